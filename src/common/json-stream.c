@@ -0,0 +1,1003 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <inttypes.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mm.h>
+#include <murphy/common/json-stream.h>
+
+#define NUMBER_MAX 64                    /* max. length of a number */
+
+/*
+ * reader
+ */
+
+static inline uint32_t depth_bit(int depth)
+{
+    return 1U << ((depth - 1) & 31);
+}
+
+
+static inline bool reader_fail(mrp_json_reader_t *r, int error)
+{
+    if (!r->error)
+        r->error = error;
+
+    errno = r->error;
+
+    return false;
+}
+
+
+static inline void skip_whitespace(mrp_json_reader_t *r)
+{
+    while (r->p < r->end) {
+        switch (*r->p) {
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+            r->p++;
+            break;
+        default:
+            return;
+        }
+    }
+}
+
+
+void mrp_json_reader_init(mrp_json_reader_t *r, char *buf, size_t size)
+{
+    r->p     = buf;
+    r->end   = buf + size;
+    r->depth  = 0;
+    r->first  = 0;
+    r->object = 0;
+    r->error  = 0;
+}
+
+
+mrp_json_reader_type_t mrp_json_reader_peek(mrp_json_reader_t *r)
+{
+    if (r->error)
+        return MRP_JSON_READER_ERROR;
+
+    skip_whitespace(r);
+
+    if (r->p >= r->end)
+        return MRP_JSON_READER_END;
+
+    switch (*r->p) {
+    case '{':
+        return MRP_JSON_READER_OBJECT;
+    case '[':
+        return MRP_JSON_READER_ARRAY;
+    case '"':
+        return MRP_JSON_READER_STRING;
+    case '-':
+    case '0' ... '9':
+        return MRP_JSON_READER_NUMBER;
+    case 't':
+    case 'f':
+        return MRP_JSON_READER_BOOLEAN;
+    case 'n':
+        return MRP_JSON_READER_NULL;
+    case '}':
+    case ']':
+        return MRP_JSON_READER_END;
+    default:
+        reader_fail(r, EINVAL);
+        return MRP_JSON_READER_ERROR;
+    }
+}
+
+
+static bool enter_container(mrp_json_reader_t *r, char open)
+{
+    if (r->error)
+        return false;
+
+    skip_whitespace(r);
+
+    if (r->p >= r->end || *r->p != open)
+        return reader_fail(r, EINVAL);
+
+    if (r->depth >= MRP_JSON_STREAM_MAXDEPTH)
+        return reader_fail(r, EOVERFLOW);
+
+    r->p++;
+    r->depth++;
+    r->first |= depth_bit(r->depth);
+
+    if (open == '{')
+        r->object |= depth_bit(r->depth);
+    else
+        r->object &= ~depth_bit(r->depth);
+
+    return true;
+}
+
+
+bool mrp_json_reader_enter_object(mrp_json_reader_t *r)
+{
+    return enter_container(r, '{');
+}
+
+
+bool mrp_json_reader_enter_array(mrp_json_reader_t *r)
+{
+    return enter_container(r, '[');
+}
+
+
+static bool next_item(mrp_json_reader_t *r, char close)
+{
+    uint32_t bit;
+
+    if (r->error || r->depth <= 0)
+        return reader_fail(r, EINVAL);
+
+    skip_whitespace(r);
+
+    if (r->p >= r->end)
+        return reader_fail(r, EINVAL);
+
+    bit = depth_bit(r->depth);
+
+    if (*r->p == close) {
+        r->p++;
+        r->first &= ~bit;
+        r->depth--;
+
+        return false;
+    }
+
+    if (r->first & bit)
+        r->first &= ~bit;
+    else {
+        if (*r->p != ',')
+            return reader_fail(r, EINVAL);
+
+        r->p++;
+        skip_whitespace(r);
+    }
+
+    return true;
+}
+
+
+static int hex_digit(char c)
+{
+    switch (c) {
+    case '0' ... '9': return c - '0';
+    case 'a' ... 'f': return c - 'a' + 10;
+    case 'A' ... 'F': return c - 'A' + 10;
+    default:          return -1;
+    }
+}
+
+
+static bool read_hex4(mrp_json_reader_t *r, uint32_t *cp)
+{
+    int i, d;
+
+    if (r->end - r->p < 4)
+        return reader_fail(r, EINVAL);
+
+    *cp = 0;
+    for (i = 0; i < 4; i++) {
+        if ((d = hex_digit(*r->p++)) < 0)
+            return reader_fail(r, EINVAL);
+
+        *cp = (*cp << 4) | d;
+    }
+
+    return true;
+}
+
+
+static char *put_utf8(char *w, uint32_t cp)
+{
+    if (cp < 0x80)
+        *w++ = cp;
+    else if (cp < 0x800) {
+        *w++ = 0xc0 |  (cp >> 6);
+        *w++ = 0x80 |  (cp & 0x3f);
+    }
+    else if (cp < 0x10000) {
+        *w++ = 0xe0 |  (cp >> 12);
+        *w++ = 0x80 | ((cp >> 6) & 0x3f);
+        *w++ = 0x80 |  (cp & 0x3f);
+    }
+    else {
+        *w++ = 0xf0 |  (cp >> 18);
+        *w++ = 0x80 | ((cp >> 12) & 0x3f);
+        *w++ = 0x80 | ((cp >> 6) & 0x3f);
+        *w++ = 0x80 |  (cp & 0x3f);
+    }
+
+    return w;
+}
+
+
+static bool read_string(mrp_json_reader_t *r, const char **sp)
+{
+    char     *start, *w;
+    uint32_t  cp, lo;
+
+    /*
+     * Notes:
+     *     We unescape strings in place. This is always possible since
+     *     an escape sequence is never shorter than what it stands for.
+     *     The closing quote is replaced by a terminating '\0'.
+     */
+
+    if (r->error)
+        return false;
+
+    skip_whitespace(r);
+
+    if (r->p >= r->end || *r->p != '"')
+        return reader_fail(r, EINVAL);
+
+    start = w = ++r->p;
+
+    while (r->p < r->end) {
+        switch (*r->p) {
+        case '"':
+            *w = '\0';
+            r->p++;
+            *sp = start;
+            return true;
+
+        case '\\':
+            if (++r->p >= r->end)
+                return reader_fail(r, EINVAL);
+
+            switch (*r->p++) {
+            case '"':  *w++ = '"';  break;
+            case '\\': *w++ = '\\'; break;
+            case '/':  *w++ = '/';  break;
+            case 'b':  *w++ = '\b'; break;
+            case 'f':  *w++ = '\f'; break;
+            case 'n':  *w++ = '\n'; break;
+            case 'r':  *w++ = '\r'; break;
+            case 't':  *w++ = '\t'; break;
+            case 'u':
+                if (!read_hex4(r, &cp))
+                    return false;
+
+                if (0xd800 <= cp && cp <= 0xdbff) {
+                    if (r->end - r->p < 6 || r->p[0] != '\\' || r->p[1] != 'u')
+                        return reader_fail(r, EINVAL);
+
+                    r->p += 2;
+
+                    if (!read_hex4(r, &lo))
+                        return false;
+
+                    if (lo < 0xdc00 || lo > 0xdfff)
+                        return reader_fail(r, EINVAL);
+
+                    cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+                }
+
+                w = put_utf8(w, cp);
+                break;
+            default:
+                return reader_fail(r, EINVAL);
+            }
+            break;
+
+        default:
+            if ((unsigned char)*r->p < 0x20)
+                return reader_fail(r, EINVAL);
+
+            *w++ = *r->p++;
+        }
+    }
+
+    return reader_fail(r, EINVAL);
+}
+
+
+bool mrp_json_reader_next_member(mrp_json_reader_t *r, const char **key)
+{
+    if (!next_item(r, '}'))
+        return false;
+
+    if (!read_string(r, key))
+        return false;
+
+    skip_whitespace(r);
+
+    if (r->p >= r->end || *r->p != ':')
+        return reader_fail(r, EINVAL);
+
+    r->p++;
+
+    return true;
+}
+
+
+bool mrp_json_reader_next_element(mrp_json_reader_t *r)
+{
+    return next_item(r, ']');
+}
+
+
+bool mrp_json_reader_get_string(mrp_json_reader_t *r, const char **s)
+{
+    return read_string(r, s);
+}
+
+
+static bool read_number(mrp_json_reader_t *r, char *buf, bool *integer)
+{
+    int n;
+
+    if (r->error)
+        return false;
+
+    skip_whitespace(r);
+
+    *integer = true;
+
+    for (n = 0; r->p < r->end && n < NUMBER_MAX - 1; n++) {
+        switch (*r->p) {
+        case '0' ... '9':
+        case '-':
+        case '+':
+            break;
+        case '.':
+        case 'e':
+        case 'E':
+            *integer = false;
+            break;
+        default:
+            goto out;
+        }
+
+        buf[n] = *r->p++;
+    }
+
+ out:
+    if (n == 0 || n == NUMBER_MAX - 1)
+        return reader_fail(r, EINVAL);
+
+    buf[n] = '\0';
+
+    return true;
+}
+
+
+bool mrp_json_reader_get_int64(mrp_json_reader_t *r, int64_t *i)
+{
+    char  buf[NUMBER_MAX], *end;
+    bool  integer;
+
+    if (!read_number(r, buf, &integer))
+        return false;
+
+    if (!integer)
+        return reader_fail(r, EINVAL);
+
+    errno = 0;
+    *i = strtoll(buf, &end, 10);
+
+    if (*end || errno != 0)
+        return reader_fail(r, errno ? errno : EINVAL);
+
+    return true;
+}
+
+
+bool mrp_json_reader_get_integer(mrp_json_reader_t *r, int *i)
+{
+    int64_t v;
+
+    if (!mrp_json_reader_get_int64(r, &v))
+        return false;
+
+    if (v < INT32_MIN || v > INT32_MAX)
+        return reader_fail(r, ERANGE);
+
+    *i = (int)v;
+
+    return true;
+}
+
+
+bool mrp_json_reader_get_double(mrp_json_reader_t *r, double *d)
+{
+    char  buf[NUMBER_MAX], *end;
+    bool  integer;
+
+    if (!read_number(r, buf, &integer))
+        return false;
+
+    errno = 0;
+    *d = strtod(buf, &end);
+
+    if (*end || errno != 0)
+        return reader_fail(r, errno ? errno : EINVAL);
+
+    return true;
+}
+
+
+bool mrp_json_reader_get_number(mrp_json_reader_t *r, int64_t *i, double *d,
+                                bool *integer)
+{
+    char  buf[NUMBER_MAX], *end;
+
+    if (!read_number(r, buf, integer))
+        return false;
+
+    errno = 0;
+
+    if (*integer)
+        *i = strtoll(buf, &end, 10);
+    else
+        *d = strtod(buf, &end);
+
+    if (*end || errno != 0)
+        return reader_fail(r, errno ? errno : EINVAL);
+
+    return true;
+}
+
+
+static bool read_literal(mrp_json_reader_t *r, const char *lit, size_t len)
+{
+    if ((size_t)(r->end - r->p) < len || strncmp(r->p, lit, len))
+        return false;
+
+    r->p += len;
+
+    return true;
+}
+
+
+bool mrp_json_reader_get_boolean(mrp_json_reader_t *r, bool *b)
+{
+    if (r->error)
+        return false;
+
+    skip_whitespace(r);
+
+    if (read_literal(r, "true", 4))
+        *b = true;
+    else if (read_literal(r, "false", 5))
+        *b = false;
+    else
+        return reader_fail(r, EINVAL);
+
+    return true;
+}
+
+
+static bool skip_string(mrp_json_reader_t *r)
+{
+    for (r->p++; r->p < r->end; r->p++) {
+        if (*r->p == '\\')
+            r->p++;
+        else if (*r->p == '"') {
+            r->p++;
+            return true;
+        }
+    }
+
+    return reader_fail(r, EINVAL);
+}
+
+
+bool mrp_json_reader_skip(mrp_json_reader_t *r)
+{
+    uint32_t objs;
+    int      level;
+
+    /*
+     * Notes:
+     *     Skipping only checks that strings are terminated and brackets
+     *     are properly balanced. It does not validate separators within
+     *     the skipped value.
+     */
+
+    if (r->error)
+        return false;
+
+    skip_whitespace(r);
+
+    if (r->p >= r->end)
+        return reader_fail(r, EINVAL);
+
+    switch (*r->p) {
+    case '"':
+        return skip_string(r);
+
+    case '{':
+    case '[':
+        level = 0;
+        objs  = 0;
+        while (r->p < r->end) {
+            switch (*r->p) {
+            case '"':
+                if (!skip_string(r))
+                    return false;
+                continue;
+            case '{':
+            case '[':
+                if (level >= MRP_JSON_STREAM_MAXDEPTH)
+                    return reader_fail(r, EOVERFLOW);
+
+                level++;
+                if (*r->p == '{')
+                    objs |=  depth_bit(level);
+                else
+                    objs &= ~depth_bit(level);
+                break;
+            case '}':
+            case ']':
+                if (!!(objs & depth_bit(level)) != (*r->p == '}'))
+                    return reader_fail(r, EINVAL);
+
+                if (--level == 0) {
+                    r->p++;
+                    return true;
+                }
+                break;
+            default:
+                break;
+            }
+            r->p++;
+        }
+        return reader_fail(r, EINVAL);
+
+    case '-':
+    case '0' ... '9':
+    case 't':
+    case 'f':
+    case 'n':
+        while (r->p < r->end) {
+            switch (*r->p) {
+            case ',': case '}': case ']':
+            case ' ': case '\t': case '\n': case '\r':
+                return true;
+            default:
+                r->p++;
+            }
+        }
+        return true;
+
+    default:
+        return reader_fail(r, EINVAL);
+    }
+}
+
+
+bool mrp_json_reader_leave(mrp_json_reader_t *r, int depth)
+{
+    const char *key;
+    bool        more;
+
+    while (r->depth > depth) {
+        if (r->object & depth_bit(r->depth))
+            more = mrp_json_reader_next_member(r, &key);
+        else
+            more = mrp_json_reader_next_element(r);
+
+        if (more) {
+            if (!mrp_json_reader_skip(r))
+                return false;
+        }
+        else if (r->error)
+            return false;
+    }
+
+    return true;
+}
+
+
+bool mrp_json_reader_done(mrp_json_reader_t *r)
+{
+    skip_whitespace(r);
+
+    /* tolerate trailing NULs, some peers terminate their messages */
+    while (r->p < r->end && *r->p == '\0')
+        r->p++;
+
+    return !r->error && r->depth == 0 && r->p >= r->end;
+}
+
+
+/*
+ * writer
+ */
+
+#define WRITER_INITIAL_SIZE 256
+
+static inline bool writer_fail(mrp_json_writer_t *w, int error)
+{
+    if (!w->error)
+        w->error = error;
+
+    errno = w->error;
+
+    return false;
+}
+
+
+static bool writer_ensure(mrp_json_writer_t *w, size_t n)
+{
+    size_t size;
+
+    if (w->error)
+        return false;
+
+    if (w->used + n <= w->size)
+        return true;
+
+    if (!w->dynamic)
+        return writer_fail(w, ENOBUFS);
+
+    size = w->size ? w->size : WRITER_INITIAL_SIZE;
+
+    while (size < w->used + n)
+        size *= 2;
+
+    if (mrp_realloc(w->buf, size) == NULL)
+        return writer_fail(w, ENOMEM);
+
+    w->size = size;
+
+    return true;
+}
+
+
+static inline bool writer_put(mrp_json_writer_t *w, const char *s, size_t n)
+{
+    if (!writer_ensure(w, n))
+        return false;
+
+    memcpy(w->buf + w->used, s, n);
+    w->used += n;
+
+    return true;
+}
+
+
+static inline bool writer_putc(mrp_json_writer_t *w, char c)
+{
+    if (!writer_ensure(w, 1))
+        return false;
+
+    w->buf[w->used++] = c;
+
+    return true;
+}
+
+
+void mrp_json_writer_init(mrp_json_writer_t *w, char *buf, size_t size,
+                          size_t headroom)
+{
+    mrp_clear(w);
+
+    w->headroom = headroom;
+
+    if (buf != NULL) {
+        w->buf  = buf;
+        w->size = size;
+
+        if (headroom > size)
+            writer_fail(w, ENOBUFS);
+    }
+    else
+        w->dynamic = true;
+
+    w->used = headroom;
+
+    if (w->dynamic)
+        writer_ensure(w, 0);
+}
+
+
+void mrp_json_writer_reset(mrp_json_writer_t *w)
+{
+    w->used  = w->headroom;
+    w->depth = 0;
+    w->first = 0;
+    w->error = (!w->dynamic && w->headroom > w->size) ? ENOBUFS : 0;
+    w->keyed = false;
+}
+
+
+void mrp_json_writer_cleanup(mrp_json_writer_t *w)
+{
+    if (w->dynamic)
+        mrp_free(w->buf);
+
+    w->buf  = NULL;
+    w->size = 0;
+    w->used = 0;
+}
+
+
+static bool separate(mrp_json_writer_t *w)
+{
+    uint32_t bit;
+
+    if (w->error)
+        return false;
+
+    if (w->keyed) {
+        w->keyed = false;
+        return true;
+    }
+
+    if (w->depth > 0) {
+        bit = depth_bit(w->depth);
+
+        if (w->first & bit)
+            w->first &= ~bit;
+        else
+            return writer_putc(w, ',');
+    }
+
+    return true;
+}
+
+
+static bool begin_container(mrp_json_writer_t *w, char open)
+{
+    if (!separate(w))
+        return false;
+
+    if (w->depth >= MRP_JSON_STREAM_MAXDEPTH)
+        return writer_fail(w, EOVERFLOW);
+
+    if (!writer_putc(w, open))
+        return false;
+
+    w->depth++;
+    w->first |= depth_bit(w->depth);
+
+    return true;
+}
+
+
+static bool end_container(mrp_json_writer_t *w, char close)
+{
+    if (w->error)
+        return false;
+
+    if (w->depth <= 0 || w->keyed)
+        return writer_fail(w, EINVAL);
+
+    w->first &= ~depth_bit(w->depth);
+    w->depth--;
+
+    return writer_putc(w, close);
+}
+
+
+bool mrp_json_writer_begin_object(mrp_json_writer_t *w)
+{
+    return begin_container(w, '{');
+}
+
+
+bool mrp_json_writer_end_object(mrp_json_writer_t *w)
+{
+    return end_container(w, '}');
+}
+
+
+bool mrp_json_writer_begin_array(mrp_json_writer_t *w)
+{
+    return begin_container(w, '[');
+}
+
+
+bool mrp_json_writer_end_array(mrp_json_writer_t *w)
+{
+    return end_container(w, ']');
+}
+
+
+static bool write_escaped(mrp_json_writer_t *w, const char *s)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char *p, *q;
+    char        esc[6];
+    size_t      n;
+
+    if (s == NULL)
+        s = "";
+
+    if (!writer_putc(w, '"'))
+        return false;
+
+    for (p = q = s; *p; p++) {
+        switch (*p) {
+        case '"':  esc[1] = '"';  n = 2; break;
+        case '\\': esc[1] = '\\'; n = 2; break;
+        case '\b': esc[1] = 'b';  n = 2; break;
+        case '\f': esc[1] = 'f';  n = 2; break;
+        case '\n': esc[1] = 'n';  n = 2; break;
+        case '\r': esc[1] = 'r';  n = 2; break;
+        case '\t': esc[1] = 't';  n = 2; break;
+        default:
+            if ((unsigned char)*p >= 0x20)
+                continue;
+
+            esc[1] = 'u';
+            esc[2] = '0';
+            esc[3] = '0';
+            esc[4] = hex[(*p >> 4) & 0xf];
+            esc[5] = hex[*p & 0xf];
+            n = 6;
+        }
+
+        esc[0] = '\\';
+
+        if (!writer_put(w, q, p - q) || !writer_put(w, esc, n))
+            return false;
+
+        q = p + 1;
+    }
+
+    if (!writer_put(w, q, p - q))
+        return false;
+
+    return writer_putc(w, '"');
+}
+
+
+bool mrp_json_writer_key(mrp_json_writer_t *w, const char *key)
+{
+    if (w->keyed)
+        return writer_fail(w, EINVAL);
+
+    if (!separate(w))
+        return false;
+
+    if (!write_escaped(w, key) || !writer_putc(w, ':'))
+        return false;
+
+    w->keyed = true;
+
+    return true;
+}
+
+
+bool mrp_json_writer_string(mrp_json_writer_t *w, const char *s)
+{
+    return separate(w) && write_escaped(w, s);
+}
+
+
+bool mrp_json_writer_integer(mrp_json_writer_t *w, int64_t i)
+{
+    char buf[32];
+    int  n;
+
+    n = snprintf(buf, sizeof(buf), "%" PRId64, i);
+
+    return separate(w) && writer_put(w, buf, n);
+}
+
+
+bool mrp_json_writer_unsigned(mrp_json_writer_t *w, uint64_t u)
+{
+    char buf[32];
+    int  n;
+
+    n = snprintf(buf, sizeof(buf), "%" PRIu64, u);
+
+    return separate(w) && writer_put(w, buf, n);
+}
+
+
+bool mrp_json_writer_double(mrp_json_writer_t *w, double d)
+{
+    char buf[64];
+    int  n;
+
+    if (!isfinite(d))
+        return mrp_json_writer_null(w);
+
+    n = snprintf(buf, sizeof(buf), "%.17g", d);
+
+    /* make sure the value reads back as floating point */
+    if (strspn(buf, "-0123456789") == (size_t)n && n < (int)sizeof(buf) - 2) {
+        buf[n++] = '.';
+        buf[n++] = '0';
+    }
+
+    return separate(w) && writer_put(w, buf, n);
+}
+
+
+bool mrp_json_writer_boolean(mrp_json_writer_t *w, bool b)
+{
+    if (b)
+        return separate(w) && writer_put(w, "true", 4);
+    else
+        return separate(w) && writer_put(w, "false", 5);
+}
+
+
+bool mrp_json_writer_null(mrp_json_writer_t *w)
+{
+    return separate(w) && writer_put(w, "null", 4);
+}
+
+
+bool mrp_json_writer_string_array(mrp_json_writer_t *w, const char **arr,
+                                  size_t cnt)
+{
+    size_t i;
+
+    if (!mrp_json_writer_begin_array(w))
+        return false;
+
+    for (i = 0; i < cnt; i++)
+        if (!mrp_json_writer_string(w, arr[i]))
+            return false;
+
+    return mrp_json_writer_end_array(w);
+}
+
+
+const char *mrp_json_writer_data(mrp_json_writer_t *w, size_t *lenp)
+{
+    if (w->error || w->depth != 0 || w->buf == NULL) {
+        if (lenp != NULL)
+            *lenp = 0;
+
+        if (!w->error)
+            w->error = EINVAL;
+
+        errno = w->error;
+
+        return NULL;
+    }
+
+    if (lenp != NULL)
+        *lenp = w->used - w->headroom;
+
+    return w->buf + w->headroom;
+}
@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MURPHY_JSON_STREAM_H__
+#define __MURPHY_JSON_STREAM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include <murphy/common/macros.h>
+
+MRP_CDECL_BEGIN
+
+/*
+ * Streaming JSON reader and writer.
+ *
+ * These are lightweight alternatives to the DOM-based JSON API in json.h
+ * for protocols where building and walking a full object tree per message
+ * would be a waste.
+ *
+ * The reader is a pull parser that walks a single JSON text on demand.
+ * Objects are walked member by member (mrp_json_reader_next_member), arrays
+ * element by element (mrp_json_reader_next_element), and values are read
+ * with the typed getters or skipped altogether. The reader never allocates
+ * memory. Strings are unescaped and NUL-terminated in place, so the reader
+ * needs to be given a writable buffer and the returned strings stay valid
+ * for as long as the buffer does.
+ *
+ * The writer serializes directly into a buffer, taking care of separators.
+ * It can write to a caller-provided fixed-size buffer or to a buffer of its
+ * own that it grows on demand and which can be reused for any number of
+ * messages. Optionally some headroom can be reserved in front of the data
+ * (for instance for transport headers).
+ */
+
+#define MRP_JSON_STREAM_MAXDEPTH 32      /* max. nesting depth */
+
+/*
+ * JSON value types, as seen by the reader
+ */
+
+typedef enum {
+    MRP_JSON_READER_ERROR = -1,          /* parse error */
+    MRP_JSON_READER_END   = 0,           /* end of input/container */
+    MRP_JSON_READER_OBJECT,              /* object */
+    MRP_JSON_READER_ARRAY,               /* array */
+    MRP_JSON_READER_STRING,              /* string */
+    MRP_JSON_READER_NUMBER,              /* integer or floating point */
+    MRP_JSON_READER_BOOLEAN,             /* true or false */
+    MRP_JSON_READER_NULL,                /* null */
+} mrp_json_reader_type_t;
+
+
+/*
+ * a JSON reader
+ */
+
+typedef struct {
+    char    *p;                          /* current read position */
+    char    *end;                        /* end of input */
+    int      depth;                      /* current nesting depth */
+    uint32_t first;                      /* first element bits per depth */
+    uint32_t object;                     /* object (vs. array) bits per depth */
+    int      error;                      /* error (errno), if any */
+} mrp_json_reader_t;
+
+/** Initialize a reader for the given (writable) buffer. */
+void mrp_json_reader_init(mrp_json_reader_t *r, char *buf, size_t size);
+
+/** Peek at the type of the next value. */
+mrp_json_reader_type_t mrp_json_reader_peek(mrp_json_reader_t *r);
+
+/** Enter the object starting at the current position. */
+bool mrp_json_reader_enter_object(mrp_json_reader_t *r);
+
+/** Enter the array starting at the current position. */
+bool mrp_json_reader_enter_array(mrp_json_reader_t *r);
+
+/** Get the next member key of the current object, FALSE at its end. */
+bool mrp_json_reader_next_member(mrp_json_reader_t *r, const char **key);
+
+/** Check if the current array has more elements, FALSE at its end. */
+bool mrp_json_reader_next_element(mrp_json_reader_t *r);
+
+/** Read a string value. */
+bool mrp_json_reader_get_string(mrp_json_reader_t *r, const char **s);
+
+/** Read an integer value. */
+bool mrp_json_reader_get_integer(mrp_json_reader_t *r, int *i);
+
+/** Read a 64-bit integer value. */
+bool mrp_json_reader_get_int64(mrp_json_reader_t *r, int64_t *i);
+
+/** Read a floating point value. */
+bool mrp_json_reader_get_double(mrp_json_reader_t *r, double *d);
+
+/** Read a number, which can be either an integer or floating point value. */
+bool mrp_json_reader_get_number(mrp_json_reader_t *r, int64_t *i, double *d,
+                                bool *integer);
+
+/** Read a boolean value. */
+bool mrp_json_reader_get_boolean(mrp_json_reader_t *r, bool *b);
+
+/** Skip the next value (including any nested objects or arrays). */
+bool mrp_json_reader_skip(mrp_json_reader_t *r);
+
+/** Skip the rest of all containers entered below the given depth. */
+bool mrp_json_reader_leave(mrp_json_reader_t *r, int depth);
+
+/** Check if the reader has consumed all of its input. */
+bool mrp_json_reader_done(mrp_json_reader_t *r);
+
+/** Get the current nesting depth of the reader. */
+static inline int mrp_json_reader_depth(mrp_json_reader_t *r)
+{
+    return r->depth;
+}
+
+/** Get the error of the reader, or 0 if no error has occured. */
+static inline int mrp_json_reader_error(mrp_json_reader_t *r)
+{
+    return r->error;
+}
+
+
+/*
+ * a JSON writer
+ */
+
+typedef struct {
+    char     *buf;                       /* output buffer */
+    size_t    size;                      /* buffer size */
+    size_t    used;                      /* buffer used (including headroom) */
+    size_t    headroom;                  /* reserved space in front of data */
+    int       depth;                     /* current nesting depth */
+    uint32_t  first;                     /* first element bits per depth */
+    int       error;                     /* error (errno), if any */
+    bool      keyed;                     /* member key just written */
+    bool      dynamic;                   /* whether we own/grow buf */
+} mrp_json_writer_t;
+
+/** Initialize a writer for the given buffer, or a growable one if NULL. */
+void mrp_json_writer_init(mrp_json_writer_t *w, char *buf, size_t size,
+                          size_t headroom);
+
+/** Reset the given writer for writing a new message. */
+void mrp_json_writer_reset(mrp_json_writer_t *w);
+
+/** Free any resources (the output buffer if we own it) of the writer. */
+void mrp_json_writer_cleanup(mrp_json_writer_t *w);
+
+/** Begin writing an object. */
+bool mrp_json_writer_begin_object(mrp_json_writer_t *w);
+
+/** Finish writing an object. */
+bool mrp_json_writer_end_object(mrp_json_writer_t *w);
+
+/** Begin writing an array. */
+bool mrp_json_writer_begin_array(mrp_json_writer_t *w);
+
+/** Finish writing an array. */
+bool mrp_json_writer_end_array(mrp_json_writer_t *w);
+
+/** Write a member key within an object. */
+bool mrp_json_writer_key(mrp_json_writer_t *w, const char *key);
+
+/** Write a string value. */
+bool mrp_json_writer_string(mrp_json_writer_t *w, const char *s);
+
+/** Write an integer value. */
+bool mrp_json_writer_integer(mrp_json_writer_t *w, int64_t i);
+
+/** Write an unsigned integer value. */
+bool mrp_json_writer_unsigned(mrp_json_writer_t *w, uint64_t u);
+
+/** Write a floating point value. */
+bool mrp_json_writer_double(mrp_json_writer_t *w, double d);
+
+/** Write a boolean value. */
+bool mrp_json_writer_boolean(mrp_json_writer_t *w, bool b);
+
+/** Write a null value. */
+bool mrp_json_writer_null(mrp_json_writer_t *w);
+
+/** Write an array of strings. */
+bool mrp_json_writer_string_array(mrp_json_writer_t *w, const char **arr,
+                                  size_t cnt);
+
+/** Get the serialized data (excluding headroom) and its length. */
+const char *mrp_json_writer_data(mrp_json_writer_t *w, size_t *lenp);
+
+/** Get the error of the writer, or 0 if no error has occured. */
+static inline int mrp_json_writer_error(mrp_json_writer_t *w)
+{
+    return w->error;
+}
+
+/** Write a member key and string value within an object. */
+static inline bool mrp_json_writer_add_string(mrp_json_writer_t *w,
+                                              const char *key, const char *s)
+{
+    return mrp_json_writer_key(w, key) && mrp_json_writer_string(w, s);
+}
+
+/** Write a member key and integer value within an object. */
+static inline bool mrp_json_writer_add_integer(mrp_json_writer_t *w,
+                                               const char *key, int64_t i)
+{
+    return mrp_json_writer_key(w, key) && mrp_json_writer_integer(w, i);
+}
+
+/** Write a member key and floating point value within an object. */
+static inline bool mrp_json_writer_add_double(mrp_json_writer_t *w,
+                                              const char *key, double d)
+{
+    return mrp_json_writer_key(w, key) && mrp_json_writer_double(w, d);
+}
+
+/** Write a member key and boolean value within an object. */
+static inline bool mrp_json_writer_add_boolean(mrp_json_writer_t *w,
+                                               const char *key, bool b)
+{
+    return mrp_json_writer_key(w, key) && mrp_json_writer_boolean(w, b);
+}
+
+MRP_CDECL_END
+
+#endif /* __MURPHY_JSON_STREAM_H__ */
@@ -124,6 +124,28 @@ const char *mrp_json_object_to_string(mrp_json_t *o)
 }
 
 
+const char *mrp_json_object_to_string_len(mrp_json_t *o, size_t *lenp)
+{
+    const char *s;
+
+    if (o == NULL) {
+        *lenp = 2;
+        return "{}";
+    }
+
+#ifdef HAVE_JSON_OBJECT_TO_JSON_STRING_LENGTH
+    s = json_object_to_json_string_length(o, JSON_C_TO_STRING_SPACED, lenp);
+#else
+    s = json_object_to_json_string(o);
+
+    if (s != NULL)
+        *lenp = strlen(s);
+#endif
+
+    return s;
+}
+
+
 mrp_json_t *mrp_json_ref(mrp_json_t *o)
 {
     return json_object_get(o);
@@ -86,6 +86,9 @@ mrp_json_t *mrp_json_string_to_object(const char *str, int len);
 /** Serialize a JSON object to a string. */
 const char *mrp_json_object_to_string(mrp_json_t *o);
 
+/** Serialize a JSON object to a string, also returning its length. */
+const char *mrp_json_object_to_string_len(mrp_json_t *o, size_t *lenp);
+
 /** Add a reference to the given JSON object. */
 mrp_json_t *mrp_json_ref(mrp_json_t *o);
 
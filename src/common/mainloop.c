@@ -27,6 +27,9 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <errno.h>
 #include <time.h>
@@ -35,8 +38,11 @@
 #include <stdarg.h>
 #include <sys/epoll.h>
 #include <sys/signalfd.h>
+#include <sys/timerfd.h>
 #include <sys/socket.h>
+#include <execinfo.h>
 
+#include <murphy/config.h>
 #include <murphy/common/macros.h>
 #include <murphy/common/mm.h>
 #include <murphy/common/log.h>
@@ -46,10 +52,47 @@
 #include <murphy/common/msg.h>
 #include <murphy/common/mainloop.h>
 
+#include "uring.h"
+#include "transport-worker.h"
+
 #define USECS_PER_SEC  (1000 * 1000)
 #define USECS_PER_MSEC (1000)
+#define NSECS_PER_SEC  (1000ULL * 1000 * 1000)
+#define NSECS_PER_MSEC (1000 * 1000)
 #define NSECS_PER_USEC (1000)
 
+/*
+ * mainloop instrumentation
+ */
+
+#ifdef MAINLOOP_STATS_ENABLED
+
+#define STATS_NBUCKET      24                    /* histogram buckets */
+#define STATS_SLOW_DEFAULT (50 * USECS_PER_MSEC) /* slow callback (usecs) */
+
+typedef struct {
+    uint64_t ncall;                              /* number of calls */
+    uint64_t total;                              /* cumulative time (ns) */
+    uint64_t max;                                /* maximum time (ns) */
+} cbstat_t;
+
+typedef struct {
+    uint64_t count[STATS_NBUCKET];               /* samples per log2(usecs) */
+    uint64_t nsample;                            /* number of samples */
+    uint64_t total;                              /* cumulative value (ns) */
+    uint64_t max;                                /* maximum value (ns) */
+} histogram_t;
+
+typedef struct {
+    uint64_t    niter;                           /* dispatched iterations */
+    uint64_t    polled;                          /* last poll return (ns) */
+    uint64_t    nslow;                           /* number of slow callbacks */
+    histogram_t lag;                             /* poll return to dispatch end */
+    histogram_t late;                            /* timer lateness */
+} mlstats_t;
+
+#endif
+
 /*
  * I/O watches
  */
@@ -65,7 +108,11 @@ struct mrp_io_watch_s {
     void              *user_data;                /* opaque user data */
     struct pollfd     *pollfd;                   /* associated pollfd */
     mrp_list_hook_t    slave;                    /* watches with the same fd */
+    int                iofd;                     /* fd record, if polled */
     int                wrhup;                    /* EPOLLHUPs delivered */
+#ifdef MAINLOOP_STATS_ENABLED
+    cbstat_t           stat;                     /* callback statistics */
+#endif
 };
 
 #define is_master(w) !mrp_list_empty(&(w)->hook)
@@ -81,10 +128,15 @@ struct mrp_timer_s {
     mrp_list_hook_t  deleted;                    /* to list of pending delete */
     int            (*free)(void *ptr);           /* cb to free memory */
     mrp_mainloop_t  *ml;                         /* mainloop */
-    unsigned int     msecs;                      /* timer interval */
-    uint64_t         expire;                     /* next expiration time */
+    uint64_t         interval;                   /* timer interval (ns) */
+    uint64_t         slack;                      /* allowed delay (ns) */
+    uint64_t         expire;                     /* next expiration (ns) */
+    int              hires;                      /* high-resolution timer */
     mrp_timer_cb_t   cb;                         /* user callback */
     void            *user_data;                  /* opaque user data */
+#ifdef MAINLOOP_STATS_ENABLED
+    cbstat_t        stat;                        /* callback statistics */
+#endif
 };
 
 
@@ -100,6 +152,9 @@ struct mrp_deferred_s {
     mrp_deferred_cb_t  cb;                       /* user callback */
     void              *user_data;                /* opaque user data */
     int                inactive : 1;
+#ifdef MAINLOOP_STATS_ENABLED
+    cbstat_t           stat;                     /* callback statistics */
+#endif
 };
 
 
@@ -133,6 +188,9 @@ struct mrp_wakeup_s {
     mrp_timer_t         *timer;                  /* forced interval timer */
     mrp_wakeup_cb_t      cb;                     /* user callback */
     void                *user_data;              /* opaque user data */
+#ifdef MAINLOOP_STATS_ENABLED
+    cbstat_t            stat;                    /* callback statistics */
+#endif
 };
 
 #define mark_deleted(o) do {                                    \
@@ -184,6 +242,28 @@ typedef struct {
 } fdtbl_t;
 
 
+/*
+ * polled fd records
+ *
+ * For every fd we poll we allocate a record which points to the master
+ * I/O watch of the fd. Instead of the fd we pass the index and current
+ * generation of the record to epoll, so we can dispatch events without
+ * an fd table lookup. Records get recycled with their generation bumped,
+ * so events fetched before an fd was removed (and possibly reused) are
+ * recognized as stale and ignored.
+ */
+
+typedef struct {
+    mrp_io_watch_t *master;                      /* master watch of the fd */
+    uint32_t        gen;                         /* record generation */
+    int             next;                        /* next free record */
+} iofd_t;
+
+#define IOFD_DATA(idx, gen) (((uint64_t)(gen) << 32) | (uint32_t)(idx))
+#define IOFD_IDX(data)      ((uint32_t)((data) & 0xffffffff))
+#define IOFD_GEN(data)      ((uint32_t)((data) >> 32))
+
+
 /*
  * external mainloops
  */
@@ -204,6 +284,9 @@ struct mrp_subloop_s {
     int                  npollfd;                /* number of pollfds */
     int                  pending;                /* pending events */
     int                  poll;                   /* need to poll for events */
+#ifdef MAINLOOP_STATS_ENABLED
+    cbstat_t             stat;                   /* callback statistics */
+#endif
 };
 
 
@@ -253,10 +336,15 @@ typedef struct {
  */
 
 struct mrp_mainloop_s {
+    mrp_mainloop_backend_t backend;              /* polling backend */
+    mrp_uring_t         *uring;                  /* io_uring, if used */
     int                  epollfd;                /* our epoll descriptor */
     struct epoll_event  *events;                 /* epoll event buffer */
     int                  nevent;                 /* epoll event buffer size */
     fdtbl_t             *fdtbl;                  /* file descriptor table */
+    iofd_t              *iofds;                  /* polled fd records */
+    int                  niofd;                  /* number of records */
+    int                  iofree;                 /* first free record */
 
     mrp_list_hook_t      iowatches;              /* list of I/O watches */
     int                  niowatch;               /* number of I/O watches */
@@ -264,6 +352,9 @@ struct mrp_mainloop_s {
 
     mrp_list_hook_t      timers;                 /* list of timers */
     mrp_timer_t         *next_timer;             /* next expiring timer */
+    int                  tfd;                    /* timerfd, -2 if unusable */
+    mrp_io_watch_t      *tfdwatch;               /* timerfd I/O watch */
+    uint64_t             tfd_expire;             /* timerfd expiration */
 
     mrp_list_hook_t      deferred;               /* list of deferred cbs */
     mrp_list_hook_t      inactive_deferred;      /* inactive defferred cbs */
@@ -287,12 +378,19 @@ struct mrp_mainloop_s {
     mrp_superloop_ops_t *super_ops;              /* superloop options */
     void                *super_data;             /* superloop glue data */
     void                *iow;                    /* superloop epollfd watch */
+    struct epoll_event  *sevents;                /* reused superloop events */
+    int                  nsevent;                /* reused buffer size */
     void                *timer;                  /* superloop timer */
     void                *work;                   /* superloop deferred work */
 
     mrp_list_hook_t      busses;                 /* known event busses */
     mrp_list_hook_t      eventq;                 /* pending events */
     mrp_deferred_t      *eventd;                 /* deferred event pump cb */
+
+#ifdef MAINLOOP_STATS_ENABLED
+    mlstats_t           *stats;                  /* statistics, if enabled */
+    uint64_t             slow;                   /* slow callback limit (ns) */
+#endif
 };
 
 
@@ -306,6 +404,191 @@ static void adjust_superloop_timer(mrp_mainloop_t *ml);
 static size_t poll_events(void *id, mrp_mainloop_t *ml, void **bufp);
 static void pump_events(mrp_deferred_t *d, void *user_data);
 
+
+/*
+ * mainloop instrumentation
+ *
+ * When compiled in, statistics are collected only while enabled for a
+ * mainloop, otherwise the only overhead is a NULL check of the statistics
+ * pointer per dispatched callback. When compiled out, all the hooks below
+ * expand to nothing (or to the bare callback invocation).
+ */
+
+#ifdef MAINLOOP_STATS_ENABLED
+
+static inline uint64_t stats_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+static inline uint64_t stats_begin(mrp_mainloop_t *ml)
+{
+    return MRP_UNLIKELY(ml->stats != NULL) ? stats_now() : 0;
+}
+
+
+static void histogram_add(histogram_t *h, uint64_t ns)
+{
+    uint64_t usecs = ns / NSECS_PER_USEC;
+    int      b     = 0;
+
+    while (usecs != 0 && b < STATS_NBUCKET - 1) {
+        usecs >>= 1;
+        b++;
+    }
+
+    h->count[b]++;
+    h->nsample++;
+    h->total += ns;
+
+    if (ns > h->max)
+        h->max = ns;
+}
+
+
+static const char *callback_name(void *cb, char *buf, size_t size)
+{
+    char **syms, *sym;
+
+    syms = backtrace_symbols(&cb, 1);
+    sym  = syms && syms[0] ? strrchr(syms[0], '/') : NULL;
+
+    if (sym != NULL)
+        snprintf(buf, size, "%s", sym + 1);
+    else
+        snprintf(buf, size, "%p", cb);
+
+    free(syms);
+
+    return buf;
+}
+
+
+static void stats_callback(mrp_mainloop_t *ml, cbstat_t *cs, const char *type,
+                           void *obj, void *cb, uint64_t start)
+{
+    uint64_t diff;
+    char     name[256];
+
+    if (MRP_LIKELY(ml->stats == NULL) || start == 0)
+        return;
+
+    diff = stats_now() - start;
+
+    cs->ncall++;
+    cs->total += diff;
+
+    if (diff > cs->max)
+        cs->max = diff;
+
+    if (ml->slow && diff > ml->slow) {
+        ml->stats->nslow++;
+        mrp_log_warning("mainloop: slow %s %p callback %s took %.3f msecs",
+                        type, obj, callback_name(cb, name, sizeof(name)),
+                        diff / 1000000.0);
+    }
+}
+
+
+static inline void stats_timer_late(mrp_mainloop_t *ml, uint64_t usecs)
+{
+    if (MRP_UNLIKELY(ml->stats != NULL))
+        histogram_add(&ml->stats->late, usecs * NSECS_PER_USEC);
+}
+
+
+static inline void stats_polled(mrp_mainloop_t *ml)
+{
+    if (MRP_UNLIKELY(ml->stats != NULL))
+        ml->stats->polled = stats_now();
+}
+
+
+static inline void stats_dispatched(mrp_mainloop_t *ml)
+{
+    mlstats_t *st = ml->stats;
+
+    if (MRP_LIKELY(st == NULL) || st->polled == 0)
+        return;
+
+    histogram_add(&st->lag, stats_now() - st->polled);
+    st->niter++;
+    st->polled = 0;
+}
+
+
+static void stats_init(mrp_mainloop_t *ml);
+
+#define STATS_CALL(_ml, _o, _type, _cb, _call) do {                     \
+        uint64_t  _start = stats_begin(_ml);                            \
+        void     *_fn    = (void *)(_cb);                               \
+                                                                        \
+        _call;                                                          \
+                                                                        \
+        stats_callback(_ml, &(_o)->stat, _type, _o, _fn, _start);       \
+    } while (0)
+
+#define STATS_TIMER_LATE(_ml, _usecs) stats_timer_late(_ml, _usecs)
+#define STATS_POLLED(_ml)             stats_polled(_ml)
+#define STATS_DISPATCHED(_ml)         stats_dispatched(_ml)
+#define STATS_INIT(_ml)               stats_init(_ml)
+#define STATS_FREE(_ml)               mrp_free((_ml)->stats)
+
+#else /* !MAINLOOP_STATS_ENABLED */
+
+#define STATS_CALL(_ml, _o, _type, _cb, _call) _call
+#define STATS_TIMER_LATE(_ml, _usecs)          do { } while (0)
+#define STATS_POLLED(_ml)                      do { } while (0)
+#define STATS_DISPATCHED(_ml)                  do { } while (0)
+#define STATS_INIT(_ml)                        do { } while (0)
+#define STATS_FREE(_ml)                        do { } while (0)
+
+#endif /* !MAINLOOP_STATS_ENABLED */
+
+/*
+ * polling backends
+ *
+ * The epoll backend is the default. The io_uring backend emulates the
+ * epoll interface we need with poll requests (see uring.h).
+ */
+
+static int backend_ctl(mrp_mainloop_t *ml, int op, int fd,
+                       struct epoll_event *evt)
+{
+    if (ml->uring != NULL)
+        return mrp_uring_poll_ctl(ml->uring, op, fd, evt);
+    else
+        return epoll_ctl(ml->epollfd, op, fd, evt);
+}
+
+
+static int backend_wait(mrp_mainloop_t *ml, struct epoll_event *events,
+                        int nevent, int timeout)
+{
+    if (ml->uring != NULL)
+        return mrp_uring_wait(ml->uring, events, nevent, timeout);
+    else
+        return epoll_wait(ml->epollfd, events, nevent, timeout);
+}
+
+
+static inline int backend_fd(mrp_mainloop_t *ml)
+{
+    return ml->uring != NULL ? mrp_uring_fd(ml->uring) : ml->epollfd;
+}
+
+
+mrp_uring_t *mrp_mainloop_get_uring(mrp_mainloop_t *ml)
+{
+    return ml->uring;
+}
+
+
 /*
  * fd table manipulation
  */
@@ -410,6 +693,77 @@ static void fdtbl_remove(fdtbl_t *ft, int fd)
 }
 
 
+/*
+ * polled fd records
+ */
+
+static int iofd_alloc(mrp_mainloop_t *ml, mrp_io_watch_t *w)
+{
+    iofd_t *r;
+    int     i, n;
+
+    if (ml->iofree < 0) {
+        n = ml->niofd ? 2 * ml->niofd : 64;
+
+        if (!mrp_reallocz(ml->iofds, ml->niofd, n))
+            return -1;
+
+        for (i = ml->niofd; i < n; i++)
+            ml->iofds[i].next = (i < n - 1 ? i + 1 : -1);
+
+        ml->iofree = ml->niofd;
+        ml->niofd  = n;
+    }
+
+    i = ml->iofree;
+    r = ml->iofds + i;
+
+    ml->iofree = r->next;
+    r->master  = w;
+    r->next    = -1;
+    w->iofd    = i;
+
+    return 0;
+}
+
+
+static void iofd_free(mrp_mainloop_t *ml, mrp_io_watch_t *w)
+{
+    iofd_t *r;
+
+    if (w->iofd < 0)
+        return;
+
+    r = ml->iofds + w->iofd;
+
+    r->master  = NULL;
+    r->gen++;
+    r->next    = ml->iofree;
+    ml->iofree = w->iofd;
+    w->iofd    = -1;
+}
+
+
+static inline uint64_t iofd_data(mrp_mainloop_t *ml, mrp_io_watch_t *master)
+{
+    return IOFD_DATA(master->iofd, ml->iofds[master->iofd].gen);
+}
+
+
+static inline mrp_io_watch_t *iofd_lookup(mrp_mainloop_t *ml, uint64_t data)
+{
+    uint32_t idx = IOFD_IDX(data);
+
+    if (MRP_UNLIKELY(idx >= (uint32_t)ml->niofd))
+        return NULL;
+
+    if (ml->iofds[idx].gen != IOFD_GEN(data))
+        return NULL;
+
+    return ml->iofds[idx].master;
+}
+
+
 /*
  * I/O watches
  */
@@ -442,10 +796,9 @@ static int epoll_add_slave(mrp_io_watch_t *master, mrp_io_watch_t *slave)
     struct epoll_event  evt;
 
     evt.events   = epoll_event_mask(master, NULL) | slave->events;
-    evt.data.u64 = 0;
-    evt.data.fd  = master->fd;
+    evt.data.u64 = iofd_data(ml, master);
 
-    if (epoll_ctl(ml->epollfd, EPOLL_CTL_MOD, master->fd, &evt) == 0) {
+    if (backend_ctl(ml, EPOLL_CTL_MOD, master->fd, &evt) == 0) {
         mrp_list_append(&master->slave, &slave->slave);
 
         return 0;
@@ -462,18 +815,21 @@ static int epoll_add(mrp_io_watch_t *w)
     struct epoll_event  evt;
 
     if (fdtbl_insert(ml->fdtbl, w->fd, w) == 0) {
-        evt.events   = w->events;
-        evt.data.u64 = 0;                /* init full union for valgrind... */
-        evt.data.fd  = w->fd;
+        if (iofd_alloc(ml, w) == 0) {
+            evt.events   = w->events;
+            evt.data.u64 = iofd_data(ml, w);
 
-        if (epoll_ctl(ml->epollfd, EPOLL_CTL_ADD, w->fd, &evt) == 0) {
-            mrp_list_append(&ml->iowatches, &w->hook);
-            ml->niowatch++;
+            if (backend_ctl(ml, EPOLL_CTL_ADD, w->fd, &evt) == 0) {
+                mrp_list_append(&ml->iowatches, &w->hook);
+                ml->niowatch++;
 
-            return 0;
+                return 0;
+            }
+
+            iofd_free(ml, w);
         }
-        else
-            fdtbl_remove(ml->fdtbl, w->fd);
+
+        fdtbl_remove(ml->fdtbl, w->fd);
     }
     else {
         if (errno == EEXIST) {
@@ -501,19 +857,22 @@ static int epoll_del(mrp_io_watch_t *w)
         master = fdtbl_lookup(ml->fdtbl, w->fd);
 
     if (master != NULL) {
+        if (master->iofd < 0)            /* polling already stopped */
+            return 0;
+
         evt.events   = epoll_event_mask(master, w);
-        evt.data.u64 = 0;                /* init full union for valgrind... */
-        evt.data.fd  = w->fd;
+        evt.data.u64 = iofd_data(ml, master);
 
         if ((evt.events & MRP_IO_EVENT_ALL) == 0) {
             fdtbl_remove(ml->fdtbl, w->fd);
-            status = epoll_ctl(ml->epollfd, EPOLL_CTL_DEL, w->fd, &evt);
+            iofd_free(ml, master);
+            status = backend_ctl(ml, EPOLL_CTL_DEL, w->fd, &evt);
 
             if (status == 0 || (errno == EBADF || errno == ENOENT))
                 ml->niowatch--;
         }
         else
-            status = epoll_ctl(ml->epollfd, EPOLL_CTL_MOD, w->fd, &evt);
+            status = backend_ctl(ml, EPOLL_CTL_MOD, w->fd, &evt);
 
         if (status == 0 || (errno == EBADF || errno == ENOENT))
             return 0;
@@ -548,9 +907,17 @@ static int free_io_watch(void *ptr)
             mrp_list_append(&ml->iowatches, &master->hook);
 
             fdtbl_insert(ml->fdtbl, master->fd, master);
+
+            /* and hand our fd record over to it */
+            if (w->iofd >= 0) {
+                ml->iofds[w->iofd].master = master;
+                master->iofd = w->iofd;
+                w->iofd      = -1;
+            }
         }
     }
 
+    iofd_free(ml, w);
     mrp_list_delete(&w->slave);
     mrp_free(w);
 
@@ -573,6 +940,7 @@ mrp_io_watch_t *mrp_add_io_watch(mrp_mainloop_t *ml, int fd,
         mrp_list_init(&w->slave);
         w->ml        = ml;
         w->fd        = fd;
+        w->iofd      = -1;
         w->events    = events & MRP_IO_EVENT_ALL;
 
         switch (events & MRP_IO_TRIGGER_MASK) {
@@ -669,13 +1037,26 @@ static uint64_t time_now(void)
 }
 
 
-static inline int usecs_to_msecs(uint64_t usecs)
+static uint64_t time_now_ns(void)
 {
-    int msecs;
+    struct timespec ts;
+    uint64_t        now;
 
-    msecs = (usecs + USECS_PER_MSEC - 1) / USECS_PER_MSEC;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now  = ts.tv_sec  * NSECS_PER_SEC;
+    now += ts.tv_nsec;
 
-    return msecs;
+    return now;
+}
+
+
+static inline int nsecs_to_msecs(uint64_t nsecs)
+{
+    uint64_t msecs;
+
+    msecs = (nsecs + NSECS_PER_MSEC - 1) / NSECS_PER_MSEC;
+
+    return msecs < INT_MAX ? (int)msecs : INT_MAX;
 }
 
 
@@ -721,10 +1102,39 @@ static void insert_timer(mrp_timer_t *t)
 }
 
 
-static inline void rearm_timer(mrp_timer_t *t)
+static inline void restart_timer(mrp_timer_t *t)
 {
     mrp_list_delete(&t->hook);
-    t->expire = time_now() + t->msecs * USECS_PER_MSEC;
+    t->expire = time_now_ns() + t->interval;
+    insert_timer(t);
+}
+
+
+static inline void rearm_timer(mrp_timer_t *t, uint64_t now)
+{
+    uint64_t missed;
+
+    /*
+     * Normal timers get rescheduled relative to the current time, so
+     * they slowly drift by the time it takes to get them dispatched.
+     * High-resolution timers get rescheduled relative to their previous
+     * expiration, skipping any expirations we missed altogether.
+     */
+
+    if (!t->hires || t->interval == 0) {
+        restart_timer(t);
+        return;
+    }
+
+    mrp_list_delete(&t->hook);
+
+    t->expire += t->interval;
+
+    if (t->expire <= now) {
+        missed     = (now - t->expire) / t->interval + 1;
+        t->expire += missed * t->interval;
+    }
+
     insert_timer(t);
 }
 
@@ -759,8 +1169,9 @@ static int free_timer(void *ptr)
 
 
 
-mrp_timer_t *mrp_add_timer(mrp_mainloop_t *ml, unsigned int msecs,
-                           mrp_timer_cb_t cb, void *user_data)
+static mrp_timer_t *add_timer(mrp_mainloop_t *ml, uint64_t nsecs,
+                              uint64_t slack, int hires,
+                              mrp_timer_cb_t cb, void *user_data)
 {
     mrp_timer_t *t;
 
@@ -771,8 +1182,10 @@ mrp_timer_t *mrp_add_timer(mrp_mainloop_t *ml, unsigned int msecs,
         mrp_list_init(&t->hook);
         mrp_list_init(&t->deleted);
         t->ml        = ml;
-        t->expire    = time_now() + msecs * USECS_PER_MSEC;
-        t->msecs     = msecs;
+        t->expire    = time_now_ns() + nsecs;
+        t->interval  = nsecs;
+        t->slack     = slack;
+        t->hires     = hires;
         t->cb        = cb;
         t->user_data = user_data;
         t->free      = free_timer;
@@ -784,13 +1197,51 @@ mrp_timer_t *mrp_add_timer(mrp_mainloop_t *ml, unsigned int msecs,
 }
 
 
+mrp_timer_t *mrp_add_timer(mrp_mainloop_t *ml, unsigned int msecs,
+                           mrp_timer_cb_t cb, void *user_data)
+{
+    return add_timer(ml, (uint64_t)msecs * NSECS_PER_MSEC, 0, FALSE,
+                     cb, user_data);
+}
+
+
+mrp_timer_t *mrp_add_timer_ns(mrp_mainloop_t *ml, uint64_t nsecs,
+                              uint64_t slack, mrp_timer_cb_t cb,
+                              void *user_data)
+{
+    return add_timer(ml, nsecs, slack, TRUE, cb, user_data);
+}
+
+
 void mrp_mod_timer(mrp_timer_t *t, unsigned int msecs)
 {
     if (t != NULL && !is_deleted(t)) {
         if (msecs != MRP_TIMER_RESTART)
-            t->msecs = msecs;
+            t->interval = (uint64_t)msecs * NSECS_PER_MSEC;
+
+        restart_timer(t);
+    }
+}
+
+
+void mrp_mod_timer_ns(mrp_timer_t *t, uint64_t nsecs)
+{
+    if (t != NULL && !is_deleted(t)) {
+        if (nsecs != MRP_TIMER_RESTART_NS)
+            t->interval = nsecs;
+
+        restart_timer(t);
+    }
+}
+
 
-        rearm_timer(t);
+void mrp_set_timer_slack(mrp_timer_t *t, uint64_t slack)
+{
+    if (t != NULL && !is_deleted(t)) {
+        t->slack = slack;
+
+        if (t->ml->next_timer == t)
+            adjust_superloop_timer(t->ml);
     }
 }
 
@@ -826,6 +1277,105 @@ mrp_mainloop_t *mrp_get_timer_mainloop(mrp_timer_t *t)
 }
 
 
+static uint64_t timer_wakeup(mrp_mainloop_t *ml, int *hires)
+{
+    mrp_list_hook_t *p, *n;
+    mrp_timer_t     *t;
+    uint64_t         wakeup;
+
+    /*
+     * Find the latest time we can wake up without delaying any timer
+     * beyond its slack. This is the earliest expiration plus slack of
+     * any timer. Also check if any timer we'll dispatch by then needs
+     * a high-resolution wakeup.
+     */
+
+    wakeup = UINT64_MAX;
+    *hires = FALSE;
+
+    mrp_list_foreach(&ml->timers, p, n) {
+        t = mrp_list_entry(p, typeof(*t), hook);
+
+        if (is_deleted(t))
+            continue;
+
+        if (t->expire >= wakeup)
+            break;
+
+        if (t->expire + t->slack < wakeup)
+            wakeup = t->expire + t->slack;
+
+        if (t->hires)
+            *hires = TRUE;
+    }
+
+    return wakeup;
+}
+
+
+static void dispatch_timerfd(mrp_io_watch_t *w, int fd,
+                             mrp_io_event_t events, void *user_data)
+{
+    mrp_mainloop_t *ml = mrp_get_io_watch_mainloop(w);
+    uint64_t        n;
+
+    MRP_UNUSED(events);
+    MRP_UNUSED(user_data);
+
+    /* the expired timers themselves are dispatched by dispatch_timers */
+    if (read(fd, &n, sizeof(n)) == sizeof(n))
+        ml->tfd_expire = 0;
+}
+
+
+static int arm_timerfd(mrp_mainloop_t *ml, uint64_t expire)
+{
+    struct itimerspec it;
+
+    if (expire == ml->tfd_expire)
+        return TRUE;
+
+    if (ml->tfd < 0) {
+        if (expire == 0 || ml->tfd == -2)
+            return expire == 0;
+
+        ml->tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+        if (ml->tfd == -1)
+            goto fail;
+
+        ml->tfdwatch = mrp_add_io_watch(ml, ml->tfd, MRP_IO_EVENT_IN,
+                                        dispatch_timerfd, NULL);
+
+        if (ml->tfdwatch == NULL) {
+            close(ml->tfd);
+            goto fail;
+        }
+    }
+
+    mrp_clear(&it);
+    it.it_value.tv_sec  = expire / NSECS_PER_SEC;
+    it.it_value.tv_nsec = expire % NSECS_PER_SEC;
+
+    if (timerfd_settime(ml->tfd, TFD_TIMER_ABSTIME, &it, NULL) < 0) {
+        mrp_log_error("Failed to arm timerfd (%d: %s).", errno,
+                      strerror(errno));
+        return FALSE;
+    }
+
+    ml->tfd_expire = expire;
+
+    return TRUE;
+
+ fail:
+    mrp_log_error("Failed to set up timerfd (%d: %s), high-resolution "
+                  "timers will have millisecond resolution.", errno,
+                  strerror(errno));
+    ml->tfd = -2;
+    return FALSE;
+}
+
+
 /*
  * deferred/idle callbacks
  */
@@ -1332,7 +1882,7 @@ int mrp_set_superloop(mrp_mainloop_t *ml, mrp_superloop_ops_t *ops,
         mrp_mainloop_prepare(ml);
 
         events    = MRP_IO_EVENT_IN | MRP_IO_EVENT_OUT | MRP_IO_EVENT_HUP;
-        ml->iow   = ops->add_io(ml->super_data, ml->epollfd, events,
+        ml->iow   = ops->add_io(ml->super_data, backend_fd(ml), events,
                                 super_io_cb, ml);
         ml->work  = ops->add_defer(ml->super_data, super_work_cb, ml);
 
@@ -1528,16 +2078,64 @@ static void purge_subloops(mrp_mainloop_t *ml)
 }
 
 
+static mrp_mainloop_backend_t default_backend(void)
+{
+    const char *env = getenv("__MURPHY_MAINLOOP_BACKEND");
+
+    if (env == NULL || !strcmp(env, "epoll"))
+        return MRP_MAINLOOP_BACKEND_EPOLL;
+
+    if (!strcmp(env, "io_uring") || !strcmp(env, "uring"))
+        return MRP_MAINLOOP_BACKEND_IO_URING;
+
+    mrp_log_warning("Ignoring unknown mainloop backend '%s'.", env);
+
+    return MRP_MAINLOOP_BACKEND_EPOLL;
+}
+
+
+static int setup_backend(mrp_mainloop_t *ml, mrp_mainloop_backend_t backend)
+{
+    if (backend == MRP_MAINLOOP_BACKEND_DEFAULT)
+        backend = default_backend();
+
+    if (backend == MRP_MAINLOOP_BACKEND_IO_URING) {
+        if ((ml->uring = mrp_uring_create()) != NULL) {
+            ml->backend = MRP_MAINLOOP_BACKEND_IO_URING;
+            ml->epollfd = -1;
+
+            return TRUE;
+        }
+
+        mrp_log_warning("Failed to create io_uring (%d: %s), falling back "
+                        "to epoll.", errno, strerror(errno));
+    }
+
+    ml->backend = MRP_MAINLOOP_BACKEND_EPOLL;
+    ml->epollfd = epoll_create1(EPOLL_CLOEXEC);
+
+    return ml->epollfd >= 0;
+}
+
+
 mrp_mainloop_t *mrp_mainloop_create(void)
+{
+    return mrp_mainloop_create_backend(MRP_MAINLOOP_BACKEND_DEFAULT);
+}
+
+
+mrp_mainloop_t *mrp_mainloop_create_backend(mrp_mainloop_backend_t backend)
 {
     mrp_mainloop_t *ml;
 
     if ((ml = mrp_allocz(sizeof(*ml))) != NULL) {
-        ml->epollfd = epoll_create1(EPOLL_CLOEXEC);
+        ml->epollfd = -1;
         ml->sigfd   = -1;
+        ml->tfd     = -1;
+        ml->iofree  = -1;
         ml->fdtbl   = fdtbl_create();
 
-        if (ml->epollfd >= 0 && ml->fdtbl != NULL) {
+        if (ml->fdtbl != NULL && setup_backend(ml, backend)) {
             mrp_list_init(&ml->iowatches);
             mrp_list_init(&ml->timers);
             mrp_list_init(&ml->deferred);
@@ -1556,9 +2154,12 @@ mrp_mainloop_t *mrp_mainloop_create(void)
 
             if (!setup_sighandlers(ml))
                 goto fail;
+
+            STATS_INIT(ml);
         }
         else {
         fail:
+            mrp_uring_destroy(ml->uring);
             close(ml->epollfd);
             fdtbl_destroy(ml->fdtbl);
             mrp_free(ml);
@@ -1572,10 +2173,17 @@ mrp_mainloop_t *mrp_mainloop_create(void)
 }
 
 
+mrp_mainloop_backend_t mrp_mainloop_get_backend(mrp_mainloop_t *ml)
+{
+    return ml->backend;
+}
+
+
 void mrp_mainloop_destroy(mrp_mainloop_t *ml)
 {
     if (ml != NULL) {
         mrp_clear_superloop(ml);
+        mrp_transport_async_purge(ml);
         purge_io_watches(ml);
         purge_timers(ml);
         purge_deferred(ml);
@@ -1584,11 +2192,17 @@ void mrp_mainloop_destroy(mrp_mainloop_t *ml)
         purge_subloops(ml);
         purge_deleted(ml);
 
+        mrp_uring_destroy(ml->uring);
         close(ml->sigfd);
+        if (ml->tfd >= 0)
+            close(ml->tfd);
         close(ml->epollfd);
         fdtbl_destroy(ml->fdtbl);
 
+        STATS_FREE(ml);
+        mrp_free(ml->iofds);
         mrp_free(ml->events);
+        mrp_free(ml->sevents);
         mrp_free(ml);
     }
 }
@@ -1632,7 +2246,8 @@ static int prepare_subloop(mrp_subloop_t *sl)
 
     if (sl->cb->prepare(sl->user_data)) {
         mrp_debug("subloop %p prepare reported ready, dispatching it", sl);
-        sl->cb->dispatch(sl->user_data);
+        STATS_CALL(sl->ml, sl, "subloop", sl->cb->dispatch,
+                   sl->cb->dispatch(sl->user_data));
     }
     sl->poll = FALSE;
 
@@ -1773,7 +2388,9 @@ static inline void dump_timers(mrp_mainloop_t *ml)
     mrp_list_foreach(&ml->timers, p, n) {
         t = mrp_list_entry(p, typeof(*t), hook);
 
-        mrp_debug("  #%d: %p, @%u, next %llu (%s)", i, t, t->msecs, t->expire,
+        mrp_debug("  #%d: %p, @%llu, next %llu (%s)", i, t,
+                  (unsigned long long)t->interval,
+                  (unsigned long long)t->expire,
                   is_deleted(t) ? "DEAD" : "alive");
 
         if (!is_deleted(t) && next == NULL)
@@ -1797,27 +2414,33 @@ static inline void dump_timers(mrp_mainloop_t *ml)
 
 int mrp_mainloop_prepare(mrp_mainloop_t *ml)
 {
-    mrp_timer_t *next_timer;
-    int          timeout, ext_timeout;
-    uint64_t     now;
+    uint64_t now, expire;
+    int      timeout, ext_timeout, hires;
+
+    hires = FALSE;
 
     if (!mrp_list_empty(&ml->deferred)) {
         timeout = 0;
     }
     else {
-        next_timer = ml->next_timer;
-
-        if (next_timer == NULL)
+        if (ml->next_timer == NULL)
             timeout = -1;
         else {
-            now = time_now();
-            if (MRP_UNLIKELY(next_timer->expire <= now))
+            now    = time_now_ns();
+            expire = timer_wakeup(ml, &hires);
+
+            if (MRP_UNLIKELY(expire <= now))
                 timeout = 0;
+            else if (hires && arm_timerfd(ml, expire))
+                timeout = -1;
             else
-                timeout = usecs_to_msecs(next_timer->expire - now);
+                timeout = nsecs_to_msecs(expire - now);
         }
     }
 
+    if (!hires && ml->tfd_expire != 0)
+        arm_timerfd(ml, 0);
+
     ext_timeout = prepare_subloops(ml);
 
     if (ext_timeout != -1 && timeout != -1)
@@ -1834,6 +2457,14 @@ int mrp_mainloop_prepare(mrp_mainloop_t *ml)
         MRP_ASSERT(ml->events != NULL, "can't allocate epoll event buffer");
     }
 
+    /*
+     * With a superloop we won't get to submit pending io_uring requests
+     * when polling, so submit them now before the superloop blocks.
+     */
+
+    if (ml->uring != NULL && ml->super_ops != NULL)
+        mrp_uring_submit(ml->uring);
+
     mrp_debug("mainloop %p prepared: %d I/O watches, timeout %d", ml,
               ml->niowatch, ml->poll_timeout);
 
@@ -1841,14 +2472,24 @@ int mrp_mainloop_prepare(mrp_mainloop_t *ml)
 }
 
 
+static int check_superloop_id(mrp_mainloop_t *ml, void *id)
+{
+    if (MRP_UNLIKELY(id != ml->iow)) {
+        mrp_log_error("superloop polling with invalid I/O watch (%p != %p)",
+                      id, ml->iow);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
 static size_t poll_events(void *id, mrp_mainloop_t *ml, void **bufp)
 {
     void *buf;
     int   n;
 
-    if (MRP_UNLIKELY(id != ml->iow)) {
-        mrp_log_error("superloop polling with invalid I/O watch (%p != %p)",
-                      id, ml->iow);
+    if (!check_superloop_id(ml, id)) {
         *bufp = NULL;
         return 0;
     }
@@ -1856,7 +2497,7 @@ static size_t poll_events(void *id, mrp_mainloop_t *ml, void **bufp)
     buf = mrp_allocz(ml->nevent * sizeof(ml->events[0]));
 
     if (buf != NULL) {
-        n = epoll_wait(ml->epollfd, buf, ml->nevent, 0);
+        n = backend_wait(ml, buf, ml->nevent, 0);
 
         if (n < 0)
             n = 0;
@@ -1869,6 +2510,38 @@ static size_t poll_events(void *id, mrp_mainloop_t *ml, void **bufp)
 }
 
 
+size_t mrp_superloop_poll_events(mrp_mainloop_t *ml, void *id, void **bufp)
+{
+    int n;
+
+    if (!check_superloop_id(ml, id)) {
+        *bufp = NULL;
+        return 0;
+    }
+
+    if (ml->nsevent < ml->nevent) {
+        mrp_free(ml->sevents);
+        ml->nsevent = 0;
+
+        if ((ml->sevents = mrp_allocz_array(struct epoll_event,
+                                            ml->nevent)) == NULL) {
+            *bufp = NULL;
+            return 0;
+        }
+
+        ml->nsevent = ml->nevent;
+    }
+
+    n = backend_wait(ml, ml->sevents, ml->nevent, 0);
+
+    if (n < 0)
+        n = 0;
+
+    *bufp = ml->sevents;
+    return n * sizeof(ml->events[0]);
+}
+
+
 int mrp_mainloop_poll(mrp_mainloop_t *ml, int may_block)
 {
     int n, timeout;
@@ -1880,7 +2553,7 @@ int mrp_mainloop_poll(mrp_mainloop_t *ml, int may_block)
             mrp_debug("polling %d descriptors with timeout %d",
                       ml->nevent, timeout);
 
-            n = epoll_wait(ml->epollfd, ml->events, ml->nevent, timeout);
+            n = backend_wait(ml, ml->events, ml->nevent, timeout);
 
             if (n < 0 && errno == EINTR)
                 n = 0;
@@ -1915,6 +2588,8 @@ int mrp_mainloop_poll(mrp_mainloop_t *ml, int may_block)
         ml->poll_result = 0;
     }
 
+    STATS_POLLED(ml);
+
     return TRUE;
 }
 
@@ -1984,7 +2659,7 @@ static void dispatch_wakeup(mrp_mainloop_t *ml)
 
         if (!is_deleted(w)) {
             mrp_debug("dispatching wakeup cb %p", w);
-            wakeup_cb(w, event, now);
+            STATS_CALL(ml, w, "wakeup", w->cb, wakeup_cb(w, event, now));
         }
         else
             mrp_debug("skipping deleted wakeup cb %p", w);
@@ -2005,7 +2680,7 @@ static void dispatch_deferred(mrp_mainloop_t *ml)
 
         if (!is_deleted(d) && !d->inactive) {
             mrp_debug("dispatching active deferred cb %p", d);
-            d->cb(d, d->user_data);
+            STATS_CALL(ml, d, "deferred", d->cb, d->cb(d, d->user_data));
         }
         else
             mrp_debug("skipping %s deferred cb %p",
@@ -2026,7 +2701,7 @@ static void dispatch_timers(mrp_mainloop_t *ml)
     mrp_timer_t     *t;
     uint64_t         now;
 
-    now = time_now();
+    now = time_now_ns();
 
     mrp_list_foreach(&ml->timers, p, n) {
         t = mrp_list_entry(p, typeof(*t), hook);
@@ -2035,10 +2710,11 @@ static void dispatch_timers(mrp_mainloop_t *ml)
             if (t->expire <= now) {
                 mrp_debug("dispatching expired timer %p", t);
 
-                t->cb(t, t->user_data);
+                STATS_TIMER_LATE(ml, (now - t->expire) / NSECS_PER_USEC);
+                STATS_CALL(ml, t, "timer", t->cb, t->cb(t, t->user_data));
 
                 if (!is_deleted(t))
-                    rearm_timer(t);
+                    rearm_timer(t, now);
             }
             else
                 break;
@@ -2066,7 +2742,8 @@ static void dispatch_subloops(mrp_mainloop_t *ml)
             if (sl->cb->check(sl->user_data, sl->pollfds,
                               sl->npollfd)) {
                 mrp_debug("dispatching subloop %p", sl);
-                sl->cb->dispatch(sl->user_data);
+                STATS_CALL(ml, sl, "subloop", sl->cb->dispatch,
+                           sl->cb->dispatch(sl->user_data));
             }
             else
                 mrp_debug("skipping subloop %p, check said no", sl);
@@ -2091,7 +2768,8 @@ static void dispatch_slaves(mrp_io_watch_t *w, struct epoll_event *e)
 
         if (!is_deleted(s)) {
             mrp_debug("dispatching slave I/O watch %p (fd %d)", s, s->fd);
-            s->cb(s, s->fd, events, s->user_data);
+            STATS_CALL(s->ml, s, "I/O watch", s->cb,
+                       s->cb(s, s->fd, events, s->user_data));
         }
         else
             mrp_debug("skipping slave I/O watch %p (fd %d)", s, s->fd);
@@ -2104,21 +2782,24 @@ static void dispatch_slaves(mrp_io_watch_t *w, struct epoll_event *e)
 static void dispatch_poll_events(mrp_mainloop_t *ml)
 {
     struct epoll_event *e;
-    mrp_io_watch_t     *w, *tblw;
+    mrp_io_watch_t     *w;
     int                 i, fd;
 
     for (i = 0, e = ml->events; i < ml->poll_result; i++, e++) {
-        fd = e->data.fd;
-        w  = fdtbl_lookup(ml->fdtbl, fd);
+        w = iofd_lookup(ml, e->data.u64);
 
         if (w == NULL) {
-            mrp_debug("ignoring event for deleted fd %d", fd);
+            mrp_debug("ignoring stale event for fd record 0x%llx",
+                      (unsigned long long)e->data.u64);
             continue;
         }
 
+        fd = w->fd;
+
         if (!is_deleted(w)) {
             mrp_debug("dispatching I/O watch %p (fd %d)", w, fd);
-            w->cb(w, w->fd, e->events, w->user_data);
+            STATS_CALL(ml, w, "I/O watch", w->cb,
+                       w->cb(w, w->fd, e->events, w->user_data));
         }
         else
             mrp_debug("skipping deleted I/O watch %p (fd %d)", w, fd);
@@ -2127,15 +2808,10 @@ static void dispatch_poll_events(mrp_mainloop_t *ml)
             dispatch_slaves(w, e);
 
         if (e->events & EPOLLRDHUP) {
-            tblw = fdtbl_lookup(ml->fdtbl, w->fd);
-
-            if (tblw == w) {
+            if (iofd_lookup(ml, e->data.u64) == w) {
                 mrp_debug("forcibly stop polling fd %d for watch %p", w->fd, w);
                 epoll_del(w);
             }
-            else if (tblw != NULL)
-                mrp_debug("don't stop polling reused fd %d of watch %p",
-                          w->fd, w);
         }
         else {
             if ((e->events & EPOLLHUP) && !is_deleted(w)) {
@@ -2149,16 +2825,11 @@ static void dispatch_poll_events(mrp_mainloop_t *ml)
                  */
 
                 if (w->wrhup++ > 5) {
-                    tblw = fdtbl_lookup(ml->fdtbl, w->fd);
-
-                    if (tblw == w) {
+                    if (iofd_lookup(ml, e->data.u64) == w) {
                         mrp_debug("forcibly stop polling fd %d for watch %p",
                                   w->fd, w);
                         epoll_del(w);
                     }
-                    else if (tblw != NULL)
-                        mrp_debug("don't stop polling reused fd %d of watch %p",
-                                  w->fd, w);
                 }
             }
         }
@@ -2170,6 +2841,13 @@ static void dispatch_poll_events(mrp_mainloop_t *ml)
     if (ml->quit)
         return;
 
+    if (ml->uring != NULL) {
+        mrp_uring_dispatch(ml->uring);
+
+        if (ml->quit)
+            return;
+    }
+
     dispatch_subloops(ml);
 
     mrp_debug("done dispatching poll events");
@@ -2198,6 +2876,8 @@ int mrp_mainloop_dispatch(mrp_mainloop_t *ml)
  quit:
     purge_deleted(ml);
 
+    STATS_DISPATCHED(ml);
+
     return !ml->quit;
 }
 
@@ -2228,6 +2908,286 @@ void mrp_mainloop_quit(mrp_mainloop_t *ml, int exit_code)
 }
 
 
+/*
+ * mainloop statistics
+ */
+
+#ifdef MAINLOOP_STATS_ENABLED
+
+static void stats_init(mrp_mainloop_t *ml)
+{
+    const char    *env = getenv("__MURPHY_MAINLOOP_STATS");
+    char          *end;
+    unsigned long  usecs;
+
+    ml->slow = (uint64_t)STATS_SLOW_DEFAULT * NSECS_PER_USEC;
+
+    if (env == NULL)
+        return;
+
+    usecs = strtoul(env, &end, 10);
+
+    if (*env && !*end)
+        ml->slow = (uint64_t)usecs * NSECS_PER_USEC;
+
+    mrp_mainloop_enable_stats(ml, TRUE);
+}
+
+
+int mrp_mainloop_enable_stats(mrp_mainloop_t *ml, int enable)
+{
+    if (enable) {
+        if (ml->stats == NULL) {
+            mrp_mainloop_reset_stats(ml);
+            ml->stats = mrp_allocz(sizeof(*ml->stats));
+
+            if (ml->stats == NULL)
+                return FALSE;
+        }
+    }
+    else {
+        mrp_free(ml->stats);
+        ml->stats = NULL;
+    }
+
+    return TRUE;
+}
+
+
+int mrp_mainloop_stats_enabled(mrp_mainloop_t *ml)
+{
+    return ml->stats != NULL;
+}
+
+
+int mrp_mainloop_set_slow_threshold(mrp_mainloop_t *ml, unsigned int usecs)
+{
+    ml->slow = (uint64_t)usecs * NSECS_PER_USEC;
+
+    return TRUE;
+}
+
+
+void mrp_mainloop_reset_stats(mrp_mainloop_t *ml)
+{
+    mrp_list_hook_t *p, *n, *sp, *sn;
+    mrp_io_watch_t  *w, *s;
+    mrp_timer_t     *t;
+    mrp_deferred_t  *d;
+    mrp_wakeup_t    *wu;
+    mrp_subloop_t   *sl;
+
+    if (ml->stats != NULL)
+        memset(ml->stats, 0, sizeof(*ml->stats));
+
+    mrp_list_foreach(&ml->iowatches, p, n) {
+        w = mrp_list_entry(p, typeof(*w), hook);
+        memset(&w->stat, 0, sizeof(w->stat));
+
+        mrp_list_foreach(&w->slave, sp, sn) {
+            s = mrp_list_entry(sp, typeof(*s), slave);
+            memset(&s->stat, 0, sizeof(s->stat));
+        }
+    }
+
+    mrp_list_foreach(&ml->timers, p, n) {
+        t = mrp_list_entry(p, typeof(*t), hook);
+        memset(&t->stat, 0, sizeof(t->stat));
+    }
+
+    mrp_list_foreach(&ml->deferred, p, n) {
+        d = mrp_list_entry(p, typeof(*d), hook);
+        memset(&d->stat, 0, sizeof(d->stat));
+    }
+
+    mrp_list_foreach(&ml->inactive_deferred, p, n) {
+        d = mrp_list_entry(p, typeof(*d), hook);
+        memset(&d->stat, 0, sizeof(d->stat));
+    }
+
+    mrp_list_foreach(&ml->wakeups, p, n) {
+        wu = mrp_list_entry(p, typeof(*wu), hook);
+        memset(&wu->stat, 0, sizeof(wu->stat));
+    }
+
+    mrp_list_foreach(&ml->subloops, p, n) {
+        sl = mrp_list_entry(p, typeof(*sl), hook);
+        memset(&sl->stat, 0, sizeof(sl->stat));
+    }
+}
+
+
+static void dump_histogram(FILE *fp, const char *name, histogram_t *h)
+{
+    unsigned long long lo, hi;
+    int                b;
+
+    fprintf(fp, "%s: %llu samples", name, (unsigned long long)h->nsample);
+
+    if (h->nsample == 0) {
+        fprintf(fp, "\n");
+        return;
+    }
+
+    fprintf(fp, ", avg %.3f msecs, max %.3f msecs\n",
+            h->total / 1000000.0 / h->nsample, h->max / 1000000.0);
+
+    for (b = 0; b < STATS_NBUCKET; b++) {
+        if (h->count[b] == 0)
+            continue;
+
+        lo = b ? 1ULL << (b - 1) : 0;
+        hi = 1ULL << b;
+
+        if (b < STATS_NBUCKET - 1)
+            fprintf(fp, "    %8llu - %8llu usecs: %llu\n", lo, hi,
+                    (unsigned long long)h->count[b]);
+        else
+            fprintf(fp, "    %8llu -          usecs: %llu\n", lo,
+                    (unsigned long long)h->count[b]);
+    }
+}
+
+
+static void dump_cbstat(FILE *fp, const char *type, void *obj, void *cb,
+                        cbstat_t *cs)
+{
+    char name[256];
+
+    if (cs->ncall == 0)
+        return;
+
+    fprintf(fp, "    %s %p (%s): %llu calls, total %.3f msecs, "
+            "avg %.3f usecs, max %.3f usecs\n", type, obj,
+            callback_name(cb, name, sizeof(name)),
+            (unsigned long long)cs->ncall, cs->total / 1000000.0,
+            cs->total / 1000.0 / cs->ncall, cs->max / 1000.0);
+}
+
+
+void mrp_mainloop_dump_stats(mrp_mainloop_t *ml, FILE *fp)
+{
+    mlstats_t       *st = ml->stats;
+    mrp_list_hook_t *p, *n, *sp, *sn;
+    mrp_io_watch_t  *w, *s;
+    mrp_timer_t     *t;
+    mrp_deferred_t  *d;
+    mrp_wakeup_t    *wu;
+    mrp_subloop_t   *sl;
+
+    if (st == NULL) {
+        fprintf(fp, "Mainloop statistics are disabled.\n");
+        return;
+    }
+
+    fprintf(fp, "Mainloop statistics:\n");
+    fprintf(fp, "  iterations: %llu\n", (unsigned long long)st->niter);
+    fprintf(fp, "  slow callback threshold: %.3f msecs, slow callbacks: %llu\n",
+            ml->slow / 1000000.0, (unsigned long long)st->nslow);
+
+    dump_histogram(fp, "  iteration lag", &st->lag);
+    dump_histogram(fp, "  timer lateness", &st->late);
+
+    fprintf(fp, "  callbacks:\n");
+
+    mrp_list_foreach(&ml->iowatches, p, n) {
+        w = mrp_list_entry(p, typeof(*w), hook);
+
+        if (!is_deleted(w))
+            dump_cbstat(fp, "I/O watch", w, w->cb, &w->stat);
+
+        mrp_list_foreach(&w->slave, sp, sn) {
+            s = mrp_list_entry(sp, typeof(*s), slave);
+
+            if (!is_deleted(s))
+                dump_cbstat(fp, "I/O watch", s, s->cb, &s->stat);
+        }
+    }
+
+    mrp_list_foreach(&ml->timers, p, n) {
+        t = mrp_list_entry(p, typeof(*t), hook);
+
+        if (!is_deleted(t))
+            dump_cbstat(fp, "timer", t, t->cb, &t->stat);
+    }
+
+    mrp_list_foreach(&ml->deferred, p, n) {
+        d = mrp_list_entry(p, typeof(*d), hook);
+
+        if (!is_deleted(d))
+            dump_cbstat(fp, "deferred", d, d->cb, &d->stat);
+    }
+
+    mrp_list_foreach(&ml->inactive_deferred, p, n) {
+        d = mrp_list_entry(p, typeof(*d), hook);
+
+        if (!is_deleted(d))
+            dump_cbstat(fp, "deferred", d, d->cb, &d->stat);
+    }
+
+    mrp_list_foreach(&ml->wakeups, p, n) {
+        wu = mrp_list_entry(p, typeof(*wu), hook);
+
+        if (!is_deleted(wu))
+            dump_cbstat(fp, "wakeup", wu, wu->cb, &wu->stat);
+    }
+
+    mrp_list_foreach(&ml->subloops, p, n) {
+        sl = mrp_list_entry(p, typeof(*sl), hook);
+
+        if (!is_deleted(sl))
+            dump_cbstat(fp, "subloop", sl, sl->cb->dispatch, &sl->stat);
+    }
+}
+
+#else /* !MAINLOOP_STATS_ENABLED */
+
+int mrp_mainloop_enable_stats(mrp_mainloop_t *ml, int enable)
+{
+    MRP_UNUSED(ml);
+
+    if (!enable)
+        return TRUE;
+
+    errno = EOPNOTSUPP;
+    return FALSE;
+}
+
+
+int mrp_mainloop_stats_enabled(mrp_mainloop_t *ml)
+{
+    MRP_UNUSED(ml);
+
+    return FALSE;
+}
+
+
+int mrp_mainloop_set_slow_threshold(mrp_mainloop_t *ml, unsigned int usecs)
+{
+    MRP_UNUSED(ml);
+    MRP_UNUSED(usecs);
+
+    errno = EOPNOTSUPP;
+    return FALSE;
+}
+
+
+void mrp_mainloop_reset_stats(mrp_mainloop_t *ml)
+{
+    MRP_UNUSED(ml);
+}
+
+
+void mrp_mainloop_dump_stats(mrp_mainloop_t *ml, FILE *fp)
+{
+    MRP_UNUSED(ml);
+
+    fprintf(fp, "Mainloop statistics support is not compiled in.\n");
+}
+
+#endif /* !MAINLOOP_STATS_ENABLED */
+
+
 /*
  * debugging routines
  */
@@ -2487,7 +3447,7 @@ static int queue_event(mrp_event_bus_t *bus, uint32_t id, void *data,
 {
     pending_event_t *e;
 
-    e = mrp_allocz(sizeof(*e));
+    e = mrp_allocz_pooled(pending_event_t);
 
     if (e == NULL)
         return -1;
@@ -2564,7 +3524,7 @@ static void pump_events(mrp_deferred_t *d, void *user_data)
         mrp_list_delete(&e->hook);
         unref_event_data(e->data, e->format);
 
-        mrp_free(e);
+        mrp_free_pooled(e);
     }
 
     if (!mrp_list_empty(&ml->eventq))
@@ -30,6 +30,7 @@
 #ifndef __MURPHY_MAINLOOP_H__
 #define __MURPHY_MAINLOOP_H__
 
+#include <stdio.h>
 #include <signal.h>
 #include <stdint.h>
 #include <sys/poll.h>
@@ -258,6 +259,12 @@ mrp_io_event_t mrp_get_io_event_mode(mrp_mainloop_t *ml);
  *
  * Timers can be dynamically stopped and restarted and the timer interval can
  * be dynamically changed. The timer interval resolution is 1 millisecond.
+ *
+ * High-resolution timers, created with @mrp_add_timer_ns, have an interval
+ * resolution of 1 nanosecond and are woken up by a timerfd instead of the
+ * (millisecond) poll timeout. They are rescheduled relative to their
+ * previous expiration instead of the time their callback got called, so
+ * periodic high-resolution timers do not drift.
  */
 
 /**
@@ -309,6 +316,58 @@ void mrp_mod_timer(mrp_timer_t *t, unsigned int msecs);
  */
 #define MRP_TIMER_RESTART (unsigned int)-1
 
+/**
+ * @brief Create a new high-resolution Murphy timer.
+ *
+ * Create a new timer with nanosecond resolution for the given mainloop.
+ * The timer is rescheduled relative to its previous expiration, so it
+ * does not drift. If the mainloop falls behind by more than an interval,
+ * the missed expirations are skipped instead of being triggered in a
+ * burst. A non-zero @slack allows the timer to be triggered that much
+ * later, so that it can be coalesced with other nearby timers into a
+ * single wakeup.
+ *
+ * @param [in] ml         mainloop to add the timer to
+ * @param [in] nsecs      timer interval in nanoseconds
+ * @param [in] slack      maximum allowed delay in nanoseconds, or 0
+ * @param [in] cb         callback to trigger
+ * @param [in] user_data  opaque user data to pass to @cb
+ *
+ * @return Returns the newly created timer, or @NULL upon failure.
+ */
+mrp_timer_t *mrp_add_timer_ns(mrp_mainloop_t *ml, uint64_t nsecs,
+                              uint64_t slack, mrp_timer_cb_t cb,
+                              void *user_data);
+
+/**
+ * @brief Modify the interval of the given timer in nanoseconds.
+ *
+ * Update the given timer to be triggered at the new given interval,
+ * counting from now. Use @MRP_TIMER_RESTART_NS for @nsecs to simply
+ * restart the timer without changing its interval.
+ *
+ * @param [in] t      timer to modify
+ * @param [in] nsecs  new interval in nanoseconds
+ */
+void mrp_mod_timer_ns(mrp_timer_t *t, uint64_t nsecs);
+
+/**
+ * @brief Macro to pass to @mrp_mod_timer_ns to simply restart a timer.
+ */
+#define MRP_TIMER_RESTART_NS ((uint64_t)-1)
+
+/**
+ * @brief Set the slack of the given timer.
+ *
+ * Allow the given timer to be triggered up to @slack nanoseconds late
+ * to coalesce it with other timers. This works for all timers, not only
+ * for high-resolution ones.
+ *
+ * @param [in] t      timer to modify
+ * @param [in] slack  maximum allowed delay in nanoseconds, or 0
+ */
+void mrp_set_timer_slack(mrp_timer_t *t, uint64_t slack);
+
 /**
  * @brief Delete the given timer.
  *
@@ -339,6 +398,9 @@ mrp_mainloop_t *mrp_get_timer_mainloop(mrp_timer_t *t);
 #define mrp_timer_add mrp_add_timer
 #define mrp_timer_del mrp_del_timer
 #define mrp_timer_mod mrp_mod_timer
+#define mrp_timer_add_ns mrp_add_timer_ns
+#define mrp_timer_mod_ns mrp_mod_timer_ns
+#define mrp_timer_set_slack mrp_set_timer_slack
 #define mrp_timer_get_mainloop mrp_get_timer_mainloop
 
 
@@ -772,7 +834,11 @@ typedef struct {
      *     to retrieve pending epoll events from the glue code. The glue code
      *     needs to take care of any necessary locking to protect itself/us
      *     from potentially concurrent invocations of poll_io and poll_events
-     *     from different threads.
+     *     from different threads. The event buffer returned by poll_events
+     *     is allocated for each invocation and is owned by the glue code,
+     *     which needs to free it with mrp_free once it is done with it.
+     *     Glue code that can live with a buffer owned by the mainloop can
+     *     use mrp_superloop_poll_events instead to avoid the allocation.
      *
      *     The superloop abstraction now became really really ugly. poll_io
      *     and poll_events implicitly assume/know that add_io/del_io is only
@@ -819,6 +885,22 @@ int mrp_clear_superloop(mrp_mainloop_t *ml);
  */
 int mrp_mainloop_unregister(mrp_mainloop_t *ml);
 
+/**
+ * @brief Poll pending events for superloop glue into a reused buffer.
+ *
+ * This is an allocation-free alternative to the poll_events superloop
+ * operation. Unlike there, the returned event buffer is owned by @ml
+ * and is reused by the next call, so the caller must not free it and
+ * must be done with it before calling this function again.
+ *
+ * @param [in]  ml      the mainloop pumped by the superloop
+ * @param [in]  id      the superloop I/O watch of the mainloop
+ * @param [out] events  pointer to the event buffer
+ *
+ * @return Returns the size of the pending events in @events in bytes.
+ */
+size_t mrp_superloop_poll_events(mrp_mainloop_t *ml, void *id, void **events);
+
 /**
  * @brief Convenience macros to fix naming convention.
  *
@@ -838,15 +920,49 @@ int mrp_mainloop_unregister(mrp_mainloop_t *ml);
  * are inhrently operating within the context of a mainloop.
  */
 
+/**
+ * @brief Mainloop polling backends.
+ */
+typedef enum {
+    MRP_MAINLOOP_BACKEND_DEFAULT = 0,    /**< default, see below */
+    MRP_MAINLOOP_BACKEND_EPOLL,          /**< epoll-based polling */
+    MRP_MAINLOOP_BACKEND_IO_URING,       /**< io_uring-based polling and I/O */
+} mrp_mainloop_backend_t;
+
 /**
  * @brief Create a new mainloop.
  *
- * Creates and initializes a new Murphy mainloop.
+ * Creates and initializes a new Murphy mainloop with the default backend.
  *
  * @return Return the new mainloop, or @NULL upon failure.
  */
 mrp_mainloop_t *mrp_mainloop_create(void);
 
+/**
+ * @brief Create a new mainloop with the given backend.
+ *
+ * Creates and initializes a new Murphy mainloop using the given polling
+ * backend. The default backend is epoll, unless overridden by setting
+ * the environment variable __MURPHY_MAINLOOP_BACKEND to io_uring. With
+ * the io_uring backend stream transports also accept, receive and send
+ * using the ring. If io_uring is not available, the mainloop falls back
+ * to epoll.
+ *
+ * @param [in] backend  backend to use
+ *
+ * @return Return the new mainloop, or @NULL upon failure.
+ */
+mrp_mainloop_t *mrp_mainloop_create_backend(mrp_mainloop_backend_t backend);
+
+/**
+ * @brief Get the backend used by a mainloop.
+ *
+ * @param [in] ml  mainloop to check
+ *
+ * @return Returns the backend actually in use by @ml.
+ */
+mrp_mainloop_backend_t mrp_mainloop_get_backend(mrp_mainloop_t *ml);
+
 /**
  * @brief Destroy an existing mainloop.
  *
@@ -925,6 +1041,60 @@ int mrp_mainloop_iterate(mrp_mainloop_t *ml);
  */
 void mrp_mainloop_quit(mrp_mainloop_t *ml, int exit_code);
 
+/**
+ * @brief Enable or disable collecting mainloop statistics.
+ *
+ * Enable or disable collecting per-callback call counts and durations,
+ * iteration lag and timer lateness histograms for the given mainloop.
+ * Statistics support needs to be compiled in (--enable-mainloop-stats).
+ * Setting the environment variable __MURPHY_MAINLOOP_STATS enables
+ * statistics for all newly created mainloops. If its value is a number,
+ * it is also used as the slow callback threshold in microseconds.
+ *
+ * @param [in] ml      mainloop to enable or disable statistics for
+ * @param [in] enable  whether to enable or disable statistics
+ *
+ * @return Returns @TRUE on success, @FALSE otherwise.
+ */
+int mrp_mainloop_enable_stats(mrp_mainloop_t *ml, int enable);
+
+/**
+ * @brief Check if collecting mainloop statistics is enabled.
+ *
+ * @param [in] ml  mainloop to check
+ *
+ * @return Returns @TRUE if statistics are being collected for @ml.
+ */
+int mrp_mainloop_stats_enabled(mrp_mainloop_t *ml);
+
+/**
+ * @brief Set the slow callback threshold of a mainloop.
+ *
+ * While statistics are enabled, any callback running longer than the
+ * given threshold is logged as a warning together with its symbol.
+ *
+ * @param [in] ml     mainloop to set the threshold for
+ * @param [in] usecs  threshold in microseconds, 0 to disable logging
+ *
+ * @return Returns @TRUE on success, @FALSE otherwise.
+ */
+int mrp_mainloop_set_slow_threshold(mrp_mainloop_t *ml, unsigned int usecs);
+
+/**
+ * @brief Reset all collected mainloop statistics.
+ *
+ * @param [in] ml  mainloop to reset statistics for
+ */
+void mrp_mainloop_reset_stats(mrp_mainloop_t *ml);
+
+/**
+ * @brief Dump collected mainloop statistics.
+ *
+ * @param [in] ml  mainloop to dump statistics for
+ * @param [in] fp  stream to dump statistics to
+ */
+void mrp_mainloop_dump_stats(mrp_mainloop_t *ml, FILE *fp);
+
 
 /**
  * @brief Murphy event bus and events.
@@ -0,0 +1,598 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <execinfo.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/log.h>
+#include <murphy/common/mm.h>
+
+#include "mm-profile.h"
+
+/*
+ * sampling heap profiler
+ *
+ * Instead of recording every allocation we take a sample on average once
+ * every mm_prof_rate bytes allocated. The distance between two samples is
+ * drawn from an exponential distribution, which turns sampling into a
+ * Poisson process over the allocated bytes. The probability of a block of
+ * size S getting sampled is then 1 - exp(-S / rate), and the real number
+ * of blocks and bytes can be estimated by scaling the sampled ones with the
+ * inverse of this. This is the same model used by gperftools, so pprof can
+ * read and scale our profiles directly.
+ *
+ * For every sample we record the call stack of the allocation, and keep
+ * live and cumulative statistics per distinct call stack (site). Sampled
+ * blocks are kept in a hash table so their statistics can be updated when
+ * they are freed. To avoid looking up every freed block in this table, we
+ * keep a small counting filter of sampled addresses and only do the lookup
+ * if the filter says the block might have been sampled. The free path only
+ * looks at a bitmap of the non-zero counters, which fits in a few cache
+ * lines.
+ *
+ * Bookkeeping memory is allocated directly from libc, so the profiler
+ * never profiles itself.
+ */
+
+#define DEFAULT_RATE   (512 * 1024)             /* default sampling rate */
+#define MAX_DEPTH      32                       /* max. stack depth */
+#define NSITE_BUCKET   1024                     /* site hash buckets */
+#define NBLOCK_BUCKET  4096                     /* block hash buckets */
+
+typedef struct site_s site_t;
+typedef struct block_s block_t;
+
+struct site_s {
+    site_t   *next;                             /* next in hash chain */
+    uint32_t  hash;                             /* hash of call stack */
+    int       depth;                            /* call stack depth */
+    uint64_t  live_cnt;                         /* live sampled blocks */
+    uint64_t  live_bytes;                       /* live sampled bytes */
+    uint64_t  alloc_cnt;                        /* all sampled blocks */
+    uint64_t  alloc_bytes;                      /* all sampled bytes */
+    void     *bt[];                             /* call stack */
+};
+
+struct block_s {
+    block_t *next;                              /* next in hash chain */
+    void    *ptr;                               /* sampled block */
+    size_t   size;                              /* requested size */
+    site_t  *site;                              /* allocating site */
+};
+
+typedef struct {
+    site_t   *site;                             /* site */
+    uint64_t  live_cnt;                         /* snapshot of counters */
+    uint64_t  live_bytes;
+    uint64_t  alloc_cnt;
+    uint64_t  alloc_bytes;
+} snapshot_t;
+
+static struct {
+    pthread_mutex_t  lock;                      /* protects everything */
+    size_t           rate;                      /* last sampling rate */
+    site_t          *sites[NSITE_BUCKET];       /* call sites */
+    int              nsite;                     /* number of sites */
+    block_t         *blocks[NBLOCK_BUCKET];     /* live sampled blocks */
+    uint8_t          count[MM_PROF_FILTER_SIZE];/* sampled address filter */
+} prof = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+size_t             mm_prof_rate;
+uint32_t           mm_prof_nlive;
+int                mm_prof_disabled;
+uint8_t            mm_prof_filter[MM_PROF_FILTER_SIZE / 8];
+__thread ptrdiff_t mm_prof_left __attribute__((tls_model("initial-exec")));
+
+static __thread uint64_t prof_seed;
+
+
+static inline uint32_t stack_hash(void **bt, int depth)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    int      i;
+
+    for (i = 0; i < depth; i++)
+        h = (h ^ (uintptr_t)bt[i]) * 0x100000001b3ULL;
+
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+
+static inline void filter_add(uint32_t bit)
+{
+    if (prof.count[bit] < UINT8_MAX && prof.count[bit]++ == 0)
+        mm_prof_filter[bit / 8] |= 1 << (bit % 8);
+}
+
+
+static inline void filter_del(uint32_t bit)
+{
+    /* saturated counters stick, we don't know how many more there are */
+    if (prof.count[bit] < UINT8_MAX && --prof.count[bit] == 0)
+        mm_prof_filter[bit / 8] &= ~(1 << (bit % 8));
+}
+
+
+static ptrdiff_t next_interval(size_t rate)
+{
+    uint64_t x;
+    double   u;
+
+    if (MRP_UNLIKELY(prof_seed == 0))
+        prof_seed = ((uintptr_t)&prof_seed ^ (uint64_t)time(NULL) << 20) | 1;
+
+    x  = prof_seed;                             /* xorshift64* */
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    prof_seed = x;
+    x *= 0x2545f4914f6cdd1dULL;
+
+    u = ((x >> 11) + 1) * (1.0 / 9007199254740992.0);
+
+    return (ptrdiff_t)(-log(u) * rate) + 1;
+}
+
+
+static site_t *get_site(void **bt, int depth)
+{
+    uint32_t  hash = stack_hash(bt, depth);
+    site_t   *s;
+
+    for (s = prof.sites[hash % NSITE_BUCKET]; s != NULL; s = s->next)
+        if (s->hash == hash && s->depth == depth &&
+            !memcmp(s->bt, bt, depth * sizeof(bt[0])))
+            return s;
+
+    if ((s = calloc(1, sizeof(*s) + depth * sizeof(bt[0]))) == NULL)
+        return NULL;
+
+    s->hash  = hash;
+    s->depth = depth;
+    memcpy(s->bt, bt, depth * sizeof(bt[0]));
+
+    s->next = prof.sites[hash % NSITE_BUCKET];
+    prof.sites[hash % NSITE_BUCKET] = s;
+    prof.nsite++;
+
+    return s;
+}
+
+
+void mm_prof_sample(void *ptr, size_t size, void *caller)
+{
+    static __thread int  ready;
+    void                *bt[MAX_DEPTH + 8];
+    size_t               rate = mm_prof_rate;
+    uint32_t             h;
+    block_t             *b;
+    site_t              *s;
+    int                  n, skip;
+
+    if (rate == 0) {
+        mm_prof_left = MM_PROF_IDLE_BYTES;
+        return;
+    }
+
+    mm_prof_left = next_interval(rate);
+
+    if (ptr == NULL)
+        return;
+
+    /* don't sample the first allocation a thread makes while profiling */
+    if (MRP_UNLIKELY(!ready)) {
+        ready = TRUE;
+        return;
+    }
+
+    n = backtrace(bt, (int)MRP_ARRAY_SIZE(bt));
+
+    for (skip = 1; skip < n && bt[skip] != caller; skip++)
+        ;
+
+    if (skip >= n)
+        skip = n > 1 ? 1 : 0;
+
+    if (n - skip > MAX_DEPTH)
+        n = skip + MAX_DEPTH;
+
+    if ((b = malloc(sizeof(*b))) == NULL)
+        return;
+
+    pthread_mutex_lock(&prof.lock);
+
+    if ((s = get_site(bt + skip, n - skip)) == NULL) {
+        pthread_mutex_unlock(&prof.lock);
+        free(b);
+        return;
+    }
+
+    h = mm_prof_hash(ptr);
+
+    b->ptr  = ptr;
+    b->size = size;
+    b->site = s;
+    b->next = prof.blocks[h % NBLOCK_BUCKET];
+    prof.blocks[h % NBLOCK_BUCKET] = b;
+
+    filter_add(h % MM_PROF_FILTER_SIZE);
+
+    s->live_cnt++;
+    s->live_bytes += size;
+    s->alloc_cnt++;
+    s->alloc_bytes += size;
+
+    prof.rate = rate;
+    mm_prof_nlive++;
+
+    pthread_mutex_unlock(&prof.lock);
+}
+
+
+void mm_prof_forget(void *ptr)
+{
+    uint32_t   h = mm_prof_hash(ptr);
+    block_t  **bp, *b;
+
+    if (prof.count[h % MM_PROF_FILTER_SIZE] == 0)
+        return;
+
+    pthread_mutex_lock(&prof.lock);
+
+    for (bp = prof.blocks + h % NBLOCK_BUCKET; (b = *bp) != NULL; bp = &b->next) {
+        if (b->ptr == ptr) {
+            *bp = b->next;
+
+            b->site->live_cnt--;
+            b->site->live_bytes -= b->size;
+
+            filter_del(h % MM_PROF_FILTER_SIZE);
+
+            mm_prof_nlive--;
+            free(b);
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&prof.lock);
+}
+
+
+int mrp_mm_profile_start(size_t rate)
+{
+    if (mm_prof_disabled) {
+        errno = EOPNOTSUPP;
+        return FALSE;
+    }
+
+    mm_prof_rate = rate ? rate : DEFAULT_RATE;
+
+    mrp_log_info("Heap profiling enabled, sampling every %zu bytes.",
+                 mm_prof_rate);
+
+    return TRUE;
+}
+
+
+void mrp_mm_profile_stop(void)
+{
+    if (mm_prof_rate != 0) {
+        mm_prof_rate = 0;
+        mrp_log_info("Heap profiling disabled.");
+    }
+}
+
+
+size_t mrp_mm_profile_rate(void)
+{
+    return mm_prof_rate;
+}
+
+
+void mrp_mm_profile_reset(void)
+{
+    site_t *s;
+    int     i;
+
+    pthread_mutex_lock(&prof.lock);
+
+    for (i = 0; i < NSITE_BUCKET; i++) {
+        for (s = prof.sites[i]; s != NULL; s = s->next) {
+            s->alloc_cnt   = s->live_cnt;
+            s->alloc_bytes = s->live_bytes;
+        }
+    }
+
+    pthread_mutex_unlock(&prof.lock);
+}
+
+
+static int snapshot_cmp(const void *p1, const void *p2)
+{
+    const snapshot_t *s1 = p1, *s2 = p2;
+
+    if (s1->live_bytes != s2->live_bytes)
+        return s1->live_bytes < s2->live_bytes ? 1 : -1;
+    else
+        return s1->alloc_bytes < s2->alloc_bytes ? 1 :
+            (s1->alloc_bytes > s2->alloc_bytes ? -1 : 0);
+}
+
+
+/*
+ * Take a sorted snapshot of the site statistics. We never format output
+ * with the lock held: writing to a console stream might allocate memory
+ * and try to take a sample.
+ */
+
+static snapshot_t *take_snapshot(int *nsnapshot, size_t *ratep)
+{
+    snapshot_t *snap;
+    site_t     *s;
+    int         i, n;
+
+    pthread_mutex_lock(&prof.lock);
+
+    n    = 0;
+    snap = malloc((prof.nsite ? prof.nsite : 1) * sizeof(*snap));
+
+    if (snap != NULL) {
+        for (i = 0; i < NSITE_BUCKET; i++) {
+            for (s = prof.sites[i]; s != NULL; s = s->next) {
+                if (!s->live_cnt && !s->alloc_cnt)
+                    continue;
+
+                snap[n].site        = s;
+                snap[n].live_cnt    = s->live_cnt;
+                snap[n].live_bytes  = s->live_bytes;
+                snap[n].alloc_cnt   = s->alloc_cnt;
+                snap[n].alloc_bytes = s->alloc_bytes;
+                n++;
+            }
+        }
+    }
+
+    *ratep = prof.rate ? prof.rate : DEFAULT_RATE;
+
+    pthread_mutex_unlock(&prof.lock);
+
+    if (snap != NULL)
+        qsort(snap, n, sizeof(*snap), snapshot_cmp);
+
+    *nsnapshot = n;
+    return snap;
+}
+
+
+static double scale(uint64_t cnt, uint64_t bytes, size_t rate)
+{
+    double avg;
+
+    if (cnt == 0)
+        return 0.0;
+
+    avg = (double)bytes / cnt;
+
+    return 1.0 / (1.0 - exp(-avg / rate));
+}
+
+
+/*
+ * Strip a backtrace_symbols entry of the form module(function+off) [addr]
+ * to function, or to module+off if the function is not known.
+ */
+
+static const char *frame_name(const char *sym, char *buf, size_t size)
+{
+    const char *b, *p, *e, *m;
+    int         n;
+
+    if ((b = strchr(sym, '(')) == NULL || (e = strchr(b, ')')) == NULL)
+        return sym;
+
+    if ((p = strchr(b, '+')) == NULL || p > e)
+        p = e;
+
+    if (p > b + 1)
+        n = snprintf(buf, size, "%.*s", (int)(p - b - 1), b + 1);
+    else {
+        for (m = b; m > sym && m[-1] != '/'; m--)
+            ;
+        n = snprintf(buf, size, "%.*s%.*s", (int)(b - m), m,
+                     (int)(e - p), p);
+    }
+
+    if (n < 0 || n >= (int)size)
+        return sym;
+
+    return buf;
+}
+
+
+static int dump_pprof(FILE *fp, snapshot_t *snap, int n, size_t rate)
+{
+    uint64_t  lc, lb, ac, ab;
+    FILE     *maps;
+    char      line[512];
+    int       i, j;
+
+    lc = lb = ac = ab = 0;
+    for (i = 0; i < n; i++) {
+        lc += snap[i].live_cnt;
+        lb += snap[i].live_bytes;
+        ac += snap[i].alloc_cnt;
+        ab += snap[i].alloc_bytes;
+    }
+
+    fprintf(fp, "heap profile: %llu: %llu [%llu: %llu] @ heap_v2/%zu\n",
+            (unsigned long long)lc, (unsigned long long)lb,
+            (unsigned long long)ac, (unsigned long long)ab, rate);
+
+    for (i = 0; i < n; i++) {
+        fprintf(fp, "%llu: %llu [%llu: %llu] @",
+                (unsigned long long)snap[i].live_cnt,
+                (unsigned long long)snap[i].live_bytes,
+                (unsigned long long)snap[i].alloc_cnt,
+                (unsigned long long)snap[i].alloc_bytes);
+
+        for (j = 0; j < snap[i].site->depth; j++)
+            fprintf(fp, " %p", snap[i].site->bt[j]);
+
+        fprintf(fp, "\n");
+    }
+
+    fprintf(fp, "\nMAPPED_LIBRARIES:\n");
+
+    if ((maps = fopen("/proc/self/maps", "r")) != NULL) {
+        while (fgets(line, sizeof(line), maps) != NULL)
+            fputs(line, fp);
+        fclose(maps);
+    }
+
+    return TRUE;
+}
+
+
+static int dump_folded(FILE *fp, snapshot_t *snap, int n, size_t rate)
+{
+    site_t  *s;
+    char   **syms, buf[256];
+    double   bytes;
+    int      i, j;
+
+    for (i = 0; i < n; i++) {
+        if (snap[i].live_cnt == 0)
+            continue;
+
+        s     = snap[i].site;
+        bytes = snap[i].live_bytes *
+            scale(snap[i].live_cnt, snap[i].live_bytes, rate);
+
+        if ((syms = backtrace_symbols(s->bt, s->depth)) == NULL)
+            return FALSE;
+
+        for (j = s->depth - 1; j >= 0; j--)
+            fprintf(fp, "%s%s", frame_name(syms[j], buf, sizeof(buf)),
+                    j ? ";" : "");
+
+        fprintf(fp, " %.0f\n", bytes);
+
+        free(syms);
+    }
+
+    return TRUE;
+}
+
+
+int mrp_mm_profile_dump(FILE *fp, mrp_mm_profile_format_t format)
+{
+    snapshot_t *snap;
+    size_t      rate;
+    int         n, success;
+
+    if ((snap = take_snapshot(&n, &rate)) == NULL)
+        return FALSE;
+
+    switch (format) {
+    case MRP_MM_PROFILE_PPROF:
+        success = dump_pprof(fp, snap, n, rate);
+        break;
+    case MRP_MM_PROFILE_FOLDED:
+        success = dump_folded(fp, snap, n, rate);
+        break;
+    default:
+        errno   = EINVAL;
+        success = FALSE;
+    }
+
+    free(snap);
+
+    return success;
+}
+
+
+void mrp_mm_profile_summary(FILE *fp, int nsite)
+{
+    snapshot_t  *snap;
+    size_t       rate;
+    double       lb, lc, ab, ls, as;
+    double       tlb, tab;
+    char       **syms, buf[256];
+    int          i, j, n;
+
+    if ((snap = take_snapshot(&n, &rate)) == NULL) {
+        fprintf(fp, "Failed to collect heap profile.\n");
+        return;
+    }
+
+    tlb = tab = 0;
+    for (i = 0; i < n; i++) {
+        tlb += snap[i].live_bytes *
+            scale(snap[i].live_cnt, snap[i].live_bytes, rate);
+        tab += snap[i].alloc_bytes *
+            scale(snap[i].alloc_cnt, snap[i].alloc_bytes, rate);
+    }
+
+    fprintf(fp, "Heap profile (%s, sampling every %zu bytes, %d sites):\n",
+            mm_prof_rate ? "running" : "stopped", rate, n);
+    fprintf(fp, "  estimated live: %.0f bytes, allocated: %.0f bytes\n",
+            tlb, tab);
+
+    for (i = 0; i < n && i < nsite; i++) {
+        ls = scale(snap[i].live_cnt, snap[i].live_bytes, rate);
+        as = scale(snap[i].alloc_cnt, snap[i].alloc_bytes, rate);
+        lb = snap[i].live_bytes * ls;
+        lc = snap[i].live_cnt * ls;
+        ab = snap[i].alloc_bytes * as;
+
+        fprintf(fp, "  #%d: %.0f bytes live (%.1f%%) in %.0f blocks, "
+                "%.0f bytes allocated\n", i + 1, lb,
+                tlb ? 100.0 * lb / tlb : 0.0, lc, ab);
+
+        syms = backtrace_symbols(snap[i].site->bt, snap[i].site->depth);
+
+        for (j = 0; j < snap[i].site->depth && j < 4; j++)
+            fprintf(fp, "      %s\n", syms ?
+                    frame_name(syms[j], buf, sizeof(buf)) : "???");
+
+        free(syms);
+    }
+
+    free(snap);
+}
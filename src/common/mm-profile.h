@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MURPHY_MM_PROFILE_H__
+#define __MURPHY_MM_PROFILE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <murphy/common/macros.h>
+
+MRP_CDECL_BEGIN
+
+/*
+ * Sampling heap profiler hooks.
+ *
+ * These are called by the passthru and slab allocators for every
+ * allocation and free. Allocations only decrement a per-thread byte
+ * counter until it runs out, whether profiling is on or not. While it
+ * is off the counter is reloaded with MM_PROF_IDLE_BYTES, so a thread
+ * notices profiling getting turned on soon enough. Frees only check a
+ * single bit of a small filter of sampled addresses, and only while
+ * there are any, until the filter hits. The allocator passes its own
+ * return address as @caller, so the recorded call stacks can start at
+ * the code requesting the memory.
+ *
+ * This header is internal to the memory management code.
+ */
+
+#define MM_PROF_FILTER_SIZE 8192                        /* filter bits */
+#define MM_PROF_IDLE_BYTES  (64 * 1024)                 /* check when off */
+
+extern size_t             mm_prof_rate MRP_HIDDEN;      /* bytes per sample */
+extern uint32_t           mm_prof_nlive MRP_HIDDEN;     /* live samples */
+extern int                mm_prof_disabled MRP_HIDDEN;  /* debug allocator */
+extern uint8_t            mm_prof_filter[MM_PROF_FILTER_SIZE / 8] MRP_HIDDEN;
+extern __thread ptrdiff_t mm_prof_left MRP_HIDDEN       /* till next sample */
+    __attribute__((tls_model("initial-exec")));
+
+MRP_HIDDEN void mm_prof_sample(void *ptr, size_t size, void *caller);
+MRP_HIDDEN void mm_prof_forget(void *ptr);
+
+static inline uint32_t mm_prof_hash(void *ptr)
+{
+    uint64_t h = ((uintptr_t)ptr >> 4) * 0x9e3779b97f4a7c15ULL;
+
+    return (uint32_t)(h >> 32);
+}
+
+static inline void mm_prof_alloc(void *ptr, size_t size, void *caller)
+{
+    if (MRP_UNLIKELY((mm_prof_left -= (ptrdiff_t)size) < 0))
+        mm_prof_sample(ptr, size, caller);
+}
+
+static inline void mm_prof_free(void *ptr)
+{
+    uint32_t bit;
+
+    if (MRP_UNLIKELY(mm_prof_nlive != 0) && ptr != NULL) {
+        bit = mm_prof_hash(ptr) % MM_PROF_FILTER_SIZE;
+
+        if (mm_prof_filter[bit / 8] & (1 << (bit % 8)))
+            mm_prof_forget(ptr);
+    }
+}
+
+MRP_CDECL_END
+
+#endif /* __MURPHY_MM_PROFILE_H__ */
@@ -33,6 +33,8 @@
 #include <errno.h>
 #include <unistd.h>
 #include <execinfo.h>
+#include <pthread.h>
+#include <sys/mman.h>
 
 #include <murphy/common/macros.h>
 #include <murphy/common/log.h>
@@ -40,6 +42,8 @@
 #include <murphy/common/mm.h>
 #include <murphy/common/hashtbl.h>
 
+#include "mm-profile.h"
+
 
 #define DEFAULT_DEPTH   8                     /* default backtrace depth */
 #define MAX_DEPTH     128                     /* max. backtrace depth */
@@ -58,7 +62,9 @@ typedef struct {
     uint64_t        max_alloc;                /* max allocated memory */
     int             poison;                   /* poisoning pattern */
     size_t          chunk_size;               /* object pool chunk size */
+    int             slab;                     /* use slab for pooled allocs */
     mrp_mm_type_t   mode;                     /* passthru/debug mode */
+    pthread_mutex_t lock;                     /* protects blocks, counters */
 
     void *(*alloc)(size_t size, const char *file, int line, const char *func);
     void *(*realloc)(void *ptr, size_t size, const char *file,
@@ -90,6 +96,7 @@ static mm_t __mm = {                          /* allocator state */
                          MRP_MM_ALIGN),
     .depth   = DEFAULT_DEPTH,
     .poison  = 0xdeadbeef,
+    .lock    = PTHREAD_MUTEX_INITIALIZER,
 };
 
 
@@ -235,10 +242,17 @@ MRP_INIT_AT(101) static void setup(void)
     __mm.poison     = get_config_uint32(config, "poison", 0xdeadbeef);
     __mm.chunk_size = sysconf(_SC_PAGESIZE) * 2;
 
-    if (config == NULL || !get_config_bool(config, "debug", FALSE))
+    if (config == NULL || !get_config_bool(config, "debug", FALSE)) {
         mrp_mm_config(MRP_MM_PASSTHRU);
-    else
+        __mm.slab = get_config_bool(config, "slab", TRUE);
+
+        if (get_config_bool(config, "profile", FALSE))
+            mrp_mm_profile_start(get_config_uint32(config, "profile-rate", 0));
+    }
+    else {
         mrp_mm_config(MRP_MM_DEBUG);
+        __mm.slab = FALSE;
+    }
 }
 
 
@@ -426,7 +440,10 @@ static void *__mm_alloc(size_t size, const char *file, int line,
     void     *bt[__mm.depth + 1];
 
     __mm_backtrace(bt, MRP_ARRAY_SIZE(bt));
+
+    pthread_mutex_lock(&__mm.lock);
     blk = memblk_alloc(size, file, line, func, bt + 1);
+    pthread_mutex_unlock(&__mm.lock);
 
     return memblk_to_ptr(blk);
 }
@@ -441,10 +458,12 @@ static void *__mm_realloc(void *ptr, size_t size, const char *file,
     __mm_backtrace(bt, MRP_ARRAY_SIZE(bt));
     blk = ptr_to_memblk(ptr);
 
+    pthread_mutex_lock(&__mm.lock);
     if (blk != NULL)
         blk = memblk_resize(blk, size, file, line, func, bt + 1);
     else
         blk = memblk_alloc(size, file, line, func, bt + 1);
+    pthread_mutex_unlock(&__mm.lock);
 
     return memblk_to_ptr(blk);
 }
@@ -477,8 +496,11 @@ static void __mm_free(void *ptr, const char *file, int line,
         __mm_backtrace(bt, MRP_ARRAY_SIZE(bt));
         blk = ptr_to_memblk(ptr);
 
-        if (blk != NULL)
+        if (blk != NULL) {
+            pthread_mutex_lock(&__mm.lock);
             memblk_free(blk, file, line, func, bt + 1);
+            pthread_mutex_unlock(&__mm.lock);
+        }
     }
 }
 
@@ -490,36 +512,57 @@ static void __mm_free(void *ptr, const char *file, int line,
 static void *__passthru_alloc(size_t size, const char *file, int line,
                               const char *func)
 {
+    void *ptr;
+
     MRP_UNUSED(file);
     MRP_UNUSED(line);
     MRP_UNUSED(func);
 
     if (MRP_UNLIKELY(size == 0))
         return NULL;
-    else
-        return malloc(size);
+
+    ptr = malloc(size);
+    mm_prof_alloc(ptr, size, __builtin_return_address(0));
+
+    return ptr;
 }
 
 
 static void *__passthru_realloc(void *ptr, size_t size, const char *file,
                                 int line, const char *func)
 {
+    void *nptr;
+
     MRP_UNUSED(file);
     MRP_UNUSED(line);
     MRP_UNUSED(func);
 
-    return realloc(ptr, size);
+    /*
+     * Forget the old block before realloc can hand its address out to
+     * another thread. If realloc fails, the block just goes unaccounted.
+     */
+    mm_prof_free(ptr);
+
+    if ((nptr = realloc(ptr, size)) != NULL)
+        mm_prof_alloc(nptr, size, __builtin_return_address(0));
+
+    return nptr;
 }
 
 
 static int __passthru_memalign(void **ptr, size_t align, size_t size,
                                const char *file, int line, const char *func)
 {
+    int err;
+
     MRP_UNUSED(file);
     MRP_UNUSED(line);
     MRP_UNUSED(func);
 
-    return posix_memalign(ptr, align, size);
+    if ((err = posix_memalign(ptr, align, size)) == 0)
+        mm_prof_alloc(*ptr, size, __builtin_return_address(0));
+
+    return err;
 }
 
 
@@ -530,6 +573,7 @@ static void __passthru_free(void *ptr, const char *file, int line,
     MRP_UNUSED(line);
     MRP_UNUSED(func);
 
+    mm_prof_free(ptr);
     free(ptr);
 }
 
@@ -590,6 +634,7 @@ int mrp_mm_config(mrp_mm_type_t type)
 
     switch (type) {
     case MRP_MM_PASSTHRU:
+        mm_prof_disabled = FALSE;
         __mm.alloc    = __passthru_alloc;
         __mm.realloc  = __passthru_realloc;
         __mm.memalign = __passthru_memalign;
@@ -598,6 +643,8 @@ int mrp_mm_config(mrp_mm_type_t type)
         return TRUE;
 
     case MRP_MM_DEBUG:
+        mrp_mm_profile_stop();
+        mm_prof_disabled = TRUE;
         __mm.alloc    = __mm_alloc;
         __mm.realloc  = __mm_realloc;
         __mm.memalign = __mm_memalign;
@@ -813,6 +860,8 @@ void mrp_mm_dump(FILE *fp)
 
     mrp_list_init(&sorted);
 
+    pthread_mutex_lock(&__mm.lock);
+
     collect_blocks(buckets);
     sort_blocks(buckets, &sorted);
     dump_blocks(fp, &sorted);
@@ -828,6 +877,8 @@ void mrp_mm_dump(FILE *fp)
             1.0 * __mm.cur_alloc / (1024 * 1024),
             1.0 * __mm.cur_alloc / (1024 * 1024 * 1024),
             (unsigned long)__mm.cur_blocks);
+
+    pthread_mutex_unlock(&__mm.lock);
 }
 
 
@@ -886,6 +937,7 @@ struct mrp_objpool_s {
 
     size_t            nperchunk;                 /* objects per chunk */
     size_t            dataidx;                   /* data  */
+    size_t            dataoffs;                  /* object offset in chunk */
     mrp_list_hook_t   space;                     /* chunk with frees slots */
     size_t            nspace;                    /* number of such chunks */
     mrp_list_hook_t   full;                      /* fully allocated chunks */
@@ -905,6 +957,12 @@ struct pool_chunk_s {
 };
 
 
+static inline void *chunk_data(pool_chunk_t *chunk)
+{
+    return ((void *)chunk) + chunk->pool->dataoffs;
+}
+
+
 
 mrp_objpool_t *mrp_objpool_create(mrp_objpool_config_t *cfg)
 {
@@ -957,10 +1015,25 @@ static void free_object(void *obj, void *user_data)
 
 void mrp_objpool_destroy(mrp_objpool_t *pool)
 {
+    mrp_list_hook_t *p, *n;
+    pool_chunk_t    *chunk;
+
     if (pool != NULL) {
         if (pool->cleanup != NULL)
             pool_foreach_object(pool, free_object, pool);
 
+        mrp_list_foreach(&pool->full, p, n) {
+            chunk = mrp_list_entry(p, pool_chunk_t, hook);
+            mrp_list_delete(&chunk->hook);
+            chunk_free(chunk);
+        }
+
+        mrp_list_foreach(&pool->space, p, n) {
+            chunk = mrp_list_entry(p, pool_chunk_t, hook);
+            mrp_list_delete(&chunk->hook);
+            chunk_free(chunk);
+        }
+
         mrp_free(pool->name);
         mrp_free(pool);
     }
@@ -1001,15 +1074,15 @@ void *mrp_objpool_alloc(mrp_objpool_t *pool)
         uidx--;
 
     sidx = cidx * MASK_BITS + uidx;
-    obj  = ((void *)&chunk->used[pool->dataidx]) + (sidx * pool->objsize);
+    obj  = chunk_data(chunk) + (sidx * pool->objsize);
 
     mrp_debug("%p: %u/%u: %u, offs %zd\n", obj, cidx, uidx, sidx,
               sidx * pool->objsize);
 
-    chunk->used[cidx] &= ~(1 << uidx);
+    chunk->used[cidx] &= ~((mask_t)1 << uidx);
 
     if (chunk->used[cidx] == MASK_FULL) {
-        chunk->cache &= ~(1 << cidx);
+        chunk->cache &= ~((mask_t)1 << cidx);
 
         if (chunk->cache == MASK_FULL) {          /* chunk exhausted */
             mrp_list_delete(&chunk->hook);
@@ -1044,7 +1117,7 @@ void mrp_objpool_free(void *obj)
     chunk = (pool_chunk_t *)(((ptrdiff_t)obj) & ~(__mm.chunk_size - 1));
     pool  = chunk->pool;
 
-    base = (void *)&chunk->used[pool->dataidx];
+    base = chunk_data(chunk);
     sidx = (obj - base) / pool->objsize;
     cidx = sidx / MASK_BITS;
     uidx = sidx & (MASK_BITS - 1);
@@ -1055,7 +1128,7 @@ void mrp_objpool_free(void *obj)
     cache = chunk->cache;
     used  = chunk->used[cidx];
 
-    if (used & (1 << uidx)) {
+    if (used & ((mask_t)1 << uidx)) {
         mrp_log_error("Trying to free unallocated object %p of pool <%s>.",
                       obj, pool->name);
         return;
@@ -1067,8 +1140,8 @@ void mrp_objpool_free(void *obj)
     if (pool->flags & MRP_OBJPOOL_FLAG_POISON)
         memset(obj, pool->poison, pool->objsize);
 
-    chunk->used[cidx] |= (1 << uidx);
-    chunk->cache      |= (1 << cidx);
+    chunk->used[cidx] |= ((mask_t)1 << uidx);
+    chunk->cache      |= ((mask_t)1 << cidx);
 
     if (cache == MASK_FULL) {                    /* chunk was full */
         mrp_list_delete(&chunk->hook);
@@ -1143,6 +1216,9 @@ static int pool_calc_sizes(mrp_objpool_t *pool)
      * to express padding as part of the equation system (which seems to be
      * way beyond my abilities in math nowadays), we initally assume no
      * padding then check and compensate for it in the end if necessary.
+     * The objects start at the first MRP_MM_ALIGN-aligned offset after the
+     * last mask word. Since the cache word has one bit per mask word, we
+     * cannot have more than MASK_BITS * MASK_BITS objects in a chunk.
      */
 
     Hf = sizeof(pool_chunk_t);
@@ -1151,27 +1227,29 @@ static int pool_calc_sizes(mrp_objpool_t *pool)
 
     S  = MRP_ALIGN(pool->objsize, MRP_MM_ALIGN);
     n  = (B * C - B * Hf - W * (2*B - 1)) / (B * S + W);
-    Hv = W + W * (n + B - 1) / B;
 
-    P = (Hf + Hv) % sizeof(void *);
-    if (P != 0) {
-        P = sizeof(void *) - P;
+    if (n > MASK_BITS * MASK_BITS)
+        n = MASK_BITS * MASK_BITS;
 
-        if (Hv + Hf + P + n * S > C) {
-            n--;
-            Hv = W + W * (n + B - 1) / B;
-        }
+    Hv = MRP_OFFSET(pool_chunk_t, used[(n + B - 1) / B]);
+    P  = MRP_ALIGN(Hv, MRP_MM_ALIGN) - Hv;
+
+    while (n > 0 && Hv + P + n * S > C) {
+        n--;
+        Hv = MRP_OFFSET(pool_chunk_t, used[(n + B - 1) / B]);
+        P  = MRP_ALIGN(Hv, MRP_MM_ALIGN) - Hv;
     }
 
-    T  = Hf + Hv + P + n * S;
+    T  = Hv + P + n * S;
 
-    if (T > C) {
+    if (n == 0 || T > C) {
         mrp_log_error("Could not size pool '%s' properly.", pool->name);
         return FALSE;
     }
 
     pool->nperchunk = n;
     pool->dataidx   = (n + B - 1) / B;
+    pool->dataoffs  = Hv + P;
 
     if (pool->limit && (pool->limit % pool->nperchunk) != 0)
         pool->limit += (pool->nperchunk - (pool->limit % pool->nperchunk));
@@ -1260,8 +1338,8 @@ static void chunk_foreach_object(pool_chunk_t *chunk,
         uidx = sidx & (MASK_BITS - 1);
         used = chunk->used[cidx];
 
-        if (!(used & (1 << uidx))) {
-            obj = ((void *)&chunk->used[pool->dataidx]) + (sidx*pool->objsize);
+        if (!(used & ((mask_t)1 << uidx))) {
+            obj = chunk_data(chunk) + (sidx * pool->objsize);
             cb(obj, user_data);
             sidx++;
         }
@@ -1275,12 +1353,21 @@ static void chunk_foreach_object(pool_chunk_t *chunk,
 }
 
 
+static inline mask_t cache_mask(int nword)
+{
+    if (nword >= (int)MASK_BITS)
+        return MASK_EMPTY;
+    else
+        return ((mask_t)1 << nword) - 1;
+}
+
+
 static inline int chunk_empty(pool_chunk_t *chunk)
 {
     mask_t mask;
     int    i, n;
 
-    if (chunk->cache != (MASK_EMPTY & 0xffff))
+    if (chunk->cache != cache_mask(chunk->pool->dataidx))
         return FALSE;
     else {
         for (n = chunk->pool->nperchunk, i = 0; n > 0; n -= MASK_BITS, i++) {
@@ -1315,7 +1402,7 @@ static void chunk_init(pool_chunk_t *chunk, int nperchunk)
      * code paths simpler.
      */
 
-    chunk->cache = (1 << nword) - 1;
+    chunk->cache = cache_mask(nword);
 
     for (i = 0; left > 0; i++) {
         if (left >= (int)MASK_BITS)
@@ -1330,17 +1417,34 @@ static void chunk_init(pool_chunk_t *chunk, int nperchunk)
 
 static pool_chunk_t *chunk_alloc(int nperchunk)
 {
-    void *chunk;
-    int   err;
+    size_t  size = __mm.chunk_size;
+    void   *map, *chunk;
+    size_t  head, tail;
+
+    /*
+     * Chunks are mapped directly instead of using posix_memalign. Since
+     * chunks are aligned to their own size, posix_memalign would leave a
+     * chunk-sized hole in the heap for every chunk, practically doubling
+     * the memory used by pools. We map twice the chunk size and unmap the
+     * unaligned excess from the head and the tail of the mapping.
+     */
 
-    err = posix_memalign(&chunk, __mm.chunk_size, __mm.chunk_size);
+    map = mmap(NULL, 2 * size, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 
-    if (err == 0) {
-        memset(chunk, 0, __mm.chunk_size);
-        chunk_init((pool_chunk_t *)chunk, nperchunk);
-    }
-    else
-        chunk = NULL;
+    if (map == MAP_FAILED)
+        return NULL;
+
+    chunk = (void *)MRP_ALIGN((ptrdiff_t)map, size);
+    head  = chunk - map;
+    tail  = size - head;
+
+    if (head)
+        munmap(map, head);
+    if (tail)
+        munmap(chunk + size, tail);
+
+    chunk_init((pool_chunk_t *)chunk, nperchunk);
 
     return chunk;
 }
@@ -1348,7 +1452,237 @@ static pool_chunk_t *chunk_alloc(int nperchunk)
 
 static void chunk_free(pool_chunk_t *chunk)
 {
-    free(chunk);
+    munmap(chunk, __mm.chunk_size);
+}
+
+
+/*
+ * size-class slab allocator
+ *
+ * Pooled allocations are served from one object pool per size class.
+ * Every thread keeps a short list of free objects for each class. Both
+ * allocations and frees normally only touch this list. The pool of the
+ * class is locked only when the list runs empty and we grab a batch of
+ * objects from the pool, or when it grows too long and we give a batch
+ * back. Objects can be freed by any thread, not just the one which
+ * allocated them.
+ */
+
+#define SLAB_CLASS_GRAIN 16                      /* size class granularity */
+#define SLAB_BATCH_BYTES 4096                    /* max. bytes per batch */
+#define SLAB_BATCH_MIN   4                       /* min. objects per batch */
+#define SLAB_BATCH_MAX   64                      /* max. objects per batch */
+
+typedef struct slab_obj_s slab_obj_t;
+
+struct slab_obj_s {
+    slab_obj_t *next;                            /* next free object */
+};
+
+typedef struct {
+    size_t           size;                       /* object size */
+    uint32_t         batch;                      /* objects per refill */
+    mrp_objpool_t   *pool;                       /* pool for this class */
+    pthread_mutex_t  lock;                       /* lock protecting pool */
+} slab_class_t;
+
+typedef struct {
+    slab_obj_t *objs;                            /* free objects */
+    uint32_t    nobj;                            /* number of free objects */
+} slab_cache_t;
+
+static const size_t slab_sizes[] = {
+    16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512
+};
+
+#define SLAB_NCLASS MRP_ARRAY_SIZE(slab_sizes)
+
+static slab_class_t   slab_classes[SLAB_NCLASS];
+static uint8_t        slab_index[MRP_MM_SLAB_MAX / SLAB_CLASS_GRAIN + 1];
+static pthread_key_t  slab_key;
+static pthread_once_t slab_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Use the initial-exec TLS model for the per-thread caches. With the
+ * default model every access from the shared library would go through
+ * __tls_get_addr, which costs more than what the caches save.
+ */
+
+#define SLAB_TLS __thread __attribute__((tls_model("initial-exec")))
+
+static SLAB_TLS slab_cache_t slab_cache[SLAB_NCLASS];
+static SLAB_TLS int          slab_registered;
+
+
+static void slab_release_thread(void *data);
+
+static void slab_setup(void)
+{
+    slab_class_t *c;
+    size_t        size;
+    int           i, n;
+
+    for (i = n = 0; i < (int)SLAB_NCLASS; i++) {
+        c        = slab_classes + i;
+        c->size  = slab_sizes[i];
+        c->batch = SLAB_BATCH_BYTES / c->size;
+
+        if (c->batch < SLAB_BATCH_MIN)
+            c->batch = SLAB_BATCH_MIN;
+        if (c->batch > SLAB_BATCH_MAX)
+            c->batch = SLAB_BATCH_MAX;
+
+        pthread_mutex_init(&c->lock, NULL);
+
+        for (size = n * SLAB_CLASS_GRAIN; size <= c->size;
+             size += SLAB_CLASS_GRAIN, n++)
+            slab_index[n] = i;
+    }
+
+    pthread_key_create(&slab_key, slab_release_thread);
+}
+
+
+static inline int slab_class(size_t size)
+{
+    if (MRP_UNLIKELY(!slab_registered)) {
+        pthread_once(&slab_once, slab_setup);
+        pthread_setspecific(slab_key, slab_cache);
+        slab_registered = TRUE;
+    }
+
+    return slab_index[(size + SLAB_CLASS_GRAIN - 1) / SLAB_CLASS_GRAIN];
+}
+
+
+static int slab_refill(int idx)
+{
+    slab_class_t         *c     = slab_classes + idx;
+    slab_cache_t         *cache = slab_cache + idx;
+    mrp_objpool_config_t  cfg;
+    slab_obj_t           *obj;
+    char                  name[32];
+    uint32_t              i;
+
+    pthread_mutex_lock(&c->lock);
+
+    if (c->pool == NULL) {
+        snprintf(name, sizeof(name), "slab-%zu", c->size);
+
+        mrp_clear(&cfg);
+        cfg.name    = name;
+        cfg.objsize = c->size;
+
+        c->pool = mrp_objpool_create(&cfg);
+    }
+
+    for (i = 0; c->pool != NULL && i < c->batch; i++) {
+        if ((obj = mrp_objpool_alloc(c->pool)) == NULL)
+            break;
+
+        obj->next    = cache->objs;
+        cache->objs  = obj;
+        cache->nobj++;
+    }
+
+    pthread_mutex_unlock(&c->lock);
+
+    return cache->nobj > 0;
+}
+
+
+static void slab_flush(int idx, uint32_t n)
+{
+    slab_class_t *c     = slab_classes + idx;
+    slab_cache_t *cache = slab_cache + idx;
+    slab_obj_t   *obj;
+
+    pthread_mutex_lock(&c->lock);
+
+    while (n-- > 0 && (obj = cache->objs) != NULL) {
+        cache->objs = obj->next;
+        cache->nobj--;
+        mrp_objpool_free(obj);
+    }
+
+    pthread_mutex_unlock(&c->lock);
+}
+
+
+static void slab_release_thread(void *data)
+{
+    int idx;
+
+    MRP_UNUSED(data);
+
+    for (idx = 0; idx < (int)SLAB_NCLASS; idx++)
+        slab_flush(idx, slab_cache[idx].nobj);
+
+    slab_registered = FALSE;
+}
+
+
+void *mrp_mm_slab_alloc(size_t size, const char *file, int line,
+                        const char *func)
+{
+    slab_cache_t *cache;
+    slab_obj_t   *obj;
+    int           idx;
+
+    if (!__mm.slab || size > MRP_MM_SLAB_MAX)
+        return mrp_mm_alloc(size, file, line, func);
+
+    idx   = slab_class(size);
+    cache = slab_cache + idx;
+
+    if (MRP_UNLIKELY(cache->objs == NULL) && !slab_refill(idx)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    obj         = cache->objs;
+    cache->objs = obj->next;
+    cache->nobj--;
+
+    mm_prof_alloc(obj, size, __builtin_return_address(0));
+
+    return obj;
+}
+
+
+void mrp_mm_slab_free(void *ptr, size_t size, const char *file, int line,
+                      const char *func)
+{
+    slab_cache_t *cache;
+    slab_obj_t   *obj;
+    int           idx;
+
+    if (ptr == NULL)
+        return;
+
+    if (!__mm.slab || size > MRP_MM_SLAB_MAX) {
+        mrp_mm_free(ptr, file, line, func);
+        return;
+    }
+
+    mm_prof_free(ptr);
+
+    idx   = slab_class(size);
+    cache = slab_cache + idx;
+    obj   = ptr;
+
+    obj->next   = cache->objs;
+    cache->objs = obj;
+
+    if (MRP_UNLIKELY(++cache->nobj > 2 * slab_classes[idx].batch))
+        slab_flush(idx, slab_classes[idx].batch);
+}
+
+
+void mrp_mm_slab_flush(void)
+{
+    if (__mm.slab && slab_registered)
+        slab_release_thread(NULL);
 }
 
 
@@ -180,6 +180,93 @@ int mrp_objpool_grow(mrp_objpool_t *pool, int nobj);
 /** Shrink @pool by @nobj new objects, if possible. */
 int mrp_objpool_shrink(mrp_objpool_t *pool, int nobj);
 
+
+/*
+ * pooled allocations
+ *
+ * Small objects that are allocated and freed at a high rate can be
+ * allocated from a set of size-classed object pools with per-thread
+ * caches instead of the general purpose allocator. Pooled objects are
+ * freed with the size they were allocated with. Allocations larger than
+ * MRP_MM_SLAB_MAX, and all pooled allocations if the debugging allocator
+ * is enabled in the environment or slab is set to false in the
+ * configuration, are passed through to mrp_alloc/mrp_free.
+ */
+
+#define MRP_MM_SLAB_MAX 512                      /* max. pooled object size */
+
+#define mrp_alloc_pooled(type)                                            \
+    ((type *)mrp_mm_slab_alloc(sizeof(type), __LOC__))
+
+#define mrp_allocz_pooled(type) ({                                        \
+            type *_ptr;                                                   \
+                                                                          \
+            if ((_ptr = mrp_alloc_pooled(type)) != NULL)                  \
+                memset(_ptr, 0, sizeof(type));                            \
+                                                                          \
+            _ptr; })
+
+#define mrp_free_pooled(ptr)                                              \
+    mrp_mm_slab_free((ptr), sizeof(*(ptr)), __LOC__)
+
+#define mrp_allocz_pooled_size(size) ({                                   \
+            size_t  _size = (size);                                       \
+            void   *_ptr;                                                 \
+                                                                          \
+            if ((_ptr = mrp_mm_slab_alloc(_size, __LOC__)) != NULL)       \
+                memset(_ptr, 0, _size);                                   \
+                                                                          \
+            _ptr; })
+
+#define mrp_free_pooled_size(ptr, size)                                   \
+    mrp_mm_slab_free((ptr), (size), __LOC__)
+
+/** Allocate a pooled object of @size bytes. */
+void *mrp_mm_slab_alloc(size_t size, const char *file, int line,
+                        const char *func);
+
+/** Free a pooled object of @size bytes. */
+void mrp_mm_slab_free(void *ptr, size_t size, const char *file, int line,
+                      const char *func);
+
+/** Return all pooled objects cached by the calling thread to the pools. */
+void mrp_mm_slab_flush(void);
+
+
+/*
+ * sampling heap profiler
+ *
+ * While running, the profiler samples on average one allocation for
+ * every @rate bytes allocated through the passthru or slab allocators, and
+ * records its call stack. Live and cumulative statistics are kept for each
+ * distinct call stack. Profiling can also be started by setting profile
+ * (and optionally profile-rate) in __MURPHY_MM_CONFIG. The profiler is not
+ * available while the debugging allocator is active.
+ */
+
+typedef enum {
+    MRP_MM_PROFILE_PPROF = 0,            /* pprof (gperftools) heap profile */
+    MRP_MM_PROFILE_FOLDED,               /* folded stacks of live memory */
+} mrp_mm_profile_format_t;
+
+/** Start heap profiling, sampling every @rate bytes (0 for default). */
+int mrp_mm_profile_start(size_t rate);
+
+/** Stop taking new samples. Already sampled live blocks are still tracked. */
+void mrp_mm_profile_stop(void);
+
+/** Get the current sampling rate, 0 if profiling is not running. */
+size_t mrp_mm_profile_rate(void);
+
+/** Reset the cumulative allocation statistics of the profile. */
+void mrp_mm_profile_reset(void);
+
+/** Write the current profile to @fp in the given @format. */
+int mrp_mm_profile_dump(FILE *fp, mrp_mm_profile_format_t format);
+
+/** Write a summary of the top @nsite allocation sites to @fp. */
+void mrp_mm_profile_summary(FILE *fp, int nsite);
+
 /** Get the value of a boolean key from the configuration. */
 int mrp_mm_config_bool(const char *key, int defval);
 
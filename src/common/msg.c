@@ -40,6 +40,7 @@
 #include <murphy/common/msg.h>
 
 #define NDIRECT_TYPE      256            /* directly indexed types */
+#define FIELD_SIZE        MRP_OFFSET(mrp_msg_field_t, size[1])
 
 static mrp_data_descr_t **direct_types;  /* directly indexed types */
 static mrp_data_descr_t **other_types;   /* linearly searched types */
@@ -75,7 +76,7 @@ static inline void destroy_field(mrp_msg_field_t *f)
             break;
         }
 
-        mrp_free(f);
+        mrp_free_pooled_size(f, FIELD_SIZE);
     }
 }
 
@@ -91,8 +92,7 @@ static inline mrp_msg_field_t *create_field(uint16_t tag, va_list *ap)
 
 #define CREATE(_f, _tag, _type, _fldtype, _fld, _last, _errlbl) do {      \
                                                                           \
-            (_f) = mrp_allocz(MRP_OFFSET(typeof(*_f), _last) +            \
-                              sizeof(_f->_last));                         \
+            (_f) = mrp_allocz_pooled_size(FIELD_SIZE);                    \
                                                                           \
             if ((_f) != NULL) {                                           \
                 mrp_list_init(&(_f)->hook);                             \
@@ -109,7 +109,7 @@ static inline mrp_msg_field_t *create_field(uint16_t tag, va_list *ap)
             uint16_t _base;                                               \
             uint32_t _i;                                                  \
                                                                           \
-            (_f) = mrp_allocz(MRP_OFFSET(typeof(*_f), size[1]));          \
+            (_f) = mrp_allocz_pooled_size(FIELD_SIZE);                    \
                                                                           \
             if ((_f) != NULL) {                                           \
                 mrp_list_init(&(_f)->hook);                               \
@@ -266,7 +266,7 @@ static void msg_destroy(mrp_msg_t *msg)
             destroy_field(f);
         }
 
-        mrp_free(msg);
+        mrp_free_pooled(msg);
     }
 }
 
@@ -278,7 +278,7 @@ mrp_msg_t *mrp_msg_createv(uint16_t tag, va_list ap)
     va_list          aq;
 
     va_copy(aq, ap);
-    if ((msg = mrp_allocz(sizeof(*msg))) != NULL) {
+    if ((msg = mrp_allocz_pooled(mrp_msg_t)) != NULL) {
         mrp_list_init(&msg->fields);
         mrp_refcnt_init(&msg->refcnt);
 
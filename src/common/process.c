@@ -28,8 +28,10 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
+#include <sys/syscall.h>
 #include <sys/inotify.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -45,6 +47,14 @@
 
 
 #define MURPHY_PROCESS_INOTIFY_DIR "/var/run/murphy/processes"
+#define MURPHY_PID_WATCH_ENVVAR    "__MURPHY_PID_WATCH"
+
+#ifndef __NR_pidfd_open
+#    define __NR_pidfd_open 434          /* same on all architectures */
+#endif
+
+/* pids per BPF filter leaf, checked linearly */
+#define BPF_LEAF_PIDS 8
 
 struct mrp_pid_watch_s {
     pid_t pid;
@@ -76,12 +86,21 @@ typedef struct {
     pid_t pid;
     char pid_s[16]; /* memory for hashing */
 
+    int pidfd; /* pidfd if we're using pidfds, -1 otherwise */
+    mrp_io_watch_t *pidfd_wd;
+
     mrp_list_hook_t clients;
     int n_clients;
     int busy : 1;
     int dead : 1;
 } nl_pid_watch_t;
 
+typedef enum {
+    PID_BACKEND_UNKNOWN = 0,
+    PID_BACKEND_PIDFD, /* a pidfd per watched pid */
+    PID_BACKEND_NETLINK, /* proc connector with a pid filter */
+} pid_backend_t;
+
 /* murphy pid file directory notify */
 static int dir_fd;
 static int i_n_process_watches;
@@ -98,6 +117,9 @@ static mrp_io_watch_t *nl_wd;
 static mrp_htbl_t *nl_watches;
 static int nl_n_pid_watches;
 
+/* pid watch backend in use */
+static pid_backend_t pid_backend;
+
 static bool id_ok(const char *id)
 {
     int i, len;
@@ -140,12 +162,28 @@ static char *path_from_id(const char *id)
 }
 
 
+static void close_pidfd(nl_pid_watch_t *w)
+{
+    if (w->pidfd_wd) {
+        mrp_del_io_watch(w->pidfd_wd);
+        w->pidfd_wd = NULL;
+    }
+
+    if (w->pidfd >= 0) {
+        close(w->pidfd);
+        w->pidfd = -1;
+    }
+}
+
+
 static void htbl_free_nl_watch(void *key, void *object)
 {
     nl_pid_watch_t *w = (nl_pid_watch_t *) object;
 
     MRP_UNUSED(key);
 
+    close_pidfd(w);
+
     if (!w->busy)
         mrp_free(w);
     else
@@ -318,6 +356,93 @@ static int unsubscribe_proc_events()
 }
 
 
+static void notify_pid_exit(nl_pid_watch_t *nl_w)
+{
+    mrp_list_hook_t *p, *n;
+
+    nl_w->busy = TRUE;
+    mrp_list_foreach(&nl_w->clients, p, n) {
+        nl_pid_client_t *client;
+
+        client = mrp_list_entry(p, typeof(*client), hook);
+        client->cb(nl_w->pid, MRP_PROCESS_STATE_NOT_READY,
+                client->user_data);
+    }
+    if (nl_w->dead)
+        mrp_free(nl_w);
+    else
+        nl_w->busy = FALSE;
+
+    /* TODO: should we automatically free the wathces? Or let
+     * client do that to preserver symmetricity? */
+}
+
+
+static void pidfd_watch(mrp_io_watch_t *w, int fd, mrp_io_event_t events,
+        void *user_data)
+{
+    nl_pid_watch_t *nl_w = (nl_pid_watch_t *) user_data;
+
+    MRP_UNUSED(w);
+    MRP_UNUSED(fd);
+    MRP_UNUSED(events);
+
+    mrp_log_info("process %d exited", nl_w->pid);
+
+    /* a pidfd stays readable once the process has exited */
+    close_pidfd(nl_w);
+
+    notify_pid_exit(nl_w);
+}
+
+
+static int open_pidfd(nl_pid_watch_t *nl_w, mrp_mainloop_t *ml)
+{
+    nl_w->pidfd = syscall(__NR_pidfd_open, nl_w->pid, 0);
+
+    if (nl_w->pidfd < 0)
+        return -1;
+
+    nl_w->pidfd_wd = mrp_add_io_watch(ml, nl_w->pidfd, MRP_IO_EVENT_IN,
+            pidfd_watch, nl_w);
+
+    if (!nl_w->pidfd_wd) {
+        close(nl_w->pidfd);
+        nl_w->pidfd = -1;
+        errno = ENOMEM;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static pid_backend_t probe_pid_backend()
+{
+    const char *env = getenv(MURPHY_PID_WATCH_ENVVAR);
+    int fd;
+
+    if (env != NULL) {
+        if (!strcmp(env, "netlink"))
+            return PID_BACKEND_NETLINK;
+        if (strcmp(env, "pidfd"))
+            mrp_log_warning("ignoring unknown pid watch backend '%s'", env);
+    }
+
+    fd = syscall(__NR_pidfd_open, getpid(), 0);
+
+    if (fd < 0) {
+        mrp_log_info("pidfds not available (%s), using netlink to watch pids",
+                strerror(errno));
+        return PID_BACKEND_NETLINK;
+    }
+
+    close(fd);
+
+    return PID_BACKEND_PIDFD;
+}
+
+
 static void nl_watch(mrp_io_watch_t *w, int fd, mrp_io_event_t events,
         void *user_data)
 {
@@ -370,7 +495,6 @@ static void nl_watch(mrp_io_watch_t *w, int fd, mrp_io_event_t events,
             switch (ev->what) {
                 case PROC_EVENT_EXIT:
                 {
-                    mrp_list_hook_t *p, *n;
                     nl_pid_watch_t *nl_w;
                     char pid_s[16];
                     int ret;
@@ -388,25 +512,13 @@ static void nl_watch(mrp_io_watch_t *w, int fd, mrp_io_event_t events,
                     nl_w = (nl_pid_watch_t *) mrp_htbl_lookup(nl_watches, pid_s);
 
                     if (!nl_w) {
-                        mrp_log_error("pid %s exited but no-one was following it", pid_s);
+                        /* the filter passes all exits if it got too big */
+                        mrp_debug("pid %s exited but no-one was following it",
+                                pid_s);
                         break;
                     }
 
-                    nl_w->busy = TRUE;
-                    mrp_list_foreach(&nl_w->clients, p, n) {
-                        nl_pid_client_t *client;
-
-                        client = mrp_list_entry(p, typeof(*client), hook);
-                        client->cb(nl_w->pid, MRP_PROCESS_STATE_NOT_READY,
-                                client->user_data);
-                    }
-                    if (nl_w->dead)
-                        mrp_free(nl_w);
-                    else
-                        nl_w->busy = FALSE;
-
-                    /* TODO: should we automatically free the wathces? Or let
-                     * client do that to preserver symmetricity? */
+                    notify_pid_exit(nl_w);
                     break;
                 }
                 default:
@@ -468,7 +580,10 @@ static int initialize(mrp_mainloop_t *ml, bool process, bool pid)
     }
 
     if (pid) {
-        if (nl_sock <= 0) {
+        if (pid_backend == PID_BACKEND_UNKNOWN)
+            pid_backend = probe_pid_backend();
+
+        if (pid_backend == PID_BACKEND_NETLINK && nl_sock <= 0) {
             struct sockaddr_nl nl_addr;
             int nl_options = SOCK_NONBLOCK | SOCK_DGRAM | SOCK_CLOEXEC;
             struct sock_filter block[] = {
@@ -617,30 +732,65 @@ end:
 }
 
 
-static void filter_add_pid(struct sock_filter *p, pid_t pid, int proc_offset)
+static int cmp_keys(const void *a, const void *b)
 {
-    int proc_event_data_offset = proc_offset +
-            offsetof(struct proc_event, event_data);
-    /* event_data is an union, leaving out */
-    int proc_event_data_exit_pid_offset = proc_event_data_offset +
-            offsetof(struct exit_proc_event, process_pid);
+    uint32_t ka = *(const uint32_t *) a;
+    uint32_t kb = *(const uint32_t *) b;
 
-    struct sock_filter bpf[] = {
-        /* load the pid value ... */
-        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, proc_event_data_exit_pid_offset),
+    return ka < kb ? -1 : (ka > kb ? 1 : 0);
+}
 
-        /* ... if it is the pid we're comparing it to ... */
-        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(pid), 0, 1),
 
-        /* ... return success immediately ... */
-        BPF_STMT(BPF_RET | BPF_K, 0xffffffff),
+static int filter_tree_size(int n)
+{
+    int left, size;
 
-        /* ... otherwise proceed to the next comparison or exit. */
-    };
+    /* a leaf is a linear run of compares followed by two returns */
+    if (n <= BPF_LEAF_PIDS)
+        return n + 2;
+
+    /* conditional jumps reach only 255 ahead, longer ones need a BPF_JA */
+    left = n / 2;
+    size = filter_tree_size(left);
+
+    return (size > 255 ? 2 : 1) + size + filter_tree_size(n - left);
+}
+
+
+static struct sock_filter *filter_add_tree(struct sock_filter *p,
+                                           uint32_t *keys, int n)
+{
+    int left, size, i;
 
-    mrp_debug("adding pid %d to filter\n", pid);
+    if (n <= BPF_LEAF_PIDS) {
+        for (i = 0; i < n; i++) {
+            /* on match jump to the accepting return at the end */
+            *p++ = (struct sock_filter)
+                BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, keys[i], n - i, 0);
+        }
+
+        *p++ = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, 0x0);
+        *p++ = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, 0xffffffff);
+
+        return p;
+    }
 
-    memcpy(p, bpf, 3*sizeof(struct sock_filter));
+    /* keys[left] is the smallest key in the right subtree */
+    left = n / 2;
+    size = filter_tree_size(left);
+
+    if (size <= 255)
+        *p++ = (struct sock_filter)
+            BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, keys[left], size, 0);
+    else {
+        *p++ = (struct sock_filter)
+            BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, keys[left], 0, 1);
+        *p++ = (struct sock_filter) BPF_STMT(BPF_JMP | BPF_JA, size);
+    }
+
+    p = filter_add_tree(p, keys, left);
+
+    return filter_add_tree(p, keys + left, n - left);
 }
 
 
@@ -653,9 +803,15 @@ static int filter_update(pid_t pids[], int len_pids)
     int cn_val_offset = cn_id_offset + offsetof(struct cb_id, val);
     int proc_offset = cn_offset + offsetof(struct cn_msg, data);
     int proc_what_offset = proc_offset + offsetof(struct proc_event, what);
+    int proc_event_data_offset = proc_offset +
+            offsetof(struct proc_event, event_data);
+    /* event_data is an union, leaving out */
+    int proc_event_data_exit_pid_offset = proc_event_data_offset +
+            offsetof(struct exit_proc_event, process_pid);
 
     struct sock_fprog fp;
     struct sock_filter *bpf, *iter;
+    uint32_t *keys = NULL;
 
     struct sock_filter bpf_header[] = {
 
@@ -693,55 +849,100 @@ static int filter_update(pid_t pids[], int len_pids)
         BPF_STMT(BPF_LD | BPF_W | BPF_ABS, proc_what_offset),
         BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(PROC_EVENT_EXIT), 1, 0),
         BPF_STMT(BPF_RET | BPF_K, 0x0),
-    };
 
-    struct sock_filter bpf_footer[] = {
-        /* if there was no pid match then filter the packet */
-        BPF_STMT (BPF_RET | BPF_K, 0x0),
+        /* load the pid of the exited process */
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, proc_event_data_exit_pid_offset),
     };
 
-    int len_bpf_header = sizeof(bpf_header);
-    int len_bpf_footer = sizeof(bpf_footer);
-    /* three statements */
-    int len_bpf_pids = sizeof(struct sock_filter) * len_pids * 3;
-    int len = len_bpf_header + len_bpf_pids + len_bpf_footer;
-    int i;
+    int n_header = MRP_ARRAY_SIZE(bpf_header);
+    int n_tree, len, i;
 
     if (nl_sock <= 0) {
         mrp_log_error("invalid netlink socket %d", nl_sock);
         goto error;
     }
 
+    /*
+     * Check that the PID is one that we are following. The pids are
+     * sorted and checked with a binary search tree of compares, ending
+     * in short linear leaves. If the tree does not fit in a filter, we
+     * let all exit events through and look up the pid in nl_watch().
+     */
+
+    n_tree = filter_tree_size(len_pids);
+
+    if (n_header + n_tree > BPF_MAXINSNS) {
+        mrp_log_warning("too many pids (%d) for socket filter, "
+                "passing all exit events", len_pids);
+        len_pids = -1;
+    }
+
+ rebuild:
+    if (len_pids < 0)
+        n_tree = 1;
+
+    len = n_header + n_tree;
+
     /* build the filter */
 
-    bpf = (struct sock_filter *) mrp_allocz(len);
+    bpf = (struct sock_filter *) mrp_allocz_array(struct sock_filter, len);
 
     if (!bpf)
         goto error;
 
     iter = bpf;
 
-    memcpy(iter, bpf_header, len_bpf_header);
+    memcpy(iter, bpf_header, sizeof(bpf_header));
+
+    iter += n_header;
+
+    if (len_pids < 0)
+        *iter++ = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, 0xffffffff);
+    else {
+        keys = mrp_alloc_array(uint32_t, len_pids ? len_pids : 1);
+
+        if (!keys) {
+            mrp_free(bpf);
+            goto error;
+        }
+
+        /* BPF_LD | BPF_ABS loads in network byte order, sort accordingly */
+        for (i = 0; i < len_pids; i++)
+            keys[i] = htonl(pids[i]);
+
+        qsort(keys, len_pids, sizeof(keys[0]), cmp_keys);
+
+        mrp_debug("adding %d pids to filter", len_pids);
 
-    iter = iter + (len_bpf_header / sizeof(struct sock_filter));
+        iter = filter_add_tree(iter, keys, len_pids);
 
-    /* check that the PID is one that we are following */
-    for (i = 0; i < len_pids; i++, iter=iter+3) {
-        filter_add_pid(iter, pids[i], proc_offset);
+        mrp_free(keys);
     }
 
-    memcpy(iter, bpf_footer, len_bpf_footer);
+    MRP_ASSERT(iter - bpf == len, "socket filter size mismatch");
 
     memset(&fp, 0, sizeof(struct sock_fprog));
     fp.filter = bpf;
-    fp.len = len / sizeof(struct sock_filter);
+    fp.len = len;
 
     if (setsockopt(nl_sock, SOL_SOCKET, SO_ATTACH_FILTER, &fp,
-            sizeof(struct sock_fprog)) < 0)
+            sizeof(struct sock_fprog)) < 0) {
         mrp_log_error("setting socket filter failed: %s", strerror(errno));
+        mrp_free(bpf);
+
+        /* don't leave the old filter in place, it would miss new pids */
+        if (len_pids >= 0) {
+            len_pids = -1;
+            goto rebuild;
+        }
+
+        goto error;
+    }
 
     mrp_free(bpf);
 
+    return 0;
+
 error:
     return -1;
 }
@@ -905,6 +1106,7 @@ mrp_pid_watch_t *mrp_pid_set_watch(pid_t pid, mrp_mainloop_t *ml,
 
         mrp_list_init(&nl_w->clients);
         nl_w->pid = pid;
+        nl_w->pidfd = -1;
         memcpy(nl_w->pid_s, pid_s, sizeof(nl_w->pid_s));
 
         already_inserted = FALSE;
@@ -934,8 +1136,17 @@ mrp_pid_watch_t *mrp_pid_set_watch(pid_t pid, mrp_mainloop_t *ml,
     nl_w->n_clients++;
 
     if (!already_inserted) {
+        if (pid_backend == PID_BACKEND_PIDFD && open_pidfd(nl_w, ml) < 0) {
+            mrp_log_error("failed to open pidfd for %d: %s", pid,
+                    strerror(errno));
+            mrp_list_delete(&client->hook);
+            mrp_free(nl_w);
+            goto error;
+        }
+
         if (mrp_htbl_insert(nl_watches, nl_w->pid_s, nl_w) < 0) {
             mrp_list_delete(&client->hook);
+            close_pidfd(nl_w);
             mrp_free(nl_w);
             goto error;
         }
@@ -943,10 +1154,12 @@ mrp_pid_watch_t *mrp_pid_set_watch(pid_t pid, mrp_mainloop_t *ml,
         nl_n_pid_watches++;
     }
 
-    pid_filter_update();
+    if (pid_backend == PID_BACKEND_NETLINK) {
+        pid_filter_update();
 
-    if (!subscribed)
-        subscribe_proc_events();
+        if (!subscribed)
+            subscribe_proc_events();
+    }
 
     /* check that the pid is still there -- return error if not */
 
@@ -961,8 +1174,8 @@ error_process:
 
 error:
     if (client) {
-        mrp_free(client);
         mrp_free(client->w);
+        mrp_free(client);
     }
 
     return NULL;
@@ -1059,12 +1272,14 @@ int mrp_pid_remove_watch(mrp_pid_watch_t *w)
         mrp_htbl_remove(nl_watches, pid_s, TRUE);
         nl_n_pid_watches--;
 
-        pid_filter_update();
+        if (pid_backend == PID_BACKEND_NETLINK) {
+            pid_filter_update();
 
-        if (nl_n_pid_watches == 0) {
-            /* no-one is following pids anymore */
-            if (subscribed)
-                unsubscribe_proc_events();
+            if (nl_n_pid_watches == 0) {
+                /* no-one is following pids anymore */
+                if (subscribed)
+                    unsubscribe_proc_events();
+            }
         }
     }
 
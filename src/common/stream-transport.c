@@ -47,6 +47,9 @@
 #include <murphy/common/socket-utils.h>
 #include <murphy/common/transport.h>
 
+#include "transport-worker.h"
+#include "uring.h"
+
 #ifndef UNIX_PATH_MAX
 #    define UNIX_PATH_MAX sizeof(((struct sockaddr_un *)NULL)->sun_path)
 #endif
@@ -65,12 +68,18 @@ typedef struct {
     int             sock;                /* TCP socket */
     mrp_io_watch_t *iow;                 /* socket I/O watch */
     mrp_fragbuf_t  *buf;                 /* fragment buffer */
+    mrp_transport_async_t *async;        /* or worker reading the socket */
+    mrp_uring_conn_t *ring;              /* or io_uring connection */
+    int             accepted;            /* socket accepted by io_uring */
 } strm_t;
 
 
 static void strm_recv_cb(mrp_io_watch_t *w, int fd, mrp_io_event_t events,
                          void *user_data);
 static int strm_disconnect(mrp_transport_t *mt);
+static void strm_closed(mrp_transport_t *mt, int error);
+static int add_watch(strm_t *t);
+static int add_accept(strm_t *t);
 static int open_socket(strm_t *t, int family);
 
 
@@ -252,7 +261,8 @@ static int strm_open(mrp_transport_t *mt)
 {
     strm_t *t = (strm_t *)mt;
 
-    t->sock = -1;
+    t->sock     = -1;
+    t->accepted = -1;
 
     return TRUE;
 }
@@ -292,7 +302,8 @@ static int strm_createfrom(mrp_transport_t *mt, void *conn)
     strm_t           *t = (strm_t *)mt;
     mrp_io_event_t   events;
 
-    t->sock = *(int *)conn;
+    t->sock     = *(int *)conn;
+    t->accepted = -1;
 
     if (t->sock >= 0) {
         if (mt->flags & MRP_TRANSPORT_REUSEADDR)
@@ -306,11 +317,17 @@ static int strm_createfrom(mrp_transport_t *mt, void *conn)
         if (t->connected || t->listened) {
             if (!t->connected ||
                 (t->buf = mrp_fragbuf_create(TRUE, 0)) != NULL) {
-                events = MRP_IO_EVENT_IN | MRP_IO_EVENT_HUP;
-                t->iow = mrp_add_io_watch(t->ml, t->sock, events,
-                                          strm_recv_cb, t);
-
-                if (t->iow != NULL)
+                if (t->listened) {
+                    events = MRP_IO_EVENT_IN | MRP_IO_EVENT_HUP;
+                    t->iow = mrp_add_io_watch(t->ml, t->sock, events,
+                                              strm_recv_cb, t);
+
+                    if (t->iow != NULL) {
+                        add_accept(t);
+                        return TRUE;
+                    }
+                }
+                else if (add_watch(t))
                     return TRUE;
 
                 mrp_fragbuf_destroy(t->buf);
@@ -332,6 +349,20 @@ static void strm_close(mrp_transport_t *mt)
     mrp_del_io_watch(t->iow);
     t->iow = NULL;
 
+    mrp_transport_async_del(t->async);
+    t->async = NULL;
+
+    if (t->ring != NULL) {
+        mrp_uring_close(t->ring);        /* takes care of closing t->sock */
+        t->ring = NULL;
+        t->sock = -1;
+    }
+
+    if (t->accepted >= 0) {
+        close(t->accepted);
+        t->accepted = -1;
+    }
+
     mrp_fragbuf_destroy(t->buf);
     t->buf = NULL;
 
@@ -370,6 +401,7 @@ static int strm_listen(mrp_transport_t *mt, int backlog)
         if (listen(t->sock, backlog) == 0) {
             mrp_debug("transport %p listening", mt);
             t->listened = TRUE;
+            add_accept(t);
             return TRUE;
         }
     }
@@ -384,7 +416,6 @@ static int strm_accept(mrp_transport_t *mt, mrp_transport_t *mlt)
     strm_t         *t, *lt;
     mrp_sockaddr_t  addr;
     socklen_t       addrlen;
-    mrp_io_event_t  events;
 
     t  = (strm_t *)mt;
     lt = (strm_t *)mlt;
@@ -395,8 +426,14 @@ static int strm_accept(mrp_transport_t *mt, mrp_transport_t *mlt)
         return FALSE;
     }
 
-    addrlen = sizeof(addr);
-    t->sock = accept(lt->sock, &addr.any, &addrlen);
+    if (lt->accepted >= 0) {
+        t->sock      = lt->accepted;
+        lt->accepted = -1;
+    }
+    else {
+        addrlen = sizeof(addr);
+        t->sock = accept(lt->sock, &addr.any, &addrlen);
+    }
 
     if (t->sock >= 0) {
         if (mt->flags & MRP_TRANSPORT_REUSEADDR)
@@ -412,10 +449,8 @@ static int strm_accept(mrp_transport_t *mt, mrp_transport_t *mlt)
                 goto reject;
 
         t->buf = mrp_fragbuf_create(TRUE, 0);
-        events = MRP_IO_EVENT_IN | MRP_IO_EVENT_HUP;
-        t->iow = mrp_add_io_watch(t->ml, t->sock, events, strm_recv_cb, t);
 
-        if (t->iow != NULL && t->buf != NULL) {
+        if (t->buf != NULL && add_watch(t)) {
             mrp_debug("accepted connection on transport %p/%p", mlt, mt);
             return TRUE;
         }
@@ -453,14 +488,49 @@ static int strm_accept(mrp_transport_t *mt, mrp_transport_t *mlt)
 }
 
 
+static int strm_deliver(strm_t *t)
+{
+    mrp_transport_t *mt = (mrp_transport_t *)t;
+    void            *data;
+    size_t           size;
+    int              error;
+
+    data = NULL;
+    size = 0;
+    while (mrp_fragbuf_pull(t->buf, &data, &size)) {
+        if (t->mode != MRP_TRANSPORT_MODE_JSON)
+            error = t->recv_data(mt, data, size, NULL, 0);
+        else {
+            mrp_json_t *msg = mrp_json_string_to_object(data, size);
+
+            if (msg != NULL) {
+                error = t->recv_data((mrp_transport_t *)t, msg, 0, NULL, 0);
+                mrp_json_unref(msg);
+            }
+            else
+                error = EILSEQ;
+        }
+
+        if (error) {
+            strm_closed(mt, error);
+            return FALSE;
+        }
+
+        if (t->check_destroy(mt))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+
 static void strm_recv_cb(mrp_io_watch_t *w, int fd, mrp_io_event_t events,
                          void *user_data)
 {
     strm_t          *t  = (strm_t *)user_data;
     mrp_transport_t *mt = (mrp_transport_t *)t;
-    void            *data, *buf;
+    void            *buf;
     uint32_t         pending;
-    size_t           size;
     ssize_t          n;
     int              error;
 
@@ -511,28 +581,8 @@ static void strm_recv_cb(mrp_io_watch_t *w, int fd, mrp_io_event_t events,
             }
         }
 
-        data = NULL;
-        size = 0;
-        while (mrp_fragbuf_pull(t->buf, &data, &size)) {
-            if (t->mode != MRP_TRANSPORT_MODE_JSON)
-                error = t->recv_data(mt, data, size, NULL, 0);
-            else {
-                mrp_json_t *msg = mrp_json_string_to_object(data, size);
-
-                if (msg != NULL) {
-                    error = t->recv_data((mrp_transport_t *)t, msg, 0, NULL, 0);
-                    mrp_json_unref(msg);
-                }
-                else
-                    error = EILSEQ;
-            }
-
-            if (error)
-                goto fatal_error;
-
-            if (t->check_destroy(mt))
-                return;
-        }
+        if (!strm_deliver(t))
+            return;
     }
 
     if (events & MRP_IO_EVENT_HUP) {
@@ -543,6 +593,126 @@ static void strm_recv_cb(mrp_io_watch_t *w, int fd, mrp_io_event_t events,
 }
 
 
+static void strm_closed(mrp_transport_t *mt, int error)
+{
+    if (error)
+        mrp_debug("transport %p closed with error %d", mt, error);
+    else
+        mrp_debug("transport %p closed by peer", mt);
+
+    strm_disconnect(mt);
+
+    if (mt->evt.closed != NULL)
+        MRP_TRANSPORT_BUSY(mt, {
+                mt->evt.closed(mt, error, mt->user_data);
+            });
+
+    mt->check_destroy(mt);
+}
+
+
+static void strm_ring_recv(mrp_uring_conn_t *c, void *data, size_t size,
+                           int error, void *user_data)
+{
+    strm_t          *t  = (strm_t *)user_data;
+    mrp_transport_t *mt = (mrp_transport_t *)t;
+    void            *buf;
+
+    MRP_UNUSED(c);
+
+    if (size == 0) {
+        strm_closed(mt, error);
+        return;
+    }
+
+    if ((buf = mrp_fragbuf_alloc(t->buf, size)) == NULL) {
+        strm_closed(mt, ENOMEM);
+        return;
+    }
+
+    memcpy(buf, data, size);
+    strm_deliver(t);
+}
+
+
+static void strm_ring_accept(mrp_uring_conn_t *c, int fd, void *user_data)
+{
+    strm_t          *t  = (strm_t *)user_data;
+    mrp_transport_t *mt = (mrp_transport_t *)t;
+
+    MRP_UNUSED(c);
+
+    if (fd < 0) {
+        mrp_log_error("Failed to accept connection on transport %p (%d: %s).",
+                      mt, errno, strerror(errno));
+        return;
+    }
+
+    t->accepted = fd;
+
+    MRP_TRANSPORT_BUSY(mt, {
+            mrp_debug("connection event on transport %p", mt);
+            mt->evt.connection(mt, mt->user_data);
+        });
+
+    if (t->accepted >= 0) {              /* not accepted, reject it */
+        close(t->accepted);
+        t->accepted = -1;
+    }
+
+    t->check_destroy(mt);
+}
+
+
+static int add_watch(strm_t *t)
+{
+    mrp_transport_t *mt = (mrp_transport_t *)t;
+    mrp_uring_t     *u;
+    mrp_io_event_t   events;
+
+    if (t->flags & MRP_TRANSPORT_ASYNC_DECODE) {
+        t->async = mrp_transport_async_add(mt, t->sock, strm_closed);
+
+        if (t->async != NULL)
+            return TRUE;
+
+        mrp_log_warning("Failed to decode asynchronously on transport %p, "
+                        "falling back to synchronous decoding.", mt);
+    }
+
+    if ((u = mrp_mainloop_get_uring(t->ml)) != NULL) {
+        t->ring = mrp_uring_recv(u, t->sock, strm_ring_recv, t);
+
+        if (t->ring != NULL)
+            return TRUE;
+    }
+
+    events = MRP_IO_EVENT_IN | MRP_IO_EVENT_HUP;
+    t->iow = mrp_add_io_watch(t->ml, t->sock, events, strm_recv_cb, t);
+
+    return t->iow != NULL;
+}
+
+
+static int add_accept(strm_t *t)
+{
+    mrp_uring_t *u;
+
+    if ((u = mrp_mainloop_get_uring(t->ml)) == NULL)
+        return FALSE;
+
+    t->ring = mrp_uring_accept(u, t->sock, strm_ring_accept, t);
+
+    if (t->ring == NULL)
+        return FALSE;
+
+    mrp_del_io_watch(t->iow);
+    t->iow = NULL;
+
+    return TRUE;
+}
+
+
 static int open_socket(strm_t *t, int family)
 {
     mrp_io_event_t events;
@@ -582,7 +752,6 @@ static int strm_connect(mrp_transport_t *mt, mrp_sockaddr_t *addr,
                         socklen_t addrlen)
 {
     strm_t         *t    = (strm_t *)mt;
-    mrp_io_event_t  events;
 
     t->sock = socket(addr->any.sa_family, SOCK_STREAM, 0);
 
@@ -597,10 +766,7 @@ static int strm_connect(mrp_transport_t *mt, mrp_sockaddr_t *addr,
         t->buf = mrp_fragbuf_create(TRUE, 0);
 
         if (t->buf != NULL) {
-            events = MRP_IO_EVENT_IN | MRP_IO_EVENT_HUP;
-            t->iow = mrp_add_io_watch(t->ml, t->sock, events, strm_recv_cb, t);
-
-            if (t->iow != NULL) {
+            if (add_watch(t)) {
                 mrp_debug("connected transport %p", mt);
 
                 return TRUE;
@@ -632,7 +798,16 @@ static int strm_disconnect(mrp_transport_t *mt)
         mrp_del_io_watch(t->iow);
         t->iow = NULL;
 
-        shutdown(t->sock, SHUT_RDWR);
+        mrp_transport_async_del(t->async);
+        t->async = NULL;
+
+        if (t->ring != NULL) {
+            mrp_uring_close(t->ring);    /* flushes, shuts down and closes */
+            t->ring = NULL;
+            t->sock = -1;
+        }
+        else
+            shutdown(t->sock, SHUT_RDWR);
 
         mrp_fragbuf_destroy(t->buf);
         t->buf = NULL;
@@ -646,6 +821,32 @@ static int strm_disconnect(mrp_transport_t *mt)
 }
 
 
+static ssize_t strm_writev(strm_t *t, struct iovec *iov, int iovcnt)
+{
+    ssize_t size;
+    int     i;
+
+    if (t->ring == NULL)
+        return writev(t->sock, iov, iovcnt);
+
+    for (i = 0, size = 0; i < iovcnt; i++)
+        size += iov[i].iov_len;
+
+    return mrp_uring_send(t->ring, iov, iovcnt) ? size : -1;
+}
+
+
+static ssize_t strm_write(strm_t *t, void *data, size_t size)
+{
+    struct iovec iov;
+
+    iov.iov_base = data;
+    iov.iov_len  = size;
+
+    return strm_writev(t, &iov, 1);
+}
+
+
 static int strm_send(mrp_transport_t *mt, mrp_msg_t *msg)
 {
     strm_t        *t = (strm_t *)mt;
@@ -664,7 +865,7 @@ static int strm_send(mrp_transport_t *mt, mrp_msg_t *msg)
             iov[1].iov_base = buf;
             iov[1].iov_len  = size;
 
-            n = writev(t->sock, iov, 2);
+            n = strm_writev(t, iov, 2);
             mrp_free(buf);
 
             if (n == (ssize_t)(size + sizeof(len)))
@@ -689,7 +890,7 @@ static int strm_sendraw(mrp_transport_t *mt, void *data, size_t size)
     ssize_t  n;
 
     if (t->connected) {
-        n = write(t->sock, data, size);
+        n = strm_write(t, data, size);
 
         if (n == (ssize_t)size)
             return TRUE;
@@ -730,7 +931,7 @@ static int strm_senddata(mrp_transport_t *mt, void *data, uint16_t tag)
                 *lenp = htobe32(len);
                 *tagp = htobe16(tag);
 
-                n = write(t->sock, buf, len + sizeof(*lenp));
+                n = strm_write(t, buf, len + sizeof(*lenp));
 
                 mrp_free(buf);
 
@@ -767,7 +968,7 @@ static int strm_sendnative(mrp_transport_t *mt, void *data, uint32_t type_id)
             lenp  = buf;
             *lenp = htobe32(size - sizeof(*lenp));
 
-            n = write(t->sock, buf, size);
+            n = strm_write(t, buf, size);
 
             mrp_free(buf);
 
@@ -803,7 +1004,7 @@ static int strm_sendjson(mrp_transport_t *mt, mrp_json_t *msg)
         iov[1].iov_base = (void *)s;
         iov[1].iov_len  = size;
 
-        n = writev(t->sock, iov, 2);
+        n = strm_writev(t, iov, 2);
 
         if (n == (ssize_t)(size + sizeof(len)))
             return TRUE;
@@ -0,0 +1,396 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <libgen.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mm.h>
+#include <murphy/common/mainloop.h>
+
+/*
+ * Measure the I/O event dispatching rate of the mainloop with a large
+ * number of idle file descriptors and a smaller number of always readable
+ * ones (eventfds that are never read), so that every iteration dispatches
+ * an event for each active fd. The mainloop is run natively with both the
+ * epoll and io_uring backends, and pumped by a minimal superloop which
+ * fetches events either with the poll_events superloop operation or with
+ * mrp_superloop_poll_events().
+ */
+
+typedef enum {
+    MODE_NATIVE = 0,                     /* run natively */
+    MODE_SUPER_ALLOC,                    /* superloop, poll_events */
+    MODE_SUPER_REUSE,                    /* superloop, reused buffer */
+} bench_mode_t;
+
+typedef struct {
+    mrp_mainloop_t *ml;
+    bench_mode_t    mode;
+    void           *io_id;               /* our only I/O watch */
+    void          (*io_cb)(void *, void *, int, mrp_io_event_t, void *);
+    void           *io_data;
+    void          (*defer_cb)(void *, void *, void *);
+    void           *defer_data;
+    int             defer_enabled;
+} glue_t;
+
+static glue_t              glue;
+static mrp_superloop_ops_t glue_ops;
+static long                ncallback;
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+
+/*
+ * A superloop that only knows about the single I/O watch of the mainloop
+ * and its deferred callback. Timers are ignored, the bench keeps enough
+ * fds readable for the mainloop never to need one.
+ */
+
+static void *glue_add_io(void *glue_data, int fd, mrp_io_event_t events,
+                         void (*cb)(void *glue_data, void *id, int fd,
+                                    mrp_io_event_t events, void *user_data),
+                         void *user_data)
+{
+    glue_t *g = glue_data;
+
+    MRP_UNUSED(fd);
+    MRP_UNUSED(events);
+
+    g->io_cb   = cb;
+    g->io_data = user_data;
+    g->io_id   = &g->io_id;
+
+    return g->io_id;
+}
+
+
+static void glue_del_io(void *glue_data, void *id)
+{
+    glue_t *g = glue_data;
+
+    MRP_UNUSED(id);
+
+    g->io_cb = NULL;
+}
+
+
+static void *glue_add_timer(void *glue_data, unsigned int msecs,
+                            void (*cb)(void *glue_data, void *id,
+                                       void *user_data),
+                            void *user_data)
+{
+    MRP_UNUSED(msecs);
+    MRP_UNUSED(cb);
+    MRP_UNUSED(user_data);
+
+    return glue_data;
+}
+
+
+static void glue_del_timer(void *glue_data, void *id)
+{
+    MRP_UNUSED(glue_data);
+    MRP_UNUSED(id);
+}
+
+
+static void glue_mod_timer(void *glue_data, void *id, unsigned int msecs)
+{
+    MRP_UNUSED(glue_data);
+    MRP_UNUSED(id);
+    MRP_UNUSED(msecs);
+}
+
+
+static void *glue_add_defer(void *glue_data,
+                            void (*cb)(void *glue_data, void *id,
+                                       void *user_data),
+                            void *user_data)
+{
+    glue_t *g = glue_data;
+
+    g->defer_cb   = cb;
+    g->defer_data = user_data;
+
+    return &g->defer_cb;
+}
+
+
+static void glue_del_defer(void *glue_data, void *id)
+{
+    glue_t *g = glue_data;
+
+    MRP_UNUSED(id);
+
+    g->defer_cb = NULL;
+}
+
+
+static void glue_mod_defer(void *glue_data, void *id, int enabled)
+{
+    glue_t *g = glue_data;
+
+    MRP_UNUSED(id);
+
+    g->defer_enabled = enabled;
+}
+
+
+static void glue_unregister(void *glue_data)
+{
+    MRP_UNUSED(glue_data);
+}
+
+
+static size_t glue_poll_io(void *glue_data, void *id, void *buf, size_t size)
+{
+    glue_t *g = glue_data;
+    void   *events;
+    size_t  n;
+
+    if (g->mode == MODE_SUPER_REUSE)
+        n = mrp_superloop_poll_events(g->ml, id, &events);
+    else
+        n = glue_ops.poll_events(id, g->ml, &events);
+
+    if (n > size)
+        n = size;
+
+    if (n > 0)
+        memcpy(buf, events, n);
+
+    if (g->mode != MODE_SUPER_REUSE)
+        mrp_free(events);
+
+    return n;
+}
+
+
+static void superloop_iterate(glue_t *g)
+{
+    /* our epoll fd is always readable, pretend we polled it */
+    g->io_cb(g, g->io_id, -1, MRP_IO_EVENT_IN, g->io_data);
+
+    if (g->defer_enabled)
+        g->defer_cb(g, &g->defer_cb, g->defer_data);
+}
+
+
+static void io_cb(mrp_io_watch_t *w, int fd, mrp_io_event_t events,
+                  void *user_data)
+{
+    MRP_UNUSED(w);
+    MRP_UNUSED(fd);
+    MRP_UNUSED(events);
+    MRP_UNUSED(user_data);
+
+    ncallback++;
+}
+
+
+static int raise_fd_limit(int nfd)
+{
+    struct rlimit rl;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) < 0)
+        return -1;
+
+    if (rl.rlim_cur >= (rlim_t)nfd)
+        return 0;
+
+    rl.rlim_cur = rl.rlim_max < (rlim_t)nfd ? rl.rlim_max : (rlim_t)nfd;
+
+    if (setrlimit(RLIMIT_NOFILE, &rl) < 0 || rl.rlim_cur < (rlim_t)nfd)
+        return -1;
+
+    return 0;
+}
+
+
+static double run(mrp_mainloop_backend_t backend, bench_mode_t mode,
+                  int nidle, int nactive, int rounds)
+{
+    mrp_mainloop_t  *ml;
+    mrp_io_watch_t **w;
+    int             *fds;
+    uint64_t         one = 1;
+    double           start, end;
+    int              nfd, i;
+
+    if ((ml = mrp_mainloop_create_backend(backend)) == NULL)
+        return -1;
+
+    if (mrp_mainloop_get_backend(ml) != backend) {
+        mrp_mainloop_destroy(ml);
+        return 0;
+    }
+
+    nfd = nidle + nactive;
+    fds = mrp_allocz_array(int, nfd);
+    w   = mrp_allocz_array(mrp_io_watch_t *, nfd);
+
+    if (fds == NULL || w == NULL)
+        return -1;
+
+    for (i = 0; i < nfd; i++) {
+        if ((fds[i] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+            return -1;
+
+        if (i >= nidle && write(fds[i], &one, sizeof(one)) != sizeof(one))
+            return -1;
+
+        w[i] = mrp_add_io_watch(ml, fds[i], MRP_IO_EVENT_IN, io_cb, NULL);
+
+        if (w[i] == NULL)
+            return -1;
+    }
+
+    if (mode != MODE_NATIVE) {
+        mrp_clear(&glue);
+        glue.ml   = ml;
+        glue.mode = mode;
+
+        if (!mrp_set_superloop(ml, &glue_ops, &glue))
+            return -1;
+    }
+
+    ncallback = 0;
+    start     = now();
+
+    for (i = 0; i < rounds; i++) {
+        if (mode == MODE_NATIVE)
+            mrp_mainloop_iterate(ml);
+        else
+            superloop_iterate(&glue);
+    }
+
+    end = now();
+
+    if (mode != MODE_NATIVE)
+        mrp_clear_superloop(ml);
+
+    for (i = 0; i < nfd; i++) {
+        mrp_del_io_watch(w[i]);
+        close(fds[i]);
+    }
+
+    mrp_free(w);
+    mrp_free(fds);
+    mrp_mainloop_destroy(ml);
+
+    if (ncallback != (long)nactive * rounds) {
+        printf("expected %ld callbacks, got %ld\n", (long)nactive * rounds,
+               ncallback);
+        return -1;
+    }
+
+    return ncallback / (end - start);
+}
+
+
+int main(int argc, char **argv)
+{
+    static struct {
+        const char             *name;
+        mrp_mainloop_backend_t  backend;
+        bench_mode_t            mode;
+    } setups[] = {
+#define EPOLL    MRP_MAINLOOP_BACKEND_EPOLL
+#define IO_URING MRP_MAINLOOP_BACKEND_IO_URING
+        { "native, epoll"   , EPOLL   , MODE_NATIVE      },
+        { "native, io_uring", IO_URING, MODE_NATIVE      },
+        { "superloop, alloc", EPOLL   , MODE_SUPER_ALLOC },
+        { "superloop, reuse", EPOLL   , MODE_SUPER_REUSE },
+#undef EPOLL
+#undef IO_URING
+    };
+    int    nidle, nactive, rounds, i;
+    double rate;
+
+    nidle   = argc > 1 ? atoi(argv[1]) : 10000;
+    nactive = argc > 2 ? atoi(argv[2]) : 100;
+    rounds  = argc > 3 ? atoi(argv[3]) : 20000;
+
+    if (nidle < 0 || nactive <= 0 || rounds <= 0) {
+        printf("usage: %s [idle-fds [active-fds [rounds]]]\n",
+               basename(argv[0]));
+        exit(1);
+    }
+
+    if (raise_fd_limit(nidle + nactive + 64) < 0) {
+        printf("can't raise fd limit for %d fds (%d: %s)\n", nidle + nactive,
+               errno, strerror(errno));
+        exit(1);
+    }
+
+    glue_ops.add_io      = glue_add_io;
+    glue_ops.del_io      = glue_del_io;
+    glue_ops.add_timer   = glue_add_timer;
+    glue_ops.del_timer   = glue_del_timer;
+    glue_ops.mod_timer   = glue_mod_timer;
+    glue_ops.add_defer   = glue_add_defer;
+    glue_ops.del_defer   = glue_del_defer;
+    glue_ops.mod_defer   = glue_mod_defer;
+    glue_ops.unregister  = glue_unregister;
+    glue_ops.poll_io     = glue_poll_io;
+
+    printf("%d idle and %d active fds, %d rounds:\n", nidle, nactive,
+           rounds);
+
+    for (i = 0; i < (int)MRP_ARRAY_SIZE(setups); i++) {
+        rate = run(setups[i].backend, setups[i].mode, nidle, nactive, rounds);
+
+        if (rate < 0)
+            printf("    %-17s: failed\n", setups[i].name);
+        else if (rate == 0)
+            printf("    %-17s: not available\n", setups[i].name);
+        else
+            printf("    %-17s: %6.2fM events/s\n", setups[i].name,
+                   rate / 1000000.0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,396 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mm.h>
+#include <murphy/common/json.h>
+#include <murphy/common/json-stream.h>
+
+#define fatal(fmt, args...) do {                                          \
+        fprintf(stderr, "fatal error: "fmt"\n" , ## args);                \
+        exit(1);                                                          \
+    } while (0)
+
+#define info(fmt, args...) do {                                           \
+        fprintf(stdout, fmt"\n" , ## args);                               \
+    } while (0)
+
+#define DEFAULT_ROUNDS 100000
+
+/*
+ * a typical resource-wrt acquire/release exchange
+ */
+
+static const char *requests[] = {
+    "{ \"type\": \"acquire\", \"seq\": 1234, \"id\": 17 }",
+    "{ \"type\": \"release\", \"seq\": 1235, \"id\": 17 }",
+};
+
+
+static void check_reader(void)
+{
+    char              buf[] =
+        "{ \"a\": 1, \"b\": [ -2, 3.5, true, null, { \"x\": \"y\" } ],"
+        " \"s\": \"tab\\there \\\"quoted\\\" \\u00e9\\ud83d\\ude00\","
+        " \"skip\": { \"deep\": [ [ \"]\" ], { } ] }, \"z\": false }";
+    mrp_json_reader_t r;
+    const char       *key, *s;
+    int               i, n;
+    double            d;
+    bool              b;
+
+    mrp_json_reader_init(&r, buf, sizeof(buf) - 1);
+
+    if (!mrp_json_reader_enter_object(&r))
+        fatal("failed to enter top-level object");
+
+    n = 0;
+    while (mrp_json_reader_next_member(&r, &key)) {
+        if (!strcmp(key, "a")) {
+            if (!mrp_json_reader_get_integer(&r, &i) || i != 1)
+                fatal("failed to read member 'a'");
+        }
+        else if (!strcmp(key, "b")) {
+            if (!mrp_json_reader_enter_array(&r))
+                fatal("failed to enter array 'b'");
+
+            if (!mrp_json_reader_next_element(&r) ||
+                !mrp_json_reader_get_integer(&r, &i) || i != -2)
+                fatal("failed to read b[0]");
+
+            if (!mrp_json_reader_next_element(&r) ||
+                !mrp_json_reader_get_double(&r, &d) || d != 3.5)
+                fatal("failed to read b[1]");
+
+            if (!mrp_json_reader_next_element(&r) ||
+                !mrp_json_reader_get_boolean(&r, &b) || !b)
+                fatal("failed to read b[2]");
+
+            if (!mrp_json_reader_next_element(&r) ||
+                mrp_json_reader_peek(&r) != MRP_JSON_READER_NULL ||
+                !mrp_json_reader_skip(&r))
+                fatal("failed to read b[3]");
+
+            if (!mrp_json_reader_next_element(&r) ||
+                !mrp_json_reader_enter_object(&r) ||
+                !mrp_json_reader_next_member(&r, &key) || strcmp(key, "x") ||
+                !mrp_json_reader_get_string(&r, &s) || strcmp(s, "y") ||
+                mrp_json_reader_next_member(&r, &key))
+                fatal("failed to read b[4]");
+
+            if (mrp_json_reader_next_element(&r))
+                fatal("array 'b' has too many elements");
+        }
+        else if (!strcmp(key, "s")) {
+            if (!mrp_json_reader_get_string(&r, &s) ||
+                strcmp(s, "tab\there \"quoted\" \xc3\xa9\xf0\x9f\x98\x80"))
+                fatal("failed to read/unescape member 's'");
+        }
+        else if (!strcmp(key, "z")) {
+            if (!mrp_json_reader_get_boolean(&r, &b) || b)
+                fatal("failed to read member 'z'");
+        }
+        else {
+            if (!mrp_json_reader_skip(&r))
+                fatal("failed to skip member '%s'", key);
+        }
+
+        n++;
+    }
+
+    if (mrp_json_reader_error(&r) || !mrp_json_reader_done(&r) || n != 5)
+        fatal("reader failed (error %d, %d members)",
+              mrp_json_reader_error(&r), n);
+
+    info("reader tests: OK");
+}
+
+
+static void check_invalid(void)
+{
+    const char *invalid[] = {
+        "{ \"a\": 1, }",
+        "{ \"a\" 1 }",
+        "{ \"a\": [1, 2 } }",
+        "{ \"a\": \"unterminated }",
+        "[ 1, 2",
+        NULL
+    };
+    mrp_json_reader_t  r;
+    const char        *key;
+    char               buf[128];
+    int                i;
+
+    for (i = 0; invalid[i] != NULL; i++) {
+        snprintf(buf, sizeof(buf), "%s", invalid[i]);
+        mrp_json_reader_init(&r, buf, strlen(buf));
+
+        if (mrp_json_reader_peek(&r) == MRP_JSON_READER_OBJECT) {
+            mrp_json_reader_enter_object(&r);
+
+            while (mrp_json_reader_next_member(&r, &key))
+                mrp_json_reader_skip(&r);
+        }
+        else
+            mrp_json_reader_skip(&r);
+
+        if (mrp_json_reader_done(&r))
+            fatal("invalid input '%s' accepted", invalid[i]);
+    }
+
+    info("invalid input tests: OK");
+}
+
+
+static void check_leave(void)
+{
+    char               buf[] = "{ \"a\": [ { \"b\": 1, \"c\": [2, 3] }, 4 ],"
+                               "  \"d\": \"e\" }";
+    mrp_json_reader_t  r;
+    const char        *key, *s;
+    int                depth, i;
+
+    mrp_json_reader_init(&r, buf, strlen(buf));
+
+    if (!mrp_json_reader_enter_object(&r) ||
+        !mrp_json_reader_next_member(&r, &key) || strcmp(key, "a"))
+        fatal("failed to read member 'a'");
+
+    depth = mrp_json_reader_depth(&r);
+
+    if (!mrp_json_reader_enter_array(&r) ||
+        !mrp_json_reader_next_element(&r) ||
+        !mrp_json_reader_enter_object(&r) ||
+        !mrp_json_reader_next_member(&r, &key) ||
+        !mrp_json_reader_get_integer(&r, &i) || i != 1)
+        fatal("failed to read member 'a[0].b'");
+
+    if (!mrp_json_reader_leave(&r, depth))
+        fatal("failed to leave nested containers");
+
+    if (!mrp_json_reader_next_member(&r, &key) || strcmp(key, "d") ||
+        !mrp_json_reader_get_string(&r, &s) || strcmp(s, "e") ||
+        mrp_json_reader_next_member(&r, &key) ||
+        !mrp_json_reader_done(&r))
+        fatal("failed to resume reading after leaving nested containers");
+
+    info("nested container skipping tests: OK");
+}
+
+
+static void check_writer(void)
+{
+    const char        *strs[] = { "foo", "bar" };
+    const char        *expected =
+        "{\"type\":\"event\",\"seq\":-1,\"d\":1.5,\"e\":\"a\\\"b\\n\","
+        "\"arr\":[\"foo\",\"bar\"],\"o\":{},\"b\":true,\"n\":null}";
+    mrp_json_writer_t  w;
+    char               fixed[16];
+    const char        *data;
+    size_t             len;
+
+    mrp_json_writer_init(&w, NULL, 0, 8);
+
+    if (!mrp_json_writer_begin_object(&w) ||
+        !mrp_json_writer_add_string(&w, "type", "event") ||
+        !mrp_json_writer_add_integer(&w, "seq", -1) ||
+        !mrp_json_writer_add_double(&w, "d", 1.5) ||
+        !mrp_json_writer_add_string(&w, "e", "a\"b\n") ||
+        !mrp_json_writer_key(&w, "arr") ||
+        !mrp_json_writer_string_array(&w, strs, 2) ||
+        !mrp_json_writer_key(&w, "o") ||
+        !mrp_json_writer_begin_object(&w) ||
+        !mrp_json_writer_end_object(&w) ||
+        !mrp_json_writer_add_boolean(&w, "b", true) ||
+        !mrp_json_writer_key(&w, "n") ||
+        !mrp_json_writer_null(&w) ||
+        !mrp_json_writer_end_object(&w))
+        fatal("writer failed (%d: %s)", errno, strerror(errno));
+
+    data = mrp_json_writer_data(&w, &len);
+
+    if (data == NULL || len != strlen(expected) || strncmp(data, expected, len))
+        fatal("writer produced '%*.*s', expected '%s'", (int)len, (int)len,
+              data ? data : "", expected);
+
+    if (data - w.buf != 8)
+        fatal("writer headroom not honoured");
+
+    mrp_json_writer_cleanup(&w);
+
+    mrp_json_writer_init(&w, fixed, sizeof(fixed), 0);
+    mrp_json_writer_begin_object(&w);
+    mrp_json_writer_add_string(&w, "overflow", "this does not fit");
+
+    if (mrp_json_writer_error(&w) != ENOBUFS)
+        fatal("fixed buffer overflow not detected");
+
+    info("writer tests: OK");
+}
+
+
+/*
+ * acquire/release exchange benchmark, DOM vs. streaming
+ */
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+
+static size_t dom_exchange(const char *req)
+{
+    mrp_json_t *msg, *reply;
+    const char *type, *s;
+    int         seq, id;
+    size_t      len;
+
+    msg = mrp_json_string_to_object(req, -1);
+
+    if (msg == NULL ||
+        !mrp_json_get_string (msg, "type", &type) ||
+        !mrp_json_get_integer(msg, "seq" , &seq) ||
+        !mrp_json_get_integer(msg, "id"  , &id))
+        fatal("DOM: failed to parse request");
+
+    reply = mrp_json_create(MRP_JSON_OBJECT);
+    mrp_json_add_string (reply, "type"  , type);
+    mrp_json_add_integer(reply, "seq"   , seq);
+    mrp_json_add_integer(reply, "status", 0);
+
+    s = mrp_json_object_to_string_len(reply, &len);
+
+    if (s == NULL)
+        fatal("DOM: failed to serialize reply");
+
+    mrp_json_unref(reply);
+    mrp_json_unref(msg);
+
+    return len;
+}
+
+
+static size_t stream_exchange(const char *req, mrp_json_writer_t *w)
+{
+    mrp_json_reader_t  r;
+    char               buf[256];
+    const char        *key, *type;
+    int                seq, id;
+    size_t             len;
+
+    len = strlen(req);
+    memcpy(buf, req, len);
+    mrp_json_reader_init(&r, buf, len);
+
+    type = NULL;
+    seq  = id = -1;
+
+    if (!mrp_json_reader_enter_object(&r))
+        fatal("stream: failed to parse request");
+
+    while (mrp_json_reader_next_member(&r, &key)) {
+        switch (key[0]) {
+        case 't': mrp_json_reader_get_string(&r, &type); break;
+        case 's': mrp_json_reader_get_integer(&r, &seq); break;
+        case 'i': mrp_json_reader_get_integer(&r, &id);  break;
+        default:  mrp_json_reader_skip(&r);              break;
+        }
+    }
+
+    if (!mrp_json_reader_done(&r) || type == NULL || seq < 0 || id < 0)
+        fatal("stream: failed to parse request");
+
+    mrp_json_writer_reset(w);
+    mrp_json_writer_begin_object(w);
+    mrp_json_writer_add_string(w, "type", type);
+    mrp_json_writer_add_integer(w, "seq", seq);
+    mrp_json_writer_add_integer(w, "status", 0);
+    mrp_json_writer_end_object(w);
+
+    if (mrp_json_writer_data(w, &len) == NULL)
+        fatal("stream: failed to serialize reply");
+
+    return len;
+}
+
+
+static void benchmark(int rounds)
+{
+    mrp_json_writer_t w;
+    double            start, dom, stream;
+    int               i;
+
+    start = now();
+    for (i = 0; i < rounds; i++)
+        dom_exchange(requests[i & 1]);
+    dom = now() - start;
+
+    mrp_json_writer_init(&w, NULL, 0, 0);
+
+    start = now();
+    for (i = 0; i < rounds; i++)
+        stream_exchange(requests[i & 1], &w);
+    stream = now() - start;
+
+    mrp_json_writer_cleanup(&w);
+
+    info("acquire/release exchange, %d messages:", rounds);
+    info("    json-c DOM: %.0f messages/s", rounds / dom);
+    info("    streaming : %.0f messages/s", rounds / stream);
+}
+
+
+int main(int argc, char *argv[])
+{
+    int rounds = DEFAULT_ROUNDS;
+
+    if (argc > 1)
+        rounds = (int)strtol(argv[1], NULL, 10);
+
+    check_reader();
+    check_invalid();
+    check_leave();
+    check_writer();
+
+    if (rounds > 0)
+        benchmark(rounds);
+
+    return 0;
+}
@@ -131,6 +131,7 @@ typedef struct {
     const char *log_target;
 
     int         mainloop_type;
+    int         backend;
 
     mrp_mainloop_t *ml;
     pulse_config_t *pulse;
@@ -1374,6 +1375,7 @@ static void print_usage(const char *argv0, int exit_code, const char *fmt, ...)
            "      LEVELS is a comma separated list of info, error and warning\n"
            "  -v, --verbose                  increase logging verbosity\n"
            "  -d, --debug site               enable debug messages for <site>\n"
+           "  -u, --io-uring                 use the io_uring backend\n"
 #ifdef PULSE_ENABLED
            "  -p, --pulse                    use pulse mainloop\n"
 #endif
@@ -1420,7 +1422,7 @@ int parse_cmdline(test_config_t *cfg, int argc, char **argv)
 #endif
 
 
-#   define OPTIONS "r:i:t:s:I:T:S:M:l:w:W:o:vd:h" \
+#   define OPTIONS "r:i:t:s:I:T:S:M:l:w:W:o:vd:uh" \
         PULSE_OPTION""ECORE_OPTION""GLIB_OPTION""QT_OPTION
     struct option options[] = {
         { "runtime"     , required_argument, NULL, 'r' },
@@ -1449,6 +1451,7 @@ int parse_cmdline(test_config_t *cfg, int argc, char **argv)
         { "log-target"  , required_argument, NULL, 'o' },
         { "verbose"     , optional_argument, NULL, 'v' },
         { "debug"       , required_argument, NULL, 'd' },
+        { "io-uring"    , no_argument      , NULL, 'u' },
         { "help"        , no_argument      , NULL, 'h' },
         { NULL, 0, NULL, 0 }
     };
@@ -1578,6 +1581,10 @@ int parse_cmdline(test_config_t *cfg, int argc, char **argv)
             mrp_debug_enable(TRUE);
             break;
 
+        case 'u':
+            cfg->backend = MRP_MAINLOOP_BACKEND_IO_URING;
+            break;
+
         case 'h':
             print_usage(argv[0], -1, "");
             exit(0);
@@ -1596,7 +1603,7 @@ static mrp_mainloop_t *mainloop_create(test_config_t *cfg)
 {
     switch (cfg->mainloop_type) {
     case MAINLOOP_NATIVE:
-        cfg->ml = mrp_mainloop_create();
+        cfg->ml = mrp_mainloop_create_backend(cfg->backend);
         break;
 
     case MAINLOOP_PULSE:
@@ -28,6 +28,7 @@
  */
 
 #include <stdio.h>
+#include <pthread.h>
 #include <murphy/common/mm.h>
 
 #define fatal(fmt, args...) do {                                          \
@@ -265,6 +266,122 @@ static int pool_tests(void)
 }
 
 
+#define SLAB_SIZE(i) (1 + ((i) * 7) % (MRP_MM_SLAB_MAX + 64))
+
+static int slab_check(void **ptrs, int n)
+{
+    unsigned char *p;
+    size_t         size, j;
+    int            i;
+
+    for (i = 0; i < n; i++) {
+        if ((p = ptrs[i]) == NULL)
+            continue;
+
+        if (((ptrdiff_t)p) & (MRP_MM_ALIGN - 1)) {
+            error("Pooled object %p is misaligned.", p);
+            return FALSE;
+        }
+
+        for (size = SLAB_SIZE(i), j = 0; j < size; j++) {
+            if (p[j] != (unsigned char)i) {
+                error("Pooled object #%d (%p) has been corrupted.", i, p);
+                return FALSE;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+
+static void *slab_thread(void *data)
+{
+    void **ptrs = data;
+    int    i;
+
+    for (i = 0; i < 1024; i++) {
+        ptrs[i] = mrp_allocz_pooled_size(SLAB_SIZE(i));
+
+        if (ptrs[i] != NULL)
+            memset(ptrs[i], i, SLAB_SIZE(i));
+    }
+
+    return NULL;
+}
+
+
+static int slab_tests(int n)
+{
+    void      **ptrs;
+    pthread_t   t;
+    int         i, success;
+
+    ptrs = mrp_allocz(MRP_MAX(n, 1024) * sizeof(*ptrs));
+
+    if (ptrs == NULL)
+        fatal("Failed to allocate pointer table.");
+
+    success = TRUE;
+
+    info("Allocating pooled objects...");
+    for (i = 0; i < n; i++) {
+        if ((ptrs[i] = mrp_allocz_pooled_size(SLAB_SIZE(i))) == NULL) {
+            error("Failed to allocate pooled object #%d.", i);
+            success = FALSE;
+            goto out;
+        }
+
+        memset(ptrs[i], i, SLAB_SIZE(i));
+    }
+
+    if (!slab_check(ptrs, n))
+        success = FALSE;
+
+    info("Freeing and reallocating every other pooled object...");
+    for (i = 0; i < n; i += 2) {
+        mrp_free_pooled_size(ptrs[i], SLAB_SIZE(i));
+        ptrs[i] = NULL;
+    }
+
+    for (i = 0; i < n; i += 2) {
+        ptrs[i] = mrp_allocz_pooled_size(SLAB_SIZE(i));
+
+        if (ptrs[i] != NULL)
+            memset(ptrs[i], i, SLAB_SIZE(i));
+    }
+
+    if (!slab_check(ptrs, n))
+        success = FALSE;
+
+    for (i = 0; i < n; i++) {
+        mrp_free_pooled_size(ptrs[i], SLAB_SIZE(i));
+        ptrs[i] = NULL;
+    }
+
+    info("Freeing pooled objects allocated by another thread...");
+    if (pthread_create(&t, NULL, slab_thread, ptrs) != 0 ||
+        pthread_join(t, NULL) != 0) {
+        error("Failed to run slab allocator test thread.");
+        success = FALSE;
+        goto out;
+    }
+
+    if (!slab_check(ptrs, 1024))
+        success = FALSE;
+
+    for (i = 0; i < 1024; i++)
+        mrp_free_pooled_size(ptrs[i], SLAB_SIZE(i));
+
+    mrp_mm_slab_flush();
+
+ out:
+    mrp_free(ptrs);
+
+    return success;
+}
+
+
 int main(int argc, char *argv[])
 {
     int max;
@@ -280,5 +397,9 @@ int main(int argc, char *argv[])
     info("Running object pool tests...");
     pool_tests();
 
+    info("Running slab allocator tests...");
+    if (!slab_tests(max * 16))
+        return 1;
+
     return 0;
 }
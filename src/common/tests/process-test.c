@@ -30,7 +30,12 @@
 #include <murphy/common.h>
 #include <murphy/common/process.h>
 
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <unistd.h>
+#include <signal.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
@@ -133,17 +138,131 @@ static void test_pid_watch(mrp_mainloop_t *ml)
     }
 }
 
+static int bench_exited;
+
+static void bench_pid_watch(pid_t pid, mrp_process_state_t s, void *userdata)
+{
+    MRP_UNUSED(pid);
+    MRP_UNUSED(s);
+    MRP_UNUSED(userdata);
+
+    bench_exited++;
+}
+
+static uint64_t bench_usecs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void bench_pid_watch_n(mrp_mainloop_t *ml, int n)
+{
+    pid_t *pids;
+    mrp_pid_watch_t **w;
+    uint64_t t0, t1, t2;
+    int nkill;
+    int i;
+
+    if (n <= 0)
+        return;
+
+    pids = mrp_allocz_array(pid_t, n);
+    w = mrp_allocz_array(mrp_pid_watch_t *, n);
+
+    if (!pids || !w)
+        goto out;
+
+    for (i = 0; i < n; i++) {
+        pids[i] = fork();
+
+        if (pids[i] < 0) {
+            printf("fork failed after %d children: %s\n", i, strerror(errno));
+            break;
+        }
+
+        if (pids[i] == 0) {
+            pause();
+            _exit(0);
+        }
+    }
+
+    /* only ever touch the children we actually managed to create */
+    if ((n = i) == 0)
+        goto out;
+
+    nkill = n < 100 ? n : 100;
+
+    t0 = bench_usecs();
+
+    for (i = 0; i < n; i++)
+        w[i] = mrp_pid_set_watch(pids[i], ml, bench_pid_watch, ml);
+
+    t1 = bench_usecs();
+
+    /* time exit notifications, each with all n pids being watched */
+    for (i = 0; i < nkill; i++) {
+        bench_exited = 0;
+        kill(pids[i], SIGKILL);
+        waitpid(pids[i], NULL, 0);
+
+        while (w[i] != NULL && !bench_exited)
+            mrp_mainloop_iterate(ml);
+    }
+
+    t2 = bench_usecs();
+
+    for (i = nkill; i < n; i++) {
+        kill(pids[i], SIGKILL);
+        waitpid(pids[i], NULL, 0);
+    }
+
+    for (i = 0; i < n; i++)
+        mrp_pid_remove_watch(w[i]);
+
+    printf("%5d pids: %8.2f us/watch, %8.2f us/exit event\n", n,
+           (double) (t1 - t0) / n, (double) (t2 - t1) / nkill);
+
+ out:
+    mrp_free(w);
+    mrp_free(pids);
+}
+
+static void bench_pid_watch_all(mrp_mainloop_t *ml, int argc, char **argv)
+{
+    int sizes[] = { 10, 100, 500, 1000, 2000, 5000 };
+    int i;
+
+    printf("pid watch backend: %s\n",
+           getenv("__MURPHY_PID_WATCH") ? getenv("__MURPHY_PID_WATCH") :
+           "default");
+
+    if (argc > 0) {
+        for (i = 0; i < argc; i++)
+            bench_pid_watch_n(ml, (int) strtol(argv[i], NULL, 10));
+    }
+    else {
+        for (i = 0; i < (int) MRP_ARRAY_SIZE(sizes); i++)
+            bench_pid_watch_n(ml, sizes[i]);
+    }
+}
+
 int main(int argc, char **argv) {
     mrp_mainloop_t *ml = mrp_mainloop_create();
 
     if (argc == 2 && strcmp(argv[1], "pid") == 0) {
         test_pid_watch(ml);
     }
+    else if (argc >= 2 && strcmp(argv[1], "pid-bench") == 0) {
+        bench_pid_watch_all(ml, argc - 2, argv + 2);
+    }
     else if (argc == 2 && strcmp(argv[1], "process") == 0) {
         test_process_watch(ml);
     }
     else {
-        printf("Usage: process-watch-test <process|pid>\n");
+        printf("Usage: process-watch-test <process|pid|pid-bench [n...]>\n");
     }
 
     mrp_mainloop_destroy(ml);
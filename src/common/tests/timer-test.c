@@ -0,0 +1,555 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mm.h>
+#include <murphy/common/mainloop.h>
+
+#define fatal(fmt, args...) do {                                          \
+        fprintf(stderr, "fatal error: "fmt"\n" , ## args);                \
+        exit(1);                                                          \
+    } while (0)
+
+#define info(fmt, args...) do {                                           \
+        fprintf(stdout, fmt"\n" , ## args);                               \
+    } while (0)
+
+#define NSECS_PER_USEC  1000ULL
+#define NSECS_PER_MSEC  (1000 * NSECS_PER_USEC)
+#define DEFAULT_TICKS   1000
+
+typedef struct {
+    mrp_mainloop_t *ml;
+    mrp_timer_t    *t;
+    uint64_t        start;                 /* time the timer was added */
+    uint64_t       *ticks;                 /* times of the callbacks */
+    int             nalloc;                /* room in ticks */
+    int             ntick;                 /* number of callbacks */
+    int             busy;                  /* block callback for (us) */
+    int             stall;                 /* block first callback (us) */
+} timer_test_t;
+
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000 * NSECS_PER_MSEC + ts.tv_nsec;
+}
+
+
+static void spin(int usecs)
+{
+    uint64_t end = now_ns() + usecs * NSECS_PER_USEC;
+
+    while (now_ns() < end)
+        ;
+}
+
+
+static void tick_cb(mrp_timer_t *t, void *user_data)
+{
+    timer_test_t *tt = (timer_test_t *)user_data;
+
+    MRP_UNUSED(t);
+
+    if (tt->ntick < tt->nalloc)
+        tt->ticks[tt->ntick] = now_ns();
+
+    if (tt->ntick == 0 && tt->stall)
+        spin(tt->stall);
+    else if (tt->busy)
+        spin(tt->busy);
+
+    if (++tt->ntick >= tt->nalloc)
+        mrp_mainloop_quit(tt->ml, 0);
+}
+
+
+static void run_timer(timer_test_t *tt, mrp_mainloop_t *ml, uint64_t interval,
+                      uint64_t slack, int ntick)
+{
+    tt->ml     = ml;
+    tt->nalloc = ntick;
+    tt->ntick  = 0;
+    tt->ticks  = mrp_allocz_array(uint64_t, ntick);
+
+    if (tt->ticks == NULL)
+        fatal("failed to allocate tick buffer");
+
+    tt->start = now_ns();
+    tt->t     = mrp_add_timer_ns(ml, interval, slack, tick_cb, tt);
+
+    if (tt->t == NULL)
+        fatal("failed to create high-resolution timer");
+
+    mrp_mainloop_run(ml);
+    mrp_del_timer(tt->t);
+}
+
+
+/*
+ * A periodic high-resolution timer must not drift, even if its callback
+ * takes a considerable part of the period. A timer rescheduled from its
+ * dispatch time would run 50 % late here.
+ */
+
+static void check_drift(mrp_mainloop_t *ml, int ntick)
+{
+    timer_test_t tt;
+    uint64_t     interval, elapsed;
+    int          i;
+
+    MRP_UNUSED(ntick);
+
+    mrp_clear(&tt);
+    interval = 2 * NSECS_PER_MSEC;
+    tt.busy  = 1000;
+
+    run_timer(&tt, ml, interval, 0, 50);
+
+    for (i = 0; i < tt.ntick; i++) {
+        if (tt.ticks[i] < tt.start + (i + 1) * interval)
+            fatal("drift: tick #%d triggered early", i);
+    }
+
+    elapsed = tt.ticks[tt.ntick - 1] - tt.start;
+
+    if (elapsed >= (tt.ntick + 10) * interval)
+        fatal("drift: %d ticks of %llu us took %llu us", tt.ntick,
+              (unsigned long long)(interval / NSECS_PER_USEC),
+              (unsigned long long)(elapsed / NSECS_PER_USEC));
+
+    info("drift: %d ticks of %llu us took %llu us: OK", tt.ntick,
+         (unsigned long long)(interval / NSECS_PER_USEC),
+         (unsigned long long)(elapsed / NSECS_PER_USEC));
+
+    mrp_free(tt.ticks);
+}
+
+
+/*
+ * Periods missed altogether are skipped. The expiration pending when the
+ * mainloop stalled triggers once, late, then the timer is back on the grid
+ * of its original period instead of catching up in a burst.
+ */
+
+static void check_missed(mrp_mainloop_t *ml, int ntick)
+{
+    timer_test_t tt;
+    uint64_t     interval, stalled;
+
+    MRP_UNUSED(ntick);
+
+    mrp_clear(&tt);
+    interval = 2 * NSECS_PER_MSEC;
+    tt.stall = 11000;
+
+    run_timer(&tt, ml, interval, 0, 4);
+
+    /* stalled until at least 13 ms, the next periods on the grid are 14 ms
+     * and 16 ms, in a burst we'd see the ones at 6, 8, 10 and 12 ms */
+    stalled = tt.ticks[0] + tt.stall * NSECS_PER_USEC;
+
+    if (tt.ticks[1] < stalled)
+        fatal("missed: second tick triggered during the stall");
+
+    if (tt.ticks[2] < tt.start + 7 * interval ||
+        tt.ticks[3] < tt.start + 8 * interval)
+        fatal("missed: missed periods were triggered in a burst "
+              "(%llu us, %llu us)",
+              (unsigned long long)((tt.ticks[2] - tt.start) / NSECS_PER_USEC),
+              (unsigned long long)((tt.ticks[3] - tt.start) / NSECS_PER_USEC));
+
+    info("missed: ticks at %llu, %llu, %llu and %llu us: OK",
+         (unsigned long long)((tt.ticks[0] - tt.start) / NSECS_PER_USEC),
+         (unsigned long long)((tt.ticks[1] - tt.start) / NSECS_PER_USEC),
+         (unsigned long long)((tt.ticks[2] - tt.start) / NSECS_PER_USEC),
+         (unsigned long long)((tt.ticks[3] - tt.start) / NSECS_PER_USEC));
+
+    mrp_free(tt.ticks);
+}
+
+
+typedef struct {
+    mrp_mainloop_t *ml;
+    mrp_timer_t    *t;
+    uint64_t        interval;              /* new interval, or restart */
+    uint64_t        modified;              /* time of modification */
+    uint64_t        fired;                 /* time of first callback */
+} mod_test_t;
+
+
+static void mod_fired_cb(mrp_timer_t *t, void *user_data)
+{
+    mod_test_t *mt = (mod_test_t *)user_data;
+
+    MRP_UNUSED(t);
+
+    mt->fired = now_ns();
+    mrp_mainloop_quit(mt->ml, 0);
+}
+
+
+static void mod_cb(mrp_timer_t *t, void *user_data)
+{
+    mod_test_t *mt = (mod_test_t *)user_data;
+
+    mrp_del_timer(t);
+
+    mt->modified = now_ns();
+    mrp_mod_timer_ns(mt->t, mt->interval);
+}
+
+
+static void run_mod(mod_test_t *mt, mrp_mainloop_t *ml, uint64_t interval,
+                    uint64_t after, uint64_t modified)
+{
+    mrp_clear(mt);
+    mt->ml       = ml;
+    mt->interval = modified;
+    mt->t        = mrp_add_timer_ns(ml, interval, 0, mod_fired_cb, mt);
+
+    if (mt->t == NULL ||
+        mrp_add_timer_ns(ml, after, 0, mod_cb, mt) == NULL)
+        fatal("failed to create high-resolution timers");
+
+    mrp_mainloop_run(ml);
+    mrp_del_timer(mt->t);
+
+    if (mt->modified == 0)
+        fatal("mod: timer fired before it was modified");
+}
+
+
+static void check_mod(mrp_mainloop_t *ml, int restart)
+{
+    mod_test_t mt;
+    uint64_t   delay;
+
+    if (restart)
+        goto restart;
+
+    /* shortening the interval takes effect from the modification on */
+    run_mod(&mt, ml, 1000 * NSECS_PER_MSEC, 5 * NSECS_PER_MSEC,
+            2 * NSECS_PER_MSEC);
+
+    delay = mt.fired - mt.modified;
+
+    if (delay < 2 * NSECS_PER_MSEC || delay > 500 * NSECS_PER_MSEC)
+        fatal("mod: modified timer fired after %llu us instead of 2000 us",
+              (unsigned long long)(delay / NSECS_PER_USEC));
+
+    info("mod: modified timer fired after %llu us: OK",
+         (unsigned long long)(delay / NSECS_PER_USEC));
+
+    return;
+
+ restart:
+    /* restarting keeps the interval but counts it from the restart */
+    run_mod(&mt, ml, 20 * NSECS_PER_MSEC, 10 * NSECS_PER_MSEC,
+            MRP_TIMER_RESTART_NS);
+
+    delay = mt.fired - mt.modified;
+
+    if (delay < 20 * NSECS_PER_MSEC)
+        fatal("mod: restarted timer fired after %llu us instead of 20000 us",
+              (unsigned long long)(delay / NSECS_PER_USEC));
+
+    info("mod: restarted timer fired after %llu us: OK",
+         (unsigned long long)(delay / NSECS_PER_USEC));
+}
+
+
+typedef struct {
+    uint64_t expire;                       /* earliest expiration */
+    uint64_t fired;                        /* time of first callback */
+    int      iteration;                    /* mainloop iteration of it */
+} slack_timer_t;
+
+static int iteration;
+
+
+static void slack_cb(mrp_timer_t *t, void *user_data)
+{
+    slack_timer_t *st = (slack_timer_t *)user_data;
+
+    if (st->fired == 0) {
+        st->fired     = now_ns();
+        st->iteration = iteration;
+    }
+
+    mrp_del_timer(t);
+}
+
+
+static int run_slack(mrp_mainloop_t *ml, uint64_t slack, slack_timer_t *st)
+{
+    mrp_timer_t *t1, *t2;
+
+    mrp_clear(st + 0);
+    mrp_clear(st + 1);
+
+    st[0].expire = now_ns() + 10 * NSECS_PER_MSEC;
+    st[1].expire = st[0].expire + 2 * NSECS_PER_MSEC;
+
+    t1 = mrp_add_timer_ns(ml, 10 * NSECS_PER_MSEC, 0, slack_cb, st + 0);
+    t2 = mrp_add_timer_ns(ml, 12 * NSECS_PER_MSEC, 0, slack_cb, st + 1);
+
+    if (t1 == NULL || t2 == NULL)
+        fatal("failed to create high-resolution timers");
+
+    mrp_set_timer_slack(t1, slack);
+
+    for (iteration = 0; !st[0].fired || !st[1].fired; iteration++)
+        mrp_mainloop_iterate(ml);
+
+    if (st[0].fired < st[0].expire || st[1].fired < st[1].expire)
+        fatal("slack: timer fired before its expiration");
+
+    return st[0].iteration == st[1].iteration;
+}
+
+
+/*
+ * A timer whose slack window covers the expiration of another one gets
+ * triggered together with that in a single wakeup, but never early.
+ */
+
+static void check_slack(mrp_mainloop_t *ml, int ntick)
+{
+    slack_timer_t st[2];
+
+    MRP_UNUSED(ntick);
+
+    if (run_slack(ml, 0, st))
+        fatal("slack: timers without slack were coalesced");
+
+    if (!run_slack(ml, 5 * NSECS_PER_MSEC, st))
+        fatal("slack: timers with overlapping slack were not coalesced");
+
+    if (st[0].fired > st[0].expire + 5 * NSECS_PER_MSEC + 50 * NSECS_PER_MSEC)
+        fatal("slack: timer fired way beyond its slack");
+
+    info("slack: timers with overlapping slack coalesced: OK");
+}
+
+
+static void print_latency(const char *what, uint64_t *lat, int n)
+{
+    int       i, j;
+    uint64_t  l;
+
+    /* insertion sort, n is small enough */
+    for (i = 1; i < n; i++) {
+        l = lat[i];
+        for (j = i; j > 0 && lat[j - 1] > l; j--)
+            lat[j] = lat[j - 1];
+        lat[j] = l;
+    }
+
+    info("%-20s p50 %6.1f us, p99 %6.1f us, max %6.1f us", what,
+         lat[n / 2] / 1000.0, lat[(n * 99) / 100] / 1000.0,
+         lat[n - 1] / 1000.0);
+}
+
+
+typedef struct {
+    mrp_mainloop_t *ml;
+    uint64_t        prev;                  /* time of previous tick */
+    uint64_t       *period;                /* measured periods */
+    int             ntick;                 /* ticks so far */
+    int             nalloc;                /* ticks to measure */
+} jitter_t;
+
+
+static void jitter_cb(mrp_timer_t *t, void *user_data)
+{
+    jitter_t *j   = (jitter_t *)user_data;
+    uint64_t  now = now_ns();
+
+    MRP_UNUSED(t);
+
+    if (j->prev != 0)
+        j->period[j->ntick++] = now - j->prev;
+
+    j->prev = now;
+
+    if (j->ntick >= j->nalloc)
+        mrp_mainloop_quit(j->ml, 0);
+}
+
+
+static void jitter(mrp_mainloop_t *ml, int hires, int ntick)
+{
+    mrp_timer_t *t;
+    jitter_t     j;
+    uint64_t     sum, *dev;
+    int          i;
+
+    mrp_clear(&j);
+    j.ml     = ml;
+    j.nalloc = ntick;
+    j.period = mrp_allocz_array(uint64_t, ntick);
+    dev      = mrp_allocz_array(uint64_t, ntick);
+
+    if (j.period == NULL || dev == NULL)
+        fatal("failed to allocate jitter buffers");
+
+    if (hires)
+        t = mrp_add_timer_ns(ml, NSECS_PER_MSEC, 0, jitter_cb, &j);
+    else
+        t = mrp_add_timer(ml, 1, jitter_cb, &j);
+
+    if (t == NULL)
+        fatal("failed to create timer");
+
+    mrp_mainloop_run(ml);
+    mrp_del_timer(t);
+
+    for (i = 0, sum = 0; i < ntick; i++) {
+        sum += j.period[i];
+        dev[i] = j.period[i] > NSECS_PER_MSEC ?
+            j.period[i] - NSECS_PER_MSEC : NSECS_PER_MSEC - j.period[i];
+    }
+
+    info("%-20s mean period %.3f ms over %d ticks",
+         hires ? "mrp_add_timer_ns:" : "mrp_add_timer:",
+         sum / 1000000.0 / ntick, ntick);
+    print_latency("  period jitter:", dev, ntick);
+
+    mrp_free(j.period);
+    mrp_free(dev);
+}
+
+
+static void count_cb(mrp_timer_t *t, void *user_data)
+{
+    MRP_UNUSED(t);
+    MRP_UNUSED(user_data);
+}
+
+
+static void wakeups(mrp_mainloop_t *ml, uint64_t slack)
+{
+    static uint64_t intervals[] = { 1000, 1300, 1700 };
+    mrp_timer_t *t[MRP_ARRAY_SIZE(intervals)];
+    uint64_t     end;
+    int          i, n;
+
+    for (i = 0; i < (int)MRP_ARRAY_SIZE(t); i++) {
+        t[i] = mrp_add_timer_ns(ml, intervals[i] * NSECS_PER_USEC, slack,
+                                count_cb, NULL);
+        if (t[i] == NULL)
+            fatal("failed to create high-resolution timer");
+    }
+
+    end = now_ns() + 1000 * NSECS_PER_MSEC;
+    for (n = 0; now_ns() < end; n++)
+        mrp_mainloop_iterate(ml);
+
+    for (i = 0; i < (int)MRP_ARRAY_SIZE(t); i++)
+        mrp_del_timer(t[i]);
+
+    info("1.0/1.3/1.7 ms timers, %4llu us slack: %d wakeups/s",
+         (unsigned long long)(slack / NSECS_PER_USEC), n);
+}
+
+
+static void jitter_legacy(mrp_mainloop_t *ml, int ntick)
+{
+    jitter(ml, FALSE, ntick);
+}
+
+
+static void jitter_hires(mrp_mainloop_t *ml, int ntick)
+{
+    jitter(ml, TRUE, ntick);
+}
+
+
+static void wakeups_noslack(mrp_mainloop_t *ml, int ntick)
+{
+    MRP_UNUSED(ntick);
+
+    wakeups(ml, 0);
+}
+
+
+static void wakeups_slack(mrp_mainloop_t *ml, int ntick)
+{
+    MRP_UNUSED(ntick);
+
+    wakeups(ml, 500 * NSECS_PER_USEC);
+}
+
+
+static void run(void (*test)(mrp_mainloop_t *, int), int ntick)
+{
+    mrp_mainloop_t *ml;
+
+    /* a mainloop can't be run again once it has been quit */
+    if ((ml = mrp_mainloop_create()) == NULL)
+        fatal("failed to create mainloop");
+
+    test(ml, ntick);
+
+    mrp_mainloop_destroy(ml);
+}
+
+
+int main(int argc, char *argv[])
+{
+    int ntick = DEFAULT_TICKS;
+
+    if (argc > 1)
+        ntick = (int)strtol(argv[1], NULL, 10);
+
+    run(check_drift, 0);
+    run(check_missed, 0);
+    run(check_mod, FALSE);
+    run(check_mod, TRUE);
+    run(check_slack, 0);
+
+    if (ntick > 0) {
+        run(jitter_legacy, ntick);
+        run(jitter_hires, ntick);
+        run(wakeups_noslack, 0);
+        run(wakeups_slack, 0);
+    }
+
+    return 0;
+}
@@ -149,6 +149,7 @@ typedef struct {
     mrp_timer_t     *timer;
     int              mode;
     int              buggy;
+    int              async;
     int              connect;
     int              stream;
     int              log_mask;
@@ -561,6 +562,9 @@ void server_init(context_t *c)
 
     flags = MRP_TRANSPORT_REUSEADDR;
 
+    if (c->async)
+        flags |= MRP_TRANSPORT_ASYNC_DECODE;
+
     switch (c->mode) {
     case MODE_DATA:    flags |= MRP_TRANSPORT_MODE_DATA;   break;
     case MODE_RAW:     flags |= MRP_TRANSPORT_MODE_RAW;    break;
@@ -847,6 +851,9 @@ void client_init(context_t *c)
         flags            = MRP_TRANSPORT_MODE_MSG;
     }
 
+    if (c->async)
+        flags |= MRP_TRANSPORT_ASYNC_DECODE;
+
     c->t = mrp_transport_create(c->ml, c->atype, &evt, c, flags);
 
     if (c->t == NULL) {
@@ -912,6 +919,7 @@ static void print_usage(const char *argv0, int exit_code, const char *fmt, ...)
            "  -n, --native                   use native messages\n"
            "  -j, --json                     use JSON messages\n"
            "  -b, --buggy                    use buggy data descriptors\n"
+           "  -A, --async                    decode on I/O worker threads\n"
            "  -t, --log-target=TARGET        log target to use\n"
            "      TARGET is one of stderr,stdout,syslog, or a logfile path\n"
            "  -l, --log-level=LEVELS         logging level to use\n"
@@ -940,7 +948,7 @@ static void config_set_defaults(context_t *ctx)
 
 int parse_cmdline(context_t *ctx, int argc, char **argv)
 {
-#   define OPTIONS "scmrnjbCa:l:t:v:d:h"
+#   define OPTIONS "scmrnjbACa:l:t:v:d:h"
     struct option options[] = {
         { "server"    , no_argument      , NULL, 's' },
         { "address"   , required_argument, NULL, 'a' },
@@ -952,6 +960,7 @@ int parse_cmdline(context_t *ctx, int argc, char **argv)
         { "connect"   , no_argument      , NULL, 'C' },
 
         { "buggy"     , no_argument      , NULL, 'b' },
+        { "async"     , no_argument      , NULL, 'A' },
         { "log-level" , required_argument, NULL, 'l' },
         { "log-target", required_argument, NULL, 't' },
         { "verbose"   , optional_argument, NULL, 'v' },
@@ -1019,6 +1028,10 @@ int parse_cmdline(context_t *ctx, int argc, char **argv)
             ctx->buggy = TRUE;
             break;
 
+        case 'A':
+            ctx->async = TRUE;
+            break;
+
         case 'C':
             ctx->connect = TRUE;
             break;
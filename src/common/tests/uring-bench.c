@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <libgen.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <linux/ptrace.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mainloop.h>
+#include <murphy/common/msg.h>
+#include <murphy/common/transport.h>
+
+/*
+ * Compare the epoll and io_uring mainloop backends by bouncing messages
+ * between a client and a server stream transport, with a number of them
+ * in flight, in a single mainloop. Each backend is run twice in a child
+ * process: once under ptrace(2) to count the system calls made per
+ * message, and once on its own to measure the message rate.
+ */
+
+#define TAG_SEQ     1
+#define TAG_PAYLOAD 2
+
+typedef struct {
+    mrp_mainloop_t  *ml;
+    mrp_transport_t *lt;                 /* listening transport */
+    mrp_transport_t *st;                 /* server side of connection */
+    mrp_transport_t *ct;                 /* client side of connection */
+    const char      *payload;            /* message payload */
+    int              nmsg;               /* messages to send */
+    int              nsent;              /* messages sent */
+    int              nrecv;              /* messages bounced back */
+} bench_t;
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+
+static void fail(const char *what)
+{
+    printf("%s failed (%d: %s)\n", what, errno, strerror(errno));
+    exit(1);
+}
+
+
+static void send_next(bench_t *b)
+{
+    mrp_msg_t *msg;
+
+    msg = mrp_msg_create(MRP_MSG_TAG_UINT32(TAG_SEQ, b->nsent),
+                         MRP_MSG_TAG_STRING(TAG_PAYLOAD, b->payload),
+                         MRP_MSG_FIELD_END);
+
+    if (msg == NULL || !mrp_transport_send(b->ct, msg))
+        fail("sending message");
+
+    mrp_msg_unref(msg);
+    b->nsent++;
+}
+
+
+static void server_recv(mrp_transport_t *t, mrp_msg_t *msg, void *user_data)
+{
+    MRP_UNUSED(user_data);
+
+    if (!mrp_transport_send(t, msg))
+        fail("bouncing message");
+}
+
+
+static void client_recv(mrp_transport_t *t, mrp_msg_t *msg, void *user_data)
+{
+    bench_t *b = user_data;
+
+    MRP_UNUSED(t);
+    MRP_UNUSED(msg);
+
+    b->nrecv++;
+
+    if (b->nsent < b->nmsg)
+        send_next(b);
+    else if (b->nrecv == b->nmsg)
+        mrp_mainloop_quit(b->ml, 0);
+}
+
+
+static void recvfrom_evt(mrp_transport_t *t, mrp_msg_t *msg,
+                         mrp_sockaddr_t *addr, socklen_t addrlen,
+                         void *user_data)
+{
+    MRP_UNUSED(t);
+    MRP_UNUSED(msg);
+    MRP_UNUSED(addr);
+    MRP_UNUSED(addrlen);
+    MRP_UNUSED(user_data);
+}
+
+
+static void closed_evt(mrp_transport_t *t, int error, void *user_data)
+{
+    MRP_UNUSED(t);
+    MRP_UNUSED(error);
+    MRP_UNUSED(user_data);
+
+    printf("connection closed unexpectedly\n");
+    exit(1);
+}
+
+
+static void connection_evt(mrp_transport_t *lt, void *user_data)
+{
+    bench_t *b = user_data;
+
+    if ((b->st = mrp_transport_accept(lt, b, MRP_TRANSPORT_REUSEADDR)) == NULL)
+        fail("accepting connection");
+}
+
+
+/*
+ * Set up the transports, bounce nmsg messages with window of them in
+ * flight, and return the time it took. The bouncing itself is bracketed
+ * by two getppid() calls, which the tracing parent uses as markers.
+ */
+
+static double bounce(mrp_mainloop_backend_t backend, int nmsg, int window)
+{
+    mrp_transport_evt_t  sevt = {
+        { .recvmsg     = server_recv  },
+        { .recvmsgfrom = recvfrom_evt },
+        .closed        = closed_evt,
+        .connection    = connection_evt,
+    };
+    mrp_transport_evt_t  cevt = {
+        { .recvmsg     = client_recv  },
+        { .recvmsgfrom = recvfrom_evt },
+        .closed        = closed_evt,
+        .connection    = NULL,
+    };
+    bench_t              b;
+    mrp_sockaddr_t       addr;
+    socklen_t            alen;
+    char                 name[64], payload[65];
+    double               start, end;
+    int                  i;
+
+    mrp_clear(&b);
+    memset(payload, 'x', sizeof(payload) - 1);
+    payload[sizeof(payload) - 1] = '\0';
+
+    b.payload = payload;
+    b.nmsg    = nmsg;
+
+    snprintf(name, sizeof(name), "unxs:@murphy-uring-bench-%d", getpid());
+
+    if ((b.ml = mrp_mainloop_create_backend(backend)) == NULL)
+        fail("creating mainloop");
+
+    if (mrp_mainloop_get_backend(b.ml) != backend) {
+        printf("backend not available\n");
+        exit(2);
+    }
+
+    b.lt = mrp_transport_create(b.ml, "unxs", &sevt, &b, 0);
+    b.ct = mrp_transport_create(b.ml, "unxs", &cevt, &b, 0);
+    alen = mrp_transport_resolve(NULL, name, &addr, sizeof(addr), NULL);
+
+    if (b.lt == NULL || b.ct == NULL || alen <= 0 ||
+        !mrp_transport_bind(b.lt, &addr, alen) ||
+        !mrp_transport_listen(b.lt, 1) ||
+        !mrp_transport_connect(b.ct, &addr, alen))
+        fail("setting up transports");
+
+    while (b.st == NULL)
+        mrp_mainloop_iterate(b.ml);
+
+    getppid();
+    start = now();
+
+    for (i = 0; i < window && i < nmsg; i++)
+        send_next(&b);
+
+    mrp_mainloop_run(b.ml);
+
+    end = now();
+    getppid();
+
+    mrp_transport_destroy(b.ct);
+    mrp_transport_destroy(b.st);
+    mrp_transport_destroy(b.lt);
+    mrp_mainloop_destroy(b.ml);
+
+    return end - start;
+}
+
+
+/*
+ * Count the system calls a traced child makes between the two markers.
+ */
+
+static long count_syscalls(pid_t pid)
+{
+    struct ptrace_syscall_info info;
+    int                        status, marks;
+    long                       n;
+
+    if (waitpid(pid, &status, 0) < 0 || !WIFSTOPPED(status))
+        return -1;
+
+    ptrace(PTRACE_SETOPTIONS, pid, 0, PTRACE_O_TRACESYSGOOD |
+           PTRACE_O_EXITKILL);
+
+    n     = 0;
+    marks = 0;
+
+    while (ptrace(PTRACE_SYSCALL, pid, 0, 0) == 0) {
+        if (waitpid(pid, &status, 0) < 0 || WIFEXITED(status) ||
+            WIFSIGNALED(status))
+            break;
+
+        if (!WIFSTOPPED(status) || WSTOPSIG(status) != (SIGTRAP | 0x80))
+            continue;
+
+        if (ptrace(PTRACE_GET_SYSCALL_INFO, pid, sizeof(info), &info) <= 0 ||
+            info.op != PTRACE_SYSCALL_INFO_ENTRY)
+            continue;
+
+        if (info.entry.nr == SYS_getppid)
+            marks++;
+        else if (marks == 1)
+            n++;
+    }
+
+    waitpid(pid, &status, 0);
+
+    return marks == 2 ? n : -1;
+}
+
+
+static int run(mrp_mainloop_backend_t backend, int traced, int nmsg,
+               int window, double *result)
+{
+    int    fds[2], status;
+    pid_t  pid;
+    double t;
+
+    if (pipe(fds) < 0)
+        fail("creating pipe");
+
+    fflush(stdout);
+
+    if ((pid = fork()) < 0)
+        fail("forking");
+
+    if (pid == 0) {
+        close(fds[0]);
+
+        if (traced) {
+            if (ptrace(PTRACE_TRACEME, 0, 0, 0) < 0)
+                exit(3);
+            raise(SIGSTOP);
+        }
+
+        t = bounce(backend, nmsg, window);
+
+        if (write(fds[1], &t, sizeof(t)) != sizeof(t))
+            exit(1);
+
+        exit(0);
+    }
+
+    close(fds[1]);
+
+    if (traced)
+        *result = count_syscalls(pid);
+
+    if (read(fds[0], &t, sizeof(t)) != sizeof(t))
+        t = -1;
+
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || t < 0)
+        return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+    if (!traced)
+        *result = nmsg / t;
+
+    return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+    static struct {
+        const char             *name;
+        mrp_mainloop_backend_t  backend;
+    } backends[] = {
+        { "epoll"   , MRP_MAINLOOP_BACKEND_EPOLL    },
+        { "io_uring", MRP_MAINLOOP_BACKEND_IO_URING },
+    };
+    int    nmsg, window, ntrace, i, status;
+    double nsys, rate;
+
+    nmsg   = argc > 1 ? atoi(argv[1]) : 200000;
+    window = argc > 2 ? atoi(argv[2]) : 16;
+    ntrace = nmsg < 10000 ? nmsg : 10000;
+
+    if (nmsg <= 0 || window <= 0) {
+        printf("usage: %s [messages [window]]\n", basename(argv[0]));
+        exit(1);
+    }
+
+    printf("%d messages bounced, %d in flight:\n", nmsg, window);
+
+    for (i = 0; i < (int)MRP_ARRAY_SIZE(backends); i++) {
+        if ((status = run(backends[i].backend, FALSE, nmsg, window,
+                          &rate)) != 0) {
+            printf("    %-8s: %s\n", backends[i].name,
+                   status == 2 ? "not available" : "failed");
+            continue;
+        }
+
+        if (run(backends[i].backend, TRUE, ntrace, window, &nsys) != 0 ||
+            nsys < 0)
+            printf("    %-8s: %9.0f msgs/s, syscalls not counted\n",
+                   backends[i].name, rate);
+        else
+            printf("    %-8s: %9.0f msgs/s, %5.2f syscalls/msg\n",
+                   backends[i].name, rate, nsys / ntrace);
+    }
+
+    return 0;
+}
@@ -0,0 +1,867 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mm.h>
+#include <murphy/common/log.h>
+#include <murphy/common/list.h>
+#include <murphy/common/fragbuf.h>
+#include <murphy/common/json.h>
+#include <murphy/common/transport.h>
+
+#include "transport-worker.h"
+
+#define DEFAULT_THREADS 2                /* default number of workers */
+#define MAX_THREADS     32               /* max. number of workers */
+#define MAX_INFLIGHT    64               /* max. undelivered msgs/connection */
+#define MAX_EVENTS      64               /* max. events per epoll_wait */
+
+/*
+ * A decoded message (or connection closure) queued to the mainloop.
+ */
+
+typedef struct rxitem_s rxitem_t;
+
+struct rxitem_s {
+    rxitem_t              *next;         /* next item in the queue */
+    mrp_transport_async_t *a;            /* connection it was received on */
+    int                    closed;       /* connection closed, see error */
+    int                    error;        /* closing error */
+    mrp_transport_rx_t     rx;           /* decoded message */
+};
+
+
+/*
+ * A multiple producer single consumer queue to a mainloop.
+ *
+ * Workers push decoded messages to the queue with a single atomic
+ * exchange. The mainloop gets woken up through an eventfd and pops
+ * the messages. This is an intrusive Vyukov MPSC queue: it can be
+ * momentarily inconsistent while a producer is between its exchange
+ * and linking in its item, but that producer will then signal the
+ * eventfd once it is done, so the consumer can safely just stop.
+ */
+
+typedef struct {
+    mrp_mainloop_t  *ml;                 /* mainloop we deliver to */
+    int              fd;                 /* eventfd for waking up */
+    mrp_io_watch_t  *iow;                /* I/O watch for fd */
+    rxitem_t        *head;               /* producers push here */
+    rxitem_t        *tail;               /* consumer pops here */
+    rxitem_t         stub;               /* empty queue marker */
+    int              signalled;          /* wakeup pending */
+    mrp_list_hook_t  conns;              /* connections delivering here */
+    mrp_list_hook_t  hook;               /* to list of queues */
+} rxqueue_t;
+
+
+/*
+ * An I/O worker thread.
+ */
+
+typedef struct {
+    pthread_t        tid;                /* worker thread */
+    int              epfd;               /* epoll fd of our connections */
+    int              evfd;               /* eventfd for wakeups */
+    pthread_mutex_t  lock;               /* protects resumed, released */
+    mrp_list_hook_t  resumed;            /* connections to resume */
+    mrp_list_hook_t  released;           /* detached connections */
+    int              stop;               /* asked to exit */
+} worker_t;
+
+
+/*
+ * Asynchronous reader state of a connection.
+ */
+
+struct mrp_transport_async_s {
+    mrp_transport_t          *t;         /* transport, NULL once detached */
+    mrp_transport_async_cb_t  closed;    /* closing callback */
+    int                       fd;        /* socket we read */
+    int                       mode;      /* transport mode */
+    mrp_typemap_t            *map;       /* native type map */
+    mrp_fragbuf_t            *buf;       /* fragment buffer */
+    worker_t                 *w;         /* worker reading us */
+    rxqueue_t                *q;         /* queue we deliver to */
+    pthread_mutex_t           lock;      /* held while reading and decoding */
+    int                       refcnt;    /* references (atomic) */
+    int                       inflight;  /* undelivered messages (atomic) */
+    int                       paused;    /* not rearmed, too much inflight */
+    int                       dead;      /* detached from transport */
+    int                       eof;       /* closed or failed, not rearmed */
+    mrp_list_hook_t           resume;    /* to worker resumed list */
+    mrp_list_hook_t           hook;      /* to worker released list */
+    mrp_list_hook_t           qhook;     /* to queue connection list */
+};
+
+
+static MRP_LIST_HOOK(queues);            /* rx queues per mainloop */
+static worker_t *workers;                /* I/O worker threads */
+static int       nworker;                /* number of worker threads */
+static int       nthread = DEFAULT_THREADS;
+static int       next_worker;            /* worker for next connection */
+static int       nconn;                  /* connections not deleted yet */
+
+
+int mrp_transport_set_decode_threads(int n)
+{
+    if (workers != NULL || n < 1 || n > MAX_THREADS) {
+        errno = workers != NULL ? EBUSY : EINVAL;
+        return FALSE;
+    }
+
+    nthread = n;
+
+    return TRUE;
+}
+
+
+static void async_ref(mrp_transport_async_t *a)
+{
+    __atomic_add_fetch(&a->refcnt, 1, __ATOMIC_RELAXED);
+}
+
+
+static void async_unref(mrp_transport_async_t *a)
+{
+    if (__atomic_sub_fetch(&a->refcnt, 1, __ATOMIC_ACQ_REL) == 0) {
+        mrp_fragbuf_destroy(a->buf);
+        pthread_mutex_destroy(&a->lock);
+        mrp_free(a);
+    }
+}
+
+
+static void queue_push(rxqueue_t *q, rxitem_t *item)
+{
+    rxitem_t *prev;
+
+    item->next = NULL;
+    prev = __atomic_exchange_n(&q->head, item, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, item, __ATOMIC_RELEASE);
+}
+
+
+static rxitem_t *queue_pop(rxqueue_t *q)
+{
+    rxitem_t *tail, *next, *head;
+
+    tail = q->tail;
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    if (tail == &q->stub) {
+        if (next == NULL)
+            return NULL;
+
+        q->tail = tail = next;
+        next    = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    }
+
+    if (next != NULL) {
+        q->tail = next;
+        return tail;
+    }
+
+    head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+
+    if (tail != head)                    /* a push is in progress */
+        return NULL;
+
+    queue_push(q, &q->stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    if (next != NULL) {
+        q->tail = next;
+        return tail;
+    }
+
+    return NULL;
+}
+
+
+static void queue_signal(rxqueue_t *q)
+{
+    uint64_t one = 1;
+
+    if (__atomic_exchange_n(&q->signalled, 1, __ATOMIC_ACQ_REL) == 0) {
+        if (write(q->fd, &one, sizeof(one)) < 0)
+            mrp_log_error("transport: failed to signal mainloop (%d: %s).",
+                          errno, strerror(errno));
+    }
+}
+
+
+static void rearm(mrp_transport_async_t *a)
+{
+    struct epoll_event e;
+
+    e.events   = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    e.data.ptr = a;
+
+    if (epoll_ctl(a->w->epfd, EPOLL_CTL_MOD, a->fd, &e) < 0)
+        mrp_log_error("transport: failed to rearm connection %p (%d: %s).",
+                      a->t, errno, strerror(errno));
+}
+
+
+static void resume(mrp_transport_async_t *a)
+{
+    worker_t *w = a->w;
+    uint64_t  one = 1;
+
+    /*
+     * Let the worker resume us instead of just rearming. It might have
+     * complete frames buffered that no further socket event would wake
+     * it up for.
+     */
+
+    pthread_mutex_lock(&w->lock);
+    if (mrp_list_empty(&a->resume)) {
+        async_ref(a);
+        mrp_list_append(&w->resumed, &a->resume);
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    if (write(w->evfd, &one, sizeof(one)) < 0)
+        mrp_log_error("transport: failed to wake up I/O worker.");
+}
+
+
+static void dispatch_cb(mrp_io_watch_t *w, int fd, mrp_io_event_t events,
+                        void *user_data)
+{
+    rxqueue_t             *q = (rxqueue_t *)user_data;
+    rxitem_t              *item;
+    mrp_transport_async_t *a;
+    mrp_transport_t       *t;
+    uint64_t               cnt;
+    int                    error, inflight;
+
+    MRP_UNUSED(w);
+    MRP_UNUSED(events);
+
+    if (read(fd, &cnt, sizeof(cnt)) < 0 && errno != EAGAIN)
+        mrp_log_error("transport: failed to read wakeup (%d: %s).",
+                      errno, strerror(errno));
+
+    __atomic_store_n(&q->signalled, 0, __ATOMIC_RELEASE);
+
+    while ((item = queue_pop(q)) != NULL) {
+        a = item->a;
+        t = a->t;
+
+        if (t == NULL) {
+            if (!item->closed)
+                mrp_transport_discard(&item->rx);
+        }
+        else if (item->closed)
+            a->closed(t, item->error);
+        else {
+            error = mrp_transport_deliver(t, &item->rx, NULL, 0);
+
+            if (error)
+                a->closed(t, error);
+            else
+                t->check_destroy(t);
+        }
+
+        inflight = __atomic_sub_fetch(&a->inflight, 1, __ATOMIC_SEQ_CST);
+
+        if (inflight <= MAX_INFLIGHT / 2 &&
+            __atomic_load_n(&a->paused, __ATOMIC_SEQ_CST)) {
+            pthread_mutex_lock(&a->lock);
+            if (a->paused && !a->dead && !a->eof) {
+                a->paused = FALSE;
+                resume(a);
+            }
+            pthread_mutex_unlock(&a->lock);
+        }
+
+        async_unref(a);
+        mrp_free(item);
+    }
+}
+
+
+static rxqueue_t *get_queue(mrp_mainloop_t *ml)
+{
+    rxqueue_t       *q;
+    mrp_list_hook_t *p, *n;
+
+    mrp_list_foreach(&queues, p, n) {
+        q = mrp_list_entry(p, typeof(*q), hook);
+
+        if (q->ml == ml)
+            return q;
+    }
+
+    if ((q = mrp_allocz(sizeof(*q))) == NULL)
+        return NULL;
+
+    mrp_list_init(&q->hook);
+    mrp_list_init(&q->conns);
+    q->ml   = ml;
+    q->head = q->tail = &q->stub;
+    q->fd   = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (q->fd < 0) {
+        mrp_free(q);
+        return NULL;
+    }
+
+    q->iow = mrp_add_io_watch(ml, q->fd, MRP_IO_EVENT_IN, dispatch_cb, q);
+
+    if (q->iow == NULL) {
+        close(q->fd);
+        mrp_free(q);
+        return NULL;
+    }
+
+    mrp_list_append(&queues, &q->hook);
+
+    return q;
+}
+
+
+static int push_item(mrp_transport_async_t *a, rxitem_t *item)
+{
+    item->a = a;
+    async_ref(a);
+
+    queue_push(a->q, item);
+    queue_signal(a->q);
+
+    return __atomic_add_fetch(&a->inflight, 1, __ATOMIC_ACQ_REL);
+}
+
+
+static void push_closed(mrp_transport_async_t *a, int error)
+{
+    rxitem_t *item;
+
+    a->eof = TRUE;
+    epoll_ctl(a->w->epfd, EPOLL_CTL_DEL, a->fd, NULL);
+
+    if ((item = mrp_allocz(sizeof(*item))) == NULL) {
+        mrp_log_error("transport: failed to queue closing of connection.");
+        return;
+    }
+
+    item->closed = TRUE;
+    item->error  = error;
+
+    push_item(a, item);
+}
+
+
+static int decode_frames(mrp_transport_async_t *a, int *full)
+{
+    rxitem_t *item;
+    void     *data;
+    size_t    size;
+    int       error, inflight;
+
+    inflight = __atomic_load_n(&a->inflight, __ATOMIC_ACQUIRE);
+
+    data = NULL;
+    size = 0;
+    while (inflight < MAX_INFLIGHT && mrp_fragbuf_pull(a->buf, &data, &size)) {
+        if ((item = mrp_allocz(sizeof(*item))) == NULL)
+            return ENOMEM;
+
+        if (a->mode != MRP_TRANSPORT_MODE_JSON)
+            error = mrp_transport_decode(a->mode, a->map, data, size, TRUE,
+                                         &item->rx);
+        else {
+            item->rx.mode  = a->mode;
+            item->rx.owned = TRUE;
+            item->rx.json  = mrp_json_string_to_object(data, size);
+            error          = item->rx.json != NULL ? 0 : EILSEQ;
+        }
+
+        if (error) {
+            mrp_free(item);
+            return error;
+        }
+
+        inflight = push_item(a, item);
+    }
+
+    /*
+     * A frame is only consumed by the next pull. If we stopped because
+     * of too many messages in flight, consume the last one we decoded.
+     * Any frame that pull returns now stays at the head of the buffer.
+     */
+
+    *full = (inflight >= MAX_INFLIGHT);
+
+    if (*full && data != NULL)
+        mrp_fragbuf_pull(a->buf, &data, &size);
+
+    return 0;
+}
+
+
+static int read_decode(mrp_transport_async_t *a, uint32_t events, int *full)
+{
+    void     *buf;
+    uint32_t  pending;
+    ssize_t   n;
+    int       error;
+
+    /* decode what we have buffered before reading more */
+    if ((error = decode_frames(a, full)) != 0 || *full)
+        return error;
+
+    if (!(events & EPOLLIN))
+        return 0;
+
+    while (ioctl(a->fd, FIONREAD, &pending) == 0 && pending > 0) {
+        buf = mrp_fragbuf_alloc(a->buf, pending);
+
+        if (buf == NULL)
+            return ENOMEM;
+
+        n = read(a->fd, buf, pending);
+
+        if (n >= 0) {
+            if (n < (ssize_t)pending)
+                mrp_fragbuf_trim(a->buf, buf, pending, n);
+        }
+
+        if (n < 0 && errno != EAGAIN)
+            return EIO;
+    }
+
+    return decode_frames(a, full);
+}
+
+
+static void worker_read(mrp_transport_async_t *a, uint32_t events)
+{
+    int error, full;
+
+    for (;;) {
+        full = FALSE;
+
+        if ((error = read_decode(a, events, &full)) != 0) {
+            push_closed(a, error);
+            return;
+        }
+
+        if (!full)
+            break;
+
+        /*
+         * If the mainloop is lagging behind, stop reading until it has
+         * caught up. Either we see it catch up here or it sees us paused
+         * in dispatch and resumes us. A pending hangup is left for later,
+         * epoll reports it again once we're rearmed.
+         */
+
+        __atomic_store_n(&a->paused, TRUE, __ATOMIC_SEQ_CST);
+
+        if (__atomic_load_n(&a->inflight, __ATOMIC_SEQ_CST) > MAX_INFLIGHT / 2)
+            return;
+
+        a->paused = FALSE;
+    }
+
+    if (events & (EPOLLHUP | EPOLLRDHUP | EPOLLERR)) {
+        push_closed(a, 0);
+        return;
+    }
+
+    rearm(a);
+}
+
+
+static void *worker_thread(void *arg)
+{
+    worker_t              *w = (worker_t *)arg;
+    struct epoll_event     events[MAX_EVENTS];
+    mrp_transport_async_t *a;
+    mrp_list_hook_t        released, *p, *n;
+    uint64_t               cnt;
+    int                    nevent, i;
+
+    for (;;) {
+        nevent = epoll_wait(w->epfd, events, MRP_ARRAY_SIZE(events), -1);
+
+        if (nevent < 0) {
+            if (errno == EINTR)
+                continue;
+
+            mrp_log_error("transport: I/O worker failed (%d: %s).",
+                          errno, strerror(errno));
+            break;
+        }
+
+        for (i = 0; i < nevent; i++) {
+            a = events[i].data.ptr;
+
+            if (a == NULL) {
+                if (read(w->evfd, &cnt, sizeof(cnt)) < 0 && errno != EAGAIN)
+                    mrp_log_error("transport: failed to read wakeup.");
+                continue;
+            }
+
+            pthread_mutex_lock(&a->lock);
+            if (!a->dead && !a->eof)
+                worker_read(a, events[i].events);
+            pthread_mutex_unlock(&a->lock);
+        }
+
+        /* decode what paused connections have buffered, then rearm them */
+        for (;;) {
+            pthread_mutex_lock(&w->lock);
+            if (!mrp_list_empty(&w->resumed)) {
+                a = mrp_list_entry(w->resumed.next, typeof(*a), resume);
+                mrp_list_delete(&a->resume);
+            }
+            else
+                a = NULL;
+            pthread_mutex_unlock(&w->lock);
+
+            if (a == NULL)
+                break;
+
+            pthread_mutex_lock(&a->lock);
+            if (!a->dead && !a->eof && !a->paused)
+                worker_read(a, 0);
+            pthread_mutex_unlock(&a->lock);
+
+            async_unref(a);
+        }
+
+        /*
+         * Drop our references to detached connections only once we're
+         * done with the batch of events, which might still refer to them.
+         */
+
+        mrp_list_init(&released);
+
+        pthread_mutex_lock(&w->lock);
+        mrp_list_move(&released, &w->released);
+        pthread_mutex_unlock(&w->lock);
+
+        mrp_list_foreach(&released, p, n) {
+            a = mrp_list_entry(p, typeof(*a), hook);
+            mrp_list_delete(&a->hook);
+            async_unref(a);
+        }
+
+        if (__atomic_load_n(&w->stop, __ATOMIC_ACQUIRE))
+            break;
+    }
+
+    return NULL;
+}
+
+
+static int start_workers(void)
+{
+    struct epoll_event  e;
+    sigset_t            all, old;
+    worker_t           *w;
+    int                 i;
+
+    if (workers != NULL)
+        return TRUE;
+
+    if ((workers = mrp_allocz_array(worker_t, nthread)) == NULL)
+        return FALSE;
+
+    /* keep signals to the mainloop, it might be using a signalfd */
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+
+    for (i = 0; i < nthread; i++) {
+        w = workers + i;
+
+        mrp_list_init(&w->resumed);
+        mrp_list_init(&w->released);
+        pthread_mutex_init(&w->lock, NULL);
+
+        w->epfd = epoll_create1(EPOLL_CLOEXEC);
+        w->evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        if (w->epfd < 0 || w->evfd < 0)
+            goto fail;
+
+        e.events   = EPOLLIN;
+        e.data.ptr = NULL;
+
+        if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, w->evfd, &e) < 0)
+            goto fail;
+
+        if (pthread_create(&w->tid, NULL, worker_thread, w) != 0)
+            goto fail;
+
+        nworker++;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    mrp_log_info("transport: started %d I/O worker threads.", nworker);
+
+    return TRUE;
+
+ fail:
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (w->epfd >= 0)
+        close(w->epfd);
+    if (w->evfd >= 0)
+        close(w->evfd);
+
+    /* use whatever workers we managed to start */
+    if (nworker > 0) {
+        mrp_log_warning("transport: started only %d I/O worker threads.",
+                        nworker);
+        return TRUE;
+    }
+
+    mrp_log_error("transport: failed to start I/O worker threads.");
+
+    mrp_free(workers);
+    workers = NULL;
+
+    return FALSE;
+}
+
+
+static void stop_workers(void)
+{
+    mrp_transport_async_t *a;
+    mrp_list_hook_t       *p, *n;
+    worker_t              *w;
+    uint64_t               one = 1;
+    int                    i;
+
+    if (workers == NULL)
+        return;
+
+    for (i = 0; i < nworker; i++) {
+        w = workers + i;
+
+        __atomic_store_n(&w->stop, TRUE, __ATOMIC_RELEASE);
+
+        if (write(w->evfd, &one, sizeof(one)) < 0)
+            mrp_log_error("transport: failed to stop I/O worker.");
+    }
+
+    for (i = 0; i < nworker; i++) {
+        w = workers + i;
+
+        pthread_join(w->tid, NULL);
+
+        /* drop connections released after the last round of the worker */
+        mrp_list_foreach(&w->released, p, n) {
+            a = mrp_list_entry(p, typeof(*a), hook);
+            mrp_list_delete(&a->hook);
+            async_unref(a);
+        }
+
+        close(w->epfd);
+        close(w->evfd);
+        pthread_mutex_destroy(&w->lock);
+    }
+
+    mrp_log_info("transport: stopped %d I/O worker threads.", nworker);
+
+    mrp_free(workers);
+    workers     = NULL;
+    nworker     = 0;
+    next_worker = 0;
+}
+
+
+static void check_workers(void)
+{
+    /* stop workers once no mainloop or connection can use them */
+    if (nconn == 0 && mrp_list_empty(&queues))
+        stop_workers();
+}
+
+
+mrp_transport_async_t *mrp_transport_async_add(mrp_transport_t *t, int fd,
+                                               mrp_transport_async_cb_t closed)
+{
+    mrp_transport_async_t *a;
+    struct epoll_event     e;
+
+    if (t->mode == MRP_TRANSPORT_MODE_CUSTOM || !start_workers())
+        return NULL;
+
+    if ((a = mrp_allocz(sizeof(*a))) == NULL)
+        return NULL;
+
+    mrp_list_init(&a->resume);
+    mrp_list_init(&a->hook);
+    mrp_list_init(&a->qhook);
+    pthread_mutex_init(&a->lock, NULL);
+
+    a->t      = t;
+    a->closed = closed;
+    a->fd     = fd;
+    a->mode   = t->mode;
+    a->map    = t->map;
+    a->refcnt = 2;                       /* for the transport and worker */
+    a->q      = get_queue(t->ml);
+    a->buf    = mrp_fragbuf_create(TRUE, 0);
+    a->w      = workers + next_worker;
+
+    if (a->q == NULL || a->buf == NULL)
+        goto fail;
+
+    next_worker = (next_worker + 1) % nworker;
+
+    e.events   = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    e.data.ptr = a;
+
+    if (epoll_ctl(a->w->epfd, EPOLL_CTL_ADD, fd, &e) < 0)
+        goto fail;
+
+    mrp_list_append(&a->q->conns, &a->qhook);
+    nconn++;
+
+    mrp_debug("transport %p reading on I/O worker %d", t,
+              (int)(a->w - workers));
+
+    return a;
+
+ fail:
+    mrp_fragbuf_destroy(a->buf);
+    pthread_mutex_destroy(&a->lock);
+    mrp_free(a);
+
+    return NULL;
+}
+
+
+void mrp_transport_async_del(mrp_transport_async_t *a)
+{
+    worker_t *w;
+    uint64_t  one = 1;
+
+    if (a == NULL)
+        return;
+
+    w = a->w;
+
+    epoll_ctl(w->epfd, EPOLL_CTL_DEL, a->fd, NULL);
+
+    /* wait for the worker to finish with us, then cut us loose */
+    pthread_mutex_lock(&a->lock);
+    a->dead = TRUE;
+    a->t    = NULL;
+    pthread_mutex_unlock(&a->lock);
+
+    pthread_mutex_lock(&w->lock);
+    mrp_list_append(&w->released, &a->hook);
+    pthread_mutex_unlock(&w->lock);
+
+    if (write(w->evfd, &one, sizeof(one)) < 0)
+        mrp_log_error("transport: failed to wake up I/O worker.");
+
+    mrp_list_delete(&a->qhook);
+    nconn--;
+
+    async_unref(a);
+
+    check_workers();
+}
+
+
+void mrp_transport_async_purge(mrp_mainloop_t *ml)
+{
+    rxqueue_t             *q;
+    rxitem_t              *item;
+    mrp_transport_async_t *a;
+    mrp_list_hook_t       *p, *n;
+
+    q = NULL;
+    mrp_list_foreach(&queues, p, n) {
+        q = mrp_list_entry(p, typeof(*q), hook);
+
+        if (q->ml == ml)
+            break;
+
+        q = NULL;
+    }
+
+    if (q == NULL)
+        return;
+
+    /*
+     * Cut loose any connections still delivering to this mainloop. Once
+     * we have seen them dead their worker won't queue anything further.
+     * Their transports still delete them, which releases them for good.
+     */
+
+    mrp_list_foreach(&q->conns, p, n) {
+        a = mrp_list_entry(p, typeof(*a), qhook);
+        mrp_list_delete(&a->qhook);
+
+        pthread_mutex_lock(&a->lock);
+        a->dead = TRUE;
+        a->t    = NULL;
+        a->q    = NULL;
+        pthread_mutex_unlock(&a->lock);
+    }
+
+    mrp_del_io_watch(q->iow);
+    close(q->fd);
+
+    while ((item = queue_pop(q)) != NULL) {
+        a = item->a;
+
+        if (!item->closed)
+            mrp_transport_discard(&item->rx);
+
+        __atomic_sub_fetch(&a->inflight, 1, __ATOMIC_SEQ_CST);
+
+        async_unref(a);
+        mrp_free(item);
+    }
+
+    mrp_list_delete(&q->hook);
+    mrp_free(q);
+
+    check_workers();
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MURPHY_TRANSPORT_WORKER_H__
+#define __MURPHY_TRANSPORT_WORKER_H__
+
+#include <murphy/common/macros.h>
+#include <murphy/common/transport.h>
+
+MRP_CDECL_BEGIN
+
+/*
+ * Asynchronous transport decoding.
+ *
+ * Transports created with MRP_TRANSPORT_ASYNC_DECODE have their
+ * connection read and the received frames decoded on a small pool
+ * of I/O worker threads. Decoded messages are queued to the mainloop
+ * of the transport, which delivers them to the transport event
+ * callbacks. All reads and decoding of a single connection are done
+ * by the same worker, so messages of a connection are delivered in
+ * order. The decoding half of this is shared with the synchronous
+ * reception path in transport.c.
+ *
+ * This header is internal to the transport backends.
+ */
+
+/** A received message, decoded but not delivered yet. */
+typedef struct {
+    int mode;                            /* transport mode */
+    int owned;                           /* whether we own raw/json */
+    union {
+        mrp_msg_t  *msg;                 /* MRP_TRANSPORT_MODE_MSG */
+        struct {                         /* MRP_TRANSPORT_MODE_DATA */
+            void     *data;
+            uint16_t  tag;
+        } data;
+        struct {                         /* MRP_TRANSPORT_MODE_RAW */
+            void     *data;
+            size_t    size;
+        } raw;
+        struct {                         /* MRP_TRANSPORT_MODE_NATIVE */
+            void     *data;
+            uint32_t  type_id;
+        } native;
+        void       *custom;              /* MRP_TRANSPORT_MODE_CUSTOM */
+        mrp_json_t *json;                /* MRP_TRANSPORT_MODE_JSON */
+    };
+} mrp_transport_rx_t;
+
+/** Decode received data, copying raw data if asked to. */
+int mrp_transport_decode(int mode, mrp_typemap_t *map, void *data,
+                         size_t size, int copy, mrp_transport_rx_t *rx);
+
+/** Deliver a decoded message to the transport event callbacks. */
+int mrp_transport_deliver(mrp_transport_t *t, mrp_transport_rx_t *rx,
+                          mrp_sockaddr_t *addr, socklen_t addrlen);
+
+/** Free a decoded message that could not be delivered. */
+void mrp_transport_discard(mrp_transport_rx_t *rx);
+
+/** Opaque asynchronous reader state of a connection. */
+typedef struct mrp_transport_async_s mrp_transport_async_t;
+
+/** Callback to close a connection on EOF or a read or decoding error. */
+typedef void (*mrp_transport_async_cb_t)(mrp_transport_t *t, int error);
+
+/** Start reading and decoding framed data from fd on a worker thread. */
+mrp_transport_async_t *mrp_transport_async_add(mrp_transport_t *t, int fd,
+                                               mrp_transport_async_cb_t closed);
+
+/** Stop reading on a worker, discarding any undelivered messages. */
+void mrp_transport_async_del(mrp_transport_async_t *a);
+
+/** Stop delivering to a mainloop being destroyed, discarding its messages. */
+void mrp_transport_async_purge(mrp_mainloop_t *ml);
+
+MRP_CDECL_END
+
+#endif /* __MURPHY_TRANSPORT_WORKER_H__ */
@@ -36,6 +36,8 @@
 #include <murphy/common/native-types.h>
 #include <murphy/common/transport.h>
 
+#include "transport-worker.h"
+
 static int check_destroy(mrp_transport_t *t);
 static int recv_data(mrp_transport_t *t, void *data, size_t size,
                      mrp_sockaddr_t *addr, socklen_t addrlen);
@@ -331,6 +333,7 @@ mrp_transport_t *mrp_transport_accept(mrp_transport_t *lt,
         t->check_destroy = check_destroy;
         t->recv_data     = recv_data;
         t->flags         = (lt->flags & MRP_TRANSPORT_INHERIT) | flags;
+        t->flags        |= (lt->flags & MRP_TRANSPORT_ASYNC_DECODE);
         t->flags         = t->flags & ~MRP_TRANSPORT_MODE_MASK;
         t->mode          = lt->mode;
         t->map           = lt->map;
@@ -668,16 +671,17 @@ int mrp_transport_sendjsonto(mrp_transport_t *t, mrp_json_t *msg,
 }
 
 
-static int recv_data(mrp_transport_t *t, void *data, size_t size,
-                     mrp_sockaddr_t *addr, socklen_t addrlen)
+int mrp_transport_decode(int mode, mrp_typemap_t *map, void *data,
+                         size_t size, int copy, mrp_transport_rx_t *rx)
 {
     mrp_data_descr_t *type;
     uint16_t          tag;
-    mrp_msg_t        *msg;
-    uint32_t          type_id;
     void             *decoded;
 
-    switch (t->mode) {
+    mrp_clear(rx);
+    rx->mode = mode;
+
+    switch (mode) {
     case MRP_TRANSPORT_MODE_DATA:
         tag   = be16toh(*(uint16_t *)data);
         data += sizeof(tag);
@@ -688,19 +692,8 @@ static int recv_data(mrp_transport_t *t, void *data, size_t size,
             decoded = mrp_data_decode(&data, &size, type);
 
             if (decoded != NULL && size == 0) {
-                if (t->connected && t->evt.recvdata) {
-                    MRP_TRANSPORT_BUSY(t, {
-                            t->evt.recvdata(t, decoded, tag, t->user_data);
-                        });
-                }
-                else if (t->evt.recvdatafrom) {
-                    MRP_TRANSPORT_BUSY(t, {
-                            t->evt.recvdatafrom(t, decoded, tag, addr, addrlen,
-                                                t->user_data);
-                        });
-                }
-                else
-                    mrp_free(decoded);         /* no callback, discard */
+                rx->data.data = decoded;
+                rx->data.tag  = tag;
 
                 return 0;
             }
@@ -718,17 +711,14 @@ static int recv_data(mrp_transport_t *t, void *data, size_t size,
         break;
 
     case MRP_TRANSPORT_MODE_RAW:
-        if (t->connected) {
-            MRP_TRANSPORT_BUSY(t, {
-                    t->evt.recvraw(t, data, size, t->user_data);
-                });
-        }
-        else {
-            MRP_TRANSPORT_BUSY(t, {
-                    t->evt.recvrawfrom(t, data, size, addr, addrlen,
-                                       t->user_data);
-                });
+        if (copy) {
+            if ((rx->raw.data = mrp_datadup(data, size)) == NULL && size > 0)
+                return -ENOMEM;
+            rx->owned = TRUE;
         }
+        else
+            rx->raw.data = data;
+        rx->raw.size = size;
         return 0;
 
     case MRP_TRANSPORT_MODE_MSG:
@@ -737,93 +727,200 @@ static int recv_data(mrp_transport_t *t, void *data, size_t size,
         size -= sizeof(tag);
 
         if (tag != MRP_MSG_TAG_DEFAULT ||
-            (msg = mrp_msg_default_decode(data, size)) == NULL) {
+            (rx->msg = mrp_msg_default_decode(data, size)) == NULL)
+            return -EPROTO;
+        else
+            return 0;
+        break;
+
+    case MRP_TRANSPORT_MODE_CUSTOM:
+        rx->custom = data;
+        return 0;
+
+    case MRP_TRANSPORT_MODE_NATIVE:
+        decoded = NULL;
+        if (mrp_decode_native(&data, &size, &decoded, &rx->native.type_id,
+                              map) < 0)
+            return -EPROTO;
+
+        if (decoded == NULL || size != 0) {
+            mrp_free_native(decoded, rx->native.type_id);
             return -EPROTO;
         }
+
+        rx->native.data = decoded;
+        return 0;
+
+    case MRP_TRANSPORT_MODE_JSON:
+        rx->json = data;
+        return 0;
+
+    default:
+        return -EPROTOTYPE;
+    }
+}
+
+
+void mrp_transport_discard(mrp_transport_rx_t *rx)
+{
+    switch (rx->mode) {
+    case MRP_TRANSPORT_MODE_DATA:
+        mrp_free(rx->data.data);
+        break;
+    case MRP_TRANSPORT_MODE_RAW:
+        if (rx->owned)
+            mrp_free(rx->raw.data);
+        break;
+    case MRP_TRANSPORT_MODE_MSG:
+        mrp_msg_unref(rx->msg);
+        break;
+    case MRP_TRANSPORT_MODE_NATIVE:
+        mrp_free_native(rx->native.data, rx->native.type_id);
+        break;
+    case MRP_TRANSPORT_MODE_JSON:
+        if (rx->owned)
+            mrp_json_unref(rx->json);
+        break;
+    default:
+        break;
+    }
+}
+
+
+int mrp_transport_deliver(mrp_transport_t *t, mrp_transport_rx_t *rx,
+                          mrp_sockaddr_t *addr, socklen_t addrlen)
+{
+    int error = 0;
+
+    switch (rx->mode) {
+    case MRP_TRANSPORT_MODE_DATA:
+        if (t->connected && t->evt.recvdata) {
+            MRP_TRANSPORT_BUSY(t, {
+                    t->evt.recvdata(t, rx->data.data, rx->data.tag,
+                                    t->user_data);
+                });
+        }
+        else if (t->evt.recvdatafrom) {
+            MRP_TRANSPORT_BUSY(t, {
+                    t->evt.recvdatafrom(t, rx->data.data, rx->data.tag,
+                                        addr, addrlen, t->user_data);
+                });
+        }
+        else
+            mrp_free(rx->data.data);           /* no callback, discard */
+        break;
+
+    case MRP_TRANSPORT_MODE_RAW:
+        if (t->connected) {
+            MRP_TRANSPORT_BUSY(t, {
+                    t->evt.recvraw(t, rx->raw.data, rx->raw.size,
+                                   t->user_data);
+                });
+        }
         else {
-            if (t->connected) {
-                MRP_TRANSPORT_BUSY(t, {
-                        t->evt.recvmsg(t, msg, t->user_data);
-                    });
-            }
-            else {
-                MRP_TRANSPORT_BUSY(t, {
-                        t->evt.recvmsgfrom(t, msg, addr, addrlen,
-                                           t->user_data);
-                    });
-            }
+            MRP_TRANSPORT_BUSY(t, {
+                    t->evt.recvrawfrom(t, rx->raw.data, rx->raw.size,
+                                       addr, addrlen, t->user_data);
+                });
+        }
 
-            mrp_msg_unref(msg);
+        if (rx->owned)
+            mrp_free(rx->raw.data);
+        break;
 
-            return 0;
+    case MRP_TRANSPORT_MODE_MSG:
+        if (t->connected) {
+            MRP_TRANSPORT_BUSY(t, {
+                    t->evt.recvmsg(t, rx->msg, t->user_data);
+                });
         }
+        else {
+            MRP_TRANSPORT_BUSY(t, {
+                    t->evt.recvmsgfrom(t, rx->msg, addr, addrlen,
+                                       t->user_data);
+                });
+        }
+
+        mrp_msg_unref(rx->msg);
         break;
 
     case MRP_TRANSPORT_MODE_CUSTOM:
         if (t->connected) {
             if (t->evt.recvcustom) {
                 MRP_TRANSPORT_BUSY(t, {
-                        t->evt.recvcustom(t, data, t->user_data);
+                        t->evt.recvcustom(t, rx->custom, t->user_data);
                     });
-
-                return 0;
             }
+            else
+                error = -EPROTOTYPE;
         }
         else {
             if (t->evt.recvcustomfrom) {
                 MRP_TRANSPORT_BUSY(t, {
-                        t->evt.recvcustomfrom(t, data, addr, addrlen,
+                        t->evt.recvcustomfrom(t, rx->custom, addr, addrlen,
                                               t->user_data);
                     });
-
-                return 0;
             }
+            else
+                error = -EPROTOTYPE;
         }
-        return -EPROTOTYPE;
+        break;
 
     case MRP_TRANSPORT_MODE_NATIVE:
-        type_id = 0;
-        if (mrp_decode_native(&data, &size, &decoded, &type_id, t->map) < 0)
-            return -EPROTO;
-
-        if (decoded == NULL || size != 0) {
-            mrp_free_native(decoded, type_id);
-            return -EPROTO;
-        }
-
         if (t->connected) {
             MRP_TRANSPORT_BUSY(t, {
-                    t->evt.recvnative(t, decoded, type_id, t->user_data);
+                    t->evt.recvnative(t, rx->native.data, rx->native.type_id,
+                                      t->user_data);
                 });
         }
         else {
             MRP_TRANSPORT_BUSY(t, {
-                    t->evt.recvnativefrom(t, decoded, type_id, addr, addrlen,
+                    t->evt.recvnativefrom(t, rx->native.data,
+                                          rx->native.type_id, addr, addrlen,
                                           t->user_data);
                 });
         }
-        return 0;
+        break;
 
     case MRP_TRANSPORT_MODE_JSON:
         if (t->connected) {
             if (t->evt.recvjson) {
                 MRP_TRANSPORT_BUSY(t, {
-                        t->evt.recvjson(t, data, t->user_data);
+                        t->evt.recvjson(t, rx->json, t->user_data);
                     });
             }
         }
         else {
             if (t->evt.recvjsonfrom) {
                 MRP_TRANSPORT_BUSY(t, {
-                        t->evt.recvjsonfrom(t, data, addr, addrlen,
+                        t->evt.recvjsonfrom(t, rx->json, addr, addrlen,
                                             t->user_data);
                     });
             }
         }
-        return 0;
+
+        if (rx->owned)
+            mrp_json_unref(rx->json);
+        break;
 
     default:
-        return -EPROTOTYPE;
+        error = -EPROTOTYPE;
     }
+
+    return error;
 }
 
+
+static int recv_data(mrp_transport_t *t, void *data, size_t size,
+                     mrp_sockaddr_t *addr, socklen_t addrlen)
+{
+    mrp_transport_rx_t rx;
+    int                error;
+
+    error = mrp_transport_decode(t->mode, t->map, data, size, FALSE, &rx);
+
+    if (error != 0)
+        return error;
+
+    return mrp_transport_deliver(t, &rx, addr, addrlen);
+}
@@ -116,6 +116,9 @@ typedef enum {
     MRP_TRANSPORT_CLOEXEC   = 0x040,
     MRP_TRANSPORT_CONNECTED = 0x080,
     MRP_TRANSPORT_LISTENED  = 0x001,
+
+    /* read and decode on I/O worker threads (stream transports only) */
+    MRP_TRANSPORT_ASYNC_DECODE = 0x100,
 } mrp_transport_flag_t;
 
 #define MRP_TRANSPORT_MODE(t) ((t)->flags & MRP_TRANSPORT_MODE_MASK)
@@ -554,6 +557,9 @@ int mrp_transport_sendjson(mrp_transport_t *t, mrp_json_t *msg);
 /** Send a JSON message through the given transport to the remote address. */
 int mrp_transport_sendjsonto(mrp_transport_t *t, mrp_json_t *msg,
                              mrp_sockaddr_t *addr, socklen_t addrlen);
+
+/** Set the number of I/O worker threads for MRP_TRANSPORT_ASYNC_DECODE. */
+int mrp_transport_set_decode_threads(int nthread);
 MRP_CDECL_END
 
 #endif /* __MURPHY_TRANSPORT_H__ */
@@ -0,0 +1,1357 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include <murphy/config.h>
+#include <murphy/common/macros.h>
+#include <murphy/common/mm.h>
+#include <murphy/common/log.h>
+#include <murphy/common/debug.h>
+#include <murphy/common/list.h>
+
+#include "uring.h"
+
+#if defined(HAVE_LINUX_IO_URING_H)
+#    include <linux/io_uring.h>
+#endif
+
+#if defined(IORING_RECV_MULTISHOT) && defined(__NR_io_uring_setup)
+
+#define SQ_ENTRIES  256                  /* submission queue size */
+#define BUF_COUNT   128                  /* number of receive buffers */
+#define BUF_SIZE    (8 * 1024)           /* size of a receive buffer */
+#define BUF_GROUP   0                    /* receive buffer group id */
+#define MAX_PENDING (8 * 1024 * 1024)    /* max. queued output per conn */
+
+/*
+ * request types, encoded in the low bits of the request user_data
+ *
+ * Poll requests encode the polled fd and a generation counter in the
+ * rest of user_data, so stale completions for an fd which has been
+ * removed (and maybe re-added) since can be detected. Connection
+ * requests encode a pointer to the connection, which is kept alive
+ * until all of its requests have completed.
+ */
+
+enum {
+    REQ_IGNORE = 0,                      /* completion to ignore */
+    REQ_POLL   = 1,                      /* I/O watch readiness poll */
+    REQ_RECV   = 2,                      /* multishot receive */
+    REQ_ACCEPT = 3,                      /* multishot accept */
+    REQ_SEND   = 4,                      /* send */
+    REQ_MASK   = 0x7,
+};
+
+#define POLL_DATA(fd, gen)                                      \
+    (((uint64_t)(gen) << 32) | ((uint64_t)(fd) << 3) | REQ_POLL)
+#define POLL_FD(data)  ((int)(((data) >> 3) & 0x1fffffff))
+#define POLL_GEN(data) ((uint32_t)((data) >> 32))
+#define CONN_DATA(c, type) ((uint64_t)(ptrdiff_t)(c) | (type))
+#define CONN_PTR(data) ((mrp_uring_conn_t *)(ptrdiff_t)((data) & ~REQ_MASK))
+
+/*
+ * poll state of a single file descriptor
+ */
+
+typedef struct {
+    uint64_t data;                       /* epoll_event data to report */
+    uint32_t events;                     /* polled events, 0 if none */
+    uint32_t gen;                        /* generation of poll request */
+    uint32_t round;                      /* last wait round with an event */
+    int      slot;                       /* event index in that round */
+    int      armed : 1;                  /* poll request in the kernel */
+    int      queued : 1;                 /* queued for (re)arming */
+} fdpoll_t;
+
+
+/*
+ * a completion held back for dispatching
+ */
+
+typedef struct {
+    uint64_t data;                       /* request user_data */
+    int32_t  res;                        /* request result */
+    uint32_t flags;                      /* completion flags */
+} cqe_t;
+
+
+/*
+ * a ring-driven connection (or listening socket)
+ */
+
+struct mrp_uring_conn_s {
+    mrp_list_hook_t        hook;         /* to list of connections */
+    mrp_list_hook_t        flush;        /* to list of conns to flush */
+    mrp_uring_t           *u;            /* ring we belong to */
+    int                    fd;           /* socket, -1 once closed */
+    int                    type;         /* REQ_RECV or REQ_ACCEPT */
+    mrp_uring_recv_cb_t    recv;         /* receive notification */
+    mrp_uring_accept_cb_t  accept;       /* accept notification */
+    void                  *user_data;    /* opaque callback data */
+    int                    ninflight;    /* requests in the kernel */
+    int                    busy;         /* being dispatched */
+    int                    armed : 1;    /* recv/accept request in kernel */
+    int                    eof : 1;      /* no more input */
+    int                    closed : 1;   /* closed by the user */
+    int                    sending : 1;  /* send request in the kernel */
+    int                    error;        /* sticky send error */
+    char                  *out;          /* data being sent */
+    size_t                 outsize;      /* amount of data being sent */
+    size_t                 outdone;      /* amount already sent */
+    size_t                 outalloc;     /* size of out buffer */
+    char                  *pend;         /* data queued for sending */
+    size_t                 npend;        /* amount of data queued */
+    size_t                 pendalloc;    /* size of pend buffer */
+};
+
+
+/*
+ * an io_uring
+ */
+
+struct mrp_uring_s {
+    int                      fd;         /* io_uring fd */
+    void                    *ring;       /* SQ/CQ ring mapping */
+    size_t                   ringsize;   /* size of ring mapping */
+    struct io_uring_sqe     *sqes;       /* submission queue entries */
+    size_t                   sqesize;    /* size of sqes mapping */
+    uint32_t                *sq_head;    /* SQ head (kernel) */
+    uint32_t                *sq_tail;    /* SQ tail (us) */
+    uint32_t                *sq_flags;   /* SQ flags */
+    uint32_t                *sq_array;   /* SQ index array */
+    uint32_t                 sq_mask;    /* SQ ring mask */
+    uint32_t                 sq_entries; /* SQ size */
+    uint32_t                 sqe_tail;   /* next free SQ entry */
+    uint32_t                *cq_head;    /* CQ head (us) */
+    uint32_t                *cq_tail;    /* CQ tail (kernel) */
+    uint32_t                 cq_mask;    /* CQ ring mask */
+    struct io_uring_cqe     *cqes;       /* completion queue entries */
+    fdpoll_t                *polls;      /* poll state per fd */
+    int                      npoll;      /* size of polls */
+    int                     *arm;        /* fds to (re)arm polls for */
+    int                      narm;       /* number of fds to (re)arm */
+    int                      armsize;    /* size of arm */
+    uint32_t                 round;      /* wait round counter */
+    cqe_t                   *cqe;        /* completions to dispatch */
+    int                      ncqe;       /* number of such completions */
+    int                      cqesize;    /* size of cqe */
+    struct io_uring_buf_ring *br;        /* receive buffer ring */
+    uint16_t                 br_tail;    /* receive buffer ring tail */
+    char                    *bufs;       /* receive buffers */
+    int                      conns;      /* connections supported */
+    mrp_list_hook_t          connections;/* active connections */
+    mrp_list_hook_t          flushq;     /* connections to flush */
+};
+
+
+static int sys_setup(unsigned int entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+
+static int sys_enter(int fd, unsigned int to_submit, unsigned int min_complete,
+                     unsigned int flags, void *arg, size_t argsz)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                        flags, arg, argsz);
+}
+
+
+static int sys_register(int fd, unsigned int opcode, void *arg,
+                        unsigned int nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+
+static int enter(mrp_uring_t *u, int wait, int timeout)
+{
+    struct io_uring_getevents_arg  arg;
+    struct timespec                ts;
+    unsigned int                   to_submit, flags, min;
+    int                            n;
+
+    __atomic_store_n(u->sq_tail, u->sqe_tail, __ATOMIC_RELEASE);
+
+    to_submit = u->sqe_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+    flags     = 0;
+    min       = 0;
+
+    if (wait) {
+        flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        min   = 1;
+
+        mrp_clear(&arg);
+
+        if (timeout >= 0) {
+            ts.tv_sec  = timeout / 1000;
+            ts.tv_nsec = (timeout % 1000) * 1000000;
+            arg.ts     = (uint64_t)(ptrdiff_t)&ts;
+        }
+    }
+    else {
+        if (*u->sq_flags & (IORING_SQ_CQ_OVERFLOW | IORING_SQ_TASKRUN))
+            flags = IORING_ENTER_GETEVENTS;
+        else if (to_submit == 0)
+            return 0;
+    }
+
+    n = sys_enter(u->fd, to_submit, min, flags,
+                  wait ? &arg : NULL, wait ? sizeof(arg) : 0);
+
+    if (n < 0 && errno != ETIME && errno != EINTR && errno != EBUSY) {
+        mrp_log_error("io_uring_enter failed (%d: %s).", errno,
+                      strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static struct io_uring_sqe *get_sqe(mrp_uring_t *u)
+{
+    struct io_uring_sqe *sqe;
+    uint32_t             head, idx;
+
+    head = __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+
+    if (u->sqe_tail - head >= u->sq_entries) {
+        enter(u, FALSE, 0);
+        head = __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+
+        if (u->sqe_tail - head >= u->sq_entries) {
+            mrp_log_error("io_uring submission queue full.");
+            return NULL;
+        }
+    }
+
+    idx = u->sqe_tail & u->sq_mask;
+    sqe = u->sqes + idx;
+    u->sq_array[idx] = idx;
+    u->sqe_tail++;
+
+    memset(sqe, 0, sizeof(*sqe));
+
+    return sqe;
+}
+
+
+static int prep_cancel(mrp_uring_t *u, int opcode, uint64_t data)
+{
+    struct io_uring_sqe *sqe;
+
+    if ((sqe = get_sqe(u)) == NULL)
+        return -1;
+
+    sqe->opcode    = opcode;
+    sqe->fd        = -1;
+    sqe->addr      = data;
+    sqe->user_data = REQ_IGNORE;
+
+    return 0;
+}
+
+
+/*
+ * receive buffers
+ */
+
+static void recycle_buffer(mrp_uring_t *u, int bid)
+{
+    struct io_uring_buf *b;
+
+    b = &u->br->bufs[u->br_tail & (BUF_COUNT - 1)];
+    b->addr = (uint64_t)(ptrdiff_t)(u->bufs + (size_t)bid * BUF_SIZE);
+    b->len  = BUF_SIZE;
+    b->bid  = bid;
+
+    u->br_tail++;
+    __atomic_store_n(&u->br->tail, u->br_tail, __ATOMIC_RELEASE);
+}
+
+
+static int setup_buffers(mrp_uring_t *u)
+{
+    struct io_uring_buf_reg reg;
+    size_t                  size;
+    int                     i;
+
+    size  = BUF_COUNT * sizeof(struct io_uring_buf);
+    u->br = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (u->br == MAP_FAILED) {
+        u->br = NULL;
+        return FALSE;
+    }
+
+    u->bufs = mmap(NULL, (size_t)BUF_COUNT * BUF_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (u->bufs == MAP_FAILED) {
+        u->bufs = NULL;
+        return FALSE;
+    }
+
+    mrp_clear(&reg);
+    reg.ring_addr    = (uint64_t)(ptrdiff_t)u->br;
+    reg.ring_entries = BUF_COUNT;
+    reg.bgid         = BUF_GROUP;
+
+    if (sys_register(u->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+        return FALSE;
+
+    for (i = 0; i < BUF_COUNT; i++)
+        recycle_buffer(u, i);
+
+    return TRUE;
+}
+
+
+/*
+ * polling (I/O watches)
+ */
+
+static int prep_poll(mrp_uring_t *u, int fd)
+{
+    fdpoll_t            *p = u->polls + fd;
+    struct io_uring_sqe *sqe;
+
+    if ((sqe = get_sqe(u)) == NULL)
+        return -1;
+
+    sqe->opcode        = IORING_OP_POLL_ADD;
+    sqe->fd            = fd;
+    sqe->poll32_events = p->events & ~(EPOLLET | EPOLLONESHOT);
+    sqe->user_data     = POLL_DATA(fd, p->gen);
+
+    if (p->events & EPOLLET)
+        sqe->len = IORING_POLL_ADD_MULTI;
+
+    p->armed = TRUE;
+
+    return 0;
+}
+
+
+static void queue_poll(mrp_uring_t *u, int fd)
+{
+    fdpoll_t *p = u->polls + fd;
+
+    if (p->queued)
+        return;
+
+    if (u->narm >= u->armsize) {
+        if (!mrp_reallocz(u->arm, u->armsize, u->armsize ? 2 * u->armsize : 64))
+            return;
+        u->armsize = u->armsize ? 2 * u->armsize : 64;
+    }
+
+    u->arm[u->narm++] = fd;
+    p->queued = TRUE;
+}
+
+
+static void unarm_poll(mrp_uring_t *u, int fd)
+{
+    fdpoll_t *p = u->polls + fd;
+
+    if (p->armed) {
+        prep_cancel(u, IORING_OP_POLL_REMOVE, POLL_DATA(fd, p->gen));
+        p->armed = FALSE;
+    }
+
+    p->gen++;
+}
+
+
+int mrp_uring_poll_ctl(mrp_uring_t *u, int op, int fd,
+                       struct epoll_event *evt)
+{
+    fdpoll_t *p;
+    uint32_t  events;
+    int       n;
+
+    if (fd < 0 || fd > 0x1fffffff) {
+        errno = EBADF;
+        return -1;
+    }
+
+    if (fd >= u->npoll) {
+        if (op != EPOLL_CTL_ADD) {
+            errno = ENOENT;
+            return -1;
+        }
+
+        for (n = u->npoll ? u->npoll : 64; n <= fd; n *= 2)
+            ;
+
+        if (!mrp_reallocz(u->polls, u->npoll, n))
+            return -1;
+
+        u->npoll = n;
+    }
+
+    p      = u->polls + fd;
+    events = evt != NULL ? evt->events : 0;
+
+    switch (op) {
+    case EPOLL_CTL_ADD:
+        if (p->events != 0) {
+            errno = EEXIST;
+            return -1;
+        }
+
+        if (fcntl(fd, F_GETFD) < 0)
+            return -1;
+
+        p->events = events;
+        p->data   = evt->data.u64;
+        break;
+
+    case EPOLL_CTL_MOD:
+        if (p->events == 0) {
+            errno = ENOENT;
+            return -1;
+        }
+
+        p->data = evt->data.u64;
+
+        if (p->events == events)
+            return 0;
+
+        unarm_poll(u, fd);
+        p->events = events;
+        break;
+
+    case EPOLL_CTL_DEL:
+        if (p->events == 0) {
+            errno = ENOENT;
+            return -1;
+        }
+
+        unarm_poll(u, fd);
+        p->events = 0;
+        return 0;
+
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+
+    queue_poll(u, fd);
+
+    return 0;
+}
+
+
+/*
+ * Turn a poll completion into an epoll event. Return the new number of
+ * events, or -1 if the completion needs a new event but events is full,
+ * in which case the completion is left unconsumed.
+ */
+
+static int poll_event(mrp_uring_t *u, struct io_uring_cqe *cqe,
+                      struct epoll_event *events, int nevent, int n)
+{
+    int       fd = POLL_FD(cqe->user_data);
+    fdpoll_t *p;
+    uint32_t  revents;
+
+    if (fd >= u->npoll)
+        return n;
+
+    p = u->polls + fd;
+
+    if (p->events == 0 || p->gen != POLL_GEN(cqe->user_data))
+        return n;                        /* stale, removed or modified */
+
+    if (p->round != u->round && n >= nevent)
+        return -1;
+
+    if (cqe->res < 0) {
+        p->armed = FALSE;
+
+        switch (-cqe->res) {
+        case ECANCELED:                  /* not by us, we bump gen */
+        case EINTR:
+        case EAGAIN:
+        case ENOMEM:
+            queue_poll(u, fd);
+            return n;
+
+        default:
+            /* like epoll, report it and leave it to the watch owner */
+            mrp_log_error("io_uring: polling fd %d failed (%d: %s).", fd,
+                          -cqe->res, strerror(-cqe->res));
+            revents = EPOLLERR;
+        }
+    }
+    else {
+        revents = (uint32_t)cqe->res;
+
+        if (!(cqe->flags & IORING_CQE_F_MORE)) {
+            p->armed = FALSE;
+            queue_poll(u, fd);
+        }
+    }
+
+    if (p->round == u->round)
+        events[p->slot].events |= revents;
+    else {
+        p->round = u->round;
+        p->slot  = n;
+
+        events[n].events   = revents;
+        events[n].data.u64 = p->data;
+        n++;
+    }
+
+    return n;
+}
+
+
+/*
+ * connections
+ */
+
+static void queue_flush(mrp_uring_conn_t *c)
+{
+    if (mrp_list_empty(&c->flush))
+        mrp_list_append(&c->u->flushq, &c->flush);
+}
+
+
+static int prep_recv(mrp_uring_conn_t *c)
+{
+    struct io_uring_sqe *sqe;
+
+    if ((sqe = get_sqe(c->u)) == NULL)
+        return -1;
+
+    sqe->fd        = c->fd;
+    sqe->user_data = CONN_DATA(c, c->type);
+
+    if (c->type == REQ_RECV) {
+        sqe->opcode    = IORING_OP_RECV;
+        sqe->ioprio    = IORING_RECV_MULTISHOT;
+        sqe->flags     = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUF_GROUP;
+    }
+    else {
+        sqe->opcode       = IORING_OP_ACCEPT;
+        sqe->ioprio       = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_CLOEXEC;
+    }
+
+    c->armed = TRUE;
+    c->ninflight++;
+
+    return 0;
+}
+
+
+static int prep_send(mrp_uring_conn_t *c)
+{
+    struct io_uring_sqe *sqe;
+
+    if ((sqe = get_sqe(c->u)) == NULL)
+        return -1;
+
+    sqe->opcode    = IORING_OP_SEND;
+    sqe->fd        = c->fd;
+    sqe->addr      = (uint64_t)(ptrdiff_t)(c->out + c->outdone);
+    sqe->len       = c->outsize - c->outdone;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = CONN_DATA(c, REQ_SEND);
+
+    c->sending = TRUE;
+    c->ninflight++;
+
+    return 0;
+}
+
+
+static void close_conn_fd(mrp_uring_conn_t *c)
+{
+    if (c->fd < 0)
+        return;
+
+    if (c->type == REQ_RECV)
+        shutdown(c->fd, SHUT_RDWR);
+
+    close(c->fd);
+    c->fd = -1;
+}
+
+
+static int release_conn(mrp_uring_conn_t *c)
+{
+    if (!c->closed || c->busy)
+        return FALSE;
+
+    if (!c->sending && (c->npend == 0 || c->error))
+        close_conn_fd(c);
+
+    if (c->fd >= 0 || c->ninflight > 0)
+        return FALSE;
+
+    mrp_debug("freeing io_uring connection %p", c);
+
+    mrp_list_delete(&c->hook);
+    mrp_list_delete(&c->flush);
+    mrp_free(c->out);
+    mrp_free(c->pend);
+    mrp_free(c);
+
+    return TRUE;
+}
+
+
+static void flush_conn(mrp_uring_conn_t *c)
+{
+    char   *buf;
+    size_t  size;
+
+    mrp_list_delete(&c->flush);
+
+    if (!c->closed && !c->eof && !c->armed && c->fd >= 0)
+        prep_recv(c);
+
+    if (!c->sending && c->npend > 0 && !c->error && c->fd >= 0) {
+        buf          = c->out;
+        size         = c->outalloc;
+        c->out       = c->pend;
+        c->outalloc  = c->pendalloc;
+        c->outsize   = c->npend;
+        c->outdone   = 0;
+        c->pend      = buf;
+        c->pendalloc = size;
+        c->npend     = 0;
+
+        prep_send(c);
+    }
+}
+
+
+static void flush_queued(mrp_uring_t *u)
+{
+    mrp_list_hook_t  *p, *n;
+    mrp_uring_conn_t *c;
+    fdpoll_t         *fp;
+    int               i, fd;
+
+    for (i = 0; i < u->narm; i++) {
+        fd = u->arm[i];
+        fp = u->polls + fd;
+
+        fp->queued = FALSE;
+
+        if (fp->events != 0 && !fp->armed)
+            prep_poll(u, fd);
+    }
+
+    u->narm = 0;
+
+    mrp_list_foreach(&u->flushq, p, n) {
+        c = mrp_list_entry(p, typeof(*c), flush);
+        flush_conn(c);
+    }
+}
+
+
+static void hold_cqe(mrp_uring_t *u, struct io_uring_cqe *cqe)
+{
+    if (u->ncqe >= u->cqesize) {
+        if (!mrp_reallocz(u->cqe, u->cqesize, u->cqesize ? 2*u->cqesize : 64)) {
+            mrp_log_error("Failed to hold io_uring completion, dropping it.");
+            return;
+        }
+        u->cqesize = u->cqesize ? 2 * u->cqesize : 64;
+    }
+
+    u->cqe[u->ncqe].data  = cqe->user_data;
+    u->cqe[u->ncqe].res   = cqe->res;
+    u->cqe[u->ncqe].flags = cqe->flags;
+    u->ncqe++;
+}
+
+
+static int reap(mrp_uring_t *u, struct epoll_event *events, int nevent)
+{
+    struct io_uring_cqe *cqe;
+    uint32_t             head, tail;
+    int                  n, m;
+
+    u->round++;
+
+    head = *u->cq_head;
+    tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+    n    = 0;
+
+    while (head != tail) {
+        cqe = u->cqes + (head & u->cq_mask);
+
+        switch (cqe->user_data & REQ_MASK) {
+        case REQ_IGNORE:
+            break;
+        case REQ_POLL:
+            if ((m = poll_event(u, cqe, events, nevent, n)) < 0)
+                goto out;
+            n = m;
+            break;
+        default:
+            hold_cqe(u, cqe);
+            break;
+        }
+
+        head++;
+    }
+
+ out:
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+
+    return n;
+}
+
+
+int mrp_uring_submit(mrp_uring_t *u)
+{
+    flush_queued(u);
+
+    return enter(u, FALSE, 0);
+}
+
+
+int mrp_uring_wait(mrp_uring_t *u, struct epoll_event *events, int nevent,
+                   int timeout)
+{
+    uint32_t head, tail;
+
+    flush_queued(u);
+
+    head = *u->cq_head;
+    tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+
+    if (head != tail || u->ncqe > 0)
+        timeout = 0;
+
+    if (enter(u, timeout != 0, timeout) < 0)
+        return -1;
+
+    return reap(u, events, nevent);
+}
+
+
+static void dispatch_recv(mrp_uring_conn_t *c, cqe_t *e)
+{
+    mrp_uring_t *u   = c->u;
+    void        *buf = NULL;
+    int          bid = -1;
+
+    if (!(e->flags & IORING_CQE_F_MORE)) {
+        c->armed = FALSE;
+        c->ninflight--;
+    }
+
+    if (e->flags & IORING_CQE_F_BUFFER) {
+        bid = e->flags >> IORING_CQE_BUFFER_SHIFT;
+        buf = u->bufs + (size_t)bid * BUF_SIZE;
+    }
+
+    if (!c->closed) {
+        c->busy++;
+
+        if (e->res > 0)
+            c->recv(c, buf, e->res, 0, c->user_data);
+        else if (e->res == 0) {
+            c->eof = TRUE;
+            c->recv(c, NULL, 0, 0, c->user_data);
+        }
+        else if (e->res != -ENOBUFS && e->res != -ECANCELED) {
+            c->eof = TRUE;
+            c->recv(c, NULL, 0, -e->res, c->user_data);
+        }
+
+        c->busy--;
+
+        if (!c->closed && !c->eof && !c->armed)
+            queue_flush(c);
+    }
+
+    if (bid >= 0)
+        recycle_buffer(u, bid);
+}
+
+
+static void dispatch_accept(mrp_uring_conn_t *c, cqe_t *e)
+{
+    if (!(e->flags & IORING_CQE_F_MORE)) {
+        c->armed = FALSE;
+        c->ninflight--;
+    }
+
+    if (c->closed) {
+        if (e->res >= 0)
+            close(e->res);
+        return;
+    }
+
+    c->busy++;
+
+    if (e->res >= 0)
+        c->accept(c, e->res, c->user_data);
+    else if (e->res != -ECANCELED) {
+        errno = -e->res;
+        c->accept(c, -1, c->user_data);
+    }
+
+    c->busy--;
+
+    if (!c->closed && !c->armed)
+        queue_flush(c);
+}
+
+
+static void dispatch_send(mrp_uring_conn_t *c, cqe_t *e)
+{
+    c->sending = FALSE;
+    c->ninflight--;
+
+    if (e->res < 0) {
+        c->error = -e->res;
+        c->npend = 0;
+
+        mrp_debug("send on io_uring connection %p failed (%d: %s)", c,
+                  c->error, strerror(c->error));
+
+        if (!c->closed && !c->eof) {
+            c->eof = TRUE;
+            c->busy++;
+            c->recv(c, NULL, 0, c->error, c->user_data);
+            c->busy--;
+        }
+
+        return;
+    }
+
+    c->outdone += e->res;
+
+    if (c->outdone < c->outsize)
+        prep_send(c);
+    else if (c->npend > 0)
+        queue_flush(c);
+}
+
+
+void mrp_uring_dispatch(mrp_uring_t *u)
+{
+    mrp_uring_conn_t *c;
+    cqe_t            *e;
+    int               i;
+
+    for (i = 0; i < u->ncqe; i++) {
+        e = u->cqe + i;
+        c = CONN_PTR(e->data);
+
+        switch (e->data & REQ_MASK) {
+        case REQ_RECV:   dispatch_recv(c, e);   break;
+        case REQ_ACCEPT: dispatch_accept(c, e); break;
+        case REQ_SEND:   dispatch_send(c, e);   break;
+        default:                                break;
+        }
+
+        release_conn(c);
+    }
+
+    u->ncqe = 0;
+}
+
+
+static mrp_uring_conn_t *create_conn(mrp_uring_t *u, int fd, int type,
+                                     void *user_data)
+{
+    mrp_uring_conn_t *c;
+
+    if (!u->conns) {
+        errno = EOPNOTSUPP;
+        return NULL;
+    }
+
+    if ((c = mrp_allocz(sizeof(*c))) == NULL)
+        return NULL;
+
+    mrp_list_init(&c->hook);
+    mrp_list_init(&c->flush);
+    c->u         = u;
+    c->fd        = fd;
+    c->type      = type;
+    c->user_data = user_data;
+
+    mrp_list_append(&u->connections, &c->hook);
+    queue_flush(c);
+
+    return c;
+}
+
+
+mrp_uring_conn_t *mrp_uring_recv(mrp_uring_t *u, int fd,
+                                 mrp_uring_recv_cb_t cb, void *user_data)
+{
+    mrp_uring_conn_t *c = create_conn(u, fd, REQ_RECV, user_data);
+
+    if (c != NULL)
+        c->recv = cb;
+
+    return c;
+}
+
+
+mrp_uring_conn_t *mrp_uring_accept(mrp_uring_t *u, int fd,
+                                   mrp_uring_accept_cb_t cb, void *user_data)
+{
+    mrp_uring_conn_t *c = create_conn(u, fd, REQ_ACCEPT, user_data);
+
+    if (c != NULL)
+        c->accept = cb;
+
+    return c;
+}
+
+
+int mrp_uring_send(mrp_uring_conn_t *c, const struct iovec *iov, int iovcnt)
+{
+    size_t size, need, alloc;
+    int    i;
+
+    if (c->closed || c->error || c->fd < 0) {
+        errno = c->error ? c->error : EPIPE;
+        return FALSE;
+    }
+
+    for (i = 0, size = 0; i < iovcnt; i++)
+        size += iov[i].iov_len;
+
+    need = c->npend + size;
+
+    if (need > MAX_PENDING) {
+        errno = EAGAIN;
+        return FALSE;
+    }
+
+    if (need > c->pendalloc) {
+        for (alloc = c->pendalloc ? c->pendalloc : 4096; alloc < need; )
+            alloc *= 2;
+
+        if (!mrp_realloc(c->pend, alloc))
+            return FALSE;
+
+        c->pendalloc = alloc;
+    }
+
+    for (i = 0; i < iovcnt; i++) {
+        memcpy(c->pend + c->npend, iov[i].iov_base, iov[i].iov_len);
+        c->npend += iov[i].iov_len;
+    }
+
+    queue_flush(c);
+
+    return TRUE;
+}
+
+
+void mrp_uring_close(mrp_uring_conn_t *c)
+{
+    if (c == NULL || c->closed)
+        return;
+
+    mrp_debug("closing io_uring connection %p", c);
+
+    c->closed = TRUE;
+
+    if (c->armed)
+        prep_cancel(c->u, IORING_OP_ASYNC_CANCEL, CONN_DATA(c, c->type));
+
+    release_conn(c);
+}
+
+
+/*
+ * ring setup and teardown
+ */
+
+static void probe_recv(mrp_uring_conn_t *c, void *data, size_t size,
+                       int error, void *user_data)
+{
+    MRP_UNUSED(c);
+    MRP_UNUSED(data);
+    MRP_UNUSED(size);
+    MRP_UNUSED(error);
+    MRP_UNUSED(user_data);
+}
+
+
+static int probe_conns(mrp_uring_t *u)
+{
+    mrp_uring_conn_t   *c;
+    struct epoll_event  e;
+    int                 sv[2], ok, i;
+    char                byte = 0;
+
+    /*
+     * Check that provided buffer rings and multishot receive work by
+     * receiving a single byte over a socketpair.
+     */
+
+    if (!setup_buffers(u))
+        return FALSE;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0)
+        return FALSE;
+
+    u->conns = TRUE;
+    ok       = FALSE;
+
+    if ((c = mrp_uring_recv(u, sv[0], probe_recv, NULL)) == NULL) {
+        close(sv[0]);
+        close(sv[1]);
+        u->conns = FALSE;
+        return FALSE;
+    }
+
+    if (write(sv[1], &byte, 1) == 1) {
+        for (i = 0; i < 10 && u->ncqe == 0; i++)
+            mrp_uring_wait(u, &e, 1, 100);
+
+        ok = (u->ncqe > 0 && u->cqe[0].res == 1 &&
+              (u->cqe[0].flags & IORING_CQE_F_MORE));
+    }
+
+    mrp_uring_dispatch(u);
+    mrp_uring_close(c);
+
+    for (i = 0; i < 10 && !mrp_list_empty(&u->connections); i++) {
+        mrp_uring_wait(u, &e, 1, 100);
+        mrp_uring_dispatch(u);
+    }
+
+    close(sv[1]);
+
+    u->conns = ok && mrp_list_empty(&u->connections);
+
+    return u->conns;
+}
+
+
+mrp_uring_t *mrp_uring_create(void)
+{
+    struct io_uring_params  params;
+    mrp_uring_t            *u;
+    uint32_t                required;
+    size_t                  sqsize, cqsize;
+    char                   *ring;
+
+    if ((u = mrp_allocz(sizeof(*u))) == NULL)
+        return NULL;
+
+    mrp_list_init(&u->connections);
+    mrp_list_init(&u->flushq);
+
+    mrp_clear(&params);
+    params.flags = IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG;
+
+    u->fd = sys_setup(SQ_ENTRIES, &params);
+
+    if (u->fd < 0 && errno == EINVAL) {
+        mrp_clear(&params);
+        u->fd = sys_setup(SQ_ENTRIES, &params);
+    }
+
+    if (u->fd < 0)
+        goto fail;
+
+    required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP |
+        IORING_FEAT_EXT_ARG;
+
+    if ((params.features & required) != required) {
+        errno = EOPNOTSUPP;
+        goto fail;
+    }
+
+    sqsize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    cqsize = params.cq_off.cqes +
+        params.cq_entries * sizeof(struct io_uring_cqe);
+
+    u->ringsize = MRP_MAX(sqsize, cqsize);
+    u->ring     = mmap(NULL, u->ringsize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+
+    if (u->ring == MAP_FAILED) {
+        u->ring = NULL;
+        goto fail;
+    }
+
+    u->sqesize = params.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes    = mmap(NULL, u->sqesize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+
+    if (u->sqes == MAP_FAILED) {
+        u->sqes = NULL;
+        goto fail;
+    }
+
+    ring = u->ring;
+
+    u->sq_head    = (uint32_t *)(ring + params.sq_off.head);
+    u->sq_tail    = (uint32_t *)(ring + params.sq_off.tail);
+    u->sq_flags   = (uint32_t *)(ring + params.sq_off.flags);
+    u->sq_array   = (uint32_t *)(ring + params.sq_off.array);
+    u->sq_mask    = *(uint32_t *)(ring + params.sq_off.ring_mask);
+    u->sq_entries = params.sq_entries;
+    u->sqe_tail   = *u->sq_tail;
+    u->cq_head    = (uint32_t *)(ring + params.cq_off.head);
+    u->cq_tail    = (uint32_t *)(ring + params.cq_off.tail);
+    u->cq_mask    = *(uint32_t *)(ring + params.cq_off.ring_mask);
+    u->cqes       = (struct io_uring_cqe *)(ring + params.cq_off.cqes);
+
+    if (!probe_conns(u))
+        mrp_log_info("io_uring: multishot receive not available, stream "
+                     "transports will use readiness polling.");
+
+    mrp_debug("created io_uring %p (fd %d, %u SQ entries, %u CQ entries)", u,
+              u->fd, params.sq_entries, params.cq_entries);
+
+    return u;
+
+ fail:
+    mrp_uring_destroy(u);
+    return NULL;
+}
+
+
+static void drain_output(mrp_uring_t *u)
+{
+    mrp_list_hook_t  *p, *n;
+    mrp_uring_conn_t *c;
+    int               i;
+
+    /*
+     * Cancel all polls, so their completions get dropped as stale while
+     * we wait, instead of waking us up or getting stuck in the ring.
+     */
+
+    for (i = 0; i < u->npoll; i++) {
+        if (u->polls[i].events != 0) {
+            unarm_poll(u, i);
+            u->polls[i].events = 0;
+        }
+    }
+
+    mrp_list_foreach(&u->connections, p, n) {
+        c = mrp_list_entry(p, typeof(*c), hook);
+        mrp_uring_close(c);
+    }
+
+    /*
+     * Wait for pending output to get flushed and for cancelled requests
+     * to complete. The latter drops the ring's references to the files,
+     * so sockets are really gone once we're done here.
+     */
+
+    for (i = 0; i < 10 && !mrp_list_empty(&u->connections); i++) {
+        mrp_uring_wait(u, NULL, 0, 100);
+        mrp_uring_dispatch(u);
+    }
+}
+
+
+void mrp_uring_destroy(mrp_uring_t *u)
+{
+    mrp_list_hook_t  *p, *n;
+    mrp_uring_conn_t *c;
+
+    if (u == NULL)
+        return;
+
+    if (u->ring != NULL && u->sqes != NULL)
+        drain_output(u);
+
+    if (u->fd >= 0)
+        close(u->fd);
+
+    mrp_list_foreach(&u->connections, p, n) {
+        c = mrp_list_entry(p, typeof(*c), hook);
+
+        close_conn_fd(c);
+        mrp_list_delete(&c->hook);
+        mrp_free(c->out);
+        mrp_free(c->pend);
+        mrp_free(c);
+    }
+
+    if (u->ring != NULL)
+        munmap(u->ring, u->ringsize);
+    if (u->sqes != NULL)
+        munmap(u->sqes, u->sqesize);
+    if (u->br != NULL)
+        munmap(u->br, BUF_COUNT * sizeof(struct io_uring_buf));
+    if (u->bufs != NULL)
+        munmap(u->bufs, (size_t)BUF_COUNT * BUF_SIZE);
+
+    mrp_free(u->polls);
+    mrp_free(u->arm);
+    mrp_free(u->cqe);
+    mrp_free(u);
+}
+
+
+int mrp_uring_fd(mrp_uring_t *u)
+{
+    return u->fd;
+}
+
+
+#else /* !IORING_RECV_MULTISHOT */
+
+mrp_uring_t *mrp_uring_create(void)
+{
+    errno = ENOSYS;
+    return NULL;
+}
+
+
+void mrp_uring_destroy(mrp_uring_t *u)
+{
+    MRP_UNUSED(u);
+}
+
+
+int mrp_uring_fd(mrp_uring_t *u)
+{
+    MRP_UNUSED(u);
+
+    return -1;
+}
+
+
+int mrp_uring_poll_ctl(mrp_uring_t *u, int op, int fd,
+                       struct epoll_event *evt)
+{
+    MRP_UNUSED(u);
+    MRP_UNUSED(op);
+    MRP_UNUSED(fd);
+    MRP_UNUSED(evt);
+
+    errno = ENOSYS;
+    return -1;
+}
+
+
+int mrp_uring_submit(mrp_uring_t *u)
+{
+    MRP_UNUSED(u);
+
+    errno = ENOSYS;
+    return -1;
+}
+
+
+int mrp_uring_wait(mrp_uring_t *u, struct epoll_event *events, int nevent,
+                   int timeout)
+{
+    MRP_UNUSED(u);
+    MRP_UNUSED(events);
+    MRP_UNUSED(nevent);
+    MRP_UNUSED(timeout);
+
+    errno = ENOSYS;
+    return -1;
+}
+
+
+void mrp_uring_dispatch(mrp_uring_t *u)
+{
+    MRP_UNUSED(u);
+}
+
+
+mrp_uring_conn_t *mrp_uring_recv(mrp_uring_t *u, int fd,
+                                 mrp_uring_recv_cb_t cb, void *user_data)
+{
+    MRP_UNUSED(u);
+    MRP_UNUSED(fd);
+    MRP_UNUSED(cb);
+    MRP_UNUSED(user_data);
+
+    errno = EOPNOTSUPP;
+    return NULL;
+}
+
+
+mrp_uring_conn_t *mrp_uring_accept(mrp_uring_t *u, int fd,
+                                   mrp_uring_accept_cb_t cb, void *user_data)
+{
+    MRP_UNUSED(u);
+    MRP_UNUSED(fd);
+    MRP_UNUSED(cb);
+    MRP_UNUSED(user_data);
+
+    errno = EOPNOTSUPP;
+    return NULL;
+}
+
+
+int mrp_uring_send(mrp_uring_conn_t *c, const struct iovec *iov, int iovcnt)
+{
+    MRP_UNUSED(c);
+    MRP_UNUSED(iov);
+    MRP_UNUSED(iovcnt);
+
+    errno = EOPNOTSUPP;
+    return FALSE;
+}
+
+
+void mrp_uring_close(mrp_uring_conn_t *c)
+{
+    MRP_UNUSED(c);
+}
+
+#endif /* !IORING_RECV_MULTISHOT */
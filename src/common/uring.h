@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MURPHY_URING_H__
+#define __MURPHY_URING_H__
+
+#include <stdint.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mainloop.h>
+
+MRP_CDECL_BEGIN
+
+/*
+ * io_uring mainloop backend.
+ *
+ * With the io_uring backend the mainloop waits for I/O watch readiness
+ * using poll requests instead of epoll. Level-triggered watches use
+ * oneshot polls which are rearmed before the next wait, edge-triggered
+ * ones use multishot polls. Completed polls are translated back to
+ * epoll events, so event dispatching is shared with the epoll backend.
+ * All pending submissions are passed to the kernel in a single system
+ * call together with waiting for completions.
+ *
+ * Stream transports also use the ring directly for connections: they
+ * accept with multishot accept, receive with multishot recv into a
+ * ring of kernel-provided buffers, and coalesce and batch their sends.
+ *
+ * This header is internal to the mainloop and the transport backends.
+ */
+
+typedef struct mrp_uring_s      mrp_uring_t;
+typedef struct mrp_uring_conn_s mrp_uring_conn_t;
+
+/** Create a ring, or fail with ENOSYS/EOPNOTSUPP if it is unusable. */
+mrp_uring_t *mrp_uring_create(void);
+
+/** Destroy a ring, flushing any pending output and closing connections. */
+void mrp_uring_destroy(mrp_uring_t *u);
+
+/** Get the file descriptor of a ring (readable if completions pending). */
+int mrp_uring_fd(mrp_uring_t *u);
+
+/** Poll for events on an fd, epoll_ctl(2)-style, reporting evt->data. */
+int mrp_uring_poll_ctl(mrp_uring_t *u, int op, int fd,
+                       struct epoll_event *evt);
+
+/** Submit pending requests without waiting for completions. */
+int mrp_uring_submit(mrp_uring_t *u);
+
+/** Submit pending requests and wait for I/O events, epoll_wait(2)-style. */
+int mrp_uring_wait(mrp_uring_t *u, struct epoll_event *events, int nevent,
+                   int timeout);
+
+/** Dispatch completed connection requests. */
+void mrp_uring_dispatch(mrp_uring_t *u);
+
+/** Get the ring of a mainloop, if it is using the io_uring backend. */
+mrp_uring_t *mrp_mainloop_get_uring(mrp_mainloop_t *ml);
+
+/** Data received on a connection (error set or size 0 on EOF). */
+typedef void (*mrp_uring_recv_cb_t)(mrp_uring_conn_t *c, void *data,
+                                    size_t size, int error, void *user_data);
+
+/** Connection accepted on a listening socket (fd < 0 on error). */
+typedef void (*mrp_uring_accept_cb_t)(mrp_uring_conn_t *c, int fd,
+                                      void *user_data);
+
+/** Start receiving on a connected socket, or return NULL if unsupported. */
+mrp_uring_conn_t *mrp_uring_recv(mrp_uring_t *u, int fd,
+                                 mrp_uring_recv_cb_t cb, void *user_data);
+
+/** Start accepting on a listening socket, or return NULL if unsupported. */
+mrp_uring_conn_t *mrp_uring_accept(mrp_uring_t *u, int fd,
+                                   mrp_uring_accept_cb_t cb, void *user_data);
+
+/** Queue data for sending on a connection. */
+int mrp_uring_send(mrp_uring_conn_t *c, const struct iovec *iov, int iovcnt);
+
+/** Stop using a connection, taking over its fd to close after flushing. */
+void mrp_uring_close(mrp_uring_conn_t *c);
+
+MRP_CDECL_END
+
+#endif /* __MURPHY_URING_H__ */
@@ -89,6 +89,55 @@ int mrp_websock_send(mrp_websock_t *sck, void *payload, size_t size)
 }
 
 
+int mrp_websock_send_padded(mrp_websock_t *sck, void *payload, size_t size)
+{
+    return wsl_send_padded(sck, payload, size);
+}
+
+
+mrp_websock_frame_t *mrp_websock_frame_create(size_t size)
+{
+    return wsl_frame_create(size);
+}
+
+
+void *mrp_websock_frame_data(mrp_websock_frame_t *f)
+{
+    return wsl_frame_data(f);
+}
+
+
+mrp_websock_frame_t *mrp_websock_frame_ref(mrp_websock_frame_t *f)
+{
+    return wsl_frame_ref(f);
+}
+
+
+void mrp_websock_frame_unref(mrp_websock_frame_t *f)
+{
+    wsl_frame_unref(f);
+}
+
+
+int mrp_websock_send_frame(mrp_websock_t *sck, mrp_websock_frame_t *f)
+{
+    return wsl_send_frame(sck, f);
+}
+
+
+int mrp_websock_broadcast_frame(mrp_websock_t **scks, int nsck,
+                                mrp_websock_frame_t *f)
+{
+    return wsl_broadcast_frame(scks, nsck, f);
+}
+
+
+int mrp_websock_set_queue_limit(mrp_websock_t *sck, int limit)
+{
+    return wsl_set_queue_limit(sck, limit);
+}
+
+
 int mrp_websock_server_http_file(mrp_websock_t *sck, const char *path,
                                  const char *mime)
 {
@@ -45,6 +45,10 @@ typedef wsl_sck_t       mrp_websock_t;
 typedef wsl_callbacks_t mrp_websock_evt_t;
 typedef wsl_proto_t     mrp_websock_proto_t;
 typedef wsl_ssl_t       mrp_wsl_ssl_t;
+typedef wsl_frame_t     mrp_websock_frame_t;
+
+#define MRP_WEBSOCK_PRE_PADDING  WSL_SEND_PRE_PADDING
+#define MRP_WEBSOCK_POST_PADDING WSL_SEND_POST_PADDING
 
 /*
  * websocket log levels (mapped)
@@ -103,6 +107,31 @@ void *mrp_websock_close(mrp_websock_t *sck);
 /** Send data over a connected websocket. */
 int mrp_websock_send(mrp_websock_t *sck, void *payload, size_t size);
 
+/** Send data from a pre-padded buffer over a connected websocket. */
+int mrp_websock_send_padded(mrp_websock_t *sck, void *payload, size_t size);
+
+/** Create a shared frame with room for size bytes of payload. */
+mrp_websock_frame_t *mrp_websock_frame_create(size_t size);
+
+/** Get the payload buffer of a frame. */
+void *mrp_websock_frame_data(mrp_websock_frame_t *f);
+
+/** Add a reference to a frame. */
+mrp_websock_frame_t *mrp_websock_frame_ref(mrp_websock_frame_t *f);
+
+/** Remove a frame reference. */
+void mrp_websock_frame_unref(mrp_websock_frame_t *f);
+
+/** Send or queue a shared frame over a connected websocket. */
+int mrp_websock_send_frame(mrp_websock_t *sck, mrp_websock_frame_t *f);
+
+/** Send or queue a shared frame over a number of connected websockets. */
+int mrp_websock_broadcast_frame(mrp_websock_t **scks, int nsck,
+                                mrp_websock_frame_t *f);
+
+/** Set the maximum number of frames queued for a websocket. */
+int mrp_websock_set_queue_limit(mrp_websock_t *sck, int limit);
+
 /** Serve the given file, with MIME type, over the given websocket. */
 int mrp_websock_server_http_file(mrp_websock_t *sck, const char *path,
                                  const char *mime);
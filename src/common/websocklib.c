@@ -130,11 +130,44 @@ struct wsl_sck_s {
     wsl_sck_t      **sckptr;             /* back pointer from sck to us */
     int              closing : 1;        /* close in progress */
     int              pure_http : 1;      /* pure HTTP socket */
+    int              client : 1;         /* client-side (masking) socket */
     int              busy;               /* upper-layer callback(s) active */
     mrp_list_hook_t  hook;               /* to pure HTTP list, if such */
+    mrp_list_hook_t  outq;               /* frames waiting to be sent */
+    int              nqueued;            /* number of queued frames */
+    int              qlimit;             /* max. number of queued frames */
 };
 
 
+/*
+ * a shared frame
+ */
+
+struct wsl_frame_s {
+    mrp_refcnt_t     refcnt;             /* reference count */
+    size_t           size;               /* payload size */
+    size_t           alloc;              /* allocated payload size */
+    unsigned char    buf[0];             /* padding, payload, padding */
+};
+
+
+/*
+ * a frame queued for a websocket
+ */
+
+typedef struct {
+    mrp_list_hook_t  hook;               /* to queue of websocket */
+    wsl_frame_t     *frame;              /* queued frame */
+} qframe_t;
+
+
+/*
+ * largest send buffer we're willing to put on the stack
+ */
+
+#define WSL_ALLOCA_MAX (16 * 1024)
+
+
 /*
  * mark a socket busy while executing a piece of code
  */
@@ -149,6 +182,7 @@ struct wsl_sck_s {
 
 static int http_event(lws_t *ws, lws_event_t event,
                       void *user, void *in, size_t len);
+static void purge_queue(wsl_sck_t *sck);
 static int wsl_event(lws_t *ws, lws_event_t event,
                      void *user, void *in, size_t len);
 static void destroy_context(wsl_ctx_t *ctx);
@@ -730,9 +764,12 @@ wsl_sck_t *wsl_connect(wsl_ctx_t *ctx, struct sockaddr *sa,
          */
 
         mrp_list_init(&sck->hook);
-        sck->ctx   = wsl_ref_context(ctx);
-        sck->proto = up;
-        sck->buf   = mrp_fragbuf_create(/*up->framed*/TRUE, 0);
+        mrp_list_init(&sck->outq);
+        sck->ctx    = wsl_ref_context(ctx);
+        sck->proto  = up;
+        sck->buf    = mrp_fragbuf_create(/*up->framed*/TRUE, 0);
+        sck->client = TRUE;
+        sck->qlimit = WSL_DEFAULT_QUEUE_LIMIT;
 
         if (sck->buf != NULL) {
             sck->user_data = user_data;
@@ -787,14 +824,16 @@ wsl_sck_t *wsl_accept_pending(wsl_ctx_t *ctx, void *user_data)
 
     if (sck != NULL) {
         mrp_list_init(&sck->hook);
+        mrp_list_init(&sck->outq);
 
         /*
          * Notes:
          *     The same notes apply here for context creation as for
          *     wsl_connect above...
          */
-        sck->ctx = wsl_ref_context(ctx);
-        sck->buf = mrp_fragbuf_create(/*ctx->pending_proto->framed*/TRUE, 0);
+        sck->ctx    = wsl_ref_context(ctx);
+        sck->buf    = mrp_fragbuf_create(/*ctx->pending_proto->framed*/TRUE, 0);
+        sck->qlimit = WSL_DEFAULT_QUEUE_LIMIT;
 
         if (sck->buf != NULL) {
             sck->proto     = ctx->pending_proto;
@@ -899,6 +938,8 @@ void *wsl_close(wsl_sck_t *sck)
             mrp_fragbuf_destroy(sck->buf);
             sck->buf = NULL;
 
+            purge_queue(sck);
+
             mrp_debug("freeing websocket %p", sck);
             mrp_free(sck);
 
@@ -943,42 +984,304 @@ int wsl_set_sendmode(wsl_sck_t *sck, wsl_sendmode_t mode)
 }
 
 
-int wsl_send(wsl_sck_t *sck, void *payload, size_t size)
+static int write_padded(wsl_sck_t *sck, unsigned char *payload, size_t size)
 {
-    unsigned char *buf;
-    size_t         pre, post, total;
+    unsigned char *data;
+    size_t         total;
     uint32_t      *len;
 
-    if (sck != NULL && sck->sck != NULL) {
-        if (sck->proto->framed) {
-            pre  = LWS_SEND_BUFFER_PRE_PADDING;
-            post = LWS_SEND_BUFFER_POST_PADDING;
-            buf  = alloca(pre + sizeof(*len) + size + post);
-            len  = (uint32_t *)(buf + pre);
-            *len = htobe32(size);
-
-            memcpy(buf + pre + sizeof(*len), payload, size);
-            total = sizeof(*len) + size;
-        }
-        else {
-            pre  = LWS_SEND_BUFFER_PRE_PADDING;
-            post = LWS_SEND_BUFFER_POST_PADDING;
-            buf  = alloca(pre + size + post);
+    /*
+     * Notes:
+     *     The caller is responsible for providing WSL_SEND_PRE_PADDING
+     *     bytes of scratch space before and WSL_SEND_POST_PADDING bytes
+     *     after the payload. For framed protocols we put the size header
+     *     right in front of the payload. libwebsockets then puts its own
+     *     frame header in front of that.
+     */
 
-            memcpy(buf + pre, payload, size);
-            total = size;
-        }
+    if (sck->proto->framed) {
+        len   = (uint32_t *)(payload - sizeof(*len));
+        *len  = htobe32(size);
+        data  = (unsigned char *)len;
+        total = sizeof(*len) + size;
+    }
+    else {
+        data  = payload;
+        total = size;
+    }
 
 #if (WSL_SEND_TEXT != 0)
-        if (!sck->send_mode)
-            sck->send_mode = WSL_SEND_TEXT;
+    if (!sck->send_mode)
+        sck->send_mode = WSL_SEND_TEXT;
 #endif
 
-        if (lws_write(sck->sck, buf + pre, total, sck->send_mode) >= 0)
+    if (lws_write(sck->sck, data, total, sck->send_mode) >= 0)
+        return TRUE;
+    else
+        return FALSE;
+}
+
+
+static int write_copy(wsl_sck_t *sck, void *payload, size_t size)
+{
+    unsigned char *buf;
+    size_t         total;
+    int            status;
+
+    total = WSL_SEND_PRE_PADDING + size + WSL_SEND_POST_PADDING;
+
+    if (total <= WSL_ALLOCA_MAX)
+        buf = alloca(total);
+    else {
+        buf = mrp_alloc(total);
+
+        if (buf == NULL)
+            return FALSE;
+    }
+
+    memcpy(buf + WSL_SEND_PRE_PADDING, payload, size);
+    status = write_padded(sck, buf + WSL_SEND_PRE_PADDING, size);
+
+    if (total > WSL_ALLOCA_MAX)
+        mrp_free(buf);
+
+    return status;
+}
+
+
+static int write_frame(wsl_sck_t *sck, wsl_frame_t *f)
+{
+    unsigned char *payload = f->buf + WSL_SEND_PRE_PADDING;
+
+    /*
+     * Notes:
+     *     Client-side websockets mask the payload in place, so we cannot
+     *     let them write directly from a potentially shared frame buffer.
+     */
+
+    if (sck->client)
+        return write_copy(sck, payload, f->size);
+    else
+        return write_padded(sck, payload, f->size);
+}
+
+
+static int queue_frame(wsl_sck_t *sck, wsl_frame_t *f)
+{
+    qframe_t *q;
+
+    if (sck->nqueued >= sck->qlimit) {
+        mrp_log_warning("websocket %p: send queue full (%d frames)", sck,
+                        sck->nqueued);
+        errno = ENOBUFS;
+        return FALSE;
+    }
+
+    q = mrp_allocz(sizeof(*q));
+
+    if (q == NULL)
+        return FALSE;
+
+    mrp_list_init(&q->hook);
+    q->frame = wsl_frame_ref(f);
+
+    mrp_list_append(&sck->outq, &q->hook);
+    sck->nqueued++;
+
+    mrp_debug("websocket %p: queued frame %p (%d frames)", sck, f,
+              sck->nqueued);
+
+    lws_callback_on_writable(sck->sck);
+
+    return TRUE;
+}
+
+
+static int flush_queue(wsl_sck_t *sck)
+{
+    qframe_t *q;
+    int       status;
+
+    while (!mrp_list_empty(&sck->outq)) {
+        if (lws_send_pipe_choked(sck->sck)) {
+            lws_callback_on_writable(sck->sck);
             return TRUE;
+        }
+
+        q = mrp_list_entry(sck->outq.next, typeof(*q), hook);
+        mrp_list_delete(&q->hook);
+        sck->nqueued--;
+
+        status = write_frame(sck, q->frame);
+
+        wsl_frame_unref(q->frame);
+        mrp_free(q);
+
+        if (!status) {
+            mrp_log_error("websocket %p: failed to send queued frame", sck);
+            purge_queue(sck);
+            return FALSE;
+        }
     }
 
-    return FALSE;
+    return TRUE;
+}
+
+
+static void purge_queue(wsl_sck_t *sck)
+{
+    mrp_list_hook_t *p, *n;
+    qframe_t        *q;
+
+    mrp_list_foreach(&sck->outq, p, n) {
+        q = mrp_list_entry(p, typeof(*q), hook);
+        mrp_list_delete(&q->hook);
+
+        wsl_frame_unref(q->frame);
+        mrp_free(q);
+    }
+
+    sck->nqueued = 0;
+}
+
+
+static inline int must_queue(wsl_sck_t *sck)
+{
+    return !mrp_list_empty(&sck->outq) || lws_send_pipe_choked(sck->sck);
+}
+
+
+int wsl_send(wsl_sck_t *sck, void *payload, size_t size)
+{
+    wsl_frame_t *f;
+    int          status;
+
+    if (sck == NULL || sck->sck == NULL)
+        return FALSE;
+
+    if (!must_queue(sck))
+        return write_copy(sck, payload, size);
+
+    f = wsl_frame_create(size);
+
+    if (f == NULL)
+        return FALSE;
+
+    memcpy(wsl_frame_data(f), payload, size);
+    status = queue_frame(sck, f);
+    wsl_frame_unref(f);
+
+    return status;
+}
+
+
+int wsl_send_padded(wsl_sck_t *sck, void *payload, size_t size)
+{
+    if (sck == NULL || sck->sck == NULL)
+        return FALSE;
+
+    if (!must_queue(sck))
+        return write_padded(sck, payload, size);
+    else
+        return wsl_send(sck, payload, size);
+}
+
+
+wsl_frame_t *wsl_frame_create(size_t size)
+{
+    wsl_frame_t *f;
+
+    f = mrp_alloc(sizeof(*f) +
+                  WSL_SEND_PRE_PADDING + size + WSL_SEND_POST_PADDING);
+
+    if (f != NULL) {
+        mrp_refcnt_init(&f->refcnt);
+        f->size  = size;
+        f->alloc = size;
+    }
+
+    return f;
+}
+
+
+void *wsl_frame_data(wsl_frame_t *f)
+{
+    return f->buf + WSL_SEND_PRE_PADDING;
+}
+
+
+size_t wsl_frame_size(wsl_frame_t *f)
+{
+    return f->size;
+}
+
+
+int wsl_frame_trim(wsl_frame_t *f, size_t size)
+{
+    if (size > f->alloc) {
+        errno = EINVAL;
+        return FALSE;
+    }
+
+    f->size = size;
+
+    return TRUE;
+}
+
+
+wsl_frame_t *wsl_frame_ref(wsl_frame_t *f)
+{
+    return mrp_ref_obj(f, refcnt);
+}
+
+
+void wsl_frame_unref(wsl_frame_t *f)
+{
+    if (mrp_unref_obj(f, refcnt))
+        mrp_free(f);
+}
+
+
+int wsl_send_frame(wsl_sck_t *sck, wsl_frame_t *f)
+{
+    if (sck == NULL || sck->sck == NULL || f == NULL)
+        return FALSE;
+
+    if (!must_queue(sck))
+        return write_frame(sck, f);
+    else
+        return queue_frame(sck, f);
+}
+
+
+int wsl_broadcast_frame(wsl_sck_t **scks, int nsck, wsl_frame_t *f)
+{
+    int i, cnt;
+
+    for (i = cnt = 0; i < nsck; i++)
+        if (wsl_send_frame(scks[i], f))
+            cnt++;
+
+    return cnt;
+}
+
+
+int wsl_set_queue_limit(wsl_sck_t *sck, int limit)
+{
+    if (sck == NULL || limit <= 0) {
+        errno = EINVAL;
+        return FALSE;
+    }
+
+    sck->qlimit = limit;
+
+    return TRUE;
+}
+
+
+int wsl_queue_length(wsl_sck_t *sck)
+{
+    return sck != NULL ? sck->nqueued : 0;
 }
 
 
@@ -1188,6 +1491,10 @@ static int http_event(lws_t *ws, lws_event_t event,
             return LWS_EVENT_CLOSE;
         }
         mrp_debug("socket server side writeable again");
+
+        if (sck->sck != NULL)
+            flush_queue(sck);
+
         return LWS_EVENT_OK;
 
     case LWS_CALLBACK_CLIENT_WRITEABLE:
@@ -1198,6 +1505,10 @@ static int http_event(lws_t *ws, lws_event_t event,
             return LWS_EVENT_CLOSE;
         }
         mrp_debug("socket client side writeable again");
+
+        if (sck->sck != NULL)
+            flush_queue(sck);
+
         return LWS_EVENT_OK;
 
         /*
@@ -1579,6 +1890,10 @@ static int wsl_event(lws_t *ws, lws_event_t event,
             return LWS_EVENT_CLOSE;
         }
         mrp_debug("socket server side writeable again");
+
+        if (sck->sck != NULL)
+            flush_queue(sck);
+
         return LWS_EVENT_OK;
 
     case LWS_CALLBACK_CLIENT_WRITEABLE:
@@ -1590,6 +1905,10 @@ static int wsl_event(lws_t *ws, lws_event_t event,
             return LWS_EVENT_CLOSE;
         }
         mrp_debug("socket client side writeable again");
+
+        if (sck->sck != NULL)
+            flush_queue(sck);
+
         return LWS_EVENT_OK;
 
     default:
@@ -112,6 +112,19 @@ typedef struct {
 } wsl_proto_t;
 
 
+/*
+ * shared, pre-padded websocket frame
+ *
+ * A frame is a reference-counted, pre-padded send buffer. The payload
+ * of a frame is filled in by the caller once, after which the frame can
+ * be queued for sending on any number of websockets without copying it.
+ * Every websocket keeps a bounded queue of frames that are waiting for
+ * the socket to become writable. The frame is freed once the last
+ * reference to it is gone.
+ */
+typedef struct wsl_frame_s wsl_frame_t;
+
+
 /*
  * websocket write modes
  */
@@ -211,6 +224,56 @@ int wsl_set_sendmode(wsl_sck_t *sck, wsl_sendmode_t mode);
 /** Send data over a wbesocket. */
 int wsl_send(wsl_sck_t *sck, void *payload, size_t size);
 
+/*
+ * Padding the caller needs to reserve before and after the payload
+ * when sending from a pre-padded buffer with wsl_send_padded. The
+ * pre-padding includes room for the size header of framed protocols.
+ */
+#define WSL_SEND_PRE_PADDING  (LWS_SEND_BUFFER_PRE_PADDING + sizeof(uint32_t))
+#define WSL_SEND_POST_PADDING (LWS_SEND_BUFFER_POST_PADDING)
+
+/** Default maximum number of frames queued per websocket. */
+#define WSL_DEFAULT_QUEUE_LIMIT 64
+
+/**
+ * Send data from a caller-provided, pre-padded buffer over a websocket.
+ * @payload must be preceded by WSL_SEND_PRE_PADDING and followed by
+ * WSL_SEND_POST_PADDING bytes of scratch space, which will be clobbered.
+ * The payload itself might get modified in place (masked) on client-side
+ * websockets.
+ */
+int wsl_send_padded(wsl_sck_t *sck, void *payload, size_t size);
+
+/** Create a shared frame with room for size bytes of payload. */
+wsl_frame_t *wsl_frame_create(size_t size);
+
+/** Get the payload buffer of the given frame. */
+void *wsl_frame_data(wsl_frame_t *f);
+
+/** Get the payload size of the given frame. */
+size_t wsl_frame_size(wsl_frame_t *f);
+
+/** Trim the payload size of the given frame (to the actual size). */
+int wsl_frame_trim(wsl_frame_t *f, size_t size);
+
+/** Add a reference to the given frame. */
+wsl_frame_t *wsl_frame_ref(wsl_frame_t *f);
+
+/** Remove a reference from the given frame, freeing it if it was the last. */
+void wsl_frame_unref(wsl_frame_t *f);
+
+/** Send or queue the given frame over the given websocket. */
+int wsl_send_frame(wsl_sck_t *sck, wsl_frame_t *f);
+
+/** Send or queue the given frame over all the given websockets. */
+int wsl_broadcast_frame(wsl_sck_t **scks, int nsck, wsl_frame_t *f);
+
+/** Set the maximum number of frames queued for the given websocket. */
+int wsl_set_queue_limit(wsl_sck_t *sck, int limit);
+
+/** Get the number of frames currently queued for the given websocket. */
+int wsl_queue_length(wsl_sck_t *sck);
+
 /** Serve the given file over the given socket. */
 int wsl_serve_http_file(wsl_sck_t *sck, const char *path, const char *mime);
 
@@ -64,6 +64,7 @@ typedef struct {
     wsl_ctx_t          *ctx;             /* websocket context */
     wsl_sck_t          *sck;             /* websocket instance */
     int                 send_mode;       /* websocket send mode */
+    int                 queue_limit;     /* max. frames queued, or 0 */
     const char         *http_root;       /* HTTP content root */
     mrp_wsck_urimap_t  *uri_table;       /* URI-to-path table */
     mrp_wsck_mimemap_t *mime_table;      /* suffix to MIME-type table */
@@ -203,6 +204,18 @@ static int wsck_setopt(mrp_transport_t *mt, const char *opt, const void *val)
             return TRUE;
     }
 
+    if (!strcmp(opt, MRP_WSCK_OPT_QUEUE_LIMIT) && val != NULL) {
+        if (*(int *)val <= 0)
+            return FALSE;
+
+        t->queue_limit = *(int *)val;
+
+        if (t->sck != NULL)
+            return wsl_set_queue_limit(t->sck, t->queue_limit);
+        else
+            return TRUE;
+    }
+
     success = TRUE;
 
     if (!strcmp(opt, MRP_WSCK_OPT_HTTPDIR))
@@ -327,6 +340,11 @@ static int wsck_accept(mrp_transport_t *mt, mrp_transport_t *mlt)
         t->send_mode = lt->send_mode;
         wsl_set_sendmode(t->sck, t->send_mode);
 
+        /* ditto for the send queue limit, if any */
+        t->queue_limit = lt->queue_limit;
+        if (t->queue_limit > 0)
+            wsl_set_queue_limit(t->sck, t->queue_limit);
+
         /* inherit pure HTTP settings by default */
         t->http_root  = lt->http_root;
         t->uri_table  = lt->uri_table;
@@ -402,6 +420,9 @@ static int wsck_connect(mrp_transport_t *mt, mrp_sockaddr_t *addr,
     if (t->sck != NULL) {
         t->connected = TRUE;
 
+        if (t->queue_limit > 0)
+            wsl_set_queue_limit(t->sck, t->queue_limit);
+
         return TRUE;
     }
     else {
@@ -495,19 +516,13 @@ static int wsck_sendcustom(mrp_transport_t *mt, void *data)
     wsck_t     *t    = (wsck_t *)mt;
     mrp_json_t *json = (mrp_json_t *)data;
     const char *s;
+    size_t      len;
     int         status;
 
-    s = mrp_json_object_to_string(json);
-
-    /*
-     * Notes:
-     *     Although json-c internally counts the length of the serialized
-     *     object, it does not provide an API to get it out together with
-     *     the string. Great...
-     */
+    s = mrp_json_object_to_string_len(json, &len);
 
     if (s != NULL)
-        status = wsl_send(t->sck, (void *)s, strlen(s));
+        status = wsl_send(t->sck, (void *)s, len);
     else
         status = FALSE;
 
@@ -520,19 +535,13 @@ static int wsck_sendjson(mrp_transport_t *mt, mrp_json_t *msg)
     /* we could have casted and used wsck_sendcustom as well... */
     wsck_t     *t = (wsck_t *)mt;
     const char *s;
+    size_t      len;
     int         status;
 
-    s = mrp_json_object_to_string(msg);
-
-    /*
-     * Notes:
-     *     Although json-c internally counts the length of the serialized
-     *     object, it does not provide an API to get it out together with
-     *     the string. Great...
-     */
+    s = mrp_json_object_to_string_len(msg, &len);
 
     if (s != NULL)
-        status = wsl_send(t->sck, (void *)s, strlen(s));
+        status = wsl_send(t->sck, (void *)s, len);
     else
         status = FALSE;
 
@@ -540,6 +549,87 @@ static int wsck_sendjson(mrp_transport_t *mt, mrp_json_t *msg)
 }
 
 
+static inline int is_wsck(mrp_transport_t *mt)
+{
+    return mt != NULL && !strcmp(mt->descr->type, WSCKP);
+}
+
+
+mrp_wsck_frame_t *mrp_wsck_frame_create(size_t size)
+{
+    return wsl_frame_create(size);
+}
+
+
+mrp_wsck_frame_t *mrp_wsck_frame_json(mrp_json_t *msg)
+{
+    wsl_frame_t *f;
+    const char  *s;
+    size_t       len;
+
+    s = mrp_json_object_to_string_len(msg, &len);
+
+    if (s == NULL)
+        return NULL;
+
+    f = wsl_frame_create(len);
+
+    if (f != NULL)
+        memcpy(wsl_frame_data(f), s, len);
+
+    return f;
+}
+
+
+void *mrp_wsck_frame_data(mrp_wsck_frame_t *f)
+{
+    return wsl_frame_data(f);
+}
+
+
+int mrp_wsck_frame_trim(mrp_wsck_frame_t *f, size_t size)
+{
+    return wsl_frame_trim(f, size);
+}
+
+
+mrp_wsck_frame_t *mrp_wsck_frame_ref(mrp_wsck_frame_t *f)
+{
+    return wsl_frame_ref(f);
+}
+
+
+void mrp_wsck_frame_unref(mrp_wsck_frame_t *f)
+{
+    wsl_frame_unref(f);
+}
+
+
+int mrp_wsck_send_frame(mrp_transport_t *mt, mrp_wsck_frame_t *f)
+{
+    wsck_t *t = (wsck_t *)mt;
+
+    if (!is_wsck(mt)) {
+        errno = EINVAL;
+        return FALSE;
+    }
+
+    return wsl_send_frame(t->sck, f);
+}
+
+
+int mrp_wsck_broadcast_frame(mrp_transport_t **t, int nt, mrp_wsck_frame_t *f)
+{
+    int i, cnt;
+
+    for (i = cnt = 0; i < nt; i++)
+        if (mrp_wsck_send_frame(t[i], f))
+            cnt++;
+
+    return cnt;
+}
+
+
 static inline int looks_ipv4(const char *p)
 {
     if (isdigit(p[0])) {
@@ -135,6 +135,45 @@ typedef struct {
 } mrp_wsck_mimemap_t;
 
 
+/*
+ * shared websocket frames
+ *
+ * A frame is a reference-counted, pre-padded send buffer. Once filled in
+ * it can be sent over any number of websocket transports without copying
+ * the payload again for each transport. Frames that cannot be written out
+ * right away are queued (up to a per-transport limit) until the underlying
+ * websocket becomes writable.
+ */
+
+typedef struct wsl_frame_s mrp_wsck_frame_t;
+
+#define MRP_WSCK_OPT_QUEUE_LIMIT "queue-limit" /* max. queued frames */
+
+/** Create a frame with room for size bytes of payload. */
+mrp_wsck_frame_t *mrp_wsck_frame_create(size_t size);
+
+/** Create a frame with the serialized form of the given JSON message. */
+mrp_wsck_frame_t *mrp_wsck_frame_json(mrp_json_t *msg);
+
+/** Get the payload buffer of the given frame. */
+void *mrp_wsck_frame_data(mrp_wsck_frame_t *f);
+
+/** Trim the payload of the given frame to the given size. */
+int mrp_wsck_frame_trim(mrp_wsck_frame_t *f, size_t size);
+
+/** Add a reference to the given frame. */
+mrp_wsck_frame_t *mrp_wsck_frame_ref(mrp_wsck_frame_t *f);
+
+/** Remove a reference from the given frame, freeing it if was the last. */
+void mrp_wsck_frame_unref(mrp_wsck_frame_t *f);
+
+/** Send or queue the given frame over the given websocket transport. */
+int mrp_wsck_send_frame(mrp_transport_t *t, mrp_wsck_frame_t *f);
+
+/** Send or queue the given frame over a number of websocket transports. */
+int mrp_wsck_broadcast_frame(mrp_transport_t **t, int nt, mrp_wsck_frame_t *f);
+
+
 
 
 MRP_CDECL_END
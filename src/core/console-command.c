@@ -31,3 +31,5 @@
 #include "console-debug.c"
 #include "console-db.c"
 #include "console-log.c"
+#include "console-mainloop.c"
+#include "console-mm.c"
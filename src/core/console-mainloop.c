@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * mainloop commands
+ */
+
+static void mainloop_stats(mrp_console_t *c, void *user_data,
+                           int argc, char **argv)
+{
+    mrp_mainloop_t *ml = c->ctx->ml;
+    unsigned long   usecs;
+    char           *end;
+
+    MRP_UNUSED(user_data);
+
+    if (argc == 2)
+        mrp_mainloop_dump_stats(ml, c->stdout);
+    else if (argc == 3 && !strcmp(argv[2], "enable")) {
+        if (mrp_mainloop_enable_stats(ml, TRUE))
+            fprintf(c->stdout, "Mainloop statistics enabled.\n");
+        else
+            fprintf(c->stdout, "Failed to enable mainloop statistics (%s).\n",
+                    strerror(errno));
+    }
+    else if (argc == 3 && !strcmp(argv[2], "disable")) {
+        mrp_mainloop_enable_stats(ml, FALSE);
+        fprintf(c->stdout, "Mainloop statistics disabled.\n");
+    }
+    else if (argc == 3 && !strcmp(argv[2], "reset")) {
+        mrp_mainloop_reset_stats(ml);
+        fprintf(c->stdout, "Mainloop statistics reset.\n");
+    }
+    else if (argc == 4 && !strcmp(argv[2], "threshold")) {
+        usecs = strtoul(argv[3], &end, 10);
+
+        if (*end || end == argv[3]) {
+            fprintf(c->stdout, "Invalid threshold '%s'.\n", argv[3]);
+            return;
+        }
+
+        if (mrp_mainloop_set_slow_threshold(ml, (unsigned int)usecs))
+            fprintf(c->stdout, "Slow callback threshold set to %lu usecs.\n",
+                    usecs);
+        else
+            fprintf(c->stdout, "Failed to set slow callback threshold (%s).\n",
+                    strerror(errno));
+    }
+    else
+        fprintf(c->stdout, "Invalid mainloop stats command.\n");
+}
+
+
+#define MAINLOOP_GROUP_DESCRIPTION                                          \
+    "Mainloop commands provide runtime diagnostics for the Murphy\n"        \
+    "mainloop.\n"
+
+#define MAINLOOP_STATS_SYNTAX  "[enable|disable|reset|threshold <usecs>]"
+#define MAINLOOP_STATS_SUMMARY "show or control mainloop statistics"
+#define MAINLOOP_STATS_DESCRIPTION                                          \
+    "Without arguments shows the collected mainloop statistics: per-\n"     \
+    "callback call counts, cumulative, average and maximum durations for\n" \
+    "I/O watches, timers, deferred, wakeup and subloop callbacks, and\n"    \
+    "histograms of iteration lag (from poll return to the end of\n"         \
+    "dispatching) and timer lateness. With enable, disable and reset\n"     \
+    "statistics collection can be controlled. With threshold the limit\n"   \
+    "above which callbacks are logged as slow can be set (0 disables).\n"   \
+    "Statistics support needs to be compiled in with the configure\n"     \
+    "option --enable-mainloop-stats.\n"
+
+MRP_CORE_CONSOLE_GROUP(mainloop_group, "mainloop", MAINLOOP_GROUP_DESCRIPTION,
+                       NULL, {
+        MRP_TOKENIZED_CMD("stats", mainloop_stats, FALSE,
+                          MAINLOOP_STATS_SYNTAX, MAINLOOP_STATS_SUMMARY,
+                          MAINLOOP_STATS_DESCRIPTION),
+});
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * memory management commands
+ */
+
+static void mm_profile(mrp_console_t *c, void *user_data,
+                       int argc, char **argv)
+{
+    mrp_mm_profile_format_t  format;
+    unsigned long            rate;
+    char                    *end;
+    FILE                    *fp;
+
+    MRP_UNUSED(user_data);
+
+    if (argc == 2)
+        mrp_mm_profile_summary(c->stdout, 10);
+    else if ((argc == 3 || argc == 4) && !strcmp(argv[2], "enable")) {
+        rate = 0;
+
+        if (argc == 4) {
+            rate = strtoul(argv[3], &end, 10);
+
+            if (*end || end == argv[3]) {
+                fprintf(c->stdout, "Invalid sampling rate '%s'.\n", argv[3]);
+                return;
+            }
+        }
+
+        if (mrp_mm_profile_start((size_t)rate))
+            fprintf(c->stdout, "Heap profiling enabled, sampling every "
+                    "%zu bytes.\n", mrp_mm_profile_rate());
+        else
+            fprintf(c->stdout, "Failed to enable heap profiling (%s).\n",
+                    strerror(errno));
+    }
+    else if (argc == 3 && !strcmp(argv[2], "disable")) {
+        mrp_mm_profile_stop();
+        fprintf(c->stdout, "Heap profiling disabled.\n");
+    }
+    else if (argc == 3 && !strcmp(argv[2], "reset")) {
+        mrp_mm_profile_reset();
+        fprintf(c->stdout, "Heap profile allocation statistics reset.\n");
+    }
+    else if ((argc == 4 || argc == 5) && !strcmp(argv[2], "save")) {
+        if (argc == 4 || !strcmp(argv[4], "pprof"))
+            format = MRP_MM_PROFILE_PPROF;
+        else if (!strcmp(argv[4], "folded"))
+            format = MRP_MM_PROFILE_FOLDED;
+        else {
+            fprintf(c->stdout, "Invalid profile format '%s'.\n", argv[4]);
+            return;
+        }
+
+        if ((fp = fopen(argv[3], "w")) == NULL) {
+            fprintf(c->stdout, "Failed to open '%s' (%s).\n", argv[3],
+                    strerror(errno));
+            return;
+        }
+
+        if (mrp_mm_profile_dump(fp, format) && fclose(fp) == 0)
+            fprintf(c->stdout, "Heap profile saved to '%s'.\n", argv[3]);
+        else
+            fprintf(c->stdout, "Failed to save heap profile to '%s'.\n",
+                    argv[3]);
+    }
+    else
+        fprintf(c->stdout, "Invalid mm profile command.\n");
+}
+
+
+#define MM_GROUP_DESCRIPTION                                                \
+    "Memory management commands provide runtime diagnostics for the\n"      \
+    "Murphy memory allocator.\n"
+
+#define MM_PROFILE_SYNTAX                                                   \
+    "[enable [<rate>]|disable|reset|save <file> [pprof|folded]]"
+#define MM_PROFILE_SUMMARY "show or control heap profiling"
+#define MM_PROFILE_DESCRIPTION                                              \
+    "Without arguments shows the allocation sites with the most live\n"     \
+    "memory according to the sampling heap profiler. With enable the\n"     \
+    "profiler starts sampling on average every <rate> bytes allocated\n"    \
+    "(512 kB by default), with disable it stops taking new samples. With\n" \
+    "reset the cumulative allocation statistics are cleared. With save\n"   \
+    "the profile is written to <file>, either as a pprof heap profile or\n" \
+    "as folded stacks of live memory suitable for flame graphs.\n"
+
+MRP_CORE_CONSOLE_GROUP(mm_group, "mm", MM_GROUP_DESCRIPTION, NULL, {
+        MRP_TOKENIZED_CMD("profile", mm_profile, FALSE,
+                          MM_PROFILE_SYNTAX, MM_PROFILE_SUMMARY,
+                          MM_PROFILE_DESCRIPTION),
+});
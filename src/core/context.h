@@ -69,6 +69,7 @@ struct mrp_context_s {
     const char *whitelist_dynamic;         /* whitelisted dynamic plugins */
     bool        disable_runtime_load;      /* disallow post-startup loading */
     bool        disable_console;           /* disable murphy console */
+    const char *startup_trace;             /* startup timeline dump file */
 
     /* actual runtime context data */
     int              state;                /* context/daemon state */
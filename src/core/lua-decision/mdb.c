@@ -82,6 +82,7 @@ struct mrp_lua_mdb_table_s {
     mrp_lua_strarray_t *index;
     size_t              ncolumn;
     mqi_column_def_t   *columns;
+    int                *colrefs;  /* registry refs to column names */
     size_t              nrow;
 };
 
@@ -124,6 +125,12 @@ static int  table_setfield(lua_State *);
 static int  table_tostring(lua_State *);
 static int  table_insert(lua_State *);
 static int  table_replace(lua_State *);
+static int  table_insert_rows(lua_State *);
+static int  table_replace_all(lua_State *);
+static int  table_bulk_insert(lua_State *, bool);
+static void table_column_refs(lua_State *, mrp_lua_mdb_table_t *);
+static void table_bulk_getvalues(lua_State *, mrp_lua_mdb_table_t *, int,
+                                 int, int, value_t *);
 static int  table_update(lua_State *);
 static int  table_delete(lua_State *);
 static void table_destroy_from_lua(void *);
@@ -142,11 +149,18 @@ static mrp_lua_mdb_table_t *table_row_check(lua_State *, int, int *);
 static int  select_create_from_lua(lua_State *);
 static int  select_getfield(lua_State *);
 static int  select_setfield(lua_State *);
+static int  select_getlength(lua_State *);
 static void select_destroy_from_lua(void *);
-static int  select_update(lua_State *, int, mrp_lua_mdb_select_t *);
+static int  select_update(mrp_lua_mdb_select_t *);
 static int  select_update_from_lua(lua_State *);
 static int  select_update_from_resolver(mrp_scriptlet_t *,mrp_context_tbl_t *);
 static void select_install(lua_State *, mrp_lua_mdb_select_t *);
+static int  select_column_index_from_lua(lua_State *);
+static int  select_value_from_lua(lua_State *);
+static int  select_rows_from_lua(lua_State *);
+static int  select_rows_next(lua_State *);
+static int  select_column_arg(lua_State *, int, mrp_lua_mdb_select_t *);
+static void select_push_value(lua_State *, mrp_lua_mdb_select_t *, int, int);
 
 static void select_row_class_create(lua_State *);
 /* static int  select_row_create(lua_State *, int, void *, int); */
@@ -178,6 +192,8 @@ MRP_LUA_METHOD_LIST_TABLE (
     MRP_LUA_METHOD_CONSTRUCTOR  (table_create_from_lua)
     MRP_LUA_METHOD     (insert,  table_insert         )
     MRP_LUA_METHOD     (replace, table_replace        )
+    MRP_LUA_METHOD     (insert_rows, table_insert_rows)
+    MRP_LUA_METHOD     (replace_all, table_replace_all)
     MRP_LUA_METHOD     (update,  table_update         )
     MRP_LUA_METHOD     (delete,  table_delete         )
 );
@@ -213,7 +229,11 @@ MRP_LUA_METHOD_LIST_TABLE (
     MRP_LUA_OVERRIDE_CALL       (select_create_from_lua)
     MRP_LUA_OVERRIDE_GETFIELD   (select_getfield)
     MRP_LUA_OVERRIDE_SETFIELD   (select_setfield)
+    MRP_LUA_OVERRIDE_GETLENGTH  (select_getlength)
     MRP_LUA_METHOD     (update,  select_update_from_lua)
+    MRP_LUA_METHOD     (column_index, select_column_index_from_lua)
+    MRP_LUA_METHOD     (value,   select_value_from_lua)
+    MRP_LUA_METHOD     (rows,    select_rows_from_lua)
 );
 
 MRP_LUA_METHOD_LIST_TABLE (
@@ -297,34 +317,10 @@ mrp_lua_mdb_select_t *mrp_lua_to_select(lua_State *L, int idx)
 
 int mrp_lua_push_select(lua_State *L,mrp_lua_mdb_select_t *sel,bool singleval)
 {
-    mql_result_t *rslt;
-    const char *str;
-    lua_Number num;
-    char buf[1024];
-
     if (!singleval)
         mrp_lua_push_object(L, sel);
-    else {
-        if (!(rslt = sel->result) || sel->nrow < 1)
-            lua_pushnil(L);
-        else {
-            switch (mql_result_rows_get_row_column_type(rslt, 0)) {
-            case mqi_string:
-                str = mql_result_rows_get_string(rslt, 0, 0, buf,sizeof(buf));
-                lua_pushstring(L, str);
-                break;
-            case mqi_integer:
-            case mqi_unsignd:
-            case mqi_floating:
-                num = mql_result_rows_get_floating(rslt, 0, 0);
-                lua_pushnumber(L, num);
-                break;
-            default:
-                lua_pushnil(L);
-                break;
-            }
-        }
-    }
+    else
+        select_push_value(L, sel, 0, 0);
 
     return 1;
 }
@@ -461,6 +457,8 @@ static int table_create_from_lua(lua_State *L)
         memcpy(tbl->columns, defs, sizeof(mqi_column_def_t) * ndef);
         for (d = tbl->columns;  d->name;  d++)
             d->name = mrp_strdup(d->name);
+
+        mqi_subscribe_table(tbl->handle);
     }
     else {
         if (tbl->handle != MQI_HANDLE_INVALID) {
@@ -657,6 +655,172 @@ static int table_replace(lua_State *L)
     MRP_LUA_LEAVE(1);
 }
 
+static int table_insert_rows(lua_State *L)
+{
+    return table_bulk_insert(L, false);
+}
+
+static int table_replace_all(lua_State *L)
+{
+    return table_bulk_insert(L, true);
+}
+
+static int table_bulk_insert(lua_State *L, bool replace_all)
+{
+    mrp_lua_mdb_table_t *tbl;
+    mqi_column_desc_t desc[MQI_COLUMN_MAX+1];
+    value_t *rows;
+    size_t rowsize, i;
+    int nrow, anchor, r;
+    mqi_handle_t th;
+    int inserted;
+
+    MRP_LUA_ENTER;
+
+    tbl = mrp_lua_table_check(L, 1);
+    luaL_checktype(L, 2, LUA_TTABLE);
+
+    lua_settop(L, 2);
+
+    nrow    = lua_objlen(L, 2);
+    rowsize = sizeof(value_t) * tbl->ncolumn;
+
+    for (i = 0;  i < tbl->ncolumn;  i++) {
+        desc[i].cindex = i;
+        desc[i].offset = sizeof(value_t) * i;
+    }
+
+    desc[i].cindex = -1;
+    desc[i].offset = -1;
+
+    /*
+     * Both the row buffer and the table anchoring strings converted from
+     * numbers are left to the garbage collector, so nothing leaks if we
+     * bail out with a Lua error. Other strings are not copied at all, the
+     * argument table keeps them alive until we are done.
+     */
+    rows = lua_newuserdata(L, rowsize * (nrow > 0 ? nrow : 1));
+    lua_newtable(L);
+    anchor = lua_gettop(L);
+
+    table_column_refs(L, tbl);
+
+    for (r = 0;  r < nrow;  r++) {
+        lua_rawgeti(L, 2, r + 1);
+
+        if (!lua_istable(L, -1))
+            luaL_error(L, "row #%d in bulk insert is not a table", r + 1);
+
+        table_bulk_getvalues(L, tbl, lua_gettop(L), anchor, r + 1,
+                             (void *)rows + rowsize * r);
+
+        lua_pop(L, 1);
+    }
+
+    th = mqi_begin_transaction();
+
+    if (replace_all && MQI_DELETE(tbl->handle, NULL) < 0)
+        inserted = -1;
+    else if (nrow > 0)
+        inserted = mqi_insert_rows(tbl->handle, desc, rows, rowsize, nrow);
+    else
+        inserted = 0;
+
+    if (inserted >= 0)
+        mqi_commit_transaction(th);
+    else {
+        mqi_rollback_transaction(th);
+        luaL_error(L, "bulk insert failed: %s", strerror(errno));
+    }
+
+    lua_pushinteger(L, inserted);
+
+    MRP_LUA_LEAVE(1);
+}
+
+static void table_column_refs(lua_State *L, mrp_lua_mdb_table_t *tbl)
+{
+    size_t i;
+
+    if (tbl->colrefs == NULL) {
+        tbl->colrefs = mrp_allocz(sizeof(int) * (tbl->ncolumn ? tbl->ncolumn:1));
+
+        if (tbl->colrefs == NULL)
+            luaL_error(L, "failed to allocate column name references");
+
+        for (i = 0;  i < tbl->ncolumn;  i++) {
+            lua_pushstring(L, tbl->columns[i].name);
+            tbl->colrefs[i] = luaL_ref(L, LUA_REGISTRYINDEX);
+        }
+    }
+}
+
+static void table_bulk_getvalues(lua_State *L, mrp_lua_mdb_table_t *tbl,
+                                 int idx, int anchor, int rowno,
+                                 value_t *values)
+{
+    mqi_column_def_t *c;
+    value_t *v;
+    bool positional;
+    size_t i;
+
+    positional = (lua_objlen(L, idx) > 0);
+
+    for (i = 0;  i < tbl->ncolumn;  i++) {
+        c = tbl->columns + i;
+        v = values + i;
+
+        if (positional)
+            lua_rawgeti(L, idx, i + 1);
+        else {
+            lua_rawgeti(L, LUA_REGISTRYINDEX, tbl->colrefs[i]);
+            lua_rawget(L, idx);
+        }
+
+        switch (c->type) {
+        case mqi_string:
+            if (lua_type(L, -1) == LUA_TNUMBER) {
+                lua_pushvalue(L, -1);
+                v->string = (char *)lua_tostring(L, -1);
+                lua_rawseti(L, anchor, lua_objlen(L, anchor) + 1);
+            }
+            else if (lua_type(L, -1) == LUA_TSTRING)
+                v->string = (char *)lua_tostring(L, -1);
+            else
+                goto invalid;
+            break;
+        case mqi_integer:
+            if (!lua_isnumber(L, -1))
+                goto invalid;
+            v->integer = lua_tointeger(L, -1);
+            break;
+        case mqi_unsignd:
+            if (!lua_isnumber(L, -1) || lua_tointeger(L, -1) < 0)
+                goto invalid;
+            v->unsignd = lua_tointeger(L, -1);
+            break;
+        case mqi_floating:
+            if (!lua_isnumber(L, -1))
+                goto invalid;
+            v->floating = lua_tonumber(L, -1);
+            break;
+        default:
+            goto invalid;
+        }
+
+        lua_pop(L, 1);
+    }
+
+    return;
+
+ invalid:
+    if (lua_isnil(L, -1))
+        luaL_error(L, "row #%d has no value for column '%s'", rowno, c->name);
+    else
+        luaL_error(L, "row #%d has invalid value for column '%s'",
+                   rowno, c->name);
+}
+
 static int table_update(lua_State *L)
 {
     int narg;
@@ -741,10 +905,22 @@ static int table_delete(lua_State *L)
 static void table_destroy_from_lua(void *data)
 {
     mrp_lua_mdb_table_t *tbl = (mrp_lua_mdb_table_t *)data;
+    lua_State *L;
+    size_t i;
 
     MRP_LUA_ENTER;
 
     if (tbl) {
+        if (tbl->builtin && tbl->handle != MQI_HANDLE_INVALID)
+            mqi_unsubscribe_table(tbl->handle);
+
+        if (tbl->colrefs != NULL && (L = mrp_lua_get_lua_state()) != NULL) {
+            for (i = 0;  i < tbl->ncolumn;  i++)
+                luaL_unref(L, LUA_REGISTRYINDEX, tbl->colrefs[i]);
+        }
+
+        mrp_free(tbl->colrefs);
+
         mrp_free((void *)tbl->name);
         mrp_lua_free_strarray(tbl->index);
         free_coldefs(tbl->columns);
@@ -991,7 +1167,7 @@ static int select_create_from_lua(lua_State *L)
 
     select_install(L, sel);
 
-    select_update(L, -1, sel);
+    select_update(sel);
 
     MRP_LUA_LEAVE(1);
 }
@@ -1001,6 +1177,7 @@ static int select_getfield(lua_State *L)
     mrp_lua_mdb_select_t *sel = mrp_lua_select_check(L, 1);
     field_t fld;
     const char *fldnam;
+    int rowidx;
 
     MRP_LUA_ENTER;
 
@@ -1008,9 +1185,28 @@ static int select_getfield(lua_State *L)
         lua_pushnil(L);
     else {
         if (lua_type(L, 2) == LUA_TNUMBER) {
-            mrp_debug("reading row %d in '%s'", (int)lua_tointeger(L,-1),
-                      sel->name);
-            lua_rawget(L, 1);
+            rowidx = lua_tointeger(L, 2);
+
+            mrp_debug("reading row %d in '%s'", rowidx, sel->name);
+
+            if (rowidx < 1 || (size_t)rowidx > sel->nrow)
+                lua_pushnil(L);
+            else {
+                /*
+                 * Row proxies are created on first access and cached in
+                 * the select object. They only carry the row index, so
+                 * they stay valid across updates; rows past the current
+                 * row count read as nil.
+                 */
+                lua_rawget(L, 1);
+
+                if (lua_isnil(L, -1)) {
+                    lua_pop(L, 1);
+                    row_create(L, 1, sel, rowidx - 1, SELECT_ROW_CLASSID);
+                    lua_pushvalue(L, -1);
+                    lua_rawseti(L, 1, rowidx);
+                }
+            }
         }
         else {
             fld = field_check(L, 2, &fldnam);
@@ -1052,6 +1248,19 @@ static int select_setfield(lua_State *L)
     MRP_LUA_LEAVE(0);
 }
 
+static int select_getlength(lua_State *L)
+{
+    mrp_lua_mdb_select_t *sel;
+
+    MRP_LUA_ENTER;
+
+    sel = mrp_lua_select_check(L, 1);
+
+    lua_pushinteger(L, sel ? sel->nrow : 0);
+
+    MRP_LUA_LEAVE(1);
+}
+
 
 static void select_destroy_from_lua(void *data)
 {
@@ -1065,12 +1274,13 @@ static void select_destroy_from_lua(void *data)
         mrp_free((void *)sel->table_name);
         mrp_free((void *)sel->condition);
         mrp_free((void *)sel->statement.string);
+        mql_statement_free(sel->statement.precomp);
     }
 
     MRP_LUA_LEAVE_NOARG;
 }
 
-static int select_update(lua_State *L, int tbl, mrp_lua_mdb_select_t *sel)
+static int select_update(mrp_lua_mdb_select_t *sel)
 {
     mql_statement_t *statement;
     mql_result_t *result;
@@ -1084,12 +1294,14 @@ static int select_update(lua_State *L, int tbl, mrp_lua_mdb_select_t *sel)
     if (!(statement = sel->statement.precomp))
         nrow = 0;
     else {
-        mql_result_free(sel->result);
+        /* hand over the previous rows so their buffer gets reused */
+        result = mql_exec_statement_into(mql_result_rows, statement,
+                                         sel->result);
         sel->result = NULL;
 
-        result = mql_exec_statement(mql_result_rows, statement);
         if (!mql_result_is_success(result)) {
             nrow = -mql_result_error_get_code(result);
+            mql_result_free(result);
         }
         else {
             sel->result = result;
@@ -1099,10 +1311,8 @@ static int select_update(lua_State *L, int tbl, mrp_lua_mdb_select_t *sel)
 
     mrp_debug("\"%s\" resulted %d rows", sel->statement.string, nrow);
 
-    if (nrow >= 0) {
-        adjust_lua_table_size(L, tbl,sel, sel->nrow, nrow, SELECT_ROW_CLASSID);
+    if (nrow >= 0)
         sel->nrow = nrow;
-    }
 
     MRP_LUA_LEAVE(nrow);
 }
@@ -1118,7 +1328,7 @@ static int select_update_from_lua(lua_State *L)
 
     mrp_debug("update request for select '%s'\n", sel->name);
 
-    nrow = select_update(L, 1, sel);
+    nrow = select_update(sel);
 
     lua_pushinteger(L, nrow < 0 ? 0 : nrow);
 
@@ -1141,11 +1351,7 @@ static int select_update_from_resolver(mrp_scriptlet_t *script,
 
     mrp_debug("update request for select '%s'", sel->name);
 
-    mrp_lua_push_object(L, sel);
-
-    nrow = select_update(L, -1, sel);
-
-    lua_pop(L, 1);
+    nrow = select_update(sel);
 
     MRP_LUA_LEAVE(nrow >= 0);
 }
@@ -1200,6 +1406,143 @@ static void select_install(lua_State *L, mrp_lua_mdb_select_t *sel)
     MRP_LUA_LEAVE_NOARG;
 }
 
+static int select_column_index_from_lua(lua_State *L)
+{
+    mrp_lua_mdb_select_t *sel;
+    int colidx;
+
+    MRP_LUA_ENTER;
+
+    sel = mrp_lua_select_check(L, 1);
+    colidx = mrp_lua_select_get_column_index(sel, luaL_checkstring(L, 2));
+
+    if (colidx < 0)
+        lua_pushnil(L);
+    else
+        lua_pushinteger(L, colidx + 1);
+
+    MRP_LUA_LEAVE(1);
+}
+
+static int select_value_from_lua(lua_State *L)
+{
+    mrp_lua_mdb_select_t *sel;
+    int rowidx;
+    int colidx;
+
+    MRP_LUA_ENTER;
+
+    sel    = mrp_lua_select_check(L, 1);
+    rowidx = luaL_checkinteger(L, 2) - 1;
+    colidx = select_column_arg(L, 3, sel);
+
+    select_push_value(L, sel, colidx, rowidx);
+
+    MRP_LUA_LEAVE(1);
+}
+
+static int select_rows_from_lua(lua_State *L)
+{
+    mrp_lua_mdb_select_t *sel;
+    int narg, i;
+
+    MRP_LUA_ENTER;
+
+    sel  = mrp_lua_select_check(L, 1);
+    narg = lua_gettop(L);
+
+    if (narg - 1 > MQI_COLUMN_MAX)
+        luaL_error(L, "too many columns for selection '%s'", sel->name);
+
+    /* the requested column indices are resolved once, as upvalues */
+    for (i = 2;  i <= narg;  i++)
+        lua_pushinteger(L, select_column_arg(L, i, sel) + 1);
+
+    lua_pushcclosure(L, select_rows_next, narg - 1);
+    lua_pushvalue(L, 1);
+    lua_pushinteger(L, 0);
+
+    MRP_LUA_LEAVE(3);
+}
+
+static int select_rows_next(lua_State *L)
+{
+    mrp_lua_mdb_select_t *sel;
+    int rowidx;
+    int i, ncol;
+
+    MRP_LUA_ENTER;
+
+    sel    = mrp_lua_to_select(L, 1);
+    rowidx = lua_tointeger(L, 2);
+
+    if (!sel || !sel->result || rowidx < 0 || (size_t)rowidx >= sel->nrow) {
+        lua_pushnil(L);
+        MRP_LUA_LEAVE(1);
+    }
+
+    ncol = 0;
+    lua_pushinteger(L, rowidx + 1);
+
+    while (!lua_isnoneornil(L, lua_upvalueindex(ncol + 1))) {
+        i = lua_tointeger(L, lua_upvalueindex(ncol + 1)) - 1;
+        select_push_value(L, sel, i, rowidx);
+        ncol++;
+    }
+
+    MRP_LUA_LEAVE(ncol + 1);
+}
+
+static int select_column_arg(lua_State *L, int idx, mrp_lua_mdb_select_t *sel)
+{
+    const char *colnam;
+    int colidx;
+
+    if (lua_type(L, idx) == LUA_TNUMBER)
+        colidx = lua_tointeger(L, idx) - 1;
+    else {
+        colnam = luaL_checkstring(L, idx);
+        colidx = mrp_lua_select_get_column_index(sel, colnam);
+    }
+
+    if (colidx < 0 || colidx >= (int)sel->columns->nstring)
+        luaL_error(L, "invalid column %s for selection '%s'",
+                   lua_tostring(L, idx), sel->name);
+
+    return colidx;
+}
+
+static void select_push_value(lua_State *L, mrp_lua_mdb_select_t *sel,
+                              int colidx, int rowidx)
+{
+    mql_result_t *rslt = sel->result;
+
+    if (!rslt || rowidx < 0 || (size_t)rowidx >= sel->nrow) {
+        lua_pushnil(L);
+        return;
+    }
+
+    /* strings are pushed straight from the result rows, without copying */
+    switch (mql_result_rows_get_row_column_type(rslt, colidx)) {
+    case mqi_string:
+        lua_pushstring(L, mql_result_rows_get_string(rslt, colidx, rowidx,
+                                                     NULL, 0));
+        break;
+    case mqi_integer:
+        lua_pushinteger(L, mql_result_rows_get_integer(rslt, colidx,rowidx));
+        break;
+    case mqi_unsignd:
+        lua_pushnumber(L, mql_result_rows_get_unsigned(rslt, colidx,rowidx));
+        break;
+    case mqi_floating:
+        lua_pushnumber(L, mql_result_rows_get_floating(rslt, colidx,rowidx));
+        break;
+    default:
+        lua_pushnil(L);
+        break;
+    }
+}
+
 static void select_row_class_create(lua_State *L)
 {
     /* create a metatable for row's */
@@ -1231,9 +1574,6 @@ static int select_row_getfield(lua_State *L)
     const char *fldnam;
     int rowidx;
     int colidx;
-    const char *string;
-    lua_Number number;
-    char buf[1024];
 
     MRP_LUA_ENTER;
 
@@ -1244,8 +1584,10 @@ static int select_row_getfield(lua_State *L)
     mrp_debug("reading field in row %d of '%s' selection\n",
               rowidx+1, sel ? sel->name : "<unknwon>");
 
-    if (!sel || !rslt || (size_t)rowidx >= sel->nrow)
-        lua_pushnil(L); /* we should never get here actually */
+    if (!sel || !rslt || (size_t)rowidx >= sel->nrow) {
+        lua_pushnil(L); /* cached proxy of a row gone since */
+        MRP_LUA_LEAVE(1);
+    }
 
 
     switch (lua_type(L, 2)) {
@@ -1265,21 +1607,7 @@ static int select_row_getfield(lua_State *L)
         if (colidx < 0 || colidx >= (int)cols->nstring)
             goto no_data;
 
-        switch (mql_result_rows_get_row_column_type(rslt, colidx)) {
-        case mqi_string:
-            string = mql_result_rows_get_string(rslt, colidx, rowidx,
-                                                buf, sizeof(buf));
-            lua_pushstring(L, string);
-            break;
-        case mqi_integer:
-        case mqi_unsignd:
-        case mqi_floating:
-            number = mql_result_rows_get_floating(rslt, colidx, rowidx);
-            lua_pushnumber(L, number);
-            break;
-        default:
-            goto no_data;
-        }
+        select_push_value(L, sel, colidx, rowidx);
         break;
 
     default:
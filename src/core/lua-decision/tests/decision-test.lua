@@ -82,6 +82,16 @@ print("mdb.table.amb.columns="..coldefs)
 
 mdb.table.amb[1] = { key = "foo", value = 3.1415 }
 
+print("inserted "..mdb.table.amb:insert_rows {
+    { "rpm", 1200.0 },
+    { key = "gear", value = 3 }
+}.." rows into mdb.table.amb")
+
+print("replaced mdb.table.amb with "..mdb.table.amb:replace_all {
+    { key = "speed", value = 80.0 },
+    { key = "rpm",   value = 2400.0 }
+}.." rows")
+
 mdb.select {
            name = "speed",
            table = "amb",
@@ -89,6 +99,15 @@ mdb.select {
            condition = "key = 'speed'"
 }
 
+local speed_value = mdb.select.speed:column_index("value")
+
+for i, v in mdb.select.speed:rows(speed_value) do
+    print("mdb.select.speed row "..i..": value="..v..
+          " ("..mdb.select.speed:value(i, speed_value)..")")
+end
+
+print("mdb.select.speed[1].value="..mdb.select.speed[1].value)
+
 --[[
 print("mdb.select.speed.statement="..mdb.select.speed.statement)
 
@@ -0,0 +1,395 @@
+/*
+ * Copyright (c) 2012, 2013, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <murphy/common/debug.h>
+#include <murphy/common/log.h>
+#include <murphy/common/mm.h>
+#include <murphy/common/file-utils.h>
+
+#include <murphy/core/lua-utils/bytecode.h>
+
+#define CACHE_MAGIC   0x4d52504cU               /* 'MRPL' */
+#define CACHE_VERSION 1
+#define CACHE_SUFFIX  ".luac"
+
+/*
+ * Cached chunks are stored one per source file, named after the hash of
+ * the absolute path of the source. A cache file consists of a header,
+ * the absolute path of the source and the dumped bytecode. The header
+ * carries everything needed to tell whether the chunk is still valid for
+ * the source, plus a hash of the bytecode itself to catch cache files
+ * left truncated or garbled by a crash. Cache files are written to a
+ * temporary file first, then renamed in place, so a reader never sees a
+ * partially written one.
+ */
+
+typedef struct {
+    uint32_t magic;                      /* CACHE_MAGIC */
+    uint16_t version;                    /* CACHE_VERSION */
+    uint16_t luaver;                     /* LUA_VERSION_NUM */
+    uint64_t dev;                        /* source device */
+    uint64_t ino;                        /* source inode */
+    int64_t  mtime;                      /* source modification time (ns) */
+    uint64_t size;                       /* source size */
+    uint64_t srchash;                    /* hash of the source */
+    uint64_t codehash;                   /* hash of the bytecode */
+    uint32_t pathlen;                    /* length of the path */
+    uint32_t codelen;                    /* length of the bytecode */
+} cache_hdr_t;
+
+typedef struct {
+    char   *buf;                         /* dump buffer */
+    size_t  size;                        /* allocated buffer size */
+    size_t  len;                         /* amount of data dumped */
+} dump_t;
+
+static char *cache_dir;
+
+
+static inline uint64_t hash_data(const void *data, size_t size)
+{
+    const unsigned char *p = data;
+    uint64_t             h = 0xcbf29ce484222325ULL;
+
+    while (size-- > 0) {
+        h ^= *p++;
+        h *= 0x100000001b3ULL;
+    }
+
+    return h;
+}
+
+
+static inline int64_t source_mtime(struct stat *st)
+{
+    return (int64_t)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
+
+
+static int cache_path(const char *path, char *buf, size_t size)
+{
+    int n;
+
+    n = snprintf(buf, size, "%s/%016llx"CACHE_SUFFIX, cache_dir,
+                 (unsigned long long)hash_data(path, strlen(path)));
+
+    return (n < 0 || n >= (int)size) ? -1 : 0;
+}
+
+
+int mrp_lua_set_bytecode_cache(const char *dir)
+{
+    struct stat st;
+
+    mrp_free(cache_dir);
+    cache_dir = NULL;
+
+    if (dir == NULL || !*dir)
+        return 0;
+
+    if (mrp_mkdir(dir, 0700, NULL) < 0 || stat(dir, &st) < 0) {
+        mrp_log_warning("Lua bytecode cache '%s' not available (%d: %s).",
+                        dir, errno, strerror(errno));
+        return -1;
+    }
+
+    /* never trust bytecode somebody else could have planted for us */
+    if (!S_ISDIR(st.st_mode) || st.st_uid != geteuid() ||
+        (st.st_mode & (S_IWGRP | S_IWOTH))) {
+        mrp_log_warning("Refusing insecure Lua bytecode cache '%s'.", dir);
+        errno = EPERM;
+        return -1;
+    }
+
+    if ((cache_dir = mrp_strdup(dir)) == NULL)
+        return -1;
+
+    mrp_debug("Lua bytecode cache set to '%s'", cache_dir);
+
+    return 0;
+}
+
+
+const char *mrp_lua_get_bytecode_cache(void)
+{
+    return cache_dir;
+}
+
+
+static int load_cached(lua_State *L, const char *chunk, const char *abspath,
+                       struct stat *src, uint64_t srchash)
+{
+    char         path[PATH_MAX];
+    struct stat  st;
+    cache_hdr_t *hdr;
+    void        *map;
+    const char  *code;
+    size_t       plen;
+    int          fd, status;
+
+    if (cache_path(abspath, path, sizeof(path)) < 0)
+        return -1;
+
+    if ((fd = open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC)) < 0)
+        return -1;
+
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+        st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH)) ||
+        (size_t)st.st_size < sizeof(*hdr)) {
+        close(fd);
+        return -1;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED)
+        return -1;
+
+    hdr    = map;
+    plen   = strlen(abspath);
+    code   = (const char *)(hdr + 1) + hdr->pathlen;
+    status = -1;
+
+    if (hdr->magic != CACHE_MAGIC || hdr->version != CACHE_VERSION ||
+        hdr->luaver != LUA_VERSION_NUM)
+        goto stale;
+
+    if (hdr->dev != (uint64_t)src->st_dev ||
+        hdr->ino != (uint64_t)src->st_ino ||
+        hdr->mtime != source_mtime(src) ||
+        hdr->size != (uint64_t)src->st_size ||
+        hdr->srchash != srchash)
+        goto stale;
+
+    if (hdr->pathlen != plen ||
+        sizeof(*hdr) + plen + hdr->codelen != (size_t)st.st_size ||
+        memcmp(hdr + 1, abspath, plen) ||
+        hdr->codehash != hash_data(code, hdr->codelen))
+        goto stale;
+
+    if (luaL_loadbuffer(L, code, hdr->codelen, chunk) == 0)
+        status = 0;
+    else {
+        mrp_debug("failed to load cached chunk for '%s': %s", abspath,
+                  lua_tostring(L, -1));
+        lua_pop(L, 1);
+        goto stale;
+    }
+
+    munmap(map, st.st_size);
+
+    return status;
+
+ stale:
+    mrp_debug("discarding stale Lua bytecode cache '%s'", path);
+    munmap(map, st.st_size);
+    unlink(path);
+
+    return -1;
+}
+
+
+static int dump_writer(lua_State *L, const void *p, size_t size, void *ud)
+{
+    dump_t *d = ud;
+    size_t  n;
+
+    MRP_UNUSED(L);
+
+    if (d->len + size > d->size) {
+        n = d->size ? 2 * d->size : 16384;
+
+        while (n < d->len + size)
+            n *= 2;
+
+        if (mrp_realloc(d->buf, n) == NULL)
+            return 1;
+
+        d->size = n;
+    }
+
+    memcpy(d->buf + d->len, p, size);
+    d->len += size;
+
+    return 0;
+}
+
+
+static int write_all(int fd, const void *data, size_t size)
+{
+    const char *p = data;
+    ssize_t     n;
+
+    while (size > 0) {
+        if ((n = write(fd, p, size)) < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        p    += n;
+        size -= n;
+    }
+
+    return 0;
+}
+
+
+static void save_cached(lua_State *L, const char *abspath, struct stat *src,
+                        uint64_t srchash)
+{
+    char        path[PATH_MAX], tmp[PATH_MAX];
+    cache_hdr_t hdr;
+    dump_t      d;
+    int         fd, status;
+
+    if (cache_path(abspath, path, sizeof(path)) < 0)
+        return;
+
+    if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= (int)sizeof(tmp))
+        return;
+
+    mrp_clear(&d);
+
+#if LUA_VERSION_NUM >= 503
+    status = lua_dump(L, dump_writer, &d, 0);
+#else
+    status = lua_dump(L, dump_writer, &d);
+#endif
+
+    if (status != 0 || d.len > UINT32_MAX)
+        goto out;
+
+    mrp_clear(&hdr);
+    hdr.magic    = CACHE_MAGIC;
+    hdr.version  = CACHE_VERSION;
+    hdr.luaver   = LUA_VERSION_NUM;
+    hdr.dev      = src->st_dev;
+    hdr.ino      = src->st_ino;
+    hdr.mtime    = source_mtime(src);
+    hdr.size     = src->st_size;
+    hdr.srchash  = srchash;
+    hdr.codehash = hash_data(d.buf, d.len);
+    hdr.pathlen  = strlen(abspath);
+    hdr.codelen  = d.len;
+
+    if ((fd = mkstemp(tmp)) < 0)
+        goto out;
+
+    if (write_all(fd, &hdr, sizeof(hdr)) < 0 ||
+        write_all(fd, abspath, hdr.pathlen) < 0 ||
+        write_all(fd, d.buf, d.len) < 0) {
+        close(fd);
+        unlink(tmp);
+        goto out;
+    }
+
+    close(fd);
+
+    if (rename(tmp, path) < 0)
+        unlink(tmp);
+    else
+        mrp_debug("cached Lua bytecode of '%s' in '%s'", abspath, path);
+
+ out:
+    mrp_free(d.buf);
+}
+
+
+int mrp_lua_load_file(lua_State *L, const char *path)
+{
+    char         abspath[PATH_MAX], chunk[PATH_MAX + 1];
+    struct stat  st;
+    const char  *src, *code;
+    size_t       len;
+    uint64_t     hash;
+    int          fd, status;
+
+    if (cache_dir == NULL)
+        return luaL_loadfile(L, path);
+
+    if (realpath(path, abspath) == NULL ||
+        (fd = open(abspath, O_RDONLY | O_CLOEXEC)) < 0)
+        return luaL_loadfile(L, path);
+
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return luaL_loadfile(L, path);
+    }
+
+    src = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (src == MAP_FAILED)
+        return luaL_loadfile(L, path);
+
+    /* use the same chunk name luaL_loadfile would */
+    snprintf(chunk, sizeof(chunk), "@%s", path);
+
+    len  = st.st_size;
+    hash = hash_data(src, len);
+
+    if (load_cached(L, chunk, abspath, &st, hash) == 0) {
+        mrp_debug("loaded '%s' from Lua bytecode cache", path);
+        munmap((void *)src, st.st_size);
+        return 0;
+    }
+
+    /* skip a leading #! line like luaL_loadfile, but keep line numbers */
+    code = src;
+    if (*code == '#') {
+        while (len > 0 && *code != '\n') {
+            code++;
+            len--;
+        }
+    }
+
+    status = luaL_loadbuffer(L, code, len, chunk);
+
+    /* don't cache precompiled input, only what we had to compile */
+    if (status == 0 && *code != LUA_SIGNATURE[0])
+        save_cached(L, abspath, &st, hash);
+
+    munmap((void *)src, st.st_size);
+
+    return status;
+}
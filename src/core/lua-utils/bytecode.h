@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2012, 2013, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MURPHY_LUA_BYTECODE_H__
+#define __MURPHY_LUA_BYTECODE_H__
+
+#include <lualib.h>
+#include <lauxlib.h>
+
+/**
+ * Set the directory used to cache compiled Lua files, NULL to disable
+ * caching. The directory is created if necessary. It is refused unless
+ * it is owned by us and is not writable by anybody else.
+ */
+int mrp_lua_set_bytecode_cache(const char *dir);
+
+/** Get the current bytecode cache directory, or NULL if disabled. */
+const char *mrp_lua_get_bytecode_cache(void);
+
+/**
+ * Load the given Lua file, using the bytecode cache if it is enabled.
+ * This is a drop-in replacement for luaL_loadfile. A cached chunk is
+ * only used if the path, modification time, size and content hash of
+ * the source all match, otherwise the source is compiled and the cache
+ * is refreshed.
+ */
+int mrp_lua_load_file(lua_State *L, const char *path);
+
+#endif /* __MURPHY_LUA_BYTECODE_H__ */
@@ -38,6 +38,7 @@
 #include <murphy/common/file-utils.h>
 
 #include <murphy/core/lua-utils/include.h>
+#include <murphy/core/lua-utils/bytecode.h>
 
 
 /*
@@ -111,7 +112,7 @@ int mrp_lua_include_file(lua_State *L, const char *file, const char **dirs,
 
     mrp_debug("file '%s' resolved to '%s' for inclusion", file, path);
 
-    if (!luaL_loadfile(L, path) && !lua_pcall(L, 0, 0, 0)) {
+    if (!mrp_lua_load_file(L, path) && !lua_pcall(L, 0, 0, 0)) {
         if (files != NULL)
             save_included(files, path, st.st_dev, st.st_ino);
 
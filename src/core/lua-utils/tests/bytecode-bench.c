@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2012, 2013, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <libgen.h>
+#include <unistd.h>
+
+#include <lualib.h>
+#include <lauxlib.h>
+
+#include <murphy/core/lua-utils/bytecode.h>
+
+/*
+ * Compare the time it takes to load (but not run) the given Lua files
+ * from source with luaL_loadfile against loading them through a warm
+ * bytecode cache with mrp_lua_load_file, as the daemon does at startup.
+ */
+
+#define DEFAULT_SCRIPTS { "daemon/murphy.lua", "daemon/murphy-utils.lua" }
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+
+static double load_files(char **files, int nfile, int cached)
+{
+    lua_State *L;
+    double     start, end;
+    int        i, status;
+
+    if ((L = luaL_newstate()) == NULL) {
+        printf("failed to create Lua state\n");
+        exit(1);
+    }
+
+    start = now();
+
+    for (i = 0; i < nfile; i++) {
+        if (cached)
+            status = mrp_lua_load_file(L, files[i]);
+        else
+            status = luaL_loadfile(L, files[i]);
+
+        if (status != 0) {
+            printf("failed to load %s (%s)\n", files[i], lua_tostring(L, -1));
+            exit(1);
+        }
+
+        lua_pop(L, 1);
+    }
+
+    end = now();
+
+    lua_close(L);
+
+    return end - start;
+}
+
+
+int main(int argc, char **argv)
+{
+    char   *defaults[] = DEFAULT_SCRIPTS;
+    char    dir[] = "/tmp/lua-bytecode-bench.XXXXXX";
+    char    cmd[64];
+    char  **files;
+    int     nfile, rounds, r;
+    double  source, cached;
+
+    rounds = argc > 1 ? atoi(argv[1]) : 100;
+
+    if (rounds <= 0) {
+        printf("usage: %s [rounds [file...]]\n", basename(argv[0]));
+        exit(1);
+    }
+
+    if (argc > 2) {
+        files = argv + 2;
+        nfile = argc - 2;
+    }
+    else {
+        files = defaults;
+        nfile = sizeof(defaults) / sizeof(defaults[0]);
+    }
+
+    if (mkdtemp(dir) == NULL || mrp_lua_set_bytecode_cache(dir) < 0) {
+        printf("failed to set up bytecode cache (%s)\n", strerror(errno));
+        exit(1);
+    }
+
+    /* populate the cache */
+    load_files(files, nfile, 1);
+
+    source = cached = 0.0;
+
+    for (r = 0; r < rounds; r++) {
+        source += load_files(files, nfile, 0);
+        cached += load_files(files, nfile, 1);
+    }
+
+    printf("%d files, %d rounds, average per round:\n", nfile, rounds);
+    printf("    luaL_loadfile, parsing the source: %.3f ms\n",
+           1000.0 * source / rounds);
+    printf("    mrp_lua_load_file, bytecode cache: %.3f ms\n",
+           1000.0 * cached / rounds);
+
+    mrp_lua_set_bytecode_cache(NULL);
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+
+    return system(cmd) == 0 ? 0 : 1;
+}
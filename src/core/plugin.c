@@ -31,12 +31,16 @@
 #include <errno.h>
 #include <stdarg.h>
 #include <limits.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/mman.h>
 
 #include <murphy/common/list.h>
 #include <murphy/common/file-utils.h>
 #include <murphy/core/plugin.h>
+#include <murphy/core/timeline.h>
 
 #define PLUGIN_PREFIX "plugin-"
 #define BUILTIN TRUE
@@ -44,6 +48,8 @@
 
 #define __PARANOID_BLACKLIST_CHECK__
 
+#define PRELOAD_THREADS 4                /* max. preloading threads */
+
 static mrp_plugin_descr_t *open_builtin(mrp_context_t *ctx, const char *name);
 static mrp_plugin_descr_t *open_dynamic(mrp_context_t *ctx, const char *name,
                                         void **handle);
@@ -69,6 +75,32 @@ static int release_plugin_methods(mrp_plugin_t *plugin);
 static MRP_LIST_HOOK(builtin_plugins);
 
 
+/*
+ * plugin preloading
+ *
+ * Before the configuration is executed, the plugins it is going to load
+ * and the files it refers to are read into the page cache by a few worker
+ * threads. By the time a plugin gets dlopen'ed or a script gets read in
+ * the mainloop-bound startup path, no blocking disk I/O is left to do.
+ *
+ * Notes: The workers only read files. They don't dlopen anything, since
+ *        that would run the constructors of the plugins in a worker thread
+ *        concurrently with the main thread. dlopen itself is serialized by
+ *        the dynamic linker, so there would be no parallelism to gain there
+ *        anyway.
+ */
+
+typedef struct {
+    char      **paths;                   /* files to preload */
+    int         npath;                   /* number of files */
+    int         next;                    /* next file to pick */
+    pthread_t   threads[PRELOAD_THREADS]; /* worker threads */
+    int         nthread;                 /* number of workers */
+} preload_t;
+
+static preload_t *preload;
+
+
 /*
  * plugin-related events
  */
@@ -350,6 +382,7 @@ mrp_plugin_t *mrp_load_plugin(mrp_context_t *ctx, const char *name,
     void                *handle;
     mrp_console_group_t *cmds;
     char                 grpbuf[PATH_MAX], *cmdgrp;
+    int                  tl;
 
     if (name == NULL)
         return NULL;
@@ -372,8 +405,10 @@ mrp_plugin_t *mrp_load_plugin(mrp_context_t *ctx, const char *name,
     snprintf(path, sizeof(path), "%s/%s%s.so", ctx->plugin_dir,
              PLUGIN_PREFIX, name);
 
+    tl      = mrp_timeline_begin("plugin", "open %s", name);
     dynamic = open_dynamic(ctx, name, &handle);
     builtin = open_builtin(ctx, name);
+    mrp_timeline_end(tl);
 
     if (dynamic != NULL) {
         if (builtin != NULL)
@@ -654,9 +689,16 @@ int mrp_start_plugins(mrp_context_t *ctx)
 
 int mrp_start_plugin(mrp_plugin_t *plugin)
 {
+    int tl, success;
+
     if (plugin != NULL) {
         if (plugin->state == MRP_PLUGIN_LOADED) {
-            if (!plugin->descriptor->init(plugin)) {
+            tl      = mrp_timeline_begin("plugin", "init %s",
+                                         plugin->instance);
+            success = plugin->descriptor->init(plugin);
+            mrp_timeline_end(tl);
+
+            if (!success) {
                 mrp_log_error("Failed to start plugin %s (%s).",
                               plugin->instance, plugin->descriptor->name);
 
@@ -696,6 +738,136 @@ int mrp_stop_plugin(mrp_plugin_t *plugin)
 }
 
 
+static void preload_file(const char *path)
+{
+    struct stat  st;
+    void        *map;
+    int          fd, tl;
+
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+        return;
+
+    tl = mrp_timeline_begin("preload", "%s", path);
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE,
+                   fd, 0);
+
+        if (map != MAP_FAILED)
+            munmap(map, st.st_size);
+    }
+
+    mrp_timeline_end(tl);
+
+    close(fd);
+}
+
+
+static void *preload_worker(void *data)
+{
+    preload_t *pl = data;
+    int        i;
+
+    while ((i = __sync_fetch_and_add(&pl->next, 1)) < pl->npath)
+        preload_file(pl->paths[i]);
+
+    return NULL;
+}
+
+
+static void free_preload(preload_t *pl)
+{
+    int i;
+
+    for (i = 0; i < pl->npath; i++)
+        mrp_free(pl->paths[i]);
+
+    mrp_free(pl->paths);
+    mrp_free(pl);
+}
+
+
+int mrp_preload_plugins(mrp_context_t *ctx, const char **names, int nname,
+                        const char **files, int nfile)
+{
+    preload_t *pl;
+    char       path[PATH_MAX];
+    long       ncpu;
+    int        i;
+
+    if (preload != NULL || nname + nfile <= 0)
+        return 0;
+
+    if ((pl = mrp_allocz(sizeof(*pl))) == NULL)
+        return -1;
+
+    if ((pl->paths = mrp_allocz_array(char *, nname + nfile)) == NULL)
+        goto fail;
+
+    for (i = 0; i < nname; i++) {
+        if (is_blacklisted(ctx, names[i], DYNAMIC))
+            continue;
+
+        snprintf(path, sizeof(path), "%s/%s%s.so", ctx->plugin_dir,
+                 PLUGIN_PREFIX, names[i]);
+
+        if ((pl->paths[pl->npath] = mrp_strdup(path)) == NULL)
+            goto fail;
+
+        pl->npath++;
+    }
+
+    for (i = 0; i < nfile; i++) {
+        if ((pl->paths[pl->npath] = mrp_strdup(files[i])) == NULL)
+            goto fail;
+
+        pl->npath++;
+    }
+
+    ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+    while (pl->nthread < PRELOAD_THREADS && pl->nthread < pl->npath &&
+           pl->nthread < (ncpu > 0 ? ncpu : 1)) {
+        if (pthread_create(pl->threads + pl->nthread, NULL,
+                           preload_worker, pl) != 0)
+            break;
+
+        pl->nthread++;
+    }
+
+    if (pl->nthread == 0)
+        goto fail;
+
+    mrp_log_info("Preloading %d files on %d threads.", pl->npath,
+                 pl->nthread);
+
+    preload = pl;
+
+    return pl->npath;
+
+ fail:
+    free_preload(pl);
+
+    return -1;
+}
+
+
+void mrp_finish_preloading(void)
+{
+    preload_t *pl = preload;
+    int        i;
+
+    if (pl == NULL)
+        return;
+
+    for (i = 0; i < pl->nthread; i++)
+        pthread_join(pl->threads[i], NULL);
+
+    preload = NULL;
+    free_preload(pl);
+}
+
+
 static mrp_plugin_t *find_plugin_instance(mrp_context_t *ctx,
                                           const char *instance)
 {
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/log.h>
+#include <murphy/common/json-stream.h>
+#include <murphy/core/timeline.h>
+
+#define SPAN_NAME_MAX 64                 /* max. span name length */
+
+typedef struct {
+    char        name[SPAN_NAME_MAX];     /* span name */
+    const char *category;                /* span category */
+    uint64_t    start;                   /* start time (usecs) */
+    uint64_t    end;                     /* end time (usecs), 0 if open */
+    int         tid;                     /* recording thread */
+} span_t;
+
+static pthread_mutex_t  lock = PTHREAD_MUTEX_INITIALIZER;
+static span_t          *spans;           /* recorded spans */
+static int              nspan;           /* number of spans */
+static int              nalloc;          /* allocated spans */
+static int              stopped;         /* whether recording is off */
+
+
+static inline uint64_t now_usecs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+
+int mrp_timeline_begin(const char *category, const char *fmt, ...)
+{
+    span_t  *s;
+    va_list  ap;
+    int      id, n;
+
+    pthread_mutex_lock(&lock);
+
+    if (stopped) {
+        pthread_mutex_unlock(&lock);
+        return -1;
+    }
+
+    if (nspan >= nalloc) {
+        n = nalloc ? 2 * nalloc : 64;
+
+        /*
+         * Spans get recorded by the preloading threads, too. Use plain
+         * realloc, so we never call into the murphy allocator from them.
+         */
+        if ((s = realloc(spans, n * sizeof(*spans))) == NULL) {
+            pthread_mutex_unlock(&lock);
+            return -1;
+        }
+
+        spans  = s;
+        nalloc = n;
+    }
+
+    id = nspan++;
+    s  = spans + id;
+
+    va_start(ap, fmt);
+    vsnprintf(s->name, sizeof(s->name), fmt, ap);
+    va_end(ap);
+
+    s->category = category;
+    s->tid      = (int)syscall(SYS_gettid);
+    s->end      = 0;
+    s->start    = now_usecs();
+
+    pthread_mutex_unlock(&lock);
+
+    return id;
+}
+
+
+void mrp_timeline_end(int id)
+{
+    uint64_t end = now_usecs();
+
+    if (id < 0)
+        return;
+
+    pthread_mutex_lock(&lock);
+
+    if (id < nspan)
+        spans[id].end = end;
+
+    pthread_mutex_unlock(&lock);
+}
+
+
+static inline uint64_t span_duration(span_t *s, uint64_t now)
+{
+    return (s->end ? s->end : now) - s->start;
+}
+
+
+void mrp_timeline_log(void)
+{
+    uint64_t  now = now_usecs();
+    span_t   *s;
+    int       i;
+
+    pthread_mutex_lock(&lock);
+
+    for (i = 0, s = spans; i < nspan; i++, s++)
+        mrp_log_info("startup: %-8s %-40s %9.3f ms%s", s->category, s->name,
+                     span_duration(s, now) / 1000.0,
+                     s->end ? "" : " (unfinished)");
+
+    pthread_mutex_unlock(&lock);
+}
+
+
+static int write_all(int fd, const char *data, size_t size)
+{
+    ssize_t n;
+
+    while (size > 0) {
+        if ((n = write(fd, data, size)) < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        data += n;
+        size -= n;
+    }
+
+    return 0;
+}
+
+
+int mrp_timeline_dump(const char *path)
+{
+    mrp_json_writer_t  w;
+    uint64_t           now = now_usecs();
+    span_t            *s;
+    const char        *data;
+    size_t             size;
+    int                pid, fd, status, i;
+
+    pid = getpid();
+
+    mrp_json_writer_init(&w, NULL, 0, 0);
+    mrp_json_writer_begin_object(&w);
+    mrp_json_writer_key(&w, "traceEvents");
+    mrp_json_writer_begin_array(&w);
+
+    pthread_mutex_lock(&lock);
+
+    for (i = 0, s = spans; i < nspan; i++, s++) {
+        mrp_json_writer_begin_object(&w);
+        mrp_json_writer_add_string(&w, "name", s->name);
+        mrp_json_writer_add_string(&w, "cat" , s->category);
+        mrp_json_writer_add_string(&w, "ph"  , "X");
+        mrp_json_writer_key(&w, "ts");
+        mrp_json_writer_unsigned(&w, s->start - spans[0].start);
+        mrp_json_writer_key(&w, "dur");
+        mrp_json_writer_unsigned(&w, span_duration(s, now));
+        mrp_json_writer_key(&w, "pid");
+        mrp_json_writer_integer(&w, pid);
+        mrp_json_writer_key(&w, "tid");
+        mrp_json_writer_integer(&w, s->tid);
+        mrp_json_writer_end_object(&w);
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    mrp_json_writer_end_array(&w);
+    mrp_json_writer_add_string(&w, "displayTimeUnit", "ms");
+    mrp_json_writer_end_object(&w);
+
+    status = -1;
+    data   = mrp_json_writer_data(&w, &size);
+
+    if (mrp_json_writer_error(&w) != 0 || data == NULL) {
+        errno = mrp_json_writer_error(&w) ? mrp_json_writer_error(&w) : ENOMEM;
+        goto out;
+    }
+
+    if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0)
+        goto out;
+
+    status = write_all(fd, data, size);
+    close(fd);
+
+ out:
+    if (status < 0)
+        mrp_log_error("Failed to dump startup timeline to '%s' (%d: %s).",
+                      path, errno, strerror(errno));
+    else
+        mrp_log_info("Startup timeline dumped to '%s'.", path);
+
+    mrp_json_writer_cleanup(&w);
+
+    return status;
+}
+
+
+void mrp_timeline_stop(void)
+{
+    pthread_mutex_lock(&lock);
+
+    free(spans);
+    spans   = NULL;
+    nspan   = 0;
+    nalloc  = 0;
+    stopped = TRUE;
+
+    pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MURPHY_CORE_TIMELINE_H__
+#define __MURPHY_CORE_TIMELINE_H__
+
+#include <murphy/common/macros.h>
+
+MRP_CDECL_BEGIN
+
+/*
+ * startup timeline
+ *
+ * The startup timeline records how long the various phases of daemon
+ * startup, and loading, preloading and starting the individual plugins
+ * take. Recording is on from the start and is turned off for good once
+ * startup is done with mrp_timeline_stop(). Spans can be recorded from
+ * any thread. The result can be logged or dumped in the Chrome trace
+ * event format, suitable for chrome://tracing or Perfetto.
+ */
+
+/** Begin a span of the given category on the timeline, return its id. */
+int mrp_timeline_begin(const char *category, const char *fmt, ...)
+    MRP_PRINTF_LIKE(2, 3);
+
+/** End the span with the given id. */
+void mrp_timeline_end(int id);
+
+/** Log the duration of all recorded spans. */
+void mrp_timeline_log(void);
+
+/** Dump the timeline to the given file as Chrome trace event JSON. */
+int mrp_timeline_dump(const char *path);
+
+/** Stop recording and discard the timeline. */
+void mrp_timeline_stop(void);
+
+MRP_CDECL_END
+
+#endif /* __MURPHY_CORE_TIMELINE_H__ */
@@ -96,6 +96,8 @@ static void print_usage(mrp_context_t *ctx, const char *argv0, int exit_code,
            "  -R, --no-poststart-load        "
                     "disable post-startup plugin loading\n"
            "  -p, --disable-console          disable Murphy debug console\n"
+           "  -T, --startup-trace=PATH       log startup timeline, dump it\n"
+           "                                 to PATH as Chrome trace JSON\n"
 #ifdef GLIB_ENABLED
            "  -G, --gmainloop                run with GMainLoop\n"
 #endif
@@ -230,6 +232,28 @@ static void config_set_defaults(mrp_context_t *ctx, char *argv0)
 }
 
 
+static const char *trace_path(const char *path)
+{
+    static char trace_file[PATH_MAX];
+    char        cwd[PATH_MAX];
+    int         n;
+
+    /* daemonizing changes to /, so make relative paths absolute now */
+    if (path[0] == '/')
+        return path;
+
+    if (getcwd(cwd, sizeof(cwd)) == NULL)
+        return NULL;
+
+    n = snprintf(trace_file, sizeof(trace_file), "%s/%s", cwd, path);
+
+    if (n < 0 || n >= (int)sizeof(trace_file))
+        return NULL;
+
+    return trace_file;
+}
+
+
 void mrp_parse_cmdline(mrp_context_t *ctx, int argc, char **argv, char **envp)
 {
 #ifdef GLIB_ENABLED
@@ -237,7 +261,7 @@ void mrp_parse_cmdline(mrp_context_t *ctx, int argc, char **argv, char **envp)
 #else
 #    define GMAINOPT ""
 #endif
-#   define OPTIONS "c:C:l:t:fP:a:vd:hHqB:I:E:w:i:e:Rp"GMAINOPT"V"
+#   define OPTIONS "c:C:l:t:fP:a:vd:hHqB:I:E:w:i:e:RpT:"GMAINOPT"V"
     struct option options[] = {
         { "config-file"      , required_argument, NULL, 'c' },
         { "config-dir"       , required_argument, NULL, 'C' },
@@ -260,6 +284,7 @@ void mrp_parse_cmdline(mrp_context_t *ctx, int argc, char **argv, char **envp)
         { "whitelist-dynamic", required_argument, NULL, 'e' },
         { "no-poststart-load", no_argument      , NULL, 'R' },
         { "disable-console"  , no_argument      , NULL, 'p' },
+        { "startup-trace"    , required_argument, NULL, 'T' },
 #ifdef GLIB_ENABLED
         { "gmainloop"        , no_argument      , NULL, 'G' },
 #endif
@@ -408,6 +433,14 @@ void mrp_parse_cmdline(mrp_context_t *ctx, int argc, char **argv, char **envp)
             SAVE_OPT("-p");
             ctx->disable_console = TRUE;
             break;
+
+        case 'T':
+            SAVE_OPTARG("-T", optarg);
+            ctx->startup_trace = trace_path(optarg);
+            if (ctx->startup_trace == NULL)
+                print_usage(ctx, argv[0], EINVAL,
+                            "invalid startup trace path '%s'", optarg);
+            break;
 #ifdef GLIB_ENABLED
         case 'G':
             SAVE_OPT("-G");
@@ -639,6 +672,58 @@ void mrp_free_cfgfile(mrp_cfgfile_t *cfg)
 }
 
 
+void mrp_preload_cfgfile(mrp_context_t *ctx, mrp_cfgfile_t *cfg)
+{
+    const char      *names[MRP_CFG_MAXPRELOAD], *files[MRP_CFG_MAXPRELOAD];
+    int              nname, nfile, i;
+    mrp_list_hook_t *p, *n;
+    any_action_t    *a;
+    load_action_t   *load;
+    setcfg_action_t *set;
+    const char      *v;
+
+    nname = nfile = 0;
+
+    /*
+     * Collect the plugins loaded unconditionally and any files (Lua
+     * configuration, resolver ruleset, etc.) passed to them as paths.
+     */
+
+    mrp_list_foreach(&cfg->actions, p, n) {
+        a = mrp_list_entry(p, typeof(*a), hook);
+
+        switch (a->type) {
+        case ACTION_LOAD:
+        case ACTION_TRYLOAD:
+            load = (load_action_t *)a;
+
+            if (nname < MRP_CFG_MAXPRELOAD)
+                names[nname++] = load->name;
+
+            for (i = 0; i < load->narg; i++) {
+                v = load->args[i].str;
+
+                if (v != NULL && strchr(v, '/') && nfile < MRP_CFG_MAXPRELOAD)
+                    files[nfile++] = v;
+            }
+            break;
+
+        case ACTION_SETCFG:
+            set = (setcfg_action_t *)a;
+
+            if (set->id == CFGVAR_RESOLVER_RULES && nfile < MRP_CFG_MAXPRELOAD)
+                files[nfile++] = set->value;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    mrp_preload_plugins(ctx, names, nname, files, nfile);
+}
+
+
 int mrp_exec_cfgfile(mrp_context_t *ctx, mrp_cfgfile_t *cfg)
 {
     mrp_list_hook_t *p, *n;
@@ -55,6 +55,7 @@ void mrp_parse_cmdline(mrp_context_t *ctx, int argc, char **argv, char **envp);
 
 #define MRP_CFG_MAXLINE (16 * 1024)      /* input line length limit */
 #define MRP_CFG_MAXARGS  64              /* command argument limit */
+#define MRP_CFG_MAXPRELOAD 64            /* preloaded plugin/file limit */
 
 /* configuration keywords */
 #define MRP_KEYWORD_LOAD    "load-plugin"
@@ -81,6 +82,9 @@ typedef struct {
 /** Parse the given configuration file. */
 mrp_cfgfile_t *mrp_parse_cfgfile(const char *path);
 
+/** Start preloading the plugins and files used by the given configuration. */
+void mrp_preload_cfgfile(mrp_context_t *ctx, mrp_cfgfile_t *cfg);
+
 /** Execute the commands of the given parsed configuration file. */
 int mrp_exec_cfgfile(mrp_context_t *ctx, mrp_cfgfile_t *cfg);
 
@@ -37,6 +37,7 @@
 #include <murphy/common/utils.h>
 #include <murphy/core/context.h>
 #include <murphy/core/plugin.h>
+#include <murphy/core/timeline.h>
 #include <murphy/resolver/resolver.h>
 #include <murphy/daemon/config.h>
 #include <murphy/daemon/daemon.h>
@@ -69,6 +70,13 @@ static void create_mainloop(mrp_context_t *ctx);
 static void quit_mainloop(mrp_context_t *ctx, int exit_status);
 static void cleanup_mainloop(mrp_context_t *ctx);
 
+/* run a startup phase, recording it on the startup timeline */
+#define STARTUP_PHASE(_name, _code) do {                        \
+        int _tl = mrp_timeline_begin("daemon", _name);          \
+        _code;                                                  \
+        mrp_timeline_end(_tl);                                  \
+    } while (0)
+
 static int emit_daemon_event(mrp_context_t *ctx, int idx)
 {
     mrp_event_bus_t *bus   = ctx->daemon_bus;
@@ -156,11 +164,14 @@ static void load_configuration(mrp_context_t *ctx)
                      ctx->whitelist_dynamic ? ctx->whitelist_dynamic:"<none>");
 
         mrp_block_blacklisted_plugins(ctx);
+        mrp_preload_cfgfile(ctx, cfg);
 
         if (!mrp_exec_cfgfile(ctx, cfg)) {
             mrp_log_error("Failed to execute configuration.");
             exit(1);
         }
+
+        mrp_finish_preloading();
     }
     else {
         mrp_log_error("Failed to parse configuration file '%s'.",
@@ -330,6 +341,17 @@ static void cleanup_context(mrp_context_t *ctx)
 }
 
 
+static void finish_timeline(mrp_context_t *ctx)
+{
+    if (ctx->startup_trace != NULL) {
+        mrp_timeline_log();
+        mrp_timeline_dump(ctx->startup_trace);
+    }
+
+    mrp_timeline_stop();
+}
+
+
 static void set_linebuffered(FILE *stream)
 {
     fflush(stream);
@@ -347,19 +369,25 @@ static void set_nonbuffered(FILE *stream)
 int main(int argc, char *argv[], char *envp[])
 {
     mrp_context_t *ctx;
+    int            startup;
+
+    startup = mrp_timeline_begin("daemon", "startup");
+
+    STARTUP_PHASE("create context"    , ctx = create_context()              );
+    STARTUP_PHASE("setup signals"     , setup_signals(ctx)                  );
+    STARTUP_PHASE("create ruleset"    , create_ruleset(ctx)                 );
+    STARTUP_PHASE("parse command line", parse_cmdline(ctx, argc, argv, envp));
+    STARTUP_PHASE("create mainloop"   , create_mainloop(ctx)                );
+    STARTUP_PHASE("load configuration", load_configuration(ctx)             );
+    STARTUP_PHASE("start plugins"     , start_plugins(ctx)                  );
+    STARTUP_PHASE("load ruleset"      , load_ruleset(ctx)                   );
+    STARTUP_PHASE("prepare ruleset"   , prepare_ruleset(ctx)                );
+    STARTUP_PHASE("setup logging"     , setup_logging(ctx)                  );
+    STARTUP_PHASE("daemonize"         , daemonize(ctx)                      );
+
+    mrp_timeline_end(startup);
+    finish_timeline(ctx);
 
-    ctx = create_context();
-
-    setup_signals(ctx);
-    create_ruleset(ctx);
-    parse_cmdline(ctx, argc, argv, envp);
-    create_mainloop(ctx);
-    load_configuration(ctx);
-    start_plugins(ctx);
-    load_ruleset(ctx);
-    prepare_ruleset(ctx);
-    setup_logging(ctx);
-    daemonize(ctx);
     set_linebuffered(stdout);
     set_nonbuffered(stderr);
     run_mainloop(ctx);
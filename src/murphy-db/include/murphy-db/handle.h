@@ -46,6 +46,7 @@ int mdb_handle_map_destroy(mdb_handle_map_t *);
 mdb_handle_t mdb_handle_add(mdb_handle_map_t *, void *);
 void *mdb_handle_delete(mdb_handle_map_t *, mdb_handle_t);
 void *mdb_handle_get_data(mdb_handle_map_t *, mdb_handle_t);
+void *mdb_handle_replace_data(mdb_handle_map_t *, mdb_handle_t, void *);
 int mdb_handle_print(mdb_handle_map_t *, char *, int);
 
 
@@ -42,6 +42,10 @@ int mdb_trigger_delete_column_callback(mdb_table_t *, int,
 int mdb_trigger_add_row_callback(mdb_table_t *, mqi_trigger_cb_t, void *,
                                mqi_column_desc_t *);
 int mdb_trigger_delete_row_callback(mdb_table_t *, mqi_trigger_cb_t, void *);
+int mdb_trigger_add_changeset_callback(mdb_table_t *, mqi_trigger_cb_t, void *,
+                                       mqi_column_desc_t *);
+int mdb_trigger_delete_changeset_callback(mdb_table_t *, mqi_trigger_cb_t,
+                                          void *);
 int mdb_trigger_add_table_callback(mqi_trigger_cb_t, void *);
 int mdb_trigger_delete_table_callback(mqi_trigger_cb_t, void *);
 int mdb_trigger_add_transaction_callback(mqi_trigger_cb_t, void *);
@@ -59,6 +63,10 @@ int mdb_table_drop(mdb_table_t *);
 int mdb_table_create_index(mdb_table_t *, char **);
 int mdb_table_describe(mdb_table_t *, mqi_column_def_t *, int);
 int mdb_table_insert(mdb_table_t *, int, mqi_column_desc_t *, void **);
+int mdb_table_insert_rows(mdb_table_t *, int, mqi_column_desc_t *,
+                          void *, int, int);
+int mdb_table_insert_row(mdb_table_t *, int, mqi_column_desc_t *, void *,
+                         mqi_handle_t *);
 int mdb_table_select(mdb_table_t *, mqi_cond_entry_t *,
                      mqi_column_desc_t *, void *, int, int);
 int mdb_table_select_by_index(mdb_table_t *, mqi_variable_t *,
@@ -66,6 +74,9 @@ int mdb_table_select_by_index(mdb_table_t *, mqi_variable_t *,
 int mdb_table_update(mdb_table_t *, mqi_cond_entry_t *,
                      mqi_column_desc_t *, void *);
 int mdb_table_delete(mdb_table_t *, mqi_cond_entry_t *);
+int mdb_table_update_row(mdb_table_t *, mqi_handle_t, mqi_column_desc_t *,
+                         void *);
+int mdb_table_delete_row(mdb_table_t *, mqi_handle_t);
 
 
 mdb_table_t *mdb_table_find(char *);
@@ -74,6 +85,9 @@ int mdb_table_get_size(mdb_table_t *);
 char *mdb_table_get_column_name(mdb_table_t *, int);
 mqi_data_type_t mdb_table_get_column_type(mdb_table_t *, int);
 int mdb_table_get_column_size(mdb_table_t *, int);
+int mdb_table_get_column_offset(mdb_table_t *, int);
+int mdb_table_get_row_length(mdb_table_t *);
+int mdb_table_dump_rows(mdb_table_t *, void *, int);
 uint32_t mdb_table_get_stamp(mdb_table_t *);
 int mdb_table_print_rows(mdb_table_t *, char *, int);
 
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MQI_SHM_H__
+#define __MQI_SHM_H__
+
+#include <murphy-db/mqi-types.h>
+
+/*
+ * Shared memory access to MQI tables.
+ *
+ * Tables created with the MQI_SHARED flag are kept in the in-process
+ * database like any other table, but a copy of their rows is also
+ * published in a memfd-backed shared memory region whenever a change
+ * to them is committed. The region holds two snapshot buffers, each
+ * protected by its own sequence counter. The publisher always writes
+ * the buffer which is not the current one, then flips the current one
+ * over. Local clients can thus map the region read-only and read the
+ * latest committed contents without any IPC round-trip, and rarely
+ * ever need to retry a read.
+ *
+ * Snapshot rows use the same layout as rows in the database. Integer
+ * and floating point columns are stored as such, varchar and blob
+ * columns inline with their maximum length, each column at the offset
+ * reported by mqi_shm_get_column_offset(). Rows of indexed tables are
+ * in index order.
+ *
+ * The server exports a table with mqi_shm_export(), which returns a
+ * read-only descriptor for the region and one for an eventfd that is
+ * signalled every time a new snapshot is published. The server passes
+ * both to the client over a unix domain socket, and the client opens
+ * them with mqi_shm_attach(). The eventfd is shared by all clients of
+ * a table: watch it edge-triggered (EPOLLET, MRP_IO_TRIGGER_EDGE) and
+ * do not read it.
+ */
+
+typedef struct mqi_shm_s mqi_shm_t;
+
+/* server side: get descriptors to pass to a client for a shared table */
+int mqi_shm_export(mqi_handle_t, int *shmfd, int *evfd);
+
+/* client side: attach to/detach from an exported table */
+mqi_shm_t *mqi_shm_attach(int shmfd, int evfd);
+void mqi_shm_detach(mqi_shm_t *);
+
+const char *mqi_shm_get_table_name(mqi_shm_t *);
+int mqi_shm_describe(mqi_shm_t *, mqi_column_def_t *, int);
+int mqi_shm_get_column_index(mqi_shm_t *, const char *);
+int mqi_shm_get_column_offset(mqi_shm_t *, int);
+int mqi_shm_get_row_length(mqi_shm_t *);
+int mqi_shm_get_fd(mqi_shm_t *);
+uint32_t mqi_shm_get_generation(mqi_shm_t *);
+int mqi_shm_changed(mqi_shm_t *);
+
+/* copy a consistent snapshot of the rows to a buffer of dim rows */
+int mqi_shm_read(mqi_shm_t *, void *rows, int dim);
+
+/*
+ * Access the rows in place. mqi_shm_read_begin() returns the number of
+ * rows and sets *rows to point to them. After processing the rows,
+ * mqi_shm_read_end() tells whether they were consistent: if it fails
+ * with EAGAIN the publisher overwrote them in the meantime and any
+ * results derived from them need to be discarded and the read retried.
+ */
+int mqi_shm_read_begin(mqi_shm_t *, const void **rows, uint32_t *token);
+int mqi_shm_read_end(mqi_shm_t *, uint32_t token);
+
+
+#endif /* __MQI_SHM_H__ */
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
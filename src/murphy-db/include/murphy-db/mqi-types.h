@@ -117,7 +117,9 @@ enum mqi_event_type_e {
     mqi_table_created,
     mqi_table_dropped,
     mqi_transaction_start,
-    mqi_transaction_end
+    mqi_transaction_end,
+    mqi_row_updated,
+    mqi_table_changed
 };
 
 
@@ -142,13 +144,16 @@ typedef struct mqi_change_select_s   mqi_change_select_t;
 typedef struct mqi_change_coldsc_s   mqi_change_coldsc_t;
 typedef union mqi_change_data_u      mqi_change_data_t;
 typedef struct mqi_change_value_s    mqi_change_value_t;
+typedef struct mqi_change_row_s      mqi_change_row_t;
 
 typedef struct mqi_column_event_s    mqi_column_event_t;
 typedef struct mqi_row_event_s       mqi_row_event_t;
 typedef struct mqi_table_event_s     mqi_table_event_t;
 typedef struct mqi_transact_event_s  mqi_transact_event_t;
+typedef struct mqi_changeset_event_s mqi_changeset_event_t;
 
 typedef void (*mqi_trigger_cb_t)(mqi_event_t *, void *);
+typedef void (*mqi_materialize_cb_t)(mqi_handle_t, int, void *);
 
 
 
@@ -218,6 +223,12 @@ struct mqi_change_value_s {
     mqi_change_data_t new_;
 };
 
+struct mqi_change_row_s {
+    mqi_event_type_t  event;    /* mqi_row_inserted, _deleted or _updated */
+    void             *old;      /* selected columns before the change */
+    void             *new_;     /* selected columns after the change */
+};
+
 
 struct mqi_column_event_s {
     mqi_event_type_t    event;
@@ -243,6 +254,13 @@ struct mqi_transact_event_s {
     uint32_t          depth;
 };
 
+struct mqi_changeset_event_s {
+    mqi_event_type_t    event;
+    mqi_change_table_t  table;
+    int                 nrow;
+    mqi_change_row_t   *rows;
+};
+
 
 union mqi_event_u {
     mqi_event_type_t     event;
@@ -250,6 +268,7 @@ union mqi_event_u {
     mqi_row_event_t      row;
     mqi_table_event_t    table;
     mqi_transact_event_t transact;
+    mqi_changeset_event_t changeset;
 };
 
 
@@ -38,8 +38,9 @@
 /* table flags */
 #define MQI_PERSISTENT        (1 << 0)
 #define MQI_TEMPORARY         (1 << 1)
+#define MQI_SHARED            (1 << 2)  /* published in shared memory */
 #define MQI_ANY               (MQI_PERSISTENT | MQI_TEMPORARY)
-#define MQI_TABLE_TYPE_MASK   (MQI_PERSISTENT | MQI_TEMPORARY)
+#define MQI_TABLE_TYPE_MASK   (MQI_PERSISTENT | MQI_TEMPORARY | MQI_SHARED)
 
 
 #define MQI_COLUMN_DEFINITION(name, type...)  \
@@ -140,6 +141,33 @@
 #define MQI_REPLACE(table, column_descs, data)                  \
     mqi_insert_into(table, 1, column_descs, (void **)data)
 
+#define MQI_INSERT_ROWS(table, column_descs, rows)              \
+    mqi_insert_rows(table, column_descs, rows, sizeof(rows[0]), \
+                    MQI_DIMENSION(rows))
+
+#define MQI_UPSERT_ROWS(table, column_descs, rows)              \
+    mqi_upsert_rows(table, column_descs, rows, sizeof(rows[0]), \
+                    MQI_DIMENSION(rows))
+
+/*
+ * Single-row access by row handle. A handle, obtained on insertion,
+ * keeps referring to the same row until the row is deleted, so rows
+ * with a known identity can be updated or deleted without evaluating
+ * any conditions. Changes are logged and triggers fired just like for
+ * the conditional variants.
+ */
+#define MQI_INSERT_ROW(table, column_descs, data, row)          \
+    mqi_insert_row(table, 0, column_descs, data, row)
+
+#define MQI_REPLACE_ROW(table, column_descs, data, row)         \
+    mqi_insert_row(table, 1, column_descs, data, row)
+
+#define MQI_UPDATE_ROW(table, column_descs, data, row)          \
+    mqi_update_row(table, row, column_descs, data)
+
+#define MQI_DELETE_ROW(table, row)                              \
+    mqi_delete_row(table, row)
+
 #define MQI_SELECT(columns, table, where, result)               \
     mqi_select(table, where, columns, result,                   \
                sizeof(result[0]), MQI_DIMENSION(result))
@@ -170,6 +198,16 @@ int mqi_drop_transaction_trigger(mqi_trigger_cb_t, void *);
 int mqi_drop_table_trigger(mqi_trigger_cb_t, void *);
 int mqi_drop_row_trigger(mqi_handle_t, mqi_trigger_cb_t,void *);
 int mqi_drop_column_trigger(mqi_handle_t, int, mqi_trigger_cb_t, void *);
+
+/*
+ * Changeset triggers are called once per table when the outermost
+ * transaction is over, with the list of all rows inserted, deleted or
+ * updated in it, instead of once for every row.
+ */
+int mqi_create_changeset_trigger(mqi_handle_t, mqi_trigger_cb_t, void *,
+                                 mqi_column_desc_t *);
+int mqi_drop_changeset_trigger(mqi_handle_t, mqi_trigger_cb_t, void *);
+
 mqi_handle_t mqi_begin_transaction(void);
 int mqi_commit_transaction(mqi_handle_t);
 int mqi_rollback_transaction(mqi_handle_t);
@@ -180,7 +218,13 @@ int mqi_create_index(mqi_handle_t, char **);
 int mqi_drop_table(mqi_handle_t);
 int mqi_describe(mqi_handle_t, mqi_column_def_t *, int);
 int mqi_insert_into(mqi_handle_t, int, mqi_column_desc_t *, void **);
+int mqi_insert_rows(mqi_handle_t, mqi_column_desc_t *, void *, int, int);
+int mqi_upsert_rows(mqi_handle_t, mqi_column_desc_t *, void *, int, int);
 int mqi_delete_from(mqi_handle_t, mqi_cond_entry_t *);
+int mqi_insert_row(mqi_handle_t, int, mqi_column_desc_t *, void *,
+                   mqi_handle_t *);
+int mqi_update_row(mqi_handle_t, mqi_handle_t, mqi_column_desc_t *, void *);
+int mqi_delete_row(mqi_handle_t, mqi_handle_t);
 int mqi_update(mqi_handle_t, mqi_cond_entry_t *, mqi_column_desc_t *, void *);
 int mqi_select(mqi_handle_t, mqi_cond_entry_t *, mqi_column_desc_t *,
                void *, int, int);
@@ -196,6 +240,19 @@ int mqi_get_column_size(mqi_handle_t, int);
 uint32_t mqi_get_table_stamp(mqi_handle_t);
 int mqi_print_rows(mqi_handle_t, char *, int);
 
+/*
+ * Subscriptions for lazily mirrored tables. A table with a materializer
+ * is only kept up to date by its producer while it has subscribers. Row
+ * and column triggers subscribe implicitly. The materializer is called
+ * with a nonzero flag when the first subscriber arrives, so the producer
+ * can fill the table in bulk, and with zero after the last one is gone,
+ * so the producer can empty the table and stop updating it.
+ */
+int mqi_set_table_materializer(mqi_handle_t, mqi_materialize_cb_t, void *);
+int mqi_subscribe_table(mqi_handle_t);
+int mqi_unsubscribe_table(mqi_handle_t);
+int mqi_table_is_subscribed(mqi_handle_t);
+
 
 #endif /* __MQI_MQI_H__ */
 
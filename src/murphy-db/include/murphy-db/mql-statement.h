@@ -59,6 +59,16 @@ typedef struct mql_statement_s {
 
 
 mql_result_t *mql_exec_statement(mql_result_type_t, mql_statement_t *);
+
+/*
+ * Like mql_exec_statement() but takes over an earlier result of the same
+ * statement. Rows of a select are refilled into it in place whenever it
+ * is large enough, so periodically re-executed selects do not need to
+ * allocate. The earlier result is either reused or freed; the caller must
+ * not touch it afterwards.
+ */
+mql_result_t *mql_exec_statement_into(mql_result_type_t, mql_statement_t *,
+                                      mql_result_t *);
 int mql_bind_value(mql_statement_t *, int, mqi_data_type_t, ...);
 void mql_statement_free(mql_statement_t *);
 
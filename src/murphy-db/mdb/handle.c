@@ -180,6 +180,17 @@ void *mdb_handle_get_data(mdb_handle_map_t *hmap, mdb_handle_t h)
     return entry->data;
 }
 
+void *mdb_handle_replace_data(mdb_handle_map_t *hmap, mdb_handle_t h,
+                              void *data)
+{
+    uint32_t  useid = HANDLE_USEID(h);
+    int       index = HANDLE_INDEX(h);
+
+    MDB_CHECKARG(hmap && h != MDB_HANDLE_INVALID && data, NULL);
+
+    return index_realloc(&hmap->indextbl, useid,index, data);
+}
+
 
 int mdb_handle_print(mdb_handle_map_t *hmap, char *buf, int len)
 {
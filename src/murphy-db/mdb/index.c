@@ -236,8 +236,9 @@ int mdb_index_insert(mdb_table_t   *tbl,
             return -1;
         }
 
+        /* swap the rows in place in the sequence, avoiding a memmove */
         if (!(old = mdb_hash_delete(hash, lgh,key)) ||
-            (old != mdb_sequence_delete(seq, lgh,key)))
+            (old != mdb_sequence_replace(seq, lgh,key, row)))
         {
             /* something is really broken: get out quickly */
             errno = EIO;
@@ -252,7 +253,7 @@ int mdb_index_insert(mdb_table_t   *tbl,
             }
 
             mdb_hash_add(hash, lgh,key, row);
-            mdb_sequence_add(seq, lgh,key, row);
+            mdb_row_move_handle(tbl, row, old);
         }
     }
     else { /* duplicate insertion is an error. keep the original row */
@@ -47,6 +47,8 @@
 #define LOG_STATISTICS
 #endif
 
+#define CHANGE_CACHE_MAX    256  /* max. number of free change_t's kept */
+
 #define LOG_COMMON_FIELDS   \
     mdb_dlist_t     vlink;  \
     mdb_dlist_t     hlink;  \
@@ -86,8 +88,12 @@ static tx_log_t *get_tx_log(uint32_t);
 static tbl_log_t *get_tbl_log(mdb_dlist_t *, mdb_dlist_t *, uint32_t,
                               mdb_table_t *);
 static void delete_tx_log(uint32_t);
+static inline change_t *alloc_change(void);
+static inline void free_change(change_t *);
 
 static MDB_DLIST_HEAD(tx_head);
+static MDB_DLIST_HEAD(change_cache);
+static int nchange_cache;
 
 int mdb_log_create(mdb_table_t *tbl)
 {
@@ -109,6 +115,7 @@ int mdb_log_change(mdb_table_t    *tbl,
     tx_log_t  *txlog;
     tbl_log_t *tblog;
     change_t  *change;
+    mqi_event_type_t event;
 
     MDB_CHECKARG(tbl, -1);
 
@@ -121,7 +128,7 @@ int mdb_log_change(mdb_table_t    *tbl,
         return -1;
     }
 
-    if (!(change = calloc(1, sizeof(change_t)))) {
+    if (!(change = alloc_change())) {
         errno = ENOMEM;
         return -1;
     }
@@ -132,14 +139,17 @@ int mdb_log_change(mdb_table_t    *tbl,
     change->after   = after;
 
     switch (type) {
-    case mdb_log_insert: tbl->cnt.inserts++; break;
-    case mdb_log_delete: tbl->cnt.deletes++; break;
-    case mdb_log_update: tbl->cnt.updates++; break;
-    default:                                 break;
+    case mdb_log_insert: tbl->cnt.inserts++; event = mqi_row_inserted;  break;
+    case mdb_log_delete: tbl->cnt.deletes++; event = mqi_row_deleted;   break;
+    case mdb_log_update: tbl->cnt.updates++; event = mqi_row_updated;   break;
+    default:                                 event = mqi_event_unknown; break;
     }
 
     MDB_DLIST_PREPEND(change_t, link, change, &tblog->changes);
 
+    if (event != mqi_event_unknown)
+        mdb_trigger_changeset_record(tbl, depth, event, before, after);
+
     return 0;
 }
 
@@ -234,7 +244,7 @@ mdb_log_entry_t *mdb_log_transaction_iterate(uint32_t   depth,
 
             if (delete) {
                 MDB_DLIST_UNLINK(change_t, link, change);
-                free(change);
+                free_change(change);
             }
 
             return entry;
@@ -336,7 +346,7 @@ mdb_log_entry_t *mdb_log_table_iterate(mdb_table_t  *tbl,
 
             if (delete) {
                 MDB_DLIST_UNLINK(change_t, link, change);
-                free(change);
+                free_change(change);
             }
 
             return entry;
@@ -433,13 +443,13 @@ static tbl_log_t *get_tbl_log(mdb_dlist_t *vhead,
             log->table = tbl;
             MDB_DLIST_INIT(log->changes);
 
-            if (!(change = calloc(1, sizeof(change_t)))) {
+            if (!(change = alloc_change())) {
                 errno = ENOMEM;
                 return NULL;
             }
 
             if (!(change->cnt = calloc(1, sizeof(*change->cnt)))) {
-                free(change);
+                free_change(change);
                 errno = ENOMEM;
                 return NULL;
             }
@@ -470,6 +480,32 @@ static tbl_log_t *get_tbl_log(mdb_dlist_t *vhead,
     return log;
 }
 
+static inline change_t *alloc_change(void)
+{
+    change_t *change;
+
+    if (MDB_DLIST_EMPTY(change_cache))
+        return calloc(1, sizeof(change_t));
+
+    change = MDB_LIST_RELOCATE(change_t, link, change_cache.next);
+    MDB_DLIST_UNLINK(change_t, link, change);
+    nchange_cache--;
+
+    memset(change, 0, sizeof(change_t));
+
+    return change;
+}
+
+static inline void free_change(change_t *change)
+{
+    if (nchange_cache >= CHANGE_CACHE_MAX)
+        free(change);
+    else {
+        MDB_DLIST_PREPEND(change_t, link, change, &change_cache);
+        nchange_cache++;
+    }
+}
+
 static void delete_tx_log(uint32_t depth)
 {
     log_t *log;
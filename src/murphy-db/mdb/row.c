@@ -44,6 +44,11 @@
 #include "column.h"
 
 
+#define ROW_CACHE_MAX 64        /* max. number of free rows kept per table */
+
+static mdb_row_t *row_alloc(mdb_table_t *);
+static void row_free(mdb_table_t *, mdb_row_t *);
+
 
 mdb_row_t *mdb_row_create(mdb_table_t *tbl)
 {
@@ -51,7 +56,7 @@ mdb_row_t *mdb_row_create(mdb_table_t *tbl)
 
     MDB_CHECKARG(tbl, NULL);
 
-    if (!(row = calloc(1, sizeof(mdb_row_t) + tbl->dlgh))) {
+    if (!(row = row_alloc(tbl))) {
         errno = ENOMEM;
         return NULL;
     }
@@ -67,7 +72,7 @@ mdb_row_t *mdb_row_duplicate(mdb_table_t *tbl, mdb_row_t *row)
 
     MDB_CHECKARG(tbl && row, NULL);
 
-    if (!(dup = calloc(1, sizeof(mdb_row_t) + tbl->dlgh))) {
+    if (!(dup = row_alloc(tbl))) {
         errno = ENOMEM;
         return NULL;
     }
@@ -85,8 +90,6 @@ int mdb_row_delete(mdb_table_t *tbl,
 {
     int sts = 0;
 
-    (void)tbl;
-
     MDB_CHECKARG(row, -1);
 
     if (index_update && mdb_index_delete(tbl, row) < 0)
@@ -96,7 +99,7 @@ int mdb_row_delete(mdb_table_t *tbl,
         MDB_DLIST_UNLINK(mdb_row_t, link, row);
 
     if (free_it)
-        free(row);
+        row_free(tbl, row);
     else
         MDB_DLIST_INIT(row->link);
 
@@ -161,6 +164,109 @@ int mdb_row_copy_over(mdb_table_t *tbl, mdb_row_t *dst, mdb_row_t *src)
     return 0;
 }
 
+/*
+ * Row handles are handed out on demand and stay with the row until it
+ * is freed. They survive updates, and deletions rolled back. Rows
+ * replacing a duplicate on upsert take over the handle of the row they
+ * replace.
+ */
+
+mqi_handle_t mdb_row_get_handle(mdb_table_t *tbl, mdb_row_t *row)
+{
+    MDB_CHECKARG(tbl && row, MQI_HANDLE_INVALID);
+
+    if (row->handle != MDB_HANDLE_INVALID)
+        return row->handle;
+
+    if (!tbl->row_handles && !(tbl->row_handles = MDB_HANDLE_MAP_CREATE()))
+        return MQI_HANDLE_INVALID;
+
+    row->handle = mdb_handle_add(tbl->row_handles, row);
+
+    return row->handle;
+}
+
+void mdb_row_move_handle(mdb_table_t *tbl, mdb_row_t *dst, mdb_row_t *src)
+{
+    if ((dst->handle = src->handle) != MDB_HANDLE_INVALID) {
+        mdb_handle_replace_data(tbl->row_handles, dst->handle, dst);
+        src->handle = MDB_HANDLE_INVALID;
+    }
+}
+
+mdb_row_t *mdb_row_find(mdb_table_t *tbl, mqi_handle_t h)
+{
+    mdb_row_t *row;
+
+    MDB_CHECKARG(tbl && h != MQI_HANDLE_INVALID, NULL);
+
+    if (!tbl->row_handles) {
+        errno = ENOENT;
+        return NULL;
+    }
+
+    if (!(row = mdb_handle_get_data(tbl->row_handles, h))) {
+        errno = ENOENT;
+        return NULL;
+    }
+
+    /* deleted in a transaction still in progress */
+    if (MDB_DLIST_EMPTY(row->link)) {
+        errno = ENOENT;
+        return NULL;
+    }
+
+    return row;
+}
+
+void mdb_row_purge_cache(mdb_table_t *tbl)
+{
+    mdb_row_t *row, *n;
+
+    MDB_DLIST_FOR_EACH_SAFE(mdb_row_t, link, row,n, &tbl->free_rows)
+        free(row);
+
+    MDB_DLIST_INIT(tbl->free_rows);
+    tbl->nfree_row = 0;
+}
+
+
+static mdb_row_t *row_alloc(mdb_table_t *tbl)
+{
+    mdb_row_t *row;
+
+    if (MDB_DLIST_EMPTY(tbl->free_rows)) {
+        if ((row = calloc(1, sizeof(mdb_row_t) + tbl->dlgh)) != NULL)
+            row->handle = MDB_HANDLE_INVALID;
+
+        return row;
+    }
+
+    row = MDB_LIST_RELOCATE(mdb_row_t, link, tbl->free_rows.next);
+    MDB_DLIST_UNLINK(mdb_row_t, link, row);
+    tbl->nfree_row--;
+
+    memset(row->data, 0, tbl->dlgh);
+
+    return row;
+}
+
+static void row_free(mdb_table_t *tbl, mdb_row_t *row)
+{
+    if (row->handle != MDB_HANDLE_INVALID) {
+        if (tbl)
+            mdb_handle_delete(tbl->row_handles, row->handle);
+        row->handle = MDB_HANDLE_INVALID;
+    }
+
+    if (!tbl || tbl->nfree_row >= ROW_CACHE_MAX)
+        free(row);
+    else {
+        MDB_DLIST_PREPEND(mdb_row_t, link, row, &tbl->free_rows);
+        tbl->nfree_row++;
+    }
+}
+
 
 /*
  * Local Variables:
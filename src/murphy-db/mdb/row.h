@@ -32,13 +32,15 @@
 
 #include <murphy-db/mqi-types.h>
 #include <murphy-db/list.h>
+#include <murphy-db/handle.h>
 #include <murphy-db/mdb.h>
 
 typedef struct mdb_row_s mdb_row_t;
 
 struct mdb_row_s {
-    mdb_dlist_t  link;
-    uint8_t      data[0];
+    mdb_dlist_t   link;
+    mdb_handle_t  handle;       /* row handle, if one was ever asked for */
+    uint8_t       data[0];
 };
 
 mdb_row_t *mdb_row_create(mdb_table_t *);
@@ -47,6 +49,10 @@ int mdb_row_delete(mdb_table_t *, mdb_row_t *, int, int);
 int mdb_row_update(mdb_table_t *, mdb_row_t *, mqi_column_desc_t *,
                    void *, int, mqi_bitfld_t *);
 int mdb_row_copy_over(mdb_table_t *, mdb_row_t *, mdb_row_t *);
+void mdb_row_purge_cache(mdb_table_t *);
+mqi_handle_t mdb_row_get_handle(mdb_table_t *, mdb_row_t *);
+void mdb_row_move_handle(mdb_table_t *, mdb_row_t *, mdb_row_t *);
+mdb_row_t *mdb_row_find(mdb_table_t *, mqi_handle_t);
 
 #endif /* __MDB_ROW_H__ */
 
@@ -198,33 +198,22 @@ int mdb_sequence_add(mdb_sequence_t *seq, int klen, void *key, void *data)
     return 0;
 }
 
-void *mdb_sequence_delete(mdb_sequence_t *seq, int klen, void *key)
+static int find_entry(mdb_sequence_t *seq, int klen, void *key)
 {
-    sequence_entry_t *entry;
-    int               i;
-    int               min, max;
-    int               cmp;
-    int               found;
-    void             *data;
-    size_t            length;
+    int i;
+    int min, max;
+    int cmp;
 
-    MDB_CHECKARG(seq && key, NULL);
-
-    for (found = 0, min = 0, i = (max = seq->nentry)/2;  ;  i = (min+max)/2) {
-        entry = seq->entries + i;
-
-        if (!(cmp = seq->scomp(klen, key, entry->key))) {
-            found = 1;
-            break;
-        }
+    for (min = 0, i = (max = seq->nentry)/2;  ;  i = (min+max)/2) {
+        if (!(cmp = seq->scomp(klen, key, seq->entries[i].key)))
+            return i;
 
         if (i == min) {
             if (i != max) {
-                entry = seq->entries + max;
-                if (!seq->scomp(klen, key, entry->key))
-                    found = 1;
+                if (!seq->scomp(klen, key, seq->entries[max].key))
+                    return max;
             }
-            break;
+            return -1;
         }
 
         if (cmp < 0)
@@ -232,13 +221,47 @@ void *mdb_sequence_delete(mdb_sequence_t *seq, int klen, void *key)
         else
             min = i;
     }
+}
+
+void *mdb_sequence_replace(mdb_sequence_t *seq, int klen, void *key,
+                           void *data)
+{
+    sequence_entry_t *entry;
+    void             *old;
+    int               i;
 
-    if (!found) {
+    MDB_CHECKARG(seq && key && data, NULL);
+
+    if ((i = find_entry(seq, klen, key)) < 0) {
         errno = ENOENT;
         return NULL;
     }
 
-    data = entry->data;
+    entry = seq->entries + i;
+    old   = entry->data;
+
+    entry->key  = key;
+    entry->data = data;
+
+    return old;
+}
+
+void *mdb_sequence_delete(mdb_sequence_t *seq, int klen, void *key)
+{
+    sequence_entry_t *entry;
+    int               i;
+    void             *data;
+    size_t            length;
+
+    MDB_CHECKARG(seq && key, NULL);
+
+    if ((i = find_entry(seq, klen, key)) < 0) {
+        errno = ENOENT;
+        return NULL;
+    }
+
+    entry = seq->entries + i;
+    data  = entry->data;
 
     if (--seq->nentry <= 0) {
         free(seq->entries);
@@ -73,6 +73,7 @@ static int update_single_row(mdb_table_t *, mdb_row_t *, mqi_column_desc_t *,
 static int delete_conditional(mdb_table_t *, mqi_cond_entry_t *);
 static int delete_all(mdb_table_t *);
 static int delete_single_row(mdb_table_t *, mdb_row_t *, int);
+static int updates_index(mdb_table_t *, mqi_column_desc_t *);
 
 
 mdb_table_t *mdb_table_create(char *name,
@@ -178,6 +179,7 @@ mdb_table_t *mdb_table_create(char *name,
     tbl->dlgh      = dlgh;
 
     MDB_DLIST_INIT(tbl->rows);
+    MDB_DLIST_INIT(tbl->free_rows);
     mdb_log_create(tbl);
     mdb_trigger_init(&tbl->trigger, ncolumn);
 
@@ -285,44 +287,63 @@ int mdb_table_describe(mdb_table_t *tbl, mqi_column_def_t *defs, int len)
     return n;
 }
 
+static int insert_row(mdb_table_t       *tbl,
+                      uint32_t           txdepth,
+                      int                ignore,
+                      mqi_column_desc_t *cds,
+                      void              *data,
+                      mqi_handle_t      *rowh)
+{
+    mdb_row_t    *row;
+    mqi_bitfld_t  cmask;
+    int           nrow;
+
+    if (!(row = mdb_row_create(tbl))) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    mdb_row_update(tbl, row, cds, data, 0, &cmask);
+
+    if ((nrow = mdb_index_insert(tbl, row, cmask, ignore)) < 0)
+        return -1;
+
+    if (rowh && (*rowh = mdb_row_get_handle(tbl, row)) == MQI_HANDLE_INVALID)
+        return -1;
+
+    if (nrow == 0)
+        return 0;               /* a replaced duplicate */
+
+    tbl->nrow++;
+
+    if (mdb_log_change(tbl, txdepth, mdb_log_insert, cmask, NULL, row) < 0)
+        return -1;
+
+    return 1;
+}
+
 int mdb_table_insert(mdb_table_t        *tbl,
                      int                 ignore,
                      mqi_column_desc_t  *cds,
                      void              **data)
 {
     uint32_t   txdepth = mdb_transaction_get_depth();
-    mdb_row_t    *row;
-    int           error;
-    int           nrow;
-    int           ninsert;
-    mqi_bitfld_t  cmask;
-    int           i;
+    int        error;
+    int        ninsert;
+    int        n;
+    int        i;
 
     MDB_CHECKARG(tbl && cds && data && data[0], -1);
 
     for (i = 0, error = 0, ninsert = 0;    data[i];    i++) {
-        if (!(row = mdb_row_create(tbl))) {
-            errno = ENOMEM;
-            return -1;
-        }
-
-        mdb_row_update(tbl, row, cds, data[i], 0, &cmask);
-
-        if ((nrow = mdb_index_insert(tbl, row, cmask, ignore)) < 0) {
+        if ((n = insert_row(tbl, txdepth, ignore, cds, data[i], NULL)) < 0) {
             if ((error = errno) != EEXIST)
                 return -1;
 
             ninsert = -1;
         }
-        else if (nrow > 0) {
-            tbl->nrow++;
-
-            if (mdb_log_change(tbl,txdepth,mdb_log_insert,cmask,NULL,row) < 0)
-                ninsert = -1;
-            else
-                ninsert += (ninsert >= 0) ? 1 : 0;
-        }
-
+        else if (n > 0)
+            ninsert += (ninsert >= 0) ? 1 : 0;
     }
 
     if (error) {
@@ -333,6 +354,50 @@ int mdb_table_insert(mdb_table_t        *tbl,
     return ninsert;
 }
 
+int mdb_table_insert_rows(mdb_table_t       *tbl,
+                          int                ignore,
+                          mqi_column_desc_t *cds,
+                          void              *rows,
+                          int                rowsize,
+                          int                nrow)
+{
+    uint32_t  txdepth = mdb_transaction_get_depth();
+    uint8_t  *data;
+    int       ninsert;
+    int       n;
+    int       i;
+
+    MDB_CHECKARG(tbl && cds && rows && rowsize > 0 && nrow >= 0, -1);
+
+    /*
+     * Unlike mdb_table_insert we stop at the first failing row. The
+     * caller is expected to have a transaction open and roll it back.
+     */
+    for (i = 0, ninsert = 0, data = rows;  i < nrow;  i++, data += rowsize) {
+        if ((n = insert_row(tbl, txdepth, ignore, cds, data, NULL)) < 0)
+            return -1;
+
+        ninsert += n;
+    }
+
+    return ninsert;
+}
+
+int mdb_table_insert_row(mdb_table_t       *tbl,
+                         int                ignore,
+                         mqi_column_desc_t *cds,
+                         void              *data,
+                         mqi_handle_t      *rowh)
+{
+    uint32_t txdepth = mdb_transaction_get_depth();
+
+    MDB_CHECKARG(tbl && cds && data && rowh, -1);
+
+    *rowh = MQI_HANDLE_INVALID;
+
+    return insert_row(tbl, txdepth, ignore, cds, data, rowh);
+}
+
 int mdb_table_select(mdb_table_t       *tbl,
                      mqi_cond_entry_t  *cond,
                      mqi_column_desc_t *cds,
@@ -397,24 +462,12 @@ int mdb_table_update(mdb_table_t       *tbl,
                      mqi_column_desc_t *cds,
                      void              *data)
 {
-    int           index_update = 0;
-    mdb_column_t *col;
-    int           cindex;
-    int           nupdate;
-    int           i;
+    int index_update;
+    int nupdate;
 
     MDB_CHECKARG(tbl, -1);
 
-
-    if (MDB_TABLE_HAS_INDEX(tbl)) {
-        for (i = 0;   (cindex = cds[i].cindex) >= 0;    i++) {
-            col = tbl->columns + cindex;
-            if ((col->flags & MQI_COLUMN_KEY)) {
-                index_update = 1;
-                break;
-            }
-        }
-    }
+    index_update = updates_index(tbl, cds);
 
     if (cond)
         nupdate = update_conditional(tbl, cond, cds, data, index_update);
@@ -438,6 +491,36 @@ int mdb_table_delete(mdb_table_t *tbl, mqi_cond_entry_t *cond)
     return ndelete;
 }
 
+int mdb_table_update_row(mdb_table_t       *tbl,
+                         mqi_handle_t       rowh,
+                         mqi_column_desc_t *cds,
+                         void              *data)
+{
+    mdb_row_t *row;
+
+    MDB_CHECKARG(tbl && rowh != MQI_HANDLE_INVALID && cds && data, -1);
+
+    if (!(row = mdb_row_find(tbl, rowh)))
+        return -1;
+
+    return update_single_row(tbl, row, cds, data, updates_index(tbl, cds));
+}
+
+int mdb_table_delete_row(mdb_table_t *tbl, mqi_handle_t rowh)
+{
+    mdb_row_t *row;
+
+    MDB_CHECKARG(tbl && rowh != MQI_HANDLE_INVALID, -1);
+
+    if (!(row = mdb_row_find(tbl, rowh)))
+        return -1;
+
+    if (delete_single_row(tbl, row, 1) < 0)
+        return -1;
+
+    return 1;
+}
+
 mdb_table_t *mdb_table_find(char *table_name)
 {
     MDB_CHECKARG(table_name, NULL);
@@ -482,6 +565,44 @@ int mdb_table_get_column_size(mdb_table_t *tbl, int colidx)
     return tbl->columns[colidx].length;
 }
 
+int mdb_table_get_column_offset(mdb_table_t *tbl, int colidx)
+{
+    MDB_CHECKARG(tbl && colidx >= 0 && colidx < tbl->ncolumn, -1);
+
+    return tbl->columns[colidx].offset;
+}
+
+int mdb_table_get_row_length(mdb_table_t *tbl)
+{
+    MDB_CHECKARG(tbl, -1);
+
+    return tbl->dlgh;
+}
+
+int mdb_table_dump_rows(mdb_table_t *tbl, void *buf, int dim)
+{
+    mdb_row_t        *row;
+    uint8_t          *p;
+    int               n;
+    table_iterator_t  it;
+
+    MDB_CHECKARG(tbl && buf && dim >= 0, -1);
+
+    p = buf;
+    n = 0;
+
+    for (it.cursor = NULL;  n < dim && (row = table_iterator(tbl, &it));  n++){
+        memcpy(p, row->data, tbl->dlgh);
+        p += tbl->dlgh;
+    }
+
+    /* an index cursor is only freed by the iterator once it runs out */
+    if (n == dim && it.cursor && it.indexed)
+        mdb_sequence_cursor_destroy(tbl->index.sequence, &it.cursor);
+
+    return n;
+}
+
 uint32_t mdb_table_get_stamp(mdb_table_t *tbl)
 {
     return tbl->cnt.stamp;
@@ -537,6 +658,11 @@ static void destroy_table(mdb_table_t *tbl)
     MDB_DLIST_FOR_EACH_SAFE(mdb_row_t, link, row,n, &tbl->rows)
         mdb_row_delete(tbl, row, 0, 1);
 
+    mdb_row_purge_cache(tbl);
+
+    if (tbl->row_handles)
+        MDB_HANDLE_MAP_DESTROY(tbl->row_handles);
+
     for (i = 0, cols = tbl->columns;   i < tbl->ncolumn;    i++)
         free(cols[i].name);
 
@@ -749,6 +875,23 @@ static int update_all(mdb_table_t       *tbl,
     return nupdate;
 }
 
+static int updates_index(mdb_table_t *tbl, mqi_column_desc_t *cds)
+{
+    mdb_column_t *col;
+    int           cindex;
+    int           i;
+
+    if (MDB_TABLE_HAS_INDEX(tbl)) {
+        for (i = 0;   (cindex = cds[i].cindex) >= 0;    i++) {
+            col = tbl->columns + cindex;
+            if ((col->flags & MQI_COLUMN_KEY))
+                return 1;
+        }
+    }
+
+    return 0;
+}
+
 static int update_single_row(mdb_table_t       *tbl,
                              mdb_row_t         *row,
                              mqi_column_desc_t *cds,
@@ -32,6 +32,7 @@
 
 #include <murphy-db/mdb.h>
 #include <murphy-db/hash.h>
+#include <murphy-db/handle.h>
 #include <murphy-db/list.h>
 #include "index.h"
 #include "column.h"
@@ -50,6 +51,9 @@ struct mdb_table_s {
     int           dlgh;          /* length of row data */
     int           nrow;
     mdb_dlist_t   rows;
+    mdb_dlist_t   free_rows;    /* deleted rows kept for reuse */
+    int           nfree_row;
+    mdb_handle_map_t *row_handles; /* row handles, created on demand */
     mdb_dlist_t   logs;         /* transaction logs */
     mdb_opcnt_t   cnt;
     mdb_trigger_t trigger;      /* must be the last: it has a array[0] @end  */
@@ -129,8 +129,13 @@ int mdb_transaction_commit(uint32_t depth)
             sts = s;
     }
 
+    mdb_trigger_changeset_commit(depth);
+
     txdepth--;
 
+    if (!txdepth)
+        mdb_trigger_changeset_flush();
+
     CHECK_TRIGGER_END();
 
     return sts;
@@ -164,8 +169,14 @@ int mdb_transaction_rollback(uint32_t depth)
             sts = s;
     }
 
+    mdb_trigger_changeset_rollback(depth);
+
     txdepth--;
 
+    /* changesets of already committed nested transactions */
+    if (!txdepth)
+        mdb_trigger_changeset_flush();
+
     return sts;
 }
 
@@ -45,13 +45,17 @@
 #define LOG_TRIGGER
 #endif
 
+#define CHANGESET_CHUNK   4096
+
 typedef struct callback_s         callback_t;
 typedef struct select_s           select_t;
+typedef struct chunk_s            chunk_t;
 
 typedef struct column_trigger_s   column_trigger_t;
 typedef struct row_trigger_s      row_trigger_t;
 typedef struct table_trigger_s    table_trigger_t;
 typedef struct transact_trigger_s transact_trigger_t;
+typedef struct changeset_trigger_s changeset_trigger_t;
 
 struct callback_s {
     mqi_trigger_cb_t  function;
@@ -86,6 +90,26 @@ struct transact_trigger_s {
     callback_t   callback;
 };
 
+struct chunk_s {
+    chunk_t  *next;
+    size_t    size;
+    size_t    used;
+    uint8_t   data[0];
+};
+
+struct changeset_trigger_s {
+    mdb_dlist_t       link;     /* to the changeset triggers of the table */
+    mdb_dlist_t       pending;  /* to the changesets waiting for delivery */
+    callback_t        callback;
+    mdb_table_t      *table;
+    int               nrow;     /* number of collected rows */
+    int               nalloc;   /* number of allocated rows */
+    mqi_change_row_t *rows;
+    uint32_t         *depth;    /* uncommitted depth of rows, or 0 */
+    chunk_t          *chunks;   /* row images and their strings */
+    select_t          select;
+};
+
 
 static int8_t lowest_bit_in[256] = {
     /*         0   1   2   3   4   5   6   7   8   9   A   B   C   D   E   F */
@@ -111,8 +135,14 @@ static int8_t lowest_bit_in[256] = {
 
 static MDB_DLIST_HEAD(table_change_triggers);
 static MDB_DLIST_HEAD(transact_change_triggers);
+static MDB_DLIST_HEAD(pending_changesets);
 
 static int get_select_params(mdb_table_t *, mqi_column_desc_t *, int *, int *);
+static int get_image_length(mdb_table_t *, mqi_column_desc_t *);
+static void free_changeset_trigger(changeset_trigger_t *);
+static void *changeset_alloc(changeset_trigger_t *, size_t);
+static void *changeset_image(changeset_trigger_t *, mdb_row_t *);
+static void free_chunks(chunk_t *);
 static void row_change(mqi_event_type_t, mdb_table_t *, mdb_row_t *);
 static void table_change(mqi_event_type_t, mdb_table_t *);
 static void transaction_change(mqi_event_type_t, uint32_t);
@@ -126,6 +156,7 @@ void mdb_trigger_init(mdb_trigger_t *trigger, int ncol)
         return;
 
     MDB_DLIST_INIT(trigger->row_change);
+    MDB_DLIST_INIT(trigger->changeset);
 
     for (i = 0;  i < ncol;  i++)
         MDB_DLIST_INIT(trigger->column_change[i]);
@@ -135,6 +166,7 @@ void mdb_trigger_reset(mdb_trigger_t *trigger, int ncol)
 {
     row_trigger_t *rt, *n;
     column_trigger_t *ct, *m;
+    changeset_trigger_t *cs, *o;
     mdb_dlist_t *head;
     int i;
 
@@ -146,6 +178,9 @@ void mdb_trigger_reset(mdb_trigger_t *trigger, int ncol)
         free(rt);
     }
 
+    MDB_DLIST_FOR_EACH_SAFE(changeset_trigger_t,link,cs,o,&trigger->changeset)
+        free_changeset_trigger(cs);
+
     for (i = 0;  i < ncol;  i++) {
         head = trigger-> column_change + i;
 
@@ -322,6 +357,89 @@ int mdb_trigger_delete_row_callback(mdb_table_t      *tbl,
 }
 
 
+int mdb_trigger_add_changeset_callback(mdb_table_t       *tbl,
+                                       mqi_trigger_cb_t   cb_function,
+                                       void              *cb_data,
+                                       mqi_column_desc_t *cds)
+{
+    changeset_trigger_t *tr;
+    size_t cdsiz;
+    int length, ncd;
+    mdb_dlist_t *head;
+
+    MDB_CHECKARG(tbl && cb_function, -1);
+
+    if (!cds)
+        ncd = length = 0;
+    else {
+        if (get_select_params(tbl, cds, &ncd, &length) < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        /* images outlive the rows, so they need room for string pointers */
+        length = get_image_length(tbl, cds);
+    }
+
+    cdsiz = sizeof(mqi_column_desc_t) * ncd;
+    head  = &tbl->trigger.changeset;
+
+    MDB_DLIST_FOR_EACH(changeset_trigger_t, link, tr, head) {
+        if (cb_function == tr->callback.function &&
+            cb_data == tr->callback.user_data)
+        {
+            errno = EEXIST;
+            return -1;
+        }
+    }
+
+    if (!(tr = calloc(1, sizeof(changeset_trigger_t) + cdsiz))) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    MDB_DLIST_APPEND(changeset_trigger_t, link, tr, head);
+    MDB_DLIST_INIT(tr->pending);
+
+    tr->callback.function = cb_function;
+    tr->callback.user_data = cb_data;
+    tr->table = tbl;
+
+    tr->select.length = length;
+    tr->select.cdsiz = cdsiz;
+
+    if (ncd > 0)
+        memcpy(tr->select.column, cds, cdsiz);
+
+    return 0;
+}
+
+
+int mdb_trigger_delete_changeset_callback(mdb_table_t      *tbl,
+                                          mqi_trigger_cb_t  cb_function,
+                                          void             *cb_data)
+{
+    changeset_trigger_t *tr, *n;
+    mdb_dlist_t *head;
+
+    MDB_CHECKARG(tbl && cb_function, -1);
+
+    head = &tbl->trigger.changeset;
+
+    MDB_DLIST_FOR_EACH_SAFE(changeset_trigger_t, link, tr,n, head) {
+        if (cb_function == tr->callback.function &&
+            cb_data == tr->callback.user_data)
+        {
+            free_changeset_trigger(tr);
+            return 0;
+        }
+    }
+
+    errno = ENOENT;
+    return -1;
+}
+
+
 int mdb_trigger_add_table_callback(mqi_trigger_cb_t  cb_function,
                                    void             *cb_data)
 {
@@ -502,6 +620,147 @@ void mdb_trigger_row_delete(mdb_table_t *tbl, mdb_row_t *row)
 }
 
 
+void mdb_trigger_changeset_record(mdb_table_t      *tbl,
+                                  uint32_t          depth,
+                                  mqi_event_type_t  event,
+                                  mdb_row_t        *before,
+                                  mdb_row_t        *after)
+{
+    changeset_trigger_t *tr;
+    mqi_change_row_t    *rows, *cr;
+    uint32_t            *depths;
+    int                  nalloc;
+
+    if (!tbl)
+        return;
+
+    MDB_DLIST_FOR_EACH(changeset_trigger_t,link, tr, &tbl->trigger.changeset){
+        if (tr->nrow >= tr->nalloc) {
+            nalloc = tr->nalloc ? 2 * tr->nalloc : 16;
+
+            if (!(rows = realloc(tr->rows, sizeof(rows[0]) * nalloc)))
+                continue;
+
+            tr->rows = rows;
+
+            if (!(depths = realloc(tr->depth, sizeof(depths[0]) * nalloc)))
+                continue;
+
+            tr->depth  = depths;
+            tr->nalloc = nalloc;
+        }
+
+        tr->depth[tr->nrow] = depth;
+        cr = tr->rows + tr->nrow++;
+
+        cr->event = event;
+        cr->old   = NULL;
+        cr->new_  = NULL;
+
+        /* take the images now, the rows might change again before commit */
+        if (tr->select.length > 0) {
+            if (before)
+                cr->old = changeset_image(tr, before);
+            if (after)
+                cr->new_ = changeset_image(tr, after);
+        }
+
+        if (MDB_DLIST_EMPTY(tr->pending))
+            MDB_DLIST_APPEND(changeset_trigger_t, pending, tr,
+                             &pending_changesets);
+    }
+}
+
+void mdb_trigger_changeset_commit(uint32_t depth)
+{
+    changeset_trigger_t *tr;
+    int                  i;
+
+    /*
+     * Committed nested transactions can't be rolled back any more,
+     * so their rows stay in the changeset even if an outer one is.
+     */
+    MDB_DLIST_FOR_EACH(changeset_trigger_t,pending, tr, &pending_changesets){
+        for (i = 0;  i < tr->nrow;  i++) {
+            if (tr->depth[i] == depth)
+                tr->depth[i] = 0;
+        }
+    }
+}
+
+void mdb_trigger_changeset_rollback(uint32_t depth)
+{
+    changeset_trigger_t *tr, *n;
+    int                  i, j;
+
+    MDB_DLIST_FOR_EACH_SAFE(changeset_trigger_t, pending, tr,n,
+                            &pending_changesets)
+    {
+        for (i = j = 0;  i < tr->nrow;  i++) {
+            if (tr->depth[i] == depth)
+                continue;
+
+            if (i != j) {
+                tr->rows[j]  = tr->rows[i];
+                tr->depth[j] = tr->depth[i];
+            }
+            j++;
+        }
+
+        tr->nrow = j;
+
+        if (!tr->nrow)
+            MDB_DLIST_UNLINK(changeset_trigger_t, pending, tr);
+    }
+}
+
+void mdb_trigger_changeset_flush(void)
+{
+    mqi_event_t            evt;
+    changeset_trigger_t   *tr;
+    mqi_changeset_event_t *ce;
+    chunk_t               *chunks;
+    uint32_t              *depths;
+
+    while (!MDB_DLIST_EMPTY(pending_changesets)) {
+        tr = MDB_LIST_RELOCATE(changeset_trigger_t, pending,
+                               pending_changesets.next);
+
+        MDB_DLIST_UNLINK(changeset_trigger_t, pending, tr);
+
+        memset(&evt, 0, sizeof(evt));
+        ce = &evt.changeset;
+
+        ce->event = mqi_table_changed;
+
+        ce->table.handle = tr->table->handle;
+        ce->table.name   = tr->table->name;
+
+        ce->nrow = tr->nrow;
+        ce->rows = tr->rows;
+
+        /*
+         * Hand the buffers over to the event. The callback is free to
+         * start new transactions, or to drop the trigger or the table.
+         */
+        chunks = tr->chunks;
+        depths = tr->depth;
+
+        tr->nrow   = 0;
+        tr->nalloc = 0;
+        tr->rows   = NULL;
+        tr->depth  = NULL;
+        tr->chunks = NULL;
+
+        tr->callback.function(&evt, tr->callback.user_data);
+
+        free(ce->rows);
+        free(depths);
+        free_chunks(chunks);
+    }
+}
+
+
 void mdb_trigger_table_create(mdb_table_t *tbl)
 {
     if (tbl)
@@ -547,6 +806,111 @@ static int get_select_params(mdb_table_t       *tbl,
     return 0;
 }
 
+static int get_image_length(mdb_table_t *tbl, mqi_column_desc_t *cds)
+{
+    mqi_column_desc_t *cd;
+    mdb_column_t *col;
+    int length, end;
+    int cx;
+
+    for (cd = cds, length = 0;  (cx = cd->cindex) >= 0;  cd++) {
+        col = tbl->columns + cx;
+
+        if (col->type == mqi_varchar)
+            end = cd->offset + sizeof(char *);
+        else
+            end = cd->offset + col->length;
+
+        if (end > length)
+            length = end;
+    }
+
+    return length;
+}
+
+static void free_changeset_trigger(changeset_trigger_t *tr)
+{
+    MDB_DLIST_UNLINK(changeset_trigger_t, link, tr);
+    MDB_DLIST_UNLINK(changeset_trigger_t, pending, tr);
+
+    free(tr->rows);
+    free(tr->depth);
+    free_chunks(tr->chunks);
+    free(tr);
+}
+
+static void *changeset_alloc(changeset_trigger_t *tr, size_t size)
+{
+    chunk_t *ch;
+    size_t   csiz;
+    void    *ptr;
+
+    size = (size + sizeof(double) - 1) & ~(sizeof(double) - 1);
+
+    if (!(ch = tr->chunks) || ch->used + size > ch->size) {
+        csiz = size > CHANGESET_CHUNK ? size : CHANGESET_CHUNK;
+
+        if (!(ch = malloc(sizeof(chunk_t) + csiz)))
+            return NULL;
+
+        ch->next = tr->chunks;
+        ch->size = csiz;
+        ch->used = 0;
+
+        tr->chunks = ch;
+    }
+
+    ptr = ch->data + ch->used;
+    ch->used += size;
+
+    return ptr;
+}
+
+static void *changeset_image(changeset_trigger_t *tr, mdb_row_t *row)
+{
+    mdb_table_t       *tbl = tr->table;
+    mqi_column_desc_t *cd;
+    mdb_column_t      *col;
+    uint8_t           *image;
+    char             **strp;
+    char              *str;
+    size_t             len;
+
+    if (!(image = changeset_alloc(tr, tr->select.length)))
+        return NULL;
+
+    memset(image, 0, tr->select.length);
+
+    for (cd = tr->select.column;  cd->cindex >= 0;  cd++) {
+        col = tbl->columns + cd->cindex;
+
+        mdb_column_read(cd, image, col, row->data);
+
+        if (col->type == mqi_varchar) {
+            strp = (char **)(image + cd->offset);
+            len  = strlen(*strp) + 1;
+
+            if (!(str = changeset_alloc(tr, len)))
+                return NULL;
+
+            memcpy(str, *strp, len);
+            *strp = str;
+        }
+    }
+
+    return image;
+}
+
+static void free_chunks(chunk_t *ch)
+{
+    chunk_t *next;
+
+    for ( ;  ch;  ch = next) {
+        next = ch->next;
+        free(ch);
+    }
+}
+
 
 static void row_change(mqi_event_type_t  event,
                        mdb_table_t      *tbl,
@@ -558,6 +922,9 @@ static void row_change(mqi_event_type_t  event,
     int              sx;
     int              i;
 
+    if (MDB_DLIST_EMPTY(tbl->trigger.row_change))
+        return;
+
     memset(&evt, 0, sizeof(evt));
     re = &evt.row;
 
@@ -37,6 +37,7 @@
 
 typedef struct {
     mdb_dlist_t   row_change;
+    mdb_dlist_t   changeset;
     mdb_dlist_t   column_change[0];
 } mdb_trigger_t;
 
@@ -49,6 +50,12 @@ void mdb_trigger_column_change(mdb_table_t*, mqi_bitfld_t,
 void mdb_trigger_row_delete(mdb_table_t *, mdb_row_t *);
 void mdb_trigger_row_insert(mdb_table_t *, mdb_row_t *);
 
+void mdb_trigger_changeset_record(mdb_table_t *, uint32_t, mqi_event_type_t,
+                                  mdb_row_t *, mdb_row_t *);
+void mdb_trigger_changeset_commit(uint32_t);
+void mdb_trigger_changeset_rollback(uint32_t);
+void mdb_trigger_changeset_flush(void);
+
 void mdb_trigger_table_create(mdb_table_t *);
 void mdb_trigger_table_drop(mdb_table_t *);
 
@@ -41,6 +41,9 @@ typedef struct {
     int (*drop_table_trigger)(mqi_trigger_cb_t, void *);
     int (*drop_row_trigger)(void *, mqi_trigger_cb_t, void *);
     int (*drop_column_trigger)(void *, int, mqi_trigger_cb_t, void *);
+    int (*create_changeset_trigger)(void *, mqi_trigger_cb_t, void *,
+                                    mqi_column_desc_t *);
+    int (*drop_changeset_trigger)(void *, mqi_trigger_cb_t, void *);
     uint32_t (*begin_transaction)(void);
     int (*commit_transaction)(uint32_t);
     int (*rollback_transaction)(uint32_t);
@@ -51,12 +54,17 @@ typedef struct {
     int (*drop_table)(void *);
     int (*describe)(void *, mqi_column_def_t *, int);
     int (*insert_into)(void *, int, mqi_column_desc_t *, void **);
+    int (*insert_rows)(void *, int, mqi_column_desc_t *, void *, int, int);
+    int (*insert_row)(void *, int, mqi_column_desc_t *, void *,
+                      mqi_handle_t *);
     int (*select)(void *, mqi_cond_entry_t *, mqi_column_desc_t *,
                   void *, int, int);
     int (*select_by_index)(void *, mqi_variable_t *,
                            mqi_column_desc_t *, void *);
     int (*update)(void *, mqi_cond_entry_t *, mqi_column_desc_t *,void*);
     int (*delete_from)(void *, mqi_cond_entry_t *);
+    int (*update_row)(void *, mqi_handle_t, mqi_column_desc_t *, void *);
+    int (*delete_row)(void *, mqi_handle_t);
     void *(*find_table)(char *);
     int (*get_column_index)(void *, char *);
     int (*get_table_size)(void *);
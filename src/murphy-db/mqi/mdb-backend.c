@@ -52,6 +52,9 @@ static int      drop_transaction_trigger(mqi_trigger_cb_t, void *);
 static int      drop_table_trigger(mqi_trigger_cb_t, void *);
 static int      drop_row_trigger(void *, mqi_trigger_cb_t, void *);
 static int      drop_column_trigger(void*, int, mqi_trigger_cb_t, void *);
+static int      create_changeset_trigger(void *, mqi_trigger_cb_t, void *,
+                                         mqi_column_desc_t *);
+static int      drop_changeset_trigger(void *, mqi_trigger_cb_t, void *);
 static uint32_t begin_transaction(void);
 static int      commit_transaction(uint32_t);
 static int      rollback_transaction(uint32_t);
@@ -62,12 +65,17 @@ static int      create_index(void *, char **);
 static int      drop_table(void *);
 static int      describe(void *, mqi_column_def_t *, int);
 static int      insert_into(void *, int, mqi_column_desc_t *, void **);
+static int      insert_rows(void *, int, mqi_column_desc_t *, void *, int, int);
+static int      insert_row(void *, int, mqi_column_desc_t *, void *,
+                           mqi_handle_t *);
 static int      select_general(void *, mqi_cond_entry_t *, mqi_column_desc_t *,
                                void *, int, int);
 static int      select_by_index(void *, mqi_variable_t *, mqi_column_desc_t *,
                                  void *);
 static int      update(void *, mqi_cond_entry_t *, mqi_column_desc_t*,void*);
 static int      delete_from(void *, mqi_cond_entry_t *);
+static int      update_row(void *, mqi_handle_t, mqi_column_desc_t *, void *);
+static int      delete_row(void *, mqi_handle_t);
 static void *   find_table(char *);
 static int      get_column_index(void *, char *);
 static int      get_table_size(void *);
@@ -86,6 +94,8 @@ static mqi_db_functbl_t functbl = {
     drop_table_trigger,
     drop_row_trigger,
     drop_column_trigger,
+    create_changeset_trigger,
+    drop_changeset_trigger,
     begin_transaction,
     commit_transaction,
     rollback_transaction,
@@ -96,10 +106,14 @@ static mqi_db_functbl_t functbl = {
     drop_table,
     describe,
     insert_into,
+    insert_rows,
+    insert_row,
     select_general,
     select_by_index,
     update,
     delete_from,
+    update_row,
+    delete_row,
     find_table,
     get_column_index,
     get_table_size,
@@ -168,6 +182,19 @@ static int drop_column_trigger(void *t,
     return mdb_trigger_delete_column_callback((mdb_table_t *)t,colidx,cb,data);
 }
 
+static int create_changeset_trigger(void *t,
+                                    mqi_trigger_cb_t cb,
+                                    void *data,
+                                    mqi_column_desc_t *cds)
+{
+    return mdb_trigger_add_changeset_callback((mdb_table_t *)t, cb, data, cds);
+}
+
+static int drop_changeset_trigger(void *t, mqi_trigger_cb_t cb, void *data)
+{
+    return mdb_trigger_delete_changeset_callback((mdb_table_t *)t, cb, data);
+}
+
 static uint32_t begin_transaction(void)
 {
     uint32_t depth = mdb_transaction_begin();
@@ -230,6 +257,26 @@ static int insert_into(void               *t,
     return mdb_table_insert((mdb_table_t *)t, ignore, cds, data);
 }
 
+static int insert_rows(void              *t,
+                       int                ignore,
+                       mqi_column_desc_t *cds,
+                       void              *rows,
+                       int                rowsize,
+                       int                nrow)
+{
+    return mdb_table_insert_rows((mdb_table_t *)t, ignore, cds,
+                                 rows, rowsize, nrow);
+}
+
+static int insert_row(void              *t,
+                      int                ignore,
+                      mqi_column_desc_t *cds,
+                      void              *data,
+                      mqi_handle_t      *rowh)
+{
+    return mdb_table_insert_row((mdb_table_t *)t, ignore, cds, data, rowh);
+}
+
 static int select_general(void              *t,
                           mqi_cond_entry_t  *cond,
                           mqi_column_desc_t *cds,
@@ -262,6 +309,19 @@ static int delete_from(void *t, mqi_cond_entry_t *cond)
     return mdb_table_delete((mdb_table_t *)t, cond);
 }
 
+static int update_row(void              *t,
+                      mqi_handle_t       rowh,
+                      mqi_column_desc_t *cds,
+                      void              *data)
+{
+    return mdb_table_update_row((mdb_table_t *)t, rowh, cds, data);
+}
+
+static int delete_row(void *t, mqi_handle_t rowh)
+{
+    return mdb_table_delete_row((mdb_table_t *)t, rowh);
+}
+
 
 static void *find_table(char *table_name)
 {
@@ -40,7 +40,9 @@
 #include <murphy-db/mqi.h>
 #include <murphy-db/handle.h>
 #include <murphy-db/hash.h>
+#include <murphy-db/mqi-shm.h>
 #include "mdb-backend.h"
+#include "shm-backend.h"
 
 #define MAX_DB 2
 
@@ -89,8 +91,11 @@ typedef struct {
 } mqi_db_t;
 
 typedef struct {
-    mqi_db_t    *db;
-    void        *handle;
+    mqi_db_t             *db;
+    void                 *handle;
+    int                   nsubscr;      /* number of table subscribers */
+    mqi_materialize_cb_t  materialize;  /* for lazily mirrored tables */
+    void                 *user_data;
 } mqi_table_t;
 
 typedef struct {
@@ -100,6 +105,8 @@ typedef struct {
 
 
 static int db_register(const char *, uint32_t, mqi_db_functbl_t *);
+static void subscribe(mqi_handle_t);
+static void unsubscribe(mqi_handle_t);
 
 
 static int        ndb;
@@ -128,6 +135,13 @@ int mqi_open(void)
             errno = EIO;
             return -1;
         }
+
+        /* must come after MurphyDB, which runs the actual transactions */
+        if (db_register("SharedDB", MQI_TEMPORARY | MQI_SHARED,
+                        shm_backend_init()) < 0) {
+            errno = EIO;
+            return -1;
+        }
     }
 
     return 0;
@@ -275,7 +289,12 @@ int mqi_create_row_trigger(mqi_handle_t h,
 
     GET_TABLE(tbl, ftb, h, -1);
 
-    return ftb->create_row_trigger(tbl, callback, user_data, cds);
+    if (ftb->create_row_trigger(tbl, callback, user_data, cds) < 0)
+        return -1;
+
+    subscribe(h);
+
+    return 0;
 }
 
 
@@ -293,7 +312,12 @@ int mqi_create_column_trigger(mqi_handle_t h,
 
     GET_TABLE(tbl, ftb, h, -1);
 
-    return ftb->create_column_trigger(tbl, colidx, callback, user_data, cds);
+    if (ftb->create_column_trigger(tbl, colidx, callback, user_data, cds) < 0)
+        return -1;
+
+    subscribe(h);
+
+    return 0;
 }
 
 
@@ -353,7 +377,12 @@ int mqi_drop_row_trigger(mqi_handle_t h,
 
     GET_TABLE(tbl, ftb, h, -1);
 
-    return ftb->drop_row_trigger(tbl, callback, user_data);
+    if (ftb->drop_row_trigger(tbl, callback, user_data) < 0)
+        return -1;
+
+    unsubscribe(h);
+
+    return 0;
 }
 
 
@@ -370,7 +399,55 @@ int mqi_drop_column_trigger(mqi_handle_t h,
 
     GET_TABLE(tbl, ftb, h, -1);
 
-    return ftb->drop_column_trigger(tbl, colidx, callback, user_data);
+    if (ftb->drop_column_trigger(tbl, colidx, callback, user_data) < 0)
+        return -1;
+
+    unsubscribe(h);
+
+    return 0;
+}
+
+
+int mqi_create_changeset_trigger(mqi_handle_t h,
+                                 mqi_trigger_cb_t callback,
+                                 void *user_data,
+                                 mqi_column_desc_t *cds)
+{
+    mqi_db_functbl_t *ftb;
+    void             *tbl;
+
+    MDB_CHECKARG(h != MDB_HANDLE_INVALID && callback, -1);
+    MDB_PREREQUISITE(dbs && ndb > 0, -1);
+
+    GET_TABLE(tbl, ftb, h, -1);
+
+    if (ftb->create_changeset_trigger(tbl, callback, user_data, cds) < 0)
+        return -1;
+
+    subscribe(h);
+
+    return 0;
+}
+
+
+int mqi_drop_changeset_trigger(mqi_handle_t h,
+                               mqi_trigger_cb_t callback,
+                               void *user_data)
+{
+    mqi_db_functbl_t *ftb;
+    void             *tbl;
+
+    MDB_CHECKARG(h != MDB_HANDLE_INVALID && callback, -1);
+    MDB_PREREQUISITE(dbs && ndb > 0, -1);
+
+    GET_TABLE(tbl, ftb, h, -1);
+
+    if (ftb->drop_changeset_trigger(tbl, callback, user_data) < 0)
+        return -1;
+
+    unsubscribe(h);
+
+    return 0;
 }
 
 
@@ -501,6 +578,9 @@ mqi_handle_t mqi_create_table(char *name,
     for (i = 0, ftb = NULL;  i < ndb;  i++) {
         db = dbs + i;
 
+        if ((DB_TYPE(db) & MQI_SHARED) != (flags & MQI_SHARED))
+            continue;
+
         if ((DB_TYPE(db) & flags) != 0) {
             ftb = db->functbl;
             break;
@@ -620,6 +700,87 @@ int mqi_insert_into(mqi_handle_t         h,
     return ftb->insert_into(tbl, ignore, cds, data);
 }
 
+int mqi_insert_row(mqi_handle_t       h,
+                   int                ignore,
+                   mqi_column_desc_t *cds,
+                   void              *data,
+                   mqi_handle_t      *row)
+{
+    mqi_db_functbl_t *ftb;
+    void             *tbl;
+
+    MDB_CHECKARG(h != MDB_HANDLE_INVALID && cds && data && row, -1);
+    MDB_PREREQUISITE(dbs && ndb > 0, -1);
+
+    GET_TABLE(tbl, ftb, h, -1);
+
+    return ftb->insert_row(tbl, ignore, cds, data, row);
+}
+
+static int insert_rows(mqi_handle_t       h,
+                       int                ignore,
+                       mqi_column_desc_t *cds,
+                       void              *rows,
+                       int                rowsize,
+                       int                nrow)
+{
+    mqi_db_functbl_t *ftb;
+    void             *tbl;
+    mqi_handle_t      tx;
+    int               n;
+    int               err;
+
+    MDB_CHECKARG(h != MDB_HANDLE_INVALID && cds && rows &&
+                 rowsize > 0 && nrow >= 0, -1);
+    MDB_PREREQUISITE(dbs && ndb > 0, -1);
+
+    GET_TABLE(tbl, ftb, h, -1);
+
+    if (nrow == 0)
+        return 0;
+
+    /*
+     * Run the batch in a transaction of its own unless the caller has
+     * one open. This makes the batch atomic and gets all the row triggers
+     * dispatched in one go, when the transaction is committed.
+     */
+    if (txdepth > 0)
+        return ftb->insert_rows(tbl, ignore, cds, rows, rowsize, nrow);
+
+    if ((tx = mqi_begin_transaction()) == MQI_HANDLE_INVALID)
+        return -1;
+
+    if ((n = ftb->insert_rows(tbl, ignore, cds, rows, rowsize, nrow)) < 0) {
+        err = errno;
+        mqi_rollback_transaction(tx);
+        errno = err;
+        return -1;
+    }
+
+    if (mqi_commit_transaction(tx) < 0)
+        return -1;
+
+    return n;
+}
+
+int mqi_insert_rows(mqi_handle_t       h,
+                    mqi_column_desc_t *cds,
+                    void              *rows,
+                    int                rowsize,
+                    int                nrow)
+{
+    return insert_rows(h, 0, cds, rows, rowsize, nrow);
+}
+
+int mqi_upsert_rows(mqi_handle_t       h,
+                    mqi_column_desc_t *cds,
+                    void              *rows,
+                    int                rowsize,
+                    int                nrow)
+{
+    return insert_rows(h, 1, cds, rows, rowsize, nrow);
+}
+
 int mqi_select(mqi_handle_t       h,
                mqi_cond_entry_t  *cond,
                mqi_column_desc_t *cds,
@@ -684,6 +845,36 @@ int mqi_delete_from(mqi_handle_t h, mqi_cond_entry_t *cond)
     return ftb->delete_from(tbl, cond);
 }
 
+int mqi_update_row(mqi_handle_t       h,
+                   mqi_handle_t       row,
+                   mqi_column_desc_t *cds,
+                   void              *data)
+{
+    mqi_db_functbl_t *ftb;
+    void             *tbl;
+
+    MDB_CHECKARG(h != MDB_HANDLE_INVALID && row != MQI_HANDLE_INVALID &&
+                 cds && data, -1);
+    MDB_PREREQUISITE(dbs && ndb > 0, -1);
+
+    GET_TABLE(tbl, ftb, h, -1);
+
+    return ftb->update_row(tbl, row, cds, data);
+}
+
+int mqi_delete_row(mqi_handle_t h, mqi_handle_t row)
+{
+    mqi_db_functbl_t *ftb;
+    void             *tbl;
+
+    MDB_CHECKARG(h != MDB_HANDLE_INVALID && row != MQI_HANDLE_INVALID, -1);
+    MDB_PREREQUISITE(dbs && ndb > 0, -1);
+
+    GET_TABLE(tbl, ftb, h, -1);
+
+    return ftb->delete_row(tbl, row);
+}
+
 mqi_handle_t mqi_get_table_handle(char *table_name)
 {
     void *data;
@@ -700,6 +891,78 @@ mqi_handle_t mqi_get_table_handle(char *table_name)
 }
 
 
+int mqi_set_table_materializer(mqi_handle_t         h,
+                               mqi_materialize_cb_t callback,
+                               void                *user_data)
+{
+    mqi_table_t *tbl;
+
+    MDB_CHECKARG(h != MDB_HANDLE_INVALID, -1);
+    MDB_PREREQUISITE(dbs && ndb > 0, -1);
+
+    if (!(tbl = mdb_handle_get_data(table_handle, h))) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    tbl->materialize = callback;
+    tbl->user_data   = user_data;
+
+    if (callback && tbl->nsubscr > 0)
+        callback(h, 1, user_data);
+
+    return 0;
+}
+
+int mqi_subscribe_table(mqi_handle_t h)
+{
+    MDB_CHECKARG(h != MDB_HANDLE_INVALID, -1);
+    MDB_PREREQUISITE(dbs && ndb > 0, -1);
+
+    if (!mdb_handle_get_data(table_handle, h)) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    subscribe(h);
+
+    return 0;
+}
+
+int mqi_unsubscribe_table(mqi_handle_t h)
+{
+    mqi_table_t *tbl;
+
+    MDB_CHECKARG(h != MDB_HANDLE_INVALID, -1);
+    MDB_PREREQUISITE(dbs && ndb > 0, -1);
+
+    if (!(tbl = mdb_handle_get_data(table_handle, h))) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    MDB_PREREQUISITE(tbl->nsubscr > 0, -1);
+
+    unsubscribe(h);
+
+    return 0;
+}
+
+int mqi_table_is_subscribed(mqi_handle_t h)
+{
+    mqi_table_t *tbl;
+
+    MDB_CHECKARG(h != MDB_HANDLE_INVALID, -1);
+    MDB_PREREQUISITE(dbs && ndb > 0, -1);
+
+    if (!(tbl = mdb_handle_get_data(table_handle, h))) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    return tbl->nsubscr > 0;
+}
+
 int mqi_get_column_index(mqi_handle_t h, char *column_name)
 {
     mqi_db_functbl_t *ftb;
@@ -778,6 +1041,23 @@ int mqi_get_column_size(mqi_handle_t h, int colidx)
     return  ftb->get_column_size(tbl, colidx);
 }
 
+int mqi_shm_export(mqi_handle_t h, int *shmfd, int *evfd)
+{
+    mqi_table_t *t;
+
+    MDB_CHECKARG(h != MDB_HANDLE_INVALID && shmfd && evfd, -1);
+    MDB_PREREQUISITE(dbs && ndb > 0, -1);
+
+    if (!(t = mdb_handle_get_data(table_handle, h)) || !t->db) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    MDB_ASSERT(DB_TYPE(t->db) & MQI_SHARED, EOPNOTSUPP, -1);
+
+    return shm_backend_export(t->handle, shmfd, evfd);
+}
+
 int mqi_print_rows(mqi_handle_t h, char *buf, int len)
 {
     mqi_db_functbl_t *ftb;
@@ -793,6 +1073,22 @@ int mqi_print_rows(mqi_handle_t h, char *buf, int len)
 
 
 
+static void subscribe(mqi_handle_t h)
+{
+    mqi_table_t *tbl = mdb_handle_get_data(table_handle, h);
+
+    if (tbl && tbl->nsubscr++ == 0 && tbl->materialize)
+        tbl->materialize(h, 1, tbl->user_data);
+}
+
+static void unsubscribe(mqi_handle_t h)
+{
+    mqi_table_t *tbl = mdb_handle_get_data(table_handle, h);
+
+    if (tbl && tbl->nsubscr > 0 && --tbl->nsubscr == 0 && tbl->materialize)
+        tbl->materialize(h, 0, tbl->user_data);
+}
+
 static int db_register(const char       *engine,
                        uint32_t          flags,
                        mqi_db_functbl_t *functbl)
@@ -803,7 +1099,7 @@ static int db_register(const char       *engine,
     MDB_CHECKARG(engine && engine[0] && functbl, -1);
     MDB_PREREQUISITE(dbs, -1);
 
-    if (ndb + 1 >= MAX_DB) {
+    if (ndb >= MAX_DB) {
         errno = EOVERFLOW;
         return -1;
     }
@@ -0,0 +1,757 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+
+#include <murphy-db/macros.h>
+#include <murphy-db/list.h>
+#include <murphy-db/handle.h>
+#include <murphy-db/mdb.h>
+
+#include "shm-backend.h"
+#include "shm-layout.h"
+
+/*
+ * A table published in shared memory.
+ *
+ * The rows themselves are kept in an ordinary in-process mdb table, so
+ * apart from creation, modification and transaction boundaries every
+ * call is simply passed on to mdb. Modifications just mark the table
+ * dirty. Dirty tables get republished once the outermost transaction
+ * is over, or right away if there is no transaction in progress.
+ *
+ * Transaction and table triggers are not passed on: the mdb backend
+ * already registers them with mdb, which runs them for all mdb tables,
+ * including the ones created here.
+ */
+
+typedef struct {
+    mdb_dlist_t       link;              /* to list of shared tables */
+    mdb_table_t      *table;             /* backing mdb table */
+    int               fd;                /* memfd of the region */
+    int               evfd;              /* eventfd for change notifications */
+    mqi_shm_header_t *hdr;               /* region mapping */
+    size_t            size;              /* size of the mapping */
+    int               dirty;             /* needs to be republished */
+} shm_table_t;
+
+
+static int      create_transaction_trigger(mqi_trigger_cb_t, void *);
+static int      create_table_trigger(mqi_trigger_cb_t, void *);
+static int      create_row_trigger(void *, mqi_trigger_cb_t, void *,
+                                   mqi_column_desc_t *);
+static int      create_column_trigger(void *, int, mqi_trigger_cb_t, void *,
+                                      mqi_column_desc_t *);
+static int      drop_transaction_trigger(mqi_trigger_cb_t, void *);
+static int      drop_table_trigger(mqi_trigger_cb_t, void *);
+static int      drop_row_trigger(void *, mqi_trigger_cb_t, void *);
+static int      drop_column_trigger(void*, int, mqi_trigger_cb_t, void *);
+static int      create_changeset_trigger(void *, mqi_trigger_cb_t, void *,
+                                         mqi_column_desc_t *);
+static int      drop_changeset_trigger(void *, mqi_trigger_cb_t, void *);
+static uint32_t begin_transaction(void);
+static int      commit_transaction(uint32_t);
+static int      rollback_transaction(uint32_t);
+static uint32_t get_transaction_id(void);
+static void *   create_table(char *, char **, mqi_column_def_t *);
+static int      register_table_handle(void *, mqi_handle_t);
+static int      create_index(void *, char **);
+static int      drop_table(void *);
+static int      describe(void *, mqi_column_def_t *, int);
+static int      insert_into(void *, int, mqi_column_desc_t *, void **);
+static int      insert_rows(void *, int, mqi_column_desc_t *, void *, int, int);
+static int      insert_row(void *, int, mqi_column_desc_t *, void *,
+                           mqi_handle_t *);
+static int      select_general(void *, mqi_cond_entry_t *, mqi_column_desc_t *,
+                               void *, int, int);
+static int      select_by_index(void *, mqi_variable_t *, mqi_column_desc_t *,
+                                 void *);
+static int      update(void *, mqi_cond_entry_t *, mqi_column_desc_t*,void*);
+static int      delete_from(void *, mqi_cond_entry_t *);
+static int      update_row(void *, mqi_handle_t, mqi_column_desc_t *, void *);
+static int      delete_row(void *, mqi_handle_t);
+static void *   find_table(char *);
+static int      get_column_index(void *, char *);
+static int      get_table_size(void *);
+static uint32_t get_table_stamp(void *);
+static char *   get_column_name(void *, int);
+static mqi_data_type_t get_column_type(void *, int);
+static int      get_column_size(void *, int);
+static int      print_rows(void *, char *, int);
+
+static int      publish(shm_table_t *);
+static void     publish_dirty(void);
+static void     mark_dirty(shm_table_t *, int);
+
+static mqi_db_functbl_t functbl = {
+    create_transaction_trigger,
+    create_table_trigger,
+    create_row_trigger,
+    create_column_trigger,
+    drop_transaction_trigger,
+    drop_table_trigger,
+    drop_row_trigger,
+    drop_column_trigger,
+    create_changeset_trigger,
+    drop_changeset_trigger,
+    begin_transaction,
+    commit_transaction,
+    rollback_transaction,
+    get_transaction_id,
+    create_table,
+    register_table_handle,
+    create_index,
+    drop_table,
+    describe,
+    insert_into,
+    insert_rows,
+    insert_row,
+    select_general,
+    select_by_index,
+    update,
+    delete_from,
+    update_row,
+    delete_row,
+    find_table,
+    get_column_index,
+    get_table_size,
+    get_table_stamp,
+    get_column_name,
+    get_column_type,
+    get_column_size,
+    print_rows
+};
+
+static MDB_DLIST_HEAD(tables);
+static uint32_t txdepth;
+
+
+mqi_db_functbl_t *shm_backend_init(void)
+{
+    return &functbl;
+}
+
+
+int shm_backend_export(void *t, int *shmfd, int *evfd)
+{
+    shm_table_t *st = (shm_table_t *)t;
+    char         path[64];
+    int          fd, efd;
+
+    MDB_CHECKARG(st && shmfd && evfd, -1);
+
+    /*
+     * Reopen the memfd through /proc to get a descriptor which does not
+     * allow writing, and consequently can't be mapped writable either.
+     */
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", st->fd);
+
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+        return -1;
+
+    if ((efd = fcntl(st->evfd, F_DUPFD_CLOEXEC, 0)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    *shmfd = fd;
+    *evfd  = efd;
+
+    return 0;
+}
+
+
+static int create_transaction_trigger(mqi_trigger_cb_t cb, void *data)
+{
+    MQI_UNUSED(cb);
+    MQI_UNUSED(data);
+
+    return 0;
+}
+
+static int create_table_trigger(mqi_trigger_cb_t cb, void *data)
+{
+    MQI_UNUSED(cb);
+    MQI_UNUSED(data);
+
+    return 0;
+}
+
+static int create_row_trigger(void *t,
+                              mqi_trigger_cb_t cb,
+                              void *data,
+                              mqi_column_desc_t *cds)
+{
+    shm_table_t *st = (shm_table_t *)t;
+
+    return mdb_trigger_add_row_callback(st->table, cb, data, cds);
+}
+
+static int create_column_trigger(void *t,
+                                 int colidx,
+                                 mqi_trigger_cb_t cb,
+                                 void *data,
+                                 mqi_column_desc_t *cds)
+{
+    shm_table_t *st = (shm_table_t *)t;
+
+    return mdb_trigger_add_column_callback(st->table, colidx, cb, data, cds);
+}
+
+static int drop_transaction_trigger(mqi_trigger_cb_t cb, void *data)
+{
+    MQI_UNUSED(cb);
+    MQI_UNUSED(data);
+
+    return 0;
+}
+
+static int drop_table_trigger(mqi_trigger_cb_t cb, void *data)
+{
+    MQI_UNUSED(cb);
+    MQI_UNUSED(data);
+
+    return 0;
+}
+
+static int drop_row_trigger(void *t, mqi_trigger_cb_t cb, void *data)
+{
+    shm_table_t *st = (shm_table_t *)t;
+
+    return mdb_trigger_delete_row_callback(st->table, cb, data);
+}
+
+static int drop_column_trigger(void *t,
+                               int colidx,
+                               mqi_trigger_cb_t cb,
+                               void *data)
+{
+    shm_table_t *st = (shm_table_t *)t;
+
+    return mdb_trigger_delete_column_callback(st->table, colidx, cb, data);
+}
+
+static int create_changeset_trigger(void *t,
+                                    mqi_trigger_cb_t cb,
+                                    void *data,
+                                    mqi_column_desc_t *cds)
+{
+    shm_table_t *st = (shm_table_t *)t;
+
+    return mdb_trigger_add_changeset_callback(st->table, cb, data, cds);
+}
+
+static int drop_changeset_trigger(void *t, mqi_trigger_cb_t cb, void *data)
+{
+    shm_table_t *st = (shm_table_t *)t;
+
+    return mdb_trigger_delete_changeset_callback(st->table, cb, data);
+}
+
+/*
+ * The actual transactions are run by the mdb backend, which MQI calls
+ * before us. We only need to track the depth to know when to publish.
+ */
+
+static uint32_t begin_transaction(void)
+{
+    return ++txdepth;
+}
+
+static int commit_transaction(uint32_t depth)
+{
+    MDB_CHECKARG(depth > 0 && depth == txdepth, -1);
+
+    if (--txdepth == 0)
+        publish_dirty();
+
+    return 0;
+}
+
+static int rollback_transaction(uint32_t depth)
+{
+    MDB_CHECKARG(depth > 0 && depth == txdepth, -1);
+
+    if (--txdepth == 0)
+        publish_dirty();
+
+    return 0;
+}
+
+static uint32_t get_transaction_id(void)
+{
+    return txdepth;
+}
+
+static void *create_table(char *name,
+                          char **index_columns,
+                          mqi_column_def_t *cdefs)
+{
+    shm_table_t      *st;
+    mqi_shm_header_t *hdr;
+    mqi_shm_column_t *col;
+    mqi_column_def_t  defs[MQI_COLUMN_MAX];
+    size_t            size = (sizeof(*hdr) + 4095) & ~(size_t)4095;
+    int               ncolumn, i, err;
+
+    if (!(st = calloc(1, sizeof(*st))))
+        return NULL;
+
+    MDB_DLIST_INIT(st->link);
+    st->fd   = -1;
+    st->evfd = -1;
+    st->hdr  = MAP_FAILED;
+
+    if (!(st->table = mdb_table_create(name, index_columns, cdefs)))
+        goto fail;
+
+    if ((ncolumn = mdb_table_describe(st->table, defs, MQI_COLUMN_MAX)) < 0)
+        goto fail;
+
+    st->fd = memfd_create(name, MFD_CLOEXEC);
+
+    if (st->fd < 0 || ftruncate(st->fd, size) < 0)
+        goto fail;
+
+    st->hdr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, st->fd, 0);
+
+    if (st->hdr == MAP_FAILED)
+        goto fail;
+
+    if ((st->evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+        goto fail;
+
+    st->size = size;
+    hdr      = st->hdr;
+
+    hdr->magic   = MQI_SHM_MAGIC;
+    hdr->version = MQI_SHM_VERSION;
+    hdr->ncolumn = ncolumn;
+    hdr->rowlen  = mdb_table_get_row_length(st->table);
+    hdr->size    = size;
+    strncpy(hdr->name, name, sizeof(hdr->name) - 1);
+
+    for (i = 0;  i < ncolumn;  i++) {
+        col = hdr->columns + i;
+
+        strncpy(col->name, defs[i].name, sizeof(col->name) - 1);
+        col->type   = defs[i].type;
+        col->length = mdb_table_get_column_size(st->table, i);
+        col->offset = mdb_table_get_column_offset(st->table, i);
+        col->flags  = defs[i].flags;
+    }
+
+    /* publish the empty table, so clients always find a valid snapshot */
+    if (publish(st) < 0)
+        goto fail;
+
+    MDB_DLIST_APPEND(shm_table_t, link, st, &tables);
+
+    return st;
+
+ fail:
+    err = errno;
+
+    if (st->table)
+        mdb_table_drop(st->table);
+    if (st->hdr != MAP_FAILED)
+        munmap(st->hdr, size);
+    if (st->fd >= 0)
+        close(st->fd);
+    if (st->evfd >= 0)
+        close(st->evfd);
+    free(st);
+
+    errno = err;
+    return NULL;
+}
+
+static int register_table_handle(void *t, mqi_handle_t handle)
+{
+    shm_table_t *st = (shm_table_t *)t;
+
+    return mdb_table_register_handle(st->table, handle);
+}
+
+static int create_index(void *t, char **index_columns)
+{
+    shm_table_t *st = (shm_table_t *)t;
+    int          sts;
+
+    /* creating an index changes the order we publish rows in */
+    if ((sts = mdb_table_create_index(st->table, index_columns)) == 0)
+        mark_dirty(st, 1);
+
+    return sts;
+}
+
+static int drop_table(void *t)
+{
+    shm_table_t *st = (shm_table_t *)t;
+    uint64_t     one = 1;
+    int          sts;
+
+    MDB_DLIST_UNLINK(shm_table_t, link, st);
+
+    sts = mdb_table_drop(st->table);
+
+    /* let clients know the table is gone, they can keep their mapping */
+    __atomic_store_n(&st->hdr->dropped, 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&st->hdr->generation, 1, __ATOMIC_RELEASE);
+
+    if (write(st->evfd, &one, sizeof(one)) < 0) {
+        /* nothing to do */
+    }
+
+    munmap(st->hdr, st->size);
+    close(st->fd);
+    close(st->evfd);
+    free(st);
+
+    return sts;
+}
+
+static int describe(void *t, mqi_column_def_t *defs, int len)
+{
+    shm_table_t *st = (shm_table_t *)t;
+
+    return mdb_table_describe(st->table, defs, len);
+}
+
+static int insert_into(void               *t,
+                        int                 ignore,
+                        mqi_column_desc_t  *cds,
+                        void              **data)
+{
+    shm_table_t *st = (shm_table_t *)t;
+    int          n;
+
+    n = mdb_table_insert(st->table, ignore, cds, data);
+    mark_dirty(st, n < 0 ? n : 1);     /* replaced duplicates count as 0 */
+
+    return n;
+}
+
+static int insert_rows(void              *t,
+                       int                ignore,
+                       mqi_column_desc_t *cds,
+                       void              *rows,
+                       int                rowsize,
+                       int                nrow)
+{
+    shm_table_t *st = (shm_table_t *)t;
+    int          n;
+
+    n = mdb_table_insert_rows(st->table, ignore, cds, rows, rowsize, nrow);
+    mark_dirty(st, n < 0 ? n : 1);
+
+    return n;
+}
+
+static int insert_row(void              *t,
+                      int                ignore,
+                      mqi_column_desc_t *cds,
+                      void              *data,
+                      mqi_handle_t      *rowh)
+{
+    shm_table_t *st = (shm_table_t *)t;
+    int          n;
+
+    n = mdb_table_insert_row(st->table, ignore, cds, data, rowh);
+    mark_dirty(st, n < 0 ? n : 1);
+
+    return n;
+}
+
+static int select_general(void              *t,
+                          mqi_cond_entry_t  *cond,
+                          mqi_column_desc_t *cds,
+                          void              *results,
+                          int                size,
+                          int                dim)
+{
+    shm_table_t *st = (shm_table_t *)t;
+
+    return mdb_table_select(st->table, cond, cds, results, size, dim);
+}
+
+static int select_by_index(void              *t,
+                            mqi_variable_t    *idxvars,
+                            mqi_column_desc_t *cds,
+                            void              *result)
+{
+    shm_table_t *st = (shm_table_t *)t;
+
+    return mdb_table_select_by_index(st->table, idxvars, cds, result);
+}
+
+static int update(void              *t,
+                  mqi_cond_entry_t  *cond,
+                  mqi_column_desc_t *cds,
+                  void              *data)
+{
+    shm_table_t *st = (shm_table_t *)t;
+    int          n;
+
+    n = mdb_table_update(st->table, cond, cds, data);
+    mark_dirty(st, n);
+
+    return n;
+}
+
+static int delete_from(void *t, mqi_cond_entry_t *cond)
+{
+    shm_table_t *st = (shm_table_t *)t;
+    int          n;
+
+    n = mdb_table_delete(st->table, cond);
+    mark_dirty(st, n);
+
+    return n;
+}
+
+static int update_row(void              *t,
+                      mqi_handle_t       rowh,
+                      mqi_column_desc_t *cds,
+                      void              *data)
+{
+    shm_table_t *st = (shm_table_t *)t;
+    int          n;
+
+    n = mdb_table_update_row(st->table, rowh, cds, data);
+    mark_dirty(st, n);
+
+    return n;
+}
+
+static int delete_row(void *t, mqi_handle_t rowh)
+{
+    shm_table_t *st = (shm_table_t *)t;
+    int          n;
+
+    n = mdb_table_delete_row(st->table, rowh);
+    mark_dirty(st, n);
+
+    return n;
+}
+
+
+static void *find_table(char *table_name)
+{
+    shm_table_t *st;
+    mdb_table_t *tbl;
+
+    if (!(tbl = mdb_table_find(table_name)))
+        return NULL;
+
+    MDB_DLIST_FOR_EACH(shm_table_t, link, st, &tables) {
+        if (st->table == tbl)
+            return st;
+    }
+
+    return NULL;
+}
+
+
+static int get_column_index(void *t, char *column_name)
+{
+    shm_table_t *st = (shm_table_t *)t;
+
+    return mdb_table_get_column_index(st->table, column_name);
+}
+
+static int get_table_size(void *t)
+{
+    shm_table_t *st = (shm_table_t *)t;
+
+    return mdb_table_get_size(st->table);
+}
+
+static uint32_t get_table_stamp(void *t)
+{
+    shm_table_t *st = (shm_table_t *)t;
+
+    return mdb_table_get_stamp(st->table);
+}
+
+static char *get_column_name(void *t, int colidx)
+{
+    shm_table_t *st = (shm_table_t *)t;
+
+    return mdb_table_get_column_name(st->table, colidx);
+}
+
+static mqi_data_type_t get_column_type(void *t, int colidx)
+{
+    shm_table_t *st = (shm_table_t *)t;
+
+    return mdb_table_get_column_type(st->table, colidx);
+}
+
+static int get_column_size(void *t, int colidx)
+{
+    shm_table_t *st = (shm_table_t *)t;
+
+    return mdb_table_get_column_size(st->table, colidx);
+}
+
+static int print_rows(void *t, char *buf, int len)
+{
+    shm_table_t *st = (shm_table_t *)t;
+
+    return mdb_table_print_rows(st->table, buf, len);
+}
+
+
+static void mark_dirty(shm_table_t *st, int nchange)
+{
+    if (nchange <= 0)
+        return;
+
+    st->dirty = 1;
+
+    if (!txdepth)
+        publish(st);
+}
+
+
+static void publish_dirty(void)
+{
+    shm_table_t *st;
+
+    MDB_DLIST_FOR_EACH(shm_table_t, link, st, &tables) {
+        if (st->dirty)
+            publish(st);
+    }
+}
+
+
+static int grow_buffer(shm_table_t *st, mqi_shm_buffer_t **bufp, size_t need)
+{
+    mqi_shm_buffer_t *buf = *bufp;
+    mqi_shm_header_t *hdr;
+    size_t            offs, size, total;
+    int               idx;
+
+    /*
+     * The buffer being written is not in use by readers, but the other
+     * one is, so we can't move that. Extend the region and move the
+     * buffer to its end instead, leaving a hole behind. Doubling the
+     * capacity keeps the total size within a small multiple of what is
+     * needed.
+     */
+    idx   = buf - st->hdr->buf;
+    size  = (need * 2 + 4095) & ~(size_t)4095;
+    offs  = st->size;
+    total = offs + size;
+
+    if (ftruncate(st->fd, total) < 0)
+        return -1;
+
+    hdr = mremap(st->hdr, st->size, total, MREMAP_MAYMOVE);
+
+    if (hdr == MAP_FAILED)
+        return -1;
+
+    st->hdr  = hdr;
+    st->size = total;
+    buf      = hdr->buf + idx;
+
+    buf->offset = offs;
+    buf->size   = size;
+    __atomic_store_n(&hdr->size, total, __ATOMIC_RELEASE);
+
+    *bufp = buf;
+
+    return 0;
+}
+
+
+static int publish(shm_table_t *st)
+{
+    mqi_shm_header_t *hdr = st->hdr;
+    mqi_shm_buffer_t *buf;
+    uint64_t          one = 1;
+    uint32_t          seq, idx;
+    size_t            need;
+    int               nrow;
+
+    if ((nrow = mdb_table_get_size(st->table)) < 0)
+        return -1;
+
+    idx  = !hdr->active;
+    buf  = hdr->buf + idx;
+    seq  = buf->seq;
+    need = (size_t)nrow * hdr->rowlen;
+
+    __atomic_store_n(&buf->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    if (need > buf->size) {
+        if (grow_buffer(st, &buf, need) < 0) {
+            __atomic_store_n(&st->hdr->buf[idx].seq, seq + 2,__ATOMIC_RELEASE);
+            return -1;
+        }
+
+        hdr = st->hdr;
+    }
+
+    buf->nrow = mdb_table_dump_rows(st->table, (uint8_t *)hdr + buf->offset,
+                                    nrow);
+
+    __atomic_store_n(&buf->seq, seq + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&hdr->active, idx, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&hdr->generation, 1, __ATOMIC_RELEASE);
+
+    st->dirty = 0;
+
+    if (write(st->evfd, &one, sizeof(one)) < 0) {
+        /* can only fail if the counter overflows, which it won't */
+    }
+
+    return 0;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <murphy-db/macros.h>
+#include <murphy-db/mqi-shm.h>
+
+#include "shm-layout.h"
+
+/*
+ * Client side of shared tables. This does not depend on the rest of
+ * MQI, it only ever looks at the mapped region.
+ */
+
+#define MAX_RETRY 64
+
+struct mqi_shm_s {
+    int               fd;                /* region descriptor */
+    int               evfd;              /* change notification eventfd */
+    mqi_shm_header_t *hdr;               /* region mapping */
+    size_t            size;              /* size of the mapping */
+    uint32_t          generation;        /* generation last read */
+};
+
+
+static int remap(mqi_shm_t *t, size_t size)
+{
+    void *hdr;
+
+    hdr = mmap(NULL, size, PROT_READ, MAP_SHARED, t->fd, 0);
+
+    if (hdr == MAP_FAILED)
+        return -1;
+
+    if (t->hdr != NULL)
+        munmap(t->hdr, t->size);
+
+    t->hdr  = hdr;
+    t->size = size;
+
+    return 0;
+}
+
+
+mqi_shm_t *mqi_shm_attach(int shmfd, int evfd)
+{
+    mqi_shm_t   *t;
+    struct stat  st;
+
+    MDB_CHECKARG(shmfd >= 0, NULL);
+
+    if (fstat(shmfd, &st) < 0)
+        return NULL;
+
+    MDB_ASSERT((size_t)st.st_size >= sizeof(mqi_shm_header_t), EINVAL, NULL);
+
+    if (!(t = calloc(1, sizeof(*t))))
+        return NULL;
+
+    t->fd   = shmfd;
+    t->evfd = evfd;
+
+    if (remap(t, st.st_size) < 0) {
+        free(t);
+        return NULL;
+    }
+
+    if (t->hdr->magic != MQI_SHM_MAGIC || t->hdr->version != MQI_SHM_VERSION) {
+        munmap(t->hdr, t->size);
+        free(t);
+        errno = EPROTO;
+        return NULL;
+    }
+
+    return t;
+}
+
+
+void mqi_shm_detach(mqi_shm_t *t)
+{
+    if (t == NULL)
+        return;
+
+    munmap(t->hdr, t->size);
+    close(t->fd);
+
+    if (t->evfd >= 0)
+        close(t->evfd);
+
+    free(t);
+}
+
+
+const char *mqi_shm_get_table_name(mqi_shm_t *t)
+{
+    MDB_CHECKARG(t, NULL);
+
+    return t->hdr->name;
+}
+
+
+int mqi_shm_describe(mqi_shm_t *t, mqi_column_def_t *defs, int len)
+{
+    mqi_shm_column_t *col;
+    mqi_column_def_t *def;
+    int               i, n;
+
+    MDB_CHECKARG(t && defs && len > 0 && len >= (n = t->hdr->ncolumn), -1);
+
+    for (i = 0;  i < n;  i++) {
+        col = t->hdr->columns + i;
+        def = defs + i;
+
+        def->name   = col->name;
+        def->type   = col->type;
+        def->length = col->length;
+        def->flags  = col->flags;
+
+        if (def->type == mqi_varchar && def->length > 0)
+            def->length--;
+    }
+
+    return n;
+}
+
+
+int mqi_shm_get_column_index(mqi_shm_t *t, const char *name)
+{
+    uint32_t i;
+
+    MDB_CHECKARG(t && name, -1);
+
+    for (i = 0;  i < t->hdr->ncolumn;  i++)
+        if (!strcmp(t->hdr->columns[i].name, name))
+            return i;
+
+    errno = ENOENT;
+    return -1;
+}
+
+
+int mqi_shm_get_column_offset(mqi_shm_t *t, int colidx)
+{
+    MDB_CHECKARG(t && colidx >= 0 && colidx < (int)t->hdr->ncolumn, -1);
+
+    return t->hdr->columns[colidx].offset;
+}
+
+
+int mqi_shm_get_row_length(mqi_shm_t *t)
+{
+    MDB_CHECKARG(t, -1);
+
+    return t->hdr->rowlen;
+}
+
+
+int mqi_shm_get_fd(mqi_shm_t *t)
+{
+    MDB_CHECKARG(t, -1);
+
+    return t->evfd;
+}
+
+
+uint32_t mqi_shm_get_generation(mqi_shm_t *t)
+{
+    MDB_CHECKARG(t, 0);
+
+    return __atomic_load_n(&t->hdr->generation, __ATOMIC_ACQUIRE);
+}
+
+
+int mqi_shm_changed(mqi_shm_t *t)
+{
+    MDB_CHECKARG(t, 0);
+
+    return mqi_shm_get_generation(t) != t->generation;
+}
+
+
+int mqi_shm_read_begin(mqi_shm_t *t, const void **rows, uint32_t *token)
+{
+    mqi_shm_header_t *hdr;
+    mqi_shm_buffer_t *buf;
+    uint32_t          gen, idx, seq, nrow;
+    uint64_t          size;
+    int               retry;
+
+    MDB_CHECKARG(t && rows && token, -1);
+
+    for (retry = 0;  retry < MAX_RETRY;  retry++) {
+        hdr = t->hdr;
+
+        if (__atomic_load_n(&hdr->dropped, __ATOMIC_ACQUIRE)) {
+            errno = ENOENT;
+            return -1;
+        }
+
+        gen = __atomic_load_n(&hdr->generation, __ATOMIC_ACQUIRE);
+        idx = __atomic_load_n(&hdr->active, __ATOMIC_ACQUIRE) & 1;
+        buf = hdr->buf + idx;
+        seq = __atomic_load_n(&buf->seq, __ATOMIC_ACQUIRE);
+
+        if (seq & 1)
+            continue;
+
+        size = __atomic_load_n(&hdr->size, __ATOMIC_ACQUIRE);
+
+        if (buf->offset + buf->size > t->size) {
+            if (size <= t->size)
+                continue;
+
+            if (remap(t, size) < 0)
+                return -1;
+
+            continue;
+        }
+
+        nrow = buf->nrow;
+
+        /* a torn read of the buffer must not take us out of the region */
+        if ((uint64_t)nrow * hdr->rowlen > buf->size)
+            continue;
+
+        *rows  = (uint8_t *)hdr + buf->offset;
+        *token = seq | idx;
+        t->generation = gen;
+
+        return nrow;
+    }
+
+    errno = EBUSY;
+    return -1;
+}
+
+
+int mqi_shm_read_end(mqi_shm_t *t, uint32_t token)
+{
+    mqi_shm_buffer_t *buf;
+
+    MDB_CHECKARG(t, -1);
+
+    buf = t->hdr->buf + (token & 1);
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    if (__atomic_load_n(&buf->seq, __ATOMIC_RELAXED) != (token & ~1U)) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int mqi_shm_read(mqi_shm_t *t, void *rows, int dim)
+{
+    const void *data;
+    uint32_t    token;
+    int         nrow, retry;
+
+    MDB_CHECKARG(t && rows && dim >= 0, -1);
+
+    for (retry = 0;  retry < MAX_RETRY;  retry++) {
+        if ((nrow = mqi_shm_read_begin(t, &data, &token)) < 0)
+            return -1;
+
+        if (nrow > dim) {
+            if (mqi_shm_read_end(t, token) < 0)
+                continue;
+
+            errno = EOVERFLOW;
+            return -1;
+        }
+
+        memcpy(rows, data, (size_t)nrow * t->hdr->rowlen);
+
+        if (mqi_shm_read_end(t, token) == 0)
+            return nrow;
+    }
+
+    errno = EBUSY;
+    return -1;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MQI_SHM_LAYOUT_H__
+#define __MQI_SHM_LAYOUT_H__
+
+#include <stdint.h>
+
+#include <murphy-db/mqi-types.h>
+
+/*
+ * Layout of a shared table region, shared by the publishing backend
+ * and the client library.
+ *
+ * The region starts with a header, followed by the row data of the two
+ * snapshot buffers. A buffer is (re)written only while it is not the
+ * active one, with its sequence counter odd for the duration. When a
+ * buffer needs to grow, the region is extended and the buffer moved to
+ * the end of it. The header is never moved and its static part (magic
+ * through columns) is never changed after creation.
+ */
+
+#define MQI_SHM_MAGIC     0x4d514953     /* 'MQIS' */
+#define MQI_SHM_VERSION   1
+#define MQI_SHM_NAME_MAX  64
+
+typedef struct {
+    char     name[MQI_SHM_NAME_MAX];     /* column name */
+    int32_t  type;                       /* mqi_data_type_t */
+    int32_t  length;                     /* column length */
+    int32_t  offset;                     /* offset within rows */
+    uint32_t flags;                      /* MQI_COLUMN_* flags */
+} mqi_shm_column_t;
+
+typedef struct {
+    uint32_t seq;                        /* odd while being written */
+    uint32_t nrow;                       /* number of rows */
+    uint64_t offset;                     /* row data offset in region */
+    uint64_t size;                       /* row data capacity */
+} mqi_shm_buffer_t;
+
+typedef struct {
+    uint32_t         magic;              /* MQI_SHM_MAGIC */
+    uint32_t         version;            /* MQI_SHM_VERSION */
+    char             name[MQI_SHM_NAME_MAX]; /* table name */
+    uint32_t         ncolumn;            /* number of columns */
+    uint32_t         rowlen;             /* length of a row */
+    mqi_shm_column_t columns[MQI_COLUMN_MAX];
+    uint64_t         size;               /* current size of the region */
+    uint32_t         generation;         /* bumped on every publish */
+    uint32_t         active;             /* buffer with the latest rows */
+    uint32_t         dropped;            /* table has been dropped */
+    uint32_t         unused;
+    mqi_shm_buffer_t buf[2];             /* snapshot buffers */
+} mqi_shm_header_t;
+
+
+#endif /* __MQI_SHM_LAYOUT_H__ */
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
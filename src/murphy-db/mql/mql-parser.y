@@ -80,6 +80,8 @@ extern int yy_mql_lex(void);
 void yy_mql_error(const char *);
 
 static int set_select_variables(int *, mqi_data_type_t *, int *, char *,int);
+static int push_insert_row(void);
+static void reset_insert_rows(void);
 static void print_query_result(mqi_column_desc_t *, mqi_data_type_t *,
                                int *, int, int, void *);
 
@@ -105,6 +107,11 @@ static int                ninput;
 static mqi_column_desc_t  coldescs[MQI_COLUMN_MAX + 1];
 static int                ncoldesc;
 
+static input_t           *rowbuf;          /* rows of an insert statement */
+static int                nrowbuf;         /* number of rows in rowbuf */
+static int                nrowcol;         /* values per row in rowbuf */
+static int                rowbuf_size;     /* allocated rows in rowbuf */
+
 static char    *strs[256];
 static int      nstr;
 
@@ -254,6 +261,9 @@ static FILE        *mqlout;
     mql_result_t *mql_result_columns_create(int, mqi_column_def_t *);
     mql_result_t *mql_result_rows_create(int, mqi_column_desc_t*,
                                          mqi_data_type_t*,int*,int,int,void*);
+    mql_result_t *mql_result_rows_refill(mql_result_t *, int,
+                                         mqi_column_desc_t*, mqi_data_type_t*,
+                                         int*, int, int, void*);
     mql_result_t *mql_result_string_create_table_list(int, char **);
     mql_result_t *mql_result_string_create_column_change(const char *,
                                                          const char *,
@@ -732,20 +742,19 @@ insert_statement: insert table_name insert_columns TKN_VALUES insert_values {
     mqi_data_type_t    type;
     int                cindex;
     int                err;
-    int                i;
+    int                i, r, n;
 
     if (!ncolnam) {
         while ((colnams[ncolnam] = mqi_get_column_name(table, ncolnam)))
             ncolnam++;
     }
 
-    if (ncolnam != ninput)
+    if (ncolnam != nrowcol)
         MQL_ERROR(EINVAL, "unbalanced set of columns and values");
 
     for (i = 0, err = 0; i < ncolnam; i++) {
         col = colnams[i];
         cd  = coldescs + i;
-        inp = inputs + i;
 
         if ((cindex = mqi_get_column_index(table, col)) < 0) {
             MQL_ERROR(ENOENT, "know nothing about '%s'", col);
@@ -755,20 +764,24 @@ insert_statement: insert table_name insert_columns TKN_VALUES insert_values {
 
         type = coltypes[i] = mqi_get_column_type(table, cindex);
 
-        if (type != inp->type) {
-            if (type != mqi_integer ||
-                inp->type != mqi_unsignd ||
-                inp->value.unsignd > INT32_MAX)
-            {
-                MQL_ERROR(EINVAL, "mismatching column and value type for '%s'",
-                          col);
-                err = 1;
-                continue;
+        for (r = 0; r < nrowbuf; r++) {
+            inp = rowbuf + r * nrowcol + i;
+
+            if (type != inp->type) {
+                if (type != mqi_integer ||
+                    inp->type != mqi_unsignd ||
+                    inp->value.unsignd > INT32_MAX)
+                {
+                    MQL_ERROR(EINVAL, "mismatching column and value type "
+                              "for '%s'", col);
+                    err = 1;
+                    break;
+                }
             }
         }
 
         cd->cindex = cindex;
-        cd->offset = (void *)&inp->value - (void *)inputs;
+        cd->offset = (void *)&rowbuf[i].value - (void *)rowbuf;
     }
 
     cd = coldescs + i;
@@ -777,18 +790,35 @@ insert_statement: insert table_name insert_columns TKN_VALUES insert_values {
 
 
     if (mode == mql_mode_precompile) {
+        if (nrowbuf > 1)
+            MQL_ERROR(EINVAL, "multi-row inserts can't be precompiled");
+
         statement = mql_make_insert_statement(table, $1, ncolnam, coltypes,
-                                              coldescs, inputs);
+                                              coldescs, rowbuf);
     }
     else {
-        row[0] = (void *)inputs;
-        row[1] = NULL;
+        if (nrowbuf == 1) {
+            row[0] = (void *)rowbuf;
+            row[1] = NULL;
+
+            n = err ? -1 : mqi_insert_into(table, $1, coldescs, row);
+        }
+        else if (err)
+            n = -1;
+        else if ($1)
+            n = mqi_upsert_rows(table, coldescs, rowbuf,
+                                nrowcol * sizeof(rowbuf[0]), nrowbuf);
+        else
+            n = mqi_insert_rows(table, coldescs, rowbuf,
+                                nrowcol * sizeof(rowbuf[0]), nrowbuf);
 
-        if (err || mqi_insert_into(table, $1, coldescs, row) < 0)
+        if (n < 0)
             MQL_ERROR(errno, "insert failed: %s\n", strerror(errno));
         else
             MQL_SUCCESS;
     }
+
+    reset_insert_rows();
 };
 
 
@@ -797,6 +827,7 @@ insert: insert_or_replace {
       ncolnam = 0;
       ninput = 0;
       ncoldesc = 0;
+      reset_insert_rows();
       $$ = $1;
 };
 
@@ -819,7 +850,20 @@ insert_columns:
 | TKN_LEFT_PAREN column_list TKN_RIGHT_PAREN
 ;
 
-insert_values: TKN_LEFT_PAREN input_value_list TKN_RIGHT_PAREN;
+insert_values:
+  insert_row
+| insert_values TKN_COMMA insert_row
+;
+
+insert_row: TKN_LEFT_PAREN input_value_list TKN_RIGHT_PAREN {
+    if (nrowbuf > 0 && ninput != nrowcol)
+        MQL_ERROR(EINVAL, "rows with different number of values");
+
+    if (!push_insert_row())
+        MQL_ERROR(ENOMEM, "failed to save row for insertion");
+
+    ninput = 0;
+};
 
 /*#toplevel#*/
 input_value_list:
@@ -963,14 +1007,28 @@ select_statement: select columns TKN_FROM table_name where_clause {
     int n;
 
 
-    if ((tsiz = mqi_get_table_size(table)) < 0)
+    /*
+     * A lazily mirrored table is only populated while subscribed. A
+     * precompiled statement holds its subscription until it is freed,
+     * others only for the duration of the select. The producer of the
+     * table may keep it populated for a while after the select, so a
+     * series of ad-hoc selects does not refill it every time.
+     */
+    if (mqi_subscribe_table(table) < 0)
+        MQL_ERROR(errno, "can't subscribe table: %s", strerror(errno));
+
+    if ((tsiz = mqi_get_table_size(table)) < 0) {
+        mqi_unsubscribe_table(table);
         MQL_ERROR(errno, "can't get table size: %s", strerror(errno));
+    }
 
 
     sts = set_select_variables(&rowsize, coltypes,colsizes,
                                errbuf, sizeof(errbuf));
-    if (sts < 0)
+    if (sts < 0) {
+        mqi_unsubscribe_table(table);
         MQL_ERROR(errno, "%s", errbuf);
+    }
 
 
     if (mode != mql_mode_precompile && mode != mql_mode_exec && !tsiz) {
@@ -984,9 +1042,12 @@ select_statement: select columns TKN_FROM table_name where_clause {
 
         if (mode != mql_mode_precompile) {
             if (tsiz != 0) {
-                if ((n = mqi_select(table, where,
-                                    coldescs, rows, rowsize, tsiz)) < 0)
+                n = mqi_select(table, where, coldescs, rows, rowsize, tsiz);
+
+                if (n < 0) {
+                    mqi_unsubscribe_table(table);
                     MQL_ERROR(errno, "select failed: %s", strerror(errno));
+                }
             }
             else
                 n = 0;
@@ -1017,6 +1078,9 @@ select_statement: select columns TKN_FROM table_name where_clause {
             break;
         }
     }
+
+    if (mode != mql_mode_precompile || !statement)
+        mqi_unsubscribe_table(table);
 };
 
 
@@ -1434,6 +1498,64 @@ void yy_mql_error(const char *msg)
 }
 
 
+/*
+ * Save the values of the row just parsed to rowbuf. String values live
+ * in the scanner's ring buffer which can wrap around during a long,
+ * multi-row insert statement, so we need our own copies of them.
+ */
+static int push_insert_row(void)
+{
+    input_t *rows, *inp;
+    int      size, i;
+
+    if (nrowbuf >= rowbuf_size) {
+        size = rowbuf_size ? 2 * rowbuf_size : 16;
+
+        if (!(rows = realloc(rowbuf, size * MQI_COLUMN_MAX * sizeof(*rows))))
+            return 0;
+
+        rowbuf      = rows;
+        rowbuf_size = size;
+    }
+
+    inp = rowbuf + nrowbuf * ninput;
+    memcpy(inp, inputs, ninput * sizeof(*inp));
+
+    for (i = 0;  i < ninput;  i++, inp++) {
+        if (inp->type == mqi_varchar && !(inp->flags & MQL_BINDABLE)) {
+            if (!(inp->value.varchar = strdup(inp->value.varchar)))
+                break;
+        }
+    }
+
+    nrowcol = ninput;
+    nrowbuf++;
+
+    if (i < ninput) {
+        /* make sure we don't try to free the rest of the strings */
+        for ( ;  i < ninput;  i++, inp++)
+            inp->type = mqi_unknown;
+
+        return 0;
+    }
+
+    return 1;
+}
+
+static void reset_insert_rows(void)
+{
+    input_t *inp;
+    int      i;
+
+    for (i = 0, inp = rowbuf;  i < nrowbuf * nrowcol;  i++, inp++) {
+        if (inp->type == mqi_varchar && !(inp->flags & MQL_BINDABLE))
+            free(inp->value.varchar);
+    }
+
+    nrowbuf = 0;
+    nrowcol = 0;
+}
+
 static int set_select_variables(int *rowsize,
                                 mqi_data_type_t *coltypes,
                                 int *colsizes,
@@ -113,6 +113,7 @@ struct result_rows_s {
     int                   rowsize;
     int                   ncol;
     int                   nrow;
+    int                   maxrow;
     void                 *data;
     column_desc_t         cols[0];
 };
@@ -478,7 +479,30 @@ mql_result_t *mql_result_rows_create(int                ncol,
                                      int                rowsize,
                                      void              *rows)
 {
-    result_rows_t     *rslt;
+    return mql_result_rows_refill(NULL, ncol, coldescs, coltypes, colsizes,
+                                  nrow, rowsize, rows);
+}
+
+
+/*
+ * Fill @r with @nrow rows. If @r is a rows result that already has room
+ * for them it is reused in place, otherwise it is grown (or created if
+ * @r is NULL or of some other type). The storage is never shrunk, so a
+ * result that is refilled over and over again settles to a size that
+ * fits the largest row set seen and stops allocating.
+ *
+ * On failure NULL is returned and @r is left untouched.
+ */
+mql_result_t *mql_result_rows_refill(mql_result_t      *r,
+                                     int                ncol,
+                                     mqi_column_desc_t *coldescs,
+                                     mqi_data_type_t   *coltypes,
+                                     int               *colsizes,
+                                     int                nrow,
+                                     int                rowsize,
+                                     void              *rows)
+{
+    result_rows_t     *rslt = (result_rows_t *)r;
     column_desc_t     *col;
     mqi_column_desc_t *cd;
     int                offs;
@@ -491,12 +515,33 @@ mql_result_t *mql_result_rows_create(int                ncol,
 
     offs = sizeof(column_desc_t) * ncol;
     dlgh = rowsize * nrow;
-    size = sizeof(result_rows_t) + offs + dlgh;
 
+    if (rslt && rslt->type == mql_result_rows &&
+        rslt->ncol == ncol && rslt->rowsize == rowsize)
+    {
+        if (nrow > rslt->maxrow) {
+            size = sizeof(result_rows_t) + offs + dlgh;
 
-    if (!(rslt = calloc(1, size))) {
-        errno = ENOMEM;
-        return NULL;
+            if (!(rslt = realloc(rslt, size))) {
+                errno = ENOMEM;
+                return NULL;
+            }
+
+            rslt->maxrow = nrow;
+        }
+    }
+    else {
+        size = sizeof(result_rows_t) + offs + dlgh;
+
+        if (!(rslt = calloc(1, size))) {
+            errno = ENOMEM;
+            return NULL;
+        }
+
+        rslt->maxrow = nrow;
+
+        if (r)
+            mql_result_free(r);
     }
 
     rslt->type    = mql_result_rows;
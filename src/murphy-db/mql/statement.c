@@ -125,7 +125,8 @@ static mql_result_t *exec_rollback(transact_statement_t *);
 static mql_result_t *exec_insert(insert_statement_t *);
 static mql_result_t *exec_update(update_statement_t *);
 static mql_result_t *exec_delete(delete_statement_t *);
-static mql_result_t *exec_select(mql_result_type_t, select_statement_t *);
+static mql_result_t *exec_select(mql_result_type_t, select_statement_t *,
+                                 mql_result_t *);
 
 static int bind_update_value(update_statement_t *,int,mqi_data_type_t,va_list);
 static int bind_delete_value(delete_statement_t *,int,mqi_data_type_t,va_list);
@@ -546,7 +547,7 @@ mql_result_t *mql_exec_statement(mql_result_type_t type, mql_statement_t *s)
         break;
 
     case mql_statement_select:
-        result = exec_select(type, (select_statement_t *)s);
+        result = exec_select(type, (select_statement_t *)s, NULL);
         break;
 
     default:
@@ -558,9 +559,24 @@ mql_result_t *mql_exec_statement(mql_result_type_t type, mql_statement_t *s)
     return result;
 }
 
+mql_result_t *mql_exec_statement_into(mql_result_type_t  type,
+                                      mql_statement_t   *s,
+                                      mql_result_t      *r)
+{
+    if (s && s->type == mql_statement_select)
+        return exec_select(type, (select_statement_t *)s, r);
+
+    mql_result_free(r);
+
+    return mql_exec_statement(type, s);
+}
+
 
 void mql_statement_free(mql_statement_t *s)
 {
+    if (s && s->type == mql_statement_select)
+        mqi_unsubscribe_table(((select_statement_t *)s)->table);
+
     free(s);
 }
 
@@ -911,7 +927,9 @@ static mql_result_t *exec_delete(delete_statement_t *d)
     return rslt;
 }
 
-static mql_result_t *exec_select(mql_result_type_t type, select_statement_t *s)
+static mql_result_t *exec_select(mql_result_type_t   type,
+                                 select_statement_t *s,
+                                 mql_result_t       *reuse)
 {
     mql_result_t *rslt;
     int           maxrow;
@@ -938,9 +956,11 @@ static mql_result_t *exec_select(mql_result_type_t type, select_statement_t *s)
         else {
             switch (type) {
             case mql_result_rows:
-                rslt = mql_result_rows_create(s->ncolumn, s->columns,
+                rslt = mql_result_rows_refill(reuse, s->ncolumn, s->columns,
                                               s->coltypes, s->colsizes,
                                               nrow, s->rowsize, rows);
+                if (rslt)
+                    reuse = NULL;
                 break;
             case mql_result_string:
                 rslt = mql_result_string_create_row_list(
@@ -956,6 +976,8 @@ static mql_result_t *exec_select(mql_result_type_t type, select_statement_t *s)
         }
     }
 
+    mql_result_free(reuse);
+
     return rslt;
 }
 
@@ -36,6 +36,7 @@
 #include <check.h>
 
 #include <murphy-db/mqi.h>
+#include <murphy-db/mqi-shm.h>
 
 #ifndef LOGFILE
 #define LOGFILE  "check_libmqi.log"
@@ -48,6 +49,7 @@
 #define TABLE_TRIGGER_DATA    TRIGGER_DATA(2)
 #define ROW_TRIGGER_DATA      TRIGGER_DATA(3)
 #define COLUMN_TRIGGER_DATA   TRIGGER_DATA(4)
+#define CHANGESET_TRIGGER_DATA TRIGGER_DATA(5)
 
 typedef struct {
     mqi_event_type_t  event;
@@ -67,6 +69,13 @@ typedef struct {
     } col;
 } trigger_t;
 
+typedef struct {
+    mqi_event_type_t  event;
+    uint32_t          old_id;
+    uint32_t          new_id;
+    char              new_name[14];
+} change_t;
+
 typedef struct {
     const char  *sex;
     const char  *first_name;
@@ -131,16 +140,165 @@ static int          ntrigger;
 static trigger_t    triggers[256];
 static int          nseq = 32;
 static int          nnest = MQI_TXDEPTH_MAX - 1;
+static int          nmaterialize;
+static int          nchangeset;
+static int          nchange;
+static change_t     changes[16];
+
+START_TEST(shared_table)
+{
+    mqi_handle_t  shared, tx;
+    mqi_shm_t    *shm;
+    record_t     *a, *recs[2];
+    char          rows[32 * 128], *r;
+    uint32_t      gen;
+    int           shmfd, evfd, rowlen, first, family, found, i, j, n;
+
+    PREREQUISITE(open_db);
+
+    shared = MQI_CREATE_TABLE("shared_persons", MQI_SHARED,
+                              persons_coldefs, persons_indexdef);
+    fail_if(shared == MQI_HANDLE_INVALID, "errno (%s)", strerror(errno));
+
+    fail_if(mqi_shm_export(shared, &shmfd, &evfd) < 0,
+            "export failed: errno (%s)", strerror(errno));
+
+    shm = mqi_shm_attach(shmfd, evfd);
+    fail_if(shm == NULL, "attach failed: errno (%s)", strerror(errno));
+
+    rowlen = mqi_shm_get_row_length(shm);
+    first  = mqi_shm_get_column_offset(shm, 2);
+    family = mqi_shm_get_column_offset(shm, 1);
+    fail_if(rowlen <= 0 || rowlen > 128 || first < 0 || family < 0,
+            "invalid row layout");
+
+    n = mqi_shm_read(shm, rows, 32);
+    fail_if(n != 0, "new table has %d rows in shared memory", n);
+
+    gen = mqi_shm_get_generation(shm);
+    tx  = mqi_begin_transaction();
+
+    recs[1] = NULL;
+
+    for (i = 0;  (recs[0] = artists[i]) != NULL;  i++) {
+        n = MQI_INSERT_INTO(shared, persons_insert_columns, recs);
+        fail_if(n != 1, "insert failed: errno (%s)", strerror(errno));
+    }
+
+    fail_if(mqi_shm_get_generation(shm) != gen,
+            "changes published before commit");
+
+    fail_if(mqi_commit_transaction(tx) < 0, "commit failed");
+
+    fail_unless(mqi_shm_changed(shm), "commit was not published");
+
+    n = mqi_shm_read(shm, rows, 32);
+    fail_if(n != MQI_DIMENSION(artists)-1, "mismatching row numbers: "
+            "%d in shared memory, supposed to be %d",
+            n, MQI_DIMENSION(artists)-1);
+
+    for (i = 0;  (a = artists[i]) != NULL;  i++) {
+        for (found = 0, j = 0;  j < n && !found;  j++) {
+            r = rows + j * rowlen;
+            found = !strcmp(r + first, a->first_name) &&
+                !strcmp(r + family, a->family_name);
+        }
+
+        fail_unless(found, "%s %s not found in shared memory",
+                    a->first_name, a->family_name);
+    }
+
+    fail_if(mqi_drop_table(shared) < 0, "drop failed");
+
+    n = mqi_shm_read(shm, rows, 32);
+    fail_unless(n < 0 && errno == ENOENT, "dropped table still readable");
+
+    mqi_shm_detach(shm);
+}
+END_TEST
+
+
+START_TEST(row_handle)
+{
+    static record_t carrie = {"female","Carrie","Fisher", 1200, "cfi@foo.com"};
+
+    mqi_handle_t  table, row, tx;
+    record_t     *recs[2], copy;
+    query_t       rows[32];
+    int           n;
+
+    PREREQUISITE(open_db);
+
+    table = MQI_CREATE_TABLE("handled_persons", MQI_TEMPORARY,
+                             persons_coldefs, persons_indexdef);
+    fail_if(table == MQI_HANDLE_INVALID, "errno (%s)", strerror(errno));
+
+    recs[0] = &greta;
+    recs[1] = NULL;
+
+    n = MQI_INSERT_INTO(table, persons_insert_columns, recs);
+    fail_if(n != 1, "insert failed: errno (%s)", strerror(errno));
+
+    row = MQI_HANDLE_INVALID;
+    n = MQI_INSERT_ROW(table, persons_insert_columns, &rita, &row);
+    fail_if(n != 1 || row == MQI_HANDLE_INVALID,
+            "insert failed: errno (%s)", strerror(errno));
+
+    copy = rita;
+    copy.first_name  = carrie.first_name;
+    copy.family_name = carrie.family_name;
+
+    n = MQI_UPDATE_ROW(table, persons_insert_columns, &copy, row);
+    fail_if(n != 1, "update by handle failed: errno (%s)", strerror(errno));
+
+    n = MQI_SELECT(persons_select_columns, table, NULL, rows);
+    fail_if(n != 2, "%d rows after update, supposed to be 2", n);
+    fail_unless((!strcmp(rows[0].first_name, "Carrie") &&
+                 !strcmp(rows[1].first_name, "Greta")) ||
+                (!strcmp(rows[1].first_name, "Carrie") &&
+                 !strcmp(rows[0].first_name, "Greta")),
+                "row handle updated the wrong row");
+
+    tx = mqi_begin_transaction();
+    fail_if(tx == MQI_HANDLE_INVALID, "can't begin transaction");
+
+    n = MQI_DELETE_ROW(table, row);
+    fail_if(n != 1, "delete by handle failed: errno (%s)", strerror(errno));
+
+    n = MQI_UPDATE_ROW(table, persons_insert_columns, &copy, row);
+    fail_unless(n < 0 && errno == ENOENT, "deleted row still updatable");
+
+    fail_if(mqi_rollback_transaction(tx) < 0, "rollback failed");
+
+    n = MQI_UPDATE_ROW(table, persons_insert_columns, &carrie, row);
+    fail_if(n != 1, "handle invalidated by rolled back delete: "
+            "errno (%s)", strerror(errno));
 
+    n = MQI_DELETE_ROW(table, row);
+    fail_if(n != 1, "delete by handle failed: errno (%s)", strerror(errno));
+
+    n = MQI_DELETE_ROW(table, row);
+    fail_unless(n < 0 && errno == ENOENT, "stale handle still valid");
+
+    n = MQI_SELECT(persons_select_columns, table, NULL, rows);
+    fail_if(n != 1 || strcmp(rows[0].first_name, "Greta"),
+            "wrong rows left after delete by handle");
+
+    fail_if(mqi_drop_table(table) < 0, "drop failed");
+}
+END_TEST
 
 static Suite *libmqi_suite(void);
 static TCase *basic_tests(void);
 static void   print_rows(int, query_t *);
+static int    count_persons(void);
 static void   print_triggers(void);
 static void   transaction_event_cb(mqi_event_t *, void *);
 static void   table_event_cb(mqi_event_t *, void *);
 static void   row_event_cb(mqi_event_t *, void *);
 static void   column_event_cb(mqi_event_t *, void *);
+static void   materialize_cb(mqi_handle_t, int, void *);
+static void   changeset_event_cb(mqi_event_t *, void *);
 
 
 int main(int argc, char **argv)
@@ -336,6 +494,98 @@ START_TEST(insert_duplicate_into_persons)
 }
 END_TEST
 
+START_TEST(insert_rows_into_persons)
+{
+    static record_t bulk[] = {
+        {"male"  , "Clark", "Gable"  , 800, "cga@heaven.org"},
+        {"female", "Grace", "Kelly"  , 900, "gke@heaven.org"},
+        {"male"  , "James", "Dean"   , 300, "jde@heaven.org"},
+    };
+
+    int n;
+
+    PREREQUISITE(insert_into_persons);
+
+    n = MQI_INSERT_ROWS(persons, persons_insert_columns, bulk);
+
+    fail_if(n < 0, "errno (%s)", strerror(errno));
+
+    fail_if(n != MQI_DIMENSION(bulk), "some insertion failed. "
+            "Attempted %d succeeded %d", MQI_DIMENSION(bulk), n);
+
+    n = count_persons();
+
+    fail_if(n != rows_no_in_persons + MQI_DIMENSION(bulk), "mismatch in row "
+            "numbers: expected %d reported %d",
+            rows_no_in_persons + MQI_DIMENSION(bulk), n);
+}
+END_TEST
+
+
+START_TEST(insert_duplicate_rows_into_persons)
+{
+    static record_t bulk[] = {
+        {"male"  , "Clark", "Gable"  , 800, "cga@heaven.org"},
+        {"male"  , "Gary" , "Cooper" , 200, "gary@att.com"  },
+    };
+
+    int n;
+
+    PREREQUISITE(insert_into_persons);
+
+    n = MQI_INSERT_ROWS(persons, persons_insert_columns, bulk);
+
+    fail_if(n >= 0, "managed to insert a duplicate");
+
+    fail_if(errno != EEXIST, "error (%s)", strerror(errno));
+
+    n = count_persons();
+
+    fail_if(n != rows_no_in_persons, "failed batch was not rolled back "
+            "(expected %d rows, found %d)", rows_no_in_persons, n);
+}
+END_TEST
+
+
+START_TEST(upsert_rows_in_persons)
+{
+    static record_t bulk[] = {
+        {"male"  , "Clark", "Gable"  , 800, "cga@heaven.org"},
+        {"male"  , "Gary" , "Cooper" , 200, "gary@att.com"  },
+    };
+
+    MQI_INDEX_VALUE(index,
+        MQI_STRING_VAL(bulk[1].family_name)
+        MQI_STRING_VAL(bulk[1].first_name)
+    );
+
+    query_t row;
+    int n;
+
+    PREREQUISITE(insert_into_persons);
+
+    n = MQI_UPSERT_ROWS(persons, persons_insert_columns, bulk);
+
+    fail_if(n < 0, "error (%s)", strerror(errno));
+
+    fail_if(n != 1, "expected 1 insertion and 1 replacement, got %d "
+            "insertions", n);
+
+    n = count_persons();
+
+    fail_if(n != rows_no_in_persons + 1, "mismatch in row numbers: "
+            "expected %d reported %d", rows_no_in_persons + 1, n);
+
+    n = MQI_SELECT_BY_INDEX(persons_select_columns, persons, index, &row);
+
+    fail_if(n <= 0, "could not select replaced row");
+
+    fail_if(row.id != bulk[1].id, "row was not replaced (id %u vs. %u)",
+            row.id, bulk[1].id);
+}
+END_TEST
+
+
 START_TEST(transaction_begin)
 {
     mqi_handle_t tx;
@@ -871,6 +1121,149 @@ END_TEST
 
 
 
+START_TEST(lazy_table)
+{
+    mqi_handle_t  table;
+    query_t       rows[8];
+    int           n;
+
+    PREREQUISITE(open_db);
+
+    table = MQI_CREATE_TABLE("lazy_persons", MQI_TEMPORARY,
+                             persons_coldefs, persons_indexdef);
+    fail_if(table == MQI_HANDLE_INVALID, "errno (%s)", strerror(errno));
+
+    fail_if(mqi_set_table_materializer(table, materialize_cb, &tom) < 0,
+            "setting materializer failed: errno (%s)", strerror(errno));
+
+    fail_if(nmaterialize != 0, "unsubscribed table got materialized");
+    fail_if(mqi_table_is_subscribed(table), "table subscribed by default");
+
+    n = mqi_create_row_trigger(table, row_event_cb, ROW_TRIGGER_DATA,
+                               persons_select_columns);
+    fail_if(n < 0, "create row trigger failed: errno (%s)", strerror(errno));
+
+    n = MQI_SELECT(persons_select_columns, table, NULL, rows);
+    fail_unless(nmaterialize == 1 && n == 1,
+                "row trigger did not materialize the table");
+
+    fail_if(mqi_subscribe_table(table) < 0, "subscribe failed");
+    fail_if(nmaterialize != 1, "second subscriber materialized the table");
+
+    n = mqi_drop_row_trigger(table, row_event_cb, ROW_TRIGGER_DATA);
+    fail_if(n < 0, "drop row trigger failed: errno (%s)", strerror(errno));
+
+    fail_unless(mqi_table_is_subscribed(table) == 1,
+                "subscription lost with subscribers left");
+
+    fail_if(mqi_unsubscribe_table(table) < 0, "unsubscribe failed");
+
+    n = MQI_SELECT(persons_select_columns, table, NULL, rows);
+    fail_unless(nmaterialize == 0 && n == 0,
+                "last unsubscribe did not release the table");
+
+    fail_unless(mqi_unsubscribe_table(table) < 0,
+                "unsubscribing an unsubscribed table succeeded");
+
+    fail_if(mqi_drop_table(table) < 0, "drop failed");
+}
+END_TEST
+
+
+START_TEST(changeset_trigger)
+{
+    static query_t kalle = {1, "Korhonen", "Kalle"};
+
+    MQI_WHERE_CLAUSE(where_elvis,
+        MQI_EQUAL( MQI_COLUMN(3), MQI_UNSIGNED_VAR(elvis.id) )
+    );
+    MQI_WHERE_CLAUSE(where_gary,
+        MQI_EQUAL( MQI_COLUMN(3), MQI_UNSIGNED_VAR(gary.id) )
+    );
+
+    record_t     *recs[] = { &gary, &elvis, NULL };
+    mqi_handle_t  table, outer, inner;
+    change_t     *ch;
+    int           n;
+
+    PREREQUISITE(open_db);
+
+    table = MQI_CREATE_TABLE("changeset_persons", MQI_TEMPORARY,
+                             persons_coldefs, persons_indexdef);
+    fail_if(table == MQI_HANDLE_INVALID, "errno (%s)", strerror(errno));
+
+    n = mqi_create_changeset_trigger(table, changeset_event_cb,
+                                     CHANGESET_TRIGGER_DATA,
+                                     persons_select_columns);
+    fail_if(n < 0, "create changeset trigger failed: errno (%s)",
+            strerror(errno));
+
+    nchangeset = nchange = 0;
+
+    outer = mqi_begin_transaction();
+    fail_if(outer == MQI_HANDLE_INVALID, "begin failed: errno (%s)",
+            strerror(errno));
+
+    n = MQI_INSERT_INTO(table, persons_insert_columns, recs);
+    fail_unless(n == 2, "insert failed: errno (%s)", strerror(errno));
+
+    inner = mqi_begin_transaction();
+    fail_if(inner == MQI_HANDLE_INVALID, "nested begin failed: errno (%s)",
+            strerror(errno));
+
+    n = MQI_UPDATE(table, persons_select_columns, &kalle, where_elvis);
+    fail_unless(n == 1, "update failed: errno (%s)", strerror(errno));
+
+    fail_if(mqi_commit_transaction(inner) < 0, "nested commit failed");
+    fail_unless(nchangeset == 0, "changeset delivered by a nested commit");
+
+    inner = mqi_begin_transaction();
+    fail_if(inner == MQI_HANDLE_INVALID, "nested begin failed: errno (%s)",
+            strerror(errno));
+
+    n = MQI_DELETE(table, where_gary);
+    fail_unless(n == 1, "nested delete failed: errno (%s)", strerror(errno));
+
+    fail_if(mqi_rollback_transaction(inner) < 0, "nested rollback failed");
+
+    n = MQI_DELETE(table, where_gary);
+    fail_unless(n == 1, "delete failed: errno (%s)", strerror(errno));
+
+    fail_if(mqi_commit_transaction(outer) < 0, "commit failed");
+
+    fail_unless(nchangeset == 1, "%d changesets instead of one", nchangeset);
+    fail_unless(nchange == 4, "%d changed rows instead of 4", nchange);
+
+    /* rows are reported in the order they were changed, as they were */
+    ch = changes + 0;
+    fail_unless(ch->event == mqi_row_inserted && ch->new_id == gary.id,
+                "first change is not the insertion of gary");
+
+    ch = changes + 1;
+    fail_unless(ch->event == mqi_row_inserted && ch->new_id == elvis.id &&
+                !strcmp(ch->new_name, elvis.first_name),
+                "second change is not the insertion of elvis");
+
+    ch = changes + 2;
+    fail_unless(ch->event == mqi_row_updated &&
+                ch->old_id == elvis.id && ch->new_id == kalle.id &&
+                !strcmp(ch->new_name, kalle.first_name),
+                "third change is not the update of elvis");
+
+    ch = changes + 3;
+    fail_unless(ch->event == mqi_row_deleted && ch->old_id == gary.id,
+                "fourth change is not the deletion of gary");
+
+    n = mqi_drop_changeset_trigger(table, changeset_event_cb,
+                                   CHANGESET_TRIGGER_DATA);
+    fail_if(n < 0, "drop changeset trigger failed: errno (%s)",
+            strerror(errno));
+
+    fail_if(mqi_drop_table(table) < 0, "drop failed");
+}
+END_TEST
+
+
 static Suite *libmqi_suite(void)
 {
     Suite *s = suite_create("Murphy Query Interface - libmqi");
@@ -893,6 +1286,9 @@ static TCase *basic_tests(void)
     tcase_add_test(tc, row_count_in_persons);
     tcase_add_test(tc, insert_duplicate_into_persons);
     tcase_add_test(tc, replace_in_persons);
+    tcase_add_test(tc, insert_rows_into_persons);
+    tcase_add_test(tc, insert_duplicate_rows_into_persons);
+    tcase_add_test(tc, upsert_rows_in_persons);
     tcase_add_test(tc, filtered_select_from_persons);
     tcase_add_test(tc, full_select_from_persons);
     tcase_add_test(tc, select_from_persons_by_index);
@@ -904,10 +1300,21 @@ static TCase *basic_tests(void)
     tcase_add_test(tc, column_trigger);
     tcase_add_test(tc, sequential_transactions);
     tcase_add_test(tc, nested_transactions);
+    tcase_add_test(tc, shared_table);
+    tcase_add_test(tc, row_handle);
+    tcase_add_test(tc, lazy_table);
+    tcase_add_test(tc, changeset_trigger);
 
     return tc;
 }
 
+static int count_persons(void)
+{
+    query_t rows[32];
+
+    return MQI_SELECT(persons_select_columns, persons, NULL, rows);
+}
+
 static void print_rows(int n, query_t *rows)
 {
     query_t *r;
@@ -1172,6 +1579,56 @@ static void column_event_cb(mqi_event_t *evt, void *user_data)
 #undef PRINT_VALUE
 }
 
+static void materialize_cb(mqi_handle_t table, int subscribed, void *data)
+{
+    record_t *recs[2] = { (record_t *)data, NULL };
+
+    if (subscribed) {
+        if (MQI_INSERT_INTO(table, persons_insert_columns, recs) == 1)
+            nmaterialize++;
+    }
+    else {
+        if (MQI_DELETE(table, NULL) >= 0)
+            nmaterialize--;
+    }
+}
+
+static void changeset_event_cb(mqi_event_t *evt, void *user_data)
+{
+    mqi_changeset_event_t *ce = &evt->changeset;
+    mqi_change_row_t      *cr;
+    change_t              *ch;
+    query_t               *row;
+    int                    i;
+
+    if (evt->event != mqi_table_changed ||
+        user_data != CHANGESET_TRIGGER_DATA)
+    {
+        if (verbose)
+            printf("invalid event %d for changeset trigger\n", evt->event);
+        return;
+    }
+
+    nchangeset++;
+
+    for (i = 0;  i < ce->nrow && nchange < (int)MQI_DIMENSION(changes);  i++) {
+        cr = ce->rows + i;
+        ch = changes + nchange++;
+
+        memset(ch, 0, sizeof(*ch));
+        ch->event = cr->event;
+
+        if ((row = cr->old) != NULL)
+            ch->old_id = row->id;
+
+        if ((row = cr->new_) != NULL) {
+            ch->new_id = row->id;
+            strncpy(ch->new_name, row->first_name,
+                    MQI_DIMENSION(ch->new_name) - 1);
+        }
+    }
+}
+
 /*
  * Local Variables:
  * c-basic-offset: 4
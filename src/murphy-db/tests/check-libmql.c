@@ -281,6 +281,46 @@ START_TEST(make_persons)
 }
 END_TEST
 
+START_TEST(multi_row_insert_into_persons)
+{
+    mql_result_t *r;
+    int n;
+
+    PREREQUISITE(make_persons);
+
+    r = mql_exec_string(mql_result_string,
+                        "INSERT INTO persons VALUES "
+                        "('male'  , 'Gable', 'Clark', 800, 'cga@heaven.org'),"
+                        "('female', 'Kelly', 'Grace', 900, 'gke@heaven.org')");
+
+    fail_unless(mql_result_is_success(r), "insert error: %s",
+                mql_result_error_get_message(r));
+
+    mql_result_free(r);
+
+    r = mql_exec_string(mql_result_string,
+                        "REPLACE INTO persons VALUES "
+                        "('male'  , 'Cooper', 'Gary' , 200, 'gco@heaven.org'),"
+                        "('male'  , 'Dean'  , 'James', 300, 'jde@heaven.org')");
+
+    fail_unless(mql_result_is_success(r), "replace error: %s",
+                mql_result_error_get_message(r));
+
+    mql_result_free(r);
+
+    r = mql_exec_string(mql_result_rows, "SELECT id FROM persons");
+
+    fail_unless(mql_result_is_success(r), "select error: %s",
+                mql_result_error_get_message(r));
+
+    if ((n = mql_result_rows_get_row_count(r)) != persons_nrow + 3)
+        fail("row number mismatch (%d vs. %d)", persons_nrow + 3, n);
+
+    mql_result_free(r);
+}
+END_TEST
+
+
 START_TEST(precompile_transaction_statements)
 {
 #define TRID "transaction_1"
@@ -888,6 +928,7 @@ static TCase *basic_tests(void)
     tcase_add_test(tc, describe_persons);
     tcase_add_test(tc, create_index_on_persons);
     tcase_add_test(tc, insert_into_persons);
+    tcase_add_test(tc, multi_row_insert_into_persons);
     tcase_add_test(tc, precompile_transaction_statements);
     tcase_add_test(tc, precompile_filtered_person_select);
     tcase_add_test(tc, precompile_full_person_select);
@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <libgen.h>
+
+#include <murphy-db/mqi.h>
+
+/*
+ * Compare inserting rows one by one with mqi_insert_into against
+ * inserting them in a single batch with mqi_insert_rows.
+ */
+
+typedef struct {
+    uint32_t    id;
+    const char *name;
+    int32_t     value;
+} bench_row_t;
+
+
+MQI_COLUMN_DEFINITION_LIST(bench_coldefs,
+    MQI_COLUMN_DEFINITION( "id"   , MQI_UNSIGNED    ),
+    MQI_COLUMN_DEFINITION( "name" , MQI_VARCHAR(16) ),
+    MQI_COLUMN_DEFINITION( "value", MQI_INTEGER     )
+);
+
+MQI_INDEX_DEFINITION(bench_indexdef,
+    MQI_INDEX_COLUMN("id")
+);
+
+MQI_COLUMN_SELECTION_LIST(bench_columns,
+    MQI_COLUMN_SELECTOR( 0, bench_row_t, id    ),
+    MQI_COLUMN_SELECTOR( 1, bench_row_t, name  ),
+    MQI_COLUMN_SELECTOR( 2, bench_row_t, value )
+);
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+
+static mqi_handle_t create_table(const char *name)
+{
+    mqi_handle_t h;
+
+    h = MQI_CREATE_TABLE((char *)name, MQI_TEMPORARY,
+                         bench_coldefs, bench_indexdef);
+
+    if (h == MQI_HANDLE_INVALID) {
+        printf("failed to create table %s (%s)\n", name, strerror(errno));
+        exit(1);
+    }
+
+    return h;
+}
+
+
+static double insert_one_by_one(bench_row_t *rows, int nrow)
+{
+    mqi_handle_t  h, tx;
+    void         *data[2];
+    double        start, end;
+    int           i;
+
+    h = create_table("bench_single");
+    data[1] = NULL;
+
+    start = now();
+
+    tx = mqi_begin_transaction();
+    for (i = 0; i < nrow; i++) {
+        data[0] = rows + i;
+
+        if (mqi_insert_into(h, 0, bench_columns, data) != 1) {
+            printf("insert failed (%s)\n", strerror(errno));
+            exit(1);
+        }
+    }
+    mqi_commit_transaction(tx);
+
+    end = now();
+
+    mqi_drop_table(h);
+
+    return end - start;
+}
+
+
+static double insert_batch(bench_row_t *rows, int nrow, int upsert)
+{
+    mqi_handle_t h;
+    double       start, end;
+    int          n;
+
+    h = create_table("bench_batch");
+
+    start = now();
+
+    if (upsert) {
+        /* insert once, then replace every row in a second batch */
+        if (mqi_insert_rows(h, bench_columns, rows, sizeof(*rows), nrow) < 0)
+            goto fail;
+
+        start = now();
+        n = mqi_upsert_rows(h, bench_columns, rows, sizeof(*rows), nrow);
+    }
+    else
+        n = mqi_insert_rows(h, bench_columns, rows, sizeof(*rows), nrow);
+
+    end = now();
+
+    if (n < 0)
+        goto fail;
+
+    mqi_drop_table(h);
+
+    return end - start;
+
+ fail:
+    printf("batch insert failed (%s)\n", strerror(errno));
+    exit(1);
+}
+
+
+int main(int argc, char **argv)
+{
+    bench_row_t *rows;
+    char        *names;
+    int          nrow, rounds, i, r;
+    double       single, batch, upsert;
+
+    nrow   = argc > 1 ? atoi(argv[1]) : 10000;
+    rounds = argc > 2 ? atoi(argv[2]) : 10;
+
+    if (nrow <= 0 || rounds <= 0) {
+        printf("usage: %s [rows [rounds]]\n", basename(argv[0]));
+        exit(1);
+    }
+
+    if (mqi_open() < 0) {
+        printf("failed to open database (%s)\n", strerror(errno));
+        exit(1);
+    }
+
+    rows  = calloc(nrow, sizeof(*rows));
+    names = calloc(nrow, 16);
+
+    if (rows == NULL || names == NULL) {
+        printf("failed to allocate %d rows\n", nrow);
+        exit(1);
+    }
+
+    for (i = 0; i < nrow; i++) {
+        snprintf(names + i * 16, 16, "row #%d", i);
+        rows[i].id    = i;
+        rows[i].name  = names + i * 16;
+        rows[i].value = nrow - i;
+    }
+
+    single = batch = upsert = 0.0;
+
+    for (r = 0; r < rounds; r++) {
+        single += insert_one_by_one(rows, nrow);
+        batch  += insert_batch(rows, nrow, 0);
+        upsert += insert_batch(rows, nrow, 1);
+    }
+
+    printf("%d rows, %d rounds, average per round:\n", nrow, rounds);
+    printf("    mqi_insert_into, one row per call: %.3f ms\n",
+           1000.0 * single / rounds);
+    printf("    mqi_insert_rows                  : %.3f ms\n",
+           1000.0 * batch / rounds);
+    printf("    mqi_upsert_rows, replacing all   : %.3f ms\n",
+           1000.0 * upsert / rounds);
+
+    free(rows);
+    free(names);
+
+    mqi_close();
+
+    return 0;
+}
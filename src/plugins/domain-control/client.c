@@ -395,6 +395,50 @@ int mrp_domctl_set_data(mrp_domctl_t *dc, mrp_domctl_data_t *tables, int ntable,
 }
 
 
+int mrp_domctl_update_rows(mrp_domctl_t *dc, mrp_domctl_delta_t *deltas,
+                           int ndelta, mrp_domctl_status_cb_t cb,
+                           void *user_data)
+{
+    update_msg_t  update;
+    mrp_msg_t    *msg;
+    uint32_t      seq;
+    int           success, i;
+
+    if (!dc->connected)
+        return FALSE;
+
+    for (i = 0; i < ndelta; i++) {
+        if (deltas[i].id < 0 || deltas[i].id >= dc->ntable)
+            return FALSE;
+
+        if (!dc->tables[deltas[i].id].mql_index[0])
+            return FALSE;
+    }
+
+    seq = dc->seqno++;
+
+    mrp_clear(&update);
+    update.type   = MSG_TYPE_UPDATE;
+    update.seq    = seq;
+    update.tables = deltas;
+    update.ntable = ndelta;
+
+    msg = msg_encode_message((msg_t *)&update);
+
+    if (msg != NULL) {
+        success = mrp_transport_send(dc->t, msg);
+        mrp_msg_unref(msg);
+
+        if (success)
+            queue_pending(dc, seq, cb, user_data);
+
+        return success;
+    }
+    else
+        return FALSE;
+}
+
+
 int mrp_domctl_invoke(mrp_domctl_t *dc, const char *name, int narg,
                       mrp_domctl_arg_t *args, mrp_domctl_return_cb_t reply_cb,
                       void *user_data)
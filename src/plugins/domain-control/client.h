@@ -86,6 +86,27 @@ typedef struct {
 } mrp_domctl_data_t;
 
 
+/*
+ * incremental table data
+ *
+ * Rows are matched by the index columns (mql_index) given for the table
+ * at registration. Rows in rows are inserted or, if a row with the same
+ * key exists, replace it. Rows in keys contain only the key columns, in
+ * index order, and select the rows to delete. Deletions are applied before
+ * insertions.
+ */
+
+typedef struct {
+    int                  id;             /* table id */
+    int                  ncolumn;        /* columns per inserted row */
+    mrp_domctl_value_t **rows;           /* rows to insert or replace */
+    int                  nrow;           /* number of rows to insert */
+    int                  nkey;           /* columns per deleted key */
+    mrp_domctl_value_t **keys;           /* keys of rows to delete */
+    int                  ndelete;        /* number of rows to delete */
+} mrp_domctl_delta_t;
+
+
 /** Opaque policy domain controller type. */
 typedef struct mrp_domctl_s mrp_domctl_t;
 
@@ -161,6 +182,11 @@ void mrp_domctl_disconnect(mrp_domctl_t *dc);
 int mrp_domctl_set_data(mrp_domctl_t *dc, mrp_domctl_data_t *tables, int ntable,
                         mrp_domctl_status_cb_t status_cb, void *user_data);
 
+/** Insert, replace or delete the given rows, leaving other rows intact. */
+int mrp_domctl_update_rows(mrp_domctl_t *dc, mrp_domctl_delta_t *deltas,
+                           int ndelta, mrp_domctl_status_cb_t status_cb,
+                           void *user_data);
+
 /** Invoke a proxied method. */
 int mrp_domctl_invoke(mrp_domctl_t *dc, const char *method, int narg,
                       mrp_domctl_arg_t *args, mrp_domctl_return_cb_t return_cb,
@@ -428,3 +428,42 @@ DomainController.prototype.set = function (table_data) {
 
     return this.send_request(req);
 }
+
+
+/** Insert, replace or delete rows on server, matching them by index. */
+DomainController.prototype.update = function (table_deltas) {
+    var idx, id, tbl, data;
+    var ntbl, ntot, rows, keys, ncol, nkey;
+    var req;
+
+    req = { type: 'update', seq: 0, nchange: 0, ntotal: 0, tables: [] };
+
+    ntbl = ntot = 0;
+    for (idx in table_deltas) {
+        ntbl++;
+        data = table_deltas[idx];
+        rows = data.rows ? data.rows : [];
+        keys = data.keys ? data.keys : [];
+
+        ncol  = rows.length ? rows[0].length : 0;
+        nkey  = keys.length ? keys[0].length : 0;
+        ntot += ncol * rows.length + nkey * keys.length;
+
+        id = -1;
+        for (tbl in this.tables) {
+            if (this.tables[tbl].table == data.table)
+                id = this.tables[tbl].id;
+        }
+        if (id < 0)
+            throw new DomainControllerError("unknown table " + data.table);
+
+        req.tables[idx] = { id: id,
+                            nrow: rows.length, ncol: ncol, rows: rows,
+                            ndel: keys.length, nkey: nkey, keys: keys };
+    }
+
+    req.nchange = ntbl;
+    req.ntotal  = ntot;
+
+    return this.send_request(req);
+}
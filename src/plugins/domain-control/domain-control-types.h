@@ -90,6 +90,8 @@ struct pep_table_s {
     mqi_column_desc_t  *coldesc;         /* column descriptors */
     int                 ncolumn;         /* number of columns */
     int                 idx_col;         /* column index of index column */
+    int                *keys;            /* column indices of index columns */
+    int                 nkey;            /* number of index columns */
     mrp_list_hook_t     watches;         /* watches for this table */
     bool                changed;         /* whether has unsynced changes */
 };
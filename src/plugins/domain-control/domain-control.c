@@ -283,6 +283,19 @@ static void process_set(pep_proxy_t *proxy, set_msg_t *set)
 }
 
 
+static void process_update(pep_proxy_t *proxy, update_msg_t *update)
+{
+    int         error;
+    const char *errmsg;
+
+    if (update_proxy_tables(proxy, update->tables, update->ntable,
+                            &error, &errmsg))
+        msg_send_ack(proxy, update->seq);
+    else
+        msg_send_nak(proxy, update->seq, error, errmsg);
+}
+
+
 static void process_invoke(pep_proxy_t *proxy, invoke_msg_t *invoke)
 {
     mrp_context_t          *ctx = proxy->pdp->ctx;
@@ -370,6 +383,9 @@ static void process_message(pep_proxy_t *proxy, msg_t *msg)
     case MSG_TYPE_SET:
         process_set(proxy, &msg->set);
         break;
+    case MSG_TYPE_UPDATE:
+        process_update(proxy, &msg->update);
+        break;
     case MSG_TYPE_INVOKE:
         process_invoke(proxy, &msg->invoke);
         break;
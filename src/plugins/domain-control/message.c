@@ -326,6 +326,85 @@ msg_t *msg_decode_nak(mrp_msg_t *msg)
 }
 
 
+static int encode_rows(mrp_msg_t *msg, mrp_domctl_value_t **rows, int nrow,
+                       int ncol)
+{
+    mrp_domctl_value_t *col;
+    int                 r, c;
+
+    for (r = 0; r < nrow; r++) {
+        for (c = 0, col = rows[r]; c < ncol; c++, col++) {
+
+#define HANDLE_TYPE(pt, t, m)                                           \
+            case MRP_DOMCTL_##pt:                                       \
+                if (!mrp_msg_append(msg, MSG_##t(DATA, col->m)))        \
+                    return FALSE;                                       \
+                break
+
+            switch (col->type) {
+                HANDLE_TYPE(STRING  , STRING, str);
+                HANDLE_TYPE(INTEGER , SINT32, s32);
+                HANDLE_TYPE(UNSIGNED, UINT32, u32);
+                HANDLE_TYPE(DOUBLE  , DOUBLE, dbl);
+            default:
+                return FALSE;
+            }
+#undef HANDLE_TYPE
+        }
+    }
+
+    return TRUE;
+}
+
+
+static int decode_rows(mrp_msg_t *msg, void **it, mrp_domctl_value_t **rows,
+                       int nrow, int ncol, mrp_domctl_value_t **valuesp)
+{
+    mrp_domctl_value_t *v = *valuesp;
+    mrp_msg_value_t     value;
+    uint16_t            type;
+    int                 r, c;
+
+    for (r = 0; r < nrow; r++) {
+        rows[r] = v;
+
+        for (c = 0; c < ncol; c++) {
+            if (!mrp_msg_iterate_get(msg, it,
+                                     MSG_ANY(DATA, &type, &value),
+                                     MSG_END))
+                return FALSE;
+
+            switch (type) {
+            case MRP_MSG_FIELD_STRING:
+                v->type = MRP_DOMCTL_STRING;
+                v->str  = value.str;
+                break;
+            case MRP_MSG_FIELD_SINT32:
+                v->type = MRP_DOMCTL_INTEGER;
+                v->s32  = value.s32;
+                break;
+            case MRP_MSG_FIELD_UINT32:
+                v->type = MRP_DOMCTL_UNSIGNED;
+                v->u32  = value.u32;
+                break;
+            case MRP_MSG_FIELD_DOUBLE:
+                v->type = MRP_DOMCTL_DOUBLE;
+                v->dbl  = value.dbl;
+                break;
+            default:
+                return FALSE;
+            }
+
+            v++;
+        }
+    }
+
+    *valuesp = v;
+
+    return TRUE;
+}
+
+
 void msg_free_set(msg_t *msg)
 {
     set_msg_t *set = (set_msg_t *)msg;
@@ -352,9 +431,8 @@ void msg_free_set(msg_t *msg)
 mrp_msg_t *msg_encode_set(set_msg_t *set)
 {
     mrp_msg_t          *msg;
-    mrp_domctl_value_t *rows, *col;
     uint16_t            utable, utotal, tid, ncol, nrow;
-    int                 i, r, c;
+    int                 i;
 
     utable = set->ntable;
     utotal = 0;
@@ -378,29 +456,8 @@ mrp_msg_t *msg_encode_set(set_msg_t *set)
             !mrp_msg_append(msg, MSG_UINT16(NCOL , ncol)))
             goto fail;
 
-        for (r = 0; r < nrow; r++) {
-            rows = set->tables[i].rows[r];
-
-            for (c = 0; c < ncol; c++) {
-                col = rows + c;
-
-#define HANDLE_TYPE(pt, t, m)                                           \
-                case MRP_DOMCTL_##pt:                                   \
-                    if (!mrp_msg_append(msg, MSG_##t(DATA,col->m)))     \
-                        goto fail;                                      \
-                    break
-
-                switch (col->type) {
-                    HANDLE_TYPE(STRING  , STRING, str);
-                    HANDLE_TYPE(INTEGER , SINT32, s32);
-                    HANDLE_TYPE(UNSIGNED, UINT32, u32);
-                    HANDLE_TYPE(DOUBLE  , DOUBLE, dbl);
-                default:
-                    goto fail;
-                }
-#undef HANDLE_TYPE
-            }
-        }
+        if (!encode_rows(msg, set->tables[i].rows, nrow, ncol))
+            goto fail;
 
         utotal += nrow * ncol;
     }
@@ -423,9 +480,8 @@ msg_t *msg_decode_set(mrp_msg_t *msg)
     mrp_domctl_value_t *values, *v;
     uint64_t            columns_so_far;
     uint32_t            seqno;
-    uint16_t            ntable, ntotal, nrow, ncol, tblid, type;
-    int                 t, r, c;
-    mrp_msg_value_t     value;
+    uint16_t            ntable, ntotal, nrow, ncol, tblid;
+    int                 t;
 
     it = NULL;
     columns_so_far = 0;
@@ -481,39 +537,8 @@ msg_t *msg_decode_set(mrp_msg_t *msg)
         /* If we are not overflowing, add ncol to count */
         columns_so_far += nrow * ncol;
 
-        for (r = 0; r < nrow; r++) {
-            d->rows[r] = v;
-
-            for (c = 0; c < ncol; c++) {
-                if (!mrp_msg_iterate_get(msg, &it,
-                                         MSG_ANY(DATA, &type, &value),
-                                         MSG_END))
-                    goto fail;
-
-                switch (type) {
-                case MRP_MSG_FIELD_STRING:
-                    v->type = MRP_DOMCTL_STRING;
-                    v->str  = value.str;
-                    break;
-                case MRP_MSG_FIELD_SINT32:
-                    v->type = MRP_DOMCTL_INTEGER;
-                    v->s32  = value.s32;
-                    break;
-                case MRP_MSG_FIELD_UINT32:
-                    v->type = MRP_DOMCTL_UNSIGNED;
-                    v->u32  = value.u32;
-                    break;
-                case MRP_MSG_FIELD_DOUBLE:
-                    v->type = MRP_DOMCTL_DOUBLE;
-                    v->dbl  = value.dbl;
-                    break;
-                default:
-                    goto fail;
-                }
-
-                v++;
-            }
-        }
+        if (!decode_rows(msg, &it, d->rows, nrow, ncol, &v))
+            goto fail;
 
         d++;
     }
@@ -533,6 +558,152 @@ msg_t *msg_decode_set(mrp_msg_t *msg)
 }
 
 
+void msg_free_update(msg_t *msg)
+{
+    update_msg_t *update = (update_msg_t *)msg;
+    int           i;
+
+    if (update != NULL) {
+        for (i = 0; i < update->ntable && update->tables != NULL; i++) {
+            mrp_free(update->tables[i].rows);
+            mrp_free(update->tables[i].keys);
+        }
+
+        mrp_free(update->tables);
+        mrp_free(update->values);
+        unref_wire(msg);
+
+        mrp_free(update);
+    }
+}
+
+
+mrp_msg_t *msg_encode_update(update_msg_t *update)
+{
+    mrp_msg_t          *msg;
+    mrp_domctl_delta_t *d;
+    uint32_t            utotal;
+    int                 i;
+
+    utotal = 0;
+
+    msg = mrp_msg_create(MSG_UINT16(MSGTYPE, MSG_TYPE_UPDATE),
+                         MSG_UINT32(MSGSEQ , update->seq),
+                         MSG_UINT16(NCHANGE, update->ntable),
+                         MSG_UINT16(NTOTAL , 0),
+                         MSG_END);
+
+    if (msg == NULL)
+        return NULL;
+
+    for (i = 0, d = update->tables; i < update->ntable; i++, d++) {
+        if (!mrp_msg_append(msg, MSG_UINT16(TBLID, d->id))      ||
+            !mrp_msg_append(msg, MSG_UINT16(NROW , d->nrow))    ||
+            !mrp_msg_append(msg, MSG_UINT16(NCOL , d->ncolumn)) ||
+            !mrp_msg_append(msg, MSG_UINT16(NDEL , d->ndelete)) ||
+            !mrp_msg_append(msg, MSG_UINT16(NKEY , d->nkey)))
+            goto fail;
+
+        if (!encode_rows(msg, d->rows, d->nrow, d->ncolumn) ||
+            !encode_rows(msg, d->keys, d->ndelete, d->nkey))
+            goto fail;
+
+        utotal += d->nrow * d->ncolumn + d->ndelete * d->nkey;
+    }
+
+    if (utotal > UINT16_MAX)
+        goto fail;
+
+    mrp_msg_set(msg, MSG_UINT16(NTOTAL, utotal));
+
+    return msg;
+
+ fail:
+    mrp_msg_unref(msg);
+    return NULL;
+}
+
+
+msg_t *msg_decode_update(mrp_msg_t *msg)
+{
+    update_msg_t       *update;
+    void               *it;
+    mrp_domctl_delta_t *d;
+    mrp_domctl_value_t *v;
+    uint64_t            columns_so_far;
+    uint32_t            seqno;
+    uint16_t            ntable, ntotal, nrow, ncol, ndel, nkey, tblid;
+    int                 t;
+
+    it = NULL;
+    columns_so_far = 0;
+
+    if (!mrp_msg_iterate_get(msg, &it,
+                             MSG_UINT32(MSGSEQ , &seqno),
+                             MSG_UINT16(NCHANGE, &ntable),
+                             MSG_UINT16(NTOTAL , &ntotal),
+                             MSG_END))
+        return NULL;
+
+    update = mrp_allocz(sizeof(*update));
+
+    if (update == NULL)
+        return NULL;
+
+    update->type   = MSG_TYPE_UPDATE;
+    update->seq    = seqno;
+    update->tables = mrp_allocz_array(typeof(*update->tables), ntable);
+    update->values = mrp_allocz_array(typeof(*update->values), ntotal);
+
+    if ((update->tables == NULL && ntable) || (update->values == NULL && ntotal))
+        goto fail;
+
+    update->ntable = ntable;
+    v = update->values;
+
+    for (t = 0, d = update->tables; t < ntable; t++, d++) {
+        if (!mrp_msg_iterate_get(msg, &it,
+                                 MSG_UINT16(TBLID, &tblid),
+                                 MSG_UINT16(NROW , &nrow ),
+                                 MSG_UINT16(NCOL , &ncol ),
+                                 MSG_UINT16(NDEL , &ndel ),
+                                 MSG_UINT16(NKEY , &nkey ),
+                                 MSG_END))
+            goto fail;
+
+        d->id      = tblid;
+        d->ncolumn = ncol;
+        d->nrow    = nrow;
+        d->nkey    = nkey;
+        d->ndelete = ndel;
+        d->rows    = mrp_allocz_array(typeof(*d->rows), nrow);
+        d->keys    = mrp_allocz_array(typeof(*d->keys), ndel);
+
+        if ((d->rows == NULL && nrow) || (d->keys == NULL && ndel))
+            goto fail;
+
+        columns_so_far += nrow * ncol + ndel * nkey;
+
+        if (columns_so_far > ntotal)
+            goto fail;
+
+        if (!decode_rows(msg, &it, d->rows, nrow, ncol, &v) ||
+            !decode_rows(msg, &it, d->keys, ndel, nkey, &v))
+            goto fail;
+    }
+
+    update->wire       = mrp_msg_ref(msg);
+    update->unref_wire = msg_unref_wire;
+
+    return (msg_t *)update;
+
+ fail:
+    msg_free_update((msg_t *)update);
+
+    return NULL;
+}
+
+
 void msg_free_notify(msg_t *msg)
 {
     notify_msg_t *notify = (notify_msg_t *)msg;
@@ -697,9 +868,7 @@ msg_t *msg_decode_notify(mrp_msg_t *msg)
     uint32_t            seqno;
     uint16_t            ntable, ntotal, nrow, ncol;
     uint16_t            tblid;
-    int                 t, r, c;
-    uint16_t            type;
-    mrp_msg_value_t     value;
+    int                 t;
 
     it = NULL;
     columns_so_far = 0;
@@ -755,39 +924,8 @@ msg_t *msg_decode_notify(mrp_msg_t *msg)
         /* If we are not overflowing, add ncol to count */
         columns_so_far += nrow * ncol;
 
-        for (r = 0; r < nrow; r++) {
-            d->rows[r] = v;
-
-            for (c = 0; c < ncol; c++) {
-                if (!mrp_msg_iterate_get(msg, &it,
-                                         MSG_ANY(DATA, &type, &value),
-                                         MSG_END))
-                    goto fail;
-
-                switch (type) {
-                case MRP_MSG_FIELD_STRING:
-                    v->type = MRP_DOMCTL_STRING;
-                    v->str  = value.str;
-                    break;
-                case MRP_MSG_FIELD_SINT32:
-                    v->type = MRP_DOMCTL_INTEGER;
-                    v->s32  = value.s32;
-                    break;
-                case MRP_MSG_FIELD_UINT32:
-                    v->type = MRP_DOMCTL_UNSIGNED;
-                    v->u32  = value.u32;
-                    break;
-                case MRP_MSG_FIELD_DOUBLE:
-                    v->type = MRP_DOMCTL_DOUBLE;
-                    v->dbl  = value.dbl;
-                    break;
-                default:
-                    goto fail;
-                }
-
-                v++;
-            }
-        }
+        if (!decode_rows(msg, &it, d->rows, nrow, ncol, &v))
+            goto fail;
 
         d++;
     }
@@ -1144,6 +1282,7 @@ msg_t *msg_decode_message(mrp_msg_t *msg)
         case MSG_TYPE_REGISTER:   return msg_decode_register(msg);
         case MSG_TYPE_UNREGISTER: return msg_decode_unregister(msg);
         case MSG_TYPE_SET:        return msg_decode_set(msg);
+        case MSG_TYPE_UPDATE:     return msg_decode_update(msg);
         case MSG_TYPE_NOTIFY:     return msg_decode_notify(msg);
         case MSG_TYPE_ACK:        return msg_decode_ack(msg);
         case MSG_TYPE_NAK:        return msg_decode_nak(msg);
@@ -1163,6 +1302,7 @@ mrp_msg_t *msg_encode_message(msg_t *msg)
     case MSG_TYPE_REGISTER:   return msg_encode_register(&msg->reg);
     case MSG_TYPE_UNREGISTER: return msg_encode_unregister(&msg->unreg);
     case MSG_TYPE_SET:        return msg_encode_set(&msg->set);
+    case MSG_TYPE_UPDATE:     return msg_encode_update(&msg->update);
     case MSG_TYPE_NOTIFY:     return msg_encode_notify(&msg->notify);
     case MSG_TYPE_ACK:        return msg_encode_ack(&msg->ack);
     case MSG_TYPE_NAK:        return msg_encode_nak(&msg->nak);
@@ -1180,6 +1320,7 @@ void msg_free_message(msg_t *msg)
         case MSG_TYPE_REGISTER:   msg_free_register(msg);   break;
         case MSG_TYPE_UNREGISTER: msg_free_unregister(msg); break;
         case MSG_TYPE_SET:        msg_free_set(msg);        break;
+        case MSG_TYPE_UPDATE:     msg_free_update(msg);     break;
         case MSG_TYPE_NOTIFY:     msg_free_notify(msg);     break;
         case MSG_TYPE_ACK:        msg_free_ack(msg);        break;
         case MSG_TYPE_NAK:        msg_free_nak(msg);        break;
@@ -1536,6 +1677,150 @@ msg_t *json_decode_set(mrp_json_t *msg)
 }
 
 
+static int json_decode_rows(mrp_json_t *rows, mrp_domctl_value_t **dst,
+                            int nrow, int ncol, mrp_domctl_value_t **valuesp)
+{
+    mrp_domctl_value_t *v = *valuesp;
+    mrp_json_t         *row, *col;
+    int                 r, c;
+
+    for (r = 0; r < nrow; r++) {
+        if (!mrp_json_array_get_array(rows, r, &row))
+            return FALSE;
+
+        dst[r] = v;
+
+        for (c = 0; c < ncol; c++) {
+            col = mrp_json_array_get(row, c);
+
+            if (col == NULL)
+                return FALSE;
+
+            switch (mrp_json_get_type(col)) {
+            case MRP_JSON_STRING:
+                v->type = MRP_DOMCTL_STRING;
+                v->str  = mrp_json_string_value(col);
+                break;
+
+            case MRP_JSON_INTEGER:
+                v->type = MRP_DOMCTL_INTEGER;
+                v->s32  = mrp_json_integer_value(col);
+                break;
+
+            case MRP_JSON_BOOLEAN:
+                v->type = MRP_DOMCTL_INTEGER;
+                v->s32  = !!mrp_json_boolean_value(col);
+                break;
+
+            case MRP_JSON_DOUBLE:
+                v->type = MRP_DOMCTL_DOUBLE;
+                v->dbl  = mrp_json_double_value(col);
+                break;
+
+            default:
+                return FALSE;
+            }
+
+            v++;
+        }
+    }
+
+    *valuesp = v;
+
+    return TRUE;
+}
+
+
+msg_t *json_decode_update(mrp_json_t *msg)
+{
+    update_msg_t       *update;
+    mrp_domctl_delta_t *d;
+    mrp_domctl_value_t *v;
+    mrp_json_t         *tables, *tbl, *rows, *keys;
+    int                 seqno, ntable, ntotal, nrow, ncol, ndel, nkey, tblid;
+    int                 columns_so_far, t;
+
+    if (!mrp_json_get_integer(msg, "seq"    , &seqno)  ||
+        !mrp_json_get_integer(msg, "nchange", &ntable) ||
+        !mrp_json_get_integer(msg, "ntotal" , &ntotal) ||
+        ntable < 0 || ntotal < 0)
+        return NULL;
+
+    update = mrp_allocz(sizeof(*update));
+
+    if (update == NULL)
+        return NULL;
+
+    update->type   = MSG_TYPE_UPDATE;
+    update->seq    = seqno;
+    update->tables = mrp_allocz_array(typeof(*update->tables), ntable);
+    update->values = mrp_allocz_array(typeof(*update->values), ntotal);
+
+    if ((update->tables == NULL && ntable) || (update->values == NULL && ntotal))
+        goto fail;
+
+    update->ntable = ntable;
+    columns_so_far = 0;
+    v = update->values;
+
+    if (!mrp_json_get_array(msg, "tables", &tables))
+        goto fail;
+
+    for (t = 0, d = update->tables; t < ntable; t++, d++) {
+        if (!mrp_json_array_get_object(tables, t, &tbl))
+            goto fail;
+
+        if (!mrp_json_get_integer(tbl, "id"  , &tblid) ||
+            !mrp_json_get_integer(tbl, "nrow", &nrow)  ||
+            !mrp_json_get_integer(tbl, "ncol", &ncol)  ||
+            !mrp_json_get_integer(tbl, "ndel", &ndel)  ||
+            !mrp_json_get_integer(tbl, "nkey", &nkey))
+            goto fail;
+
+        if (nrow < 0 || ncol < 0 || ndel < 0 || nkey < 0)
+            goto fail;
+
+        columns_so_far += nrow * ncol + ndel * nkey;
+
+        if (columns_so_far > ntotal)
+            goto fail;
+
+        d->id      = tblid;
+        d->ncolumn = ncol;
+        d->nrow    = nrow;
+        d->nkey    = nkey;
+        d->ndelete = ndel;
+        d->rows    = mrp_allocz_array(typeof(*d->rows), nrow);
+        d->keys    = mrp_allocz_array(typeof(*d->keys), ndel);
+
+        if ((d->rows == NULL && nrow) || (d->keys == NULL && ndel))
+            goto fail;
+
+        if (nrow > 0) {
+            if (!mrp_json_get_array(tbl, "rows", &rows) ||
+                !json_decode_rows(rows, d->rows, nrow, ncol, &v))
+                goto fail;
+        }
+
+        if (ndel > 0) {
+            if (!mrp_json_get_array(tbl, "keys", &keys) ||
+                !json_decode_rows(keys, d->keys, ndel, nkey, &v))
+                goto fail;
+        }
+    }
+
+    update->wire       = mrp_json_ref(msg);
+    update->unref_wire = json_unref_wire;
+
+    return (msg_t *)update;
+
+ fail:
+    msg_free_update((msg_t *)update);
+
+    return NULL;
+}
+
+
 mrp_json_t *json_create_notify(void)
 {
     mrp_json_t *msg;
@@ -1655,6 +1940,7 @@ msg_t *json_decode_message(mrp_json_t *msg)
         if (!strcmp(type, "register"  )) return json_decode_register(msg);
         if (!strcmp(type, "unregister")) return json_decode_unregister(msg);
         if (!strcmp(type, "set"       )) return json_decode_set(msg);
+        if (!strcmp(type, "update"    )) return json_decode_update(msg);
     }
 
     return NULL;
@@ -46,6 +46,7 @@ typedef enum {
     MSG_TYPE_NAK,
     MSG_TYPE_INVOKE,
     MSG_TYPE_RETURN,
+    MSG_TYPE_UPDATE,
 } msg_type_t;
 
 typedef enum {
@@ -74,6 +75,8 @@ typedef enum {
     MSGTAG_NROW    = 0x6,            /* number of table rows */
     MSGTAG_NCOL    = 0x7,            /* number of columns in a row */
     MSGTAG_DATA    = 0x8,            /* a data column */
+    MSGTAG_NDEL    = 0x9,            /* number of rows to delete */
+    MSGTAG_NKEY    = 0xa,            /* number of key columns per deletion */
 
     /* fixed tags in invoke and return messages */
     MSGTAG_METHOD  = 0x3,            /* method name */
@@ -132,6 +135,14 @@ typedef struct {
 } set_msg_t;
 
 
+typedef struct {
+    COMMON_MSG_FIELDS;
+    mrp_domctl_delta_t *tables;          /* row deltas for tables */
+    int                 ntable;          /* number of tables */
+    mrp_domctl_value_t *values;          /* decoded values, if any */
+} update_msg_t;
+
+
 typedef struct {
     COMMON_MSG_FIELDS;
     mrp_domctl_data_t *tables;           /* data in changed tables */
@@ -179,6 +190,7 @@ union msg_u {
     register_msg_t   reg;
     unregister_msg_t unreg;
     set_msg_t        set;
+    update_msg_t     update;
     notify_msg_t     notify;
     ack_msg_t        ack;
     nak_msg_t        nak;
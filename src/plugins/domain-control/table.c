@@ -28,6 +28,8 @@
  */
 
 #include <errno.h>
+#include <string.h>
+#include <ctype.h>
 #include <stdarg.h>
 
 #include <murphy/common/debug.h>
@@ -66,6 +68,8 @@ static void table_change_cb(mqi_event_t *e, void *tptr)
         "table drop",
         "transaction start (?)",
         "transaction end (?)",
+        "row update",
+        "changeset",
     };
     pep_table_t *t = (pep_table_t *)tptr;
 
@@ -78,9 +82,7 @@ static void table_change_cb(mqi_event_t *e, void *tptr)
 
 static int add_table_triggers(pep_table_t *t)
 {
-    mdb_table_t      *tbl;
-    mqi_column_def_t  cols[256];
-    int               ncol, i;
+    mdb_table_t *tbl;
 
     if (t->h == MQI_HANDLE_INVALID) {
         errno = EAGAIN;
@@ -92,24 +94,13 @@ static int add_table_triggers(pep_table_t *t)
         return -1;
     }
 
-    if ((ncol = mdb_table_describe(tbl, &cols[0], sizeof(cols))) <= 0) {
+    /* we only need to know whether the table changed, not how */
+    if (mdb_trigger_add_changeset_callback(tbl, table_change_cb, t, NULL)) {
         errno = EINVAL;
         return -1;
     }
 
-    if (mdb_trigger_add_row_callback(tbl, table_change_cb, t, NULL)) {
-        errno = EINVAL;
-        return -1;
-    }
-
-    for (i = 0; i < ncol; i++) {
-        if (mdb_trigger_add_column_callback(tbl, i, table_change_cb,
-                                            t, NULL) < 0) {
-            mdb_trigger_delete_row_callback(tbl, table_change_cb, t);
-            errno = EINVAL;
-            return -1;
-        }
-    }
+    mqi_subscribe_table(t->h);
 
     return 0;
 }
@@ -117,9 +108,7 @@ static int add_table_triggers(pep_table_t *t)
 
 static void del_table_triggers(pep_table_t *t)
 {
-    mdb_table_t      *tbl;
-    mqi_column_def_t  cols[256];
-    int               ncol, i;
+    mdb_table_t *tbl;
 
     if (t->h == MQI_HANDLE_INVALID)
         return;
@@ -127,12 +116,8 @@ static void del_table_triggers(pep_table_t *t)
     if ((tbl = mdb_table_find(t->name)) == NULL)
         return;
 
-    ncol = mdb_table_describe(tbl, &cols[0], sizeof(cols));
-
-    mdb_trigger_delete_row_callback(tbl, table_change_cb, t);
-
-    for (i = 0; i < ncol; i++)
-        mdb_trigger_delete_column_callback(tbl, i, table_change_cb, t);
+    mqi_unsubscribe_table(t->h);
+    mdb_trigger_delete_changeset_callback(tbl, table_change_cb, t);
 }
 
 
@@ -341,6 +326,54 @@ static int get_table_description(pep_table_t *t)
 }
 
 
+static int get_table_keys(pep_table_t *t)
+{
+    const char *p, *e;
+    int         keys[MQI_COLUMN_MAX], nkey, len, i;
+
+    nkey = 0;
+    p    = t->mql_index ? t->mql_index : "";
+
+    while (*p) {
+        while (*p == ',' || isspace(*p))
+            p++;
+
+        if (!*p)
+            break;
+
+        for (e = p; *e && *e != ',' && !isspace(*e); e++)
+            ;
+
+        len = e - p;
+
+        for (i = 0; i < t->ncolumn; i++) {
+            if (!strncmp(t->columns[i].name, p, len) &&
+                !t->columns[i].name[len])
+                break;
+        }
+
+        if (i >= t->ncolumn || nkey >= (int)MRP_ARRAY_SIZE(keys))
+            return FALSE;
+
+        keys[nkey++] = i;
+        p = e;
+    }
+
+    if (nkey > 0) {
+        t->keys = mrp_allocz_array(typeof(*t->keys), nkey);
+
+        if (t->keys == NULL)
+            return FALSE;
+
+        memcpy(t->keys, keys, nkey * sizeof(*t->keys));
+    }
+
+    t->nkey = nkey;
+
+    return TRUE;
+}
+
+
 int create_proxy_table(pep_table_t *t, int *errcode, const char **errmsg)
 {
     mrp_list_init(&t->hook);
@@ -360,6 +393,9 @@ int create_proxy_table(pep_table_t *t, int *errcode, const char **errmsg)
         if (!get_table_description(t))
             FAIL(EINVAL, "DB error: failed to get table description");
 
+        if (!get_table_keys(t))
+            FAIL(EINVAL, "DB error: failed to resolve table index columns");
+
         return TRUE;
     }
     else
@@ -382,12 +418,15 @@ void destroy_proxy_table(pep_table_t *t)
 
     mrp_free(t->columns);
     mrp_free(t->coldesc);
+    mrp_free(t->keys);
     mrp_free(t->name);
 
     t->name    = NULL;
     t->h       = MQI_HANDLE_INVALID;
     t->columns = NULL;
     t->ncolumn = 0;
+    t->keys    = NULL;
+    t->nkey    = 0;
 }
 
 
@@ -579,21 +618,29 @@ static void reset_proxy_tables(pep_proxy_t *proxy)
 }
 
 
-static int insert_into_table(pep_table_t *t,
+static int insert_into_table(pep_table_t *t, int replace,
                              mrp_domctl_value_t **rows, int nrow)
 {
-    void *data[2];
-    int   i;
+    void **data;
+    int    n;
 
-    data[1] = NULL;
+    if (nrow <= 0)
+        return TRUE;
 
-    for (i = 0; i < nrow; i++) {
-        data[0] = rows[i];
-        if (mqi_insert_into(t->h, 0, t->coldesc, data) != 1)
-            return FALSE;
-    }
+    /* pass all rows to MQI in a single NULL-terminated batch */
+    data = mrp_alloc_array(void *, nrow + 1);
 
-    return TRUE;
+    if (data == NULL)
+        return FALSE;
+
+    memcpy(data, rows, nrow * sizeof(data[0]));
+    data[nrow] = NULL;
+
+    n = mqi_insert_into(t->h, replace ? 1 : 0, t->coldesc, data);
+
+    mrp_free(data);
+
+    return replace ? n >= 0 : n == nrow;
 }
 
 
@@ -625,7 +672,7 @@ int set_proxy_tables(pep_proxy_t *proxy, mrp_domctl_data_t *tables, int ntable,
                 goto fail;
 #endif
 
-            if (!insert_into_table(t, tables[i].rows, tables[i].nrow))
+            if (!insert_into_table(t, FALSE, tables[i].rows, tables[i].nrow))
                 goto fail;
 
 
@@ -643,3 +690,115 @@ int set_proxy_tables(pep_proxy_t *proxy, mrp_domctl_data_t *tables, int ntable,
 
     return FALSE;
 }
+
+
+static int delete_by_key(pep_table_t *t, mrp_domctl_value_t **keys, int nkey,
+                         int ndelete)
+{
+    mqi_cond_entry_t    cond[MQI_COND_MAX], *c;
+    mrp_domctl_value_t *v;
+    mqi_data_type_t     type;
+    int                 i, k;
+
+    if (nkey != t->nkey || 4 * nkey + 1 > (int)MRP_ARRAY_SIZE(cond))
+        return FALSE;
+
+    for (i = 0; i < ndelete; i++) {
+        c = cond;
+
+        for (k = 0, v = keys[i]; k < nkey; k++, v++) {
+            type = t->columns[t->keys[k]].type;
+
+            if (k > 0) {
+                c->type        = mqi_operator;
+                c->u.operator_ = mqi_and;
+                c++;
+            }
+
+            c->type     = mqi_column;
+            c->u.column = t->keys[k];
+            c++;
+
+            c->type        = mqi_operator;
+            c->u.operator_ = mqi_eq;
+            c++;
+
+            c->type                 = mqi_variable;
+            c->u.variable.type      = type;
+            c->u.variable.flags     = 0;
+            c->u.variable.v.generic = &v->str;
+
+            switch (type) {
+            case mqi_varchar:
+                if (v->type != MRP_DOMCTL_STRING)
+                    return FALSE;
+                break;
+            case mqi_integer:
+            case mqi_unsignd:
+                if (v->type != MRP_DOMCTL_INTEGER &&
+                    v->type != MRP_DOMCTL_UNSIGNED)
+                    return FALSE;
+                break;
+            case mqi_floating:
+                if (v->type != MRP_DOMCTL_DOUBLE)
+                    return FALSE;
+                break;
+            default:
+                return FALSE;
+            }
+            c++;
+        }
+
+        c->type        = mqi_operator;
+        c->u.operator_ = mqi_end;
+
+        if (mqi_delete_from(t->h, cond) < 0)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+int update_proxy_tables(pep_proxy_t *proxy, mrp_domctl_delta_t *deltas,
+                        int ndelta, int *errcode, const char **errmsg)
+{
+    mqi_handle_t        tx;
+    pep_table_t        *t;
+    mrp_domctl_delta_t *d;
+    int                 i;
+
+    tx = mqi_begin_transaction();
+
+    if (tx == MQI_HANDLE_INVALID)
+        FAIL(EIO, "DB error: failed to begin transaction");
+
+    for (i = 0, d = deltas; i < ndelta; i++, d++) {
+        if (d->id < 0 || d->id >= proxy->ntable)
+            FAIL(EINVAL, "invalid table id");
+
+        t = proxy->tables + d->id;
+
+        if (t->nkey <= 0)
+            FAIL(EINVAL, "table has no index for row updates");
+
+        if (d->nrow > 0 && d->ncolumn != t->ncolumn)
+            FAIL(EINVAL, "column count mismatch");
+
+        if (!delete_by_key(t, d->keys, d->nkey, d->ndelete))
+            FAIL(EINVAL, "failed to delete rows");
+
+        if (!insert_into_table(t, TRUE, d->rows, d->nrow))
+            FAIL(EINVAL, "failed to insert or replace rows");
+    }
+
+    mqi_commit_transaction(tx);
+
+    return TRUE;
+
+ fail:
+    if (tx != MQI_HANDLE_INVALID)
+        mqi_rollback_transaction(tx);
+
+    return FALSE;
+}
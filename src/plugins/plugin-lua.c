@@ -36,6 +36,7 @@
 #include <murphy/common/macros.h>
 #include <murphy/core/plugin.h>
 #include <murphy/core/lua-bindings/murphy.h>
+#include <murphy/core/lua-utils/bytecode.h>
 
 #define LUAR_INTERPRETER_NAME "lua"
 
@@ -43,6 +44,7 @@
 enum {
     ARG_CONFIG,                          /* configuration file */
     ARG_RESOLVER,                        /* enable resolver lua support */
+    ARG_BYTECODE_CACHE,                  /* compiled Lua cache directory */
 };
 
 
@@ -50,7 +52,7 @@ static int load_config(lua_State *L, const char *path)
 {
     int success;
 
-    if (!luaL_loadfile(L, path) && !lua_pcall(L, 0, 0, 0))
+    if (!mrp_lua_load_file(L, path) && !lua_pcall(L, 0, 0, 0))
         success = TRUE;
     else {
         mrp_log_error("plugin-lua: failed to load config file %s.", path);
@@ -147,6 +149,7 @@ static int plugin_init(mrp_plugin_t *plugin)
     mrp_plugin_arg_t *args = plugin->args;
     const char       *cfg  = args[ARG_CONFIG].str;
     int               res  = args[ARG_RESOLVER].bln;
+    const char       *bcc  = args[ARG_BYTECODE_CACHE].str;
     lua_State        *L;
 
     L = mrp_lua_set_murphy_context(plugin->ctx);
@@ -165,6 +168,7 @@ static int plugin_init(mrp_plugin_t *plugin)
             mrp_log_info("plugin-lua: resolver Lua support disabled.");
 
         mrp_lua_set_murphy_lua_config_file(cfg);
+        mrp_lua_set_bytecode_cache(bcc);
 
         if (load_config(L, cfg))
             return TRUE;
@@ -192,10 +196,13 @@ static void plugin_exit(mrp_plugin_t *plugin)
 #define PLUGIN_VERSION     MRP_VERSION_INT(0, 0, 1)
 
 #define DEFAULT_CONFIG  "/etc/murphy/murphy.lua"
+#define DEFAULT_BCCACHE "/var/cache/murphy/lua"
 
 static mrp_plugin_arg_t plugin_args[] = {
     MRP_PLUGIN_ARGIDX(ARG_CONFIG  , STRING,  "config",  DEFAULT_CONFIG),
     MRP_PLUGIN_ARGIDX(ARG_RESOLVER, BOOL  , "resolver",TRUE),
+    MRP_PLUGIN_ARGIDX(ARG_BYTECODE_CACHE, STRING, "bytecode_cache",
+                      DEFAULT_BCCACHE),
 };
 
 MURPHY_REGISTER_PLUGIN("lua",
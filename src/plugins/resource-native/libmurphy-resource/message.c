@@ -449,69 +449,251 @@ error:
 }
 
 
-int acquire_resource_set_request(mrp_res_context_t *cx,
+static int reset_batch_seqno(void *key, void *object, void *user_data)
+{
+    mrp_res_resource_set_t *rset = object;
+    uint32_t *seqno = user_data;
+
+    MRP_UNUSED(key);
+
+    if (rset->priv->seqno == *seqno)
+        rset->priv->seqno = 0;
+
+    return MRP_HTBL_ITER_MORE;
+}
+
+
+static void report_lost_set(mrp_res_context_t *cx,
         mrp_res_resource_set_t *rset)
 {
-    mrp_msg_t *msg = NULL;
+    uint32_t i;
+
+    for (i = 0; i < rset->priv->num_resources; i++)
+        rset->priv->resources[i]->state = MRP_RES_RESOURCE_LOST;
+
+    rset->state = MRP_RES_RESOURCE_LOST;
+
+    if (rset->priv->cb) {
+        increase_ref(cx, rset);
+        rset->priv->cb(cx, rset, rset->priv->user_data);
+        decrease_ref(cx, rset);
+    }
+}
+
+
+void forget_batch(mrp_res_context_t *cx, uint32_t seqno, bool report)
+{
+    mrp_res_resource_set_private_t *priv;
+    mrp_list_hook_t *p, *n;
+    mrp_list_hook_t lost;
+
+    mrp_list_init(&lost);
+
+    /* the sets to be created by the batch are still unknown to the server */
+    mrp_list_foreach(&cx->priv->pending_sets, p, n) {
+        priv = mrp_list_entry(p, typeof(*priv), hook);
+
+        if (priv->seqno == seqno) {
+            mrp_list_delete(&priv->hook);
+            priv->seqno = 0;
+
+            if (report)
+                mrp_list_append(&lost, &priv->hook);
+        }
+    }
+
+    mrp_htbl_foreach(cx->priv->rset_mapping, reset_batch_seqno, &seqno);
+
+    /*
+     * Tell the application that these sets did not get any resources.
+     * They are left without a server id, so acquiring or releasing them
+     * again tries to create them anew. The callbacks may delete sets, so
+     * take them off the list one by one.
+     */
+    while (!mrp_list_empty(&lost)) {
+        priv = mrp_list_entry(lost.next, typeof(*priv), hook);
+        mrp_list_delete(&priv->hook);
+
+        report_lost_set(cx, priv->pub);
+    }
+}
+
+
+bool batch_response(mrp_msg_t *msg, mrp_res_context_t *cx, uint32_t seqno,
+        void **pcursor)
+{
+    int status, req_status;
+    uint16_t req;
+    uint32_t rset_id;
+    mrp_res_resource_set_t *rset;
+    mrp_res_resource_set_private_t *priv;
+    mrp_list_hook_t *p, *n;
+
+    if (!fetch_status(msg, pcursor, &status))
+        goto malformed;
+
+    while (fetch_request(msg, pcursor, &req)) {
+        if (!fetch_status(msg, pcursor, &req_status) ||
+            !fetch_resource_set_id(msg, pcursor, &rset_id))
+            goto malformed;
+
+        rset = NULL;
+
+        if (req == RESPROTO_CREATE_RESOURCE_SET) {
+            /* none of the sets got created, forget_batch reports them */
+            if (status != 0)
+                continue;
+
+            /* the new sets were queued in the order of their requests */
+            mrp_list_foreach(&cx->priv->pending_sets, p, n) {
+                priv = mrp_list_entry(p, typeof(*priv), hook);
+
+                if (priv->seqno == seqno) {
+                    rset = priv->pub;
+                    break;
+                }
+            }
+
+            if (rset) {
+                mrp_list_delete(&rset->priv->hook);
+
+                rset->priv->id = rset_id;
+                mrp_htbl_insert(cx->priv->rset_mapping,
+                        u_to_p(rset->priv->id), rset);
+            }
+        }
+        else if (req != RESPROTO_DESTROY_RESOURCE_SET)
+            rset = mrp_htbl_lookup(cx->priv->rset_mapping, u_to_p(rset_id));
+
+        if (req_status)
+            mrp_res_error("batched request %u failed. error code %u",
+                    req, req_status);
+
+        if (rset)
+            rset->priv->seqno = 0;
+    }
+
+    if (status) {
+        mrp_res_error("batch of requests failed. error code %u", status);
+
+        /* nothing was applied, forget about the rest of the batch too */
+        forget_batch(cx, seqno, true);
+
+        return false;
+    }
+
+    return true;
+
+ malformed:
+    mrp_res_error("ignoring malformed response to a batch of requests");
+    return false;
+}
+
+
+static mrp_msg_t *start_request(mrp_res_context_t *cx,
+        mrp_res_resource_set_t *rset, uint16_t req)
+{
+    mrp_msg_t *msg;
 
     if (!cx->priv->connected)
-        return -1;
+        return NULL;
+
+    if ((msg = cx->priv->batch) != NULL) {
+        /* queue the request to the batch being collected */
+
+        if (cx->priv->batch_size >= RESPROTO_BATCH_MAX ||
+            !mrp_msg_append(msg, RESPROTO_REQUEST_TYPE, MRP_MSG_FIELD_UINT16,
+                    req)) {
+            cx->priv->batch_failed = TRUE;
+            return NULL;
+        }
+
+        cx->priv->batch_size++;
+        rset->priv->seqno = cx->priv->batch_seqno;
+
+        return msg;
+    }
 
     msg = mrp_msg_create(
             RESPROTO_SEQUENCE_NO, MRP_MSG_FIELD_UINT32, cx->priv->next_seqno,
-            RESPROTO_REQUEST_TYPE, MRP_MSG_FIELD_UINT16,
-                    RESPROTO_ACQUIRE_RESOURCE_SET,
-            RESPROTO_RESOURCE_SET_ID, MRP_MSG_FIELD_UINT32, rset->priv->id,
+            RESPROTO_REQUEST_TYPE, MRP_MSG_FIELD_UINT16, req,
             RESPROTO_MESSAGE_END);
 
     if (!msg)
-        return -1;
+        return NULL;
 
     rset->priv->seqno = cx->priv->next_seqno;
     cx->priv->next_seqno++;
 
-    if (!mrp_transport_send(cx->priv->transp, msg))
-        goto error;
+    return msg;
+}
+
+
+static int send_request(mrp_res_context_t *cx, mrp_msg_t *msg)
+{
+    if (msg == cx->priv->batch)
+        return 0;
+
+    if (!mrp_transport_send(cx->priv->transp, msg)) {
+        mrp_msg_unref(msg);
+        return -1;
+    }
 
     mrp_msg_unref(msg);
     return 0;
+}
+
+
+static int fail_request(mrp_res_context_t *cx, mrp_msg_t *msg)
+{
+    /* a half-written request ruins the whole batch */
+    if (msg == cx->priv->batch)
+        cx->priv->batch_failed = TRUE;
+    else
+        mrp_msg_unref(msg);
 
-error:
-    mrp_msg_unref(msg);
     return -1;
 }
 
 
-int release_resource_set_request(mrp_res_context_t *cx,
-        mrp_res_resource_set_t *rset)
+static int rset_id_request(mrp_res_context_t *cx,
+        mrp_res_resource_set_t *rset, uint16_t req)
 {
-    mrp_msg_t *msg = NULL;
+    mrp_msg_t *msg = start_request(cx, rset, req);
 
-    if (!cx->priv->connected)
+    if (!msg)
         return -1;
 
-    msg = mrp_msg_create(
-            RESPROTO_SEQUENCE_NO, MRP_MSG_FIELD_UINT32, cx->priv->next_seqno,
-            RESPROTO_REQUEST_TYPE, MRP_MSG_FIELD_UINT16,
-                    RESPROTO_RELEASE_RESOURCE_SET,
-            RESPROTO_RESOURCE_SET_ID, MRP_MSG_FIELD_UINT32, rset->priv->id,
-            RESPROTO_MESSAGE_END);
+    if (!mrp_msg_append(msg, RESPROTO_RESOURCE_SET_ID, MRP_MSG_FIELD_UINT32,
+            rset->priv->id))
+        return fail_request(cx, msg);
 
-    if (!msg)
-        return -1;
+    return send_request(cx, msg);
+}
 
-    rset->priv->seqno = cx->priv->next_seqno;
-    cx->priv->next_seqno++;
 
-    if (!mrp_transport_send(cx->priv->transp, msg))
-        goto error;
+int acquire_resource_set_request(mrp_res_context_t *cx,
+        mrp_res_resource_set_t *rset)
+{
+    return rset_id_request(cx, rset, RESPROTO_ACQUIRE_RESOURCE_SET);
+}
 
-    mrp_msg_unref(msg);
-    return 0;
 
-error:
-    mrp_msg_unref(msg);
-    return -1;
+int release_resource_set_request(mrp_res_context_t *cx,
+        mrp_res_resource_set_t *rset)
+{
+    return rset_id_request(cx, rset, RESPROTO_RELEASE_RESOURCE_SET);
+}
+
+
+int destroy_resource_set_request(mrp_res_context_t *cx,
+        mrp_res_resource_set_t *rset)
+{
+    /* a set still waiting for its id is unknown to the server */
+    if (cx->priv->batch && !rset->priv->id)
+        return 0;
+
+    return rset_id_request(cx, rset, RESPROTO_DESTROY_RESOURCE_SET);
 }
 
 
@@ -525,27 +707,31 @@ int create_resource_set_request(mrp_res_context_t *cx,
     if (!cx || !rset)
         return -1;
 
-    if (!cx->priv->connected)
-        return -1;
-
     if (rset->priv->autorelease)
         rset_flags |= RESPROTO_RSETFLAG_AUTORELEASE;
 
-    msg = mrp_msg_create(
-            RESPROTO_SEQUENCE_NO, MRP_MSG_FIELD_UINT32, cx->priv->next_seqno,
-            RESPROTO_REQUEST_TYPE, MRP_MSG_FIELD_UINT16,
-                    RESPROTO_CREATE_RESOURCE_SET,
-            RESPROTO_RESOURCE_FLAGS, MRP_MSG_FIELD_UINT32, rset_flags,
-            RESPROTO_RESOURCE_PRIORITY, MRP_MSG_FIELD_UINT32, 0,
-            RESPROTO_CLASS_NAME, MRP_MSG_FIELD_STRING, rset->application_class,
-            RESPROTO_ZONE_NAME, MRP_MSG_FIELD_STRING, cx->zone,
-            RESPROTO_MESSAGE_END);
+    if (cx->priv->batch) {
+        /* no round trip for the pending operation, do it on creation */
+        if (rset->priv->waiting_for == MRP_RES_PENDING_OPERATION_ACQUIRE)
+            rset_flags |= RESPROTO_RSETFLAG_AUTOACQUIRE;
+
+        rset->priv->waiting_for = MRP_RES_PENDING_OPERATION_NONE;
+    }
+
+    msg = start_request(cx, rset, RESPROTO_CREATE_RESOURCE_SET);
 
     if (!msg)
         return -1;
 
-    rset->priv->seqno = cx->priv->next_seqno;
-    cx->priv->next_seqno++;
+    if (!mrp_msg_append(msg, RESPROTO_RESOURCE_FLAGS, MRP_MSG_FIELD_UINT32,
+                rset_flags) ||
+        !mrp_msg_append(msg, RESPROTO_RESOURCE_PRIORITY, MRP_MSG_FIELD_UINT32,
+                0) ||
+        !mrp_msg_append(msg, RESPROTO_CLASS_NAME, MRP_MSG_FIELD_STRING,
+                rset->application_class) ||
+        !mrp_msg_append(msg, RESPROTO_ZONE_NAME, MRP_MSG_FIELD_STRING,
+                cx->zone))
+        goto error;
 
     for (i = 0; i < rset->priv->num_resources; i++) {
         int j;
@@ -607,6 +793,32 @@ int create_resource_set_request(mrp_res_context_t *cx,
             goto error;
     }
 
+    /* in a batch the end of the resource list needs to be marked */
+    if (msg == cx->priv->batch &&
+        !mrp_msg_append(msg, RESPROTO_SECTION_END, MRP_MSG_FIELD_UINT8, 0))
+        goto error;
+
+    return send_request(cx, msg);
+
+error:
+    return fail_request(cx, msg);
+}
+
+
+int get_application_classes_request(mrp_res_context_t *cx)
+{
+    mrp_msg_t *msg = NULL;
+
+    if (!cx->priv->connected)
+        goto error;
+
+    msg = mrp_msg_create(RESPROTO_SEQUENCE_NO, MRP_MSG_FIELD_UINT32, 0,
+            RESPROTO_REQUEST_TYPE, MRP_MSG_FIELD_UINT16, RESPROTO_QUERY_CLASSES,
+            RESPROTO_MESSAGE_END);
+
+    if (!msg)
+        goto error;
+
     if (!mrp_transport_send(cx->priv->transp, msg))
         goto error;
 
@@ -619,7 +831,7 @@ error:
 }
 
 
-int get_application_classes_request(mrp_res_context_t *cx)
+int get_available_resources_request(mrp_res_context_t *cx)
 {
     mrp_msg_t *msg = NULL;
 
@@ -627,7 +839,8 @@ int get_application_classes_request(mrp_res_context_t *cx)
         goto error;
 
     msg = mrp_msg_create(RESPROTO_SEQUENCE_NO, MRP_MSG_FIELD_UINT32, 0,
-            RESPROTO_REQUEST_TYPE, MRP_MSG_FIELD_UINT16, RESPROTO_QUERY_CLASSES,
+            RESPROTO_REQUEST_TYPE, MRP_MSG_FIELD_UINT16,
+                    RESPROTO_QUERY_RESOURCES,
             RESPROTO_MESSAGE_END);
 
     if (!msg)
@@ -645,7 +858,7 @@ error:
 }
 
 
-int get_available_resources_request(mrp_res_context_t *cx)
+int set_capabilities_request(mrp_res_context_t *cx)
 {
     mrp_msg_t *msg = NULL;
 
@@ -654,7 +867,9 @@ int get_available_resources_request(mrp_res_context_t *cx)
 
     msg = mrp_msg_create(RESPROTO_SEQUENCE_NO, MRP_MSG_FIELD_UINT32, 0,
             RESPROTO_REQUEST_TYPE, MRP_MSG_FIELD_UINT16,
-                    RESPROTO_QUERY_RESOURCES,
+                    RESPROTO_SET_CAPABILITIES,
+            RESPROTO_CAPABILITIES, MRP_MSG_FIELD_UINT32,
+                    RESPROTO_CAPFLAG_MULTI_EVENT,
             RESPROTO_MESSAGE_END);
 
     if (!msg)
@@ -74,6 +74,11 @@ bool create_resource_set_response(mrp_msg_t *msg,
 mrp_res_resource_set_t *acquire_resource_set_response(mrp_msg_t *msg,
             mrp_res_context_t *cx, void **pcursor);
 
+void forget_batch(mrp_res_context_t *cx, uint32_t seqno, bool report);
+
+bool batch_response(mrp_msg_t *msg, mrp_res_context_t *cx, uint32_t seqno,
+        void **pcursor);
+
 /* requests to the server */
 
 int acquire_resource_set_request(mrp_res_context_t *cx,
@@ -85,8 +90,13 @@ int release_resource_set_request(mrp_res_context_t *cx,
 int create_resource_set_request(mrp_res_context_t *cx,
         mrp_res_resource_set_t *rset);
 
+int destroy_resource_set_request(mrp_res_context_t *cx,
+        mrp_res_resource_set_t *rset);
+
 int get_application_classes_request(mrp_res_context_t *cx);
 
 int get_available_resources_request(mrp_res_context_t *cx);
 
+int set_capabilities_request(mrp_res_context_t *cx);
+
 #endif
@@ -283,6 +283,32 @@ int mrp_res_acquire_resource_set(const mrp_res_resource_set_t *rs);
  */
 int mrp_res_release_resource_set(mrp_res_resource_set_t *rs);
 
+/**
+ * Start collecting resource set requests into a batch. Until
+ * mrp_res_end_batch is called, acquiring, releasing and deleting
+ * resource sets does not send anything to the server. The requests
+ * are queued up in the batch instead.
+ *
+ * @param cx murphy connection context.
+ *
+ * @return murphy error code.
+ */
+int mrp_res_begin_batch(mrp_res_context_t *cx);
+
+/**
+ * Send the requests collected since mrp_res_begin_batch to the server
+ * in a single message. The server applies either all of them or none
+ * of them. The resources are arbitrated only once for the whole batch,
+ * and the resource callbacks are called only after that. If the server
+ * rejects the batch, the resource sets it would have created are
+ * reported lost through their callbacks.
+ *
+ * @param cx murphy connection context.
+ *
+ * @return murphy error code.
+ */
+int mrp_res_end_batch(mrp_res_context_t *cx);
+
 
 /**
  * Get a resource set unique server-side id. The id information is
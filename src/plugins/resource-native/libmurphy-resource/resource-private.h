@@ -130,6 +130,12 @@ struct mrp_res_context_private_s {
     uint32_t next_internal_id;
 
     mrp_list_hook_t pending_sets;
+
+    /* requests collected between mrp_res_begin_batch and mrp_res_end_batch */
+    mrp_msg_t *batch;
+    uint32_t batch_seqno;
+    uint32_t batch_size;
+    bool batch_failed;
 };
 
 uint32_t p_to_u(const void *p);
@@ -83,7 +83,7 @@ uint32_t int_hash(const void *key)
 }
 
 
-static void resource_event(mrp_msg_t *msg,
+static bool resource_event(mrp_msg_t *msg,
         mrp_res_context_t *cx,
         int32_t seqno,
         void **pcursor)
@@ -110,45 +110,52 @@ static void resource_event(mrp_msg_t *msg,
         !fetch_resource_set_mask(msg, pcursor, 0, &grant) ||
         !fetch_resource_set_mask(msg, pcursor, 1, &advice)) {
         mrp_res_error("failed to fetch data from message");
-        goto ignore;
+        goto malformed;
     }
 
     /* Update our "master copy" of the resource set. */
 
     rset = mrp_htbl_lookup(cx->priv->rset_mapping, u_to_p(rset_id));
 
-    if (!rset) {
+    if (!rset)
         mrp_res_info("resource event outside the resource set lifecycle");
-        goto ignore;
-    }
+
+    /* The resources are parsed even for unknown sets, so that the next
+     * event can be found in a message with several events. */
 
     while (mrp_msg_iterate(msg, pcursor, &tag, &type, &value, &size)) {
 
         mrp_res_resource_t *res = NULL;
 
+        if (tag == RESPROTO_SECTION_END && type == MRP_MSG_FIELD_UINT8)
+            break;
+
         if ((tag != RESPROTO_RESOURCE_ID || type != MRP_MSG_FIELD_UINT32) ||
                 !fetch_resource_name(msg, pcursor, &resnam)) {
             mrp_res_error("failed to read resource from message");
-            goto ignore;
+            goto malformed;
         }
 
+        resid = value.u32;
+
+        if (!fetch_attribute_array(msg, pcursor, ATTRIBUTE_MAX + 1, attrs,
+                &n_attrs)) {
+            mrp_res_error("failed to read attributes from message");
+            goto malformed;
+        }
+
+        if (!rset)
+            continue;
+
         res = get_resource_by_name(rset, resnam);
 
         if (!res) {
             mrp_res_error("resource doesn't exist in resource set");
-            goto ignore;
+            continue;
         }
 
-        resid = value.u32;
-
         mrp_res_info("data for '%s': %d", res->name, resid);
 
-        if (!fetch_attribute_array(msg, pcursor, ATTRIBUTE_MAX + 1, attrs,
-                &n_attrs)) {
-            mrp_res_error("failed to read attributes from message");
-            goto ignore;
-        }
-
         /* copy the attributes */
         for (i = 0; (int) i < n_attrs; i++) {
             mrp_res_attribute_t *src = &attrs[i];
@@ -182,6 +189,9 @@ static void resource_event(mrp_msg_t *msg,
         }
     }
 
+    if (!rset)
+        goto ignore;
+
     /* go through all resources and see if they have been modified */
 
     for (i = 0; i < rset->priv->num_resources; i++)
@@ -231,10 +241,15 @@ static void resource_event(mrp_msg_t *msg,
         }
     }
 
-    return;
+    return true;
 
  ignore:
     mrp_res_info("ignoring resource event");
+    return true;
+
+ malformed:
+    mrp_res_info("ignoring malformed resource event");
+    return false;
 }
 
 
@@ -362,11 +377,28 @@ static void recvfrom_msg(mrp_transport_t *transp, mrp_msg_t *msg,
 
             break;
         }
+        case RESPROTO_BATCH_REQUEST:
+            mrp_res_info("received BATCH_REQUEST response");
+
+            if (!batch_response(msg, cx, seqno, &cursor))
+                goto error;
+            break;
         case RESPROTO_RESOURCES_EVENT:
             mrp_res_info("received RESOURCES_EVENT response");
 
             resource_event(msg, cx, seqno, &cursor);
             break;
+        case RESPROTO_MULTI_RESOURCES_EVENT:
+            mrp_res_info("received MULTI_RESOURCES_EVENT response");
+
+            while (fetch_seqno(msg, &cursor, &seqno)) {
+                if (!resource_event(msg, cx, seqno, &cursor))
+                    break;
+            }
+            break;
+        case RESPROTO_SET_CAPABILITIES:
+            mrp_res_info("received SET_CAPABILITIES response");
+            break;
         case RESPROTO_DESTROY_RESOURCE_SET:
             mrp_res_info("received DESTROY_RESOURCE_SET response");
             /* TODO? */
@@ -422,6 +454,8 @@ static void destroy_context(mrp_res_context_t *cx)
         if (cx->priv->transp)
             mrp_transport_destroy(cx->priv->transp);
 
+        mrp_msg_unref(cx->priv->batch);
+
         delete_resource_set(cx->priv->master_resource_set);
 
         /* FIXME: is this the way we want to free all resources and
@@ -530,6 +564,11 @@ mrp_res_context_t *mrp_res_create(mrp_mainloop_t *ml,
         goto error;
     }
 
+    /* servers not knowing about capabilities just ignore this */
+    if (set_capabilities_request(cx) < 0) {
+        goto error;
+    }
+
     /* TODO: this needs to be gotten from an environment variable */
     cx->zone = "driver";
 
@@ -550,3 +589,54 @@ void mrp_res_destroy(mrp_res_context_t *cx)
 {
     destroy_context(cx);
 }
+
+
+int mrp_res_begin_batch(mrp_res_context_t *cx)
+{
+    if (!cx || !cx->priv->connected || cx->priv->batch)
+        return -1;
+
+    cx->priv->batch = mrp_msg_create(
+            RESPROTO_SEQUENCE_NO, MRP_MSG_FIELD_UINT32, cx->priv->next_seqno,
+            RESPROTO_REQUEST_TYPE, MRP_MSG_FIELD_UINT16,
+                    RESPROTO_BATCH_REQUEST,
+            RESPROTO_MESSAGE_END);
+
+    if (!cx->priv->batch)
+        return -1;
+
+    cx->priv->batch_seqno = cx->priv->next_seqno++;
+    cx->priv->batch_size = 0;
+    cx->priv->batch_failed = FALSE;
+
+    return 0;
+}
+
+
+int mrp_res_end_batch(mrp_res_context_t *cx)
+{
+    mrp_msg_t *msg;
+    int ret = 0;
+
+    if (!cx || !(msg = cx->priv->batch))
+        return -1;
+
+    cx->priv->batch = NULL;
+
+    if (cx->priv->batch_failed) {
+        mrp_res_error("discarding a broken batch of requests");
+        ret = -1;
+    }
+    else if (cx->priv->batch_size > 0) {
+        if (!cx->priv->connected ||
+                !mrp_transport_send(cx->priv->transp, msg))
+            ret = -1;
+    }
+
+    mrp_msg_unref(msg);
+
+    if (ret < 0)
+        forget_batch(cx, cx->priv->batch_seqno, false);
+
+    return ret;
+}
@@ -92,38 +92,6 @@ void increase_ref(mrp_res_context_t *cx,
 }
 
 
-static int destroy_resource_set_request(mrp_res_context_t *cx,
-        mrp_res_resource_set_t *rset)
-{
-    mrp_msg_t *msg = NULL;
-
-    if (!cx->priv->connected)
-        goto error;
-
-    rset->priv->seqno = cx->priv->next_seqno;
-
-    msg = mrp_msg_create(
-            RESPROTO_SEQUENCE_NO, MRP_MSG_FIELD_UINT32, cx->priv->next_seqno++,
-            RESPROTO_REQUEST_TYPE, MRP_MSG_FIELD_UINT16,
-                    RESPROTO_DESTROY_RESOURCE_SET,
-            RESPROTO_RESOURCE_SET_ID, MRP_MSG_FIELD_UINT32, rset->priv->id,
-            RESPROTO_MESSAGE_END);
-
-    if (!msg)
-        goto error;
-
-    if (!mrp_transport_send(cx->priv->transp, msg))
-        goto error;
-
-    mrp_msg_unref(msg);
-    return 0;
-
-error:
-    mrp_msg_unref(msg);
-    return -1;
-}
-
-
 void decrease_ref(mrp_res_context_t *cx,
         mrp_res_resource_set_t *rset)
 {
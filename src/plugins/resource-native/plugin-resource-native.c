@@ -90,6 +90,9 @@ typedef struct {
     uint32_t               id;
     mrp_resource_client_t *rscli;
     mrp_transport_t       *transp;
+    uint32_t               caps;
+    mrp_msg_t             *events;
+    mrp_deferred_t        *flush;
 } client_t;
 
 
@@ -100,6 +103,8 @@ static void print_owners_cb(mrp_console_t *, void *, int, char **argv);
 static void print_resources_cb(mrp_console_t *, void *, int, char **argv);
 
 static void resource_event_handler(uint32_t, mrp_resource_set_t *, void *);
+static void flush_events(client_t *);
+static void flush_events_cb(mrp_deferred_t *, void *);
 
 
 MRP_CONSOLE_GROUP(resource_group, "resource", NULL, NULL, {
@@ -556,6 +561,9 @@ static int read_resource(mrp_resource_set_t *rset, mrp_msg_t *req,void **pcurs)
     if (!mrp_msg_iterate(req, pcurs, &tag, &type, &value, &size))
         return RESOURCE_LAST;
 
+    if (tag == RESPROTO_SECTION_END)
+        return RESOURCE_LAST;
+
     if (tag != RESPROTO_RESOURCE_NAME || type != MRP_MSG_FIELD_STRING)
         return RESOURCE_ERROR;
 
@@ -589,15 +597,38 @@ static int read_resource(mrp_resource_set_t *rset, mrp_msg_t *req,void **pcurs)
 }
 
 
-static void create_resource_set_request(client_t *client, mrp_msg_t *req,
-                                        uint32_t seqno, void **pcurs)
+static bool class_and_zone_exist(const char *class, const char *zone)
 {
-    static uint16_t reqtyp = RESPROTO_CREATE_RESOURCE_SET;
+    const char **names;
+    bool         found;
+    int          i;
 
-    resource_data_t        *data   = client->data;
-    mrp_plugin_t           *plugin = data->plugin;
-    mrp_resource_set_t     *rset   = 0;
-    mrp_msg_t              *rpl;
+    if (!(names = mrp_application_class_get_all_names(0, NULL)))
+        return false;
+
+    for (i = 0, found = false;  names[i] && !found;  i++)
+        found = !strcmp(names[i], class);
+
+    mrp_free(names);
+
+    if (!found || !(names = mrp_zone_get_all_names(0, NULL)))
+        return false;
+
+    for (i = 0, found = false;  names[i] && !found;  i++)
+        found = !strcmp(names[i], zone);
+
+    mrp_free(names);
+
+    return found;
+}
+
+
+static mrp_resource_set_t *read_resource_set(client_t *client, mrp_msg_t *req,
+                                             void **pcurs, const char **pclass,
+                                             const char **pzone,
+                                             bool *pacquire)
+{
+    mrp_resource_set_t     *rset;
     uint32_t                flags;
     uint32_t                priority;
     const char             *class;
@@ -606,42 +637,32 @@ static void create_resource_set_request(client_t *client, mrp_msg_t *req,
     uint16_t                type;
     size_t                  size;
     mrp_msg_value_t         value;
-    uint32_t                rsid;
     int                     arst;
-    int32_t                 status;
     bool                    auto_release;
-    bool                    auto_acquire;
     bool                    dont_wait;
     mrp_resource_event_cb_t event_cb;
 
-    MRP_ASSERT(client, "invalid argument");
-    MRP_ASSERT(client->rscli, "confused with data structures");
-
-    rsid = MRP_RESOURCE_ID_INVALID;
-    status = EINVAL;
-
-
     if (!mrp_msg_iterate(req, pcurs, &tag, &type, &value, &size) ||
         tag != RESPROTO_RESOURCE_FLAGS || type != MRP_MSG_FIELD_UINT32)
-        goto reply;
+        return NULL;
 
     flags = value.u32;
 
     if (!mrp_msg_iterate(req, pcurs, &tag, &type, &value, &size) ||
         tag != RESPROTO_RESOURCE_PRIORITY || type != MRP_MSG_FIELD_UINT32)
-        goto reply;
+        return NULL;
 
     priority = value.u32;
 
     if (!mrp_msg_iterate(req, pcurs, &tag, &type, &value, &size) ||
         tag != RESPROTO_CLASS_NAME || type != MRP_MSG_FIELD_STRING)
-        goto reply;
+        return NULL;
 
     class = value.str;
 
     if (!mrp_msg_iterate(req, pcurs, &tag, &type, &value, &size) ||
         tag != RESPROTO_ZONE_NAME || type != MRP_MSG_FIELD_STRING)
-        goto reply;
+        return NULL;
 
     zone = value.str;
 
@@ -649,7 +670,6 @@ static void create_resource_set_request(client_t *client, mrp_msg_t *req,
                  flags, priority, class, zone);
 
     auto_release = (flags & RESPROTO_RSETFLAG_AUTORELEASE);
-    auto_acquire = (flags & RESPROTO_RSETFLAG_AUTOACQUIRE);
     dont_wait    = (flags & RESPROTO_RSETFLAG_DONTWAIT);
 
     if (flags & RESPROTO_RSETFLAG_NOEVENTS)
@@ -660,21 +680,56 @@ static void create_resource_set_request(client_t *client, mrp_msg_t *req,
     rset = mrp_resource_set_create(client->rscli, auto_release, dont_wait,
                                    priority, event_cb, client);
     if (!rset)
-        goto reply;
-
-    rsid = mrp_get_resource_set_id(rset);
+        return NULL;
 
     while ((arst = read_resource(rset, req, pcurs)) == 0)
         ;
 
-    if (arst > 0) {
+    if (arst < 0) {
+        mrp_resource_set_destroy(rset);
+        return NULL;
+    }
+
+    *pclass   = class;
+    *pzone    = zone;
+    *pacquire = (flags & RESPROTO_RSETFLAG_AUTOACQUIRE);
+
+    return rset;
+}
+
+
+static void create_resource_set_request(client_t *client, mrp_msg_t *req,
+                                        uint32_t seqno, void **pcurs)
+{
+    static uint16_t reqtyp = RESPROTO_CREATE_RESOURCE_SET;
+
+    resource_data_t        *data   = client->data;
+    mrp_plugin_t           *plugin = data->plugin;
+    mrp_resource_set_t     *rset;
+    mrp_msg_t              *rpl;
+    const char             *class;
+    const char             *zone;
+    uint32_t                rsid;
+    int32_t                 status;
+    bool                    auto_acquire;
+
+    MRP_ASSERT(client, "invalid argument");
+    MRP_ASSERT(client->rscli, "confused with data structures");
+
+    rsid = MRP_RESOURCE_ID_INVALID;
+    status = EINVAL;
+
+    rset = read_resource_set(client, req, pcurs, &class, &zone, &auto_acquire);
+
+    if (rset) {
+        rsid = mrp_get_resource_set_id(rset);
+
         if (auto_acquire)
             mrp_resource_set_acquire(rset,seqno);
         if (mrp_application_class_add_resource_set(class,zone,rset,seqno) == 0)
             status = 0;
     }
 
- reply:
     rpl = mrp_msg_create(MRP_MSG_TAG_UINT32( RESPROTO_SEQUENCE_NO    , seqno ),
                          MRP_MSG_TAG_UINT16( RESPROTO_REQUEST_TYPE   , reqtyp),
                          MRP_MSG_TAG_SINT16( RESPROTO_REQUEST_STATUS , status),
@@ -760,6 +815,193 @@ static void acquire_resource_set_request(client_t *client, mrp_msg_t *req,
         mrp_resource_set_release(rset, seqno);
 }
 
+static void batch_request(client_t *client, mrp_msg_t *req, uint32_t seqno,
+                          void **pcurs)
+{
+#define PUSH(m, tag, typ, val)    \
+    mrp_msg_append(m, MRP_MSG_TAG_##typ(RESPROTO_##tag, val))
+
+    static uint16_t reqtyp = RESPROTO_BATCH_REQUEST;
+
+    typedef struct {
+        uint16_t            reqtyp;
+        int16_t             status;
+        mrp_resource_set_t *rset;
+        const char         *class;
+        const char         *zone;
+        bool                acquire;
+    } batch_op_t;
+
+    resource_data_t    *data   = client->data;
+    mrp_plugin_t       *plugin = data->plugin;
+    batch_op_t          ops[RESPROTO_BATCH_MAX];
+    batch_op_t         *op, *prev;
+    int                 nop, i;
+    int16_t             status;
+    uint16_t            tag;
+    uint16_t            type;
+    size_t              size;
+    mrp_msg_value_t     value;
+    mrp_msg_t          *rpl;
+    uint32_t            rsid;
+    bool                ok;
+
+    MRP_ASSERT(client, "invalid argument");
+    MRP_ASSERT(client->rscli, "confused with data structures");
+
+    /*
+     * Validate the whole batch first, creating the new resource sets
+     * but not yet adding them to their class. Nothing is applied unless
+     * every request in the batch is valid.
+     */
+
+    nop    = 0;
+    status = 0;
+
+    while (mrp_msg_iterate(req, pcurs, &tag, &type, &value, &size)) {
+        if (tag != RESPROTO_REQUEST_TYPE || type != MRP_MSG_FIELD_UINT16 ||
+            nop >= RESPROTO_BATCH_MAX) {
+            status = (nop >= RESPROTO_BATCH_MAX) ? E2BIG : EINVAL;
+            break;
+        }
+
+        op = ops + nop++;
+        memset(op, 0, sizeof(*op));
+        op->reqtyp = value.u16;
+
+        switch (op->reqtyp) {
+        case RESPROTO_CREATE_RESOURCE_SET:
+            op->rset = read_resource_set(client, req, pcurs, &op->class,
+                                         &op->zone, &op->acquire);
+
+            if (!op->rset || !class_and_zone_exist(op->class, op->zone))
+                op->status = EINVAL;
+            break;
+
+        case RESPROTO_DESTROY_RESOURCE_SET:
+        case RESPROTO_ACQUIRE_RESOURCE_SET:
+        case RESPROTO_RELEASE_RESOURCE_SET:
+            if (!mrp_msg_iterate(req, pcurs, &tag, &type, &value, &size) ||
+                tag != RESPROTO_RESOURCE_SET_ID || type != MRP_MSG_FIELD_UINT32)
+            {
+                op->status = EINVAL;
+                break;
+            }
+
+            op->rset = mrp_resource_client_find_set(client->rscli, value.u32);
+
+            for (prev = ops;  op->rset && prev < op;  prev++) {
+                if (prev->rset == op->rset &&
+                    prev->reqtyp == RESPROTO_DESTROY_RESOURCE_SET)
+                    op->rset = NULL;
+            }
+
+            if (!op->rset)
+                op->status = ENOENT;
+            break;
+
+        default:
+            op->status = EINVAL;
+            break;
+        }
+
+        if ((status = op->status) != 0)
+            break;
+    }
+
+    /*
+     * Reply before applying the batch, so that the client knows the ids
+     * of the new resource sets by the time their events arrive.
+     */
+
+    rpl = mrp_msg_create(MRP_MSG_TAG_UINT32( RESPROTO_SEQUENCE_NO   , seqno ),
+                         MRP_MSG_TAG_UINT16( RESPROTO_REQUEST_TYPE  , reqtyp),
+                         MRP_MSG_TAG_SINT16( RESPROTO_REQUEST_STATUS, status),
+                         RESPROTO_MESSAGE_END                               );
+
+    for (i = 0, ok = (rpl != NULL);  i < nop && ok;  i++) {
+        op = ops + i;
+
+        if (op->rset && (status == 0 ||
+                         op->reqtyp != RESPROTO_CREATE_RESOURCE_SET))
+            rsid = mrp_get_resource_set_id(op->rset);
+        else
+            rsid = MRP_RESOURCE_ID_INVALID;
+
+        ok = PUSH(rpl, REQUEST_TYPE   , UINT16, op->reqtyp) &&
+             PUSH(rpl, REQUEST_STATUS , SINT16, op->status) &&
+             PUSH(rpl, RESOURCE_SET_ID, UINT32, rsid      );
+    }
+
+    if (!ok || !mrp_transport_send(client->transp, rpl))
+        mrp_log_error("%s: failed to create or send batch reply",
+                      plugin->instance);
+
+    mrp_msg_unref(rpl);
+
+    if (status != 0) {
+        for (i = 0;  i < nop;  i++) {
+            op = ops + i;
+
+            if (op->reqtyp == RESPROTO_CREATE_RESOURCE_SET)
+                mrp_resource_set_destroy(op->rset);
+        }
+
+        return;
+    }
+
+    /* apply the batch with a single arbitration pass per affected zone */
+    mrp_resource_begin_batch();
+
+    for (i = 0;  i < nop;  i++) {
+        op = ops + i;
+
+        switch (op->reqtyp) {
+        case RESPROTO_CREATE_RESOURCE_SET:
+            if (op->acquire)
+                mrp_resource_set_acquire(op->rset, seqno);
+            mrp_application_class_add_resource_set(op->class, op->zone,
+                                                   op->rset, seqno);
+            break;
+        case RESPROTO_DESTROY_RESOURCE_SET:
+            mrp_resource_set_destroy(op->rset);
+            break;
+        case RESPROTO_ACQUIRE_RESOURCE_SET:
+            mrp_resource_set_acquire(op->rset, seqno);
+            break;
+        case RESPROTO_RELEASE_RESOURCE_SET:
+            mrp_resource_set_release(op->rset, seqno);
+            break;
+        default:
+            break;
+        }
+    }
+
+    mrp_resource_end_batch();
+
+#undef PUSH
+}
+
+static void set_capabilities_request(client_t *client, mrp_msg_t *req,
+                                     void **pcurs)
+{
+    uint16_t        tag;
+    uint16_t        type;
+    size_t          size;
+    mrp_msg_value_t value;
+
+    if (!mrp_msg_iterate(req, pcurs, &tag, &type, &value, &size) ||
+        tag != RESPROTO_CAPABILITIES || type != MRP_MSG_FIELD_UINT32)
+    {
+        reply_with_status(client, req, EINVAL);
+        return;
+    }
+
+    client->caps = value.u32 & RESPROTO_CAPFLAG_MULTI_EVENT;
+
+    reply_with_status(client, req, 0);
+}
+
 static void connection_evt(mrp_transport_t *listen, void *user_data)
 {
     static uint32_t  id;
@@ -780,9 +1022,15 @@ static void connection_evt(mrp_transport_t *listen, void *user_data)
 
     snprintf(name, sizeof(name), "client%u", (client->id = ++id));
     client->rscli = mrp_resource_client_create(name, client);
+    client->flush = mrp_add_deferred(plugin->ctx->ml, flush_events_cb, client);
 
-    if (!(client->transp = mrp_transport_accept(listen, client, flags))) {
+    if (client->flush)
+        mrp_disable_deferred(client->flush);
+
+    if (!client->flush ||
+        !(client->transp = mrp_transport_accept(listen, client, flags))) {
         mrp_log_error("%s: failed to accept new connection", plugin->instance);
+        mrp_del_deferred(client->flush);
         mrp_resource_client_destroy(client->rscli);
         mrp_free(client);
         return;
@@ -809,6 +1057,9 @@ static void closed_evt(mrp_transport_t *transp, int error, void *user_data)
 
     mrp_resource_client_destroy(client->rscli);
 
+    mrp_del_deferred(client->flush);
+    mrp_msg_unref(client->events);
+
     mrp_list_delete(&client->list);
     mrp_free(client);
 
@@ -842,6 +1093,9 @@ static void recvfrom_msg(mrp_transport_t *transp, mrp_msg_t *msg,
     mrp_log_info("%s: received a message", plugin->instance);
     mrp_msg_dump(msg, stdout);
 
+    /* keep events of earlier requests ahead of the reply to this one */
+    flush_events(client);
+
 
     if (mrp_msg_iterate(msg, &cursor, &tag, &type, &value, &size) &&
         tag == RESPROTO_SEQUENCE_NO && type == MRP_MSG_FIELD_UINT32)
@@ -891,6 +1145,14 @@ static void recvfrom_msg(mrp_transport_t *transp, mrp_msg_t *msg,
         acquire_resource_set_request(client, msg, seqno, false, &cursor);
         break;
 
+    case RESPROTO_BATCH_REQUEST:
+        batch_request(client, msg, seqno, &cursor);
+        break;
+
+    case RESPROTO_SET_CAPABILITIES:
+        set_capabilities_request(client, msg, &cursor);
+        break;
+
     default:
         mrp_log_warning("%s: unsupported request type %d",
                         plugin->instance, reqtyp);
@@ -904,6 +1166,74 @@ static void recv_msg(mrp_transport_t *transp, mrp_msg_t *msg, void *user_data)
 }
 
 
+static bool write_resources(mrp_msg_t *msg, mrp_resource_set_t *rset)
+{
+#define PUSH(m, tag, typ, val)    \
+    mrp_msg_append(m, MRP_MSG_TAG_##typ(RESPROTO_##tag, val))
+
+    mrp_resource_mask_t all;
+    mrp_resource_mask_t mask;
+    mrp_resource_t     *res;
+    uint32_t            id;
+    const char         *name;
+    void               *curs;
+    mrp_attr_t          attrs[ATTRIBUTE_MAX + 1];
+
+    all  = mrp_get_resource_set_grant(rset) | mrp_get_resource_set_advice(rset);
+    curs = NULL;
+
+    while ((res = mrp_resource_set_iterate_resources(rset, &curs))) {
+        mask = mrp_resource_get_mask(res);
+
+        if (!(all & mask))
+            continue;
+
+        id = mrp_resource_get_id(res);
+        name = mrp_resource_get_name(res);
+
+        if (!PUSH(msg, RESOURCE_ID  , UINT32, id  ) ||
+            !PUSH(msg, RESOURCE_NAME, STRING, name)  )
+            return false;
+
+        if (!mrp_resource_read_all_attributes(res, ATTRIBUTE_MAX + 1, attrs))
+            return false;
+
+        if (!write_attributes(msg, attrs))
+            return false;
+    }
+
+    return true;
+
+#undef PUSH
+}
+
+
+static void flush_events(client_t *client)
+{
+    resource_data_t *data   = client->data;
+    mrp_plugin_t    *plugin = data->plugin;
+
+    if (client->events != NULL) {
+        if (!mrp_transport_send(client->transp, client->events))
+            mrp_log_error("%s: failed to send resource events",
+                          plugin->instance);
+
+        mrp_msg_unref(client->events);
+        client->events = NULL;
+
+        mrp_disable_deferred(client->flush);
+    }
+}
+
+
+static void flush_events_cb(mrp_deferred_t *d, void *user_data)
+{
+    MRP_UNUSED(d);
+
+    flush_events((client_t *)user_data);
+}
+
+
 static void resource_event_handler(uint32_t reqid, mrp_resource_set_t *rset,
                                    void *userdata)
 {
@@ -919,21 +1249,14 @@ static void resource_event_handler(uint32_t reqid, mrp_resource_set_t *rset,
     uint16_t            state;
     mrp_resource_mask_t grant;
     mrp_resource_mask_t advice;
-    mrp_resource_mask_t mask;
-    mrp_resource_mask_t all;
     mrp_msg_t          *msg;
-    mrp_resource_t     *res;
     uint32_t            id;
-    const char         *name;
-    void               *curs;
-    mrp_attr_t          attrs[ATTRIBUTE_MAX + 1];
 
     MRP_ASSERT(rset && client, "invalid argument");
 
     data   = client->data;
     plugin = data->plugin;
 
-    reqtyp = RESPROTO_RESOURCES_EVENT;
     id     = mrp_get_resource_set_id(rset);
     grant  = mrp_get_resource_set_grant(rset);
     advice = mrp_get_resource_set_advice(rset);
@@ -943,6 +1266,44 @@ static void resource_event_handler(uint32_t reqid, mrp_resource_set_t *rset,
     else
         state = RESPROTO_RELEASE;
 
+    /*
+     * Clients that can take several events in one message get all events
+     * of an arbitration pass coalesced, sent from a deferred callback once
+     * the pass is over. Every event there starts with its own sequence
+     * number and ends with a section end.
+     */
+
+    if (client->caps & RESPROTO_CAPFLAG_MULTI_EVENT) {
+        if ((msg = client->events) == NULL) {
+            reqtyp = RESPROTO_MULTI_RESOURCES_EVENT;
+            msg    = mrp_msg_create(FIELD( SEQUENCE_NO , UINT32, 0      ),
+                                    FIELD( REQUEST_TYPE, UINT16, reqtyp ),
+                                    RESPROTO_MESSAGE_END                 );
+            if (!msg)
+                goto failed;
+
+            client->events = msg;
+            mrp_enable_deferred(client->flush);
+        }
+
+        if (!PUSH(msg, SEQUENCE_NO    , UINT32, reqid ) ||
+            !PUSH(msg, RESOURCE_SET_ID, UINT32, id    ) ||
+            !PUSH(msg, RESOURCE_STATE , UINT16, state ) ||
+            !PUSH(msg, RESOURCE_GRANT , UINT32, grant ) ||
+            !PUSH(msg, RESOURCE_ADVICE, UINT32, advice) ||
+            !write_resources(msg, rset)                  ||
+            !PUSH(msg, SECTION_END    , UINT8 , 0     )   )
+        {
+            /* a half-written event would garble all of them, drop them */
+            client->events = NULL;
+            mrp_disable_deferred(client->flush);
+            goto failed;
+        }
+
+        return;
+    }
+
+    reqtyp = RESPROTO_RESOURCES_EVENT;
     msg = mrp_msg_create(FIELD( SEQUENCE_NO    , UINT32, reqid  ),
                          FIELD( REQUEST_TYPE   , UINT16, reqtyp ),
                          FIELD( RESOURCE_SET_ID, UINT32, id     ),
@@ -951,32 +1312,9 @@ static void resource_event_handler(uint32_t reqid, mrp_resource_set_t *rset,
                          FIELD( RESOURCE_ADVICE, UINT32, advice ),
                          RESPROTO_MESSAGE_END                   );
 
-    if (!msg)
+    if (!msg || !write_resources(msg, rset))
         goto failed;
 
-    all = grant | advice;
-    curs = NULL;
-
-    while ((res = mrp_resource_set_iterate_resources(rset, &curs))) {
-        mask = mrp_resource_get_mask(res);
-
-        if (!(all & mask))
-            continue;
-
-        id = mrp_resource_get_id(res);
-        name = mrp_resource_get_name(res);
-
-         if (!PUSH(msg, RESOURCE_ID  , UINT32, id  ) ||
-             !PUSH(msg, RESOURCE_NAME, STRING, name)  )
-             goto failed;
-
-         if (!mrp_resource_read_all_attributes(res, ATTRIBUTE_MAX + 1, attrs))
-             goto failed;
-
-         if (!write_attributes(msg, attrs))
-                 goto failed;
-    }
-
     if (!mrp_transport_send(client->transp, msg))
         goto failed;
 
@@ -0,0 +1,676 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/log.h>
+#include <murphy/common/mainloop.h>
+#include <murphy/common/msg.h>
+#include <murphy/common/transport.h>
+#include <murphy/core/context.h>
+#include <murphy/core/lua-bindings/murphy.h>
+
+#include <murphy/plugins/resource-native/libmurphy-resource/resource-api.h>
+
+/*
+ * Run the batch request handling of the native resource plugin end to
+ * end: the real request handlers serve a raw protocol client and a
+ * libmurphy-resource client over a private address, and the resource
+ * library counts its arbitration passes through a resource manager.
+ */
+
+#include "../plugin-resource-native.c"
+
+#define TEST_ZONE  "driver"
+#define TEST_CLASS "player"
+#define TEST_RES   "audio_playback"
+
+#define WAIT_MSECS 5000                  /* max. wait for a reply */
+#define IDLE_MSECS 100                   /* time to let things settle */
+
+typedef struct {
+    uint16_t reqtyp;
+    int16_t  status;
+    uint32_t rsid;
+} entry_t;
+
+static mrp_mainloop_t  *ml;
+static mrp_plugin_t     server;
+static mrp_transport_t *raw;
+static uint32_t         seqno;
+static int              nbatch;          /* batch replies received */
+static int              nreply;          /* other replies received */
+static int16_t          bstatus;         /* status of the last batch */
+static entry_t          bentry[RESPROTO_BATCH_MAX];
+static int              nbentry;
+static uint32_t         last_rsid;       /* set id of the last reply */
+static int              narbitration;    /* arbitration passes */
+static int              nfailed;
+
+
+static void fail(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    printf("FAIL: ");
+    vprintf(fmt, ap);
+    printf("\n");
+    va_end(ap);
+
+    nfailed++;
+}
+
+
+static void mgr_init(mrp_zone_t *zone, void *data)
+{
+    MRP_UNUSED(zone);
+    MRP_UNUSED(data);
+
+    narbitration++;
+}
+
+
+static bool mgr_allocate(mrp_zone_t *zone, mrp_resource_t *res, void *data)
+{
+    MRP_UNUSED(zone);
+    MRP_UNUSED(res);
+    MRP_UNUSED(data);
+
+    return true;
+}
+
+
+static void mgr_free(mrp_zone_t *zone, mrp_resource_t *res, void *data)
+{
+    MRP_UNUSED(zone);
+    MRP_UNUSED(res);
+    MRP_UNUSED(data);
+}
+
+
+static bool mgr_advice(mrp_zone_t *zone, mrp_resource_t *res, void *data)
+{
+    MRP_UNUSED(zone);
+    MRP_UNUSED(res);
+    MRP_UNUSED(data);
+
+    return true;
+}
+
+
+static void timeout_cb(mrp_timer_t *t, void *user_data)
+{
+    MRP_UNUSED(t);
+
+    *(bool *)user_data = true;
+}
+
+
+/*
+ * Run the mainloop until *counter reaches target, or for msecs if
+ * counter is NULL. Returns false if we timed out waiting for counter.
+ */
+
+static bool run(int *counter, int target, unsigned int msecs)
+{
+    mrp_timer_t *t;
+    bool         expired = false;
+
+    t = mrp_add_timer(ml, msecs, timeout_cb, &expired);
+
+    while (!expired && (counter == NULL || *counter < target))
+        mrp_mainloop_iterate(ml);
+
+    mrp_del_timer(t);
+
+    return counter == NULL || *counter >= target;
+}
+
+
+static void setup_server(void)
+{
+    static mrp_resource_mgr_ftbl_t ftbl = {
+        .init     = mgr_init,
+        .allocate = mgr_allocate,
+        .free     = mgr_free,
+        .advice   = mgr_advice,
+    };
+
+    mrp_context_t *ctx;
+    char           addr[64];
+
+    snprintf(addr, sizeof(addr), "unxs:@murphy-batch-test-%u", getpid());
+    setenv(RESPROTO_DEFAULT_ADDRVAR, addr, 1);
+
+    if ((ctx = mrp_context_create()) == NULL ||
+        mrp_lua_set_murphy_context(ctx) == NULL) {
+        printf("failed to set up murphy context\n");
+        exit(1);
+    }
+
+    ml = ctx->ml;
+
+    server.instance = "resource-native";
+    server.ctx      = ctx;
+    server.args     = args;
+
+    if (!resource_init(&server)) {
+        printf("failed to initialize resource plugin\n");
+        exit(1);
+    }
+
+    if (mqi_open() < 0 || mrp_zone_definition_create(NULL) < 0 ||
+        mrp_zone_create(TEST_ZONE, NULL) == MRP_ZONE_ID_INVALID ||
+        mrp_resource_definition_create(TEST_RES, true, NULL, &ftbl,
+                                       NULL) == MRP_RESOURCE_ID_INVALID ||
+        !mrp_application_class_create(TEST_CLASS, 1, false, true,
+                                      MRP_RESOURCE_ORDER_FIFO)) {
+        printf("failed to set up resource configuration\n");
+        exit(1);
+    }
+
+    if (initiate_transport(&server) < 0) {
+        printf("failed to set up server transport\n");
+        exit(1);
+    }
+}
+
+
+static void raw_recv(mrp_transport_t *t, mrp_msg_t *msg, void *user_data)
+{
+    void            *cursor = NULL;
+    uint16_t         tag, type, reqtyp;
+    size_t           size;
+    mrp_msg_value_t  value;
+    entry_t         *e;
+
+    MRP_UNUSED(t);
+    MRP_UNUSED(user_data);
+
+    if (!mrp_msg_iterate(msg, &cursor, &tag, &type, &value, &size) ||
+        tag != RESPROTO_SEQUENCE_NO ||
+        !mrp_msg_iterate(msg, &cursor, &tag, &type, &value, &size) ||
+        tag != RESPROTO_REQUEST_TYPE)
+        return;
+
+    reqtyp = value.u16;
+
+    if (reqtyp == RESPROTO_RESOURCES_EVENT ||
+        reqtyp == RESPROTO_MULTI_RESOURCES_EVENT)
+        return;
+
+    if (!mrp_msg_iterate(msg, &cursor, &tag, &type, &value, &size) ||
+        tag != RESPROTO_REQUEST_STATUS)
+        return;
+
+    if (reqtyp != RESPROTO_BATCH_REQUEST) {
+        if (mrp_msg_iterate(msg, &cursor, &tag, &type, &value, &size) &&
+            tag == RESPROTO_RESOURCE_SET_ID)
+            last_rsid = value.u32;
+        nreply++;
+        return;
+    }
+
+    bstatus = value.s16;
+    nbentry = 0;
+
+    while (nbentry < RESPROTO_BATCH_MAX &&
+           mrp_msg_iterate(msg, &cursor, &tag, &type, &value, &size)) {
+        e = bentry + nbentry++;
+        e->reqtyp = value.u16;
+
+        if (!mrp_msg_iterate(msg, &cursor, &tag, &type, &value, &size))
+            break;
+        e->status = value.s16;
+
+        if (!mrp_msg_iterate(msg, &cursor, &tag, &type, &value, &size))
+            break;
+        e->rsid = value.u32;
+    }
+
+    nbatch++;
+}
+
+
+static void raw_recvfrom(mrp_transport_t *t, mrp_msg_t *msg,
+                         mrp_sockaddr_t *addr, socklen_t addrlen,
+                         void *user_data)
+{
+    MRP_UNUSED(addr);
+    MRP_UNUSED(addrlen);
+
+    raw_recv(t, msg, user_data);
+}
+
+
+static void raw_closed(mrp_transport_t *t, int error, void *user_data)
+{
+    MRP_UNUSED(t);
+    MRP_UNUSED(error);
+    MRP_UNUSED(user_data);
+
+    printf("server closed the raw connection\n");
+    exit(1);
+}
+
+
+static void setup_raw_client(void)
+{
+    static mrp_transport_evt_t evt = {
+        { .recvmsg     = raw_recv     },
+        { .recvmsgfrom = raw_recvfrom },
+        .closed        = raw_closed,
+        .connection    = NULL,
+    };
+
+    mrp_sockaddr_t  addr;
+    socklen_t       alen;
+    const char     *type;
+
+    alen = mrp_transport_resolve(NULL, mrp_resource_get_default_address(),
+                                 &addr, sizeof(addr), &type);
+
+    if (alen <= 0 ||
+        (raw = mrp_transport_create(ml, type, &evt, NULL, 0)) == NULL ||
+        !mrp_transport_connect(raw, &addr, alen)) {
+        printf("failed to connect to server\n");
+        exit(1);
+    }
+}
+
+
+static mrp_msg_t *request(uint16_t reqtyp)
+{
+    return mrp_msg_create(RESPROTO_SEQUENCE_NO , MRP_MSG_FIELD_UINT32, ++seqno,
+                          RESPROTO_REQUEST_TYPE, MRP_MSG_FIELD_UINT16, reqtyp,
+                          RESPROTO_MESSAGE_END);
+}
+
+
+static bool push_create(mrp_msg_t *msg, uint32_t flags, bool batch)
+{
+    uint32_t resflags = RESPROTO_RESFLAG_MANDATORY | RESPROTO_RESFLAG_SHARED;
+
+    if (batch &&
+        !mrp_msg_append(msg, RESPROTO_REQUEST_TYPE, MRP_MSG_FIELD_UINT16,
+                        RESPROTO_CREATE_RESOURCE_SET))
+        return false;
+
+    if (!mrp_msg_append(msg, RESPROTO_RESOURCE_FLAGS, MRP_MSG_FIELD_UINT32,
+                        flags) ||
+        !mrp_msg_append(msg, RESPROTO_RESOURCE_PRIORITY, MRP_MSG_FIELD_UINT32,
+                        0) ||
+        !mrp_msg_append(msg, RESPROTO_CLASS_NAME, MRP_MSG_FIELD_STRING,
+                        TEST_CLASS) ||
+        !mrp_msg_append(msg, RESPROTO_ZONE_NAME, MRP_MSG_FIELD_STRING,
+                        TEST_ZONE) ||
+        !mrp_msg_append(msg, RESPROTO_RESOURCE_NAME, MRP_MSG_FIELD_STRING,
+                        TEST_RES) ||
+        !mrp_msg_append(msg, RESPROTO_RESOURCE_FLAGS, MRP_MSG_FIELD_UINT32,
+                        resflags) ||
+        !mrp_msg_append(msg, RESPROTO_SECTION_END, MRP_MSG_FIELD_UINT8, 0))
+        return false;
+
+    /* in a batch the end of the resource list needs to be marked */
+    if (batch &&
+        !mrp_msg_append(msg, RESPROTO_SECTION_END, MRP_MSG_FIELD_UINT8, 0))
+        return false;
+
+    return true;
+}
+
+
+static bool push_op(mrp_msg_t *msg, uint16_t reqtyp, uint32_t rsid)
+{
+    return
+        mrp_msg_append(msg, RESPROTO_REQUEST_TYPE, MRP_MSG_FIELD_UINT16,
+                       reqtyp) &&
+        mrp_msg_append(msg, RESPROTO_RESOURCE_SET_ID, MRP_MSG_FIELD_UINT32,
+                       rsid);
+}
+
+
+static void send_request(mrp_msg_t *msg)
+{
+    if (msg == NULL || !mrp_transport_send(raw, msg)) {
+        printf("failed to build or send request\n");
+        exit(1);
+    }
+
+    mrp_msg_unref(msg);
+}
+
+
+static uint32_t create_set(uint32_t flags)
+{
+    mrp_msg_t *msg = request(RESPROTO_CREATE_RESOURCE_SET);
+    int        n   = nreply + 1;
+
+    if (!push_create(msg, flags, false))
+        msg = NULL;
+
+    send_request(msg);
+
+    if (!run(&nreply, n, WAIT_MSECS) ||
+        mrp_resource_set_find_by_id(last_rsid) == NULL) {
+        printf("failed to create resource set\n");
+        exit(1);
+    }
+
+    run(NULL, 0, IDLE_MSECS);
+
+    return last_rsid;
+}
+
+
+/*
+ * Send a batch and wait for its reply, then a bit more to catch any
+ * extra replies or arbitration passes caused by it.
+ */
+
+static void send_batch(mrp_msg_t *msg)
+{
+    int n = nbatch + 1;
+
+    send_request(msg);
+
+    if (!run(&nbatch, n, WAIT_MSECS)) {
+        printf("no reply to batch request\n");
+        exit(1);
+    }
+
+    run(NULL, 0, IDLE_MSECS);
+}
+
+
+static void test_mixed_batch(void)
+{
+    static uint16_t expected[] = {
+        RESPROTO_CREATE_RESOURCE_SET,
+        RESPROTO_ACQUIRE_RESOURCE_SET,
+        RESPROTO_RELEASE_RESOURCE_SET,
+        RESPROTO_DESTROY_RESOURCE_SET,
+    };
+
+    uint32_t   acq, rel, dst, nset;
+    int        nrpl, narb, i;
+    mrp_msg_t *msg;
+
+    acq = create_set(0);
+    rel = create_set(RESPROTO_RSETFLAG_AUTOACQUIRE);
+    dst = create_set(0);
+
+    nset = mrp_get_resource_set_count();
+    nrpl = nbatch;
+    narb = narbitration;
+
+    msg = request(RESPROTO_BATCH_REQUEST);
+
+    if (!push_create(msg, RESPROTO_RSETFLAG_AUTOACQUIRE, true) ||
+        !push_op(msg, RESPROTO_ACQUIRE_RESOURCE_SET, acq) ||
+        !push_op(msg, RESPROTO_RELEASE_RESOURCE_SET, rel) ||
+        !push_op(msg, RESPROTO_DESTROY_RESOURCE_SET, dst))
+        msg = NULL;
+
+    send_batch(msg);
+
+    if (nbatch - nrpl != 1)
+        fail("mixed batch: got %d replies instead of 1", nbatch - nrpl);
+
+    if (bstatus != 0)
+        fail("mixed batch: failed with status %d", bstatus);
+
+    if (nbentry != (int)MRP_ARRAY_SIZE(expected))
+        fail("mixed batch: %d entries in reply instead of %d", nbentry,
+             (int)MRP_ARRAY_SIZE(expected));
+
+    for (i = 0; i < nbentry && i < (int)MRP_ARRAY_SIZE(expected); i++) {
+        if (bentry[i].reqtyp != expected[i] || bentry[i].status != 0)
+            fail("mixed batch: bad reply entry #%d (type %u, status %d)", i,
+                 bentry[i].reqtyp, bentry[i].status);
+    }
+
+    if (narbitration - narb != 1)
+        fail("mixed batch: %d arbitration passes instead of 1",
+             narbitration - narb);
+
+    if (mrp_resource_set_find_by_id(bentry[0].rsid) == NULL)
+        fail("mixed batch: created set %u does not exist", bentry[0].rsid);
+
+    if (mrp_resource_set_find_by_id(dst) != NULL)
+        fail("mixed batch: destroyed set %u still exists", dst);
+
+    if (mrp_get_resource_set_count() != nset)
+        fail("mixed batch: %u sets instead of %u",
+             mrp_get_resource_set_count(), nset);
+}
+
+
+static void test_failed_batch(const char *name, uint32_t victim, bool destroy)
+{
+    uint32_t   nset;
+    int        nrpl, narb;
+    mrp_msg_t *msg;
+
+    nset = mrp_get_resource_set_count();
+    nrpl = nbatch;
+    narb = narbitration;
+
+    msg = request(RESPROTO_BATCH_REQUEST);
+
+    if (!push_create(msg, RESPROTO_RSETFLAG_AUTOACQUIRE, true) ||
+        !push_create(msg, 0, true) ||
+        (destroy && !push_op(msg, RESPROTO_DESTROY_RESOURCE_SET, victim)) ||
+        !push_op(msg, RESPROTO_ACQUIRE_RESOURCE_SET, victim))
+        msg = NULL;
+
+    send_batch(msg);
+
+    if (nbatch - nrpl != 1)
+        fail("%s: got %d replies instead of 1", name, nbatch - nrpl);
+
+    if (bstatus == 0)
+        fail("%s: did not fail", name);
+
+    if (nbentry < 2 || bentry[0].rsid != MRP_RESOURCE_ID_INVALID ||
+        bentry[1].rsid != MRP_RESOURCE_ID_INVALID)
+        fail("%s: reply has ids for sets that were not created", name);
+
+    if (narbitration != narb)
+        fail("%s: %d arbitration passes instead of 0", name,
+             narbitration - narb);
+
+    if (mrp_get_resource_set_count() != nset)
+        fail("%s: %u sets instead of %u", name, mrp_get_resource_set_count(),
+             nset);
+
+    if (destroy && mrp_resource_set_find_by_id(victim) == NULL)
+        fail("%s: set %u got destroyed", name, victim);
+}
+
+
+/*
+ * The same failing batch through libmurphy-resource: a set created by
+ * the batch must be reported to the application as lost.
+ */
+
+static int               connected;
+static mrp_res_context_t *cx;
+
+typedef struct {
+    int      nevent;                     /* callbacks received */
+    int      state;                      /* last reported state */
+    uint32_t id;                         /* last reported set id */
+} app_set_t;
+
+
+static void state_cb(mrp_res_context_t *c, mrp_res_error_t err, void *data)
+{
+    MRP_UNUSED(data);
+
+    /* the failed batch is reported as an error, too */
+    if (err == MRP_RES_ERROR_NONE && c->state == MRP_RES_CONNECTED)
+        connected = 1;
+}
+
+
+static void set_cb(mrp_res_context_t *c, const mrp_res_resource_set_t *rs,
+                   void *data)
+{
+    app_set_t *s = data;
+
+    MRP_UNUSED(c);
+
+    s->nevent++;
+    s->state = rs->state;
+    s->id    = mrp_res_get_resource_set_id((mrp_res_resource_set_t *)rs);
+}
+
+
+static mrp_res_resource_set_t *app_set(app_set_t *s)
+{
+    mrp_res_resource_set_t *rs;
+
+    rs = mrp_res_create_resource_set(cx, TEST_CLASS, set_cb, s);
+
+    if (rs == NULL || !mrp_res_create_resource(rs, TEST_RES, true, true)) {
+        printf("failed to create library resource set\n");
+        exit(1);
+    }
+
+    return rs;
+}
+
+
+static bool wait_acquired(app_set_t *s, bool acquired)
+{
+    while ((s->state == MRP_RES_RESOURCE_ACQUIRED) != acquired) {
+        if (!run(&s->nevent, s->nevent + 1, WAIT_MSECS))
+            return false;
+    }
+
+    return true;
+}
+
+
+static void test_lost_sets(void)
+{
+    mrp_res_resource_set_t *old, *new;
+    app_set_t               olds, news;
+
+    mrp_clear(&olds);
+    mrp_clear(&news);
+
+    if ((cx = mrp_res_create(ml, state_cb, NULL)) == NULL ||
+        !run(&connected, 1, WAIT_MSECS)) {
+        printf("failed to connect with libmurphy-resource\n");
+        exit(1);
+    }
+
+    /* get a set created on the server, then have the server forget it */
+    old = app_set(&olds);
+
+    if (mrp_res_acquire_resource_set(old) < 0 || !wait_acquired(&olds, true)) {
+        printf("failed to acquire library resource set\n");
+        exit(1);
+    }
+
+    if (mrp_res_release_resource_set(old) < 0 || !wait_acquired(&olds, false)) {
+        printf("failed to release library resource set\n");
+        exit(1);
+    }
+
+    mrp_resource_set_destroy(mrp_resource_set_find_by_id(olds.id));
+
+    /* acquiring the forgotten set makes the whole batch fail */
+    new = app_set(&news);
+
+    if (mrp_res_begin_batch(cx) < 0 ||
+        mrp_res_acquire_resource_set(new) < 0 ||
+        mrp_res_acquire_resource_set(old) < 0 ||
+        mrp_res_end_batch(cx) < 0) {
+        printf("failed to send library batch\n");
+        exit(1);
+    }
+
+    if (!run(&news.nevent, 1, WAIT_MSECS))
+        fail("lost set: set of the failed batch was not reported");
+    else {
+        if (news.state != MRP_RES_RESOURCE_LOST)
+            fail("lost set: reported in state %d instead of lost",
+                 news.state);
+        if (news.id != 0)
+            fail("lost set: reported with server id %u", news.id);
+    }
+
+    mrp_res_delete_resource_set(new);
+    mrp_res_delete_resource_set(old);
+    mrp_res_destroy(cx);
+}
+
+
+int main(int argc, char **argv)
+{
+    uint32_t victim;
+
+    MRP_UNUSED(argc);
+    MRP_UNUSED(argv);
+
+    mrp_log_set_mask(MRP_LOG_MASK_ERROR);
+
+    setup_server();
+    setup_raw_client();
+
+    test_mixed_batch();
+
+    victim = create_set(0);
+
+    test_failed_batch("unknown set", victim + 1000, false);
+    test_failed_batch("destroyed set", victim, true);
+
+    test_lost_sets();
+
+    mrp_transport_disconnect(raw);
+    mrp_transport_destroy(raw);
+
+    if (nfailed) {
+        printf("%d checks failed\n", nfailed);
+        exit(1);
+    }
+
+    printf("all checks passed\n");
+
+    return 0;
+}
@@ -0,0 +1,478 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <libgen.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/log.h>
+#include <murphy/common/mainloop.h>
+#include <murphy/common/msg.h>
+#include <murphy/common/transport.h>
+#include <murphy/core/context.h>
+#include <murphy/core/lua-bindings/murphy.h>
+
+/*
+ * Compare the cost of delivering the resource events of an arbitration
+ * pass to a client owning several resource sets, when each event is sent
+ * as a message of its own and when the client has asked for the events
+ * to be coalesced into a single multi-event message. The events are
+ * produced by the real event handler of the native resource plugin and
+ * sent over a private address, coalesced ones by the deferred per-client
+ * flush or when the next request of the client arrives.
+ *
+ * The client has a number of resource sets sharing all resources. A set
+ * of a higher priority class then takes all the resources exclusively,
+ * and gives them back, so that every arbitration pass revokes or grants
+ * the resources of all the shared sets.
+ */
+
+#include "../plugin-resource-native.c"
+
+#define BENCH_ZONE    "driver"
+#define SHARED_CLASS  "player"
+#define PREEMPT_CLASS "phone"
+
+#define WAIT_MSECS 5000                  /* max. wait for a reply */
+
+typedef struct {
+    int    nmsg;                         /* messages received */
+    int    nevent;                       /* events received */
+    double time;                         /* time spent in arbitrations */
+} cost_t;
+
+static mrp_mainloop_t  *ml;
+static mrp_plugin_t     server;
+static mrp_transport_t *raw;
+static uint32_t         seqno;
+static int              nres;
+static int              nreply;          /* replies received */
+static uint32_t         last_rsid;       /* set id of the last reply */
+static int16_t          last_status;     /* status of the last reply */
+static int              nmsg;            /* messages received */
+static int              nevent;          /* events received */
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+
+static void timeout_cb(mrp_timer_t *t, void *user_data)
+{
+    MRP_UNUSED(t);
+
+    *(bool *)user_data = true;
+}
+
+
+/*
+ * Run the mainloop until *counter reaches target. Returns false if we
+ * timed out waiting for it.
+ */
+
+static bool run(int *counter, int target, unsigned int msecs)
+{
+    mrp_timer_t *t;
+    bool         expired = false;
+
+    t = mrp_add_timer(ml, msecs, timeout_cb, &expired);
+
+    while (!expired && *counter < target)
+        mrp_mainloop_iterate(ml);
+
+    mrp_del_timer(t);
+
+    return *counter >= target;
+}
+
+
+static void setup_server(void)
+{
+    mrp_context_t *ctx;
+    char           addr[64], name[64];
+    int            i;
+
+    snprintf(addr, sizeof(addr), "unxs:@murphy-event-bench-%u", getpid());
+    setenv(RESPROTO_DEFAULT_ADDRVAR, addr, 1);
+
+    if ((ctx = mrp_context_create()) == NULL ||
+        mrp_lua_set_murphy_context(ctx) == NULL) {
+        printf("failed to set up murphy context\n");
+        exit(1);
+    }
+
+    ml = ctx->ml;
+
+    server.instance = "resource-native";
+    server.ctx      = ctx;
+    server.args     = args;
+
+    if (!resource_init(&server)) {
+        printf("failed to initialize resource plugin\n");
+        exit(1);
+    }
+
+    if (mqi_open() < 0 || mrp_zone_definition_create(NULL) < 0 ||
+        mrp_zone_create(BENCH_ZONE, NULL) == MRP_ZONE_ID_INVALID) {
+        printf("failed to set up resource zone\n");
+        exit(1);
+    }
+
+    for (i = 0; i < nres; i++) {
+        snprintf(name, sizeof(name), "resource%d", i);
+
+        if (mrp_resource_definition_create(name, true, NULL, NULL,
+                                           NULL) == MRP_RESOURCE_ID_INVALID) {
+            printf("failed to create resource '%s'\n", name);
+            exit(1);
+        }
+    }
+
+    if (!mrp_application_class_create(SHARED_CLASS, 1, false, true,
+                                      MRP_RESOURCE_ORDER_FIFO) ||
+        !mrp_application_class_create(PREEMPT_CLASS, 2, false, false,
+                                      MRP_RESOURCE_ORDER_FIFO)) {
+        printf("failed to create application classes\n");
+        exit(1);
+    }
+
+    if (initiate_transport(&server) < 0) {
+        printf("failed to set up server transport\n");
+        exit(1);
+    }
+}
+
+
+static void raw_recv(mrp_transport_t *t, mrp_msg_t *msg, void *user_data)
+{
+    void            *cursor = NULL;
+    uint16_t         tag, type, reqtyp;
+    size_t           size;
+    mrp_msg_value_t  value;
+
+    MRP_UNUSED(t);
+    MRP_UNUSED(user_data);
+
+    nmsg++;
+
+    if (!mrp_msg_iterate(msg, &cursor, &tag, &type, &value, &size) ||
+        tag != RESPROTO_SEQUENCE_NO ||
+        !mrp_msg_iterate(msg, &cursor, &tag, &type, &value, &size) ||
+        tag != RESPROTO_REQUEST_TYPE)
+        return;
+
+    reqtyp = value.u16;
+
+    switch (reqtyp) {
+    case RESPROTO_RESOURCES_EVENT:
+        nevent++;
+        break;
+
+    case RESPROTO_MULTI_RESOURCES_EVENT:
+        while (mrp_msg_iterate(msg, &cursor, &tag, &type, &value, &size))
+            if (tag == RESPROTO_RESOURCE_SET_ID)
+                nevent++;
+        break;
+
+    default:
+        /* some replies are the request with the status appended */
+        while (mrp_msg_iterate(msg, &cursor, &tag, &type, &value, &size)) {
+            if (tag == RESPROTO_REQUEST_STATUS)
+                last_status = value.s16;
+            else if (tag == RESPROTO_RESOURCE_SET_ID)
+                last_rsid = value.u32;
+        }
+
+        nreply++;
+    }
+}
+
+
+static void raw_recvfrom(mrp_transport_t *t, mrp_msg_t *msg,
+                         mrp_sockaddr_t *addr, socklen_t addrlen,
+                         void *user_data)
+{
+    MRP_UNUSED(addr);
+    MRP_UNUSED(addrlen);
+
+    raw_recv(t, msg, user_data);
+}
+
+
+static void raw_closed(mrp_transport_t *t, int error, void *user_data)
+{
+    MRP_UNUSED(t);
+    MRP_UNUSED(error);
+    MRP_UNUSED(user_data);
+
+    printf("server closed the raw connection\n");
+    exit(1);
+}
+
+
+static void setup_raw_client(void)
+{
+    static mrp_transport_evt_t evt = {
+        { .recvmsg     = raw_recv     },
+        { .recvmsgfrom = raw_recvfrom },
+        .closed        = raw_closed,
+        .connection    = NULL,
+    };
+
+    mrp_sockaddr_t  addr;
+    socklen_t       alen;
+    const char     *type;
+
+    alen = mrp_transport_resolve(NULL, mrp_resource_get_default_address(),
+                                 &addr, sizeof(addr), &type);
+
+    if (alen <= 0 ||
+        (raw = mrp_transport_create(ml, type, &evt, NULL, 0)) == NULL ||
+        !mrp_transport_connect(raw, &addr, alen)) {
+        printf("failed to connect to server\n");
+        exit(1);
+    }
+}
+
+
+static mrp_msg_t *request(uint16_t reqtyp)
+{
+    return mrp_msg_create(RESPROTO_SEQUENCE_NO , MRP_MSG_FIELD_UINT32, ++seqno,
+                          RESPROTO_REQUEST_TYPE, MRP_MSG_FIELD_UINT16, reqtyp,
+                          RESPROTO_MESSAGE_END);
+}
+
+
+/*
+ * Send a request and wait for its reply.
+ */
+
+static void send_request(mrp_msg_t *msg)
+{
+    int n = nreply + 1;
+
+    if (msg == NULL || !mrp_transport_send(raw, msg)) {
+        printf("failed to build or send request\n");
+        exit(1);
+    }
+
+    mrp_msg_unref(msg);
+
+    if (!run(&nreply, n, WAIT_MSECS) || last_status != 0) {
+        printf("request failed or timed out\n");
+        exit(1);
+    }
+}
+
+
+static uint32_t create_set(const char *class, bool shared)
+{
+    mrp_msg_t *msg = request(RESPROTO_CREATE_RESOURCE_SET);
+    uint32_t   resflags;
+    char       name[64];
+    int        i;
+    bool       ok;
+
+    resflags = RESPROTO_RESFLAG_MANDATORY;
+
+    if (shared)
+        resflags |= RESPROTO_RESFLAG_SHARED;
+
+    ok = msg != NULL &&
+        mrp_msg_append(msg, RESPROTO_RESOURCE_FLAGS, MRP_MSG_FIELD_UINT32,
+                       0) &&
+        mrp_msg_append(msg, RESPROTO_RESOURCE_PRIORITY, MRP_MSG_FIELD_UINT32,
+                       0) &&
+        mrp_msg_append(msg, RESPROTO_CLASS_NAME, MRP_MSG_FIELD_STRING,
+                       class) &&
+        mrp_msg_append(msg, RESPROTO_ZONE_NAME, MRP_MSG_FIELD_STRING,
+                       BENCH_ZONE);
+
+    for (i = 0; i < nres && ok; i++) {
+        snprintf(name, sizeof(name), "resource%d", i);
+
+        ok = mrp_msg_append(msg, RESPROTO_RESOURCE_NAME, MRP_MSG_FIELD_STRING,
+                            name) &&
+            mrp_msg_append(msg, RESPROTO_RESOURCE_FLAGS, MRP_MSG_FIELD_UINT32,
+                           resflags) &&
+            mrp_msg_append(msg, RESPROTO_SECTION_END, MRP_MSG_FIELD_UINT8, 0);
+    }
+
+    if (!ok) {
+        mrp_msg_unref(msg);
+        msg = NULL;
+    }
+
+    send_request(msg);
+
+    return last_rsid;
+}
+
+
+/*
+ * Acquire or release a set and wait until the given number of events
+ * caused by it have been received.
+ */
+
+static void set_state(uint32_t rsid, bool acquire, int events)
+{
+    mrp_msg_t *msg;
+    int        n;
+
+    msg = request(acquire ?
+                  RESPROTO_ACQUIRE_RESOURCE_SET :
+                  RESPROTO_RELEASE_RESOURCE_SET);
+
+    if (msg != NULL &&
+        !mrp_msg_append(msg, RESPROTO_RESOURCE_SET_ID, MRP_MSG_FIELD_UINT32,
+                        rsid)) {
+        mrp_msg_unref(msg);
+        msg = NULL;
+    }
+
+    n = nevent + events;
+
+    send_request(msg);
+
+    if (!run(&nevent, n, WAIT_MSECS)) {
+        printf("got %d events instead of %d\n", events - (n - nevent),
+               events);
+        exit(1);
+    }
+}
+
+
+static void set_capabilities(uint32_t caps)
+{
+    mrp_msg_t *msg = request(RESPROTO_SET_CAPABILITIES);
+
+    if (msg != NULL &&
+        !mrp_msg_append(msg, RESPROTO_CAPABILITIES, MRP_MSG_FIELD_UINT32,
+                        caps)) {
+        mrp_msg_unref(msg);
+        msg = NULL;
+    }
+
+    send_request(msg);
+}
+
+
+static void bench(uint32_t caps, uint32_t preempt, int nset, int rounds,
+                  cost_t *c)
+{
+    double start;
+    int    r, m, e;
+
+    set_capabilities(caps);
+
+    m = nmsg;
+    e = nevent;
+
+    start = now();
+
+    /* every pass changes all the shared sets and the preempting one */
+    for (r = 0; r < rounds; r++) {
+        set_state(preempt, true , nset + 1);
+        set_state(preempt, false, nset + 1);
+    }
+
+    c->time   = now() - start;
+    c->nmsg   = nmsg - m;
+    c->nevent = nevent - e;
+}
+
+
+int main(int argc, char **argv)
+{
+    uint32_t preempt;
+    cost_t   single, multi;
+    int      nset, rounds, i, out, null;
+
+    nset   = argc > 1 ? atoi(argv[1]) : 16;
+    nres   = argc > 2 ? atoi(argv[2]) : 2;
+    rounds = argc > 3 ? atoi(argv[3]) : 500;
+
+    if (nset <= 0 || nres <= 0 || nres > 31 || rounds <= 0) {
+        printf("usage: %s [sets [resources [rounds]]]\n", basename(argv[0]));
+        exit(1);
+    }
+
+    mrp_log_set_mask(MRP_LOG_MASK_ERROR);
+
+    /* the plugin dumps every request it receives, keep it out of sight */
+    if ((out = dup(fileno(stdout))) < 0 ||
+        (null = open("/dev/null", O_WRONLY)) < 0) {
+        printf("failed to redirect stdout\n");
+        exit(1);
+    }
+
+    fflush(stdout);
+    dup2(null, fileno(stdout));
+    close(null);
+
+    setup_server();
+    setup_raw_client();
+
+    for (i = 0; i < nset; i++)
+        set_state(create_set(SHARED_CLASS, true), true, 1);
+
+    preempt = create_set(PREEMPT_CLASS, false);
+
+    bench(0, preempt, nset, rounds, &single);
+    bench(RESPROTO_CAPFLAG_MULTI_EVENT, preempt, nset, rounds, &multi);
+
+    fflush(stdout);
+    dup2(out, fileno(stdout));
+    close(out);
+
+    printf("%d sets of %d resources, %d arbitrations, per arbitration "
+           "(messages include the request reply):\n", nset, nres, 2 * rounds);
+    printf("    one message per event: %5.1f messages, %5.1f events, "
+           "%.3f ms\n", 0.5 * single.nmsg / rounds,
+           0.5 * single.nevent / rounds, 500.0 * single.time / rounds);
+    printf("    coalesced events     : %5.1f messages, %5.1f events, "
+           "%.3f ms\n", 0.5 * multi.nmsg / rounds,
+           0.5 * multi.nevent / rounds, 500.0 * multi.time / rounds);
+
+    mrp_transport_disconnect(raw);
+    mrp_transport_destroy(raw);
+
+    return 0;
+}
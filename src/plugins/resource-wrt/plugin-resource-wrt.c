@@ -37,7 +37,7 @@
 #include <murphy/common/macros.h>
 #include <murphy/common/transport.h>
 #include <murphy/common/wsck-transport.h>
-#include <murphy/common/json.h>
+#include <murphy/common/json-stream.h>
 #include <murphy/core/plugin.h>
 #include <murphy/core/lua-bindings/murphy.h>
 
@@ -57,6 +57,7 @@
 
 #define DEFAULT_ADDRESS "wsck:127.0.0.1:4000/murphy"
 #define ATTRIBUTE_MAX   MRP_ATTRIBUTE_MAX
+#define RESOURCE_MAX    MRP_RESOURCE_MAX
 
 /*
  * plugin argument indices
@@ -85,13 +86,15 @@ typedef struct {
     const char      *sslcert;            /* path to SSL certificate */
     const char      *sslpkey;            /* path to SSL private key */
     const char      *sslca;              /* path to SSL CA */
-
+    mrp_json_writer_t w;                 /* reply/event writer */
+    struct wrt_request_s *req;           /* request being processed */
 } wrt_data_t;
 
 
 typedef struct {
     int                    id;           /* client id */
     int                    seq;          /* last request sequence number */
+    wrt_data_t            *data;         /* plugin data */
     mrp_context_t         *ctx;          /* murphy context */
     mrp_transport_t       *t;            /* client transport */
     mrp_resource_client_t *rsc;          /* resource client */
@@ -130,9 +133,40 @@ typedef struct {
 } errbuf_t;
 
 
-static int send_message(wrt_client_t *c, mrp_json_t *msg);
+/*
+ * a parsed WRT request
+ *
+ * Requests are parsed in a single pass, directly from the received buffer.
+ * All strings point to the (in place unescaped) receive buffer and hence
+ * are only valid while the request is being processed.
+ */
 
-static void ignore_invalid_request(wrt_client_t *c, mrp_json_t *req, ...)
+typedef struct wrt_request_s {
+    const char *type;                    /* request type */
+    int         seq;                     /* request sequence number */
+    uint32_t    id;                      /* resource set id */
+    uint32_t    priority;                /* resource set priority */
+    const char *appclass;                /* application class */
+    const char *zone;                    /* zone */
+    uint32_t    flags;                   /* resource set flags */
+    resdef_t    res[RESOURCE_MAX];       /* resource definitions */
+    int         nres;                    /* number of resources */
+    int         has;                     /* fields present in request */
+    errbuf_t    e;                       /* first parse error, if any */
+} wrt_request_t;
+
+#define REQ_TYPE      0x001
+#define REQ_SEQ       0x002
+#define REQ_ID        0x004
+#define REQ_PRIORITY  0x008
+#define REQ_CLASS     0x010
+#define REQ_ZONE      0x020
+#define REQ_RESOURCES 0x040
+
+
+static int send_message(wrt_client_t *c);
+
+static void ignore_invalid_request(wrt_client_t *c, wrt_request_t *req, ...)
 {
     MRP_UNUSED(c);
     MRP_UNUSED(req);
@@ -141,7 +175,7 @@ static void ignore_invalid_request(wrt_client_t *c, mrp_json_t *req, ...)
 }
 
 
-static void ignore_unknown_request(wrt_client_t *c, mrp_json_t *req,
+static void ignore_unknown_request(wrt_client_t *c, wrt_request_t *req,
                                    const char *type)
 {
     MRP_UNUSED(c);
@@ -165,19 +199,17 @@ static int error(errbuf_t *e, int code, const char *format, ...)
 }
 
 
-static mrp_json_t *alloc_reply(const char *type, int seq)
+static mrp_json_writer_t *begin_reply(wrt_client_t *c, const char *type,
+                                      int seq)
 {
-    mrp_json_t *reply;
+    mrp_json_writer_t *w = &c->data->w;
 
-    reply = mrp_json_create(MRP_JSON_OBJECT);
+    mrp_json_writer_reset(w);
 
-    if (reply != NULL) {
-        if (mrp_json_add_string (reply, "type", type) &&
-            mrp_json_add_integer(reply, "seq" , seq))
-            return reply;
-        else
-            mrp_json_unref(reply);
-    }
+    if (mrp_json_writer_begin_object(w) &&
+        mrp_json_writer_add_string  (w, "type", type) &&
+        mrp_json_writer_add_integer (w, "seq" , seq))
+        return w;
 
     mrp_log_error("Failed to allocate WRT resource reply.");
 
@@ -188,248 +220,239 @@ static mrp_json_t *alloc_reply(const char *type, int seq)
 static void error_reply(wrt_client_t *c, const char *type, int seq, int code,
                         const char *fmt, ...)
 {
-    mrp_json_t *reply;
-    char        errmsg[256];
-    va_list     ap;
+    mrp_json_writer_t *w;
+    char               errmsg[256];
+    va_list            ap;
 
-    reply = mrp_json_create(MRP_JSON_OBJECT);
+    w = begin_reply(c, type, seq);
 
-    if (reply != NULL) {
+    if (w != NULL) {
         va_start(ap, fmt);
         vsnprintf(errmsg, sizeof(errmsg), fmt, ap);
         errmsg[sizeof(errmsg) - 1] = '\0';
         va_end(ap);
 
-        if (mrp_json_add_string (reply, "type"   , type) &&
-            mrp_json_add_integer(reply, "seq"    , seq ) &&
-            mrp_json_add_integer(reply, "error"  , code) &&
-            mrp_json_add_string (reply, "message", errmsg))
-            send_message(c, reply);
-
-        mrp_json_unref(reply);
+        if (mrp_json_writer_add_integer(w, "error"  , code) &&
+            mrp_json_writer_add_string (w, "message", errmsg))
+            send_message(c);
     }
 }
 
 
-static void query_resources(wrt_client_t *c, mrp_json_t *req)
+static void status_reply(wrt_client_t *c, const char *type, int seq)
 {
-    const char  *type = RESWRT_QUERY_RESOURCES;
-    mrp_json_t  *reply, *rarr, *r, *ao;
-    const char **resources;
-    int          seq, cnt;
-    mrp_attr_t  *attrs, *a;
-    mrp_attr_t   buf[ATTRIBUTE_MAX];
-    uint32_t     id;
-
-    if (!mrp_json_get_integer(req, "seq", &seq)) {
-        ignore_invalid_request(c, req, "missing 'seq' field");
-        return;
-    }
+    mrp_json_writer_t *w;
 
-    rarr = r = ao = NULL;
-    resources = mrp_resource_definition_get_all_names(0, NULL);
+    w = begin_reply(c, type, seq);
 
-    if (resources == NULL) {
-        error_reply(c, type, seq, ENOMEM, "failed to query class names");
-        return;
-    }
+    if (w != NULL && mrp_json_writer_add_integer(w, "status", 0))
+        send_message(c);
+}
 
-    reply = alloc_reply(type, seq);
 
-    if (reply == NULL)
-        return;
+static int write_attributes(mrp_json_writer_t *w, mrp_attr_t *attrs,
+                            const char *owner)
+{
+    mrp_attr_t *a;
 
-    rarr = mrp_json_create(MRP_JSON_ARRAY);
+    if (attrs->name == NULL)
+        return TRUE;
 
-    if (rarr == NULL)
-        goto fail;
+    if (!mrp_json_writer_key(w, "attributes") ||
+        !mrp_json_writer_begin_object(w))
+        return FALSE;
 
-    for (id = 0; resources[id]; id++) {
-        r = mrp_json_create(MRP_JSON_OBJECT);
+    for (a = attrs; a->name != NULL; a++) {
+        switch (a->type) {
+        case mqi_string:
+            if (!mrp_json_writer_add_string(w, a->name, a->value.string))
+                return FALSE;
+            break;
+        case mqi_integer:
+            if (!mrp_json_writer_add_integer(w, a->name, a->value.integer))
+                return FALSE;
+            break;
+        case mqi_unsignd:
+            if (!mrp_json_writer_add_integer(w, a->name, a->value.unsignd))
+                return FALSE;
+            break;
+        case mqi_floating:
+            if (!mrp_json_writer_add_double(w, a->name, a->value.floating))
+                return FALSE;
+            break;
+        default:
+            mrp_log_error("attribute '%s' of resource '%s' "
+                          "has unknown type %d", a->name, owner, a->type);
+            break;
+        }
+    }
 
-        if (r == NULL)
-            goto fail;
+    return mrp_json_writer_end_object(w);
+}
 
-        if (!mrp_json_add_string (r, "name", resources[id]))
-            goto fail;
 
-        attrs = mrp_resource_definition_read_all_attributes(id,
-                                                            ATTRIBUTE_MAX, buf);
+static void query_resources(wrt_client_t *c, wrt_request_t *req)
+{
+    const char         *type = RESWRT_QUERY_RESOURCES;
+    int                 seq  = req->seq;
+    mrp_json_writer_t  *w;
+    const char        **resources;
+    mrp_attr_t         *attrs;
+    mrp_attr_t          buf[ATTRIBUTE_MAX + 1];
+    uint32_t            id;
 
-        ao = mrp_json_create(MRP_JSON_OBJECT);
+    resources = mrp_resource_definition_get_all_names(0, NULL);
 
-        if (ao == NULL)
-            goto fail;
+    if (resources == NULL) {
+        error_reply(c, type, seq, ENOMEM, "failed to query class names");
+        return;
+    }
 
-        for (a = attrs, cnt = 0; a->name; a++, cnt++) {
-            switch (a->type) {
-            case mqi_string:
-                if (!mrp_json_add_string(ao, a->name, a->value.string))
-                    goto fail;
-
-                break;
-            case mqi_integer:
-            case mqi_unsignd:
-                if (!mrp_json_add_integer(ao, a->name, a->value.integer))
-                    goto fail;
-                break;
-            case mqi_floating:
-                if (!mrp_json_add_double(ao, a->name, a->value.floating))
-                    goto fail;
-                break;
-            default:
-                mrp_log_error("attribute '%s' of resource '%s' "
-                              "has unknown type %d", a->name, resources[id],
-                              a->type);
-                break;
-            }
-        }
+    w = begin_reply(c, type, seq);
 
-        if (cnt > 0)
-            mrp_json_add(r, "attributes", ao);
-        else
-            mrp_json_unref(ao);
+    if (w == NULL)
+        goto out;
 
-        ao = NULL;
+    if (!mrp_json_writer_add_integer (w, "status", 0) ||
+        !mrp_json_writer_key         (w, "resources") ||
+        !mrp_json_writer_begin_array (w))
+        goto out;
 
-        if (!mrp_json_array_append(rarr, r))
-            goto fail;
-        else
-            r = NULL;
-    }
+    for (id = 0; resources[id]; id++) {
+        attrs = mrp_resource_definition_read_all_attributes(id,
+                                                            ATTRIBUTE_MAX + 1,
+                                                            buf);
+
+        if (!mrp_json_writer_begin_object(w) ||
+            !mrp_json_writer_add_string  (w, "name", resources[id]))
+            goto out;
+
+        if (attrs != NULL && !write_attributes(w, attrs, resources[id]))
+            goto out;
 
-    if (mrp_json_add_integer(reply, "status"   , 0)) {
-        mrp_json_add        (reply, "resources", rarr);
-        send_message(c, reply);
+        if (!mrp_json_writer_end_object(w))
+            goto out;
     }
 
-    mrp_json_unref(reply);
-    mrp_free(resources);
-    return;
+    if (mrp_json_writer_end_array(w))
+        send_message(c);
 
- fail:
-    mrp_json_unref(reply);
-    mrp_json_unref(rarr);
-    mrp_json_unref(r);
-    mrp_json_unref(ao);
+ out:
     mrp_free(resources);
 }
 
 
-static void query_classes(wrt_client_t *c, mrp_json_t *req)
+static void query_names(wrt_client_t *c, wrt_request_t *req, const char *type,
+                        const char *what, const char **names)
 {
-    const char  *type = RESWRT_QUERY_CLASSES;
-    mrp_json_t  *reply;
-    const char **classes;
-    size_t       nclass;
-    int          seq;
-
-    if (!mrp_json_get_integer(req, "seq", &seq)) {
-        ignore_invalid_request(c, req, "missing 'seq' field");
-        return;
-    }
-
-    classes = mrp_application_class_get_all_names(0, NULL);
+    mrp_json_writer_t *w;
+    size_t             cnt;
 
-    if (classes == NULL) {
-        error_reply(c, type, seq, ENOMEM, "failed to query class names");
+    if (names == NULL) {
+        error_reply(c, type, req->seq, ENOMEM, "failed to query %s names",
+                    what);
         return;
     }
 
-    reply = alloc_reply(type, seq);
-
-    if (reply == NULL)
-        return;
-
-    nclass = 0;
-    for (nclass = 0; classes[nclass] != NULL; nclass++)
+    for (cnt = 0; names[cnt] != NULL; cnt++)
         ;
 
-    if (mrp_json_add_integer     (reply, "status" , 0) &&
-        mrp_json_add_string_array(reply, "classes", classes, nclass))
-        send_message(c, reply);
+    w = begin_reply(c, type, req->seq);
 
-    mrp_json_unref(reply);
-    mrp_free(classes);
+    if (w != NULL) {
+        if (mrp_json_writer_add_integer (w, "status", 0) &&
+            mrp_json_writer_key         (w, strcmp(what, "class") ?
+                                         "zones" : "classes") &&
+            mrp_json_writer_string_array(w, names, cnt))
+            send_message(c);
+    }
+
+    mrp_free(names);
 }
 
 
-static void query_zones(wrt_client_t *c, mrp_json_t *req)
+static void query_classes(wrt_client_t *c, wrt_request_t *req)
 {
-    const char  *type = RESWRT_QUERY_ZONES;
-    mrp_json_t  *reply;
-    const char **zones;
-    size_t       nzone;
-    int          seq;
-
-    if (!mrp_json_get_integer(req, "seq", &seq)) {
-        ignore_invalid_request(c, req, "missing 'seq' field");
-        return;
-    }
+    query_names(c, req, RESWRT_QUERY_CLASSES, "class",
+                mrp_application_class_get_all_names(0, NULL));
+}
 
-    zones = mrp_zone_get_all_names(0, NULL);
 
-    if (zones == NULL) {
-        error_reply(c, type, seq, ENOMEM, "failed to query zone names");
-        return;
-    }
+static void query_zones(wrt_client_t *c, wrt_request_t *req)
+{
+    query_names(c, req, RESWRT_QUERY_ZONES, "zone",
+                mrp_zone_get_all_names(0, NULL));
+}
 
-    reply = alloc_reply(type, seq);
 
-    if (reply == NULL)
-        mrp_log_error("Failed to allocate WRT resource reply.");
+static int get_string(mrp_json_reader_t *r, const char **s)
+{
+    if (mrp_json_reader_peek(r) == MRP_JSON_READER_STRING)
+        return mrp_json_reader_get_string(r, s);
 
-    nzone = 0;
-    for (nzone = 0; zones[nzone] != NULL; nzone++)
-        ;
+    mrp_json_reader_skip(r);
+    return FALSE;
+}
 
-    if (mrp_json_add_integer     (reply, "status", 0) &&
-        mrp_json_add_string_array(reply, "zones" , zones, nzone))
-        send_message(c, reply);
 
-    mrp_json_unref(reply);
-    mrp_free(zones);
+static int get_integer(mrp_json_reader_t *r, int *i)
+{
+    if (mrp_json_reader_peek(r) == MRP_JSON_READER_NUMBER)
+        return mrp_json_reader_get_integer(r, i);
+
+    mrp_json_reader_skip(r);
+    return FALSE;
 }
 
 
-static int parse_attributes(mrp_json_t *ja, mrp_attr_t *attrs, size_t max,
-                            errbuf_t *e)
+static int parse_attributes(mrp_json_reader_t *r, mrp_attr_t *attrs,
+                            size_t max, errbuf_t *e)
 {
-    mrp_json_iter_t  it;
-    mrp_json_t      *v;
-    const char      *k;
-    mrp_attr_t      *attr;
-    int              nattr, cnt;
-
-    nattr = mrp_json_array_length(ja);
+    mrp_attr_t *attr;
+    const char *k;
+    int64_t     i;
+    double      d;
+    bool        b, integer;
+    int         cnt;
 
-    if (nattr >= (int)max)
-        return -error(e, EOVERFLOW, "too many attributes (%d > %d)", nattr,
-                      max - 1);
+    if (!mrp_json_reader_enter_object(r))
+        return -error(e, EINVAL, "invalid resource attributes");
 
     cnt  = 0;
     attr = attrs;
-    mrp_json_foreach_member(ja, k, v, it) {
+    while (mrp_json_reader_next_member(r, &k)) {
+        if (cnt >= (int)max - 1)
+            return -error(e, EOVERFLOW, "too many attributes (> %d)",
+                          (int)max - 1);
+
         attr->name = k;
 
-        switch (mrp_json_get_type(v)) {
-        case MRP_JSON_STRING:
+        switch (mrp_json_reader_peek(r)) {
+        case MRP_JSON_READER_STRING:
             attr->type = mqi_string;
-            attr->value.string = mrp_json_string_value(v);
+            if (!mrp_json_reader_get_string(r, &attr->value.string))
+                goto invalid;
             break;
-        case MRP_JSON_INTEGER:
-            attr->type = mqi_integer;
-            attr->value.integer = mrp_json_integer_value(v);
-            break;
-        case MRP_JSON_DOUBLE:
-            attr->type = mqi_floating;
-            attr->value.floating = mrp_json_double_value(v);
+        case MRP_JSON_READER_NUMBER:
+            if (!mrp_json_reader_get_number(r, &i, &d, &integer))
+                goto invalid;
+            if (integer) {
+                attr->type = mqi_integer;
+                attr->value.integer = (int32_t)i;
+            }
+            else {
+                attr->type = mqi_floating;
+                attr->value.floating = d;
+            }
             break;
-        case MRP_JSON_BOOLEAN:
+        case MRP_JSON_READER_BOOLEAN:
+            if (!mrp_json_reader_get_boolean(r, &b))
+                goto invalid;
             attr->type = mqi_integer;
-            attr->value.integer = mrp_json_boolean_value(v);
+            attr->value.integer = b;
             break;
         default:
+        invalid:
             return -error(e, EINVAL, "attribute '%s' with invalid type", k);
         }
 
@@ -438,69 +461,27 @@ static int parse_attributes(mrp_json_t *ja, mrp_attr_t *attrs, size_t max,
     }
     attr->name = NULL;
 
-    return cnt;
-}
-
+    if (mrp_json_reader_error(r))
+        return -error(e, EINVAL, "invalid resource attributes");
 
-static int append_attributes(mrp_json_t *o, mrp_attr_t *attrs, errbuf_t *e)
-{
-    mrp_json_t *a;
-    mrp_attr_t *attr;
-
-    if (attrs->name == NULL)
-        return 0;
-
-    a = mrp_json_create(MRP_JSON_OBJECT);
-
-    if (a == NULL)
-        return error(e, ENOMEM, "failed to create attributes object");
-
-    for (attr = attrs; attr->name != NULL; attr++) {
-        switch (attr->type) {
-        case mqi_string:
-            if (!mrp_json_add_string(a, attr->name, attr->value.string))
-                goto fail;
-            break;
-        case mqi_integer:
-            if (!mrp_json_add_integer(a, attr->name, attr->value.integer))
-                goto fail;
-            break;
-        case mqi_unsignd:
-            if (!mrp_json_add_integer(a, attr->name, attr->value.integer))
-                goto fail;
-            break;
-        case mqi_floating:
-            if (!mrp_json_add_double(a, attr->name, attr->value.floating))
-                goto fail;
-            break;
-        default:
-            goto fail;
-        }
-    }
-
-    mrp_json_add(o, "attributes", a);
-    return 0;
-
- fail:
-    mrp_json_unref(a);
-
-    return error(e, EINVAL, "failed to append attribtues");
+    return cnt;
 }
 
 
-static int parse_flags(mrp_json_t *arr, flagdef_t *defs, uint32_t *flagsp,
+static int parse_flags(mrp_json_reader_t *r, flagdef_t *defs, uint32_t *flagsp,
                        errbuf_t *e)
 {
     const char *name;
     flagdef_t  *d;
-    int         i, cnt;
     uint32_t    flags;
 
     flags = 0;
-    cnt   = mrp_json_array_length(arr);
 
-    for (i = 0; i < cnt; i++) {
-        if (mrp_json_array_get_string(arr, i, &name)) {
+    if (!mrp_json_reader_enter_array(r))
+        return -error(e, EINVAL, "flags must be an array");
+
+    while (mrp_json_reader_next_element(r)) {
+        if (get_string(r, &name)) {
             for (d = defs; d->name != NULL; d++)
                 if (!strcmp(d->name, name))
                     break;
@@ -514,12 +495,16 @@ static int parse_flags(mrp_json_t *arr, flagdef_t *defs, uint32_t *flagsp,
             return -error(e, EINVAL, "flags must be strings");
     }
 
+    if (mrp_json_reader_error(r))
+        return -error(e, EINVAL, "invalid flags");
+
     *flagsp = flags;
     return 0;
 }
 
 
-static int parse_resource_definition(mrp_json_t *jr, resdef_t *d, errbuf_t *e)
+static int parse_resource_definition(mrp_json_reader_t *r, resdef_t *d,
+                                     errbuf_t *e)
 {
 #define OPTIONAL 0x1
 #define SHARED   0x2
@@ -528,44 +513,194 @@ static int parse_resource_definition(mrp_json_t *jr, resdef_t *d, errbuf_t *e)
         { "shared"  , 0x2 },
         { NULL, 0 }
     };
-    mrp_json_t *jf, *ja;
+    const char *key;
     uint32_t    flags;
 
-    if (!mrp_json_get_string(jr, "name", &d->name))
-        return -error(e, EINVAL, "missing resource name");
+    d->name          = NULL;
+    d->attrs[0].name = NULL;
+    d->nattr         = 0;
+    flags            = 0;
 
-    if (mrp_json_get_array(jr, "flags", &jf)) {
-        if (parse_flags(jf, res_flags, &flags, e) != 0)
-            return e->err;
-    }
-    else {
-        if (errno != ENOENT)
-            return -error(e, EINVAL, "invalid resource flags");
-        else
-            flags = 0;
+    if (!mrp_json_reader_enter_object(r))
+        return -error(e, EINVAL, "invalid resource definition");
+
+    while (mrp_json_reader_next_member(r, &key)) {
+        if (!strcmp(key, "name")) {
+            if (!get_string(r, &d->name))
+                return -error(e, EINVAL, "invalid resource name");
+        }
+        else if (!strcmp(key, "flags")) {
+            if (parse_flags(r, res_flags, &flags, e) != 0)
+                return -e->err;
+        }
+        else if (!strcmp(key, "attributes")) {
+            d->nattr = parse_attributes(r, d->attrs, MRP_ARRAY_SIZE(d->attrs),
+                                        e);
+
+            if (d->nattr < 0)
+                return -e->err;
+        }
+        else if (!mrp_json_reader_skip(r))
+            break;
     }
 
+    if (mrp_json_reader_error(r))
+        return -error(e, EINVAL, "invalid resource definition");
+
+    if (d->name == NULL)
+        return -error(e, EINVAL, "missing resource name");
+
     d->mand  = !(flags & OPTIONAL);
     d->share =   flags & SHARED;
 
-    if (mrp_json_get_object(jr, "attributes", &ja)) {
-        d->nattr = parse_attributes(ja, d->attrs, MRP_ARRAY_SIZE(d->attrs), e);
+    return 0;
+#undef OPTIONAL
+#undef SHARED
+}
+
+
+static int parse_resources(mrp_json_reader_t *r, wrt_request_t *req)
+{
+    errbuf_t *e = &req->e;
+
+    if (!mrp_json_reader_enter_array(r))
+        return -error(e, EINVAL, "missing or invalid 'resources'");
+
+    req->nres = 0;
+    while (mrp_json_reader_next_element(r)) {
+        if (req->nres >= (int)MRP_ARRAY_SIZE(req->res))
+            return -error(e, EOVERFLOW, "too many resources (> %d)",
+                          (int)MRP_ARRAY_SIZE(req->res));
 
-        if (d->nattr < 0)
+        if (parse_resource_definition(r, req->res + req->nres, e) != 0)
             return -e->err;
+
+        req->nres++;
     }
-    else {
-        if (errno != ENOENT)
-            return -error(e, EINVAL, "invalid resource attributes");
-        else {
-            d->attrs[0].name = NULL;
-            d->nattr = 0;
+
+    if (mrp_json_reader_error(r))
+        return -error(e, EINVAL, "missing or invalid 'resources'");
+
+    return 0;
+}
+
+
+static int parse_request(char *buf, size_t size, wrt_request_t *req)
+{
+    static flagdef_t set_flags[] = {
+        { "autorelease", TRUE },
+        { NULL, 0 }
+    };
+    mrp_json_reader_t  r;
+    const char        *key;
+    int                v, depth;
+    errbuf_t          *e = &req->e;
+
+    /*
+     * Notes:
+     *     We parse the full request in a single pass, picking up all the
+     *     fields any of the requests might need and skipping anything else.
+     *     Semantic errors (the first of them) are recorded in the request
+     *     and reported by the request handlers, once we know the sequence
+     *     number to reply with. After a semantic error we skip the rest
+     *     of the offending value. Syntax errors abort parsing.
+     */
+
+    req->has    = 0;
+    req->flags  = 0;
+    req->nres   = 0;
+    req->e.err  = 0;
+    req->e.msg[0] = '\0';
+
+    mrp_json_reader_init(&r, buf, size);
+
+    if (!mrp_json_reader_enter_object(&r))
+        return FALSE;
+
+    while (mrp_json_reader_next_member(&r, &key)) {
+        depth = mrp_json_reader_depth(&r);
+
+        switch (key[0]) {
+        case 't':
+            if (!strcmp(key, "type")) {
+                if (get_string(&r, &req->type))
+                    req->has |= REQ_TYPE;
+                continue;
+            }
+            break;
+        case 's':
+            if (!strcmp(key, "seq")) {
+                if (get_integer(&r, &req->seq))
+                    req->has |= REQ_SEQ;
+                continue;
+            }
+            break;
+        case 'i':
+            if (!strcmp(key, "id")) {
+                if (get_integer(&r, &v)) {
+                    req->id   = (uint32_t)v;
+                    req->has |= REQ_ID;
+                }
+                continue;
+            }
+            break;
+        case 'p':
+            if (!strcmp(key, "priority")) {
+                if (get_integer(&r, &v)) {
+                    req->priority = (uint32_t)v;
+                    req->has |= REQ_PRIORITY;
+                }
+                continue;
+            }
+            break;
+        case 'c':
+            if (!strcmp(key, "class")) {
+                if (get_string(&r, &req->appclass))
+                    req->has |= REQ_CLASS;
+                continue;
+            }
+            break;
+        case 'z':
+            if (!strcmp(key, "zone")) {
+                if (get_string(&r, &req->zone))
+                    req->has |= REQ_ZONE;
+                continue;
+            }
+            break;
+        case 'f':
+            if (!strcmp(key, "flags")) {
+                if (e->err != 0 ||
+                    mrp_json_reader_peek(&r) != MRP_JSON_READER_ARRAY) {
+                    if (e->err == 0)
+                        error(e, EINVAL, "flags must be an array");
+                    mrp_json_reader_skip(&r);
+                }
+                else if (parse_flags(&r, set_flags, &req->flags, e) != 0)
+                    mrp_json_reader_leave(&r, depth);
+                continue;
+            }
+            break;
+        case 'r':
+            if (!strcmp(key, "resources")) {
+                if (e->err != 0 ||
+                    mrp_json_reader_peek(&r) != MRP_JSON_READER_ARRAY)
+                    mrp_json_reader_skip(&r);
+                else if (parse_resources(&r, req) == 0)
+                    req->has |= REQ_RESOURCES;
+                else
+                    mrp_json_reader_leave(&r, depth);
+                continue;
+            }
+            break;
+        default:
+            break;
         }
+
+        if (!mrp_json_reader_skip(&r))
+            break;
     }
 
-    return 0;
-#undef OPTIONAL
-#undef SHARED
+    return mrp_json_reader_done(&r);
 }
 
 
@@ -600,17 +735,16 @@ static int resource_set_events_blocked(wrt_client_t *c, mrp_resource_set_t *rs)
 static void emit_resource_set_event(wrt_client_t *c, uint32_t reqid,
                                     mrp_resource_set_t *rset, int force_all)
 {
-    const char     *type = RESWRT_EVENT;
-    int             seq  = (int)reqid;
-    mrp_json_t     *msg, *rarr, *r;
-    int             rsid;
-    const char     *state;
-    int             grant, advice, all, mask;
-    errbuf_t        e;
-    mrp_resource_t *res;
-    void           *it;
-    const char     *name;
-    mrp_attr_t      attrs[ATTRIBUTE_MAX + 1];
+    const char        *type = RESWRT_EVENT;
+    int                seq  = (int)reqid;
+    mrp_json_writer_t *w;
+    int                rsid;
+    const char        *state;
+    int                grant, advice, all, mask, cnt;
+    mrp_resource_t    *res;
+    void              *it;
+    const char        *name;
+    mrp_attr_t         attrs[ATTRIBUTE_MAX + 1];
 
     mrp_debug("event for resource set %p of client %p", rset, c);
 
@@ -628,69 +762,52 @@ static void emit_resource_set_event(wrt_client_t *c, uint32_t reqid,
     grant  = (int)mrp_get_resource_set_grant(rset);
     advice = (int)mrp_get_resource_set_advice(rset);
 
-    msg = alloc_reply(type, seq);
+    w = begin_reply(c, type, seq);
 
-    if (msg == NULL)
+    if (w == NULL)
         return;
 
-    rarr = r = NULL;
-
-    if (mrp_json_add_integer(msg, "id"    , rsid ) &&
-        mrp_json_add_string (msg, "state" , state) &&
-        mrp_json_add_integer(msg, "grant" , grant) &&
-        mrp_json_add_integer(msg, "advice", advice)) {
-
-        all = grant | advice;
-        it  = NULL;
-
-        while ((res = mrp_resource_set_iterate_resources(rset, &it)) != NULL) {
-            mask = mrp_resource_get_mask(res);
-
-            if (!(mask & all) && !force_all)
-                continue;
-
-            name = mrp_resource_get_name(res);
-
-            if (!mrp_resource_read_all_attributes(res, ATTRIBUTE_MAX+1, attrs))
-                goto fail;
+    if (!mrp_json_writer_add_integer(w, "id"    , rsid ) ||
+        !mrp_json_writer_add_string (w, "state" , state) ||
+        !mrp_json_writer_add_integer(w, "grant" , grant) ||
+        !mrp_json_writer_add_integer(w, "advice", advice))
+        return;
 
-            if (rarr == NULL) {
-                rarr = mrp_json_create(MRP_JSON_ARRAY);
-                if (rarr == NULL)
-                    goto fail;
-            }
+    all = grant | advice;
+    it  = NULL;
+    cnt = 0;
 
-            r = mrp_json_create(MRP_JSON_OBJECT);
+    while ((res = mrp_resource_set_iterate_resources(rset, &it)) != NULL) {
+        mask = mrp_resource_get_mask(res);
 
-            if (r == NULL)
-                goto fail;
+        if (!(mask & all) && !force_all)
+            continue;
 
-            if (!mrp_json_add_string (r, "name", name) ||
-                (force_all && !mrp_json_add_integer(r, "mask", mask)))
-                goto fail;
+        name = mrp_resource_get_name(res);
 
-            if (append_attributes(r, attrs, &e) != 0)
-                goto fail;
+        if (!mrp_resource_read_all_attributes(res, ATTRIBUTE_MAX + 1, attrs))
+            return;
 
-            if (!mrp_json_array_append(rarr, r))
-                goto fail;
-            else
-                r = NULL;
+        if (cnt++ == 0) {
+            if (!mrp_json_writer_key(w, "resources") ||
+                !mrp_json_writer_begin_array(w))
+                return;
         }
 
-        if (rarr != NULL)
-            mrp_json_add(msg, "resources", rarr);
+        if (!mrp_json_writer_begin_object(w) ||
+            !mrp_json_writer_add_string (w, "name", name) ||
+            (force_all && !mrp_json_writer_add_integer(w, "mask", mask)))
+            return;
 
-        send_message(c, msg);
-        mrp_json_unref(msg);
+        if (!write_attributes(w, attrs, name) ||
+            !mrp_json_writer_end_object(w))
+            return;
+    }
 
+    if (cnt > 0 && !mrp_json_writer_end_array(w))
         return;
-    }
 
- fail:
-    mrp_json_unref(msg);
-    mrp_json_unref(rarr);
-    mrp_json_unref(r);
+    send_message(c);
 }
 
 
@@ -700,68 +817,60 @@ static void event_cb(uint32_t reqid, mrp_resource_set_t *rset, void *user_data)
 }
 
 
-static void create_set(wrt_client_t *c, mrp_json_t *req)
+static void create_set(wrt_client_t *c, wrt_request_t *req)
 {
-    static flagdef_t set_flags[] = {
-        { "autorelease", TRUE },
-        { NULL, 0 }
-    };
-    const char *type = RESWRT_CREATE_SET;
-    int         seq;
-    mrp_json_t *reply;
-    errbuf_t    e;
-    mrp_json_t *jf, *jra, *jr;
-    uint32_t    flags = 0, priority, rsid;
-    bool        autorelease;
-    bool        dontwait;
-    const char *appclass, *zone;
-    char        attr[1024], *p;
-    resdef_t    r;
-    int         i, j, cnt, n, l;
+    const char         *type = RESWRT_CREATE_SET;
+    int                 seq  = req->seq;
+    mrp_json_writer_t  *w;
+    uint32_t            priority, rsid;
+    bool                autorelease;
+    bool                dontwait;
+    const char         *appclass, *zone;
+    char                attr[1024], *p;
+    resdef_t           *r;
+    int                 i, j, n, l;
     mrp_resource_set_t *rset;
 
-    if (!mrp_json_get_integer(req, "seq", &seq)) {
-        ignore_invalid_request(c, req, "missing 'seq' field");
+    /* check resource set flags */
+    if (req->e.err != 0) {
+        error_reply(c, type, seq, req->e.err, "%s", req->e.msg);
         return;
     }
 
-    /* parse resource set flags */
-    if (mrp_json_get_array(req, "flags", &jf)) {
-        if (parse_flags(jf, set_flags, &flags, &e) != 0) {
-            error_reply(c, type, seq, e.err, e.msg);
-            return;
-        }
-    }
-
-    autorelease = (flags != 0);
+    autorelease = (req->flags != 0);
     dontwait    = false;
     mrp_debug("autorelease: %s", autorelease ? "true" : "false");
 
     /* dig out priority, class, and zone */
-    if (mrp_json_get_integer(req, "priority", &priority))
+    if (req->has & REQ_PRIORITY) {
+        priority = req->priority;
         mrp_debug("priority: %u", priority);
+    }
     else {
         error_reply(c, type, seq, EINVAL, "missing or invalid 'priority'");
         return;
     }
 
-    if (mrp_json_get_string(req, "class", &appclass))
+    if (req->has & REQ_CLASS) {
+        appclass = req->appclass;
         mrp_debug("class: '%s'", appclass);
+    }
     else {
         error_reply(c, type, seq, EINVAL, "missing or invalid 'class'");
         return;
     }
 
-    if (mrp_json_get_string(req, "zone", &zone))
+    if (req->has & REQ_ZONE) {
+        zone = req->zone;
         mrp_debug("zone: '%s'", zone);
+    }
     else {
         error_reply(c, type, seq, EINVAL, "missing or invalid 'zone'");
         return;
     }
 
-    /* dig out resources */
-    if (!mrp_json_get_array(req, "resources", &jra) ||
-        (cnt = mrp_json_array_length(jra)) <= 0) {
+    /* check resources */
+    if (!(req->has & REQ_RESOURCES) || req->nres <= 0) {
         error_reply(c, type, seq, EINVAL, "missing or invalid 'resources'");
         return;
     }
@@ -774,57 +883,51 @@ static void create_set(wrt_client_t *c, mrp_json_t *req)
         rsid = mrp_get_resource_set_id(rset);
 
         /* add resources to set */
-        for (i = 0; i < cnt; i++) {
-            if (mrp_json_array_get_object(jra, i, &jr)) {
-                if (parse_resource_definition(jr, &r, &e) != 0) {
-                    ignore_invalid_request(c, req, e.msg);
-                    goto fail;
-                }
-                else {
-                    mrp_debug("resource '%s': %s %s", r.name,
-                              r.mand  ? "mandatory" : "optional",
-                              r.share ? "shared"    : "exclusive");
-
-                    for (j = 0; j < r.nattr; j++) {
-                        p  = attr;
-                        n  = sizeof(attr);
-                        l  = snprintf(p, n, "'%s' = ", r.attrs[j].name);
-                        p += l;
-                        n -= l;
-
-                        switch (r.attrs[j].type) {
-                        case mqi_string:
-                            l = snprintf(p, n, "'%s'", r.attrs[j].value.string);
-                            p += l;
-                            n -= l;
-                            break;
-                        case mqi_integer:
-                            l = snprintf(p, n, "%d", r.attrs[j].value.integer);
-                            p += l;
-                            n -= l;
-                            break;
-                        case mqi_floating:
-                            l = snprintf(p, n, "%f", r.attrs[j].value.floating);
-                            p += l;
-                            n -= l;
-                            break;
-                        default:
-                            l = snprintf(p, n, "<unsupported type>");
-                            p += l;
-                            n -= l;
-                        }
-
-                        if (n > 0)
-                            mrp_debug("    attribute %s", attr);
-                    }
-
-                    if (mrp_resource_set_add_resource(rset, r.name, r.share,
-                                                      r.attrs, r.mand) < 0) {
-                        error_reply(c, type, seq, EINVAL,
-                                    "failed to add resource %s to set", r.name);
-                        goto fail;
-                    }
+        for (i = 0; i < req->nres; i++) {
+            r = req->res + i;
+
+            mrp_debug("resource '%s': %s %s", r->name,
+                      r->mand  ? "mandatory" : "optional",
+                      r->share ? "shared"    : "exclusive");
+
+            for (j = 0; j < r->nattr; j++) {
+                p  = attr;
+                n  = sizeof(attr);
+                l  = snprintf(p, n, "'%s' = ", r->attrs[j].name);
+                p += l;
+                n -= l;
+
+                switch (r->attrs[j].type) {
+                case mqi_string:
+                    l = snprintf(p, n, "'%s'", r->attrs[j].value.string);
+                    p += l;
+                    n -= l;
+                    break;
+                case mqi_integer:
+                    l = snprintf(p, n, "%d", r->attrs[j].value.integer);
+                    p += l;
+                    n -= l;
+                    break;
+                case mqi_floating:
+                    l = snprintf(p, n, "%f", r->attrs[j].value.floating);
+                    p += l;
+                    n -= l;
+                    break;
+                default:
+                    l = snprintf(p, n, "<unsupported type>");
+                    p += l;
+                    n -= l;
                 }
+
+                if (n > 0)
+                    mrp_debug("    attribute %s", attr);
+            }
+
+            if (mrp_resource_set_add_resource(rset, r->name, r->share,
+                                              r->attrs, r->mand) < 0) {
+                error_reply(c, type, seq, EINVAL,
+                            "failed to add resource %s to set", r->name);
+                goto fail;
             }
         }
 
@@ -838,20 +941,18 @@ static void create_set(wrt_client_t *c, mrp_json_t *req)
             goto fail;
         }
         else {
-            reply = alloc_reply(type, seq);
+            w = begin_reply(c, type, seq);
 
-            if (reply != NULL) {
-                if (mrp_json_add_integer(reply, "status",0) &&
-                    mrp_json_add_integer(reply, "id", rsid)) {
-                    send_message(c, reply);
+            if (w != NULL) {
+                if (mrp_json_writer_add_integer(w, "status", 0) &&
+                    mrp_json_writer_add_integer(w, "id", rsid)) {
+                    send_message(c);
 
                     allow_resource_set_events(c, rset);
                     emit_resource_set_event(c, seq, rset, TRUE);
                 }
             }
 
-            mrp_json_unref(reply);
-
             return;
         }
     }
@@ -861,111 +962,56 @@ static void create_set(wrt_client_t *c, mrp_json_t *req)
 }
 
 
-static void destroy_set(wrt_client_t *c, mrp_json_t *req)
+static mrp_resource_set_t *lookup_set(wrt_client_t *c, wrt_request_t *req)
 {
-    const char         *type = RESWRT_DESTROY_SET;
-    int                 seq;
-    mrp_json_t         *reply;
     mrp_resource_set_t *rset;
-    uint32_t            rsid;
-
-    if (!mrp_json_get_integer(req, "seq", &seq)) {
-        ignore_invalid_request(c, req, "missing 'seq' field");
-        return;
-    }
 
     /* get resource set id */
-    if (!mrp_json_get_integer(req, "id", &rsid)) {
-        error_reply(c, type, seq, EINVAL, "missing id");
-        return;
+    if (!(req->has & REQ_ID)) {
+        error_reply(c, req->type, req->seq, EINVAL, "missing id");
+        return NULL;
     }
 
-    rset = mrp_resource_client_find_set(c->rsc, rsid);
+    rset = mrp_resource_client_find_set(c->rsc, req->id);
 
-    if (rset != NULL) {
-        reply = alloc_reply(type, seq);
+    if (rset == NULL)
+        error_reply(c, req->type, req->seq, ENOENT,
+                    "resource set %d not found", req->id);
 
-        if (reply != NULL) {
-            if (mrp_json_add_integer(reply, "status", 0))
-                send_message(c, reply);
-        }
-
-        mrp_resource_set_destroy(rset);
-    }
-    else
-        error_reply(c, type, seq, ENOENT, "resource set %d not found", rsid);
+    return rset;
 }
 
 
-static void acquire_set(wrt_client_t *c, mrp_json_t *req)
+static void destroy_set(wrt_client_t *c, wrt_request_t *req)
 {
-    const char         *type = RESWRT_ACQUIRE_SET;
-    int                 seq;
-    mrp_json_t         *reply;
     mrp_resource_set_t *rset;
-    uint32_t            rsid;
-
-    if (!mrp_json_get_integer(req, "seq", &seq)) {
-        ignore_invalid_request(c, req, "missing 'seq' field");
-        return;
-    }
-
-    /* get resource set id */
-    if (!mrp_json_get_integer(req, "id", &rsid)) {
-        error_reply(c, type, seq, EINVAL, "missing id");
-        return;
-    }
-
-    rset = mrp_resource_client_find_set(c->rsc, rsid);
 
-    if (rset != NULL) {
-        reply = alloc_reply(type, seq);
-
-        if (reply != NULL) {
-            if (mrp_json_add_integer(reply, "status", 0))
-                send_message(c, reply);
-        }
-
-        mrp_resource_set_acquire(rset, (uint32_t)seq);
+    if ((rset = lookup_set(c, req)) != NULL) {
+        status_reply(c, RESWRT_DESTROY_SET, req->seq);
+        mrp_resource_set_destroy(rset);
     }
-    else
-        error_reply(c, type, seq, ENOENT, "resource set %d not found", rsid);
 }
 
 
-static void release_set(wrt_client_t *c, mrp_json_t *req)
+static void acquire_set(wrt_client_t *c, wrt_request_t *req)
 {
-    const char         *type = RESWRT_RELEASE_SET;
-    int                 seq;
-    mrp_json_t         *reply;
     mrp_resource_set_t *rset;
-    uint32_t            rsid;
 
-    if (!mrp_json_get_integer(req, "seq", &seq)) {
-        ignore_invalid_request(c, req, "missing 'seq' field");
-        return;
+    if ((rset = lookup_set(c, req)) != NULL) {
+        status_reply(c, RESWRT_ACQUIRE_SET, req->seq);
+        mrp_resource_set_acquire(rset, (uint32_t)req->seq);
     }
+}
 
-    /* get resource set id */
-    if (!mrp_json_get_integer(req, "id", &rsid)) {
-        error_reply(c, type, seq, EINVAL, "missing id");
-        return;
-    }
-
-    rset = mrp_resource_client_find_set(c->rsc, rsid);
-
-    if (rset != NULL) {
-        reply = alloc_reply(type, seq);
 
-        if (reply != NULL) {
-            if (mrp_json_add_integer(reply, "status", 0))
-                send_message(c, reply);
-        }
+static void release_set(wrt_client_t *c, wrt_request_t *req)
+{
+    mrp_resource_set_t *rset;
 
-        mrp_resource_set_release(rset, (uint32_t)seq);
+    if ((rset = lookup_set(c, req)) != NULL) {
+        status_reply(c, RESWRT_RELEASE_SET, req->seq);
+        mrp_resource_set_release(rset, (uint32_t)req->seq);
     }
-    else
-        error_reply(c, type, seq, ENOENT, "resource set %d not found", rsid);
 }
 
 
@@ -978,6 +1024,7 @@ static wrt_client_t *create_client(wrt_data_t *data, mrp_transport_t *lt)
 
     if (c != NULL) {
         mrp_list_init(&c->hook);
+        c->data = data;
 
         c->t = mrp_transport_accept(lt, c, MRP_TRANSPORT_REUSEADDR);
 
@@ -1045,38 +1092,46 @@ static void closed_evt(mrp_transport_t *t, int error, void *user_data)
 }
 
 
-static int send_message(wrt_client_t *c, mrp_json_t *msg)
+static int send_message(wrt_client_t *c)
 {
-    const char *s;
-
-    s = mrp_json_object_to_string(msg);
+    mrp_json_writer_t *w = &c->data->w;
+    const char        *s;
+    size_t             len;
+
+    if (!mrp_json_writer_end_object(w) ||
+        (s = mrp_json_writer_data(w, &len)) == NULL) {
+        mrp_log_error("Failed to serialize WRT resource message (%d: %s).",
+                      mrp_json_writer_error(w),
+                      strerror(mrp_json_writer_error(w)));
+        return FALSE;
+    }
 
-    mrp_log_info("sending WRT resource message:");
-    mrp_log_info("  %s", s);
+    mrp_debug("sending WRT resource message: %*.*s", (int)len, (int)len, s);
 
-    return mrp_transport_sendcustom(c->t, msg);
+    return mrp_transport_sendraw(c->t, (void *)s, len);
 }
 
 
-static void recv_evt(mrp_transport_t *t, void *data, void *user_data)
+static void recv_evt(mrp_transport_t *t, void *data, size_t size,
+                     void *user_data)
 {
-    wrt_client_t *c   = (wrt_client_t *)user_data;
-    mrp_json_t   *req = (mrp_json_t *)data;
-    const char   *type;
-    int           seq;
-    const char   *s;
+    wrt_client_t  *c   = (wrt_client_t *)user_data;
+    wrt_request_t *req = c->data->req;
+    const char    *type;
+    int            seq;
 
     MRP_UNUSED(t);
 
-    s = mrp_json_object_to_string((mrp_json_t *)data);
-
-    mrp_log_info("recived WRT resource message:");
-    mrp_log_info("  %s", s);
+    mrp_debug("received WRT resource message: %*.*s", (int)size, (int)size,
+              (char *)data);
 
-    if (!mrp_json_get_string (req, "type", &type) ||
-        !mrp_json_get_integer(req, "seq" , &seq))
+    if (!parse_request(data, size, req) ||
+        !(req->has & REQ_TYPE) || !(req->has & REQ_SEQ))
         ignore_invalid_request(c, req);
     else {
+        type = req->type;
+        seq  = req->seq;
+
         if (seq < c->seq) {
             mrp_log_info("ignoring out-of-date request");
             return;
@@ -1107,8 +1162,8 @@ static void recv_evt(mrp_transport_t *t, void *data, void *user_data)
 static int transport_create(wrt_data_t *data)
 {
     static mrp_transport_evt_t evt = {
-        { .recvcustom     = recv_evt },
-        { .recvcustomfrom = NULL     },
+        { .recvraw        = recv_evt },
+        { .recvrawfrom    = NULL     },
         .connection       = connection_evt,
         .closed           = closed_evt,
     };
@@ -1127,7 +1182,7 @@ static int transport_create(wrt_data_t *data)
     len = mrp_transport_resolve(NULL, data->addr, &addr, sizeof(addr), &type);
 
     if (len > 0) {
-        flags    = MRP_TRANSPORT_REUSEADDR | MRP_TRANSPORT_MODE_CUSTOM;
+        flags    = MRP_TRANSPORT_REUSEADDR | MRP_TRANSPORT_MODE_RAW;
         data->lt = mrp_transport_create(ml, type, &evt, data, flags);
 
         if (data->lt != NULL) {
@@ -1182,6 +1237,12 @@ static int plugin_init(mrp_plugin_t *plugin)
         data->sslcert = plugin->args[ARG_SSLCERT].str;
         data->sslpkey = plugin->args[ARG_SSLPKEY].str;
         data->sslca   = plugin->args[ARG_SSLCA].str;
+        data->req     = mrp_allocz(sizeof(*data->req));
+
+        if (data->req == NULL)
+            goto fail;
+
+        mrp_json_writer_init(&data->w, NULL, 0, 0);
 
         if (!transport_create(data))
             goto fail;
@@ -1193,7 +1254,9 @@ static int plugin_init(mrp_plugin_t *plugin)
  fail:
     if (data != NULL) {
         transport_destroy(data);
+        mrp_json_writer_cleanup(&data->w);
 
+        mrp_free(data->req);
         mrp_free(data);
     }
 
@@ -1206,7 +1269,9 @@ static void plugin_exit(mrp_plugin_t *plugin)
     wrt_data_t *data = (wrt_data_t *)plugin->data;
 
     transport_destroy(data);
+    mrp_json_writer_cleanup(&data->w);
 
+    mrp_free(data->req);
     mrp_free(data);
 }
 
@@ -29,6 +29,126 @@ static void dot(mrp_console_t *c, void *user_data, int argc, char **argv)
     }
 }
 
+static void stats(mrp_console_t *c, void *user_data, int argc, char **argv)
+{
+    mrp_context_t *ctx = c->ctx;
+    int            ntrace;
+    char          *end;
+
+    MRP_UNUSED(user_data);
+
+    if (ctx->r == NULL)
+        return;
+
+    if (argc == 2)
+        mrp_resolver_dump_stats(ctx->r, c->stdout);
+    else if (argc == 3 && !strcmp(argv[2], "trace"))
+        mrp_resolver_dump_trace(ctx->r, c->stdout);
+    else if (argc == 3 && !strcmp(argv[2], "reset")) {
+        mrp_resolver_reset_stats(ctx->r);
+        fprintf(c->stdout, "Resolver statistics reset.\n");
+    }
+    else if (argc == 3 && !strcmp(argv[2], "disable")) {
+        mrp_resolver_enable_stats(ctx->r, FALSE, 0);
+        fprintf(c->stdout, "Resolver statistics disabled.\n");
+    }
+    else if ((argc == 3 || argc == 4) && !strcmp(argv[2], "enable")) {
+        if (argc == 4) {
+            ntrace = (int)strtol(argv[3], &end, 10);
+
+            if (*end || ntrace < 0) {
+                fprintf(c->stdout, "Invalid trace size '%s'.\n", argv[3]);
+                return;
+            }
+        }
+        else
+            ntrace = -1;
+
+        if (mrp_resolver_enable_stats(ctx->r, TRUE, ntrace))
+            fprintf(c->stdout, "Resolver statistics enabled.\n");
+        else
+            fprintf(c->stdout, "Failed to enable resolver statistics.\n");
+    }
+    else
+        fprintf(c->stdout, "Invalid resolver stats command.\n");
+}
+
+static void coalesce(mrp_console_t *c, void *user_data, int argc, char **argv)
+{
+    mrp_context_t *ctx = c->ctx;
+    unsigned int   window, max_delay;
+    char          *end;
+
+    MRP_UNUSED(user_data);
+
+    if (ctx->r == NULL)
+        return;
+
+    if (argc == 2) {
+        mrp_resolver_dump_coalescing(ctx->r, c->stdout);
+        return;
+    }
+
+    if (argc > 4)
+        goto invalid;
+
+    window = (unsigned int)strtoul(argv[2], &end, 10);
+
+    if (*end)
+        goto invalid;
+
+    if (argc == 4) {
+        max_delay = (unsigned int)strtoul(argv[3], &end, 10);
+
+        if (*end)
+            goto invalid;
+    }
+    else
+        max_delay = 0;
+
+    if (mrp_resolver_set_coalescing(ctx->r, window, max_delay))
+        fprintf(c->stdout, "Autoupdate coalescing set to %u/%u msecs.\n",
+                window, max_delay);
+    else
+        fprintf(c->stdout, "Failed to set autoupdate coalescing.\n");
+
+    return;
+
+ invalid:
+    fprintf(c->stdout, "Invalid resolver coalesce command.\n");
+}
+
+static void interval(mrp_console_t *c, void *user_data, int argc, char **argv)
+{
+    mrp_context_t *ctx = c->ctx;
+    unsigned int   msecs;
+    char          *end;
+
+    MRP_UNUSED(user_data);
+
+    if (ctx->r == NULL)
+        return;
+
+    if (argc != 4) {
+        fprintf(c->stdout, "Invalid resolver interval command.\n");
+        return;
+    }
+
+    msecs = (unsigned int)strtoul(argv[3], &end, 10);
+
+    if (*end || argv[3][0] == '-') {
+        fprintf(c->stdout, "Invalid interval '%s'.\n", argv[3]);
+        return;
+    }
+
+    if (mrp_resolver_set_min_interval(ctx->r, argv[2], msecs))
+        fprintf(c->stdout, "Minimum autoupdate interval of %s set to "
+                "%u msecs.\n", argv[2], msecs);
+    else
+        fprintf(c->stdout, "Failed to set minimum interval of %s: unknown "
+                "fact or target.\n", argv[2]);
+}
+
 #define RESOLVER_DESCRIPTION                                              \
     "Resolver commands provide runtime diagnostics and debugging for\n"   \
     "the Murphy resolver.\n"
@@ -43,9 +163,42 @@ static void dot(mrp_console_t *c, void *user_data, int argc, char **argv)
 #define DOT_DESCRIPTION                        \
     "Dump the resolver facts and targets in DOT format.\n"
 
+#define STATS_SYNTAX  "stats [enable [trace-size]|disable|reset|trace]"
+#define STATS_SUMMARY "show or control resolver update statistics"
+#define STATS_DESCRIPTION                                                 \
+    "Show the collected per-target update statistics (number of script\n" \
+    "executions, failures and up-to-date skips, cumulative, average and\n" \
+    "maximum script execution times) and transaction commit times. With\n" \
+    "enable, disable and reset statistics collection can be controlled.\n" \
+    "Enable optionally takes the number of recent updates to trace. The\n"  \
+    "trace of recent updates can be shown with trace.\n"
+
+#define COALESCE_SYNTAX  "coalesce [window [max-delay]]"
+#define COALESCE_SUMMARY "show or set resolver autoupdate coalescing"
+#define COALESCE_DESCRIPTION                                              \
+    "Show the autoupdate coalescing configuration and the number of\n"    \
+    "autoupdates saved by it, or set the debounce window and maximum\n"   \
+    "update delay in milliseconds. A window of 0 disables coalescing.\n"
+
+#define INTERVAL_SYNTAX  "interval $fact|target msecs"
+#define INTERVAL_SUMMARY "set the minimum autoupdate interval of a fact or target"
+#define INTERVAL_DESCRIPTION                                              \
+    "Set the minimum interval in milliseconds between autoupdates\n"      \
+    "triggered by changes to the given fact, or to any fact the given\n"  \
+    "target directly depends on. An interval of 0 removes the limit.\n"   \
+    "The configured intervals are shown by the coalesce command.\n"
+
 MRP_CORE_CONSOLE_GROUP(resolver_group, "resolver", RESOLVER_DESCRIPTION, NULL, {
         MRP_TOKENIZED_CMD("dump", dump, FALSE,
                           DUMP_SYNTAX, DUMP_SUMMARY, DUMP_DESCRIPTION),
         MRP_TOKENIZED_CMD("dot", dot, FALSE,
                           DOT_SYNTAX, DOT_SUMMARY, DOT_DESCRIPTION),
+        MRP_TOKENIZED_CMD("stats", stats, FALSE,
+                          STATS_SYNTAX, STATS_SUMMARY, STATS_DESCRIPTION),
+        MRP_TOKENIZED_CMD("coalesce", coalesce, FALSE,
+                          COALESCE_SYNTAX, COALESCE_SUMMARY,
+                          COALESCE_DESCRIPTION),
+        MRP_TOKENIZED_CMD("interval", interval, FALSE,
+                          INTERVAL_SYNTAX, INTERVAL_SUMMARY,
+                          INTERVAL_DESCRIPTION),
 });
@@ -27,8 +27,12 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <errno.h>
+
 #include <murphy/common/mm.h>
 #include <murphy/common/log.h>
+#include <murphy/common/utils.h>
+#include <murphy/common/hashtbl.h>
 #include <murphy-db/mqi.h>
 
 #include "resolver-types.h"
@@ -41,28 +45,53 @@ static void unsubscribe_db_events(mrp_resolver_t *r);
 
 int create_fact(mrp_resolver_t *r, char *fact)
 {
-    int     i;
-    fact_t *f;
+    mrp_htbl_config_t  hcfg;
+    fact_t            *f;
 
     subscribe_db_events(r);
 
-    for (i = 0; i < r->nfact; i++) {
-        if (!strcmp(r->facts[i].name, fact))
-            return TRUE;
+    if (r->fact_tbl == NULL) {
+        mrp_clear(&hcfg);
+        hcfg.nentry  = 64;
+        hcfg.comp    = mrp_string_comp;
+        hcfg.hash    = mrp_string_hash;
+        hcfg.free    = NULL;
+        hcfg.nbucket = 512;
+
+        if ((r->fact_tbl = mrp_htbl_create(&hcfg)) == NULL)
+            return FALSE;
     }
 
+    if (fact_id(r, fact) >= 0)
+        return TRUE;
+
     if (!mrp_reallocz(r->facts, r->nfact * sizeof(*r->facts),
                       (r->nfact + 1) * sizeof(*r->facts)))
         return FALSE;
 
-    f = r->facts + r->nfact++;
+    f = r->facts + r->nfact;
     f->name  = mrp_strdup(fact);
+
+    if (f->name == NULL)
+        return FALSE;
+
     f->table = mqi_get_table_handle(f->name + 1);
 
-    if (f->name != NULL)
-        return TRUE;
-    else
+    if (f->table != MQI_HANDLE_INVALID)
+        mqi_subscribe_table(f->table);
+
+    if (!mrp_htbl_insert(r->fact_tbl, f->name,
+                         (void *)(ptrdiff_t)(r->nfact + 1))) {
+        if (f->table != MQI_HANDLE_INVALID)
+            mqi_unsubscribe_table(f->table);
+        mrp_free(f->name);
+        f->name = NULL;
         return FALSE;
+    }
+
+    r->nfact++;
+
+    return TRUE;
 }
 
 
@@ -73,13 +102,40 @@ void destroy_facts(mrp_resolver_t *r)
 
     unsubscribe_db_events(r);
 
-    for (i = 0, f = r->facts; i < r->nfact; i++, f++)
+    if (r->fact_tbl != NULL) {
+        mrp_htbl_destroy(r->fact_tbl, FALSE);
+        r->fact_tbl = NULL;
+    }
+
+    for (i = 0, f = r->facts; i < r->nfact; i++, f++) {
+        if (f->table != MQI_HANDLE_INVALID)
+            mqi_unsubscribe_table(f->table);
         mrp_free(f->name);
+    }
 
     mrp_free(r->facts);
 }
 
 
+int fact_changed(mrp_resolver_t *r, int id)
+{
+    fact_t   *fact = r->facts + id;
+    uint32_t  stamp;
+
+    stamp = fact_stamp(r, id);
+
+    if (stamp == fact->stamp)
+        return FALSE;
+
+    mrp_debug("fact '%s' changed (@%u -> @%u)", fact->name, fact->stamp, stamp);
+
+    fact->stamp = stamp;
+    mark_dependents_dirty(r, id);
+
+    return TRUE;
+}
+
+
 uint32_t fact_stamp(mrp_resolver_t *r, int id)
 {
     fact_t   *fact = r->facts + id;
@@ -102,44 +158,120 @@ const char *fact_name(mrp_resolver_t *r, int id)
 }
 
 
-fact_t *lookup_fact(mrp_resolver_t *r, const char *name)
+int fact_id(mrp_resolver_t *r, const char *name)
 {
-    fact_t *f;
-    int     i;
+    void *id;
+
+    if (r->fact_tbl == NULL)
+        return -1;
+
+    id = mrp_htbl_lookup(r->fact_tbl, (void *)name);
 
-    for (i = 0, f = r->facts; i < r->nfact; i++, f++)
-        if (!strcmp(f->name, name))
-            return f;
+    return id != NULL ? (int)(ptrdiff_t)id - 1 : -1;
+}
+
+
+fact_t *lookup_fact(mrp_resolver_t *r, const char *name)
+{
+    int id = fact_id(r, name);
 
-    return NULL;
+    return id >= 0 ? r->facts + id : NULL;
 }
 
 
 static void update_fact_table(mrp_resolver_t *r, const char *name,
                               mqi_handle_t tbl)
 {
+    char    fact[strlen(name) + 2];
     fact_t *f;
-    int     i;
 
-    for (i = 0, f = r->facts; i < r->nfact; i++, f++) {
-        if (!strcmp(f->name + 1, name)) {
-            f->table = tbl;
-            return;
+    fact[0] = '$';
+    strcpy(fact + 1, name);
+
+    if ((f = lookup_fact(r, fact)) == NULL || f->table == tbl)
+        return;
+
+    /*
+     * The fact might have picked up the table and subscribed to it in
+     * create_fact() already, before we got the creation event. If the
+     * table is being dropped, unsubscribing might fail, which is fine.
+     */
+
+    if (f->table != MQI_HANDLE_INVALID)
+        mqi_unsubscribe_table(f->table);
+
+    f->table = tbl;
+
+    if (tbl != MQI_HANDLE_INVALID)
+        mqi_subscribe_table(tbl);
+}
+
+
+static uint32_t change_interval(mrp_resolver_t *r, int id)
+{
+    depidx_t *d = &r->dependents;
+    uint32_t  interval;
+    target_t *t;
+    int       i;
+
+    interval = r->facts[id].min_interval;
+
+    if (d->idx != NULL) {
+        for (i = d->idx[id]; i < d->idx[id + 1]; i++) {
+            t = r->targets + d->ids[i];
+
+            if (t->min_interval > interval)
+                interval = t->min_interval;
         }
     }
+
+    return interval;
 }
 
 
-static void check_fact_tables(mrp_resolver_t *r)
+static uint32_t check_fact_tables(mrp_resolver_t *r)
 {
-    fact_t *f;
-    int     i;
+    fact_t   *f;
+    uint32_t  interval, iv;
+    int       i;
+
+    /*
+     * Check all facts for changes and return the largest minimum
+     * update interval set for any of the changed facts or the targets
+     * directly depending on them.
+     */
+
+    interval = 0;
 
     for (i = 0, f = r->facts; i < r->nfact; i++, f++) {
         if (f->table != MQI_HANDLE_INVALID)
             mrp_debug("Fact table '%s' stamp: %u.",
                       f->name, mqi_get_table_stamp(f->table));
+
+        if (fact_changed(r, i)) {
+            iv = change_interval(r, i);
+
+            if (iv > interval)
+                interval = iv;
+        }
     }
+
+    return interval;
+}
+
+
+int set_fact_interval(mrp_resolver_t *r, const char *name, uint32_t msecs)
+{
+    fact_t *f = lookup_fact(r, name);
+
+    if (f == NULL) {
+        errno = ENOENT;
+        return FALSE;
+    }
+
+    f->min_interval = msecs;
+
+    return TRUE;
 }
 
 
@@ -177,16 +309,15 @@ static void table_event(mqi_event_t *e, void *user_data)
 static void transaction_event(mqi_event_t *e, void *user_data)
 {
     mrp_resolver_t *r = (mrp_resolver_t *)user_data;
-
-    MRP_UNUSED(r);
+    uint32_t        interval;
 
     switch (e->event) {
     case mqi_transaction_end:
         mrp_debug("DB transaction ended.");
-        check_fact_tables(r);
+        interval = check_fact_tables(r);
         if (mqi_get_transaction_depth() == 1) {
             mrp_debug("was not nested, scheduling update");
-            schedule_target_autoupdate(r);
+            schedule_target_autoupdate(r, interval);
         }
         else
             mrp_debug("was nested");
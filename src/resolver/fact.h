@@ -41,6 +41,8 @@ uint32_t fact_stamp(mrp_resolver_t *r, int id);
 const char *fact_name(mrp_resolver_t *r, int id);
 
 fact_t *lookup_fact(mrp_resolver_t *r, const char *name);
+int fact_id(mrp_resolver_t *r, const char *name);
+int set_fact_interval(mrp_resolver_t *r, const char *name, uint32_t msecs);
 
 
 mqi_handle_t start_transaction(mrp_resolver_t *r);
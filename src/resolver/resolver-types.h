@@ -41,6 +41,7 @@
 
 typedef struct target_s target_t;        /* opaque type for resolver targets */
 typedef struct fact_s   fact_t;          /* opaque type for tracked facts */
+typedef struct resolver_stats_s resolver_stats_t; /* update statistics */
 
 /*
  * a resolver target
@@ -55,9 +56,12 @@ struct target_s {
     int             *directs;            /* direct dependencies */
     int              ndirect;            /* number of direct dependencies */
     uint32_t        *fact_stamps;        /* stamps of facts at last update */
+    int              nfact;              /* number of facts to check */
+    uint32_t         min_interval;       /* min. autoupdate interval (ms) */
     mrp_scriptlet_t *script;             /* update script if any, or NULL */
     int              prepared : 1;       /* ready for resolution */
     int              precompiled : 1;
+    int              dirty : 1;          /* needs to be checked for update */
 };
 
 
@@ -67,22 +71,65 @@ struct target_s {
 struct fact_s {
     char         *name;                  /* fact name */
     mqi_handle_t  table;                 /* associated DB table */
-    uint32_t      stamp;                 /* touch-stamp */
+    uint32_t      stamp;                 /* last seen table stamp */
+    uint32_t      min_interval;          /* min. autoupdate interval (ms) */
 };
 
 
+/*
+ * reverse dependency index
+ *
+ * Graph nodes are numbered the same way as in target_t->directs: facts
+ * come first, followed by targets (offset by the number of facts). The
+ * targets directly depending on node n are ids[idx[n]] ... ids[idx[n+1]-1].
+ */
+typedef struct {
+    int *idx;                            /* dependents offsets per node */
+    int *ids;                            /* dependent target indices */
+} depidx_t;
+
+
+/*
+ * autoupdate coalescing
+ *
+ * Fact changes arriving within the debounce window of each other are
+ * merged into a single autoupdate. Minimum intervals can be set for facts
+ * and targets to limit how often changes to them trigger an autoupdate.
+ * An autoupdate is still guaranteed to happen within max_delay of the
+ * first change.
+ */
+typedef struct {
+    uint32_t           window;           /* debounce window (ms) */
+    uint32_t           max_delay;        /* max. delay of an update (ms) */
+    mrp_timer_t       *timer;            /* delayed autoupdate timer */
+    int                pending;          /* autoupdate pending */
+    uint64_t           first;            /* first pending change (ms) */
+    uint64_t           last;             /* last autoupdate (ms) */
+    uint32_t           nrequest;         /* number of requested updates */
+    uint32_t           nupdate;          /* number of autoupdates run */
+} coalesce_t;
+
+
 struct mrp_resolver_s {
     mrp_context_t     *ctx;              /* murphy context we're running in */
     mrp_event_bus_t   *bus;              /* bus for resolver events */
     target_t          *targets;          /* targets defined in the ruleset */
     int                ntarget;          /* number of targets */
+    mrp_htbl_t        *target_tbl;       /* target name to index + 1 */
     fact_t            *facts;            /* facts tracked as dependencies */
     int                nfact;            /* number of tracked facts */
+    mrp_htbl_t        *fact_tbl;         /* fact name to index + 1 */
+    depidx_t           dependents;       /* reverse dependency index */
+    uint32_t          *journal;          /* stamps to restore on rollback */
+    int                njournal;         /* used journal entries */
+    int                journal_size;     /* allocated journal entries */
     target_t          *auto_update;      /* target to resolve on fact changes */
     mrp_deferred_t    *auto_scheduled;   /* scheduled auto_update */
+    coalesce_t         coalesce;         /* autoupdate coalescing */
     uint32_t           stamp;            /* update stamp */
     mrp_context_tbl_t *ctbl;             /* context variable table */
     int                level;            /* target update nesting level */
+    resolver_stats_t  *stats;            /* statistics, if enabled */
 };
 
 
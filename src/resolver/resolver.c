@@ -39,6 +39,7 @@
 #include "target.h"
 #include "target-sorter.h"
 #include "fact.h"
+#include "stats.h"
 #include "resolver.h"
 
 
@@ -107,6 +108,7 @@ void mrp_resolver_destroy(mrp_resolver_t *r)
         mrp_destroy_context_table(r->ctbl);
         destroy_targets(r);
         destroy_facts(r);
+        destroy_stats(r);
 
         mrp_free(r);
     }
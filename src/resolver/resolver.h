@@ -123,6 +123,36 @@ void mrp_resolver_dump_targets(mrp_resolver_t *r, FILE *fp);
 /** Produce a debug dump of all tracked facts. */
 void mrp_resolver_dump_facts(mrp_resolver_t *r, FILE *fp);
 
+/** Coalesce fact changes arriving within window msecs of each other into
+    a single autoupdate, but update at most max_delay msecs after the first
+    change (unless max_delay is 0). A window of 0 disables coalescing. */
+int mrp_resolver_set_coalescing(mrp_resolver_t *r, unsigned int window,
+                                unsigned int max_delay);
+
+/** Set the minimum interval between autoupdates triggered by changes to
+    the given fact (name starting with '$') or target. */
+int mrp_resolver_set_min_interval(mrp_resolver_t *r, const char *name,
+                                  unsigned int msecs);
+
+/** Dump the autoupdate coalescing configuration and counters. */
+void mrp_resolver_dump_coalescing(mrp_resolver_t *r, FILE *fp);
+
+/** Enable/disable collecting update statistics, tracing the last ntrace
+    updates (or a default number of them if ntrace is negative). */
+int mrp_resolver_enable_stats(mrp_resolver_t *r, int enable, int ntrace);
+
+/** Check if collecting update statistics is enabled. */
+int mrp_resolver_stats_enabled(mrp_resolver_t *r);
+
+/** Reset all collected update statistics. */
+void mrp_resolver_reset_stats(mrp_resolver_t *r);
+
+/** Dump the collected per-target update statistics. */
+void mrp_resolver_dump_stats(mrp_resolver_t *r, FILE *fp);
+
+/** Dump the trace of the most recent updates. */
+void mrp_resolver_dump_trace(mrp_resolver_t *r, FILE *fp);
+
 /** Register a script interpreter. */
 int mrp_resolver_register_interpreter(mrp_interpreter_t *i);
 
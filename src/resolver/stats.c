@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+
+#include <murphy/common/mm.h>
+#include <murphy/common/log.h>
+
+#include "resolver-types.h"
+#include "resolver.h"
+#include "stats.h"
+
+#define DEFAULT_TRACE 32                 /* default update trace size */
+
+void stats_executed(mrp_resolver_t *r, target_t *t, uint64_t start,
+                    int status)
+{
+    target_stats_t *ts = target_stats(r, t);
+    uint64_t        diff;
+
+    if (ts == NULL)
+        return;
+
+    diff = stats_now() - start;
+
+    ts->nexec++;
+    ts->total += diff;
+
+    if (diff > ts->max)
+        ts->max = diff;
+
+    if (status <= 0)
+        ts->nfail++;
+}
+
+
+void stats_committed(mrp_resolver_t *r, uint64_t start)
+{
+    resolver_stats_t *s = r->stats;
+    uint64_t          diff;
+
+    if (s == NULL)
+        return;
+
+    diff = stats_now() - start;
+
+    s->ncommit++;
+    s->commit_total += diff;
+
+    if (diff > s->commit_max)
+        s->commit_max = diff;
+}
+
+
+void stats_updated(mrp_resolver_t *r, target_t *t, int level, int status,
+                   uint32_t nexec, uint32_t nskip, uint64_t start,
+                   uint64_t commit)
+{
+    resolver_stats_t *s = r->stats;
+    update_trace_t   *u;
+
+    if (s == NULL)
+        return;
+
+    s->nupdate++;
+
+    if (s->ntrace <= 0)
+        return;
+
+    u = s->trace + (s->ntraced++ % s->ntrace);
+
+    u->target   = t - r->targets;
+    u->level    = level;
+    u->status   = status;
+    u->nexec    = nexec;
+    u->nskip    = nskip;
+    u->start    = start;
+    u->duration = stats_now() - start;
+    u->commit   = commit;
+}
+
+
+void destroy_stats(mrp_resolver_t *r)
+{
+    if (r->stats != NULL) {
+        mrp_free(r->stats->targets);
+        mrp_free(r->stats->trace);
+        mrp_free(r->stats);
+        r->stats = NULL;
+    }
+}
+
+
+int mrp_resolver_enable_stats(mrp_resolver_t *r, int enable, int ntrace)
+{
+    resolver_stats_t *s;
+
+    if (!enable) {
+        destroy_stats(r);
+        return TRUE;
+    }
+
+    if (ntrace < 0)
+        ntrace = DEFAULT_TRACE;
+
+    /*
+     * Notes:
+     *     The statistics table is sized for the targets we have at the
+     *     time of enabling. Re-enabling resizes the table (and the trace)
+     *     but throws away any statistics collected so far.
+     */
+
+    s = mrp_allocz(sizeof(*s));
+
+    if (s == NULL)
+        return FALSE;
+
+    s->ntarget = r->ntarget;
+    s->targets = mrp_allocz_array(target_stats_t, s->ntarget ? s->ntarget : 1);
+    s->ntrace  = ntrace;
+    s->trace   = mrp_allocz_array(update_trace_t, ntrace ? ntrace : 1);
+
+    if (s->targets == NULL || s->trace == NULL) {
+        mrp_free(s->targets);
+        mrp_free(s->trace);
+        mrp_free(s);
+        return FALSE;
+    }
+
+    destroy_stats(r);
+    r->stats = s;
+
+    return TRUE;
+}
+
+
+int mrp_resolver_stats_enabled(mrp_resolver_t *r)
+{
+    return r->stats != NULL;
+}
+
+
+void mrp_resolver_reset_stats(mrp_resolver_t *r)
+{
+    resolver_stats_t *s = r->stats;
+
+    if (s == NULL)
+        return;
+
+    memset(s->targets, 0, s->ntarget * sizeof(s->targets[0]));
+    memset(s->trace  , 0, s->ntrace  * sizeof(s->trace[0]));
+
+    s->nupdate      = 0;
+    s->ncommit      = 0;
+    s->commit_total = 0;
+    s->commit_max   = 0;
+    s->ntraced      = 0;
+}
+
+
+#define USEC(ns) ((double)(ns) / 1000.0)
+
+void mrp_resolver_dump_stats(mrp_resolver_t *r, FILE *fp)
+{
+    resolver_stats_t *s = r->stats;
+    target_stats_t   *ts;
+    int               i;
+
+    if (s == NULL) {
+        fprintf(fp, "Resolver statistics are disabled.\n");
+        return;
+    }
+
+    fprintf(fp, "%u update%s, %u commit%s (avg %.1f us, max %.1f us)\n",
+            s->nupdate, s->nupdate != 1 ? "s" : "",
+            s->ncommit, s->ncommit != 1 ? "s" : "",
+            s->ncommit ? USEC(s->commit_total) / s->ncommit : 0.0,
+            USEC(s->commit_max));
+
+    fprintf(fp, "  %-32.32s %8s %6s %8s %12s %10s %10s\n", "target",
+            "executed", "failed", "skipped", "total (us)", "avg (us)",
+            "max (us)");
+
+    for (i = 0; i < s->ntarget && i < r->ntarget; i++) {
+        ts = s->targets + i;
+
+        if (!ts->nexec && !ts->nskip)
+            continue;
+
+        fprintf(fp, "  %-32.32s %8u %6u %8u %12.1f %10.1f %10.1f\n",
+                r->targets[i].name, ts->nexec, ts->nfail, ts->nskip,
+                USEC(ts->total), ts->nexec ? USEC(ts->total) / ts->nexec : 0.0,
+                USEC(ts->max));
+    }
+}
+
+
+void mrp_resolver_dump_trace(mrp_resolver_t *r, FILE *fp)
+{
+    resolver_stats_t *s = r->stats;
+    update_trace_t   *u;
+    uint32_t          i, n, first;
+    uint64_t          base;
+
+    if (s == NULL) {
+        fprintf(fp, "Resolver statistics are disabled.\n");
+        return;
+    }
+
+    n     = s->ntraced < (uint32_t)s->ntrace ? s->ntraced : (uint32_t)s->ntrace;
+    first = s->ntraced - n;
+
+    fprintf(fp, "last %u of %u update%s:\n", n, s->ntraced,
+            s->ntraced != 1 ? "s" : "");
+
+    if (n == 0)
+        return;
+
+    base = s->trace[first % s->ntrace].start;
+
+    for (i = first; i < s->ntraced; i++) {
+        u = s->trace + (i % s->ntrace);
+
+        fprintf(fp, "  +%.1f us: %*s%s: %s, %u executed, %u skipped, "
+                "%.1f us (commit %.1f us)\n", USEC((int64_t)(u->start - base)),
+                2 * u->level, "",
+                u->target < r->ntarget ? r->targets[u->target].name : "?",
+                u->status > 0 ? "ok" : "failed", u->nexec, u->nskip,
+                USEC(u->duration), USEC(u->commit));
+    }
+}
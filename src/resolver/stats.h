@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MURPHY_RESOLVER_STATS_H__
+#define __MURPHY_RESOLVER_STATS_H__
+
+#include <stdint.h>
+#include <time.h>
+
+#include "resolver-types.h"
+
+/*
+ * per-target update statistics
+ */
+
+typedef struct {
+    uint32_t nexec;                      /* number of script executions */
+    uint32_t nfail;                      /* number of failed executions */
+    uint32_t nskip;                      /* times found to be up-to-date */
+    uint64_t total;                      /* cumulative script time (ns) */
+    uint64_t max;                        /* maximum script time (ns) */
+} target_stats_t;
+
+
+/*
+ * a traced target update
+ */
+
+typedef struct {
+    int      target;                     /* target index */
+    int      level;                      /* update nesting level */
+    int      status;                     /* update status */
+    uint32_t nexec;                      /* number of scripts executed */
+    uint32_t nskip;                      /* number of targets skipped */
+    uint64_t start;                      /* update start time (ns) */
+    uint64_t duration;                   /* total update time (ns) */
+    uint64_t commit;                     /* transaction commit time (ns) */
+} update_trace_t;
+
+
+/*
+ * resolver statistics
+ */
+
+struct resolver_stats_s {
+    target_stats_t *targets;             /* per-target statistics */
+    int             ntarget;             /* size of targets */
+    uint32_t        nupdate;             /* number of updates */
+    uint32_t        ncommit;             /* number of commits */
+    uint64_t        commit_total;        /* cumulative commit time (ns) */
+    uint64_t        commit_max;          /* maximum commit time (ns) */
+    update_trace_t *trace;               /* ring buffer of last updates */
+    int             ntrace;              /* size of trace */
+    uint32_t        ntraced;             /* total number of traced updates */
+};
+
+
+static inline uint64_t stats_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+static inline target_stats_t *target_stats(mrp_resolver_t *r, target_t *t)
+{
+    int idx = t - r->targets;
+
+    if (r->stats == NULL || idx >= r->stats->ntarget)
+        return NULL;
+    else
+        return r->stats->targets + idx;
+}
+
+
+static inline void stats_skipped(mrp_resolver_t *r, target_t *t)
+{
+    target_stats_t *ts;
+
+    if (MRP_UNLIKELY(r->stats != NULL) && (ts = target_stats(r, t)) != NULL)
+        ts->nskip++;
+}
+
+
+void stats_executed(mrp_resolver_t *r, target_t *t, uint64_t start,
+                    int status);
+void stats_committed(mrp_resolver_t *r, uint64_t start);
+void stats_updated(mrp_resolver_t *r, target_t *t, int level, int status,
+                   uint32_t nexec, uint32_t nskip, uint64_t start,
+                   uint64_t commit);
+void destroy_stats(mrp_resolver_t *r);
+
+#endif /* __MURPHY_RESOLVER_STATS_H__ */
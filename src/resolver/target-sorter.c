@@ -26,7 +26,6 @@
  * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
-
 #include <errno.h>
 
 #include <murphy/common/mm.h>
@@ -43,17 +42,35 @@
 
 /*
  * dependency graph used to determine target update orders
+ *
+ * The graph is stored in compressed sparse row form. Facts are numbered
+ * 0 ... nfact - 1, targets nfact ... nfact + ntarget - 1. For every node
+ * we store both its dependencies (in) and its dependents (out), so both
+ * the per-target sorting and the reverse dependency index can be produced
+ * in time linear to the size of the graph.
  */
 
 typedef struct {
     mrp_resolver_t *r;                   /* resolver context */
-    int            *edges;               /* edges between nodes */
     int             nnode;               /* number of graph nodes */
+    int             nedge;               /* number of graph edges */
+    int            *in_idx;              /* dependency offsets per node */
+    int            *in;                  /* dependencies */
+    int            *out_idx;             /* dependent offsets per node */
+    int            *out;                 /* dependents */
+    int            *mark;                /* node visit marks */
+    int            *stack;               /* DFS node stack */
+    int            *next;                /* DFS next edge stack */
+    int            *order;               /* sorting result buffer */
 } graph_t;
 
+#define MARK_ACTIVE(gen) (2 * (gen))     /* node is being visited */
+#define MARK_DONE(gen)   (2 * (gen) + 1) /* node has been visited */
+
 
 static graph_t *build_graph(mrp_resolver_t *r);
 static int sort_graph(graph_t *g, int target_idx);
+static int build_dependents(graph_t *g);
 static void free_graph(graph_t *g);
 static void dump_graph(graph_t *g, FILE *fp);
 
@@ -66,7 +83,7 @@ int sort_targets(mrp_resolver_t *r)
     g = build_graph(r);
 
     if (g != NULL) {
-        dump_graph(g, stdout);
+        mrp_debug_code(dump_graph(g, stdout));
 
         status = 0;
 
@@ -80,7 +97,10 @@ int sort_targets(mrp_resolver_t *r)
             t->update_targets = NULL;
             t->update_facts   = NULL;
             t->fact_stamps    = NULL;
+            t->directs        = NULL;
             t->ndirect        = 0;
+            t->nfact          = 0;
+            t->dirty          = TRUE;
         }
 
         for (i = 0; i < r->ntarget; i++) {
@@ -96,6 +116,9 @@ int sort_targets(mrp_resolver_t *r)
             }
         }
 
+        if (status == 0 && !build_dependents(g))
+            status = -1;
+
         free_graph(g);
     }
     else
@@ -105,30 +128,6 @@ int sort_targets(mrp_resolver_t *r)
 }
 
 
-static inline int fact_id(graph_t *g, char *fact)
-{
-    int i;
-
-    for (i = 0; i < g->r->nfact; i++)
-        if (!strcmp(fact, g->r->facts[i].name))
-            return i;
-
-    return -1;
-}
-
-
-static inline int target_id(graph_t *g, char *target)
-{
-    int i;
-
-    for (i = 0; i < g->r->ntarget; i++)
-        if (!strcmp(target, g->r->targets[i].name))
-            return g->r->nfact + i;
-
-    return -1;
-}
-
-
 static inline char *node_name(graph_t *g, int id)
 {
     if (id < g->r->nfact)
@@ -140,175 +139,91 @@ static inline char *node_name(graph_t *g, int id)
 
 static inline int node_id(graph_t *g, char *name)
 {
-    if (name[0] == '$')
-        return fact_id(g, name);
-    else
-        return target_id(g, name);
-}
-
-
-static inline int *edge_markp(graph_t *g, int n1, int n2)
-{
-    static int invalid = 0;
-
-    if (n1 >= 0 && n2 >= 0)
-        return g->edges + (n1 * g->nnode) + n2;
-    else
-        return &invalid;
-}
-
-
-static inline void mark_node(graph_t *g, int node)
-{
-    *edge_markp(g, node, node) = 1;
-}
-
-
-static inline void unmark_node(graph_t *g, int node)
-{
-    *edge_markp(g, node, node) = 0;
-}
+    int id;
 
+    if (name[0] == '$')
+        return fact_id(g->r, name);
+    else {
+        id = target_id(g->r, name);
 
-static inline int node_present(graph_t *g, int node)
-{
-    return *edge_markp(g, node, node) == 1;
+        return id < 0 ? -1 : g->r->nfact + id;
+    }
 }
 
 
 static graph_t *build_graph(mrp_resolver_t *r)
 {
     graph_t  *g;
-    int       tid, did, i, j;
+    int       tid, did, nedge, i, j;
     target_t *t;
 
     g = mrp_allocz(sizeof(*g));
 
-    if (g != NULL) {
-        g->r     = r;
-        g->nnode = r->nfact + r->ntarget;
-        g->edges = mrp_allocz(g->nnode * g->nnode * sizeof(*g->edges));
-
-        if (g->edges == NULL)
-            goto fail;
-
-        for (i = 0; i < r->ntarget; i++) {
-            t   = r->targets + i;
-            tid = r->nfact + i;
-
-            for (j = 0; j < t->ndepend; j++) {
-                mrp_debug("adding edge: %s <- %s", t->depends[j], t->name);
-                did = node_id(g, t->depends[j]);
-
-                if (did < 0)
-                    goto fail;
-
-                *edge_markp(g, did, tid) = 1;
-            }
-        }
-    }
-
-    return g;
+    if (g == NULL)
+        return NULL;
 
- fail:
-    if (g != NULL) {
-        mrp_free(g->edges);
-        mrp_free(g);
-    }
-    return NULL;
-}
+    g->r     = r;
+    g->nnode = r->nfact + r->ntarget;
 
+    for (i = 0, nedge = 0; i < r->ntarget; i++)
+        nedge += r->targets[i].ndepend;
 
-static int mark_present_nodes(graph_t *g, int target_idx)
-{
-    int       tid, did, i;
-    target_t *t;
+    g->nedge   = nedge;
+    g->in_idx  = mrp_allocz_array(int, g->nnode + 1);
+    g->out_idx = mrp_allocz_array(int, g->nnode + 1);
+    g->in      = mrp_allocz_array(int, nedge + 1);
+    g->out     = mrp_allocz_array(int, nedge + 1);
+    g->mark    = mrp_allocz_array(int, g->nnode);
+    g->stack   = mrp_allocz_array(int, g->nnode + 1);
+    g->next    = mrp_allocz_array(int, g->nnode + 1);
+    g->order   = mrp_allocz_array(int, g->nnode + 1);
 
-    tid = g->r->nfact + target_idx;
-    t   = g->r->targets + target_idx;
+    if (g->in_idx == NULL || g->out_idx == NULL || g->in == NULL ||
+        g->out == NULL || g->mark == NULL || g->stack == NULL ||
+        g->next == NULL || g->order == NULL)
+        goto fail;
 
-    if (node_present(g, tid))
-        return TRUE;
+    /* resolve dependencies, count dependents of each node */
+    for (i = 0, nedge = 0; i < r->ntarget; i++) {
+        t   = r->targets + i;
+        tid = r->nfact + i;
 
-    mark_node(g, tid);
+        g->in_idx[tid] = nedge;
 
-    for (i = 0; i < t->ndepend; i++) {
-        did = node_id(g, t->depends[i]);
+        for (j = 0; j < t->ndepend; j++) {
+            mrp_debug("adding edge: %s <- %s", t->depends[j], t->name);
+            did = node_id(g, t->depends[j]);
 
-        if (did < 0)
-            return FALSE;
+            if (did < 0) {
+                mrp_log_error("Unknown dependency '%s' for target '%s'.",
+                              t->depends[j], t->name);
+                errno = ENOENT;
+                goto fail;
+            }
 
-        if (*t->depends[i] == '$')
-            mark_node(g, did);
-        else {
-            if (!mark_present_nodes(g, did - g->r->nfact))
-                return FALSE;
+            g->in[nedge++] = did;
+            g->out_idx[did + 1]++;
         }
     }
 
-    return TRUE;
-}
-
-
-/*
- * queues we use for topological sorting
- */
-
-typedef struct {
-    int  size;                           /* max queue capacity */
-    int *items;                          /* queue item buffer */
-    int  head;                           /* push index */
-    int  tail;                           /* pop index */
-} que_t;
-
-#define EMPTY_QUE {.items = NULL }       /* initializer for empty queue */
-
-
-static int que_init(que_t *q, int size)
-{
-    mrp_free(q->items);
-
-    q->items = mrp_alloc(size * sizeof(*q->items));
-
-    if (q->items != NULL) {
-        q->size = size;
-        q->head = 0;
-        q->tail = 0;
-
-        return TRUE;
-    }
-    else
-        return FALSE;
-}
-
-
-static void que_cleanup(que_t *q)
-{
-    mrp_free(q->items);
-    q->items = NULL;
-}
+    g->in_idx[g->nnode] = nedge;        /* facts have no dependencies */
 
+    /* turn dependent counts into offsets, then fill in dependents */
+    for (i = 0; i < g->nnode; i++)
+        g->out_idx[i + 1] += g->out_idx[i];
 
-static void que_push(que_t *q, int item)
-{
-    /* we know the max size, so we don't check for overflow here */
-    q->items[q->tail++] = item;
-    q->tail            %= q->size;
-}
+    for (i = 0; i < g->nnode; i++)
+        g->next[i] = g->out_idx[i];
 
+    for (tid = r->nfact; tid < g->nnode; tid++)
+        for (j = g->in_idx[tid]; j < g->in_idx[tid + 1]; j++)
+            g->out[g->next[g->in[j]]++] = tid;
 
-static int que_pop(que_t *q, int *itemp)
-{
-    if (q->head != q->tail) {
-        *itemp   = q->items[q->head++];
-        q->head %= q->size;
+    return g;
 
-        return TRUE;
-    }
-    else {
-        *itemp = -1;
-        return FALSE;
-    }
+ fail:
+    free_graph(g);
+    return NULL;
 }
 
 
@@ -317,214 +232,200 @@ static int sort_graph(graph_t *g, int target_idx)
     /*
      * Notes:
      *
-     *   We perform a topological sort of the dependency graph here
-     *   for our target with the given idx. We include only nodes
-     *   for facts and targets which are relevant for our target.
-     *   These are the ones which our target directly or indirectly
-     *   depends on. We use the otherwise unused diagonal (no target
-     *   can depend on itself) of our edge matrix to mark which nodes
-     *   are present in the graph. Then we use the following algorithm
-     *   to sort the subgraph of relevant nodes:
-     *
-     *       initialize que L to be empty
-     *       initialize que Q with all nodes without incoming edges
-     *       while Q is not empty
-     *           pop a node <n> from Q
-     *           push <n> to L
-     *           remove all edges that start from <n>
-     *           for all nodes <m> where we removed an incoming node
-     *               if <m> has no more incoming edges
-     *                   push <m> to Q
+     *   We perform a topological sort of the subgraph relevant for the
+     *   target with the given idx. This subgraph consists of the facts
+     *   and targets our target directly or indirectly depends on. We
+     *   do a depth-first search along the dependency edges, emitting
+     *   each target after all of its dependencies (postorder). Hitting
+     *   a node which is still being visited means we have a cycle. The
+     *   visit marks are tagged with a per-target generation, so we never
+     *   need to clear them between targets.
      *
-     *       if there are any remaining edges
-     *           return an error about cyclic dependency
-     *       else
-     *           L is the sorted subgraph (our target is the last item in L)
+     *   Facts are collected in the order we first encounter them, but
+     *   the facts the target directly depends on are always put first,
+     *   in the same order as they appear in target->directs. This way
+     *   target->fact_stamps[i] corresponds to target->directs[i] for all
+     *   direct fact dependencies.
      *
-     *   The resulted sort order of our target is then used as the
-     *   dependency check/update order when the resolver is asked to
+     *   The resulting order (our target being the last item) is used as
+     *   the dependency check/update order when the resolver is asked to
      *   update that target.
      */
 
-    target_t *target;
-    int       edges[g->nnode * g->nnode];
-    que_t     L = EMPTY_QUE, Q = EMPTY_QUE;
-    int       i, j, m, id, node, nedge, nfact, ntarget;
+    mrp_resolver_t *r = g->r;
+    target_t       *target;
+    int             gen, top, node, dep, nfact, ntarget, i;
+    int            *facts, *targets;
 
-    target = g->r->targets + target_idx;
+    target  = r->targets + target_idx;
+    gen     = target_idx + 1;
+    facts   = g->order;
+    targets = g->order + g->nnode;
+    nfact   = 0;
+    ntarget = 0;
 
-    /* save full graph */
-    memcpy(edges, g->edges, sizeof(edges));
-
-    if (!que_init(&L, g->nnode + 1) || !que_init(&Q, g->nnode))
-        goto fail;
+    mrp_debug("-- target %s --", target->name);
 
-    /* find and mark relevant nodes in the graph */
-    mark_present_nodes(g, target_idx);
+    /* direct fact dependencies go first */
+    node = r->nfact + target_idx;
+    for (i = g->in_idx[node]; i < g->in_idx[node + 1]; i++) {
+        dep = g->in[i];
 
-    mrp_debug("-- target %s --", target->name);
-    /*dump_graph(g, stdout);*/
-
-    /* push all relevant facts, they do not depend on anything */
-    for (i = 0; i < g->r->nfact; i++) {
-        id = i;
-        if (node_present(g, id)) {
-            que_push(&Q, id);
-            unmark_node(g, id);
+        if (dep < r->nfact && g->mark[dep] != MARK_DONE(gen)) {
+            g->mark[dep]     = MARK_DONE(gen);
+            facts[nfact++] = dep;
         }
     }
 
-    /* push all relevant targets that have no dependencies */
-    for (i = 0; i < g->r->ntarget; i++) {
-        id = g->r->nfact + i;
-        if (g->r->targets[i].depends == NULL && node_present(g, id)) {
-            que_push(&Q, id);
-            unmark_node(g, id);
-        }
-    }
+    /* sort the subgraph (targets are collected downwards from the end) */
+    top             = 0;
+    g->stack[top]   = node;
+    g->next[top]    = g->in_idx[node];
+    g->mark[node]   = MARK_ACTIVE(gen);
 
-    /* try sorting the marked subgraph */
-    while (que_pop(&Q, &node)) {
-        que_push(&L, node);
+    while (top >= 0) {
+        node = g->stack[top];
 
-        mrp_debug("popped node %s", node_name(g, node));
+        if (g->next[top] < g->in_idx[node + 1]) {
+            dep = g->in[g->next[top]++];
 
-        for (m = 0; m < g->nnode; m++) {
-            if (m == node || !node_present(g, m))
+            if (dep < r->nfact) {
+                if (g->mark[dep] != MARK_DONE(gen)) {
+                    g->mark[dep]   = MARK_DONE(gen);
+                    facts[nfact++] = dep;
+                }
                 continue;
-            *edge_markp(g, node, m) = 0;
-            nedge = 0;
-            for (j = 0; j < g->nnode; j++) {
-                if (j == m)
-                    continue;
-                if (node_present(g, j) && *edge_markp(g, j, m))
-                    nedge++;
-            }
-            if (nedge == 0) {
-                mrp_debug("node %s empty, pushing it", node_name(g, m));
-                que_push(&Q, m);
-                unmark_node(g, m);
             }
-            else
-                mrp_debug("node %s not empty yet", node_name(g, m));
-        }
-    }
 
-    /* check if the subgraph has any remaining edges */
-    nedge = 0;
-    for (node = 0; node < g->nnode; node++) {
-        if (!node_present(g, node))
-            continue;
-        for (m = 0; m < g->nnode; m++) {
-            if (m == node || !node_present(g, m))
+            if (g->mark[dep] == MARK_DONE(gen))
                 continue;
-            if (*edge_markp(g, node, m) == 1) {
+
+            if (g->mark[dep] == MARK_ACTIVE(gen)) {
+                mrp_debug("cycle: %s <- %s", node_name(g, node),
+                          node_name(g, dep));
                 errno = ELOOP;
-                goto fail;
+                return -1;
             }
+
+            top++;
+            g->stack[top] = dep;
+            g->next[top]  = g->in_idx[dep];
+            g->mark[dep]  = MARK_ACTIVE(gen);
+        }
+        else {
+            g->mark[node] = MARK_DONE(gen);
+            ntarget++;
+            targets[-ntarget] = node - r->nfact;
+            top--;
         }
     }
 
+    targets -= ntarget;
+
     mrp_debug("----- %s: graph sorted successfully -----", target->name);
 
-    for (i = 0; i < L.tail; i++)
-        mrp_debug(" %s", node_name(g, L.items[i]));
+    /*
+     * Notes:
+     *   Since targets were collected from the end of the buffer
+     *   downwards, they're in reverse postorder now. Flip them around.
+     */
+
+    for (i = 0; i < ntarget / 2; i++) {
+        dep                        = targets[i];
+        targets[i]                 = targets[ntarget - 1 - i];
+        targets[ntarget - 1 - i]   = dep;
+    }
+
+    for (i = 0; i < nfact; i++)
+        mrp_debug(" %s", r->facts[facts[i]].name);
+    for (i = 0; i < ntarget; i++)
+        mrp_debug(" %s", r->targets[targets[i]].name);
     mrp_debug("-----");
 
     /* save the result in the given target */
-    if (L.tail > 0) {
-        nfact   = 0;
-        ntarget = 0;
-
-        for (i = 0; i < L.tail; i++) {
-            if (L.items[i] < g->r->nfact)
-                nfact++;
-            else
-                ntarget++;
-        }
+    if (nfact > 0) {
+        target->update_facts = mrp_alloc_array(int, nfact + 1);
+        target->fact_stamps  = mrp_allocz_array(uint32_t, nfact);
 
-        if (nfact > 0) {
-            target->update_facts = mrp_alloc_array(int, nfact + 1);
-            target->fact_stamps  = mrp_allocz_array(uint32_t, nfact);
+        if (target->update_facts == NULL || target->fact_stamps == NULL)
+            return -1;
 
-            if (target->update_facts != NULL && target->fact_stamps != NULL) {
-                for (i = 0; i < nfact; i++)
-                    target->update_facts[i] = L.items[i];
-                target->update_facts[i] = -1;
-            }
-            else
-                goto fail;
-        }
+        memcpy(target->update_facts, facts, nfact * sizeof(facts[0]));
+        target->update_facts[nfact] = -1;
+        target->nfact               = nfact;
+    }
 
-        if (ntarget > 0) {
-            target->update_targets = mrp_alloc_array(int, ntarget + 1);
-            if (target->update_targets != NULL) {
-                for (i = 0; i < ntarget; i++)
-                    target->update_targets[i] = L.items[nfact+i] - g->r->nfact;
-                target->update_targets[i] = -1;
-            }
-            else
-                goto fail;
-        }
+    target->update_targets = mrp_alloc_array(int, ntarget + 1);
 
-        target->ndirect = 0;
-        target->directs = mrp_allocz_array(int, target->ndepend);
+    if (target->update_targets == NULL)
+        return -1;
 
-        if (target->ndepend == 0 || target->directs != NULL) {
-            fact_t   *f;
-            target_t *t;
+    memcpy(target->update_targets, targets, ntarget * sizeof(targets[0]));
+    target->update_targets[ntarget] = -1;
 
-            for (i = 0; i < target->ndepend; i++) {
-                if (*target->depends[i] != '$')
-                    continue;
+    /* save direct dependencies, facts first */
+    target->ndirect = 0;
+    target->directs = mrp_allocz_array(int, target->ndepend);
 
-                f = lookup_fact(g->r, target->depends[i]);
+    if (target->ndepend > 0 && target->directs == NULL)
+        return -1;
 
-                if (f != NULL)
-                    target->directs[target->ndirect++] = f - g->r->facts;
-                else
-                    target->directs[target->ndirect++] = -1;
-            }
+    node = r->nfact + target_idx;
+    for (i = g->in_idx[node]; i < g->in_idx[node + 1]; i++)
+        if (g->in[i] < r->nfact)
+            target->directs[target->ndirect++] = g->in[i];
+    for (i = g->in_idx[node]; i < g->in_idx[node + 1]; i++)
+        if (g->in[i] >= r->nfact)
+            target->directs[target->ndirect++] = g->in[i];
 
-            for (i = 0; i < target->ndepend; i++) {
-                if (*target->depends[i] == '$')
-                    continue;
+    return 0;
+}
 
-                t = lookup_target(g->r, target->depends[i]);
 
-                if (t != NULL)
-                    target->directs[target->ndirect++] = g->r->nfact +
-                        t - g->r->targets;
-                else
-                    target->directs[target->ndirect++] = -1;
-            }
-        }
-        else
-            goto fail;
-    }
+static int build_dependents(graph_t *g)
+{
+    mrp_resolver_t *r = g->r;
+    int            *idx, *ids, i;
 
-    que_cleanup(&L);
-    que_cleanup(&Q);
+    /*
+     * Hand the dependents of each node over to the resolver as its
+     * reverse dependency index, translating node ids to target indices.
+     */
 
-    /* restore the original full graph */
-    memcpy(g->edges, edges, sizeof(edges));
+    idx = mrp_alloc_array(int, g->nnode + 1);
+    ids = mrp_alloc_array(int, g->nedge + 1);
 
-    return 0;
+    if (idx == NULL || ids == NULL) {
+        mrp_free(idx);
+        mrp_free(ids);
+        return FALSE;
+    }
 
- fail:
-    que_cleanup(&L);
-    que_cleanup(&Q);
+    memcpy(idx, g->out_idx, (g->nnode + 1) * sizeof(idx[0]));
 
-    memcpy(g->edges, edges, sizeof(edges));
+    for (i = 0; i < g->nedge; i++)
+        ids[i] = g->out[i] - r->nfact;
 
-    return -1;
+    mrp_free(r->dependents.idx);
+    mrp_free(r->dependents.ids);
+    r->dependents.idx = idx;
+    r->dependents.ids = ids;
+
+    return TRUE;
 }
 
 
 static void free_graph(graph_t *g)
 {
     if (g != NULL) {
-        mrp_free(g->edges);
+        mrp_free(g->in_idx);
+        mrp_free(g->in);
+        mrp_free(g->out_idx);
+        mrp_free(g->out);
+        mrp_free(g->mark);
+        mrp_free(g->stack);
+        mrp_free(g->next);
+        mrp_free(g->order);
         mrp_free(g);
     }
 }
@@ -536,15 +437,10 @@ static void dump_graph(graph_t *g, FILE *fp)
 
     fprintf(fp, "Graph edges:\n");
 
-    fprintf(fp, "  %20.20s ", "");
-    for (i = 0; i < g->nnode; i++)
-        fprintf(fp, " %d", i % 10);
-    fprintf(fp, "\n");
-
     for (i = 0; i < g->nnode; i++) {
-        fprintf(fp, "  %20.20s: ", node_name(g, i));
-        for (j = 0; j < g->nnode; j++)
-            fprintf(fp, "%d ", *edge_markp(g, i, j));
+        fprintf(fp, "  %20.20s:", node_name(g, i));
+        for (j = g->out_idx[i]; j < g->out_idx[i + 1]; j++)
+            fprintf(fp, " %s", node_name(g, g->out[j]));
         fprintf(fp, "\n");
     }
 }
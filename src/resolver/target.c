@@ -30,10 +30,13 @@
 #include <stdarg.h>
 #include <errno.h>
 #include <alloca.h>
+#include <time.h>
 
 #include <murphy/common/log.h>
 #include <murphy/common/mm.h>
 #include <murphy/common/list.h>
+#include <murphy/common/utils.h>
+#include <murphy/common/hashtbl.h>
 
 #include <murphy/core/scripting.h>
 
@@ -43,6 +46,7 @@
 #include "events.h"
 #include "target-sorter.h"
 #include "target.h"
+#include "stats.h"
 
 
 
@@ -106,15 +110,28 @@ void destroy_targets(mrp_resolver_t *r)
     target_t *t;
     int       i;
 
+    if (r->target_tbl != NULL) {
+        mrp_htbl_destroy(r->target_tbl, FALSE);
+        r->target_tbl = NULL;
+    }
+
     for (i = 0, t = r->targets; i < r->ntarget; i++, t++)
         purge_target(t);
 
     mrp_free(r->targets);
+    mrp_free(r->dependents.idx);
+    mrp_free(r->dependents.ids);
+    mrp_free(r->journal);
 
     if (r->auto_scheduled != NULL) {
         mrp_del_deferred(r->auto_scheduled);
         r->auto_scheduled = NULL;
     }
+
+    if (r->coalesce.timer != NULL) {
+        mrp_del_timer(r->coalesce.timer);
+        r->coalesce.timer = NULL;
+    }
 }
 
 
@@ -122,15 +139,26 @@ target_t *create_target(mrp_resolver_t *r, const char *target,
                         const char **depends, int ndepend,
                         const char *script_type, const char *script_source)
 {
-    target_t *t;
-    size_t    old_size, new_size;
-    int       i, j, found, nduplicate;
-
-    for (i = 0, t = r->targets; i < r->ntarget; i++, t++) {
-        if (!strcmp(t->name, target)) {
-            errno = EEXIST;
+    mrp_htbl_config_t  hcfg;
+    target_t          *t;
+    size_t             old_size, new_size;
+    int                i, j, found, nduplicate;
+
+    if (r->target_tbl == NULL) {
+        mrp_clear(&hcfg);
+        hcfg.nentry  = 64;
+        hcfg.comp    = mrp_string_comp;
+        hcfg.hash    = mrp_string_hash;
+        hcfg.free    = NULL;
+        hcfg.nbucket = 512;
+
+        if ((r->target_tbl = mrp_htbl_create(&hcfg)) == NULL)
             return NULL;
-        }
+    }
+
+    if (target_id(r, target) >= 0) {
+        errno = EEXIST;
+        return NULL;
     }
 
     old_size = sizeof(*r->targets) *  r->ntarget;
@@ -199,6 +227,10 @@ target_t *create_target(mrp_resolver_t *r, const char *target,
         }
     }
 
+    if (!mrp_htbl_insert(r->target_tbl, t->name,
+                         (void *)(ptrdiff_t)r->ntarget))
+        goto undo_and_fail;
+
     return t;
 
 
@@ -321,13 +353,15 @@ static int older_than_facts(mrp_resolver_t *r, target_t *t)
                 return TRUE;
         }
 #else
+        /* direct facts are sorted first in update_facts (and stamps) */
         for (i = 0; i < t->ndirect; i++) {
             id = t->directs[i];
 
-            if (id < r->nfact) {
-                if (fact_stamp(r, id) > t->fact_stamps[i])
-                    return TRUE;
-            }
+            if (id >= r->nfact)
+                break;
+
+            if (fact_stamp(r, id) > t->fact_stamps[i])
+                return TRUE;
         }
 #endif
     }
@@ -342,14 +376,20 @@ static int older_than_targets(mrp_resolver_t *r, target_t *t)
     target_t *dep;
 
     /*
-     * Although the target itself is always the last item in its own
-     * sorted target dependencies (as the list is the topologically
-     * sorted dependency graph) we don't special case this out here as
-     * a target cannot be newer than itself by definition.
+     * It is enough to check the direct target dependencies here. Any
+     * indirect dependency newer than us has either been propagated to
+     * one of our direct dependencies (which are checked/updated before
+     * us in the sorted update order), or its update has failed in which
+     * case we never get here.
      */
 
-    for (i = 0; (id = t->update_targets[i]) >= 0; i++) {
-        dep = r->targets + id;
+    for (i = 0; i < t->ndirect; i++) {
+        id = t->directs[i];
+
+        if (id < r->nfact)
+            continue;
+
+        dep = r->targets + (id - r->nfact);
 
         if (dep->stamp > t->stamp)
             return TRUE;
@@ -359,54 +399,102 @@ static int older_than_targets(mrp_resolver_t *r, target_t *t)
 }
 
 
-static void save_fact_stamps(mrp_resolver_t *r, target_t *t, uint32_t *buf)
+void mark_dependents_dirty(mrp_resolver_t *r, int node)
 {
-    int id, idx, i;
+    target_t *dep;
+    int       i, id;
+
+    /*
+     * Mark all targets directly or indirectly depending on the given
+     * graph node dirty. We can stop descending at targets which are
+     * already dirty, since their dependents have already been marked.
+     */
+
+    if (r->dependents.idx == NULL)
+        return;
 
-    if (t->update_facts != NULL) {
-        id  = t - r->targets;
-        idx = id * r->nfact;
+    for (i = r->dependents.idx[node]; i < r->dependents.idx[node + 1]; i++) {
+        id  = r->dependents.ids[i];
+        dep = r->targets + id;
 
-        for (i = 0; (id = t->update_facts[i]) >= 0; i++, idx++)
-            buf[idx] = t->fact_stamps[i];
+        if (!dep->dirty) {
+            dep->dirty = TRUE;
+            mark_dependents_dirty(r, r->nfact + id);
+        }
     }
 }
 
 
-static void restore_fact_stamps(mrp_resolver_t *r, target_t *t, uint32_t *buf)
+static void check_direct_facts(mrp_resolver_t *r, target_t *t)
 {
-    int id, idx, i;
+    int i, id;
 
-    if (t->update_facts != NULL) {
-        id  = t - r->targets;
-        idx = id * r->nfact;
+    for (i = 0; i < t->ndirect; i++) {
+        id = t->directs[i];
 
-        for (i = 0; (id = t->update_facts[i]) >= 0; i++, idx++)
-            t->fact_stamps[i] = buf[idx];
+        if (id >= r->nfact)
+            break;
+
+        fact_changed(r, id);
     }
 }
 
 
-static void save_target_stamps(mrp_resolver_t *r, target_t *t, uint32_t *buf)
+static int save_fact_stamps(mrp_resolver_t *r, target_t *t)
 {
-    target_t *dep;
-    int       i, id;
+    uint32_t *journal;
+    int       size;
 
-    for (i = 0; (id = t->update_targets[i]) >= 0; i++) {
-        dep = r->targets + id;
-        save_fact_stamps(r, dep, buf);
+    /*
+     * Notes:
+     *     The journal is a stack of records, each consisting of the
+     *     fact stamps of a target followed by the index of the target.
+     *     This lets us restore stamps in reverse order on rollback.
+     */
+
+    if (r->njournal + t->nfact + 1 > r->journal_size) {
+        size = r->journal_size ? 2 * r->journal_size : 64;
+
+        while (size < r->njournal + t->nfact + 1)
+            size *= 2;
+
+        journal = mrp_realloc(r->journal, size * sizeof(*journal));
+
+        if (journal == NULL)
+            return FALSE;
+
+        r->journal      = journal;
+        r->journal_size = size;
     }
+
+    if (t->nfact > 0)
+        memcpy(r->journal + r->njournal, t->fact_stamps,
+               t->nfact * sizeof(*t->fact_stamps));
+
+    r->njournal += t->nfact;
+    r->journal[r->njournal++] = t - r->targets;
+
+    return TRUE;
 }
 
 
-static void restore_target_stamps(mrp_resolver_t *r, target_t *t, uint32_t *buf)
+static void restore_fact_stamps(mrp_resolver_t *r, int base)
 {
-    target_t *dep;
-    int       i, id;
+    target_t *t;
+    int       id;
 
-    for (i = 0; (id = t->update_targets[i]) >= 0; i++) {
-        dep = r->targets + id;
-        restore_fact_stamps(r, dep, buf);
+    while (r->njournal > base) {
+        id = r->journal[--r->njournal];
+        t  = r->targets + id;
+
+        r->njournal -= t->nfact;
+
+        if (t->nfact > 0)
+            memcpy(t->fact_stamps, r->journal + r->njournal,
+                   t->nfact * sizeof(*t->fact_stamps));
+
+        t->dirty = TRUE;
+        mark_dependents_dirty(r, r->nfact + id);
     }
 }
 
@@ -420,6 +508,25 @@ static void update_target_stamps(mrp_resolver_t *r, target_t *t)
             t->fact_stamps[i] = fact_stamp(r, id);
 
     t->stamp = r->stamp;
+    t->dirty = FALSE;
+
+    mark_dependents_dirty(r, r->nfact + (t - r->targets));
+}
+
+
+static int execute_target(mrp_resolver_t *r, target_t *t)
+{
+    uint64_t start;
+    int      status;
+
+    if (MRP_LIKELY(r->stats == NULL))
+        return mrp_execute_script(t->script, r->ctbl);
+
+    start  = stats_now();
+    status = mrp_execute_script(t->script, r->ctbl);
+    stats_executed(r, t, start, status);
+
+    return status;
 }
 
 
@@ -427,10 +534,12 @@ static int update_target(mrp_resolver_t *r, target_t *t)
 {
     mqi_handle_t  tx;
     target_t     *dep;
-    uint32_t      stamps[r->ntarget * r->nfact];
-    int           i, id, status, needs_update, level;
+    int           i, id, status, needs_update, level, base;
+    uint32_t      nexec, nskip;
+    uint64_t      start, commit;
 
-    tx = start_transaction(r);
+    start = r->stats ? stats_now() : 0;
+    tx    = start_transaction(r);
 
     if (tx == MQI_HANDLE_INVALID) {
         if (errno != 0)
@@ -444,10 +553,25 @@ static int update_target(mrp_resolver_t *r, target_t *t)
     level = r->level++;
     emit_resolver_event(r, RESOLVER_UPDATE_STARTED, t->name, level);
 
-    save_target_stamps(r, t, stamps);
+    /*
+     * Notes:
+     *     Only dirty targets need to be checked. A target is marked
+     *     dirty whenever any of its direct or indirect dependencies
+     *     changes (a fact stamp changes or a target gets updated). We
+     *     check the direct facts of each target before looking at it,
+     *     to catch fact changes we have not been notified about yet
+     *     (for instance ones made by earlier scripts of this update).
+     *     Targets without fact dependencies are always updated.
+     */
 
+    base         = r->njournal;
+    nexec        = 0;
+    nskip        = 0;
+    commit       = 0;
     status       = TRUE;
-    needs_update = older_than_facts(r, t);
+    check_direct_facts(r, t);
+    needs_update = (t->dirty || t->update_facts == NULL) &&
+        older_than_facts(r, t);
 
     for (i = 0; (id = t->update_targets[i]) >= 0; i++) {
         dep = r->targets + id;
@@ -455,62 +579,112 @@ static int update_target(mrp_resolver_t *r, target_t *t)
         if (dep == t)
             break;
 
-        /*                              hmm... is this really needed? */
+        check_direct_facts(r, dep);
+
+        if (!dep->dirty && dep->update_facts != NULL) {
+            stats_skipped(r, dep);
+            nskip++;
+            continue;
+        }
+
         if (older_than_facts(r, dep) || older_than_targets(r, dep)) {
             needs_update = TRUE;
-            status       = mrp_execute_script(dep->script, r->ctbl);
+
+            if (!save_fact_stamps(r, dep)) {
+                status = -ENOMEM;
+                break;
+            }
+
+            status = execute_target(r, dep);
+            nexec++;
 
             if (status <= 0)
                 break;
             else
                 update_target_stamps(r, dep);
         }
+        else {
+            dep->dirty = FALSE;
+            stats_skipped(r, dep);
+            nskip++;
+        }
     }
 
     if (needs_update && status > 0) {
-        status = mrp_execute_script(t->script, r->ctbl);
+        if (save_fact_stamps(r, t)) {
+            status = execute_target(r, t);
+            nexec++;
+        }
+        else
+            status = -ENOMEM;
 
         if (status > 0)
             update_target_stamps(r, t);
     }
+    else if (status > 0) {
+        t->dirty = FALSE;
+        stats_skipped(r, t);
+        nskip++;
+    }
 
     if (status <= 0) {
         rollback_transaction(r, tx);
-        restore_target_stamps(r, t, stamps);
+        restore_fact_stamps(r, base);
         emit_resolver_event(r, RESOLVER_UPDATE_FAILED, t->name, level);
     }
     else {
+        commit = r->stats ? stats_now() : 0;
+
         if (!commit_transaction(r, tx)) {
-            restore_target_stamps(r, t, stamps);
+            restore_fact_stamps(r, base);
             if (errno != 0)
                 status = -errno;
             else
                 status = -EINVAL;
         }
+
+        if (MRP_UNLIKELY(r->stats != NULL)) {
+            stats_committed(r, commit);
+            commit = stats_now() - commit;
+        }
     }
 
+    /* nested updates can still be rolled back by the outermost one */
+    if (level == 0)
+        r->njournal = 0;
+
     if (status <= 0)
         emit_resolver_event(r, RESOLVER_UPDATE_FAILED, t->name, level);
     else
         emit_resolver_event(r, RESOLVER_UPDATE_DONE  , t->name, level);
 
+    if (MRP_UNLIKELY(r->stats != NULL))
+        stats_updated(r, t, level, status, nexec, nskip, start, commit);
+
     r->level--;
 
     return status;
 }
 
 
-target_t *lookup_target(mrp_resolver_t *r, const char *name)
+int target_id(mrp_resolver_t *r, const char *name)
 {
-   target_t *t;
-    int       i;
+    void *id;
 
-    for (i = 0, t = r->targets; i < r->ntarget; i++, t++) {
-        if (!strcmp(t->name, name))
-            return t;
-    }
+    if (r->target_tbl == NULL)
+        return -1;
 
-    return NULL;
+    id = mrp_htbl_lookup(r->target_tbl, (void *)name);
+
+    return id != NULL ? (int)(ptrdiff_t)id - 1 : -1;
+}
+
+
+target_t *lookup_target(mrp_resolver_t *r, const char *name)
+{
+    int id = target_id(r, name);
+
+    return id >= 0 ? r->targets + id : NULL;
 }
 
 
@@ -534,8 +708,25 @@ int update_target_by_id(mrp_resolver_t *r, int id)
 }
 
 
+static uint64_t time_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
 static int autoupdate_target(mrp_resolver_t *r)
 {
+    coalesce_t *c = &r->coalesce;
+
+    c->pending = FALSE;
+    c->first   = 0;
+    c->last    = time_now();
+    c->nupdate++;
+
     if (r->auto_update != NULL)
         return mrp_resolver_update_targetl(r, r->auto_update->name, NULL);
     else
@@ -553,24 +744,182 @@ static void autoupdate_cb(mrp_deferred_t *d, void *user_data)
 }
 
 
-int schedule_target_autoupdate(mrp_resolver_t *r)
+static void delayed_autoupdate_cb(mrp_timer_t *t, void *user_data)
 {
-    if (r->auto_update != NULL) {
-        if (r->ctx != NULL && r->auto_scheduled == NULL)
-            r->auto_scheduled = mrp_add_deferred(r->ctx->ml, autoupdate_cb, r);
+    mrp_resolver_t *r = (mrp_resolver_t *)user_data;
 
-        if (r->auto_scheduled != NULL)
-            mrp_enable_deferred(r->auto_scheduled);
-        else
+    mrp_debug("running delayed target autoupdate");
+    mrp_del_timer(t);
+    r->coalesce.timer = NULL;
+    autoupdate_target(r);
+}
+
+
+static uint32_t autoupdate_delay(mrp_resolver_t *r, uint32_t min_interval,
+                                 uint64_t now)
+{
+    coalesce_t *c = &r->coalesce;
+    uint64_t    delay, latest;
+
+    /*
+     * Delay the update by the debounce window, or more if necessary to
+     * honour the minimum update interval, but never beyond the maximum
+     * allowed delay counted from the first pending change.
+     */
+
+    delay = c->window;
+
+    if (min_interval > 0 && c->last + min_interval > now)
+        if (c->last + min_interval - now > delay)
+            delay = c->last + min_interval - now;
+
+    if (c->max_delay > 0) {
+        latest = c->first + c->max_delay;
+
+        if (now + delay > latest)
+            delay = latest > now ? latest - now : 0;
+    }
+
+    return (uint32_t)delay;
+}
+
+
+static int schedule_immediate_autoupdate(mrp_resolver_t *r)
+{
+    coalesce_t *c = &r->coalesce;
+
+    if (c->timer != NULL) {
+        mrp_del_timer(c->timer);
+        c->timer = NULL;
+    }
+
+    if (r->ctx != NULL && r->auto_scheduled == NULL)
+        r->auto_scheduled = mrp_add_deferred(r->ctx->ml, autoupdate_cb, r);
+
+    if (r->auto_scheduled != NULL)
+        mrp_enable_deferred(r->auto_scheduled);
+    else
+        return FALSE;
+
+    c->pending = TRUE;
+
+    mrp_debug("scheduled target autoupdate (%s)", r->auto_update->name);
+
+    return TRUE;
+}
+
+
+int schedule_target_autoupdate(mrp_resolver_t *r, uint32_t min_interval)
+{
+    coalesce_t *c = &r->coalesce;
+    uint64_t    now;
+    uint32_t    delay;
+
+    if (r->auto_update == NULL)
+        return TRUE;
+
+    c->nrequest++;
+
+    if (c->pending && c->timer == NULL) {
+        mrp_debug("target autoupdate already scheduled");
+        return TRUE;
+    }
+
+    if (c->window == 0 && min_interval == 0)
+        return schedule_immediate_autoupdate(r);
+
+    now = time_now();
+
+    if (!c->pending)
+        c->first = now;
+
+    delay = autoupdate_delay(r, min_interval, now);
+
+    if (delay == 0)
+        return schedule_immediate_autoupdate(r);
+
+    if (c->timer != NULL)
+        mrp_mod_timer(c->timer, delay);
+    else {
+        if (r->ctx != NULL)
+            c->timer = mrp_add_timer(r->ctx->ml, delay,
+                                     delayed_autoupdate_cb, r);
+
+        if (c->timer == NULL)
             return FALSE;
+    }
+
+    c->pending = TRUE;
+
+    mrp_debug("scheduled target autoupdate (%s) in %u msecs",
+              r->auto_update->name, delay);
+
+    return TRUE;
+}
+
 
-        mrp_debug("scheduled target autoupdate (%s)", r->auto_update->name);
+int mrp_resolver_set_coalescing(mrp_resolver_t *r, unsigned int window,
+                                unsigned int max_delay)
+{
+    coalesce_t *c = &r->coalesce;
+
+    if (max_delay > 0 && max_delay < window) {
+        errno = EINVAL;
+        return FALSE;
     }
 
+    c->window    = window;
+    c->max_delay = max_delay;
+
     return TRUE;
 }
 
 
+int mrp_resolver_set_min_interval(mrp_resolver_t *r, const char *name,
+                                  unsigned int msecs)
+{
+    target_t *t;
+
+    if (name[0] == '$')
+        return set_fact_interval(r, name, msecs);
+
+    if ((t = lookup_target(r, name)) == NULL) {
+        errno = ENOENT;
+        return FALSE;
+    }
+
+    t->min_interval = msecs;
+
+    return TRUE;
+}
+
+
+void mrp_resolver_dump_coalescing(mrp_resolver_t *r, FILE *fp)
+{
+    coalesce_t *c = &r->coalesce;
+    uint32_t    done, saved;
+    int         i;
+
+    done  = c->nupdate + (c->pending ? 1 : 0);
+    saved = c->nrequest > done ? c->nrequest - done : 0;
+
+    fprintf(fp, "autoupdate coalescing: window %u ms, max. delay %u ms\n",
+            c->window, c->max_delay);
+    fprintf(fp, "  %u update%s requested, %u run, %u saved\n",
+            c->nrequest, c->nrequest != 1 ? "s" : "", c->nupdate, saved);
+
+    for (i = 0; i < r->nfact; i++)
+        if (r->facts[i].min_interval > 0)
+            fprintf(fp, "  %s: min. interval %u ms\n", r->facts[i].name,
+                    r->facts[i].min_interval);
+
+    for (i = 0; i < r->ntarget; i++)
+        if (r->targets[i].min_interval > 0)
+            fprintf(fp, "  %s: min. interval %u ms\n", r->targets[i].name,
+                    r->targets[i].min_interval);
+}
+
+
 void dump_targets(mrp_resolver_t *r, FILE *fp)
 {
     int       i, j, idx;
@@ -721,10 +1070,11 @@ void mrp_resolver_dump_dot_graph(mrp_resolver_t *r, FILE *fp)
 {
     int i, j;
     target_t *t;
+    target_stats_t *ts;
 
     fprintf(fp, "digraph decision_graph {\n");
 
-    /* vertexes */
+    /* vertexes, annotated with update timings if we have them */
     for (i = 0; i < r->ntarget; i++) {
         dot_node_type_t i_type;
         char *name;
@@ -735,7 +1085,15 @@ void mrp_resolver_dump_dot_graph(mrp_resolver_t *r, FILE *fp)
             continue;
 
         i_type = dot_node_type(t->name);
-        fprintf(fp, "    %s [shape=%s];\n", name, dot_get_shape(i_type));
+        ts     = target_stats(r, t);
+
+        if (ts != NULL && ts->nexec > 0)
+            fprintf(fp, "    %s [shape=%s, label=\"%s\\n%ux, avg %.1f us, "
+                    "max %.1f us\"];\n", name, dot_get_shape(i_type), name,
+                    ts->nexec, (double)ts->total / ts->nexec / 1000.0,
+                    (double)ts->max / 1000.0);
+        else
+            fprintf(fp, "    %s [shape=%s];\n", name, dot_get_shape(i_type));
     }
 
     fprintf(fp, "\n");
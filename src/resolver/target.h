@@ -45,9 +45,11 @@ int prepare_target_scripts(mrp_resolver_t *r);
 
 int update_target_by_name(mrp_resolver_t *r, const char *name);
 int update_target_by_id(mrp_resolver_t *r, int id);
-int schedule_target_autoupdate(mrp_resolver_t *r);
+int schedule_target_autoupdate(mrp_resolver_t *r, uint32_t min_interval);
 
 target_t *lookup_target(mrp_resolver_t *s, const char *name);
+int target_id(mrp_resolver_t *r, const char *name);
+void mark_dependents_dirty(mrp_resolver_t *r, int node);
 void dump_targets(mrp_resolver_t *r, FILE *fp);
 
 /** Dump the resolver dependency graph in DOT format. */
@@ -0,0 +1,584 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mm.h>
+#include <murphy/common/log.h>
+#include <murphy/common/mainloop.h>
+#include <murphy/core/context.h>
+#include <murphy/core/scripting.h>
+#include <murphy/resolver/resolver.h>
+
+#include <murphy-db/mqi.h>
+
+/*
+ * Check the dependency tracking of the resolver: a changed fact must
+ * mark dirty exactly the targets which directly or indirectly depend on
+ * it, and an update must then run exactly the scripts of those targets.
+ * The expected dependents are computed here independently from the
+ * dependencies the ruleset was generated from. The same is checked on a
+ * small hand-written ruleset and on a generated one with a few thousand
+ * targets, which is also used to time preparing and updating.
+ */
+
+#include "../resolver-types.h"
+
+#define AUTOUPDATE "autoupdate"
+
+#define MAX_DEPEND 4                     /* max. dependencies per target */
+
+typedef struct {
+    int   ndepend;                       /* number of dependencies */
+    int   depends[MAX_DEPEND];           /* fact (< 0) and target deps */
+} rule_t;
+
+#define FACT_DEP(id)  (-(id) - 1)        /* encode fact id as a dependency */
+#define DEP_FACT(dep) (-(dep) - 1)       /* decode fact id from dependency */
+
+typedef struct {
+    const char     *name;                /* test name */
+    mrp_resolver_t *r;                   /* resolver being tested */
+    rule_t         *rules;               /* target dependencies */
+    int             ntarget;             /* number of targets */
+    int             nfact;               /* number of facts */
+    mqi_handle_t   *tables;              /* fact tables */
+    char           *expected;            /* expected dirty targets */
+    char           *executed;            /* executed targets */
+    double          utime;               /* time spent updating */
+} ruleset_t;
+
+typedef struct {
+    uint32_t value;
+} fact_row_t;
+
+static mrp_context_t ctx;
+static int           nexecuted;
+static int           nfailed;
+
+
+static void fail(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    printf("FAIL: ");
+    vprintf(fmt, ap);
+    printf("\n");
+    va_end(ap);
+
+    nfailed++;
+}
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+
+static int execute_target(mrp_scriptlet_t *script, mrp_context_tbl_t *ctbl)
+{
+    ruleset_t *rs = script->compiled;
+    int        id = (int)(ptrdiff_t)script->data;
+
+    MRP_UNUSED(ctbl);
+
+    rs->executed[id] = TRUE;
+    nexecuted++;
+
+    return TRUE;
+}
+
+
+static mrp_interpreter_t recorder = {
+    { NULL, NULL },
+    "dependency-test",
+    NULL,
+    NULL,
+    NULL,
+    execute_target,
+    NULL
+};
+
+
+static int create_ruleset(ruleset_t *rs)
+{
+    MQI_COLUMN_DEFINITION_LIST(coldefs,
+        MQI_COLUMN_DEFINITION("value", MQI_UNSIGNED)
+    );
+
+    const char *depends[MAX_DEPEND];
+    char        name[64], names[MAX_DEPEND][64];
+    rule_t     *rule;
+    int         i, j, dep;
+
+    rs->tables   = mrp_allocz_array(mqi_handle_t, rs->nfact);
+    rs->expected = mrp_allocz(rs->ntarget);
+    rs->executed = mrp_allocz(rs->ntarget);
+
+    if (rs->tables == NULL || rs->expected == NULL || rs->executed == NULL)
+        return FALSE;
+
+    for (i = 0; i < rs->nfact; i++) {
+        snprintf(name, sizeof(name), "%s_fact%d", rs->name, i);
+        rs->tables[i] = MQI_CREATE_TABLE(name, MQI_TEMPORARY, coldefs, NULL);
+
+        if (rs->tables[i] == MQI_HANDLE_INVALID) {
+            fail("%s: failed to create table '%s'", rs->name, name);
+            return FALSE;
+        }
+    }
+
+    if ((rs->r = mrp_resolver_create(&ctx)) == NULL)
+        return FALSE;
+
+    for (i = 0; i < rs->ntarget; i++) {
+        rule = rs->rules + i;
+
+        for (j = 0; j < rule->ndepend; j++) {
+            dep = rule->depends[j];
+
+            if (dep < 0)
+                snprintf(names[j], sizeof(names[j]), "$%s_fact%d",
+                         rs->name, DEP_FACT(dep));
+            else
+                snprintf(names[j], sizeof(names[j]), "target%d", dep);
+
+            depends[j] = names[j];
+        }
+
+        snprintf(name, sizeof(name), "target%d", i);
+
+        if (!mrp_resolver_add_prepared_target(rs->r, name, depends,
+                                              rule->ndepend, &recorder, rs,
+                                              (void *)(ptrdiff_t)i)) {
+            fail("%s: failed to add target '%s'", rs->name, name);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+
+static void destroy_ruleset(ruleset_t *rs)
+{
+    int i;
+
+    mrp_resolver_destroy(rs->r);
+
+    for (i = 0; i < rs->nfact; i++)
+        if (rs->tables[i] != MQI_HANDLE_INVALID)
+            mqi_drop_table(rs->tables[i]);
+
+    mrp_free(rs->tables);
+    mrp_free(rs->expected);
+    mrp_free(rs->executed);
+}
+
+
+static int prepare_ruleset(ruleset_t *rs)
+{
+    if (!mrp_resolver_enable_autoupdate(rs->r, AUTOUPDATE)) {
+        fail("%s: failed to enable autoupdate", rs->name);
+        return FALSE;
+    }
+
+    if (!mrp_resolver_prepare(rs->r)) {
+        fail("%s: failed to prepare targets", rs->name);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+static int update_ruleset(ruleset_t *rs)
+{
+    double start;
+    int    status;
+
+    memset(rs->executed, 0, rs->ntarget);
+    nexecuted = 0;
+
+    start     = now();
+    status    = mrp_resolver_update_target(rs->r, AUTOUPDATE, NULL);
+    rs->utime += now() - start;
+
+    if (status <= 0) {
+        fail("%s: failed to update '%s'", rs->name, AUTOUPDATE);
+        return -1;
+    }
+
+    return nexecuted;
+}
+
+
+static void change_fact(ruleset_t *rs, int fact)
+{
+    static uint32_t value;
+    fact_row_t      row, *rows[2];
+    mqi_handle_t    tx;
+
+    MQI_COLUMN_SELECTION_LIST(cdsc,
+        MQI_COLUMN_SELECTOR(0, fact_row_t, value)
+    );
+
+    row.value = value++;
+    rows[0]   = &row;
+    rows[1]   = NULL;
+
+    /* the end of the transaction triggers the change detection */
+    tx = MQI_BEGIN;
+
+    if (MQI_INSERT_INTO(rs->tables[fact], cdsc, rows) != 1)
+        fail("%s: failed to insert into fact table %d", rs->name, fact);
+
+    MQI_COMMIT(tx);
+}
+
+
+static int initial_update(ruleset_t *rs)
+{
+    int i;
+
+    /* populate all fact tables, so every target needs an update */
+    for (i = 0; i < rs->nfact; i++)
+        change_fact(rs, i);
+
+    if (update_ruleset(rs) != rs->ntarget) {
+        fail("%s: initial update did not update all targets", rs->name);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+static void mark_expected(ruleset_t *rs, int fact)
+{
+    rule_t *rule;
+    int     i, j, dep;
+
+    /*
+     * Targets only depend on targets defined before them, so a single
+     * pass in definition order propagates the dependencies transitively.
+     */
+
+    memset(rs->expected, 0, rs->ntarget);
+
+    for (i = 0; i < rs->ntarget; i++) {
+        rule = rs->rules + i;
+
+        for (j = 0; j < rule->ndepend; j++) {
+            dep = rule->depends[j];
+
+            if ((dep < 0 && DEP_FACT(dep) == fact) ||
+                (dep >= 0 && rs->expected[dep]))
+                rs->expected[i] = TRUE;
+        }
+    }
+}
+
+
+static int check_dirty(ruleset_t *rs, const char *when)
+{
+    target_t *t;
+    int       i, ndirty;
+
+    ndirty = 0;
+
+    for (i = 0; i < rs->ntarget; i++) {
+        t = rs->r->targets + i;
+
+        if (!t->dirty != !rs->expected[i]) {
+            fail("%s: %s, target '%s' is %s", rs->name, when, t->name,
+                 t->dirty ? "dirty" : "not dirty");
+            return -1;
+        }
+
+        if (t->dirty)
+            ndirty++;
+    }
+
+    return ndirty;
+}
+
+
+static int check_fact(ruleset_t *rs, int fact)
+{
+    int ndirty, nupdate, i;
+
+    mark_expected(rs, fact);
+    change_fact(rs, fact);
+
+    if ((ndirty = check_dirty(rs, "after fact change")) < 0)
+        return -1;
+
+    if (!rs->r->auto_update->dirty != !ndirty) {
+        fail("%s: '%s' is %s with %d dirty targets", rs->name, AUTOUPDATE,
+             rs->r->auto_update->dirty ? "dirty" : "not dirty", ndirty);
+        return -1;
+    }
+
+    if ((nupdate = update_ruleset(rs)) < 0)
+        return -1;
+
+    for (i = 0; i < rs->ntarget; i++) {
+        if (rs->executed[i] != rs->expected[i]) {
+            fail("%s: target '%s' was %s", rs->name, rs->r->targets[i].name,
+                 rs->executed[i] ? "updated" : "not updated");
+            return -1;
+        }
+    }
+
+    memset(rs->expected, 0, rs->ntarget);
+
+    if (check_dirty(rs, "after update") < 0)
+        return -1;
+
+    return nupdate;
+}
+
+
+static void test_ruleset(void)
+{
+    /*
+     * f0 -> t0 -> t2 -> t3, t5
+     * f1 -> t1 -> t2
+     * f2 -> t4 -> t5, t6
+     */
+    static rule_t rules[] = {
+        { 1, { FACT_DEP(0) } },          /* t0 */
+        { 1, { FACT_DEP(1) } },          /* t1 */
+        { 2, { 0, 1 } },                 /* t2 */
+        { 1, { 2 } },                    /* t3 */
+        { 1, { FACT_DEP(2) } },          /* t4 */
+        { 2, { 4, 0 } },                 /* t5 */
+        { 2, { FACT_DEP(2), 4 } },       /* t6 */
+    };
+    static int nupdate[] = { 4, 3, 3 };
+    ruleset_t  rs;
+    int        i, n;
+
+    mrp_clear(&rs);
+    rs.name    = "fixed";
+    rs.rules   = rules;
+    rs.ntarget = MRP_ARRAY_SIZE(rules);
+    rs.nfact   = 3;
+
+    if (!create_ruleset(&rs) || !prepare_ruleset(&rs))
+        goto out;
+
+    if (!initial_update(&rs))
+        goto out;
+
+    for (i = 0; i < rs.nfact; i++) {
+        if ((n = check_fact(&rs, i)) < 0)
+            break;
+
+        if (n != nupdate[i]) {
+            fail("%s: change of fact %d updated %d targets instead of %d",
+                 rs.name, i, n, nupdate[i]);
+            break;
+        }
+    }
+
+    /* no fact changes, nothing to update */
+    if (i == rs.nfact && (n = update_ruleset(&rs)) != 0)
+        fail("%s: update without changes updated %d targets", rs.name, n);
+
+ out:
+    destroy_ruleset(&rs);
+}
+
+
+static int has_dependency(rule_t *rule, int dep)
+{
+    int i;
+
+    for (i = 0; i < rule->ndepend; i++)
+        if (rule->depends[i] == dep)
+            return TRUE;
+
+    return FALSE;
+}
+
+
+static void generate_rules(rule_t *rules, int ntarget, int nfact)
+{
+    rule_t *rule;
+    int     i, j, dep, ntdep;
+
+    /*
+     * The first nfact targets depend on a fact each. The rest are split
+     * into nfact interleaved groups, each target depending on one or two
+     * earlier targets of its own group, occasionally on a random earlier
+     * target and on a random fact. So every target depends on at least
+     * one fact and a fact change affects mostly a single group.
+     */
+
+    srand(12345);
+
+    for (i = 0; i < ntarget; i++) {
+        rule = rules + i;
+        rule->ndepend = 0;
+
+        if (i < nfact) {
+            rule->depends[rule->ndepend++] = FACT_DEP(i);
+            continue;
+        }
+
+        ntdep = 1 + rand() % 2;
+
+        for (j = 0; j < ntdep; j++) {
+            dep = i - nfact * (1 + rand() % 4);
+
+            if (dep < 0)
+                dep = i - nfact;
+
+            if (!has_dependency(rule, dep))
+                rule->depends[rule->ndepend++] = dep;
+        }
+
+        if (rand() % 16 == 0 && !has_dependency(rule, dep = rand() % i))
+            rule->depends[rule->ndepend++] = dep;
+
+        if (rand() % 8 == 0)
+            rule->depends[rule->ndepend++] = FACT_DEP(rand() % nfact);
+    }
+}
+
+
+static void test_generated(int ntarget, int nfact, int nchange)
+{
+    ruleset_t  rs;
+    double     start, t_create, t_prepare;
+    long       total;
+    int        i, n;
+
+    mrp_clear(&rs);
+    rs.name    = "generated";
+    rs.ntarget = ntarget;
+    rs.nfact   = nfact;
+    rs.rules   = mrp_allocz_array(rule_t, ntarget);
+
+    if (rs.rules == NULL) {
+        fail("%s: failed to allocate rules", rs.name);
+        return;
+    }
+
+    generate_rules(rs.rules, ntarget, nfact);
+
+    start = now();
+
+    if (!create_ruleset(&rs))
+        goto out;
+
+    t_create = now() - start;
+    start    = now();
+
+    if (!prepare_ruleset(&rs))
+        goto out;
+
+    t_prepare = now() - start;
+
+    if (!initial_update(&rs))
+        goto out;
+
+    printf("%d targets, %d facts:\n", ntarget, nfact);
+    printf("    create      : %8.2f ms\n", 1000.0 * t_create);
+    printf("    prepare     : %8.2f ms\n", 1000.0 * t_prepare);
+    printf("    full update : %8.2f ms\n", 1000.0 * rs.utime);
+
+    total    = 0;
+    rs.utime = 0;
+
+    for (i = 0; i < nchange; i++) {
+        if ((n = check_fact(&rs, i % nfact)) < 0)
+            goto out;
+
+        total += n;
+    }
+
+    printf("    fact change : %8.2f ms, %ld targets updated on average\n",
+           1000.0 * rs.utime / nchange, total / nchange);
+
+ out:
+    destroy_ruleset(&rs);
+    mrp_free(rs.rules);
+}
+
+
+int main(int argc, char **argv)
+{
+    int ntarget, nfact, nchange;
+
+    ntarget = argc > 1 ? atoi(argv[1]) : 4000;
+    nfact   = argc > 2 ? atoi(argv[2]) : 64;
+    nchange = argc > 3 ? atoi(argv[3]) : 256;
+
+    if (ntarget <= 0 || nfact <= 0 || nfact > ntarget || nchange <= 0) {
+        printf("usage: %s [targets [facts [changes]]]\n", argv[0]);
+        exit(1);
+    }
+
+    mrp_log_set_mask(MRP_LOG_MASK_ERROR);
+
+    mrp_clear(&ctx);
+
+    if ((ctx.ml = mrp_mainloop_create()) == NULL || mqi_open() != 0) {
+        printf("failed to set up test context\n");
+        exit(1);
+    }
+
+    test_ruleset();
+    test_generated(ntarget, nfact, nchange);
+
+    mrp_mainloop_destroy(ctx.ml);
+
+    if (nfailed) {
+        printf("%d checks failed\n", nfailed);
+        exit(1);
+    }
+
+    printf("all checks passed\n");
+
+    return 0;
+}
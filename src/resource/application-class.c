@@ -45,6 +45,7 @@
 #include "application-class.h"
 #include "resource-set.h"
 #include "resource-owner.h"
+#include "resource.h"
 #include "zone.h"
 
 #define CLASS_MAX        64
@@ -93,6 +94,7 @@ typedef struct {
 
 static MRP_LIST_HOOK(class_list);
 static mrp_htbl_t *name_hash;
+static bool class_table_live;
 
 static void init_name_hash(void);
 static int  add_to_name_hash(mrp_application_class_t *);
@@ -101,6 +103,7 @@ static void remove_from_name_hash(mrp_application_class_t *);
 #endif
 
 static mqi_handle_t get_database_table(void);
+static void materialize_application_class_table(mqi_handle_t, int, void *);
 static void insert_into_application_class_table(const char *, uint32_t);
 
 
@@ -158,14 +161,16 @@ mrp_application_class_t *mrp_application_class_create(const char *name,
     for (zone = 0;  zone < MRP_ZONE_MAX;  zone++)
         mrp_list_init(&class->resource_sets[zone]);
 
+    /* must precede adding the class to the list, as creating the table
+       might materialize it with all listed classes */
+    insert_into_application_class_table(class->name, class->priority);
+
     /* list do not have insert_before function,
        so don't be mislead by the name */
     mrp_list_append(insert_before, &class->list);
 
     add_to_name_hash(class);
 
-    insert_into_application_class_table(class->name, class->priority);
-
     return class;
 }
 
@@ -521,11 +526,43 @@ static mqi_handle_t get_database_table(void)
 
         if (table == MQI_HANDLE_INVALID)
             mrp_log_error("Can't create table '%s': %s", name,strerror(errno));
+        else {
+            mrp_resource_table_set_materializer(table,
+                                         materialize_application_class_table,
+                                         NULL);
+        }
     }
 
     return table;
 }
 
+static void materialize_application_class_table(mqi_handle_t table,
+                                                int subscribed,
+                                                void *user_data)
+{
+    mrp_application_class_t *class;
+    mrp_list_hook_t *clhook, *n;
+    mqi_handle_t trh;
+
+    MRP_UNUSED(user_data);
+
+    /* the table is only filled in while somebody is subscribed to it */
+    class_table_live = subscribed ? true : false;
+
+    trh = mqi_begin_transaction();
+
+    if (!subscribed)
+        MQI_DELETE(table, NULL);
+    else {
+        mrp_list_foreach(&class_list, clhook, n) {
+            class = mrp_list_entry(clhook, mrp_application_class_t, list);
+            insert_into_application_class_table(class->name, class->priority);
+        }
+    }
+
+    mqi_commit_transaction(trh);
+}
+
 static void insert_into_application_class_table(const char *name, uint32_t pri)
 {
     MQI_COLUMN_SELECTION_LIST(cols,
@@ -540,6 +577,9 @@ static void insert_into_application_class_table(const char *name, uint32_t pri)
     MRP_ASSERT(name, "invalid argument");
     MRP_ASSERT(table != MQI_HANDLE_INVALID, "database problem");
 
+    if (!class_table_live)
+        return;
+
     row.class_name = name;
     row.priority = pri;
 
@@ -111,6 +111,10 @@ void mrp_resource_set_acquire(mrp_resource_set_t *resource_set,
 void mrp_resource_set_release(mrp_resource_set_t *resource_set,
                               uint32_t request_id);
 
+/* Defer zone arbitration of acquire/release requests until the batch ends. */
+void mrp_resource_begin_batch(void);
+void mrp_resource_end_batch(void);
+
 mrp_resource_t *
 mrp_resource_set_iterate_resources(mrp_resource_set_t *resource_set,void **it);
 
@@ -50,6 +50,10 @@
 #define RESPROTO_RESFLAG_MANDATORY    RESPROTO_BIT(0)
 #define RESPROTO_RESFLAG_SHARED       RESPROTO_BIT(1)
 
+#define RESPROTO_CAPFLAG_MULTI_EVENT  RESPROTO_BIT(0) /* coalesced events */
+
+#define RESPROTO_BATCH_MAX            64 /* max. requests in a batch */
+
 #define RESPROTO_TAG(x)               ((uint16_t)(x))
 
 #define RESPROTO_MESSAGE_END          MRP_MSG_FIELD_END
@@ -71,6 +75,7 @@
 #define RESPROTO_ATTRIBUTE_INDEX      RESPROTO_TAG(16)
 #define RESPROTO_ATTRIBUTE_NAME       RESPROTO_TAG(17)
 #define RESPROTO_ATTRIBUTE_VALUE      RESPROTO_TAG(18)
+#define RESPROTO_CAPABILITIES         RESPROTO_TAG(19)
 
 typedef enum {
     RESPROTO_QUERY_RESOURCES,
@@ -81,6 +86,9 @@ typedef enum {
     RESPROTO_ACQUIRE_RESOURCE_SET,
     RESPROTO_RELEASE_RESOURCE_SET,
     RESPROTO_RESOURCES_EVENT,
+    RESPROTO_BATCH_REQUEST,
+    RESPROTO_SET_CAPABILITIES,
+    RESPROTO_MULTI_RESOURCES_EVENT,
 } mrp_resproto_request_t;
 
 typedef enum {
@@ -67,6 +67,10 @@ typedef struct {
 
 static mrp_resource_owner_t  resource_owners[MRP_ZONE_MAX * MRP_RESOURCE_MAX];
 static mqi_handle_t          owner_tables[MRP_RESOURCE_MAX];
+static mqi_handle_t          owner_rows[MRP_ZONE_MAX * MRP_RESOURCE_MAX];
+static bool                  owner_live[MRP_RESOURCE_MAX];
+static int                   batch_depth;
+static uint32_t              batch_zones;
 
 static mrp_resource_owner_t *get_owner(uint32_t, uint32_t);
 static void reset_owners(uint32_t, mrp_resource_owner_t *);
@@ -80,6 +84,8 @@ static bool advice_ownership(mrp_resource_owner_t *, mrp_zone_t *,
 static void manager_start_transaction(mrp_zone_t *);
 static void manager_end_transaction(mrp_zone_t *);
 
+static void owner_table_materialize(mqi_handle_t, int, void *);
+static mqi_handle_t *get_owner_row(mrp_zone_t *, mrp_resource_def_t *);
 static void delete_resource_owner(mrp_zone_t *, mrp_resource_t *);
 static void insert_resource_owner(mrp_zone_t *, mrp_application_class_t *,
                                   mrp_resource_set_t *, mrp_resource_t *);
@@ -115,6 +121,8 @@ int mrp_resource_owner_create_database_table(mrp_resource_def_t *rdef)
         mqi_open();
         for (i = 0;  i < MRP_RESOURCE_MAX;  i++)
             owner_tables[i] = MQI_HANDLE_INVALID;
+        for (i = 0;  i < MRP_ZONE_MAX * MRP_RESOURCE_MAX;  i++)
+            owner_rows[i] = MQI_HANDLE_INVALID;
         initialized = true;
     }
 
@@ -154,6 +162,8 @@ int mrp_resource_owner_create_database_table(mrp_resource_def_t *rdef)
 
     owner_tables[rdef->id] = table;
 
+    mrp_resource_table_set_materializer(table, owner_table_materialize, rdef);
+
     return 0;
 }
 
@@ -162,6 +172,35 @@ void mrp_resource_owner_recalc(uint32_t zoneid)
     mrp_resource_owner_update_zone(zoneid, NULL, 0);
 }
 
+void mrp_resource_begin_batch(void)
+{
+    batch_depth++;
+}
+
+void mrp_resource_end_batch(void)
+{
+    mqi_handle_t trh;
+    uint32_t zones;
+    uint32_t zoneid;
+
+    MRP_ASSERT(batch_depth > 0, "unbalanced resource batch");
+
+    if (--batch_depth > 0 || !(zones = batch_zones))
+        return;
+
+    batch_zones = 0;
+
+    /* run a single arbitration pass for every zone touched by the batch */
+    trh = mqi_begin_transaction();
+
+    for (zoneid = 0;  zones;  zoneid++, zones >>= 1) {
+        if ((zones & 1))
+            mrp_resource_owner_update_zone(zoneid, NULL, 0);
+    }
+
+    mqi_commit_transaction(trh);
+}
+
 void mrp_resource_owner_update_zone(uint32_t zoneid,
                                     mrp_resource_set_t *reqset,
                                     uint32_t reqid)
@@ -198,6 +237,15 @@ void mrp_resource_owner_update_zone(uint32_t zoneid,
 
     MRP_ASSERT(zoneid < MRP_ZONE_MAX, "invalid argument");
 
+    if (batch_depth > 0) {
+        /* remember the request so it gets replied to when the batch ends */
+        if (reqset && reqid == reqset->request.id)
+            reqset->request.pending = true;
+
+        batch_zones |= ((uint32_t)1 << zoneid);
+        return;
+    }
+
     zone = mrp_zone_find_by_id(zoneid);
 
     MRP_ASSERT(zone, "zone is not defined");
@@ -299,6 +347,11 @@ void mrp_resource_owner_update_zone(uint32_t zoneid,
             notify  = 0;
             replyid = (reqset == rset && reqid == rset->request.id) ? reqid:0;
 
+            if (rset->request.pending) {
+                replyid = rset->request.id;
+                rset->request.pending = false;
+            }
+
 
             if (force_release) {
                 move = (rset->state != mrp_resource_release);
@@ -628,24 +681,64 @@ static void manager_end_transaction(mrp_zone_t *zone)
 }
 
 
-static void delete_resource_owner(mrp_zone_t *zone, mrp_resource_t *res)
+static void owner_table_materialize(mqi_handle_t table, int subscribed,
+                                    void *user_data)
 {
-    static uint32_t zone_id;
+    mrp_resource_def_t *rdef = (mrp_resource_def_t *)user_data;
+    mrp_resource_owner_t *owner;
+    mrp_zone_t *zone;
+    mqi_handle_t trh;
+    uint32_t zoneid;
 
-    MQI_WHERE_CLAUSE(where,
-        MQI_EQUAL( MQI_COLUMN(0), MQI_UNSIGNED_VAR(zone_id) )
-    );
+    /* rebuild the owner rows of all zones, or drop them if unsubscribed */
+    mrp_debug("%s owner table of resource '%s'",
+              subscribed ? "materializing" : "dropping", rdef->name);
 
+    owner_live[rdef->id] = subscribed ? true : false;
+
+    trh = mqi_begin_transaction();
+
+    if (!subscribed)
+        MQI_DELETE(table, NULL);
+
+    for (zoneid = 0;  zoneid < MRP_ZONE_MAX;  zoneid++) {
+        if (!(zone = mrp_zone_find_by_id(zoneid)))
+            continue;
+
+        owner = get_owner(zoneid, rdef->id);
+
+        if (!subscribed)
+            *get_owner_row(zone, rdef) = MQI_HANDLE_INVALID;
+        else if (owner->res)
+            insert_resource_owner(zone, owner->class, owner->rset, owner->res);
+    }
+
+    mqi_commit_transaction(trh);
+}
+
+static mqi_handle_t *get_owner_row(mrp_zone_t *zone, mrp_resource_def_t *rdef)
+{
+    return owner_rows + (zone->id * MRP_RESOURCE_MAX + rdef->id);
+}
+
+static void delete_resource_owner(mrp_zone_t *zone, mrp_resource_t *res)
+{
     mrp_resource_def_t *rdef;
+    mqi_handle_t *rowh;
     int n;
 
     MRP_ASSERT(res, "invalid argument");
 
     rdef = res->def;
-    zone_id = zone->id;
+    rowh = get_owner_row(zone, rdef);
+
+    if (!owner_live[rdef->id])
+        return;
 
-    if ((n = MQI_DELETE(owner_tables[rdef->id], where)) != 1)
+    if ((n = MQI_DELETE_ROW(owner_tables[rdef->id], *rowh)) != 1)
         mrp_log_error("Could not delete resource owner");
+
+    *rowh = MQI_HANDLE_INVALID;
 }
 
 static void insert_resource_owner(mrp_zone_t *zone,
@@ -657,12 +750,14 @@ static void insert_resource_owner(mrp_zone_t *zone,
     uint32_t i;
     int n;
     owner_row_t row;
-    owner_row_t *rows[2];
     mqi_column_desc_t cdsc[FIRST_ATTRIBUTE_IDX + MQI_COLUMN_MAX + 1];
 
     MRP_ASSERT(FIRST_ATTRIBUTE_IDX + rdef->nattr <= MQI_COLUMN_MAX,
                "too many attributes for a table");
 
+    if (!owner_live[rdef->id])
+        return;
+
     row.zone_id    = zone->id;
     row.zone_name  = zone->name;
     row.class_name = class->name;
@@ -687,10 +782,10 @@ static void insert_resource_owner(mrp_zone_t *zone,
     
     set_attr_descriptors(cdsc + (i+1), res);
 
-    rows[0] = &row;
-    rows[1] = NULL;
+    n = MQI_INSERT_ROW(owner_tables[rdef->id], cdsc, &row,
+                       get_owner_row(zone, rdef));
 
-    if ((n = MQI_INSERT_INTO(owner_tables[rdef->id], cdsc, rows)) != 1)
+    if (n != 1)
         mrp_log_error("can't insert row into owner table");
 }
 
@@ -699,23 +794,18 @@ static void update_resource_owner(mrp_zone_t *zone,
                                   mrp_resource_set_t *rset,
                                   mrp_resource_t *res)
 {
-    static uint32_t zone_id;
-
-    MQI_WHERE_CLAUSE(where,
-        MQI_EQUAL( MQI_COLUMN(0), MQI_UNSIGNED_VAR(zone_id) )
-    );
-
     mrp_resource_def_t *rdef = res->def;
     uint32_t i;
     int n;
     owner_row_t row;
     mqi_column_desc_t cdsc[FIRST_ATTRIBUTE_IDX + MQI_COLUMN_MAX + 1];
 
-    zone_id = zone->id;
-
     MRP_ASSERT(1 + rdef->nattr <= MQI_COLUMN_MAX,
                "too many attributes for a table");
 
+    if (!owner_live[rdef->id])
+        return;
+
     row.class_name = class->name;
     row.rset_id    = rset->id;
     memcpy(row.attrs, res->attrs, rdef->nattr * sizeof(mrp_attr_value_t));
@@ -730,8 +820,10 @@ static void update_resource_owner(mrp_zone_t *zone,
 
     set_attr_descriptors(cdsc + (i+1), res);
 
+    n = MQI_UPDATE_ROW(owner_tables[rdef->id], cdsc, &row,
+                       *get_owner_row(zone, rdef));
 
-    if ((n = MQI_UPDATE(owner_tables[rdef->id], cdsc, &row, where)) != 1)
+    if (n < 0)                           /* 0 if nothing has changed */
         mrp_log_error("can't update row in owner table");
 }
 
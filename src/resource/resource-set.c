@@ -204,6 +204,23 @@ mrp_resource_client_t *mrp_get_resource_set_client(mrp_resource_set_t *rset)
     return rset->client.ptr;
 }
 
+mrp_resource_set_t *mrp_resource_set_iterate(void **cursor)
+{
+    mrp_list_hook_t *entry;
+
+    MRP_ASSERT(cursor, "invalid argument");
+
+    entry = (*cursor == NULL) ? resource_set_list.next :
+                                (mrp_list_hook_t *)*cursor;
+
+    if (entry == &resource_set_list)
+        return NULL;
+
+    *cursor = entry->next;
+
+    return mrp_list_entry(entry, mrp_resource_set_t, list);
+}
+
 mrp_resource_t *mrp_resource_set_find_resource(uint32_t rsetid,
                                                const char *resnam)
 {
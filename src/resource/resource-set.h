@@ -79,6 +79,7 @@ struct mrp_resource_set_s {
     struct {
         uint32_t id;
         uint32_t stamp;
+        bool pending;
     }                               request;
     mrp_resource_event_cb_t         event;
     void                           *user_data;
@@ -86,6 +87,7 @@ struct mrp_resource_set_s {
 
 
 mrp_resource_set_t *mrp_resource_set_find_by_id(uint32_t);
+mrp_resource_set_t *mrp_resource_set_iterate(void **);
 mrp_resource_t     *mrp_resource_set_find_resource(uint32_t, const char *);
 uint32_t            mrp_get_resource_set_count(void);
 void                mrp_resource_set_updated(mrp_resource_set_t *);
@@ -34,6 +34,9 @@
 
 #include <murphy/common/mm.h>
 #include <murphy/common/log.h>
+#include <murphy/common/mainloop.h>
+#include <murphy/core/context.h>
+#include <murphy/core/lua-bindings/murphy.h>
 
 #include <murphy-db/mqi.h>
 
@@ -57,6 +60,8 @@
 #define GRANT_IDX            3
 #define FIRST_ATTRIBUTE_IDX  4
 
+#define TABLE_LINGER_MSECS   5000 /* keep unsubscribed tables this long */
+
 
 #define VALID_TYPE(t) ((t) == mqi_string  || \
                        (t) == mqi_integer || \
@@ -71,11 +76,21 @@ typedef struct {
     mrp_attr_value_t  attrs[MQI_COLUMN_MAX];
 } user_row_t;
 
+typedef struct {
+    mqi_handle_t          table;
+    mqi_materialize_cb_t  materialize;
+    void                 *user_data;
+    bool                  subscribed;
+    bool                  live;     /* whether the table is filled in */
+    mrp_timer_t          *linger;   /* pending drop of the table */
+} lazy_table_t;
+
 
 static uint32_t            resource_def_count;
 static mrp_resource_def_t *resource_def_table[RESOURCE_MAX];
 static MRP_LIST_HOOK(manager_list);
 static mqi_handle_t        resource_user_table[RESOURCE_MAX];
+static bool                resource_user_live[RESOURCE_MAX];
 
 static uint32_t add_resource_definition(const char *, bool, uint32_t,
                                         mrp_resource_mgr_ftbl_t *, void *);
@@ -91,11 +106,14 @@ static mrp_attr_value_t *get_resource_attribute_default_value(mrp_resource_t*,
 #endif
 
 static int  resource_user_create_table(mrp_resource_def_t *);
-static void resource_user_insert(mrp_resource_t *, bool);
+static void resource_user_materialize(mqi_handle_t, int, void *);
+static void resource_user_insert(mrp_resource_t *, bool, int, bool);
 static void resource_user_delete(mrp_resource_t *);
 
 static void set_attr_descriptors(mqi_column_desc_t *, mrp_resource_t *);
 
+static void lazy_table_materialize(mqi_handle_t, int, void *);
+
 
 
 uint32_t mrp_resource_definition_create(const char *name, bool shareable,
@@ -275,6 +293,7 @@ mrp_resource_t *mrp_resource_create(const char *name,
             res->rsetid = rsetid;
             res->def = rdef;
             res->shared = rdef->shareable ?  shared : false;
+            res->row = MQI_HANDLE_INVALID;
 
             sts = mrp_attribute_set_values(attrs, rdef->nattr,
                                            rdef->attrdefs, res->attrs);
@@ -284,7 +303,8 @@ mrp_resource_t *mrp_resource_create(const char *name,
                 return NULL;
             }
 
-            resource_user_insert(res, autorel);
+            resource_user_insert(res, autorel, mrp_resource_no_request,
+                                 false);
         }
     }
 
@@ -710,25 +730,150 @@ static int resource_user_create_table(mrp_resource_def_t *rdef)
 
     resource_user_table[rdef->id] = table;
 
+    mrp_resource_table_set_materializer(table, resource_user_materialize, rdef);
+
     return 0;
 }
 
-static void resource_user_insert(mrp_resource_t *res, bool autorel)
+int mrp_resource_table_set_materializer(mqi_handle_t table,
+                                        mqi_materialize_cb_t materialize,
+                                        void *user_data)
+{
+    lazy_table_t *lt;
+
+    if (!(lt = mrp_allocz(sizeof(*lt))))
+        return -1;
+
+    lt->table       = table;
+    lt->materialize = materialize;
+    lt->user_data   = user_data;
+
+    if (mqi_set_table_materializer(table, lazy_table_materialize, lt) < 0) {
+        mrp_free(lt);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void lazy_table_drop(mrp_timer_t *t, void *user_data)
+{
+    lazy_table_t *lt = (lazy_table_t *)user_data;
+
+    mrp_del_timer(t);
+    lt->linger = NULL;
+
+    if (!lt->subscribed && lt->live) {
+        lt->live = false;
+        lt->materialize(lt->table, 0, lt->user_data);
+    }
+}
+
+static void lazy_table_materialize(mqi_handle_t table, int subscribed,
+                                   void *user_data)
+{
+    lazy_table_t  *lt = (lazy_table_t *)user_data;
+    mrp_context_t *ctx;
+
+    /*
+     * Ad-hoc selects subscribe to a table only for the duration of the
+     * query. To avoid filling and emptying the table for every one of
+     * them, it is only dropped after it has been left unsubscribed for
+     * a while. Without a mainloop to time this, drop it right away.
+     */
+
+    lt->subscribed = subscribed ? true : false;
+
+    if (subscribed) {
+        if (!lt->live) {
+            lt->live = true;
+            lt->materialize(table, 1, lt->user_data);
+        }
+        return;
+    }
+
+    if (lt->linger)
+        mrp_mod_timer(lt->linger, MRP_TIMER_RESTART);
+    else if ((ctx = mrp_lua_get_murphy_context()) && ctx->ml)
+        lt->linger = mrp_add_timer(ctx->ml, TABLE_LINGER_MSECS,
+                                   lazy_table_drop, lt);
+
+    if (!lt->linger) {
+        lt->live = false;
+        lt->materialize(table, 0, lt->user_data);
+    }
+}
+
+static void resource_user_materialize(mqi_handle_t table, int subscribed,
+                                      void *user_data)
+{
+    mrp_resource_def_t *rdef = (mrp_resource_def_t *)user_data;
+    mrp_resource_set_t *rset;
+    mrp_resource_t *res;
+    mrp_resource_mask_t mask;
+    void *rsc, *rc;
+    mqi_handle_t trh;
+    bool grant;
+
+    /*
+     * Nobody looks at the user table of this resource unless it is
+     * subscribed, so we only keep it up to date in that case. On the
+     * first subscription the rows of all existing users are inserted
+     * in a single transaction, and after the last one is gone the
+     * table is emptied.
+     */
+
+    mrp_debug("%s user table of resource '%s'",
+              subscribed ? "materializing" : "dropping", rdef->name);
+
+    resource_user_live[rdef->id] = subscribed ? true : false;
+
+    trh  = mqi_begin_transaction();
+    mask = ((mrp_resource_mask_t)1) << rdef->id;
+    rsc  = NULL;
+
+    if (!subscribed)
+        MQI_DELETE(table, NULL);
+
+    while ((rset = mrp_resource_set_iterate(&rsc))) {
+        rc = NULL;
+
+        while ((res = mrp_resource_set_iterate_resources(rset, &rc))) {
+            if (res->def != rdef)
+                continue;
+
+            if (subscribed) {
+                grant = (rset->resource.mask.grant & mask) ? true : false;
+                resource_user_insert(res, rset->auto_release.client,
+                                     rset->state, grant);
+            }
+            else
+                res->row = MQI_HANDLE_INVALID;
+        }
+    }
+
+    mqi_commit_transaction(trh);
+}
+
+static void resource_user_insert(mrp_resource_t *res, bool autorel,
+                                 int state, bool grant)
 {
     mrp_resource_def_t *rdef = res->def;
     uint32_t i;
     int n;
     user_row_t row;
-    user_row_t *rows[2];
     mqi_column_desc_t cdsc[FIRST_ATTRIBUTE_IDX + MQI_COLUMN_MAX + 1];
 
     MRP_ASSERT(FIRST_ATTRIBUTE_IDX + rdef->nattr <= MQI_COLUMN_MAX,
                "too many attributes for a table");
 
+    if (!resource_user_live[rdef->id])
+        return;
+
     row.rsetid   = res->rsetid;
     row.autorel  = autorel;
-    row.grant    = 0;
-    row.state    = mrp_resource_no_request;
+    row.grant    = grant;
+    row.state    = state;
     memcpy(row.attrs, res->attrs, rdef->nattr * sizeof(mrp_attr_value_t));
 
     i = 0;
@@ -749,52 +894,44 @@ static void resource_user_insert(mrp_resource_t *res, bool autorel)
 
     set_attr_descriptors(cdsc + (i+1), res);
 
-    rows[0] = &row;
-    rows[1] = NULL;
+    n = MQI_INSERT_ROW(resource_user_table[rdef->id], cdsc, &row, &res->row);
 
-    if ((n = MQI_INSERT_INTO(resource_user_table[rdef->id], cdsc, rows)) != 1)
+    if (n != 1)
         mrp_log_error("can't insert row into resource user table");
 }
 
 static void resource_user_delete(mrp_resource_t *res)
 {
-    static uint32_t rsetid;
-
-    MQI_WHERE_CLAUSE(where,
-        MQI_EQUAL( MQI_COLUMN(RSETID_IDX), MQI_UNSIGNED_VAR(rsetid) )
-    );
-
     mrp_resource_def_t *rdef;
     int n;
 
     MRP_ASSERT(res, "invalid argument");
 
     rdef = res->def;
-    rsetid = res->rsetid;
 
-    if ((n = MQI_DELETE(resource_user_table[rdef->id], where)) != 1)
+    if (res->row == MQI_HANDLE_INVALID)
+        return;
+
+    if ((n = MQI_DELETE_ROW(resource_user_table[rdef->id], res->row)) != 1)
         mrp_log_error("Could not delete resource user");
+
+    res->row = MQI_HANDLE_INVALID;
 }
 
 void mrp_resource_user_update(mrp_resource_t *res, int state, bool grant)
 {
-    static uint32_t rsetid;
-
-    MQI_WHERE_CLAUSE(where,
-        MQI_EQUAL( MQI_COLUMN(RSETID_IDX), MQI_UNSIGNED_VAR(rsetid) )
-    );
-
     mrp_resource_def_t *rdef = res->def;
     uint32_t i;
     int n;
     user_row_t row;
     mqi_column_desc_t cdsc[FIRST_ATTRIBUTE_IDX + MQI_COLUMN_MAX + 1];
 
-    rsetid = res->rsetid;
-
     MRP_ASSERT(1 + rdef->nattr <= MQI_COLUMN_MAX,
                "too many attributes for a table");
 
+    if (res->row == MQI_HANDLE_INVALID)
+        return;
+
     row.state = state;
     row.grant = grant;
     memcpy(row.attrs, res->attrs, rdef->nattr * sizeof(mrp_attr_value_t));
@@ -809,7 +946,9 @@ void mrp_resource_user_update(mrp_resource_t *res, int state, bool grant)
 
     set_attr_descriptors(cdsc + (i+1), res);
 
-    if ((n = MQI_UPDATE(resource_user_table[rdef->id], cdsc,&row, where)) != 1)
+    n = MQI_UPDATE_ROW(resource_user_table[rdef->id], cdsc, &row, res->row);
+
+    if (n < 0)                           /* 0 if nothing has changed */
         mrp_log_error("can't update row in resource user table");
 }
 
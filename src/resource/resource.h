@@ -53,6 +53,7 @@ struct mrp_resource_s {
     uint32_t            rsetid;
     mrp_resource_def_t *def;
     bool                shared;
+    mqi_handle_t        row;        /* row in the resource user table */
     mrp_attr_value_t    attrs[0];
 };
 
@@ -77,6 +78,10 @@ int                 mrp_resource_attribute_print(mrp_resource_t *, char *,int);
 
 void                mrp_resource_user_update(mrp_resource_t *, int, bool);
 
+int                 mrp_resource_table_set_materializer(mqi_handle_t,
+                                                        mqi_materialize_cb_t,
+                                                        void *);
+
 #endif  /* __MURPHY_RESOURCE_H__ */
 
 /*
@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2012, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <libgen.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/log.h>
+#include <murphy/core/context.h>
+#include <murphy/core/lua-bindings/murphy.h>
+
+#include <murphy-db/mqi.h>
+
+#include <murphy/resource/config-api.h>
+#include <murphy/resource/manager-api.h>
+#include <murphy/resource/client-api.h>
+
+/*
+ * Measure the acquire and release rate of the resource library, once
+ * with nobody reading the resource tables in murphy-db, in which case
+ * they should not be written at all, and once with every table watched,
+ * in which case they are kept up to date on every arbitration pass. In
+ * between, measure the rate of ad-hoc selects of every table.
+ */
+
+static const char *resources[] = {
+    "audio_playback", "audio_recording", "video_playback", "video_recording",
+};
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+
+static void event_cb(uint32_t reqid, mrp_resource_set_t *rset, void *data)
+{
+    MRP_UNUSED(reqid);
+    MRP_UNUSED(rset);
+    MRP_UNUSED(data);
+}
+
+
+static void setup(int nres)
+{
+    mrp_context_t *ctx;
+    int            i;
+
+    /* the resource library keeps Lua objects for sets and resources */
+    if ((ctx = mrp_context_create()) == NULL ||
+        mrp_lua_set_murphy_context(ctx) == NULL) {
+        printf("failed to set up murphy context\n");
+        exit(1);
+    }
+
+    mrp_resource_configuration_init();
+
+    if (mqi_open() < 0 || mrp_zone_definition_create(NULL) < 0 ||
+        mrp_zone_create("driver", NULL) == MRP_ZONE_ID_INVALID) {
+        printf("failed to create resource zone\n");
+        exit(1);
+    }
+
+    for (i = 0; i < nres; i++) {
+        if (mrp_resource_definition_create(resources[i], true, NULL,
+                                           NULL, NULL) == MRP_RESOURCE_ID_INVALID) {
+            printf("failed to create resource %s\n", resources[i]);
+            exit(1);
+        }
+    }
+
+    if (!mrp_application_class_create("player", 1, false, false,
+                                      MRP_RESOURCE_ORDER_FIFO)) {
+        printf("failed to create application class\n");
+        exit(1);
+    }
+}
+
+
+static mrp_resource_set_t **create_sets(mrp_resource_client_t *client,
+                                        int nset, int nres)
+{
+    mrp_resource_set_t **sets;
+    int                  i, j;
+
+    if ((sets = calloc(nset, sizeof(sets[0]))) == NULL)
+        exit(1);
+
+    for (i = 0; i < nset; i++) {
+        sets[i] = mrp_resource_set_create(client, false, false, 0,
+                                          event_cb, NULL);
+
+        if (sets[i] == NULL)
+            goto fail;
+
+        for (j = 0; j < nres; j++)
+            if (mrp_resource_set_add_resource(sets[i], resources[j], true,
+                                              NULL, true) < 0)
+                goto fail;
+
+        if (mrp_application_class_add_resource_set("player", "driver",
+                                                   sets[i], 0) < 0)
+            goto fail;
+    }
+
+    return sets;
+
+ fail:
+    printf("failed to create resource set #%d\n", i);
+    exit(1);
+}
+
+
+static int get_tables(mqi_handle_t *tables, int max)
+{
+    char *names[256];
+    int   n, i;
+
+    if ((n = mqi_show_tables(MQI_ANY, names, MRP_ARRAY_SIZE(names))) < 0)
+        return -1;
+
+    for (i = 0; i < n && i < max; i++)
+        tables[i] = mqi_get_table_handle(names[i]);
+
+    return i;
+}
+
+
+/*
+ * Subscribe to and unsubscribe from every resource table, as an ad-hoc
+ * select of each would. The first round fills the tables, which is what
+ * every round would cost if tables were dropped right after the select.
+ * Later rounds should find them still materialized.
+ */
+
+static void select_all(mqi_handle_t *tables, int ntbl)
+{
+    int i;
+
+    for (i = 0; i < ntbl; i++)
+        mqi_subscribe_table(tables[i]);
+    for (i = 0; i < ntbl; i++)
+        mqi_unsubscribe_table(tables[i]);
+}
+
+
+static double adhoc_selects(mqi_handle_t *tables, int ntbl, int rounds,
+                            double *first)
+{
+    double start;
+    int    r;
+
+    start = now();
+    select_all(tables, ntbl);
+    *first = now() - start;
+
+    start = now();
+
+    for (r = 0; r < rounds; r++)
+        select_all(tables, ntbl);
+
+    return 1.0 * rounds / (now() - start);
+}
+
+
+static double run(mrp_resource_set_t **sets, int nset, int rounds)
+{
+    double start;
+    int    r, i;
+
+    start = now();
+
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < nset; i++)
+            mrp_resource_set_acquire(sets[i], 0);
+        for (i = 0; i < nset; i++)
+            mrp_resource_set_release(sets[i], 0);
+    }
+
+    return 1.0 * rounds * nset / (now() - start);
+}
+
+
+int main(int argc, char **argv)
+{
+    mrp_resource_client_t  *client;
+    mrp_resource_set_t    **sets;
+    mqi_handle_t            tables[256];
+    int                     nset, nres, rounds, ntbl, i;
+    double                  unwatched, watched, adhoc, first;
+
+    nset   = argc > 1 ? atoi(argv[1]) : 64;
+    nres   = argc > 2 ? atoi(argv[2]) : 4;
+    rounds = argc > 3 ? atoi(argv[3]) : 2000;
+
+    if (nset <= 0 || nres <= 0 || nres > (int)MRP_ARRAY_SIZE(resources) ||
+        rounds <= 0) {
+        printf("usage: %s [sets [resources (max. %d) [rounds]]]\n",
+               basename(argv[0]), (int)MRP_ARRAY_SIZE(resources));
+        exit(1);
+    }
+
+    mrp_log_set_mask(MRP_LOG_MASK_ERROR);
+
+    setup(nres);
+
+    if ((client = mrp_resource_client_create("bench", NULL)) == NULL) {
+        printf("failed to create resource client\n");
+        exit(1);
+    }
+
+    sets = create_sets(client, nset, nres);
+
+    run(sets, nset, rounds / 10 + 1);
+    unwatched = run(sets, nset, rounds);
+
+    if ((ntbl = get_tables(tables, MRP_ARRAY_SIZE(tables))) < 0) {
+        printf("failed to list resource tables\n");
+        exit(1);
+    }
+
+    adhoc = adhoc_selects(tables, ntbl, rounds, &first);
+
+    /* every table watched, as if by a reader */
+    for (i = 0; i < ntbl; i++)
+        mqi_subscribe_table(tables[i]);
+
+    run(sets, nset, rounds / 10 + 1);
+    watched = run(sets, nset, rounds);
+
+    printf("%d sets of %d resources, %d rounds:\n", nset, nres, rounds);
+    printf("    no readers         : %9.0f acquire+release/s\n", unwatched);
+    printf("    %2d tables watched  : %9.0f acquire+release/s\n", ntbl,
+           watched);
+    printf("    ad-hoc selects     : %9.0f rounds/s, first %.0f us\n", adhoc,
+           first * 1000000.0);
+
+    mrp_resource_client_destroy(client);
+    free(sets);
+
+    return 0;
+}